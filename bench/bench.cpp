@@ -0,0 +1,207 @@
+#include "bench.h"
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace bb {
+
+#ifdef _MSC_VER
+const void *volatile gBenchmarkSink;
+#endif
+
+static double getNowNs() {
+  return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+static double timeRepetition(const BenchmarkKernel &_kernel,
+                             uint32_t _numIterations) {
+  double startNs = getNowNs();
+  _kernel(_numIterations);
+  return getNowNs() - startNs;
+}
+
+static BenchmarkResult runBenchmark(const std::string &_name,
+                                    const BenchmarkCase &_case,
+                                    const BenchmarkParams &_params) {
+  // Doubles the iterations until a repetition lasts long enough for the
+  // clock to resolve it.
+  double minRepetitionNs = _params.MinRepetitionMs * 1e6;
+  uint32_t numIterations = 1;
+  for (;;) {
+    double ns = timeRepetition(_case.Kernel, numIterations);
+    if (ns >= minRepetitionNs || numIterations >= (1u << 30)) {
+      break;
+    }
+    numIterations *= 2;
+  }
+
+  for (uint32_t i = 0; i < _params.NumWarmupRepetitions; ++i) {
+    timeRepetition(_case.Kernel, numIterations);
+  }
+
+  std::vector<double> samplesNs(std::max(_params.NumRepetitions, 1u));
+  for (double &sampleNs : samplesNs) {
+    sampleNs = timeRepetition(_case.Kernel, numIterations) / numIterations;
+  }
+  std::sort(samplesNs.begin(), samplesNs.end());
+
+  BenchmarkResult result = {};
+  result.Name = _name;
+  result.NumIterations = numIterations;
+  result.NumRepetitions = (uint32_t)samplesNs.size();
+  result.MinNs = samplesNs.front();
+  result.MaxNs = samplesNs.back();
+  size_t mid = samplesNs.size() / 2;
+  result.MedianNs = samplesNs.size() % 2 == 1
+                        ? samplesNs[mid]
+                        : (samplesNs[mid - 1] + samplesNs[mid]) * 0.5;
+  for (double sampleNs : samplesNs) {
+    result.MeanNs += sampleNs;
+  }
+  result.MeanNs /= samplesNs.size();
+  for (double sampleNs : samplesNs) {
+    result.StdDevNs += (sampleNs - result.MeanNs) * (sampleNs - result.MeanNs);
+  }
+  result.StdDevNs = sqrt(result.StdDevNs / samplesNs.size());
+  result.NumBytes = _case.NumBytes;
+  result.NumItems = _case.NumItems;
+  return result;
+}
+
+// In MB/s and millions of items per second, at the median.
+static double getMBPerSecond(const BenchmarkResult &_result) {
+  return _result.NumBytes * 1e3 / _result.MedianNs;
+}
+
+static double getMItemsPerSecond(const BenchmarkResult &_result) {
+  return _result.NumItems * 1e3 / _result.MedianNs;
+}
+
+static void printResult(const BenchmarkResult &_result) {
+  printf("%-36s %12.1f ns  (min %.1f, max %.1f, sd %4.1f%%) x%u",
+         _result.Name.c_str(), _result.MedianNs, _result.MinNs, _result.MaxNs,
+         _result.MeanNs > 0.0 ? 100.0 * _result.StdDevNs / _result.MeanNs
+                              : 0.0,
+         _result.NumIterations);
+  if (_result.NumBytes > 0) {
+    printf("  %.0f MB/s", getMBPerSecond(_result));
+  }
+  if (_result.NumItems > 0) {
+    printf("  %.2f M items/s", getMItemsPerSecond(_result));
+  }
+  printf("\n");
+}
+
+// One benchmark per line, in the order they're run, so that the output of
+// two builds can be diffed.
+static bool writeResults(const std::vector<BenchmarkResult> &_results,
+                         const BenchmarkParams &_params,
+                         const std::string &_filePath) {
+  FILE *f = fopen(_filePath.c_str(), "w");
+  if (!f) {
+    return false;
+  }
+  fprintf(f, "{\n");
+  fprintf(f,
+          "  \"params\": {\"warmup_repetitions\": %u, \"repetitions\": %u, "
+          "\"min_repetition_ms\": %.1f},\n",
+          _params.NumWarmupRepetitions, _params.NumRepetitions,
+          _params.MinRepetitionMs);
+  fprintf(f, "  \"benchmarks\": [\n");
+  for (size_t i = 0; i < _results.size(); ++i) {
+    const BenchmarkResult &result = _results[i];
+    fprintf(f,
+            "    {\"name\": \"%s\", \"iterations\": %u, \"repetitions\": %u, "
+            "\"median_ns\": %.3f, \"mean_ns\": %.3f, \"min_ns\": %.3f, "
+            "\"max_ns\": %.3f, \"stddev_ns\": %.3f, \"bytes\": %llu, "
+            "\"items\": %llu, \"mb_per_s\": %.3f, \"mitems_per_s\": %.3f}%s\n",
+            result.Name.c_str(), result.NumIterations, result.NumRepetitions,
+            result.MedianNs, result.MeanNs, result.MinNs, result.MaxNs,
+            result.StdDevNs, (unsigned long long)result.NumBytes,
+            (unsigned long long)result.NumItems, getMBPerSecond(result),
+            getMItemsPerSecond(result), i + 1 < _results.size() ? "," : "");
+  }
+  fprintf(f, "  ]\n");
+  fprintf(f, "}\n");
+  bool isWritten = ferror(f) == 0;
+  fclose(f);
+  return isWritten;
+}
+
+} // namespace bb
+
+static void printUsage() {
+  printf("Usage: bench [--filter <substring>] [--json <path>] "
+         "[--resources <dir>]\n"
+         "             [--repetitions <n>] [--warmup <n>] "
+         "[--min-ms <ms>] [--list]\n");
+}
+
+int main(int _argc, char **_argv) {
+  using namespace bb;
+
+  BenchmarkParams params;
+  std::string jsonPath;
+  bool listsOnly = false;
+  for (int i = 1; i < _argc; ++i) {
+    const char *arg = _argv[i];
+    bool hasValue = i + 1 < _argc;
+    if (strcmp(arg, "--filter") == 0 && hasValue) {
+      params.Filter = _argv[++i];
+    } else if (strcmp(arg, "--json") == 0 && hasValue) {
+      jsonPath = _argv[++i];
+    } else if (strcmp(arg, "--resources") == 0 && hasValue) {
+      params.ResourceRoot = _argv[++i];
+    } else if (strcmp(arg, "--repetitions") == 0 && hasValue) {
+      params.NumRepetitions = (uint32_t)atoi(_argv[++i]);
+    } else if (strcmp(arg, "--warmup") == 0 && hasValue) {
+      params.NumWarmupRepetitions = (uint32_t)atoi(_argv[++i]);
+    } else if (strcmp(arg, "--min-ms") == 0 && hasValue) {
+      params.MinRepetitionMs = (float)atof(_argv[++i]);
+    } else if (strcmp(arg, "--list") == 0) {
+      listsOnly = true;
+    } else {
+      printUsage();
+      return 1;
+    }
+  }
+
+  std::vector<Benchmark> benchmarks;
+  addMathBenchmarks(benchmarks);
+  addPathBenchmarks(benchmarks);
+  addImageBenchmarks(benchmarks, params);
+  addMeshBenchmarks(benchmarks);
+  addMemoryBenchmarks(benchmarks);
+  addEnumArrayBenchmarks(benchmarks);
+  addSceneBenchmarks(benchmarks);
+
+  std::vector<BenchmarkResult> results;
+  for (const Benchmark &benchmark : benchmarks) {
+    if (benchmark.Name.find(params.Filter) == std::string::npos) {
+      continue;
+    }
+    if (listsOnly) {
+      printf("%s\n", benchmark.Name.c_str());
+      continue;
+    }
+    BenchmarkCase benchmarkCase = benchmark.Setup();
+    if (!benchmarkCase.Kernel) {
+      printf("%-36s skipped\n", benchmark.Name.c_str());
+      continue;
+    }
+    results.push_back(runBenchmark(benchmark.Name, benchmarkCase, params));
+    printResult(results.back());
+    fflush(stdout);
+  }
+
+  if (!jsonPath.empty() && !writeResults(results, params, jsonPath)) {
+    printf("Failed to write %s\n", jsonPath.c_str());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <functional>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace bb {
+
+// Microbenchmarks of CPU hot paths. Each benchmark runs its kernel in
+// repetitions of enough iterations to last MinRepetitionMs, after a few
+// warm-up repetitions, and reports statistics of the time per iteration.
+
+// Runs the measured code _numIterations times.
+using BenchmarkKernel = std::function<void(uint32_t _numIterations)>;
+
+struct BenchmarkCase {
+  BenchmarkKernel Kernel;
+  // Processed per iteration, for throughput. 0 if it doesn't apply.
+  uint64_t NumBytes;
+  uint64_t NumItems;
+};
+
+struct Benchmark {
+  std::string Name;
+  // Prepares the inputs, which isn't timed. Returns a case without a kernel
+  // to skip the benchmark, such as when an input file is missing.
+  std::function<BenchmarkCase()> Setup;
+};
+
+struct BenchmarkParams {
+  uint32_t NumWarmupRepetitions = 3;
+  uint32_t NumRepetitions = 15;
+  float MinRepetitionMs = 20.f;
+  // Benchmarks whose name doesn't contain it are skipped.
+  std::string Filter;
+  // Where input files such as images are looked up.
+  std::string ResourceRoot = "resources";
+};
+
+struct BenchmarkResult {
+  std::string Name;
+  uint32_t NumIterations;
+  uint32_t NumRepetitions;
+  // Per iteration, across repetitions.
+  double MinNs;
+  double MedianNs;
+  double MeanNs;
+  double MaxNs;
+  double StdDevNs;
+  uint64_t NumBytes;
+  uint64_t NumItems;
+};
+
+void addMathBenchmarks(std::vector<Benchmark> &_benchmarks);
+void addPathBenchmarks(std::vector<Benchmark> &_benchmarks);
+void addImageBenchmarks(std::vector<Benchmark> &_benchmarks,
+                        const BenchmarkParams &_params);
+void addMeshBenchmarks(std::vector<Benchmark> &_benchmarks);
+void addMemoryBenchmarks(std::vector<Benchmark> &_benchmarks);
+void addEnumArrayBenchmarks(std::vector<Benchmark> &_benchmarks);
+void addSceneBenchmarks(std::vector<Benchmark> &_benchmarks);
+
+// In [0, 1). Deterministic, so that every run sees the same inputs.
+inline float getBenchmarkRandom(uint32_t &_state) {
+  _state = _state * 1664525u + 1013904223u;
+  return (float)(_state >> 8) * (1.f / 16777216.f);
+}
+
+#ifdef _MSC_VER
+extern const void *volatile gBenchmarkSink;
+#endif
+
+// Keeps the compiler from optimizing _value, and what computed it, away.
+template <typename T> inline void doNotOptimize(const T &_value) {
+#ifdef _MSC_VER
+  gBenchmarkSink = &_value;
+  _ReadWriteBarrier();
+#else
+  asm volatile("" : : "r"(&_value) : "memory");
+#endif
+}
+
+} // namespace bb
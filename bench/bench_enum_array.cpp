@@ -0,0 +1,84 @@
+#include "bench.h"
+#include "enum_array.h"
+
+namespace bb {
+
+// Shaped like RenderPassType and ShadowCasterType, whose headers need Vulkan.
+enum class RenderPassType { Forward, Deferred, Visibility, COUNT };
+enum class ShadowCasterType { Static, Dynamic, COUNT };
+
+// As many arrays as a frame of per-pass or per-caster state would touch.
+constexpr uint32_t numEnumArrays = 4096;
+
+// Sums every element of numEnumArrays arrays of T per iteration, reading them
+// with _sum, against plain arrays of the same size summed by index.
+template <typename E, typename T, typename SumFn>
+static void addEnumArraySumBenchmark(std::vector<Benchmark> &_benchmarks,
+                                     const std::string &_name,
+                                     const SumFn &_sum) {
+  _benchmarks.push_back({_name, [_sum]() {
+    std::vector<EnumArray<E, T>> arrays(numEnumArrays);
+    uint32_t state = 7;
+    for (EnumArray<E, T> &array : arrays) {
+      for (T &elem : array) {
+        elem = (T)(getBenchmarkRandom(state) * 1000.f);
+      }
+    }
+    BenchmarkCase benchmarkCase = {};
+    benchmarkCase.NumItems = (uint64_t)numEnumArrays * EnumCount<E>;
+    benchmarkCase.NumBytes = numEnumArrays * sizeof(EnumArray<E, T>);
+    benchmarkCase.Kernel = [arrays, _sum](uint32_t _numIterations) {
+      for (uint32_t i = 0; i < _numIterations; ++i) {
+        T sum = 0;
+        for (const EnumArray<E, T> &array : arrays) {
+          sum += _sum(array);
+        }
+        doNotOptimize(sum);
+      }
+    };
+    return benchmarkCase;
+  }});
+}
+
+template <typename E, typename T>
+static void addEnumArrayBenchmarks(std::vector<Benchmark> &_benchmarks,
+                                   const std::string &_prefix) {
+  addEnumArraySumBenchmark<E, T>(
+      _benchmarks, _prefix + "_range_for",
+      [](const EnumArray<E, T> &_array) {
+        T sum = 0;
+        for (T elem : _array) {
+          sum += elem;
+        }
+        return sum;
+      });
+  addEnumArraySumBenchmark<E, T>(
+      _benchmarks, _prefix + "_all_enums",
+      [](const EnumArray<E, T> &_array) {
+        T sum = 0;
+        for (E e : AllEnums<E>) {
+          sum += _array[e];
+        }
+        return sum;
+      });
+  // The baseline: the same elements in a plain array.
+  addEnumArraySumBenchmark<E, T>(
+      _benchmarks, _prefix + "_plain_array",
+      [](const EnumArray<E, T> &_array) {
+        const T(&elems)[EnumCount<E>] = _array.Elems;
+        T sum = 0;
+        for (int i = 0; i < EnumCount<E>; ++i) {
+          sum += elems[i];
+        }
+        return sum;
+      });
+}
+
+void addEnumArrayBenchmarks(std::vector<Benchmark> &_benchmarks) {
+  addEnumArrayBenchmarks<RenderPassType, float>(
+      _benchmarks, "enum_array/render_pass_float");
+  addEnumArrayBenchmarks<ShadowCasterType, uint64_t>(
+      _benchmarks, "enum_array/shadow_caster_u64");
+}
+
+} // namespace bb
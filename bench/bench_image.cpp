@@ -0,0 +1,120 @@
+#include "bench.h"
+#include "frame_encode.h"
+#include "path.h"
+#include "external/stb_image.h"
+#include <memory>
+#include <stdio.h>
+
+namespace bb {
+
+static bool readBenchmarkFile(const std::string &_filePath,
+                              std::vector<uint8_t> &_contents) {
+  FILE *f = fopen(_filePath.c_str(), "rb");
+  if (!f) {
+    return false;
+  }
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  _contents.resize(size > 0 ? (size_t)size : 0);
+  bool isRead = fread(_contents.data(), 1, _contents.size(), f) ==
+                _contents.size();
+  fclose(f);
+  return isRead && !_contents.empty();
+}
+
+// Decodes from memory, as resource loading does after reading the file, so
+// that only decoding is measured.
+static void addImageDecodeBenchmark(std::vector<Benchmark> &_benchmarks,
+                                    const std::string &_name,
+                                    const std::string &_filePath) {
+  _benchmarks.push_back({_name, [_filePath]() {
+    BenchmarkCase benchmarkCase = {};
+    std::vector<uint8_t> contents;
+    int width, height, numChannels;
+    if (!readBenchmarkFile(_filePath, contents) ||
+        !stbi_info_from_memory(contents.data(), (int)contents.size(), &width,
+                               &height, &numChannels)) {
+      printf("Failed to read %s\n", _filePath.c_str());
+      return benchmarkCase;
+    }
+    benchmarkCase.NumBytes = (uint64_t)width * height * 4;
+    benchmarkCase.Kernel = [contents](uint32_t _numIterations) {
+      for (uint32_t i = 0; i < _numIterations; ++i) {
+        int width, height, numChannels;
+        stbi_uc *pixels =
+            stbi_load_from_memory(contents.data(), (int)contents.size(),
+                                  &width, &height, &numChannels,
+                                  STBI_rgb_alpha);
+        doNotOptimize(pixels);
+        stbi_image_free(pixels);
+      }
+    };
+    return benchmarkCase;
+  }});
+}
+
+using FrameWriter = void (*)(FILE *_file, const uint8_t *_texels,
+                            uint32_t _width, uint32_t _height, bool _isBGRA);
+
+// Writes a 1080p BGRA8 frame as frame readback's encoder thread does, into a
+// temporary file that every iteration overwrites. Captures keep up with the
+// frame rate as long as this takes less than a frame.
+static void addFrameEncodeBenchmark(std::vector<Benchmark> &_benchmarks,
+                                    const std::string &_name,
+                                    FrameWriter _writeFrame) {
+  _benchmarks.push_back({_name, [_writeFrame]() {
+    constexpr uint32_t width = 1920;
+    constexpr uint32_t height = 1080;
+    BenchmarkCase benchmarkCase = {};
+    std::shared_ptr<FILE> file(tmpfile(), [](FILE *_file) {
+      if (_file) {
+        fclose(_file);
+      }
+    });
+    if (!file) {
+      printf("Failed to create a temporary file\n");
+      return benchmarkCase;
+    }
+
+    // Smooth gradients with some noise, as rendered frames tend to be.
+    auto texels = std::make_shared<std::vector<uint8_t>>(
+        (size_t)width * height * 4);
+    uint32_t state = 5;
+    for (uint32_t y = 0; y < height; ++y) {
+      for (uint32_t x = 0; x < width; ++x) {
+        uint8_t *texel = texels->data() + ((size_t)width * y + x) * 4;
+        uint8_t noise = (uint8_t)(getBenchmarkRandom(state) * 16.f);
+        texel[0] = (uint8_t)(x * 255 / width) + noise;
+        texel[1] = (uint8_t)(y * 255 / height) + noise;
+        texel[2] = (uint8_t)((x + y) * 127 / height) + noise;
+        texel[3] = 255;
+      }
+    }
+
+    benchmarkCase.NumBytes = texels->size();
+    benchmarkCase.Kernel = [_writeFrame, file,
+                            texels](uint32_t _numIterations) {
+      for (uint32_t i = 0; i < _numIterations; ++i) {
+        rewind(file.get());
+        _writeFrame(file.get(), texels->data(), width, height, true);
+      }
+      fflush(file.get());
+    };
+    return benchmarkCase;
+  }});
+}
+
+void addImageBenchmarks(std::vector<Benchmark> &_benchmarks,
+                        const BenchmarkParams &_params) {
+  addImageDecodeBenchmark(_benchmarks, "image/decode_png",
+                          joinPaths(_params.ResourceRoot, "uv_debug.png"));
+  addImageDecodeBenchmark(_benchmarks, "image/decode_jpg",
+                          joinPaths(_params.ResourceRoot, "texture.jpg"));
+  addFrameEncodeBenchmark(_benchmarks, "image/encode_png_1080p", writePNG);
+  addFrameEncodeBenchmark(_benchmarks, "image/encode_raw_1080p", writeRaw);
+  addFrameEncodeBenchmark(_benchmarks, "image/encode_y4m_1080p",
+                          writeY4MFrame);
+}
+
+} // namespace bb
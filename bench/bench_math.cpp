@@ -0,0 +1,125 @@
+#include "bench.h"
+#include "vector_math.h"
+
+namespace bb {
+
+constexpr uint32_t numMathElements = 1024;
+
+static std::vector<Mat4> createRandomTransforms(uint32_t _count) {
+  std::vector<Mat4> transforms(_count);
+  uint32_t state = 1;
+  for (Mat4 &transform : transforms) {
+    Float3 delta = {getBenchmarkRandom(state) * 100.f,
+                    getBenchmarkRandom(state) * 100.f,
+                    getBenchmarkRandom(state) * 100.f};
+    transform = Mat4::translate(delta) *
+                Mat4::rotateY(getBenchmarkRandom(state) * 360.f) *
+                Mat4::rotateX(getBenchmarkRandom(state) * 360.f) *
+                Mat4::scale(0.5f + getBenchmarkRandom(state));
+  }
+  return transforms;
+}
+
+static std::vector<Float3> createRandomPoints(uint32_t _count) {
+  std::vector<Float3> points(_count);
+  uint32_t state = 2;
+  for (Float3 &point : points) {
+    point = {getBenchmarkRandom(state) * 2.f - 1.f,
+             getBenchmarkRandom(state) * 2.f - 1.f,
+             getBenchmarkRandom(state) * 2.f - 1.f};
+  }
+  return points;
+}
+
+void addMathBenchmarks(std::vector<Benchmark> &_benchmarks) {
+  _benchmarks.push_back({"math/mat4_multiply", []() {
+    std::vector<Mat4> transforms = createRandomTransforms(numMathElements);
+    BenchmarkCase benchmarkCase = {};
+    benchmarkCase.NumItems = numMathElements;
+    benchmarkCase.Kernel = [transforms](uint32_t _numIterations) {
+      Mat4 parent = transforms[0];
+      for (uint32_t i = 0; i < _numIterations; ++i) {
+        for (const Mat4 &transform : transforms) {
+          Mat4 result = parent * transform;
+          doNotOptimize(result);
+        }
+      }
+    };
+    return benchmarkCase;
+  }});
+
+  _benchmarks.push_back({"math/mat4_inverse", []() {
+    std::vector<Mat4> transforms = createRandomTransforms(numMathElements);
+    BenchmarkCase benchmarkCase = {};
+    benchmarkCase.NumItems = numMathElements;
+    benchmarkCase.Kernel = [transforms](uint32_t _numIterations) {
+      for (uint32_t i = 0; i < _numIterations; ++i) {
+        for (const Mat4 &transform : transforms) {
+          Mat4 inverse = transform.inverse();
+          doNotOptimize(inverse);
+        }
+      }
+    };
+    return benchmarkCase;
+  }});
+
+  _benchmarks.push_back({"math/transform_aabb", []() {
+    std::vector<Mat4> transforms = createRandomTransforms(numMathElements);
+    AABB aabb = {};
+    aabb.extend(Float3{-1, -1, -1});
+    aabb.extend(Float3{1, 2, 1});
+    BenchmarkCase benchmarkCase = {};
+    benchmarkCase.NumItems = numMathElements;
+    benchmarkCase.Kernel = [transforms, aabb](uint32_t _numIterations) {
+      for (uint32_t i = 0; i < _numIterations; ++i) {
+        AABB bounds = {};
+        for (const Mat4 &transform : transforms) {
+          bounds.extend(transformAABB(transform, aabb));
+        }
+        doNotOptimize(bounds);
+      }
+    };
+    return benchmarkCase;
+  }});
+
+  _benchmarks.push_back({"math/float3_normalize_cross", []() {
+    std::vector<Float3> points = createRandomPoints(numMathElements);
+    BenchmarkCase benchmarkCase = {};
+    benchmarkCase.NumItems = numMathElements;
+    benchmarkCase.Kernel = [points](uint32_t _numIterations) {
+      for (uint32_t i = 0; i < _numIterations; ++i) {
+        Float3 sum = {};
+        for (size_t p = 0; p + 1 < points.size(); ++p) {
+          Float3 normal = cross(points[p], points[p + 1]).normalize();
+          sum += normal * dot(normal, points[p]);
+        }
+        doNotOptimize(sum);
+      }
+    };
+    return benchmarkCase;
+  }});
+
+  _benchmarks.push_back({"math/frustum_spheres", []() {
+    std::vector<Float3> points = createRandomPoints(numMathElements);
+    for (Float3 &point : points) {
+      point = point * 50.f;
+    }
+    Mat4 viewProj = Mat4::perspective(60.f, 16.f / 9.f, 0.1f, 100.f) *
+                    Mat4::lookAt({0, 0, -60}, {0, 0, 0});
+    BenchmarkCase benchmarkCase = {};
+    benchmarkCase.NumItems = numMathElements;
+    benchmarkCase.Kernel = [points, viewProj](uint32_t _numIterations) {
+      for (uint32_t i = 0; i < _numIterations; ++i) {
+        Frustum frustum = extractFrustum(viewProj);
+        uint32_t numVisible = 0;
+        for (const Float3 &point : points) {
+          numVisible += isSphereInFrustum(frustum, point, 1.f) ? 1 : 0;
+        }
+        doNotOptimize(numVisible);
+      }
+    };
+    return benchmarkCase;
+  }});
+}
+
+} // namespace bb
@@ -0,0 +1,156 @@
+#include "bench.h"
+#include "job.h"
+#include "vertex.h"
+#include <memory>
+#include <string.h>
+
+namespace bb {
+
+// Copies into host memory the size of typical staging uploads. Mapped
+// staging memory is write-combined on most GPUs, so this is a lower bound on
+// what uploads take.
+static void addStagingCopyBenchmark(std::vector<Benchmark> &_benchmarks,
+                                    const std::string &_name,
+                                    size_t _numBytes) {
+  _benchmarks.push_back({_name, [_numBytes]() {
+    auto src = std::make_shared<std::vector<uint8_t>>(_numBytes, uint8_t(1));
+    auto dst = std::make_shared<std::vector<uint8_t>>(_numBytes);
+    BenchmarkCase benchmarkCase = {};
+    benchmarkCase.NumBytes = _numBytes;
+    benchmarkCase.Kernel = [src, dst](uint32_t _numIterations) {
+      for (uint32_t i = 0; i < _numIterations; ++i) {
+        memcpy(dst->data(), src->data(), src->size());
+        doNotOptimize(*dst->data());
+      }
+    };
+    return benchmarkCase;
+  }});
+}
+
+// As maxNumCrowdInstances shader balls of a few parts.
+constexpr uint32_t numBenchmarkInstances = 16384;
+constexpr uint32_t numBenchmarkInstanceParts = 4;
+constexpr int instanceBatchSize = 256;
+
+struct BenchmarkInstances {
+  std::vector<Mat4> Placements;
+  std::vector<Mat4> PartTransforms;
+  std::vector<InstanceBlock> Instances;
+};
+
+static std::shared_ptr<BenchmarkInstances> createBenchmarkInstances() {
+  auto instances = std::make_shared<BenchmarkInstances>();
+  uint32_t state = 4;
+  instances->Placements.resize(numBenchmarkInstances);
+  for (Mat4 &placement : instances->Placements) {
+    placement = Mat4::translate({getBenchmarkRandom(state) * 200.f, 0.f,
+                                 getBenchmarkRandom(state) * 200.f}) *
+                Mat4::rotateY(getBenchmarkRandom(state) * 360.f);
+  }
+  instances->PartTransforms.resize(numBenchmarkInstanceParts);
+  for (Mat4 &transform : instances->PartTransforms) {
+    transform = Mat4::translate({0.f, getBenchmarkRandom(state), 0.f}) *
+                Mat4::scale(0.5f + getBenchmarkRandom(state));
+  }
+  instances->Instances.resize(numBenchmarkInstances *
+                              numBenchmarkInstanceParts);
+  return instances;
+}
+
+// As the shader ball crowd fills its instance buffer.
+static void updateBenchmarkInstance(BenchmarkInstances &_instances,
+                                    uint32_t _index) {
+  const Mat4 &placement = _instances.Placements[_index];
+  for (uint32_t p = 0; p < numBenchmarkInstanceParts; ++p) {
+    InstanceBlock &instance =
+        _instances.Instances[p * numBenchmarkInstances + _index];
+    instance.ModelMat = placement * _instances.PartTransforms[p];
+    instance.InvModelMat = instance.ModelMat.inverse();
+  }
+}
+
+static BenchmarkCase createInstanceUpdateCase() {
+  BenchmarkCase benchmarkCase = {};
+  benchmarkCase.NumBytes = (uint64_t)numBenchmarkInstances *
+                           numBenchmarkInstanceParts * sizeof(InstanceBlock);
+  benchmarkCase.NumItems = numBenchmarkInstances;
+  return benchmarkCase;
+}
+
+void addMemoryBenchmarks(std::vector<Benchmark> &_benchmarks) {
+  addStagingCopyBenchmark(_benchmarks, "memory/staging_copy_64k", 64 << 10);
+  addStagingCopyBenchmark(_benchmarks, "memory/staging_copy_4m", 4 << 20);
+  addStagingCopyBenchmark(_benchmarks, "memory/staging_copy_64m", 64 << 20);
+
+  // Splits interleaved vertices into a position and an attribute stream, as
+  // stageGeometry() does for the split layout.
+  _benchmarks.push_back({"memory/split_vertex_streams", []() {
+    constexpr uint32_t numVertices = 1 << 16;
+    auto vertices = std::make_shared<std::vector<Vertex>>(numVertices);
+    uint32_t state = 5;
+    for (Vertex &v : *vertices) {
+      v.Pos = {getBenchmarkRandom(state), getBenchmarkRandom(state),
+               getBenchmarkRandom(state)};
+      v.UV = {getBenchmarkRandom(state), getBenchmarkRandom(state)};
+    }
+    auto positions = std::make_shared<std::vector<Float3>>(numVertices);
+    auto attributes =
+        std::make_shared<std::vector<VertexAttributes>>(numVertices);
+    BenchmarkCase benchmarkCase = {};
+    benchmarkCase.NumBytes = (uint64_t)numVertices * sizeof(Vertex);
+    benchmarkCase.NumItems = numVertices;
+    benchmarkCase.Kernel = [vertices, positions,
+                            attributes](uint32_t _numIterations) {
+      for (uint32_t i = 0; i < _numIterations; ++i) {
+        for (uint32_t v = 0; v < numVertices; ++v) {
+          const Vertex &vertex = (*vertices)[v];
+          (*positions)[v] = vertex.Pos;
+          (*attributes)[v].UV = vertex.UV;
+          (*attributes)[v].Normal = vertex.Normal;
+          (*attributes)[v].Tangent = vertex.Tangent;
+        }
+        doNotOptimize(*attributes->data());
+      }
+    };
+    return benchmarkCase;
+  }});
+
+  _benchmarks.push_back({"memory/instance_update", []() {
+    std::shared_ptr<BenchmarkInstances> instances =
+        createBenchmarkInstances();
+    BenchmarkCase benchmarkCase = createInstanceUpdateCase();
+    benchmarkCase.Kernel = [instances](uint32_t _numIterations) {
+      for (uint32_t i = 0; i < _numIterations; ++i) {
+        for (uint32_t n = 0; n < numBenchmarkInstances; ++n) {
+          updateBenchmarkInstance(*instances, n);
+        }
+        doNotOptimize(*instances->Instances.data());
+      }
+    };
+    return benchmarkCase;
+  }});
+
+  _benchmarks.push_back({"memory/instance_update_parallel", []() {
+    std::shared_ptr<BenchmarkInstances> instances =
+        createBenchmarkInstances();
+    std::shared_ptr<JobSystem> jobSystem(new JobSystem,
+                                         [](JobSystem *_jobSystem) {
+                                           destroyJobSystem(*_jobSystem);
+                                           delete _jobSystem;
+                                         });
+    initJobSystem(*jobSystem);
+    BenchmarkCase benchmarkCase = createInstanceUpdateCase();
+    benchmarkCase.Kernel = [instances, jobSystem](uint32_t _numIterations) {
+      for (uint32_t i = 0; i < _numIterations; ++i) {
+        parallelFor(*jobSystem, (int)numBenchmarkInstances,
+                    instanceBatchSize, [&](int _index) {
+                      updateBenchmarkInstance(*instances, (uint32_t)_index);
+                    });
+        doNotOptimize(*instances->Instances.data());
+      }
+    };
+    return benchmarkCase;
+  }});
+}
+
+} // namespace bb
@@ -0,0 +1,141 @@
+#include "bench.h"
+#include "job.h"
+#include "model_convert.h"
+#include "external/assimp/mesh.h"
+#include <memory>
+
+namespace bb {
+
+// A tessellated plane with UVs, normals and tangents, standing in for an
+// imported mesh.
+struct BenchmarkMesh {
+  aiMesh Mesh;
+  std::vector<ModelImportChunk> Chunks;
+  std::vector<Vertex> Vertices;
+  std::vector<uint32_t> Indices;
+};
+
+constexpr uint32_t benchmarkMeshNumQuads = 256;
+
+static std::shared_ptr<BenchmarkMesh> createBenchmarkMesh() {
+  auto mesh = std::make_shared<BenchmarkMesh>();
+  aiMesh &aiMesh = mesh->Mesh;
+  uint32_t numSideVertices = benchmarkMeshNumQuads + 1;
+  aiMesh.mPrimitiveTypes = aiPrimitiveType_TRIANGLE;
+  aiMesh.mNumVertices = numSideVertices * numSideVertices;
+  aiMesh.mVertices = new aiVector3D[aiMesh.mNumVertices];
+  aiMesh.mNormals = new aiVector3D[aiMesh.mNumVertices];
+  aiMesh.mTangents = new aiVector3D[aiMesh.mNumVertices];
+  aiMesh.mBitangents = new aiVector3D[aiMesh.mNumVertices];
+  aiMesh.mTextureCoords[0] = new aiVector3D[aiMesh.mNumVertices];
+  aiMesh.mNumUVComponents[0] = 2;
+  uint32_t state = 3;
+  for (uint32_t y = 0; y < numSideVertices; ++y) {
+    for (uint32_t x = 0; x < numSideVertices; ++x) {
+      uint32_t i = y * numSideVertices + x;
+      float u = (float)x / benchmarkMeshNumQuads;
+      float v = (float)y / benchmarkMeshNumQuads;
+      aiMesh.mVertices[i] = {u, getBenchmarkRandom(state) * 0.01f, v};
+      aiMesh.mNormals[i] = {0.f, 1.f, 0.f};
+      aiMesh.mTangents[i] = {1.f, 0.f, 0.f};
+      aiMesh.mBitangents[i] = {0.f, 0.f, 1.f};
+      aiMesh.mTextureCoords[0][i] = {u, v, 0.f};
+    }
+  }
+
+  aiMesh.mNumFaces = benchmarkMeshNumQuads * benchmarkMeshNumQuads * 2;
+  aiMesh.mFaces = new aiFace[aiMesh.mNumFaces];
+  aiFace *face = aiMesh.mFaces;
+  for (uint32_t y = 0; y < benchmarkMeshNumQuads; ++y) {
+    for (uint32_t x = 0; x < benchmarkMeshNumQuads; ++x) {
+      uint32_t i = y * numSideVertices + x;
+      uint32_t quad[2][3] = {{i, i + numSideVertices, i + 1},
+                             {i + 1, i + numSideVertices,
+                              i + numSideVertices + 1}};
+      for (const uint32_t *triangle : quad) {
+        face->mNumIndices = 3;
+        face->mIndices = new unsigned int[3];
+        face->mIndices[0] = triangle[0];
+        face->mIndices[1] = triangle[1];
+        face->mIndices[2] = triangle[2];
+        ++face;
+      }
+    }
+  }
+
+  // Split as loadModel() does.
+  uint32_t numElements = std::max(aiMesh.mNumVertices, aiMesh.mNumFaces);
+  uint32_t numChunks =
+      (numElements + modelImportChunkSize - 1) / modelImportChunkSize;
+  for (uint32_t i = 0; i < numChunks; ++i) {
+    ModelImportChunk chunk = {};
+    chunk.FirstVertex =
+        (uint32_t)((uint64_t)aiMesh.mNumVertices * i / numChunks);
+    chunk.NumVertices =
+        (uint32_t)((uint64_t)aiMesh.mNumVertices * (i + 1) / numChunks) -
+        chunk.FirstVertex;
+    chunk.FirstFace = (uint32_t)((uint64_t)aiMesh.mNumFaces * i / numChunks);
+    chunk.NumFaces =
+        (uint32_t)((uint64_t)aiMesh.mNumFaces * (i + 1) / numChunks) -
+        chunk.FirstFace;
+    mesh->Chunks.push_back(chunk);
+  }
+  mesh->Vertices.resize(aiMesh.mNumVertices);
+  mesh->Indices.resize((size_t)aiMesh.mNumFaces * 3);
+  return mesh;
+}
+
+static void convertBenchmarkChunk(BenchmarkMesh &_mesh, uint32_t _index) {
+  ModelImportChunk chunk = _mesh.Chunks[_index];
+  chunk.Bounds = {};
+  chunk.NumRepairedTangents = 0;
+  convertModelChunk(_mesh.Mesh, _mesh.Vertices.data(), _mesh.Indices.data(),
+                    chunk);
+  doNotOptimize(chunk);
+}
+
+static BenchmarkCase createMeshConvertCase(
+    const std::shared_ptr<BenchmarkMesh> &_mesh) {
+  BenchmarkCase benchmarkCase = {};
+  benchmarkCase.NumBytes = _mesh->Vertices.size() * sizeof(Vertex) +
+                           _mesh->Indices.size() * sizeof(uint32_t);
+  benchmarkCase.NumItems = _mesh->Vertices.size();
+  return benchmarkCase;
+}
+
+void addMeshBenchmarks(std::vector<Benchmark> &_benchmarks) {
+  _benchmarks.push_back({"mesh/convert", []() {
+    std::shared_ptr<BenchmarkMesh> mesh = createBenchmarkMesh();
+    BenchmarkCase benchmarkCase = createMeshConvertCase(mesh);
+    benchmarkCase.Kernel = [mesh](uint32_t _numIterations) {
+      for (uint32_t i = 0; i < _numIterations; ++i) {
+        for (uint32_t c = 0; c < (uint32_t)mesh->Chunks.size(); ++c) {
+          convertBenchmarkChunk(*mesh, c);
+        }
+      }
+    };
+    return benchmarkCase;
+  }});
+
+  _benchmarks.push_back({"mesh/convert_parallel", []() {
+    std::shared_ptr<BenchmarkMesh> mesh = createBenchmarkMesh();
+    std::shared_ptr<JobSystem> jobSystem(new JobSystem,
+                                         [](JobSystem *_jobSystem) {
+                                           destroyJobSystem(*_jobSystem);
+                                           delete _jobSystem;
+                                         });
+    initJobSystem(*jobSystem);
+    BenchmarkCase benchmarkCase = createMeshConvertCase(mesh);
+    benchmarkCase.Kernel = [mesh, jobSystem](uint32_t _numIterations) {
+      for (uint32_t i = 0; i < _numIterations; ++i) {
+        parallelFor(*jobSystem, (int)mesh->Chunks.size(), 1,
+                    [&](int _chunkIndex) {
+                      convertBenchmarkChunk(*mesh, (uint32_t)_chunkIndex);
+                    });
+      }
+    };
+    return benchmarkCase;
+  }});
+}
+
+} // namespace bb
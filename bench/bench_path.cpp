@@ -0,0 +1,62 @@
+#include "bench.h"
+#include "path.h"
+
+namespace bb {
+
+// Typical of what resources and shaders are looked up with.
+static const char *const benchmarkPaths[] = {
+    "resources/textures/uv_debug.png",
+    "..\\resources\\models\\ShaderBall.fbx",
+    "shaders/../shaders/spirv/mesh.vert.spv",
+    "/abs/path/to/a/deeply/nested/../../asset/file.ktx2",
+    "C:\\Projects\\Bibim\\resources\\cooked\\albedo.bc7",
+    "single_file.json",
+};
+constexpr uint32_t numBenchmarkPaths =
+    (uint32_t)(sizeof(benchmarkPaths) / sizeof(benchmarkPaths[0]));
+
+void addPathBenchmarks(std::vector<Benchmark> &_benchmarks) {
+  _benchmarks.push_back({"path/join", []() {
+    BenchmarkCase benchmarkCase = {};
+    benchmarkCase.NumItems = numBenchmarkPaths;
+    benchmarkCase.Kernel = [](uint32_t _numIterations) {
+      for (uint32_t i = 0; i < _numIterations; ++i) {
+        for (const char *path : benchmarkPaths) {
+          std::string joined = joinPaths("C:\\root\\dir\\", path);
+          doNotOptimize(joined);
+        }
+      }
+    };
+    return benchmarkCase;
+  }});
+
+  _benchmarks.push_back({"path/file_name", []() {
+    BenchmarkCase benchmarkCase = {};
+    benchmarkCase.NumItems = numBenchmarkPaths;
+    benchmarkCase.Kernel = [](uint32_t _numIterations) {
+      for (uint32_t i = 0; i < _numIterations; ++i) {
+        for (const char *path : benchmarkPaths) {
+          std::string fileName = getFileName(path);
+          doNotOptimize(fileName);
+        }
+      }
+    };
+    return benchmarkCase;
+  }});
+
+  _benchmarks.push_back({"path/trim_separators", []() {
+    BenchmarkCase benchmarkCase = {};
+    benchmarkCase.NumItems = numBenchmarkPaths;
+    benchmarkCase.Kernel = [](uint32_t _numIterations) {
+      for (uint32_t i = 0; i < _numIterations; ++i) {
+        for (const char *path : benchmarkPaths) {
+          std::string_view trimmed = trimPathSeparators(path);
+          doNotOptimize(trimmed);
+        }
+      }
+    };
+    return benchmarkCase;
+  }});
+}
+
+} // namespace bb
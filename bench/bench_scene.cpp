@@ -0,0 +1,134 @@
+#include "bench.h"
+#include "scene_file.h"
+#include <filesystem>
+#include <memory>
+#include <stdio.h>
+
+namespace bb {
+
+constexpr uint32_t benchmarkSceneGridSize = 1000;
+
+// Writes a 1000 x 1000 grid of instances to a temporary file, which is
+// removed when the returned path is released.
+static std::shared_ptr<const std::string>
+writeBenchmarkSceneFile(const char *_name) {
+  SceneDescription scene;
+  scene.Meshes.push_back({"ball", "ShaderBall.fbx"});
+  scene.Materials = {"first", "second"};
+  uint32_t random = 1;
+  for (uint32_t z = 0; z < benchmarkSceneGridSize; ++z) {
+    for (uint32_t x = 0; x < benchmarkSceneGridSize; ++x) {
+      Mat4 transform =
+          Mat4::translate({(float)x * 2.f, 0.f, (float)z * 2.f}) *
+          Mat4::rotateY(getBenchmarkRandom(random) * 360.f);
+      addSceneInstance(scene, 0, (x + z) % 2, transform);
+    }
+  }
+
+  std::string filePath =
+      (std::filesystem::temp_directory_path() / _name).string();
+  if (!writeSceneFile(scene, filePath)) {
+    printf("Failed to write %s\n", filePath.c_str());
+    return nullptr;
+  }
+  return std::shared_ptr<const std::string>(
+      new std::string(filePath), [](const std::string *_filePath) {
+        remove(_filePath->c_str());
+        delete _filePath;
+      });
+}
+
+// Keeps a scene file open until the kernel is released, then removes it.
+struct OpenBenchmarkScene {
+  std::shared_ptr<const std::string> FilePath;
+  SceneFile Scene = {};
+
+  ~OpenBenchmarkScene() { closeSceneFile(Scene); }
+};
+
+void addSceneBenchmarks(std::vector<Benchmark> &_benchmarks) {
+  // Mapping and validating, which is all loading does before the arrays are
+  // used. Pages are only read as they're touched.
+  _benchmarks.push_back({"scene/open_1m_instances", []() {
+    BenchmarkCase benchmarkCase = {};
+    auto filePath = writeBenchmarkSceneFile("bench_open.bbscene");
+    if (!filePath) {
+      return benchmarkCase;
+    }
+    benchmarkCase.NumItems =
+        (uint64_t)benchmarkSceneGridSize * benchmarkSceneGridSize;
+    benchmarkCase.Kernel = [filePath](uint32_t _numIterations) {
+      for (uint32_t i = 0; i < _numIterations; ++i) {
+        SceneFile scene;
+        bool isOpened = openSceneFile(*filePath, scene);
+        doNotOptimize(isOpened);
+        closeSceneFile(scene);
+      }
+    };
+    return benchmarkCase;
+  }});
+
+  // Opening, then reading every instance array once, from the page cache.
+  _benchmarks.push_back({"scene/read_1m_instances", []() {
+    BenchmarkCase benchmarkCase = {};
+    auto filePath = writeBenchmarkSceneFile("bench_read.bbscene");
+    if (!filePath) {
+      return benchmarkCase;
+    }
+    uint32_t numInstances = benchmarkSceneGridSize * benchmarkSceneGridSize;
+    benchmarkCase.NumItems = numInstances;
+    benchmarkCase.NumBytes =
+        (uint64_t)numInstances * (2 * sizeof(uint32_t) + 3 * sizeof(Float4));
+    benchmarkCase.Kernel = [filePath](uint32_t _numIterations) {
+      for (uint32_t i = 0; i < _numIterations; ++i) {
+        SceneFile scene;
+        if (!openSceneFile(*filePath, scene)) {
+          return;
+        }
+        uint32_t numInstances = scene.Header->NumInstances;
+        uint32_t sum = 0;
+        float rowSum = 0.f;
+        for (uint32_t j = 0; j < numInstances; ++j) {
+          sum += scene.InstanceMeshes[j] + scene.InstanceMaterials[j];
+          for (const Float4 *rows : scene.InstanceRows) {
+            rowSum += rows[j].X + rows[j].Y + rows[j].Z + rows[j].W;
+          }
+        }
+        doNotOptimize(sum);
+        doNotOptimize(rowSum);
+        closeSceneFile(scene);
+      }
+    };
+    return benchmarkCase;
+  }});
+
+  // What FileScene does per instance and part, on one thread.
+  _benchmarks.push_back({"scene/expand_instances", []() {
+    BenchmarkCase benchmarkCase = {};
+    auto open = std::make_shared<OpenBenchmarkScene>();
+    open->FilePath = writeBenchmarkSceneFile("bench_expand.bbscene");
+    if (!open->FilePath || !openSceneFile(*open->FilePath, open->Scene)) {
+      return benchmarkCase;
+    }
+    // Every 15th, as instances of a group are spread over the file.
+    constexpr uint32_t numInstances = 65536;
+    auto instances = std::make_shared<std::vector<uint32_t>>(numInstances);
+    for (uint32_t i = 0; i < numInstances; ++i) {
+      (*instances)[i] = i * 15;
+    }
+    auto blocks = std::make_shared<std::vector<InstanceBlock>>(numInstances);
+    benchmarkCase.NumItems = numInstances;
+    benchmarkCase.NumBytes = numInstances * sizeof(InstanceBlock);
+    benchmarkCase.Kernel = [open, instances, blocks](uint32_t _numIterations) {
+      Mat4 partTransform = Mat4::scale({0.01f, 0.01f, 0.01f});
+      for (uint32_t i = 0; i < _numIterations; ++i) {
+        expandSceneFileInstances(open->Scene, instances->data(), numInstances,
+                                 partTransform, blocks->data());
+        doNotOptimize(blocks->data());
+      }
+    };
+    return benchmarkCase;
+  }});
+}
+
+} // namespace bb
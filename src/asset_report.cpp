@@ -0,0 +1,172 @@
+#include "asset_report.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+namespace bb {
+
+static std::mutex gAssetLoadMutex;
+static std::vector<AssetLoad> gAssetLoads;
+static std::atomic<uint32_t> gNumAssetLoadThreads{0};
+
+static uint32_t getAssetLoadThread() {
+  thread_local uint32_t thread = gNumAssetLoadThreads.fetch_add(1);
+  return thread;
+}
+
+void initAssetLoadReport() { getAssetLoadThread(); }
+
+AssetLoad beginAssetLoad(AssetType _type, std::string_view _name) {
+  AssetLoad load = {};
+  load.Type = _type;
+  load.Name = _name;
+  load.Thread = getAssetLoadThread();
+  load.Queue = -1;
+  load.LastMarkTime = getCurrentTime();
+  return load;
+}
+
+void markAssetLoadStage(AssetLoad &_load, AssetLoadStage _stage) {
+  Time time = getCurrentTime();
+  _load.StageMs[_stage] +=
+      getElapsedTimeInSeconds(_load.LastMarkTime, time) * 1000.f;
+  _load.LastMarkTime = time;
+}
+
+void skipAssetLoadTime(AssetLoad &_load) {
+  _load.LastMarkTime = getCurrentTime();
+}
+
+void endAssetLoad(AssetLoad &_load) {
+  std::lock_guard<std::mutex> lock(gAssetLoadMutex);
+  gAssetLoads.push_back(_load);
+}
+
+float getAssetLoadMs(const AssetLoad &_load) {
+  float ms = 0.f;
+  for (float stageMs : _load.StageMs) {
+    ms += stageMs;
+  }
+  return ms;
+}
+
+AssetLoadReport takeAssetLoadReport(std::string_view _label) {
+  AssetLoadReport report = {};
+  report.Label = _label;
+  {
+    std::lock_guard<std::mutex> lock(gAssetLoadMutex);
+    report.Loads.swap(gAssetLoads);
+  }
+
+  // Loads of the same asset stay in the order they ended.
+  std::stable_sort(report.Loads.begin(), report.Loads.end(),
+                   [](const AssetLoad &_a, const AssetLoad &_b) {
+                     if (_a.Type != _b.Type) {
+                       return _a.Type < _b.Type;
+                     }
+                     return _a.Name < _b.Name;
+                   });
+
+  for (uint32_t i = 0; i < (uint32_t)report.Loads.size(); ++i) {
+    const AssetLoad &load = report.Loads[i];
+    float ms = getAssetLoadMs(load);
+    AssetTypeTotals &totals = report.TypeTotals[load.Type];
+    ++totals.NumLoads;
+    totals.NumBytesRead += load.NumBytesRead;
+    totals.NumDecodedBytes += load.NumDecodedBytes;
+    totals.Ms += ms;
+    for (AssetLoadStage stage : AllEnums<AssetLoadStage>) {
+      report.StageMs[stage] += load.StageMs[stage];
+    }
+    report.Ms += ms;
+    report.Slowest.push_back(i);
+  }
+  std::stable_sort(report.Slowest.begin(), report.Slowest.end(),
+                   [&](uint32_t _a, uint32_t _b) {
+                     return getAssetLoadMs(report.Loads[_a]) >
+                            getAssetLoadMs(report.Loads[_b]);
+                   });
+  return report;
+}
+
+static std::string escapeJSON(std::string_view _str) {
+  std::string escaped;
+  for (char ch : _str) {
+    if (ch == '"' || ch == '\\') {
+      escaped += '\\';
+    }
+    escaped += ch;
+  }
+  return escaped;
+}
+
+bool writeAssetLoadReport(const AssetLoadReport &_report,
+                          const std::string &_filePath) {
+  FILE *f = fopen(_filePath.c_str(), "w");
+  if (!f) {
+    BB_LOG_ERROR("Failed to write {}", _filePath);
+    return false;
+  }
+
+  constexpr uint32_t numSlowest = 10;
+  fprintf(f, "{\n");
+  fprintf(f, "  \"label\": \"%s\",\n", escapeJSON(_report.Label).c_str());
+  fprintf(f, "  \"num_loads\": %zu,\n", _report.Loads.size());
+  fprintf(f, "  \"ms\": %.3f,\n", _report.Ms);
+
+  fprintf(f, "  \"stage_ms\": {");
+  for (AssetLoadStage stage : AllEnums<AssetLoadStage>) {
+    fprintf(f, "%s\"%s\": %.3f", stage == AssetLoadStage::Read ? "" : ", ",
+            assetLoadStageLabels[stage], _report.StageMs[stage]);
+  }
+  fprintf(f, "},\n");
+
+  fprintf(f, "  \"types\": {\n");
+  for (AssetType type : AllEnums<AssetType>) {
+    const AssetTypeTotals &totals = _report.TypeTotals[type];
+    fprintf(f,
+            "    \"%s\": {\"num_loads\": %u, \"bytes_read\": %llu, "
+            "\"decoded_bytes\": %llu, \"ms\": %.3f}%s\n",
+            assetTypeLabels[type], totals.NumLoads,
+            (unsigned long long)totals.NumBytesRead,
+            (unsigned long long)totals.NumDecodedBytes, totals.Ms,
+            (int)type + 1 < (int)AssetType::COUNT ? "," : "");
+  }
+  fprintf(f, "  },\n");
+
+  uint32_t numListed =
+      std::min(numSlowest, (uint32_t)_report.Slowest.size());
+  fprintf(f, "  \"slowest\": [\n");
+  for (uint32_t i = 0; i < numListed; ++i) {
+    const AssetLoad &load = _report.Loads[_report.Slowest[i]];
+    fprintf(f, "    {\"type\": \"%s\", \"name\": \"%s\", \"ms\": %.3f}%s\n",
+            assetTypeLabels[load.Type], escapeJSON(load.Name).c_str(),
+            getAssetLoadMs(load), i + 1 < numListed ? "," : "");
+  }
+  fprintf(f, "  ],\n");
+
+  fprintf(f, "  \"loads\": [\n");
+  for (size_t i = 0; i < _report.Loads.size(); ++i) {
+    const AssetLoad &load = _report.Loads[i];
+    fprintf(f,
+            "    {\"type\": \"%s\", \"name\": \"%s\", \"bytes_read\": %llu, "
+            "\"decoded_bytes\": %llu, \"ms\": %.3f",
+            assetTypeLabels[load.Type], escapeJSON(load.Name).c_str(),
+            (unsigned long long)load.NumBytesRead,
+            (unsigned long long)load.NumDecodedBytes, getAssetLoadMs(load));
+    for (AssetLoadStage stage : AllEnums<AssetLoadStage>) {
+      fprintf(f, ", \"%s_ms\": %.3f", assetLoadStageLabels[stage],
+              load.StageMs[stage]);
+    }
+    fprintf(f, ", \"thread\": %u, \"queue\": %d}%s\n", load.Thread,
+            load.Queue, i + 1 < _report.Loads.size() ? "," : "");
+  }
+  fprintf(f, "  ]\n");
+  fprintf(f, "}\n");
+
+  bool isWritten = ferror(f) == 0;
+  fclose(f);
+  return isWritten;
+}
+
+} // namespace bb
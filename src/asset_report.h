@@ -0,0 +1,94 @@
+#pragma once
+#include "enum_array.h"
+#include "util.h"
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace bb {
+
+// Per asset load telemetry. Every texture, mesh, shader and pipeline load
+// records the bytes it read and decoded, where its time went, and the thread
+// and queue it used. Loads are collected until they're taken into a report,
+// so that a report covers one phase, such as startup or a scene load.
+//
+// Reports are written as JSON with one line per load, sorted by type and
+// name, so that reports of two builds can be diffed line by line.
+
+enum class AssetType { Texture, Mesh, Shader, Pipeline, COUNT };
+
+enum class AssetLoadStage {
+  // File I/O.
+  Read,
+  // Parsing, image decoding, compression and decompression on the CPU.
+  Decode,
+  // Copies into staging memory.
+  Stage,
+  // Vulkan objects, and the memory bound to them.
+  Create,
+  // Recording, submitting and waiting for the GPU.
+  Submit,
+  COUNT
+};
+
+struct AssetLoad {
+  AssetType Type;
+  // Relative to the resource roots where possible, so that it's the same on
+  // every machine.
+  std::string Name;
+  uint64_t NumBytesRead;
+  uint64_t NumDecodedBytes;
+  EnumArray<AssetLoadStage, float> StageMs;
+  // Numbered in the order threads first load an asset, the one that called
+  // initAssetLoadReport() being 0.
+  uint32_t Thread;
+  // Family of the queue submitted to, -1 if none.
+  int Queue;
+
+  Time LastMarkTime;
+};
+
+// Call from the main thread before anything is loaded.
+void initAssetLoadReport();
+
+AssetLoad beginAssetLoad(AssetType _type, std::string_view _name);
+// Adds the time since the previous mark, or since beginAssetLoad(), to
+// _stage. A stage may be marked several times.
+void markAssetLoadStage(AssetLoad &_load, AssetLoadStage _stage);
+// Leaves the time since the previous mark out, for loads that wait between
+// stages, such as textures finalized one after another.
+void skipAssetLoadTime(AssetLoad &_load);
+// Collects _load for the next report. Thread safe.
+void endAssetLoad(AssetLoad &_load);
+
+float getAssetLoadMs(const AssetLoad &_load);
+
+struct AssetTypeTotals {
+  uint32_t NumLoads;
+  uint64_t NumBytesRead;
+  uint64_t NumDecodedBytes;
+  float Ms;
+};
+
+struct AssetLoadReport {
+  std::string Label;
+  // Sorted by type and name.
+  std::vector<AssetLoad> Loads;
+  // Indices into Loads, slowest first.
+  std::vector<uint32_t> Slowest;
+  EnumArray<AssetType, AssetTypeTotals> TypeTotals;
+  EnumArray<AssetLoadStage, float> StageMs;
+  float Ms;
+};
+
+// Takes every load collected since the previous report.
+AssetLoadReport takeAssetLoadReport(std::string_view _label);
+bool writeAssetLoadReport(const AssetLoadReport &_report,
+                          const std::string &_filePath);
+
+inline const EnumArray<AssetType, const char *> assetTypeLabels = {
+    "texture", "mesh", "shader", "pipeline"};
+inline const EnumArray<AssetLoadStage, const char *> assetLoadStageLabels = {
+    "read", "decode", "stage", "create", "submit"};
+
+} // namespace bb
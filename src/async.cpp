@@ -0,0 +1,157 @@
+#include "async.h"
+#include "asset_report.h"
+#include "util.h"
+#include <string.h>
+
+namespace bb {
+
+void initAsyncContext(AsyncContext &_async, const Renderer &_renderer,
+                      JobSystem &_jobSystem) {
+  _async.JobSystem = &_jobSystem;
+  _async.Renderer = &_renderer;
+
+  VkCommandPoolCreateInfo cmdPoolInfo = {};
+  cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  cmdPoolInfo.queueFamilyIndex = _renderer.QueueFamilyIndex;
+  BB_VK_ASSERT(vkCreateCommandPool(_renderer.Device, &cmdPoolInfo, nullptr,
+                                   &_async.CmdPool));
+}
+
+void destroyAsyncContext(AsyncContext &_async) {
+  while (runPendingAsyncWork(_async) ||
+         _async.Counter.NumPendingJobs.load(std::memory_order_acquire) > 0) {
+    std::this_thread::yield();
+  }
+  BB_ASSERT(_async.PendingSubmits.empty());
+  vkDestroyCommandPool(_async.Renderer->Device, _async.CmdPool, nullptr);
+  _async.CmdPool = VK_NULL_HANDLE;
+}
+
+static void resumeAsJob(AsyncContext &_async,
+                        std::coroutine_handle<> _waiter) {
+  runJob(*_async.JobSystem, _async.Counter, [_waiter]() { _waiter.resume(); });
+}
+
+bool runPendingAsyncWork(AsyncContext &_async) {
+  const Renderer &renderer = *_async.Renderer;
+  std::vector<std::coroutine_handle<>> waiters;
+  bool hasPendingSubmits;
+  {
+    std::lock_guard<std::mutex> lock(_async.SubmitMutex);
+    std::vector<AsyncContext::PendingSubmit> &submits = _async.PendingSubmits;
+    for (size_t i = 0; i < submits.size();) {
+      AsyncContext::PendingSubmit &submit = submits[i];
+      if (vkGetFenceStatus(renderer.Device, submit.Fence) != VK_SUCCESS) {
+        ++i;
+        continue;
+      }
+      vkDestroyFence(renderer.Device, submit.Fence, nullptr);
+      vkFreeCommandBuffers(renderer.Device, _async.CmdPool, 1,
+                           &submit.CmdBuffer);
+      waiters.push_back(submit.Waiter);
+      submit = submits.back();
+      submits.pop_back();
+    }
+    hasPendingSubmits = !submits.empty();
+  }
+
+  for (std::coroutine_handle<> waiter : waiters) {
+    resumeAsJob(_async, waiter);
+  }
+  return tryRunJob(*_async.JobSystem) || !waiters.empty() ||
+         hasPendingSubmits;
+}
+
+void WorkerAwaiter::await_suspend(std::coroutine_handle<> _waiter) {
+  resumeAsJob(*Async, _waiter);
+}
+
+void SubmitAwaiter::await_suspend(std::coroutine_handle<> _waiter) {
+  const Renderer &renderer = *Async->Renderer;
+  std::lock_guard<std::mutex> lock(Async->SubmitMutex);
+
+  VkCommandBufferAllocateInfo cmdBufferAllocInfo = {};
+  cmdBufferAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  cmdBufferAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  cmdBufferAllocInfo.commandPool = Async->CmdPool;
+  cmdBufferAllocInfo.commandBufferCount = 1;
+  VkCommandBuffer cmdBuffer;
+  BB_VK_ASSERT(vkAllocateCommandBuffers(renderer.Device, &cmdBufferAllocInfo,
+                                        &cmdBuffer));
+
+  VkCommandBufferBeginInfo cmdBeginInfo = {};
+  cmdBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  cmdBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  BB_VK_ASSERT(vkBeginCommandBuffer(cmdBuffer, &cmdBeginInfo));
+  Record(cmdBuffer);
+  BB_VK_ASSERT(vkEndCommandBuffer(cmdBuffer));
+
+  VkFenceCreateInfo fenceInfo = {};
+  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  VkFence fence;
+  BB_VK_ASSERT(vkCreateFence(renderer.Device, &fenceInfo, nullptr, &fence));
+
+  VkSubmitInfo submitInfo = {};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &cmdBuffer;
+  BB_VK_ASSERT(vkQueueSubmit(renderer.Queue, 1, &submitInfo, fence));
+
+  Async->PendingSubmits.push_back({fence, cmdBuffer, _waiter});
+}
+
+Task<Model> importModelAsync(AsyncContext &_async, std::string _filePath) {
+  co_await resumeOnWorker(_async);
+  co_return importModel(*_async.JobSystem, _filePath);
+}
+
+Task<GeometryAllocation> uploadGeometryAsync(AsyncContext &_async,
+                                             GeometryPool &_pool,
+                                             std::vector<Vertex> _vertices,
+                                             std::vector<uint32_t> _indices,
+                                             std::string _name) {
+  co_await resumeOnWorker(_async);
+  const Renderer &renderer = *_async.Renderer;
+  AssetLoad load = beginAssetLoad(AssetType::Mesh, _name);
+  GeometryStaging staging =
+      stageGeometry(renderer, _pool.Layout, _vertices, _indices);
+  load.NumDecodedBytes = getGeometryStagingSize(staging);
+  markAssetLoadStage(load, AssetLoadStage::Stage);
+
+  GeometryAllocation allocation = {};
+  co_await submitAsync(_async, [&](VkCommandBuffer _cmd) {
+    allocation = recordGeometryUpload(_cmd, _pool, staging);
+  });
+  // Includes waiting for the queue and for a worker to resume on.
+  load.Queue = (int)renderer.QueueFamilyIndex;
+  markAssetLoadStage(load, AssetLoadStage::Submit);
+  endAssetLoad(load);
+  destroyGeometryStaging(renderer, staging);
+  co_return allocation;
+}
+
+Task<> uploadBufferAsync(AsyncContext &_async, Buffer _dst,
+                         VkDeviceSize _dstOffset, std::vector<uint8_t> _data) {
+  co_await resumeOnWorker(_async);
+  const Renderer &renderer = *_async.Renderer;
+  VkDeviceSize size = _data.size();
+  Buffer stagingBuffer =
+      createBuffer(renderer, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                       VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  void *dst;
+  vkMapMemory(renderer.Device, stagingBuffer.Memory, 0, size, 0, &dst);
+  memcpy(dst, _data.data(), size);
+  vkUnmapMemory(renderer.Device, stagingBuffer.Memory);
+
+  co_await submitAsync(_async, [&](VkCommandBuffer _cmd) {
+    VkBufferCopy region = {};
+    region.dstOffset = _dstOffset;
+    region.size = size;
+    vkCmdCopyBuffer(_cmd, stagingBuffer.Handle, _dst.Handle, 1, &region);
+  });
+  destroyBuffer(renderer, stagingBuffer);
+}
+
+} // namespace bb
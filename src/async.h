@@ -0,0 +1,199 @@
+#pragma once
+#include "render.h"
+#include "job.h"
+#include "geometry_pool.h"
+#include "model.h"
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace bb {
+
+// Coroutines that load and upload assets without blocking threads. A Task
+// starts running as soon as it's called, so that
+//
+//   Task<Model> model = importModelAsync(async, path);
+//   Task<GeometryAllocation> plane = uploadGeometryAsync(async, ...);
+//   Model shaderBall = co_await model;
+//
+// imports and uploads at once. A coroutine suspends on co_await until what
+// it waits for is done, and resumes as a job on any worker thread: CPU work
+// runs after resumeOnWorker(), GPU work is awaited through submitAsync().
+// Threads outside the job system wait with syncWait().
+
+struct AsyncContext {
+  JobSystem *JobSystem;
+  const Renderer *Renderer;
+
+  // Guards CmdPool and the renderer's queue, which every submitAsync()
+  // records into and submits to, and whatever its recording touches.
+  std::mutex SubmitMutex;
+  VkCommandPool CmdPool;
+  struct PendingSubmit {
+    VkFence Fence;
+    VkCommandBuffer CmdBuffer;
+    std::coroutine_handle<> Waiter;
+  };
+  std::vector<PendingSubmit> PendingSubmits;
+
+  // Counts coroutines queued to resume.
+  JobCounter Counter;
+};
+
+void initAsyncContext(AsyncContext &_async, const Renderer &_renderer,
+                      JobSystem &_jobSystem);
+// Waits for every submission, so that nothing is left to resume.
+void destroyAsyncContext(AsyncContext &_async);
+
+// Resumes coroutines whose submissions are done and runs one queued job.
+// Returns false if there was nothing to do.
+bool runPendingAsyncWork(AsyncContext &_async);
+
+// The awaiter of a Task once it's done.
+inline char taskDoneMarker;
+
+struct TaskPromiseBase {
+  // Null while running, the waiting coroutine once one awaits the task, or
+  // &taskDoneMarker once finished.
+  std::atomic<void *> State{nullptr};
+
+  struct FinalAwaiter {
+    bool await_ready() noexcept { return false; }
+    template <typename Promise>
+    std::coroutine_handle<>
+    await_suspend(std::coroutine_handle<Promise> _handle) noexcept {
+      void *waiter = _handle.promise().State.exchange(
+          &taskDoneMarker, std::memory_order_acq_rel);
+      if (waiter) {
+        return std::coroutine_handle<>::from_address(waiter);
+      }
+      return std::noop_coroutine();
+    }
+    void await_resume() noexcept {}
+  };
+
+  std::suspend_never initial_suspend() noexcept { return {}; }
+  FinalAwaiter final_suspend() noexcept { return {}; }
+  void unhandled_exception() { std::terminate(); }
+};
+
+template <typename T> struct Task;
+
+template <typename T> struct TaskPromise : TaskPromiseBase {
+  std::optional<T> Value;
+
+  Task<T> get_return_object();
+  void return_value(T _value) { Value.emplace(std::move(_value)); }
+};
+
+template <> struct TaskPromise<void> : TaskPromiseBase {
+  Task<void> get_return_object();
+  void return_void() {}
+};
+
+// Awaited once, by one coroutine or syncWait(). Must be done by the time
+// it's destroyed.
+template <typename T = void> struct Task {
+  using promise_type = TaskPromise<T>;
+  std::coroutine_handle<promise_type> Handle;
+
+  explicit Task(std::coroutine_handle<promise_type> _handle)
+      : Handle(_handle) {}
+  Task(Task &&_other) : Handle(_other.Handle) { _other.Handle = nullptr; }
+  ~Task() {
+    if (Handle) {
+      BB_ASSERT(isDone());
+      Handle.destroy();
+    }
+  }
+  Task(const Task &) = delete;
+  Task &operator=(const Task &) = delete;
+  Task &operator=(Task &&) = delete;
+
+  bool isDone() const {
+    return Handle.promise().State.load(std::memory_order_acquire) ==
+           &taskDoneMarker;
+  }
+
+  bool await_ready() const { return isDone(); }
+  // Doesn't suspend if the task finished in the meantime.
+  bool await_suspend(std::coroutine_handle<> _waiter) {
+    void *running = nullptr;
+    return Handle.promise().State.compare_exchange_strong(
+        running, _waiter.address(), std::memory_order_acq_rel);
+  }
+  T await_resume() {
+    if constexpr (!std::is_void_v<T>) {
+      return std::move(*Handle.promise().Value);
+    }
+  }
+};
+
+template <typename T> Task<T> TaskPromise<T>::get_return_object() {
+  return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() {
+  return Task<void>(
+      std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+// Helps with pending async work until _task is done.
+template <typename T> T syncWait(AsyncContext &_async, Task<T> &&_task) {
+  while (!_task.isDone()) {
+    if (!runPendingAsyncWork(_async)) {
+      std::this_thread::yield();
+    }
+  }
+  return _task.await_resume();
+}
+
+struct WorkerAwaiter {
+  AsyncContext *Async;
+
+  bool await_ready() const { return false; }
+  void await_suspend(std::coroutine_handle<> _waiter);
+  void await_resume() const {}
+};
+
+// Continues the awaiting coroutine as a job, off the thread that called it.
+inline WorkerAwaiter resumeOnWorker(AsyncContext &_async) {
+  return {&_async};
+}
+
+struct SubmitAwaiter {
+  AsyncContext *Async;
+  std::function<void(VkCommandBuffer)> Record;
+
+  bool await_ready() const { return false; }
+  void await_suspend(std::coroutine_handle<> _waiter);
+  void await_resume() const {}
+};
+
+// Records through _record and submits, resuming the awaiting coroutine once
+// the GPU is done with it. _record runs under AsyncContext::SubmitMutex.
+inline SubmitAwaiter submitAsync(AsyncContext &_async,
+                                 std::function<void(VkCommandBuffer)> _record) {
+  return {&_async, std::move(_record)};
+}
+
+// Parameters are taken by value, as they have to outlive the caller's
+// arguments once the coroutine suspends.
+Task<Model> importModelAsync(AsyncContext &_async, std::string _filePath);
+// Allocates from _pool under AsyncContext::SubmitMutex, so _pool must not
+// be allocated from elsewhere meanwhile. The upload is reported as _name.
+Task<GeometryAllocation> uploadGeometryAsync(AsyncContext &_async,
+                                             GeometryPool &_pool,
+                                             std::vector<Vertex> _vertices,
+                                             std::vector<uint32_t> _indices,
+                                             std::string _name);
+// Copies _data to _dst at _dstOffset through a staging buffer.
+Task<> uploadBufferAsync(AsyncContext &_async, Buffer _dst,
+                         VkDeviceSize _dstOffset, std::vector<uint8_t> _data);
+
+} // namespace bb
@@ -0,0 +1,278 @@
+#include "block_codec.h"
+#include "asset_report.h"
+#include "util.h"
+#include <algorithm>
+#include <string.h>
+
+namespace bb {
+
+constexpr uint32_t blockCodecNumLanes = 4;
+constexpr uint32_t blockCodecHeaderSize = 2;
+// Dispatches wrap into rows to stay under maxComputeWorkGroupCount, which is
+// at least this much in every dimension.
+constexpr uint32_t maxNumDecompressionGroupsX = 65535;
+
+static uint8_t zigzag(uint8_t _delta) {
+  int8_t signedDelta = (int8_t)_delta;
+  return (uint8_t)((uint8_t)(_delta << 1) ^ (uint8_t)(signedDelta >> 7));
+}
+
+static uint8_t unzigzag(uint32_t _residual) {
+  return (uint8_t)((_residual >> 1) ^ (0u - (_residual & 1u)));
+}
+
+static uint32_t getBitWidth(uint32_t _value) {
+  uint32_t width = 0;
+  while (width < 32 && (_value >> width) != 0) {
+    ++width;
+  }
+  return width;
+}
+
+static uint32_t getLaneWidth(uint32_t _widths, uint32_t _lane) {
+  return (_widths >> (_lane * 4)) & 0xf;
+}
+
+static uint32_t getNumWords(uint32_t _numBytes) {
+  return (_numBytes + 3) / 4;
+}
+
+static uint32_t getNumBlocks(uint32_t _numBytes) {
+  return (getNumWords(_numBytes) + blockCodecBlockSize - 1) /
+         blockCodecBlockSize;
+}
+
+std::vector<uint32_t> compressBlocks(const void *_data, size_t _numBytes) {
+  BB_ASSERT(_numBytes <= UINT32_MAX);
+  uint32_t numBytes = (uint32_t)_numBytes;
+  uint32_t numWords = getNumWords(numBytes);
+  uint32_t numBlocks = getNumBlocks(numBytes);
+
+  std::vector<uint32_t> words(numWords, 0);
+  memcpy(words.data(), _data, _numBytes);
+
+  std::vector<uint32_t> compressed(blockCodecHeaderSize + numBlocks, 0);
+  compressed[0] = numBytes;
+  compressed[1] = numBlocks;
+
+  uint8_t residuals[blockCodecNumLanes][blockCodecBlockSize];
+  for (uint32_t b = 0; b < numBlocks; ++b) {
+    compressed[blockCodecHeaderSize + b] = (uint32_t)compressed.size();
+
+    uint32_t prev = 0;
+    uint32_t maxResiduals[blockCodecNumLanes] = {};
+    for (uint32_t i = 0; i < blockCodecBlockSize; ++i) {
+      uint32_t w = b * blockCodecBlockSize + i;
+      // Past the end the last word repeats, which costs no bits.
+      uint32_t word = w < numWords ? words[w] : prev;
+      for (uint32_t lane = 0; lane < blockCodecNumLanes; ++lane) {
+        uint8_t delta =
+            (uint8_t)((word >> (lane * 8)) - (prev >> (lane * 8)));
+        residuals[lane][i] = zigzag(delta);
+        maxResiduals[lane] =
+            std::max(maxResiduals[lane], (uint32_t)residuals[lane][i]);
+      }
+      prev = word;
+    }
+
+    uint32_t widths = 0;
+    for (uint32_t lane = 0; lane < blockCodecNumLanes; ++lane) {
+      widths |= getBitWidth(maxResiduals[lane]) << (lane * 4);
+    }
+    compressed.push_back(widths);
+
+    for (uint32_t lane = 0; lane < blockCodecNumLanes; ++lane) {
+      uint32_t width = getLaneWidth(widths, lane);
+      size_t laneStart = compressed.size();
+      compressed.resize(laneStart + blockCodecBlockSize * width / 32, 0);
+      for (uint32_t i = 0; i < blockCodecBlockSize && width > 0; ++i) {
+        uint32_t bit = i * width;
+        uint32_t shift = bit % 32;
+        uint32_t value = residuals[lane][i];
+        compressed[laneStart + bit / 32] |= value << shift;
+        if (shift + width > 32) {
+          compressed[laneStart + bit / 32 + 1] |= value >> (32 - shift);
+        }
+      }
+    }
+  }
+
+  return compressed;
+}
+
+uint32_t getDecompressedSize(const std::vector<uint32_t> &_compressed) {
+  return _compressed.empty() ? 0 : _compressed[0];
+}
+
+uint32_t getNumCompressedBlocks(const std::vector<uint32_t> &_compressed) {
+  return _compressed.size() < blockCodecHeaderSize ? 0 : _compressed[1];
+}
+
+bool isValidCompressedPayload(const std::vector<uint32_t> &_compressed) {
+  if (_compressed.size() < blockCodecHeaderSize) {
+    return false;
+  }
+  uint32_t numBlocks = _compressed[1];
+  if (numBlocks != getNumBlocks(_compressed[0]) ||
+      _compressed.size() < blockCodecHeaderSize + (size_t)numBlocks) {
+    return false;
+  }
+  for (uint32_t b = 0; b < numBlocks; ++b) {
+    size_t offset = _compressed[blockCodecHeaderSize + b];
+    if (offset >= _compressed.size()) {
+      return false;
+    }
+    uint32_t widths = _compressed[offset];
+    size_t blockSize = 1;
+    for (uint32_t lane = 0; lane < blockCodecNumLanes; ++lane) {
+      uint32_t width = getLaneWidth(widths, lane);
+      if (width > 8) {
+        return false;
+      }
+      blockSize += blockCodecBlockSize * width / 32;
+    }
+    if (offset + blockSize > _compressed.size()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void decompressBlocks(const std::vector<uint32_t> &_compressed, void *_dst) {
+  BB_ASSERT(isValidCompressedPayload(_compressed));
+  uint32_t numBytes = _compressed[0];
+  uint32_t numBlocks = _compressed[1];
+  uint8_t *dst = (uint8_t *)_dst;
+
+  uint32_t words[blockCodecBlockSize];
+  for (uint32_t b = 0; b < numBlocks; ++b) {
+    size_t laneStart = _compressed[blockCodecHeaderSize + b];
+    uint32_t widths = _compressed[laneStart++];
+
+    memset(words, 0, sizeof(words));
+    for (uint32_t lane = 0; lane < blockCodecNumLanes; ++lane) {
+      uint32_t width = getLaneWidth(widths, lane);
+      if (width == 0) {
+        continue;
+      }
+      uint32_t mask = (1u << width) - 1;
+      uint8_t sum = 0;
+      for (uint32_t i = 0; i < blockCodecBlockSize; ++i) {
+        uint32_t bit = i * width;
+        uint32_t shift = bit % 32;
+        uint32_t value = _compressed[laneStart + bit / 32] >> shift;
+        if (shift + width > 32) {
+          value |= _compressed[laneStart + bit / 32 + 1] << (32 - shift);
+        }
+        sum += unzigzag(value & mask);
+        words[i] |= (uint32_t)sum << (lane * 8);
+      }
+      laneStart += blockCodecBlockSize * width / 32;
+    }
+
+    uint32_t blockOffset = b * blockCodecBlockSize * 4;
+    uint32_t blockBytes =
+        std::min(numBytes - blockOffset, (uint32_t)sizeof(words));
+    memcpy(dst + blockOffset, words, blockBytes);
+  }
+}
+
+BlockDecompressor createBlockDecompressor(const Renderer &_renderer) {
+  BlockDecompressor decompressor = {};
+  decompressor.ComputeShader =
+      createShaderFromFile(_renderer, "block_decode.comp.spv");
+
+  // Compressed payload, decompressed words
+  VkDescriptorSetLayoutBinding bindings[2] = {};
+  for (uint32_t i = 0; i < std::size(bindings); ++i) {
+    bindings[i].binding = i;
+    bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[i].descriptorCount = 1;
+    bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    decompressor.SetLayout.Bindings[i] = {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                          1, false};
+  }
+  decompressor.SetLayout.NumBindings = (uint32_t)std::size(bindings);
+  VkDescriptorSetLayoutCreateInfo setLayoutInfo = {};
+  setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  setLayoutInfo.bindingCount = (uint32_t)std::size(bindings);
+  setLayoutInfo.pBindings = bindings;
+  BB_VK_ASSERT(vkCreateDescriptorSetLayout(_renderer.Device, &setLayoutInfo,
+                                           nullptr,
+                                           &decompressor.SetLayout.Handle));
+  createDescriptorUpdateTemplate(_renderer, decompressor.SetLayout);
+
+  VkPipelineLayoutCreateInfo layoutInfo = {};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  layoutInfo.setLayoutCount = 1;
+  layoutInfo.pSetLayouts = &decompressor.SetLayout.Handle;
+  BB_VK_ASSERT(vkCreatePipelineLayout(_renderer.Device, &layoutInfo, nullptr,
+                                      &decompressor.PipelineLayout));
+
+  const Shader *shader = &decompressor.ComputeShader;
+  AssetLoad load = beginAssetLoad(AssetType::Pipeline,
+                                  getPipelineAssetName(&shader, 1));
+  VkComputePipelineCreateInfo pipelineInfo = {};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage = decompressor.ComputeShader.getStageInfo();
+  pipelineInfo.layout = decompressor.PipelineLayout;
+  BB_VK_ASSERT(vkCreateComputePipelines(_renderer.Device, VK_NULL_HANDLE, 1,
+                                        &pipelineInfo, nullptr,
+                                        &decompressor.Pipeline));
+  markAssetLoadStage(load, AssetLoadStage::Create);
+  endAssetLoad(load);
+
+  return decompressor;
+}
+
+void destroyBlockDecompressor(const Renderer &_renderer,
+                              BlockDecompressor &_decompressor) {
+  vkDestroyPipeline(_renderer.Device, _decompressor.Pipeline, nullptr);
+  vkDestroyPipelineLayout(_renderer.Device, _decompressor.PipelineLayout,
+                          nullptr);
+  destroyDescriptorSetLayout(_renderer, _decompressor.SetLayout);
+  destroyShader(_renderer, _decompressor.ComputeShader);
+  _decompressor = {};
+}
+
+void recordBlockDecompression(const Renderer &_renderer, VkCommandBuffer _cmd,
+                              const BlockDecompressor &_decompressor,
+                              DescriptorAllocator &_descriptorAllocator,
+                              const Buffer &_src, const Buffer &_dst,
+                              uint32_t _numBlocks) {
+  VkDescriptorSet descriptorSet = allocateDescriptorSet(
+      _renderer, _descriptorAllocator, _decompressor.SetLayout);
+
+  // Compressed payload, decompressed words
+  VkDescriptorBufferInfo bufferInfos[2] = {};
+  bufferInfos[0].buffer = _src.Handle;
+  bufferInfos[0].range = VK_WHOLE_SIZE;
+  bufferInfos[1].buffer = _dst.Handle;
+  bufferInfos[1].range = VK_WHOLE_SIZE;
+  updateDescriptorSet(_renderer, _decompressor.SetLayout, descriptorSet,
+                      bufferInfos);
+
+  vkCmdBindPipeline(_cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    _decompressor.Pipeline);
+  vkCmdBindDescriptorSets(_cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          _decompressor.PipelineLayout, 0, 1, &descriptorSet,
+                          0, nullptr);
+  uint32_t numGroupsX = std::min(_numBlocks, maxNumDecompressionGroupsX);
+  uint32_t numGroupsY = (_numBlocks + maxNumDecompressionGroupsX - 1) /
+                        maxNumDecompressionGroupsX;
+  vkCmdDispatch(_cmd, numGroupsX, numGroupsY, 1);
+
+  VkBufferMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.buffer = _dst.Handle;
+  barrier.size = VK_WHOLE_SIZE;
+  vkCmdPipelineBarrier(_cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1,
+                       &barrier, 0, nullptr);
+}
+
+} // namespace bb
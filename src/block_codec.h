@@ -0,0 +1,58 @@
+#pragma once
+#include "render.h"
+#include "descriptor_allocator.h"
+#include <vector>
+
+namespace bb {
+
+// A codec for cooked payloads that decodes on the GPU as readily as on the
+// CPU: payloads are split into blocks of blockCodecBlockSize 32-bit words
+// that decode independently, one compute workgroup each. Within a block,
+// each byte lane (byte 0 to 3 of every word) is delta coded against the
+// previous word, zigzagged and bit packed at the width of the lane's widest
+// residual. Suits RGBA8 texels and other data of 4-byte elements whose
+// neighbours are alike.
+//
+// Compressed payloads are words:
+//   NumBytes, NumBlocks, BlockOffsets[NumBlocks], blocks...
+// with the offsets in words from the start of the payload. A block starts
+// with the bit widths of its lanes, 4 bits each, followed by the packed
+// residuals of each lane in turn, 2 words per bit of width.
+
+constexpr uint32_t blockCodecBlockSize = 64;
+
+std::vector<uint32_t> compressBlocks(const void *_data, size_t _numBytes);
+
+uint32_t getDecompressedSize(const std::vector<uint32_t> &_compressed);
+uint32_t getNumCompressedBlocks(const std::vector<uint32_t> &_compressed);
+// Whether the offsets and widths stay inside _compressed, so that it can be
+// decompressed on either side.
+bool isValidCompressedPayload(const std::vector<uint32_t> &_compressed);
+
+// Writes getDecompressedSize() bytes to _dst.
+void decompressBlocks(const std::vector<uint32_t> &_compressed, void *_dst);
+
+struct BlockDecompressor {
+  Shader ComputeShader;
+  // Compressed payload, decompressed words.
+  DescriptorSetLayout SetLayout;
+  VkPipelineLayout PipelineLayout;
+  VkPipeline Pipeline;
+};
+
+BlockDecompressor createBlockDecompressor(const Renderer &_renderer);
+void destroyBlockDecompressor(const Renderer &_renderer,
+                              BlockDecompressor &_decompressor);
+
+// Expands the payload at the start of _src into _dst, which must hold
+// getDecompressedSize() rounded up to whole words. Both need
+// VK_BUFFER_USAGE_STORAGE_BUFFER_BIT. _dst is ready for transfer reads once
+// the recorded commands are done. Each decompression records with a
+// descriptor set of its own, from _descriptorAllocator.
+void recordBlockDecompression(const Renderer &_renderer, VkCommandBuffer _cmd,
+                              const BlockDecompressor &_decompressor,
+                              DescriptorAllocator &_descriptorAllocator,
+                              const Buffer &_src, const Buffer &_dst,
+                              uint32_t _numBlocks);
+
+} // namespace bb
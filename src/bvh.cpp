@@ -0,0 +1,428 @@
+#include "bvh.h"
+#include <algorithm>
+#include <math.h>
+
+namespace bb {
+
+static constexpr int sahNumBins = 16;
+// Subtrees with more items than this are handed to the job system.
+static constexpr uint32_t parallelBuildThreshold = 4096;
+
+float intersectRayAABB(const Ray &_ray, const Float3 &_invDir,
+                       const AABB &_bounds) {
+  float tx0 = (_bounds.Min.X - _ray.Origin.X) * _invDir.X;
+  float tx1 = (_bounds.Max.X - _ray.Origin.X) * _invDir.X;
+  float ty0 = (_bounds.Min.Y - _ray.Origin.Y) * _invDir.Y;
+  float ty1 = (_bounds.Max.Y - _ray.Origin.Y) * _invDir.Y;
+  float tz0 = (_bounds.Min.Z - _ray.Origin.Z) * _invDir.Z;
+  float tz1 = (_bounds.Max.Z - _ray.Origin.Z) * _invDir.Z;
+
+  float tMin = std::max(std::max(std::min(tx0, tx1), std::min(ty0, ty1)),
+                        std::max(std::min(tz0, tz1), 0.f));
+  float tMax = std::min(std::min(std::max(tx0, tx1), std::max(ty0, ty1)),
+                        std::min(std::max(tz0, tz1), _ray.MaxT));
+  return tMin <= tMax ? tMin : FLT_MAX;
+}
+
+float intersectRayTriangle(const Ray &_ray, const Float3 &_v0,
+                           const Float3 &_v1, const Float3 &_v2) {
+  Float3 edge1 = _v1 - _v0;
+  Float3 edge2 = _v2 - _v0;
+  Float3 p = cross(_ray.Dir, edge2);
+  float det = dot(edge1, p);
+  if (fabsf(det) < 1e-12f) {
+    return FLT_MAX;
+  }
+
+  float invDet = 1.f / det;
+  Float3 s = _ray.Origin - _v0;
+  float u = dot(s, p) * invDet;
+  if (u < 0.f || u > 1.f) {
+    return FLT_MAX;
+  }
+  Float3 q = cross(s, edge1);
+  float v = dot(_ray.Dir, q) * invDet;
+  if (v < 0.f || u + v > 1.f) {
+    return FLT_MAX;
+  }
+  float t = dot(edge2, q) * invDet;
+  return t >= 0.f && t < _ray.MaxT ? t : FLT_MAX;
+}
+
+static float getSurfaceArea(const AABB &_bounds) {
+  if (!_bounds.isValid()) {
+    return 0.f;
+  }
+  Float3 size = _bounds.Max - _bounds.Min;
+  return 2.f * (size.X * size.Y + size.Y * size.Z + size.Z * size.X);
+}
+
+static float getAxis(const Float3 &_v, int _axis) {
+  return _axis == 0 ? _v.X : (_axis == 1 ? _v.Y : _v.Z);
+}
+
+namespace {
+
+struct BVHBuilder {
+  JobSystem *Jobs;
+  const std::vector<AABB> *ItemBounds;
+  std::vector<Float3> Centroids;
+  uint32_t MaxLeafSize;
+  uint32_t MaxDepth;
+  BVH *Result;
+  std::atomic<uint32_t> NumNodes{1};
+};
+
+} // namespace
+
+static void buildNode(BVHBuilder &_builder, uint32_t _nodeIndex,
+                      uint32_t _depth, uint32_t _begin, uint32_t _end) {
+  BVH &bvh = *_builder.Result;
+  uint32_t *items = bvh.Items.data();
+  uint32_t numItems = _end - _begin;
+
+  AABB bounds;
+  AABB centroidBounds;
+  for (uint32_t i = _begin; i < _end; ++i) {
+    bounds.extend((*_builder.ItemBounds)[items[i]]);
+    centroidBounds.extend(_builder.Centroids[items[i]]);
+  }
+
+  BVHNode &node = bvh.Nodes[_nodeIndex];
+  node.Bounds = bounds;
+  node.First = _begin;
+  node.NumItems = numItems;
+  if (numItems <= _builder.MaxLeafSize || _depth == _builder.MaxDepth) {
+    return;
+  }
+
+  int bestAxis = -1;
+  int bestSplit = 0;
+  float bestCost = FLT_MAX;
+  for (int axis = 0; axis < 3; ++axis) {
+    float axisMin = getAxis(centroidBounds.Min, axis);
+    float axisExtent = getAxis(centroidBounds.Max, axis) - axisMin;
+    if (!(axisExtent > 0.f)) {
+      continue;
+    }
+
+    AABB binBounds[sahNumBins];
+    uint32_t binCounts[sahNumBins] = {};
+    float binScale = sahNumBins / axisExtent;
+    for (uint32_t i = _begin; i < _end; ++i) {
+      int bin = (int)((getAxis(_builder.Centroids[items[i]], axis) - axisMin) *
+                      binScale);
+      bin = std::min(bin, sahNumBins - 1);
+      ++binCounts[bin];
+      binBounds[bin].extend((*_builder.ItemBounds)[items[i]]);
+    }
+
+    // Sweep from the right to get the cost of everything past each split.
+    float rightCosts[sahNumBins];
+    AABB rightBounds;
+    uint32_t rightCount = 0;
+    for (int bin = sahNumBins - 1; bin > 0; --bin) {
+      rightBounds.extend(binBounds[bin]);
+      rightCount += binCounts[bin];
+      rightCosts[bin] = getSurfaceArea(rightBounds) * rightCount;
+    }
+
+    AABB leftBounds;
+    uint32_t leftCount = 0;
+    for (int split = 1; split < sahNumBins; ++split) {
+      leftBounds.extend(binBounds[split - 1]);
+      leftCount += binCounts[split - 1];
+      float cost = getSurfaceArea(leftBounds) * leftCount + rightCosts[split];
+      if (leftCount > 0 && leftCount < numItems && cost < bestCost) {
+        bestAxis = axis;
+        bestSplit = split;
+        bestCost = cost;
+      }
+    }
+  }
+
+  uint32_t middle;
+  if (bestAxis >= 0) {
+    float axisMin = getAxis(centroidBounds.Min, bestAxis);
+    float binScale =
+        sahNumBins / (getAxis(centroidBounds.Max, bestAxis) - axisMin);
+    const std::vector<Float3> &centroids = _builder.Centroids;
+    auto isLeft = [&](uint32_t _item) {
+      float offset = getAxis(centroids[_item], bestAxis) - axisMin;
+      return std::min((int)(offset * binScale), sahNumBins - 1) < bestSplit;
+    };
+    middle = (uint32_t)(std::partition(items + _begin, items + _end, isLeft) -
+                        items);
+  } else {
+    // Every centroid is in the same spot; split the items evenly.
+    middle = _begin + numItems / 2;
+  }
+  if (middle == _begin || middle == _end) {
+    middle = _begin + numItems / 2;
+  }
+
+  uint32_t firstChild = _builder.NumNodes.fetch_add(2);
+  node.First = firstChild;
+  node.NumItems = 0;
+
+  if (numItems > parallelBuildThreshold) {
+    JobCounter counter;
+    runJob(*_builder.Jobs, counter,
+           [&_builder, firstChild, _depth, _begin, middle]() {
+             buildNode(_builder, firstChild, _depth + 1, _begin, middle);
+           });
+    buildNode(_builder, firstChild + 1, _depth + 1, middle, _end);
+    waitForCounter(*_builder.Jobs, counter);
+  } else {
+    buildNode(_builder, firstChild, _depth + 1, _begin, middle);
+    buildNode(_builder, firstChild + 1, _depth + 1, middle, _end);
+  }
+}
+
+BVH buildBVH(JobSystem &_jobSystem, const std::vector<AABB> &_itemBounds,
+             uint32_t _maxLeafSize, uint32_t _maxDepth) {
+  BB_ASSERT(_maxLeafSize > 0);
+  BB_ASSERT(_maxDepth <= bvhMaxDepth);
+
+  BVH bvh = {};
+  uint32_t numItems = (uint32_t)_itemBounds.size();
+  if (numItems == 0) {
+    return bvh;
+  }
+
+  BVHBuilder builder;
+  builder.Jobs = &_jobSystem;
+  builder.ItemBounds = &_itemBounds;
+  builder.MaxLeafSize = _maxLeafSize;
+  builder.MaxDepth = std::min(_maxDepth, bvhMaxDepth);
+  builder.Result = &bvh;
+  builder.Centroids.resize(numItems);
+  bvh.Items.resize(numItems);
+  for (uint32_t i = 0; i < numItems; ++i) {
+    builder.Centroids[i] = _itemBounds[i].center();
+    bvh.Items[i] = i;
+  }
+
+  // A binary tree whose leaves each hold at least one item can't have more
+  // nodes than this, so the array never has to grow while jobs write to it.
+  bvh.Nodes.resize(2 * numItems - 1);
+  buildNode(builder, 0, 0, 0, numItems);
+  bvh.Nodes.resize(builder.NumNodes.load());
+
+  bvh.Parents.assign(bvh.Nodes.size(), UINT32_MAX);
+  bvh.ItemLeaves.resize(numItems);
+  for (uint32_t n = 0; n < (uint32_t)bvh.Nodes.size(); ++n) {
+    const BVHNode &node = bvh.Nodes[n];
+    if (node.NumItems > 0) {
+      for (uint32_t i = node.First; i < node.First + node.NumItems; ++i) {
+        bvh.ItemLeaves[bvh.Items[i]] = n;
+      }
+    } else {
+      bvh.Parents[node.First] = n;
+      bvh.Parents[node.First + 1] = n;
+    }
+  }
+
+  return bvh;
+}
+
+static void refitNode(BVH &_bvh, uint32_t _nodeIndex,
+                      const std::vector<AABB> &_itemBounds) {
+  BVHNode &node = _bvh.Nodes[_nodeIndex];
+  AABB bounds;
+  if (node.NumItems > 0) {
+    for (uint32_t i = node.First; i < node.First + node.NumItems; ++i) {
+      bounds.extend(_itemBounds[_bvh.Items[i]]);
+    }
+  } else {
+    bounds.extend(_bvh.Nodes[node.First].Bounds);
+    bounds.extend(_bvh.Nodes[node.First + 1].Bounds);
+  }
+  node.Bounds = bounds;
+}
+
+void refitBVH(BVH &_bvh, const std::vector<AABB> &_itemBounds) {
+  for (uint32_t n = (uint32_t)_bvh.Nodes.size(); n-- > 0;) {
+    refitNode(_bvh, n, _itemBounds);
+  }
+}
+
+void updateBVHItem(BVH &_bvh, uint32_t _item,
+                   const std::vector<AABB> &_itemBounds) {
+  for (uint32_t n = _bvh.ItemLeaves[_item]; n != UINT32_MAX;
+       n = _bvh.Parents[n]) {
+    refitNode(_bvh, n, _itemBounds);
+  }
+}
+
+float computeBVHCost(const BVH &_bvh) {
+  if (_bvh.Nodes.empty()) {
+    return 0.f;
+  }
+  float rootArea = getSurfaceArea(_bvh.Nodes[0].Bounds);
+  if (!(rootArea > 0.f)) {
+    return 0.f;
+  }
+
+  float cost = 0.f;
+  for (const BVHNode &node : _bvh.Nodes) {
+    // One box test per inner node, one item test per leaf item.
+    cost += getSurfaceArea(node.Bounds) *
+            (node.NumItems > 0 ? (float)node.NumItems : 1.f);
+  }
+  return cost / rootArea;
+}
+
+static bool isAABBInFrustum(const Frustum &_frustum, const AABB &_bounds) {
+  for (const Float4 &plane : _frustum.Planes) {
+    // The corner furthest along the plane normal.
+    Float3 p = {plane.X >= 0.f ? _bounds.Max.X : _bounds.Min.X,
+                plane.Y >= 0.f ? _bounds.Max.Y : _bounds.Min.Y,
+                plane.Z >= 0.f ? _bounds.Max.Z : _bounds.Min.Z};
+    if (plane.X * p.X + plane.Y * p.Y + plane.Z * p.Z + plane.W < 0.f) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool isAABBInSphere(const AABB &_bounds, const Float3 &_center,
+                           float _radius) {
+  Float3 closest = {std::clamp(_center.X, _bounds.Min.X, _bounds.Max.X),
+                    std::clamp(_center.Y, _bounds.Min.Y, _bounds.Max.Y),
+                    std::clamp(_center.Z, _bounds.Min.Z, _bounds.Max.Z)};
+  Float3 d = closest - _center;
+  return dot(d, d) <= _radius * _radius;
+}
+
+template <typename Fn>
+static void queryBVHNodes(const BVH &_bvh,
+                          const std::vector<AABB> &_itemBounds,
+                          std::vector<uint32_t> &_items, const Fn &_touches) {
+  if (_bvh.Nodes.empty()) {
+    return;
+  }
+
+  uint32_t stack[bvhStackSize];
+  int stackSize = 0;
+  stack[stackSize++] = 0;
+  while (stackSize > 0) {
+    const BVHNode &node = _bvh.Nodes[stack[--stackSize]];
+    if (!_touches(node.Bounds)) {
+      continue;
+    }
+    if (node.NumItems > 0) {
+      for (uint32_t i = node.First; i < node.First + node.NumItems; ++i) {
+        if (_touches(_itemBounds[_bvh.Items[i]])) {
+          _items.push_back(_bvh.Items[i]);
+        }
+      }
+    } else {
+      BB_ASSERT(stackSize + 2 <= (int)std::size(stack));
+      stack[stackSize++] = node.First + 1;
+      stack[stackSize++] = node.First;
+    }
+  }
+}
+
+void queryBVH(const BVH &_bvh, const std::vector<AABB> &_itemBounds,
+              const Frustum &_frustum, std::vector<uint32_t> &_items) {
+  queryBVHNodes(_bvh, _itemBounds, _items, [&_frustum](const AABB &_bounds) {
+    return isAABBInFrustum(_frustum, _bounds);
+  });
+}
+
+void queryBVH(const BVH &_bvh, const std::vector<AABB> &_itemBounds,
+              const Float3 &_center, float _radius,
+              std::vector<uint32_t> &_items) {
+  queryBVHNodes(_bvh, _itemBounds, _items, [&_center, _radius](const AABB &_bounds) {
+    return isAABBInSphere(_bounds, _center, _radius);
+  });
+}
+
+MeshBVH buildMeshBVH(JobSystem &_jobSystem, const Vertex *_vertices,
+                     const uint32_t *_indices, uint32_t _firstIndex,
+                     uint32_t _numIndices) {
+  BB_ASSERT(_numIndices % 3 == 0);
+  uint32_t numTriangles = _numIndices / 3;
+
+  std::vector<AABB> triangleBounds(numTriangles);
+  for (uint32_t t = 0; t < numTriangles; ++t) {
+    const uint32_t *triangle = _indices + _firstIndex + t * 3;
+    for (int k = 0; k < 3; ++k) {
+      triangleBounds[t].extend(_vertices[triangle[k]].Pos);
+    }
+  }
+
+  MeshBVH meshBVH = {};
+  meshBVH.Tree = buildBVH(_jobSystem, triangleBounds);
+
+  meshBVH.Corners.resize(numTriangles * 3);
+  for (uint32_t i = 0; i < numTriangles; ++i) {
+    const uint32_t *triangle =
+        _indices + _firstIndex + meshBVH.Tree.Items[i] * 3;
+    for (int k = 0; k < 3; ++k) {
+      meshBVH.Corners[i * 3 + k] = _vertices[triangle[k]].Pos;
+    }
+  }
+
+  return meshBVH;
+}
+
+RayHit raycastMeshBVH(const MeshBVH &_meshBVH, const Ray &_ray) {
+  // Items are looked up by position in leaf order rather than by triangle
+  // number, which is what the corners are sorted by.
+  const std::vector<uint32_t> &items = _meshBVH.Tree.Items;
+  const Float3 *corners = _meshBVH.Corners.data();
+  RayHit hit = {};
+  Ray ray = _ray;
+
+  const BVH &bvh = _meshBVH.Tree;
+  if (bvh.Nodes.empty()) {
+    return hit;
+  }
+  Float3 invDir = {1.f / ray.Dir.X, 1.f / ray.Dir.Y, 1.f / ray.Dir.Z};
+
+  uint32_t stack[bvhStackSize];
+  int stackSize = 0;
+  stack[stackSize++] = 0;
+  while (stackSize > 0) {
+    const BVHNode &node = bvh.Nodes[stack[--stackSize]];
+    if (intersectRayAABB(ray, invDir, node.Bounds) == FLT_MAX) {
+      continue;
+    }
+    if (node.NumItems > 0) {
+      for (uint32_t i = node.First; i < node.First + node.NumItems; ++i) {
+        const Float3 *triangle = corners + i * 3;
+        float t =
+            intersectRayTriangle(ray, triangle[0], triangle[1], triangle[2]);
+        if (t < ray.MaxT) {
+          ray.MaxT = t;
+          hit.T = t;
+          hit.Item = items[i];
+        }
+      }
+      continue;
+    }
+
+    uint32_t near = node.First;
+    uint32_t far = node.First + 1;
+    float nearT = intersectRayAABB(ray, invDir, bvh.Nodes[near].Bounds);
+    float farT = intersectRayAABB(ray, invDir, bvh.Nodes[far].Bounds);
+    if (farT < nearT) {
+      std::swap(near, far);
+      std::swap(nearT, farT);
+    }
+    BB_ASSERT(stackSize + 2 <= (int)std::size(stack));
+    if (farT != FLT_MAX) {
+      stack[stackSize++] = far;
+    }
+    if (nearT != FLT_MAX) {
+      stack[stackSize++] = near;
+    }
+  }
+
+  return hit;
+}
+
+} // namespace bb
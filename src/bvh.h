@@ -0,0 +1,143 @@
+#pragma once
+#include "vertex.h"
+#include "job.h"
+#include <vector>
+
+namespace bb {
+
+// Dir doesn't have to be normalized; distances are in units of Dir, so a ray
+// moved into another space with an affine transform keeps its distances.
+struct Ray {
+  Float3 Origin;
+  Float3 Dir;
+  float MaxT = FLT_MAX;
+};
+
+struct RayHit {
+  float T = FLT_MAX;
+  uint32_t Item = UINT32_MAX;
+};
+
+// Returns the entry distance of _ray into _bounds, or FLT_MAX on a miss.
+float intersectRayAABB(const Ray &_ray, const Float3 &_invDir,
+                       const AABB &_bounds);
+// Returns the hit distance, or FLT_MAX on a miss. Both sides are hit.
+float intersectRayTriangle(const Ray &_ray, const Float3 &_v0,
+                           const Float3 &_v1, const Float3 &_v2);
+
+struct BVHNode {
+  AABB Bounds;
+  // Leaves hold Items[First, First + NumItems). Inner nodes have NumItems == 0
+  // and their children at First and First + 1.
+  uint32_t First;
+  uint32_t NumItems;
+};
+
+// Bounding volume hierarchy over caller-indexed items. Children always come
+// after their parent in Nodes, which refitting relies on.
+struct BVH {
+  std::vector<BVHNode> Nodes;
+  std::vector<uint32_t> Items;
+  std::vector<uint32_t> Parents;
+  std::vector<uint32_t> ItemLeaves;
+};
+
+constexpr uint32_t bvhMaxLeafSize = 4;
+// Nodes this deep, the root being at depth 0, are leaves whatever their size.
+constexpr uint32_t bvhMaxDepth = 64;
+// Traversal pushes the children of a node together, which leaves at most one
+// pending sibling per level besides the two just pushed.
+constexpr uint32_t bvhStackSize = bvhMaxDepth + 1;
+
+// Top-down build with binned SAH splits. Subtrees above a size threshold are
+// built as separate jobs. Leaves hold up to _maxLeafSize items, more only at
+// _maxDepth, which can't exceed bvhMaxDepth.
+BVH buildBVH(JobSystem &_jobSystem, const std::vector<AABB> &_itemBounds,
+             uint32_t _maxLeafSize = bvhMaxLeafSize,
+             uint32_t _maxDepth = bvhMaxDepth);
+// Recomputes every node's bounds from _itemBounds, keeping the topology.
+void refitBVH(BVH &_bvh, const std::vector<AABB> &_itemBounds);
+// Refits only the nodes above _item's leaf. Much cheaper than refitBVH()
+// when few items moved.
+void updateBVHItem(BVH &_bvh, uint32_t _item,
+                   const std::vector<AABB> &_itemBounds);
+// Expected traversal cost relative to testing the root. Grows as refits
+// make nodes overlap, which tells when a rebuild is due.
+float computeBVHCost(const BVH &_bvh);
+
+// Append every item whose bounds touch the volume. _itemBounds must be what
+// the tree was last built or refitted with.
+void queryBVH(const BVH &_bvh, const std::vector<AABB> &_itemBounds,
+              const Frustum &_frustum, std::vector<uint32_t> &_items);
+void queryBVH(const BVH &_bvh, const std::vector<AABB> &_itemBounds,
+              const Float3 &_center, float _radius,
+              std::vector<uint32_t> &_items);
+
+// Visits the items whose bounds _ray hits, closest bounds first, and keeps
+// the closest hit. _intersectItem(item, ray) returns the hit distance or
+// FLT_MAX; the ray's MaxT shrinks as hits are found.
+template <typename Fn>
+RayHit raycastBVH(const BVH &_bvh, Ray _ray, const Fn &_intersectItem) {
+  RayHit hit = {};
+  if (_bvh.Nodes.empty()) {
+    return hit;
+  }
+
+  Float3 invDir = {1.f / _ray.Dir.X, 1.f / _ray.Dir.Y, 1.f / _ray.Dir.Z};
+  if (intersectRayAABB(_ray, invDir, _bvh.Nodes[0].Bounds) == FLT_MAX) {
+    return hit;
+  }
+
+  uint32_t stack[bvhStackSize];
+  int stackSize = 0;
+  stack[stackSize++] = 0;
+  while (stackSize > 0) {
+    const BVHNode &node = _bvh.Nodes[stack[--stackSize]];
+    if (node.NumItems > 0) {
+      for (uint32_t i = node.First; i < node.First + node.NumItems; ++i) {
+        float t = _intersectItem(_bvh.Items[i], _ray);
+        if (t < _ray.MaxT) {
+          _ray.MaxT = t;
+          hit.T = t;
+          hit.Item = _bvh.Items[i];
+        }
+      }
+      continue;
+    }
+
+    uint32_t near = node.First;
+    uint32_t far = node.First + 1;
+    float nearT = intersectRayAABB(_ray, invDir, _bvh.Nodes[near].Bounds);
+    float farT = intersectRayAABB(_ray, invDir, _bvh.Nodes[far].Bounds);
+    if (farT < nearT) {
+      std::swap(near, far);
+      std::swap(nearT, farT);
+    }
+    BB_ASSERT(stackSize + 2 <= (int)std::size(stack));
+    if (farT != FLT_MAX) {
+      stack[stackSize++] = far;
+    }
+    if (nearT != FLT_MAX) {
+      stack[stackSize++] = near;
+    }
+  }
+
+  return hit;
+}
+
+// Triangle BVH of one mesh. Triangles are stored in leaf order, three
+// corners each, so that leaves read contiguous memory.
+struct MeshBVH {
+  BVH Tree;
+  std::vector<Float3> Corners;
+};
+
+// Builds over the triangles in _indices[_firstIndex, _firstIndex +
+// _numIndices), relative to _vertices. Hit items are triangle numbers within
+// that range.
+MeshBVH buildMeshBVH(JobSystem &_jobSystem, const Vertex *_vertices,
+                     const uint32_t *_indices, uint32_t _firstIndex,
+                     uint32_t _numIndices);
+RayHit raycastMeshBVH(const MeshBVH &_meshBVH, const Ray &_ray);
+
+} // namespace bb
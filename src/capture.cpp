@@ -0,0 +1,2842 @@
+#include "capture.h"
+#include "resource.h"
+#include "util.h"
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+
+namespace bb {
+
+constexpr uint32_t captureMagic = 0x43464242; // "BBFC"
+constexpr uint32_t captureVersion = 1;
+
+// In the order the replay creates them, so that objects only refer to objects
+// of the types before theirs.
+enum class CaptureObjectType : uint32_t {
+  Sampler,
+  Image,
+  Buffer,
+  ImageView,
+  RenderPass,
+  Framebuffer,
+  DescriptorSetLayout,
+  PipelineLayout,
+  DescriptorSet,
+  Pipeline,
+  COUNT
+};
+
+static EnumArray<CaptureObjectType, const char *> captureObjectTypeNames = {
+    "sampler",          "image",           "buffer",
+    "image view",       "render pass",     "framebuffer",
+    "descriptor layout", "pipeline layout", "descriptor set",
+    "pipeline"};
+
+enum class CaptureCommandType : uint32_t {
+  BeginRenderPass,
+  NextSubpass,
+  EndRenderPass,
+  BindPipeline,
+  BindDescriptorSets,
+  BindVertexBuffers,
+  BindIndexBuffer,
+  PushConstants,
+  SetViewport,
+  SetScissor,
+  Draw,
+  DrawIndexed,
+  PipelineBarrier,
+  ClearAttachments,
+  ClearDepthStencilImage,
+  CopyBuffer,
+  CopyBufferToImage,
+  CopyImage,
+  COUNT
+};
+
+// Handles are written as the values they had while capturing, which the
+// replay maps to its own objects.
+static_assert(sizeof(VkBuffer) == sizeof(uint64_t));
+
+template <typename T> static uint64_t toId(T _handle) {
+  return (uint64_t)_handle;
+}
+
+template <typename T> static T fromId(uint64_t _id) { return (T)_id; }
+
+struct CaptureWriter {
+  std::vector<uint8_t> Bytes;
+
+  void writeBytes(const void *_data, size_t _size) {
+    const uint8_t *bytes = (const uint8_t *)_data;
+    Bytes.insert(Bytes.end(), bytes, bytes + _size);
+  }
+
+  template <typename T> void write(const T &_value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    writeBytes(&_value, sizeof(T));
+  }
+
+  // A null _values is written as empty.
+  template <typename T> void writeArray(const T *_values, uint32_t _count) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    if (_values == nullptr) {
+      _count = 0;
+    }
+    write(_count);
+    writeBytes(_values, sizeof(T) * _count);
+  }
+};
+
+struct CaptureReader {
+  const uint8_t *Data;
+  size_t Size;
+  size_t Offset = 0;
+  bool HasFailed = false;
+
+  const uint8_t *readBytes(size_t _size) {
+    if (HasFailed || Size - Offset < _size) {
+      HasFailed = true;
+      return nullptr;
+    }
+    const uint8_t *bytes = Data + Offset;
+    Offset += _size;
+    return bytes;
+  }
+
+  template <typename T> T read() {
+    T value = {};
+    if (const uint8_t *bytes = readBytes(sizeof(T))) {
+      memcpy(&value, bytes, sizeof(T));
+    }
+    return value;
+  }
+
+  template <typename T> std::vector<T> readArray() {
+    uint32_t count = read<uint32_t>();
+    std::vector<T> values;
+    const uint8_t *bytes = readBytes(sizeof(T) * (size_t)count);
+    if (bytes && count > 0) {
+      values.resize(count);
+      memcpy(values.data(), bytes, sizeof(T) * count);
+    }
+    return values;
+  }
+};
+
+// FNV-1a
+static uint64_t hashBytes(const void *_data, size_t _size) {
+  const uint8_t *bytes = (const uint8_t *)_data;
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (size_t i = 0; i < _size; ++i) {
+    hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+  }
+  return hash;
+}
+
+static bool isDepthFormat(VkFormat _format) {
+  switch (_format) {
+  case VK_FORMAT_D16_UNORM:
+  case VK_FORMAT_X8_D24_UNORM_PACK32:
+  case VK_FORMAT_D32_SFLOAT:
+  case VK_FORMAT_D16_UNORM_S8_UINT:
+  case VK_FORMAT_D24_UNORM_S8_UINT:
+  case VK_FORMAT_D32_SFLOAT_S8_UINT:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Size of a texel of the aspect that's copied, which is only depth for depth
+// stencil formats, as stencil is never used. 0 for formats that aren't
+// captured.
+static uint32_t getCopyTexelSize(VkFormat _format) {
+  switch (_format) {
+  case VK_FORMAT_R8_UNORM:
+    return 1;
+  case VK_FORMAT_D16_UNORM:
+  case VK_FORMAT_D16_UNORM_S8_UINT:
+    return 2;
+  case VK_FORMAT_R8G8B8A8_UNORM:
+  case VK_FORMAT_R8G8B8A8_SRGB:
+  case VK_FORMAT_B8G8R8A8_UNORM:
+  case VK_FORMAT_B8G8R8A8_SRGB:
+  case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+  case VK_FORMAT_B10G11R11_UFLOAT_PACK32:
+  case VK_FORMAT_R16G16_SFLOAT:
+  case VK_FORMAT_R32_SFLOAT:
+  case VK_FORMAT_R32_SINT:
+  case VK_FORMAT_R32_UINT:
+  case VK_FORMAT_X8_D24_UNORM_PACK32:
+  case VK_FORMAT_D24_UNORM_S8_UINT:
+  case VK_FORMAT_D32_SFLOAT:
+  case VK_FORMAT_D32_SFLOAT_S8_UINT:
+    return 4;
+  case VK_FORMAT_R16G16B16A16_SFLOAT:
+  case VK_FORMAT_R32G32_SFLOAT:
+  case VK_FORMAT_R32G32_SINT:
+    return 8;
+  case VK_FORMAT_R32G32B32A32_SFLOAT:
+  case VK_FORMAT_R32G32B32A32_SINT:
+    return 16;
+  default:
+    return 0;
+  }
+}
+
+// Every mip of the image with all of its layers, back to back. Returns the
+// total size, or 0 if the image can't be copied.
+static VkDeviceSize
+getImageCopyRegions(const VkImageCreateInfo &_info,
+                    std::vector<VkBufferImageCopy> &_regions) {
+  _regions.clear();
+  uint32_t texelSize = getCopyTexelSize(_info.format);
+  if (texelSize == 0 || _info.samples != VK_SAMPLE_COUNT_1_BIT) {
+    return 0;
+  }
+
+  VkDeviceSize size = 0;
+  for (uint32_t mip = 0; mip < _info.mipLevels; ++mip) {
+    VkBufferImageCopy region = {};
+    region.bufferOffset = size;
+    region.imageSubresource.aspectMask = isDepthFormat(_info.format)
+                                             ? VK_IMAGE_ASPECT_DEPTH_BIT
+                                             : VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = mip;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = _info.arrayLayers;
+    region.imageExtent = {std::max(_info.extent.width >> mip, 1u),
+                          std::max(_info.extent.height >> mip, 1u),
+                          std::max(_info.extent.depth >> mip, 1u)};
+    _regions.push_back(region);
+
+    size += (VkDeviceSize)texelSize * region.imageExtent.width *
+            region.imageExtent.height * region.imageExtent.depth *
+            _info.arrayLayers;
+    // Depth copies need 4 byte aligned offsets.
+    size = (size + 3) & ~(VkDeviceSize)3;
+  }
+  return size;
+}
+
+static VkImageSubresourceRange
+getWholeImageRange(const VkImageCreateInfo &_info) {
+  VkImageSubresourceRange range = {};
+  range.aspectMask = isDepthFormat(_info.format) ? VK_IMAGE_ASPECT_DEPTH_BIT
+                                                 : VK_IMAGE_ASPECT_COLOR_BIT;
+  range.baseMipLevel = 0;
+  range.levelCount = _info.mipLevels;
+  range.baseArrayLayer = 0;
+  range.layerCount = _info.arrayLayers;
+  return range;
+}
+
+static bool isImageDescriptor(VkDescriptorType _type) {
+  return _type == VK_DESCRIPTOR_TYPE_SAMPLER ||
+         _type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER ||
+         _type == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE ||
+         _type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE ||
+         _type == VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+}
+
+static bool hasDescriptorSampler(VkDescriptorType _type) {
+  return _type == VK_DESCRIPTOR_TYPE_SAMPLER ||
+         _type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+}
+
+static bool hasDescriptorImageView(VkDescriptorType _type) {
+  return isImageDescriptor(_type) && _type != VK_DESCRIPTOR_TYPE_SAMPLER;
+}
+
+//
+// Tracking
+//
+
+struct TrackedObject {
+  // The create info with what its pointers point to in line.
+  CaptureWriter CreateInfo;
+  // Objects it refers to, which the replay has to create first.
+  std::vector<std::pair<CaptureObjectType, uint64_t>> Dependencies;
+};
+
+struct TrackedDescriptor {
+  uint32_t Binding;
+  uint32_t ArrayElement;
+  VkDescriptorType Type;
+  VkDescriptorImageInfo ImageInfo;
+  VkDescriptorBufferInfo BufferInfo;
+};
+
+struct TrackedDescriptorSet {
+  uint64_t Layout;
+  // By binding in the upper and array element in the lower 32 bits.
+  std::map<uint64_t, TrackedDescriptor> Descriptors;
+};
+
+struct TrackedShader {
+  VkShaderStageFlagBits Stage;
+  std::string FilePath;
+  std::vector<uint8_t> Code;
+};
+
+struct CreationEntryPoints {
+  PFN_vkAllocateMemory vkAllocateMemory;
+  PFN_vkBindBufferMemory vkBindBufferMemory;
+  PFN_vkBindImageMemory vkBindImageMemory;
+  PFN_vkCreateBuffer vkCreateBuffer;
+  PFN_vkCreateImage vkCreateImage;
+  PFN_vkCreateImageView vkCreateImageView;
+  PFN_vkCreateSampler vkCreateSampler;
+  PFN_vkCreateRenderPass vkCreateRenderPass;
+  PFN_vkCreateFramebuffer vkCreateFramebuffer;
+  PFN_vkCreateDescriptorSetLayout vkCreateDescriptorSetLayout;
+  PFN_vkCreatePipelineLayout vkCreatePipelineLayout;
+  PFN_vkAllocateDescriptorSets vkAllocateDescriptorSets;
+  PFN_vkUpdateDescriptorSets vkUpdateDescriptorSets;
+  PFN_vkCreateDescriptorUpdateTemplate vkCreateDescriptorUpdateTemplate;
+  PFN_vkUpdateDescriptorSetWithTemplate vkUpdateDescriptorSetWithTemplate;
+  PFN_vkCreateSwapchainKHR vkCreateSwapchainKHR;
+  PFN_vkGetSwapchainImagesKHR vkGetSwapchainImagesKHR;
+};
+
+struct RecordingEntryPoints {
+  PFN_vkCmdBeginRenderPass vkCmdBeginRenderPass;
+  PFN_vkCmdNextSubpass vkCmdNextSubpass;
+  PFN_vkCmdEndRenderPass vkCmdEndRenderPass;
+  PFN_vkCmdBindPipeline vkCmdBindPipeline;
+  PFN_vkCmdBindDescriptorSets vkCmdBindDescriptorSets;
+  PFN_vkCmdBindVertexBuffers vkCmdBindVertexBuffers;
+  PFN_vkCmdBindIndexBuffer vkCmdBindIndexBuffer;
+  PFN_vkCmdPushConstants vkCmdPushConstants;
+  PFN_vkCmdSetViewport vkCmdSetViewport;
+  PFN_vkCmdSetScissor vkCmdSetScissor;
+  PFN_vkCmdDraw vkCmdDraw;
+  PFN_vkCmdDrawIndexed vkCmdDrawIndexed;
+  PFN_vkCmdPipelineBarrier vkCmdPipelineBarrier;
+  PFN_vkCmdClearAttachments vkCmdClearAttachments;
+  PFN_vkCmdClearDepthStencilImage vkCmdClearDepthStencilImage;
+  PFN_vkCmdCopyBuffer vkCmdCopyBuffer;
+  PFN_vkCmdCopyBufferToImage vkCmdCopyBufferToImage;
+  PFN_vkCmdCopyImage vkCmdCopyImage;
+};
+
+struct FrameCaptureState {
+  bool IsEnabled = false;
+  const struct Renderer *Renderer;
+  VkPhysicalDeviceMemoryProperties MemoryProperties;
+  VkCommandPool CmdPool;
+  VkCommandBuffer ReadBackCmdBuffer;
+
+  // Swapped with the volk entry points, so that they hold the hooks and
+  // these what the hooks call through to. Creation is hooked from startup,
+  // recording only while capturing.
+  CreationEntryPoints Creation;
+  RecordingEntryPoints Recording;
+
+  EnumArray<CaptureObjectType, std::unordered_map<uint64_t, TrackedObject>>
+      Objects;
+  // Serialized into Objects once the frame is captured, as their descriptors
+  // change after they're allocated.
+  std::unordered_map<uint64_t, TrackedDescriptorSet> DescriptorSets;
+  // Template updates are tracked as the writes they stand for.
+  std::unordered_map<uint64_t, std::vector<VkDescriptorUpdateTemplateEntry>>
+      UpdateTemplateEntries;
+  std::unordered_map<uint64_t, uint64_t> PipelineHashes;
+  std::unordered_map<uint64_t, std::vector<uint64_t>> PipelineShaders;
+  // By module, the hash of its code.
+  std::unordered_map<uint64_t, uint64_t> ShaderHashes;
+  // By the hash of their code, kept after their modules are destroyed.
+  std::unordered_map<uint64_t, TrackedShader> Shaders;
+  std::unordered_map<uint64_t, std::vector<VkImageLayout>>
+      RenderPassInitialLayouts;
+  std::unordered_map<uint64_t, VkImageCreateInfo> SwapchainImageInfos;
+  // By memory, its type index.
+  std::unordered_map<uint64_t, uint32_t> MemoryTypes;
+  // By buffer or image, the memory bound to it.
+  std::unordered_map<uint64_t, uint64_t> BoundMemory;
+
+  VkCommandBuffer CmdBuffer;
+  bool IsPaused;
+  CaptureWriter CommandStream;
+  uint32_t NumCommands;
+  EnumArray<CaptureObjectType, std::unordered_set<uint64_t>> UsedObjects;
+  // The layout each image is first used in, which it's in when the frame
+  // starts.
+  std::unordered_map<uint64_t, VkImageLayout> ImageLayouts;
+};
+
+static FrameCaptureState gCapture;
+// Guards what gCapture tracks across frames. The creation hooks run on the
+// image load threads and upload jobs too. Not held while calling into Vulkan,
+// as the capture's own staging buffers go through the hooks as well.
+static std::mutex gCaptureTrackingMutex;
+
+static TrackedObject &trackObject(CaptureObjectType _type, uint64_t _id) {
+  TrackedObject &object = gCapture.Objects[_type][_id];
+  object = {};
+  return object;
+}
+
+static VkResult VKAPI_CALL hookAllocateMemory(
+    VkDevice _device, const VkMemoryAllocateInfo *_info,
+    const VkAllocationCallbacks *_allocator, VkDeviceMemory *_memory) {
+  VkResult result = gCapture.Creation.vkAllocateMemory(_device, _info,
+                                                       _allocator, _memory);
+  if (result == VK_SUCCESS) {
+    std::lock_guard<std::mutex> lock(gCaptureTrackingMutex);
+    gCapture.MemoryTypes[toId(*_memory)] = _info->memoryTypeIndex;
+  }
+  return result;
+}
+
+static VkResult VKAPI_CALL hookBindBufferMemory(VkDevice _device,
+                                                VkBuffer _buffer,
+                                                VkDeviceMemory _memory,
+                                                VkDeviceSize _offset) {
+  {
+    std::lock_guard<std::mutex> lock(gCaptureTrackingMutex);
+    gCapture.BoundMemory[toId(_buffer)] = toId(_memory);
+  }
+  return gCapture.Creation.vkBindBufferMemory(_device, _buffer, _memory,
+                                              _offset);
+}
+
+static VkResult VKAPI_CALL hookBindImageMemory(VkDevice _device,
+                                               VkImage _image,
+                                               VkDeviceMemory _memory,
+                                               VkDeviceSize _offset) {
+  {
+    std::lock_guard<std::mutex> lock(gCaptureTrackingMutex);
+    gCapture.BoundMemory[toId(_image)] = toId(_memory);
+  }
+  return gCapture.Creation.vkBindImageMemory(_device, _image, _memory,
+                                             _offset);
+}
+
+static VkResult VKAPI_CALL hookCreateBuffer(
+    VkDevice _device, const VkBufferCreateInfo *_info,
+    const VkAllocationCallbacks *_allocator, VkBuffer *_buffer) {
+  VkBufferCreateInfo info = *_info;
+  info.usage |=
+      VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  VkResult result =
+      gCapture.Creation.vkCreateBuffer(_device, &info, _allocator, _buffer);
+  if (result == VK_SUCCESS) {
+    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    info.queueFamilyIndexCount = 0;
+    std::lock_guard<std::mutex> lock(gCaptureTrackingMutex);
+    trackObject(CaptureObjectType::Buffer, toId(*_buffer))
+        .CreateInfo.write(info);
+  }
+  return result;
+}
+
+static VkResult VKAPI_CALL hookCreateImage(
+    VkDevice _device, const VkImageCreateInfo *_info,
+    const VkAllocationCallbacks *_allocator, VkImage *_image) {
+  VkImageCreateInfo info = *_info;
+  // Transient attachments can't be used for anything else, and have nothing
+  // to keep between frames anyway.
+  if (!(info.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT)) {
+    info.usage |=
+        VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  }
+  VkResult result =
+      gCapture.Creation.vkCreateImage(_device, &info, _allocator, _image);
+  if (result == VK_SUCCESS) {
+    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    info.queueFamilyIndexCount = 0;
+    std::lock_guard<std::mutex> lock(gCaptureTrackingMutex);
+    trackObject(CaptureObjectType::Image, toId(*_image)).CreateInfo.write(info);
+  }
+  return result;
+}
+
+static VkResult VKAPI_CALL hookCreateImageView(
+    VkDevice _device, const VkImageViewCreateInfo *_info,
+    const VkAllocationCallbacks *_allocator, VkImageView *_view) {
+  VkResult result =
+      gCapture.Creation.vkCreateImageView(_device, _info, _allocator, _view);
+  if (result == VK_SUCCESS) {
+    std::lock_guard<std::mutex> lock(gCaptureTrackingMutex);
+    TrackedObject &object =
+        trackObject(CaptureObjectType::ImageView, toId(*_view));
+    object.CreateInfo.write(*_info);
+    object.Dependencies.push_back(
+        {CaptureObjectType::Image, toId(_info->image)});
+  }
+  return result;
+}
+
+static VkResult VKAPI_CALL hookCreateSampler(
+    VkDevice _device, const VkSamplerCreateInfo *_info,
+    const VkAllocationCallbacks *_allocator, VkSampler *_sampler) {
+  VkResult result =
+      gCapture.Creation.vkCreateSampler(_device, _info, _allocator, _sampler);
+  if (result == VK_SUCCESS) {
+    std::lock_guard<std::mutex> lock(gCaptureTrackingMutex);
+    trackObject(CaptureObjectType::Sampler, toId(*_sampler))
+        .CreateInfo.write(*_info);
+  }
+  return result;
+}
+
+static VkResult VKAPI_CALL hookCreateRenderPass(
+    VkDevice _device, const VkRenderPassCreateInfo *_info,
+    const VkAllocationCallbacks *_allocator, VkRenderPass *_renderPass) {
+  VkResult result = gCapture.Creation.vkCreateRenderPass(
+      _device, _info, _allocator, _renderPass);
+  if (result != VK_SUCCESS) {
+    return result;
+  }
+
+  std::lock_guard<std::mutex> lock(gCaptureTrackingMutex);
+  CaptureWriter &createInfo =
+      trackObject(CaptureObjectType::RenderPass, toId(*_renderPass))
+          .CreateInfo;
+  createInfo.write(_info->flags);
+  createInfo.writeArray(_info->pAttachments, _info->attachmentCount);
+  createInfo.write(_info->subpassCount);
+  for (uint32_t i = 0; i < _info->subpassCount; ++i) {
+    const VkSubpassDescription &subpass = _info->pSubpasses[i];
+    createInfo.write(subpass.flags);
+    createInfo.write(subpass.pipelineBindPoint);
+    createInfo.writeArray(subpass.pInputAttachments,
+                          subpass.inputAttachmentCount);
+    createInfo.writeArray(subpass.pColorAttachments,
+                          subpass.colorAttachmentCount);
+    createInfo.writeArray(subpass.pResolveAttachments,
+                          subpass.colorAttachmentCount);
+    createInfo.writeArray(subpass.pDepthStencilAttachment, 1);
+    createInfo.writeArray(subpass.pPreserveAttachments,
+                          subpass.preserveAttachmentCount);
+  }
+  createInfo.writeArray(_info->pDependencies, _info->dependencyCount);
+
+  // Multiview is the only extension render passes are created with.
+  const VkRenderPassMultiviewCreateInfo *multiview = nullptr;
+  for (const VkBaseInStructure *next = (const VkBaseInStructure *)_info->pNext;
+       next != nullptr; next = next->pNext) {
+    if (next->sType == VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO) {
+      multiview = (const VkRenderPassMultiviewCreateInfo *)next;
+    }
+  }
+  if (multiview) {
+    createInfo.writeArray(multiview->pViewMasks, multiview->subpassCount);
+    createInfo.writeArray(multiview->pViewOffsets,
+                          multiview->dependencyCount);
+    createInfo.writeArray(multiview->pCorrelationMasks,
+                          multiview->correlationMaskCount);
+  } else {
+    createInfo.write(uint32_t(0));
+    createInfo.write(uint32_t(0));
+    createInfo.write(uint32_t(0));
+  }
+
+  std::vector<VkImageLayout> &initialLayouts =
+      gCapture.RenderPassInitialLayouts[toId(*_renderPass)];
+  initialLayouts.clear();
+  for (uint32_t i = 0; i < _info->attachmentCount; ++i) {
+    initialLayouts.push_back(_info->pAttachments[i].initialLayout);
+  }
+  return result;
+}
+
+static VkResult VKAPI_CALL hookCreateFramebuffer(
+    VkDevice _device, const VkFramebufferCreateInfo *_info,
+    const VkAllocationCallbacks *_allocator, VkFramebuffer *_framebuffer) {
+  VkResult result = gCapture.Creation.vkCreateFramebuffer(
+      _device, _info, _allocator, _framebuffer);
+  if (result == VK_SUCCESS) {
+    std::lock_guard<std::mutex> lock(gCaptureTrackingMutex);
+    TrackedObject &object =
+        trackObject(CaptureObjectType::Framebuffer, toId(*_framebuffer));
+    object.CreateInfo.write(*_info);
+    object.CreateInfo.writeArray(_info->pAttachments, _info->attachmentCount);
+    // The render pass first, the attachments in order after it.
+    object.Dependencies.push_back(
+        {CaptureObjectType::RenderPass, toId(_info->renderPass)});
+    for (uint32_t i = 0; i < _info->attachmentCount; ++i) {
+      object.Dependencies.push_back(
+          {CaptureObjectType::ImageView, toId(_info->pAttachments[i])});
+    }
+  }
+  return result;
+}
+
+static VkResult VKAPI_CALL hookCreateDescriptorSetLayout(
+    VkDevice _device, const VkDescriptorSetLayoutCreateInfo *_info,
+    const VkAllocationCallbacks *_allocator, VkDescriptorSetLayout *_layout) {
+  VkResult result = gCapture.Creation.vkCreateDescriptorSetLayout(
+      _device, _info, _allocator, _layout);
+  if (result == VK_SUCCESS) {
+    std::lock_guard<std::mutex> lock(gCaptureTrackingMutex);
+    TrackedObject &object =
+        trackObject(CaptureObjectType::DescriptorSetLayout, toId(*_layout));
+    object.CreateInfo.write(*_info);
+    object.CreateInfo.writeArray(_info->pBindings, _info->bindingCount);
+    for (uint32_t i = 0; i < _info->bindingCount; ++i) {
+      const VkDescriptorSetLayoutBinding &binding = _info->pBindings[i];
+      object.CreateInfo.writeArray(binding.pImmutableSamplers,
+                                   binding.descriptorCount);
+      if (binding.pImmutableSamplers) {
+        for (uint32_t j = 0; j < binding.descriptorCount; ++j) {
+          object.Dependencies.push_back(
+              {CaptureObjectType::Sampler,
+               toId(binding.pImmutableSamplers[j])});
+        }
+      }
+    }
+  }
+  return result;
+}
+
+static VkResult VKAPI_CALL hookCreatePipelineLayout(
+    VkDevice _device, const VkPipelineLayoutCreateInfo *_info,
+    const VkAllocationCallbacks *_allocator, VkPipelineLayout *_layout) {
+  VkResult result = gCapture.Creation.vkCreatePipelineLayout(
+      _device, _info, _allocator, _layout);
+  if (result == VK_SUCCESS) {
+    std::lock_guard<std::mutex> lock(gCaptureTrackingMutex);
+    TrackedObject &object =
+        trackObject(CaptureObjectType::PipelineLayout, toId(*_layout));
+    object.CreateInfo.write(*_info);
+    object.CreateInfo.writeArray(_info->pSetLayouts, _info->setLayoutCount);
+    object.CreateInfo.writeArray(_info->pPushConstantRanges,
+                                 _info->pushConstantRangeCount);
+    for (uint32_t i = 0; i < _info->setLayoutCount; ++i) {
+      object.Dependencies.push_back({CaptureObjectType::DescriptorSetLayout,
+                                     toId(_info->pSetLayouts[i])});
+    }
+  }
+  return result;
+}
+
+static VkResult VKAPI_CALL
+hookAllocateDescriptorSets(VkDevice _device,
+                           const VkDescriptorSetAllocateInfo *_info,
+                           VkDescriptorSet *_sets) {
+  VkResult result =
+      gCapture.Creation.vkAllocateDescriptorSets(_device, _info, _sets);
+  if (result == VK_SUCCESS) {
+    std::lock_guard<std::mutex> lock(gCaptureTrackingMutex);
+    for (uint32_t i = 0; i < _info->descriptorSetCount; ++i) {
+      TrackedDescriptorSet &set = gCapture.DescriptorSets[toId(_sets[i])];
+      set = {};
+      set.Layout = toId(_info->pSetLayouts[i]);
+    }
+  }
+  return result;
+}
+
+static void trackDescriptor(TrackedDescriptorSet &_set, uint32_t _binding,
+                            uint32_t _arrayElement, VkDescriptorType _type,
+                            const void *_info) {
+  TrackedDescriptor descriptor = {};
+  descriptor.Binding = _binding;
+  descriptor.ArrayElement = _arrayElement;
+  descriptor.Type = _type;
+  if (isImageDescriptor(_type)) {
+    descriptor.ImageInfo = *(const VkDescriptorImageInfo *)_info;
+  } else {
+    descriptor.BufferInfo = *(const VkDescriptorBufferInfo *)_info;
+  }
+  uint64_t key = ((uint64_t)descriptor.Binding << 32) | descriptor.ArrayElement;
+  _set.Descriptors[key] = descriptor;
+}
+
+static void VKAPI_CALL hookUpdateDescriptorSets(
+    VkDevice _device, uint32_t _numWrites, const VkWriteDescriptorSet *_writes,
+    uint32_t _numCopies, const VkCopyDescriptorSet *_copies) {
+  gCapture.Creation.vkUpdateDescriptorSets(_device, _numWrites, _writes,
+                                           _numCopies, _copies);
+  BB_ASSERT(_numCopies == 0);
+
+  std::lock_guard<std::mutex> lock(gCaptureTrackingMutex);
+  for (uint32_t i = 0; i < _numWrites; ++i) {
+    const VkWriteDescriptorSet &write = _writes[i];
+    TrackedDescriptorSet &set = gCapture.DescriptorSets[toId(write.dstSet)];
+    BB_ASSERT(isImageDescriptor(write.descriptorType) || write.pBufferInfo);
+    for (uint32_t j = 0; j < write.descriptorCount; ++j) {
+      const void *info = isImageDescriptor(write.descriptorType)
+                             ? (const void *)&write.pImageInfo[j]
+                             : (const void *)&write.pBufferInfo[j];
+      trackDescriptor(set, write.dstBinding, write.dstArrayElement + j,
+                      write.descriptorType, info);
+    }
+  }
+}
+
+static VkResult VKAPI_CALL hookCreateDescriptorUpdateTemplate(
+    VkDevice _device, const VkDescriptorUpdateTemplateCreateInfo *_info,
+    const VkAllocationCallbacks *_allocator,
+    VkDescriptorUpdateTemplate *_template) {
+  VkResult result = gCapture.Creation.vkCreateDescriptorUpdateTemplate(
+      _device, _info, _allocator, _template);
+  if (result == VK_SUCCESS) {
+    std::lock_guard<std::mutex> lock(gCaptureTrackingMutex);
+    gCapture.UpdateTemplateEntries[toId(*_template)].assign(
+        _info->pDescriptorUpdateEntries,
+        _info->pDescriptorUpdateEntries + _info->descriptorUpdateEntryCount);
+  }
+  return result;
+}
+
+static void VKAPI_CALL hookUpdateDescriptorSetWithTemplate(
+    VkDevice _device, VkDescriptorSet _set,
+    VkDescriptorUpdateTemplate _template, const void *_data) {
+  gCapture.Creation.vkUpdateDescriptorSetWithTemplate(_device, _set, _template,
+                                                      _data);
+
+  std::lock_guard<std::mutex> lock(gCaptureTrackingMutex);
+  TrackedDescriptorSet &set = gCapture.DescriptorSets[toId(_set)];
+  for (const VkDescriptorUpdateTemplateEntry &entry :
+       gCapture.UpdateTemplateEntries[toId(_template)]) {
+    BB_ASSERT(entry.descriptorType != VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER &&
+              entry.descriptorType != VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER);
+    for (uint32_t j = 0; j < entry.descriptorCount; ++j) {
+      trackDescriptor(set, entry.dstBinding, entry.dstArrayElement + j,
+                      entry.descriptorType,
+                      (const uint8_t *)_data + entry.offset + j * entry.stride);
+    }
+  }
+}
+
+static VkResult VKAPI_CALL hookCreateSwapchainKHR(
+    VkDevice _device, const VkSwapchainCreateInfoKHR *_info,
+    const VkAllocationCallbacks *_allocator, VkSwapchainKHR *_swapchain) {
+  VkResult result = gCapture.Creation.vkCreateSwapchainKHR(
+      _device, _info, _allocator, _swapchain);
+  if (result == VK_SUCCESS) {
+    // The replay renders to a plain image in place of each swap chain image.
+    VkImageCreateInfo info = {};
+    info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    info.imageType = VK_IMAGE_TYPE_2D;
+    info.format = _info->imageFormat;
+    info.extent = {_info->imageExtent.width, _info->imageExtent.height, 1};
+    info.mipLevels = 1;
+    info.arrayLayers = _info->imageArrayLayers;
+    info.samples = VK_SAMPLE_COUNT_1_BIT;
+    info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    info.usage = _info->imageUsage;
+    info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    std::lock_guard<std::mutex> lock(gCaptureTrackingMutex);
+    gCapture.SwapchainImageInfos[toId(*_swapchain)] = info;
+  }
+  return result;
+}
+
+static VkResult VKAPI_CALL hookGetSwapchainImagesKHR(VkDevice _device,
+                                                     VkSwapchainKHR _swapchain,
+                                                     uint32_t *_numImages,
+                                                     VkImage *_images) {
+  VkResult result = gCapture.Creation.vkGetSwapchainImagesKHR(
+      _device, _swapchain, _numImages, _images);
+  std::lock_guard<std::mutex> lock(gCaptureTrackingMutex);
+  auto info = gCapture.SwapchainImageInfos.find(toId(_swapchain));
+  if (_images && result >= 0 && info != gCapture.SwapchainImageInfos.end()) {
+    for (uint32_t i = 0; i < *_numImages; ++i) {
+      trackObject(CaptureObjectType::Image, toId(_images[i]))
+          .CreateInfo.write(info->second);
+    }
+  }
+  return result;
+}
+
+static void swapEntryPoints(CreationEntryPoints &_entryPoints) {
+  std::swap(vkAllocateMemory, _entryPoints.vkAllocateMemory);
+  std::swap(vkBindBufferMemory, _entryPoints.vkBindBufferMemory);
+  std::swap(vkBindImageMemory, _entryPoints.vkBindImageMemory);
+  std::swap(vkCreateBuffer, _entryPoints.vkCreateBuffer);
+  std::swap(vkCreateImage, _entryPoints.vkCreateImage);
+  std::swap(vkCreateImageView, _entryPoints.vkCreateImageView);
+  std::swap(vkCreateSampler, _entryPoints.vkCreateSampler);
+  std::swap(vkCreateRenderPass, _entryPoints.vkCreateRenderPass);
+  std::swap(vkCreateFramebuffer, _entryPoints.vkCreateFramebuffer);
+  std::swap(vkCreateDescriptorSetLayout,
+            _entryPoints.vkCreateDescriptorSetLayout);
+  std::swap(vkCreatePipelineLayout, _entryPoints.vkCreatePipelineLayout);
+  std::swap(vkAllocateDescriptorSets, _entryPoints.vkAllocateDescriptorSets);
+  std::swap(vkUpdateDescriptorSets, _entryPoints.vkUpdateDescriptorSets);
+  std::swap(vkCreateDescriptorUpdateTemplate,
+            _entryPoints.vkCreateDescriptorUpdateTemplate);
+  std::swap(vkUpdateDescriptorSetWithTemplate,
+            _entryPoints.vkUpdateDescriptorSetWithTemplate);
+  std::swap(vkCreateSwapchainKHR, _entryPoints.vkCreateSwapchainKHR);
+  std::swap(vkGetSwapchainImagesKHR, _entryPoints.vkGetSwapchainImagesKHR);
+}
+
+void trackShader(const Shader &_shader, const std::string &_filePath,
+                 const void *_code, size_t _codeSize) {
+  if (!gCapture.IsEnabled) {
+    return;
+  }
+
+  uint64_t hash = hashBytes(_code, _codeSize);
+  std::lock_guard<std::mutex> lock(gCaptureTrackingMutex);
+  gCapture.ShaderHashes[toId(_shader.Handle)] = hash;
+  TrackedShader &shader = gCapture.Shaders[hash];
+  if (shader.Code.empty()) {
+    shader.Stage = _shader.Stage;
+    shader.FilePath = _filePath;
+    shader.Code.assign((const uint8_t *)_code,
+                       (const uint8_t *)_code + _codeSize);
+  }
+}
+
+void trackPipeline(VkPipeline _pipeline, const PipelineParams &_params) {
+  if (!gCapture.IsEnabled) {
+    return;
+  }
+
+  uint64_t id = toId(_pipeline);
+  std::lock_guard<std::mutex> lock(gCaptureTrackingMutex);
+  TrackedObject &object = trackObject(CaptureObjectType::Pipeline, id);
+  std::vector<uint64_t> &shaderHashes = gCapture.PipelineShaders[id];
+  shaderHashes.clear();
+
+  // Written field by field, so that padding stays out of the hash.
+  CaptureWriter &params = object.CreateInfo;
+  params.write((uint32_t)_params.NumShaders);
+  for (int i = 0; i < _params.NumShaders; ++i) {
+    uint64_t hash = gCapture.ShaderHashes[toId(_params.Shaders[i]->Handle)];
+    params.write(hash);
+    shaderHashes.push_back(hash);
+  }
+  params.writeArray(_params.VertexInput.Bindings,
+                    (uint32_t)_params.VertexInput.NumBindings);
+  params.writeArray(_params.VertexInput.Attributes,
+                    (uint32_t)_params.VertexInput.NumAttributes);
+  params.write(_params.InputAssembly.Topology);
+  params.write(_params.Viewport.Offset);
+  params.write(_params.Viewport.Extent);
+  params.write(_params.Viewport.ScissorOffset);
+  params.write(_params.Viewport.ScissorExtent);
+  params.write((uint8_t)_params.Viewport.IsDynamic);
+  params.write(_params.Rasterizer.PolygonMode);
+  params.write(_params.Rasterizer.CullMode);
+  params.write((uint8_t)_params.DepthStencil.DepthTestEnable);
+  params.write((uint8_t)_params.DepthStencil.DepthWriteEnable);
+  params.write(_params.Blend.NumColorBlends);
+  params.write((uint8_t)_params.Blend.DisableColorWrites);
+  params.write(_params.Subpass);
+  // Handles differ between runs, so they're left out of the hash.
+  gCapture.PipelineHashes[id] =
+      hashBytes(params.Bytes.data(), params.Bytes.size());
+
+  params.write(toId(_params.PipelineLayout));
+  params.write(toId(_params.RenderPass));
+  object.Dependencies.push_back(
+      {CaptureObjectType::PipelineLayout, toId(_params.PipelineLayout)});
+  object.Dependencies.push_back(
+      {CaptureObjectType::RenderPass, toId(_params.RenderPass)});
+}
+
+//
+// Recording
+//
+
+static CaptureWriter &writeCommand(CaptureCommandType _type) {
+  ++gCapture.NumCommands;
+  gCapture.CommandStream.write(_type);
+  return gCapture.CommandStream;
+}
+
+static void useObject(CaptureObjectType _type, uint64_t _id) {
+  if (_id != 0) {
+    gCapture.UsedObjects[_type].insert(_id);
+  }
+}
+
+// The first use of an image tells the layout the frame finds it in.
+static void useImage(uint64_t _image, VkImageLayout _layout) {
+  if (_image != 0) {
+    useObject(CaptureObjectType::Image, _image);
+    gCapture.ImageLayouts.emplace(_image, _layout);
+  }
+}
+
+static uint64_t getViewImage(uint64_t _view) {
+  const auto &views = gCapture.Objects[CaptureObjectType::ImageView];
+  auto view = views.find(_view);
+  return view != views.end() ? view->second.Dependencies[0].second : 0;
+}
+
+static void VKAPI_CALL hookCmdBeginRenderPass(
+    VkCommandBuffer _cmdBuffer, const VkRenderPassBeginInfo *_info,
+    VkSubpassContents _contents) {
+  gCapture.Recording.vkCmdBeginRenderPass(_cmdBuffer, _info, _contents);
+  if (_cmdBuffer != gCapture.CmdBuffer) {
+    return;
+  }
+
+  CaptureWriter &command = writeCommand(CaptureCommandType::BeginRenderPass);
+  command.write(*_info);
+  command.writeArray(_info->pClearValues, _info->clearValueCount);
+  command.write(_contents);
+  useObject(CaptureObjectType::RenderPass, toId(_info->renderPass));
+  useObject(CaptureObjectType::Framebuffer, toId(_info->framebuffer));
+
+  std::lock_guard<std::mutex> lock(gCaptureTrackingMutex);
+  const auto &framebuffers = gCapture.Objects[CaptureObjectType::Framebuffer];
+  auto framebuffer = framebuffers.find(toId(_info->framebuffer));
+  auto initialLayouts =
+      gCapture.RenderPassInitialLayouts.find(toId(_info->renderPass));
+  if (framebuffer != framebuffers.end() &&
+      initialLayouts != gCapture.RenderPassInitialLayouts.end()) {
+    const auto &dependencies = framebuffer->second.Dependencies;
+    const std::vector<VkImageLayout> &layouts = initialLayouts->second;
+    for (size_t i = 0; i + 1 < dependencies.size() && i < layouts.size();
+         ++i) {
+      useImage(getViewImage(dependencies[i + 1].second), layouts[i]);
+    }
+  }
+}
+
+static void VKAPI_CALL hookCmdNextSubpass(VkCommandBuffer _cmdBuffer,
+                                          VkSubpassContents _contents) {
+  gCapture.Recording.vkCmdNextSubpass(_cmdBuffer, _contents);
+  if (_cmdBuffer == gCapture.CmdBuffer) {
+    writeCommand(CaptureCommandType::NextSubpass).write(_contents);
+  }
+}
+
+static void VKAPI_CALL hookCmdEndRenderPass(VkCommandBuffer _cmdBuffer) {
+  gCapture.Recording.vkCmdEndRenderPass(_cmdBuffer);
+  if (_cmdBuffer == gCapture.CmdBuffer) {
+    writeCommand(CaptureCommandType::EndRenderPass);
+  }
+}
+
+static void VKAPI_CALL hookCmdBindPipeline(VkCommandBuffer _cmdBuffer,
+                                           VkPipelineBindPoint _bindPoint,
+                                           VkPipeline _pipeline) {
+  gCapture.Recording.vkCmdBindPipeline(_cmdBuffer, _bindPoint, _pipeline);
+  if (_cmdBuffer == gCapture.CmdBuffer) {
+    CaptureWriter &command = writeCommand(CaptureCommandType::BindPipeline);
+    command.write(_bindPoint);
+    command.write(toId(_pipeline));
+    useObject(CaptureObjectType::Pipeline, toId(_pipeline));
+  }
+}
+
+static void VKAPI_CALL hookCmdBindDescriptorSets(
+    VkCommandBuffer _cmdBuffer, VkPipelineBindPoint _bindPoint,
+    VkPipelineLayout _layout, uint32_t _firstSet, uint32_t _numSets,
+    const VkDescriptorSet *_sets, uint32_t _numDynamicOffsets,
+    const uint32_t *_dynamicOffsets) {
+  gCapture.Recording.vkCmdBindDescriptorSets(
+      _cmdBuffer, _bindPoint, _layout, _firstSet, _numSets, _sets,
+      _numDynamicOffsets, _dynamicOffsets);
+  if (_cmdBuffer != gCapture.CmdBuffer) {
+    return;
+  }
+
+  CaptureWriter &command =
+      writeCommand(CaptureCommandType::BindDescriptorSets);
+  command.write(_bindPoint);
+  command.write(toId(_layout));
+  command.write(_firstSet);
+  command.writeArray(_sets, _numSets);
+  command.writeArray(_dynamicOffsets, _numDynamicOffsets);
+  useObject(CaptureObjectType::PipelineLayout, toId(_layout));
+
+  std::lock_guard<std::mutex> lock(gCaptureTrackingMutex);
+  for (uint32_t i = 0; i < _numSets; ++i) {
+    useObject(CaptureObjectType::DescriptorSet, toId(_sets[i]));
+    auto set = gCapture.DescriptorSets.find(toId(_sets[i]));
+    if (set == gCapture.DescriptorSets.end()) {
+      continue;
+    }
+    for (const auto &[key, descriptor] : set->second.Descriptors) {
+      if (hasDescriptorImageView(descriptor.Type)) {
+        useImage(getViewImage(toId(descriptor.ImageInfo.imageView)),
+                 descriptor.ImageInfo.imageLayout);
+      }
+    }
+  }
+}
+
+static void VKAPI_CALL hookCmdBindVertexBuffers(VkCommandBuffer _cmdBuffer,
+                                                uint32_t _firstBinding,
+                                                uint32_t _numBindings,
+                                                const VkBuffer *_buffers,
+                                                const VkDeviceSize *_offsets) {
+  gCapture.Recording.vkCmdBindVertexBuffers(_cmdBuffer, _firstBinding,
+                                            _numBindings, _buffers, _offsets);
+  if (_cmdBuffer != gCapture.CmdBuffer) {
+    return;
+  }
+
+  CaptureWriter &command = writeCommand(CaptureCommandType::BindVertexBuffers);
+  command.write(_firstBinding);
+  command.writeArray(_buffers, _numBindings);
+  command.writeArray(_offsets, _numBindings);
+  for (uint32_t i = 0; i < _numBindings; ++i) {
+    useObject(CaptureObjectType::Buffer, toId(_buffers[i]));
+  }
+}
+
+static void VKAPI_CALL hookCmdBindIndexBuffer(VkCommandBuffer _cmdBuffer,
+                                              VkBuffer _buffer,
+                                              VkDeviceSize _offset,
+                                              VkIndexType _indexType) {
+  gCapture.Recording.vkCmdBindIndexBuffer(_cmdBuffer, _buffer, _offset,
+                                          _indexType);
+  if (_cmdBuffer == gCapture.CmdBuffer) {
+    CaptureWriter &command = writeCommand(CaptureCommandType::BindIndexBuffer);
+    command.write(toId(_buffer));
+    command.write(_offset);
+    command.write(_indexType);
+    useObject(CaptureObjectType::Buffer, toId(_buffer));
+  }
+}
+
+static void VKAPI_CALL hookCmdPushConstants(VkCommandBuffer _cmdBuffer,
+                                            VkPipelineLayout _layout,
+                                            VkShaderStageFlags _stages,
+                                            uint32_t _offset, uint32_t _size,
+                                            const void *_values) {
+  gCapture.Recording.vkCmdPushConstants(_cmdBuffer, _layout, _stages, _offset,
+                                        _size, _values);
+  if (_cmdBuffer == gCapture.CmdBuffer) {
+    CaptureWriter &command = writeCommand(CaptureCommandType::PushConstants);
+    command.write(toId(_layout));
+    command.write(_stages);
+    command.write(_offset);
+    command.writeArray((const uint8_t *)_values, _size);
+    useObject(CaptureObjectType::PipelineLayout, toId(_layout));
+  }
+}
+
+static void VKAPI_CALL hookCmdSetViewport(VkCommandBuffer _cmdBuffer,
+                                          uint32_t _firstViewport,
+                                          uint32_t _numViewports,
+                                          const VkViewport *_viewports) {
+  gCapture.Recording.vkCmdSetViewport(_cmdBuffer, _firstViewport,
+                                      _numViewports, _viewports);
+  if (_cmdBuffer == gCapture.CmdBuffer) {
+    CaptureWriter &command = writeCommand(CaptureCommandType::SetViewport);
+    command.write(_firstViewport);
+    command.writeArray(_viewports, _numViewports);
+  }
+}
+
+static void VKAPI_CALL hookCmdSetScissor(VkCommandBuffer _cmdBuffer,
+                                         uint32_t _firstScissor,
+                                         uint32_t _numScissors,
+                                         const VkRect2D *_scissors) {
+  gCapture.Recording.vkCmdSetScissor(_cmdBuffer, _firstScissor, _numScissors,
+                                     _scissors);
+  if (_cmdBuffer == gCapture.CmdBuffer) {
+    CaptureWriter &command = writeCommand(CaptureCommandType::SetScissor);
+    command.write(_firstScissor);
+    command.writeArray(_scissors, _numScissors);
+  }
+}
+
+static void VKAPI_CALL hookCmdDraw(VkCommandBuffer _cmdBuffer,
+                                   uint32_t _numVertices,
+                                   uint32_t _numInstances,
+                                   uint32_t _firstVertex,
+                                   uint32_t _firstInstance) {
+  gCapture.Recording.vkCmdDraw(_cmdBuffer, _numVertices, _numInstances,
+                               _firstVertex, _firstInstance);
+  if (_cmdBuffer == gCapture.CmdBuffer) {
+    CaptureWriter &command = writeCommand(CaptureCommandType::Draw);
+    command.write(_numVertices);
+    command.write(_numInstances);
+    command.write(_firstVertex);
+    command.write(_firstInstance);
+  }
+}
+
+static void VKAPI_CALL hookCmdDrawIndexed(VkCommandBuffer _cmdBuffer,
+                                          uint32_t _numIndices,
+                                          uint32_t _numInstances,
+                                          uint32_t _firstIndex,
+                                          int32_t _vertexOffset,
+                                          uint32_t _firstInstance) {
+  gCapture.Recording.vkCmdDrawIndexed(_cmdBuffer, _numIndices, _numInstances,
+                                      _firstIndex, _vertexOffset,
+                                      _firstInstance);
+  if (_cmdBuffer == gCapture.CmdBuffer) {
+    CaptureWriter &command = writeCommand(CaptureCommandType::DrawIndexed);
+    command.write(_numIndices);
+    command.write(_numInstances);
+    command.write(_firstIndex);
+    command.write(_vertexOffset);
+    command.write(_firstInstance);
+  }
+}
+
+static void VKAPI_CALL hookCmdPipelineBarrier(
+    VkCommandBuffer _cmdBuffer, VkPipelineStageFlags _srcStages,
+    VkPipelineStageFlags _dstStages, VkDependencyFlags _dependencyFlags,
+    uint32_t _numMemoryBarriers, const VkMemoryBarrier *_memoryBarriers,
+    uint32_t _numBufferBarriers, const VkBufferMemoryBarrier *_bufferBarriers,
+    uint32_t _numImageBarriers, const VkImageMemoryBarrier *_imageBarriers) {
+  gCapture.Recording.vkCmdPipelineBarrier(
+      _cmdBuffer, _srcStages, _dstStages, _dependencyFlags, _numMemoryBarriers,
+      _memoryBarriers, _numBufferBarriers, _bufferBarriers, _numImageBarriers,
+      _imageBarriers);
+  if (_cmdBuffer != gCapture.CmdBuffer) {
+    return;
+  }
+
+  CaptureWriter &command = writeCommand(CaptureCommandType::PipelineBarrier);
+  command.write(_srcStages);
+  command.write(_dstStages);
+  command.write(_dependencyFlags);
+  command.writeArray(_memoryBarriers, _numMemoryBarriers);
+  command.writeArray(_bufferBarriers, _numBufferBarriers);
+  command.writeArray(_imageBarriers, _numImageBarriers);
+  for (uint32_t i = 0; i < _numBufferBarriers; ++i) {
+    useObject(CaptureObjectType::Buffer, toId(_bufferBarriers[i].buffer));
+  }
+  for (uint32_t i = 0; i < _numImageBarriers; ++i) {
+    useImage(toId(_imageBarriers[i].image), _imageBarriers[i].oldLayout);
+  }
+}
+
+static void VKAPI_CALL hookCmdClearAttachments(
+    VkCommandBuffer _cmdBuffer, uint32_t _numAttachments,
+    const VkClearAttachment *_attachments, uint32_t _numRects,
+    const VkClearRect *_rects) {
+  gCapture.Recording.vkCmdClearAttachments(_cmdBuffer, _numAttachments,
+                                           _attachments, _numRects, _rects);
+  if (_cmdBuffer == gCapture.CmdBuffer) {
+    CaptureWriter &command =
+        writeCommand(CaptureCommandType::ClearAttachments);
+    command.writeArray(_attachments, _numAttachments);
+    command.writeArray(_rects, _numRects);
+  }
+}
+
+static void VKAPI_CALL hookCmdClearDepthStencilImage(
+    VkCommandBuffer _cmdBuffer, VkImage _image, VkImageLayout _layout,
+    const VkClearDepthStencilValue *_value, uint32_t _numRanges,
+    const VkImageSubresourceRange *_ranges) {
+  gCapture.Recording.vkCmdClearDepthStencilImage(_cmdBuffer, _image, _layout,
+                                                 _value, _numRanges, _ranges);
+  if (_cmdBuffer == gCapture.CmdBuffer) {
+    CaptureWriter &command =
+        writeCommand(CaptureCommandType::ClearDepthStencilImage);
+    command.write(toId(_image));
+    command.write(_layout);
+    command.write(*_value);
+    command.writeArray(_ranges, _numRanges);
+    useImage(toId(_image), _layout);
+  }
+}
+
+static void VKAPI_CALL hookCmdCopyBuffer(VkCommandBuffer _cmdBuffer,
+                                         VkBuffer _srcBuffer,
+                                         VkBuffer _dstBuffer,
+                                         uint32_t _numRegions,
+                                         const VkBufferCopy *_regions) {
+  gCapture.Recording.vkCmdCopyBuffer(_cmdBuffer, _srcBuffer, _dstBuffer,
+                                     _numRegions, _regions);
+  if (_cmdBuffer == gCapture.CmdBuffer) {
+    CaptureWriter &command = writeCommand(CaptureCommandType::CopyBuffer);
+    command.write(toId(_srcBuffer));
+    command.write(toId(_dstBuffer));
+    command.writeArray(_regions, _numRegions);
+    useObject(CaptureObjectType::Buffer, toId(_srcBuffer));
+    useObject(CaptureObjectType::Buffer, toId(_dstBuffer));
+  }
+}
+
+static void VKAPI_CALL hookCmdCopyBufferToImage(
+    VkCommandBuffer _cmdBuffer, VkBuffer _srcBuffer, VkImage _dstImage,
+    VkImageLayout _dstLayout, uint32_t _numRegions,
+    const VkBufferImageCopy *_regions) {
+  gCapture.Recording.vkCmdCopyBufferToImage(
+      _cmdBuffer, _srcBuffer, _dstImage, _dstLayout, _numRegions, _regions);
+  if (_cmdBuffer == gCapture.CmdBuffer) {
+    CaptureWriter &command =
+        writeCommand(CaptureCommandType::CopyBufferToImage);
+    command.write(toId(_srcBuffer));
+    command.write(toId(_dstImage));
+    command.write(_dstLayout);
+    command.writeArray(_regions, _numRegions);
+    useObject(CaptureObjectType::Buffer, toId(_srcBuffer));
+    useImage(toId(_dstImage), _dstLayout);
+  }
+}
+
+static void VKAPI_CALL hookCmdCopyImage(VkCommandBuffer _cmdBuffer,
+                                        VkImage _srcImage,
+                                        VkImageLayout _srcLayout,
+                                        VkImage _dstImage,
+                                        VkImageLayout _dstLayout,
+                                        uint32_t _numRegions,
+                                        const VkImageCopy *_regions) {
+  gCapture.Recording.vkCmdCopyImage(_cmdBuffer, _srcImage, _srcLayout,
+                                    _dstImage, _dstLayout, _numRegions,
+                                    _regions);
+  if (_cmdBuffer == gCapture.CmdBuffer) {
+    CaptureWriter &command = writeCommand(CaptureCommandType::CopyImage);
+    command.write(toId(_srcImage));
+    command.write(_srcLayout);
+    command.write(toId(_dstImage));
+    command.write(_dstLayout);
+    command.writeArray(_regions, _numRegions);
+    useImage(toId(_srcImage), _srcLayout);
+    useImage(toId(_dstImage), _dstLayout);
+  }
+}
+
+static void swapEntryPoints(RecordingEntryPoints &_entryPoints) {
+  std::swap(vkCmdBeginRenderPass, _entryPoints.vkCmdBeginRenderPass);
+  std::swap(vkCmdNextSubpass, _entryPoints.vkCmdNextSubpass);
+  std::swap(vkCmdEndRenderPass, _entryPoints.vkCmdEndRenderPass);
+  std::swap(vkCmdBindPipeline, _entryPoints.vkCmdBindPipeline);
+  std::swap(vkCmdBindDescriptorSets, _entryPoints.vkCmdBindDescriptorSets);
+  std::swap(vkCmdBindVertexBuffers, _entryPoints.vkCmdBindVertexBuffers);
+  std::swap(vkCmdBindIndexBuffer, _entryPoints.vkCmdBindIndexBuffer);
+  std::swap(vkCmdPushConstants, _entryPoints.vkCmdPushConstants);
+  std::swap(vkCmdSetViewport, _entryPoints.vkCmdSetViewport);
+  std::swap(vkCmdSetScissor, _entryPoints.vkCmdSetScissor);
+  std::swap(vkCmdDraw, _entryPoints.vkCmdDraw);
+  std::swap(vkCmdDrawIndexed, _entryPoints.vkCmdDrawIndexed);
+  std::swap(vkCmdPipelineBarrier, _entryPoints.vkCmdPipelineBarrier);
+  std::swap(vkCmdClearAttachments, _entryPoints.vkCmdClearAttachments);
+  std::swap(vkCmdClearDepthStencilImage,
+            _entryPoints.vkCmdClearDepthStencilImage);
+  std::swap(vkCmdCopyBuffer, _entryPoints.vkCmdCopyBuffer);
+  std::swap(vkCmdCopyBufferToImage, _entryPoints.vkCmdCopyBufferToImage);
+  std::swap(vkCmdCopyImage, _entryPoints.vkCmdCopyImage);
+}
+
+void initFrameCapture(const Renderer &_renderer) {
+  BB_ASSERT(!gCapture.IsEnabled);
+  gCapture.IsEnabled = true;
+  gCapture.Renderer = &_renderer;
+  vkGetPhysicalDeviceMemoryProperties(_renderer.PhysicalDevice,
+                                      &gCapture.MemoryProperties);
+
+  VkCommandPoolCreateInfo cmdPoolInfo = {};
+  cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  cmdPoolInfo.queueFamilyIndex = _renderer.QueueFamilyIndex;
+  cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  BB_VK_ASSERT(vkCreateCommandPool(_renderer.Device, &cmdPoolInfo, nullptr,
+                                   &gCapture.CmdPool));
+
+  VkCommandBufferAllocateInfo cmdBufferInfo = {};
+  cmdBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  cmdBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  cmdBufferInfo.commandPool = gCapture.CmdPool;
+  cmdBufferInfo.commandBufferCount = 1;
+  BB_VK_ASSERT(vkAllocateCommandBuffers(_renderer.Device, &cmdBufferInfo,
+                                        &gCapture.ReadBackCmdBuffer));
+
+  CreationEntryPoints &creation = gCapture.Creation;
+  creation.vkAllocateMemory = hookAllocateMemory;
+  creation.vkBindBufferMemory = hookBindBufferMemory;
+  creation.vkBindImageMemory = hookBindImageMemory;
+  creation.vkCreateBuffer = hookCreateBuffer;
+  creation.vkCreateImage = hookCreateImage;
+  creation.vkCreateImageView = hookCreateImageView;
+  creation.vkCreateSampler = hookCreateSampler;
+  creation.vkCreateRenderPass = hookCreateRenderPass;
+  creation.vkCreateFramebuffer = hookCreateFramebuffer;
+  creation.vkCreateDescriptorSetLayout = hookCreateDescriptorSetLayout;
+  creation.vkCreatePipelineLayout = hookCreatePipelineLayout;
+  creation.vkAllocateDescriptorSets = hookAllocateDescriptorSets;
+  creation.vkUpdateDescriptorSets = hookUpdateDescriptorSets;
+  creation.vkCreateDescriptorUpdateTemplate =
+      hookCreateDescriptorUpdateTemplate;
+  creation.vkUpdateDescriptorSetWithTemplate =
+      hookUpdateDescriptorSetWithTemplate;
+  creation.vkCreateSwapchainKHR = hookCreateSwapchainKHR;
+  creation.vkGetSwapchainImagesKHR = hookGetSwapchainImagesKHR;
+  swapEntryPoints(creation);
+
+  RecordingEntryPoints &recording = gCapture.Recording;
+  recording.vkCmdBeginRenderPass = hookCmdBeginRenderPass;
+  recording.vkCmdNextSubpass = hookCmdNextSubpass;
+  recording.vkCmdEndRenderPass = hookCmdEndRenderPass;
+  recording.vkCmdBindPipeline = hookCmdBindPipeline;
+  recording.vkCmdBindDescriptorSets = hookCmdBindDescriptorSets;
+  recording.vkCmdBindVertexBuffers = hookCmdBindVertexBuffers;
+  recording.vkCmdBindIndexBuffer = hookCmdBindIndexBuffer;
+  recording.vkCmdPushConstants = hookCmdPushConstants;
+  recording.vkCmdSetViewport = hookCmdSetViewport;
+  recording.vkCmdSetScissor = hookCmdSetScissor;
+  recording.vkCmdDraw = hookCmdDraw;
+  recording.vkCmdDrawIndexed = hookCmdDrawIndexed;
+  recording.vkCmdPipelineBarrier = hookCmdPipelineBarrier;
+  recording.vkCmdClearAttachments = hookCmdClearAttachments;
+  recording.vkCmdClearDepthStencilImage = hookCmdClearDepthStencilImage;
+  recording.vkCmdCopyBuffer = hookCmdCopyBuffer;
+  recording.vkCmdCopyBufferToImage = hookCmdCopyBufferToImage;
+  recording.vkCmdCopyImage = hookCmdCopyImage;
+}
+
+void destroyFrameCapture() {
+  if (!gCapture.IsEnabled) {
+    return;
+  }
+  BB_ASSERT(gCapture.CmdBuffer == VK_NULL_HANDLE);
+  swapEntryPoints(gCapture.Creation);
+  vkDestroyCommandPool(gCapture.Renderer->Device, gCapture.CmdPool, nullptr);
+  gCapture = FrameCaptureState();
+}
+
+bool isFrameCaptureEnabled() { return gCapture.IsEnabled; }
+
+void beginFrameCapture(VkCommandBuffer _cmdBuffer) {
+  BB_ASSERT(gCapture.IsEnabled && gCapture.CmdBuffer == VK_NULL_HANDLE);
+  gCapture.CmdBuffer = _cmdBuffer;
+  gCapture.IsPaused = false;
+  swapEntryPoints(gCapture.Recording);
+}
+
+void pauseFrameCapture(bool _isPaused) {
+  if (gCapture.CmdBuffer == VK_NULL_HANDLE || gCapture.IsPaused == _isPaused) {
+    return;
+  }
+  gCapture.IsPaused = _isPaused;
+  swapEntryPoints(gCapture.Recording);
+}
+
+//
+// Writing
+//
+
+static void trackDescriptorSetObject(uint64_t _id) {
+  auto set = gCapture.DescriptorSets.find(_id);
+  if (set == gCapture.DescriptorSets.end()) {
+    return;
+  }
+
+  TrackedObject &object = trackObject(CaptureObjectType::DescriptorSet, _id);
+  object.CreateInfo.write(set->second.Layout);
+  object.CreateInfo.write((uint32_t)set->second.Descriptors.size());
+  object.Dependencies.push_back(
+      {CaptureObjectType::DescriptorSetLayout, set->second.Layout});
+  for (const auto &[key, descriptor] : set->second.Descriptors) {
+    object.CreateInfo.write(descriptor);
+    if (hasDescriptorSampler(descriptor.Type)) {
+      object.Dependencies.push_back(
+          {CaptureObjectType::Sampler, toId(descriptor.ImageInfo.sampler)});
+    }
+    if (hasDescriptorImageView(descriptor.Type)) {
+      object.Dependencies.push_back({CaptureObjectType::ImageView,
+                                     toId(descriptor.ImageInfo.imageView)});
+    } else if (!isImageDescriptor(descriptor.Type)) {
+      object.Dependencies.push_back(
+          {CaptureObjectType::Buffer, toId(descriptor.BufferInfo.buffer)});
+    }
+  }
+}
+
+// Gathers what the frame used and everything that refers to, by type and in
+// order of id.
+static bool collectCapturedObjects(
+    EnumArray<CaptureObjectType, std::vector<uint64_t>> &_objects) {
+  std::vector<std::pair<CaptureObjectType, uint64_t>> pending;
+  for (int i = 0; i < (int)EnumCount<CaptureObjectType>; ++i) {
+    CaptureObjectType type = (CaptureObjectType)i;
+    for (uint64_t id : gCapture.UsedObjects[type]) {
+      pending.push_back({type, id});
+    }
+  }
+
+  EnumArray<CaptureObjectType, std::unordered_set<uint64_t>> collected;
+  while (!pending.empty()) {
+    auto [type, id] = pending.back();
+    pending.pop_back();
+    if (id == 0 || !collected[type].insert(id).second) {
+      continue;
+    }
+
+    if (type == CaptureObjectType::DescriptorSet) {
+      trackDescriptorSetObject(id);
+    }
+    auto object = gCapture.Objects[type].find(id);
+    if (object == gCapture.Objects[type].end()) {
+      printLine("Frame capture failed, the frame uses an untracked {}",
+                captureObjectTypeNames[type]);
+      return false;
+    }
+    pending.insert(pending.end(), object->second.Dependencies.begin(),
+                   object->second.Dependencies.end());
+  }
+
+  for (int i = 0; i < (int)EnumCount<CaptureObjectType>; ++i) {
+    CaptureObjectType type = (CaptureObjectType)i;
+    _objects[type].assign(collected[type].begin(), collected[type].end());
+    std::sort(_objects[type].begin(), _objects[type].end());
+  }
+  return true;
+}
+
+static VkMemoryPropertyFlags getMemoryFlags(uint64_t _id) {
+  auto memory = gCapture.BoundMemory.find(_id);
+  if (memory != gCapture.BoundMemory.end()) {
+    auto type = gCapture.MemoryTypes.find(memory->second);
+    if (type != gCapture.MemoryTypes.end()) {
+      return gCapture.MemoryProperties.memoryTypes[type->second].propertyFlags;
+    }
+  }
+  // Swap chain images
+  return VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+}
+
+template <typename T>
+static T readCreateInfo(CaptureObjectType _type, uint64_t _id) {
+  std::lock_guard<std::mutex> lock(gCaptureTrackingMutex);
+  const CaptureWriter &createInfo = gCapture.Objects[_type][_id].CreateInfo;
+  return CaptureReader{createInfo.Bytes.data(), createInfo.Bytes.size()}
+      .read<T>();
+}
+
+// Copies _size bytes into a staging buffer with _recordCopy, and appends them
+// to _file after their size.
+template <typename Fn>
+static void writeReadBack(FILE *_file, VkDeviceSize _size,
+                          const Fn &_recordCopy) {
+  const Renderer &renderer = *gCapture.Renderer;
+  Buffer stagingBuffer =
+      createBuffer(renderer, _size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                       VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  BB_DEFER(destroyBuffer(renderer, stagingBuffer));
+
+  VkCommandBuffer cmdBuffer = gCapture.ReadBackCmdBuffer;
+  BB_VK_ASSERT(vkResetCommandPool(renderer.Device, gCapture.CmdPool, 0));
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  BB_VK_ASSERT(vkBeginCommandBuffer(cmdBuffer, &beginInfo));
+  _recordCopy(cmdBuffer, stagingBuffer.Handle);
+  BB_VK_ASSERT(vkEndCommandBuffer(cmdBuffer));
+
+  VkSubmitInfo submitInfo = {};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &cmdBuffer;
+  BB_VK_ASSERT(
+      vkQueueSubmit(renderer.Queue, 1, &submitInfo, VK_NULL_HANDLE));
+  BB_VK_ASSERT(vkQueueWaitIdle(renderer.Queue));
+
+  void *data;
+  BB_VK_ASSERT(
+      vkMapMemory(renderer.Device, stagingBuffer.Memory, 0, _size, 0, &data));
+  uint64_t size = _size;
+  fwrite(&size, sizeof(size), 1, _file);
+  fwrite(data, 1, (size_t)_size, _file);
+  vkUnmapMemory(renderer.Device, stagingBuffer.Memory);
+}
+
+static void writeBufferContents(FILE *_file, uint64_t _id) {
+  VkBuffer buffer = fromId<VkBuffer>(_id);
+  VkBufferCreateInfo info =
+      readCreateInfo<VkBufferCreateInfo>(CaptureObjectType::Buffer, _id);
+  writeReadBack(_file, info.size,
+                [&](VkCommandBuffer _cmdBuffer, VkBuffer _stagingBuffer) {
+                  VkBufferCopy region = {0, 0, info.size};
+                  vkCmdCopyBuffer(_cmdBuffer, buffer, _stagingBuffer, 1,
+                                  &region);
+                });
+}
+
+static void writeImageContents(FILE *_file, uint64_t _id,
+                               VkImageLayout _layout) {
+  VkImage image = fromId<VkImage>(_id);
+  VkImageCreateInfo info =
+      readCreateInfo<VkImageCreateInfo>(CaptureObjectType::Image, _id);
+  std::vector<VkBufferImageCopy> regions;
+  VkDeviceSize size = getImageCopyRegions(info, regions);
+
+  writeReadBack(_file, size, [&](VkCommandBuffer _cmdBuffer,
+                                 VkBuffer _stagingBuffer) {
+    // Left in the layout the frame expects.
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.oldLayout = _layout;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = getWholeImageRange(info);
+    vkCmdPipelineBarrier(_cmdBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                         nullptr, 1, &barrier);
+
+    vkCmdCopyImageToBuffer(_cmdBuffer, image,
+                           VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           _stagingBuffer, (uint32_t)regions.size(),
+                           regions.data());
+
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask =
+        VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.newLayout = _layout;
+    vkCmdPipelineBarrier(_cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0,
+                         nullptr, 1, &barrier);
+  });
+}
+
+static VkImageLayout getCapturedImageLayout(uint64_t _id) {
+  auto layout = gCapture.ImageLayouts.find(_id);
+  return layout != gCapture.ImageLayouts.end() ? layout->second
+                                               : VK_IMAGE_LAYOUT_UNDEFINED;
+}
+
+// Images the frame reads before writing them, in a layout they can be copied
+// from.
+static bool hasImageContents(uint64_t _id) {
+  VkImageCreateInfo info =
+      readCreateInfo<VkImageCreateInfo>(CaptureObjectType::Image, _id);
+  VkImageLayout layout = getCapturedImageLayout(_id);
+  std::vector<VkBufferImageCopy> regions;
+  return layout != VK_IMAGE_LAYOUT_UNDEFINED &&
+         layout != VK_IMAGE_LAYOUT_PREINITIALIZED &&
+         layout != VK_IMAGE_LAYOUT_PRESENT_SRC_KHR &&
+         (info.usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) &&
+         getImageCopyRegions(info, regions) > 0;
+}
+
+static void resetCapturedFrame() {
+  gCapture.CommandStream = {};
+  gCapture.NumCommands = 0;
+  for (std::unordered_set<uint64_t> &objects : gCapture.UsedObjects) {
+    objects.clear();
+  }
+  gCapture.ImageLayouts.clear();
+}
+
+// The shaders, the create info of every object the frame uses and the
+// commands, everything but the contents of buffers and images.
+static bool writeCaptureHeader(
+    CaptureWriter &_header,
+    EnumArray<CaptureObjectType, std::vector<uint64_t>> &_objects) {
+  std::lock_guard<std::mutex> lock(gCaptureTrackingMutex);
+  if (!collectCapturedObjects(_objects)) {
+    return false;
+  }
+
+  _header.write(captureMagic);
+  _header.write(captureVersion);
+
+  std::vector<uint64_t> shaderHashes;
+  for (uint64_t pipeline : _objects[CaptureObjectType::Pipeline]) {
+    const std::vector<uint64_t> &hashes = gCapture.PipelineShaders[pipeline];
+    shaderHashes.insert(shaderHashes.end(), hashes.begin(), hashes.end());
+  }
+  std::sort(shaderHashes.begin(), shaderHashes.end());
+  shaderHashes.erase(std::unique(shaderHashes.begin(), shaderHashes.end()),
+                     shaderHashes.end());
+  _header.write((uint32_t)shaderHashes.size());
+  for (uint64_t hash : shaderHashes) {
+    const TrackedShader &shader = gCapture.Shaders[hash];
+    _header.write(hash);
+    _header.write(shader.Stage);
+    _header.writeArray(shader.FilePath.data(),
+                       (uint32_t)shader.FilePath.size());
+    _header.writeArray(shader.Code.data(), (uint32_t)shader.Code.size());
+  }
+
+  for (int i = 0; i < (int)EnumCount<CaptureObjectType>; ++i) {
+    CaptureObjectType type = (CaptureObjectType)i;
+    _header.write((uint32_t)_objects[type].size());
+    for (uint64_t id : _objects[type]) {
+      const CaptureWriter &createInfo = gCapture.Objects[type][id].CreateInfo;
+      _header.write(id);
+      _header.writeArray(createInfo.Bytes.data(),
+                         (uint32_t)createInfo.Bytes.size());
+      if (type == CaptureObjectType::Buffer ||
+          type == CaptureObjectType::Image) {
+        _header.write(getMemoryFlags(id));
+      }
+      if (type == CaptureObjectType::Image) {
+        _header.write(getCapturedImageLayout(id));
+      }
+      if (type == CaptureObjectType::Pipeline) {
+        _header.write(gCapture.PipelineHashes[id]);
+      }
+    }
+  }
+
+  _header.write(gCapture.NumCommands);
+  _header.writeArray(gCapture.CommandStream.Bytes.data(),
+                     (uint32_t)gCapture.CommandStream.Bytes.size());
+  return true;
+}
+
+bool endFrameCapture(const std::string &_filePath) {
+  BB_ASSERT(gCapture.CmdBuffer != VK_NULL_HANDLE);
+  pauseFrameCapture(true);
+  gCapture.CmdBuffer = VK_NULL_HANDLE;
+  BB_DEFER(resetCapturedFrame());
+
+  // Memory as the frame finds it, once the frames before are done with it.
+  vkDeviceWaitIdle(gCapture.Renderer->Device);
+
+  EnumArray<CaptureObjectType, std::vector<uint64_t>> objects;
+  CaptureWriter header;
+  if (!writeCaptureHeader(header, objects)) {
+    return false;
+  }
+
+  FILE *f = fopen(_filePath.c_str(), "wb");
+  if (!f) {
+    printLine("Failed to write {}", _filePath);
+    return false;
+  }
+  fwrite(header.Bytes.data(), 1, header.Bytes.size(), f);
+
+  const std::vector<uint64_t> &buffers = objects[CaptureObjectType::Buffer];
+  uint32_t numBuffers = (uint32_t)buffers.size();
+  fwrite(&numBuffers, sizeof(numBuffers), 1, f);
+  for (uint64_t id : buffers) {
+    fwrite(&id, sizeof(id), 1, f);
+    writeBufferContents(f, id);
+  }
+
+  std::vector<uint64_t> images;
+  for (uint64_t id : objects[CaptureObjectType::Image]) {
+    if (hasImageContents(id)) {
+      images.push_back(id);
+    }
+  }
+  uint32_t numImages = (uint32_t)images.size();
+  fwrite(&numImages, sizeof(numImages), 1, f);
+  for (uint64_t id : images) {
+    fwrite(&id, sizeof(id), 1, f);
+    writeImageContents(f, id, getCapturedImageLayout(id));
+  }
+
+  bool isWritten = ferror(f) == 0;
+  fclose(f);
+  if (!isWritten) {
+    printLine("Failed to write {}", _filePath);
+    return false;
+  }
+
+  printLine("Captured {} commands, {} pipelines, {} buffers and {} images to "
+            "{}",
+            gCapture.NumCommands, objects[CaptureObjectType::Pipeline].size(),
+            numBuffers, objects[CaptureObjectType::Image].size(), _filePath);
+  return true;
+}
+
+//
+// Replay
+//
+
+struct CapturedShader {
+  VkShaderStageFlagBits Stage;
+  std::string FilePath;
+  std::vector<uint8_t> Code;
+};
+
+struct CapturedObject {
+  uint64_t Id;
+  std::vector<uint8_t> CreateInfo;
+  // Buffers and images only.
+  VkMemoryPropertyFlags MemoryFlags;
+  // Images only.
+  VkImageLayout InitialLayout;
+  // Pipelines only.
+  uint64_t ParamsHash;
+};
+
+struct CapturedContents {
+  uint64_t Id;
+  const uint8_t *Data;
+  uint64_t Size;
+};
+
+struct FrameCapture {
+  std::vector<uint8_t> FileBytes;
+  std::unordered_map<uint64_t, CapturedShader> Shaders;
+  EnumArray<CaptureObjectType, std::vector<CapturedObject>> Objects;
+  uint32_t NumCommands;
+  std::vector<uint8_t> Commands;
+  // Point into FileBytes.
+  std::vector<CapturedContents> BufferContents;
+  std::vector<CapturedContents> ImageContents;
+};
+
+static bool readFrameCapture(const std::string &_filePath,
+                             FrameCapture &_capture) {
+  if (!readFile(_filePath, _capture.FileBytes)) {
+    printLine("Failed to read {}", _filePath);
+    return false;
+  }
+
+  CaptureReader reader = {_capture.FileBytes.data(),
+                          _capture.FileBytes.size()};
+  if (reader.read<uint32_t>() != captureMagic ||
+      reader.read<uint32_t>() != captureVersion) {
+    printLine("{} isn't a frame capture of this version", _filePath);
+    return false;
+  }
+
+  uint32_t numShaders = reader.read<uint32_t>();
+  for (uint32_t i = 0; i < numShaders && !reader.HasFailed; ++i) {
+    uint64_t hash = reader.read<uint64_t>();
+    CapturedShader &shader = _capture.Shaders[hash];
+    shader.Stage = reader.read<VkShaderStageFlagBits>();
+    std::vector<char> filePath = reader.readArray<char>();
+    shader.FilePath.assign(filePath.begin(), filePath.end());
+    shader.Code = reader.readArray<uint8_t>();
+  }
+
+  for (int i = 0; i < (int)EnumCount<CaptureObjectType>; ++i) {
+    CaptureObjectType type = (CaptureObjectType)i;
+    uint32_t numObjects = reader.read<uint32_t>();
+    for (uint32_t j = 0; j < numObjects && !reader.HasFailed; ++j) {
+      CapturedObject object = {};
+      object.Id = reader.read<uint64_t>();
+      object.CreateInfo = reader.readArray<uint8_t>();
+      if (type == CaptureObjectType::Buffer ||
+          type == CaptureObjectType::Image) {
+        object.MemoryFlags = reader.read<VkMemoryPropertyFlags>();
+      }
+      if (type == CaptureObjectType::Image) {
+        object.InitialLayout = reader.read<VkImageLayout>();
+      }
+      if (type == CaptureObjectType::Pipeline) {
+        object.ParamsHash = reader.read<uint64_t>();
+      }
+      _capture.Objects[type].push_back(std::move(object));
+    }
+  }
+
+  _capture.NumCommands = reader.read<uint32_t>();
+  _capture.Commands = reader.readArray<uint8_t>();
+
+  for (std::vector<CapturedContents> *contents :
+       {&_capture.BufferContents, &_capture.ImageContents}) {
+    uint32_t numContents = reader.read<uint32_t>();
+    for (uint32_t i = 0; i < numContents && !reader.HasFailed; ++i) {
+      CapturedContents content = {};
+      content.Id = reader.read<uint64_t>();
+      content.Size = reader.read<uint64_t>();
+      content.Data = reader.readBytes((size_t)content.Size);
+      contents->push_back(content);
+    }
+  }
+
+  if (reader.HasFailed) {
+    printLine("{} is truncated", _filePath);
+    return false;
+  }
+  return true;
+}
+
+// The replay has no swap chain to present to.
+static VkImageLayout patchLayout(VkImageLayout _layout) {
+  return _layout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+             ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+             : _layout;
+}
+
+struct ReplayObjects {
+  // By type and captured id, the handle the replay created.
+  EnumArray<CaptureObjectType, std::unordered_map<uint64_t, uint64_t>> Handles;
+  std::vector<VkDeviceMemory> Memories;
+  std::unordered_map<uint64_t, std::vector<VkDescriptorSetLayoutBinding>>
+      SetLayoutBindings;
+  VkDescriptorPool DescriptorPool;
+  // Modules and pipelines of the captured shaders, then of the shaders
+  // reloaded from their files. Pipelines whose shaders didn't change are
+  // shared.
+  std::unordered_map<uint64_t, VkShaderModule> ShaderModules[2];
+  std::unordered_map<uint64_t, VkPipeline> Pipelines[2];
+  std::unordered_set<uint64_t> ChangedShaders;
+  std::unordered_set<uint64_t> ChangedPipelines;
+};
+
+template <typename T>
+static T getReplayHandle(const ReplayObjects &_objects, CaptureObjectType _type,
+                         T _capturedHandle) {
+  const auto &handles = _objects.Handles[_type];
+  auto handle = handles.find(toId(_capturedHandle));
+  return handle != handles.end() ? fromId<T>(handle->second)
+                                 : (T)VK_NULL_HANDLE;
+}
+
+static bool allocateReplayMemory(const Renderer &_renderer,
+                                 ReplayObjects &_objects,
+                                 const VkMemoryRequirements &_requirements,
+                                 VkMemoryPropertyFlags _flags,
+                                 VkDeviceMemory &_memory) {
+  VkPhysicalDeviceMemoryProperties properties;
+  vkGetPhysicalDeviceMemoryProperties(_renderer.PhysicalDevice, &properties);
+
+  // Falls back to any type the resource allows, for devices without the one
+  // it was captured with.
+  constexpr VkMemoryPropertyFlags hostFlags =
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  VkMemoryPropertyFlags candidates[] = {
+      _flags & (hostFlags | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+      _flags & hostFlags, 0};
+  for (VkMemoryPropertyFlags candidate : candidates) {
+    for (uint32_t i = 0; i < properties.memoryTypeCount; ++i) {
+      if ((_requirements.memoryTypeBits & (1 << i)) &&
+          (properties.memoryTypes[i].propertyFlags & candidate) == candidate) {
+        VkMemoryAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = _requirements.size;
+        allocInfo.memoryTypeIndex = i;
+        if (vkAllocateMemory(_renderer.Device, &allocInfo, nullptr,
+                             &_memory) != VK_SUCCESS) {
+          return false;
+        }
+        _objects.Memories.push_back(_memory);
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+static bool createReplayRenderPass(const Renderer &_renderer,
+                                   CaptureReader &_reader,
+                                   VkRenderPass &_renderPass) {
+  VkRenderPassCreateInfo info = {};
+  info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  info.flags = _reader.read<VkRenderPassCreateFlags>();
+  std::vector<VkAttachmentDescription> attachments =
+      _reader.readArray<VkAttachmentDescription>();
+  for (VkAttachmentDescription &attachment : attachments) {
+    attachment.initialLayout = patchLayout(attachment.initialLayout);
+    attachment.finalLayout = patchLayout(attachment.finalLayout);
+  }
+  info.attachmentCount = (uint32_t)attachments.size();
+  info.pAttachments = attachments.data();
+
+  uint32_t numSubpasses = _reader.read<uint32_t>();
+  std::vector<VkSubpassDescription> subpasses(numSubpasses);
+  std::vector<std::vector<VkAttachmentReference>> references(numSubpasses *
+                                                             4);
+  std::vector<std::vector<uint32_t>> preserveAttachments(numSubpasses);
+  for (uint32_t i = 0; i < numSubpasses && !_reader.HasFailed; ++i) {
+    VkSubpassDescription &subpass = subpasses[i];
+    subpass.flags = _reader.read<VkSubpassDescriptionFlags>();
+    subpass.pipelineBindPoint = _reader.read<VkPipelineBindPoint>();
+    std::vector<VkAttachmentReference> *subpassReferences = &references[i * 4];
+    for (int j = 0; j < 4; ++j) {
+      subpassReferences[j] = _reader.readArray<VkAttachmentReference>();
+    }
+    preserveAttachments[i] = _reader.readArray<uint32_t>();
+
+    subpass.inputAttachmentCount = (uint32_t)subpassReferences[0].size();
+    subpass.pInputAttachments = subpassReferences[0].data();
+    subpass.colorAttachmentCount = (uint32_t)subpassReferences[1].size();
+    subpass.pColorAttachments = subpassReferences[1].data();
+    subpass.pResolveAttachments =
+        subpassReferences[2].empty() ? nullptr : subpassReferences[2].data();
+    subpass.pDepthStencilAttachment =
+        subpassReferences[3].empty() ? nullptr : subpassReferences[3].data();
+    subpass.preserveAttachmentCount = (uint32_t)preserveAttachments[i].size();
+    subpass.pPreserveAttachments = preserveAttachments[i].data();
+  }
+  info.subpassCount = numSubpasses;
+  info.pSubpasses = subpasses.data();
+
+  std::vector<VkSubpassDependency> dependencies =
+      _reader.readArray<VkSubpassDependency>();
+  info.dependencyCount = (uint32_t)dependencies.size();
+  info.pDependencies = dependencies.data();
+
+  std::vector<uint32_t> viewMasks = _reader.readArray<uint32_t>();
+  std::vector<int32_t> viewOffsets = _reader.readArray<int32_t>();
+  std::vector<uint32_t> correlationMasks = _reader.readArray<uint32_t>();
+  VkRenderPassMultiviewCreateInfo multiviewInfo = {};
+  multiviewInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO;
+  if (!viewMasks.empty()) {
+    multiviewInfo.subpassCount = (uint32_t)viewMasks.size();
+    multiviewInfo.pViewMasks = viewMasks.data();
+    multiviewInfo.dependencyCount = (uint32_t)viewOffsets.size();
+    multiviewInfo.pViewOffsets = viewOffsets.data();
+    multiviewInfo.correlationMaskCount = (uint32_t)correlationMasks.size();
+    multiviewInfo.pCorrelationMasks = correlationMasks.data();
+    if (!_renderer.SupportsMultiview) {
+      printLine("The capture needs multiview, which the device lacks");
+      return false;
+    }
+    info.pNext = &multiviewInfo;
+  }
+
+  return !_reader.HasFailed &&
+         vkCreateRenderPass(_renderer.Device, &info, nullptr, &_renderPass) ==
+             VK_SUCCESS;
+}
+
+// Rebuilds a pipeline from its captured params with the shader modules of
+// _variant.
+static VkPipeline createReplayPipeline(const Renderer &_renderer,
+                                       const ReplayObjects &_objects,
+                                       const FrameCapture &_capture,
+                                       const CapturedObject &_pipeline,
+                                       int _variant) {
+  CaptureReader reader = {_pipeline.CreateInfo.data(),
+                          _pipeline.CreateInfo.size()};
+  uint32_t numShaders = reader.read<uint32_t>();
+  std::vector<Shader> shaders(numShaders);
+  std::vector<const Shader *> shaderPtrs(numShaders);
+  for (uint32_t i = 0; i < numShaders; ++i) {
+    uint64_t hash = reader.read<uint64_t>();
+    auto shader = _capture.Shaders.find(hash);
+    auto module = _objects.ShaderModules[_variant].find(hash);
+    if (shader == _capture.Shaders.end() ||
+        module == _objects.ShaderModules[_variant].end()) {
+      return VK_NULL_HANDLE;
+    }
+    shaders[i].Stage = shader->second.Stage;
+    shaders[i].Handle = module->second;
+    shaderPtrs[i] = &shaders[i];
+  }
+
+  std::vector<VkVertexInputBindingDescription> bindings =
+      reader.readArray<VkVertexInputBindingDescription>();
+  std::vector<VkVertexInputAttributeDescription> attributes =
+      reader.readArray<VkVertexInputAttributeDescription>();
+
+  PipelineParams params = {};
+  params.Shaders = shaderPtrs.data();
+  params.NumShaders = (int)numShaders;
+  params.VertexInput.Bindings = bindings.data();
+  params.VertexInput.NumBindings = (int)bindings.size();
+  params.VertexInput.Attributes = attributes.data();
+  params.VertexInput.NumAttributes = (int)attributes.size();
+  params.InputAssembly.Topology = reader.read<VkPrimitiveTopology>();
+  params.Viewport.Offset = reader.read<Float2>();
+  params.Viewport.Extent = reader.read<Float2>();
+  params.Viewport.ScissorOffset = reader.read<Int2>();
+  params.Viewport.ScissorExtent = reader.read<Int2>();
+  params.Viewport.IsDynamic = reader.read<uint8_t>() != 0;
+  params.Rasterizer.PolygonMode = reader.read<VkPolygonMode>();
+  params.Rasterizer.CullMode = reader.read<VkCullModeFlags>();
+  params.DepthStencil.DepthTestEnable = reader.read<uint8_t>() != 0;
+  params.DepthStencil.DepthWriteEnable = reader.read<uint8_t>() != 0;
+  params.Blend.NumColorBlends = reader.read<uint32_t>();
+  params.Blend.DisableColorWrites = reader.read<uint8_t>() != 0;
+  params.Subpass = reader.read<uint32_t>();
+  params.PipelineLayout =
+      getReplayHandle(_objects, CaptureObjectType::PipelineLayout,
+                      fromId<VkPipelineLayout>(reader.read<uint64_t>()));
+  params.RenderPass =
+      getReplayHandle(_objects, CaptureObjectType::RenderPass,
+                      fromId<VkRenderPass>(reader.read<uint64_t>()));
+  if (reader.HasFailed) {
+    return VK_NULL_HANDLE;
+  }
+  return createPipeline(_renderer, params);
+}
+
+static bool createReplayObjects(const Renderer &_renderer,
+                                const FrameCapture &_capture,
+                                bool _reloadShaders, ReplayObjects &_objects) {
+  VkDevice device = _renderer.Device;
+  auto addHandle = [&](CaptureObjectType _type, uint64_t _id, auto _handle) {
+    _objects.Handles[_type][_id] = toId(_handle);
+  };
+
+  for (const CapturedObject &object :
+       _capture.Objects[CaptureObjectType::Sampler]) {
+    VkSamplerCreateInfo info =
+        CaptureReader{object.CreateInfo.data(), object.CreateInfo.size()}
+            .read<VkSamplerCreateInfo>();
+    info.pNext = nullptr;
+    VkSampler sampler;
+    if (vkCreateSampler(device, &info, nullptr, &sampler) != VK_SUCCESS) {
+      return false;
+    }
+    addHandle(CaptureObjectType::Sampler, object.Id, sampler);
+  }
+
+  for (const CapturedObject &object :
+       _capture.Objects[CaptureObjectType::Image]) {
+    VkImageCreateInfo info =
+        CaptureReader{object.CreateInfo.data(), object.CreateInfo.size()}
+            .read<VkImageCreateInfo>();
+    info.pNext = nullptr;
+    info.pQueueFamilyIndices = nullptr;
+    info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (!(info.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT)) {
+      info.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    }
+    VkImage image;
+    if (vkCreateImage(device, &info, nullptr, &image) != VK_SUCCESS) {
+      return false;
+    }
+    addHandle(CaptureObjectType::Image, object.Id, image);
+
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(device, image, &requirements);
+    VkDeviceMemory memory;
+    if (!allocateReplayMemory(_renderer, _objects, requirements,
+                              object.MemoryFlags, memory)) {
+      return false;
+    }
+    BB_VK_ASSERT(vkBindImageMemory(device, image, memory, 0));
+  }
+
+  for (const CapturedObject &object :
+       _capture.Objects[CaptureObjectType::Buffer]) {
+    VkBufferCreateInfo info =
+        CaptureReader{object.CreateInfo.data(), object.CreateInfo.size()}
+            .read<VkBufferCreateInfo>();
+    info.pNext = nullptr;
+    info.pQueueFamilyIndices = nullptr;
+    info.usage |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    VkBuffer buffer;
+    if (vkCreateBuffer(device, &info, nullptr, &buffer) != VK_SUCCESS) {
+      return false;
+    }
+    addHandle(CaptureObjectType::Buffer, object.Id, buffer);
+
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(device, buffer, &requirements);
+    VkDeviceMemory memory;
+    if (!allocateReplayMemory(_renderer, _objects, requirements,
+                              object.MemoryFlags, memory)) {
+      return false;
+    }
+    BB_VK_ASSERT(vkBindBufferMemory(device, buffer, memory, 0));
+  }
+
+  for (const CapturedObject &object :
+       _capture.Objects[CaptureObjectType::ImageView]) {
+    VkImageViewCreateInfo info =
+        CaptureReader{object.CreateInfo.data(), object.CreateInfo.size()}
+            .read<VkImageViewCreateInfo>();
+    info.pNext = nullptr;
+    info.image =
+        getReplayHandle(_objects, CaptureObjectType::Image, info.image);
+    VkImageView view;
+    if (vkCreateImageView(device, &info, nullptr, &view) != VK_SUCCESS) {
+      return false;
+    }
+    addHandle(CaptureObjectType::ImageView, object.Id, view);
+  }
+
+  for (const CapturedObject &object :
+       _capture.Objects[CaptureObjectType::RenderPass]) {
+    CaptureReader reader = {object.CreateInfo.data(),
+                            object.CreateInfo.size()};
+    VkRenderPass renderPass;
+    if (!createReplayRenderPass(_renderer, reader, renderPass)) {
+      return false;
+    }
+    addHandle(CaptureObjectType::RenderPass, object.Id, renderPass);
+  }
+
+  for (const CapturedObject &object :
+       _capture.Objects[CaptureObjectType::Framebuffer]) {
+    CaptureReader reader = {object.CreateInfo.data(),
+                            object.CreateInfo.size()};
+    VkFramebufferCreateInfo info = reader.read<VkFramebufferCreateInfo>();
+    std::vector<VkImageView> attachments = reader.readArray<VkImageView>();
+    for (VkImageView &attachment : attachments) {
+      attachment =
+          getReplayHandle(_objects, CaptureObjectType::ImageView, attachment);
+    }
+    info.pNext = nullptr;
+    info.renderPass = getReplayHandle(_objects, CaptureObjectType::RenderPass,
+                                      info.renderPass);
+    info.attachmentCount = (uint32_t)attachments.size();
+    info.pAttachments = attachments.data();
+    VkFramebuffer framebuffer;
+    if (vkCreateFramebuffer(device, &info, nullptr, &framebuffer) !=
+        VK_SUCCESS) {
+      return false;
+    }
+    addHandle(CaptureObjectType::Framebuffer, object.Id, framebuffer);
+  }
+
+  for (const CapturedObject &object :
+       _capture.Objects[CaptureObjectType::DescriptorSetLayout]) {
+    CaptureReader reader = {object.CreateInfo.data(),
+                            object.CreateInfo.size()};
+    VkDescriptorSetLayoutCreateInfo info =
+        reader.read<VkDescriptorSetLayoutCreateInfo>();
+    std::vector<VkDescriptorSetLayoutBinding> bindings =
+        reader.readArray<VkDescriptorSetLayoutBinding>();
+    std::vector<std::vector<VkSampler>> samplers(bindings.size());
+    for (size_t i = 0; i < bindings.size(); ++i) {
+      samplers[i] = reader.readArray<VkSampler>();
+      for (VkSampler &sampler : samplers[i]) {
+        sampler =
+            getReplayHandle(_objects, CaptureObjectType::Sampler, sampler);
+      }
+      bindings[i].pImmutableSamplers =
+          samplers[i].empty() ? nullptr : samplers[i].data();
+    }
+    info.pNext = nullptr;
+    info.bindingCount = (uint32_t)bindings.size();
+    info.pBindings = bindings.data();
+    VkDescriptorSetLayout layout;
+    if (vkCreateDescriptorSetLayout(device, &info, nullptr, &layout) !=
+        VK_SUCCESS) {
+      return false;
+    }
+    addHandle(CaptureObjectType::DescriptorSetLayout, object.Id, layout);
+    _objects.SetLayoutBindings[object.Id] = bindings;
+  }
+
+  for (const CapturedObject &object :
+       _capture.Objects[CaptureObjectType::PipelineLayout]) {
+    CaptureReader reader = {object.CreateInfo.data(),
+                            object.CreateInfo.size()};
+    VkPipelineLayoutCreateInfo info = reader.read<VkPipelineLayoutCreateInfo>();
+    std::vector<VkDescriptorSetLayout> setLayouts =
+        reader.readArray<VkDescriptorSetLayout>();
+    std::vector<VkPushConstantRange> pushConstantRanges =
+        reader.readArray<VkPushConstantRange>();
+    for (VkDescriptorSetLayout &setLayout : setLayouts) {
+      setLayout = getReplayHandle(
+          _objects, CaptureObjectType::DescriptorSetLayout, setLayout);
+    }
+    info.pNext = nullptr;
+    info.setLayoutCount = (uint32_t)setLayouts.size();
+    info.pSetLayouts = setLayouts.data();
+    info.pushConstantRangeCount = (uint32_t)pushConstantRanges.size();
+    info.pPushConstantRanges = pushConstantRanges.data();
+    VkPipelineLayout layout;
+    if (vkCreatePipelineLayout(device, &info, nullptr, &layout) !=
+        VK_SUCCESS) {
+      return false;
+    }
+    addHandle(CaptureObjectType::PipelineLayout, object.Id, layout);
+  }
+
+  // One pool fits every captured set.
+  const std::vector<CapturedObject> &sets =
+      _capture.Objects[CaptureObjectType::DescriptorSet];
+  std::map<VkDescriptorType, uint32_t> numDescriptors;
+  for (const CapturedObject &set : sets) {
+    uint64_t layout =
+        CaptureReader{set.CreateInfo.data(), set.CreateInfo.size()}
+            .read<uint64_t>();
+    for (const VkDescriptorSetLayoutBinding &binding :
+         _objects.SetLayoutBindings[layout]) {
+      numDescriptors[binding.descriptorType] += binding.descriptorCount;
+    }
+  }
+  if (!sets.empty()) {
+    std::vector<VkDescriptorPoolSize> poolSizes;
+    for (const auto &[type, count] : numDescriptors) {
+      poolSizes.push_back({type, count});
+    }
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = (uint32_t)sets.size();
+    poolInfo.poolSizeCount = (uint32_t)poolSizes.size();
+    poolInfo.pPoolSizes = poolSizes.data();
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr,
+                               &_objects.DescriptorPool) != VK_SUCCESS) {
+      return false;
+    }
+  }
+
+  for (const CapturedObject &object : sets) {
+    CaptureReader reader = {object.CreateInfo.data(),
+                            object.CreateInfo.size()};
+    VkDescriptorSetLayout layout =
+        getReplayHandle(_objects, CaptureObjectType::DescriptorSetLayout,
+                        fromId<VkDescriptorSetLayout>(reader.read<uint64_t>()));
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = _objects.DescriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &layout;
+    VkDescriptorSet set;
+    if (vkAllocateDescriptorSets(device, &allocInfo, &set) != VK_SUCCESS) {
+      return false;
+    }
+    addHandle(CaptureObjectType::DescriptorSet, object.Id, set);
+
+    uint32_t numSetDescriptors = reader.read<uint32_t>();
+    std::vector<TrackedDescriptor> descriptors(numSetDescriptors);
+    std::vector<VkWriteDescriptorSet> writes(numSetDescriptors);
+    for (uint32_t i = 0; i < numSetDescriptors && !reader.HasFailed; ++i) {
+      TrackedDescriptor &descriptor = descriptors[i];
+      descriptor = reader.read<TrackedDescriptor>();
+      VkDescriptorImageInfo &imageInfo = descriptor.ImageInfo;
+      imageInfo.sampler =
+          hasDescriptorSampler(descriptor.Type)
+              ? getReplayHandle(_objects, CaptureObjectType::Sampler,
+                                imageInfo.sampler)
+              : VK_NULL_HANDLE;
+      imageInfo.imageView =
+          hasDescriptorImageView(descriptor.Type)
+              ? getReplayHandle(_objects, CaptureObjectType::ImageView,
+                                imageInfo.imageView)
+              : VK_NULL_HANDLE;
+      imageInfo.imageLayout = patchLayout(imageInfo.imageLayout);
+      descriptor.BufferInfo.buffer = getReplayHandle(
+          _objects, CaptureObjectType::Buffer, descriptor.BufferInfo.buffer);
+
+      VkWriteDescriptorSet &write = writes[i];
+      write = {};
+      write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      write.dstSet = set;
+      write.dstBinding = descriptor.Binding;
+      write.dstArrayElement = descriptor.ArrayElement;
+      write.descriptorCount = 1;
+      write.descriptorType = descriptor.Type;
+      if (isImageDescriptor(descriptor.Type)) {
+        write.pImageInfo = &descriptor.ImageInfo;
+      } else {
+        write.pBufferInfo = &descriptor.BufferInfo;
+      }
+    }
+    if (reader.HasFailed) {
+      return false;
+    }
+    vkUpdateDescriptorSets(device, (uint32_t)writes.size(), writes.data(), 0,
+                           nullptr);
+  }
+
+  for (const auto &[hash, shader] : _capture.Shaders) {
+    VkShaderModuleCreateInfo moduleInfo = {};
+    moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    moduleInfo.codeSize = shader.Code.size();
+    moduleInfo.pCode = (const uint32_t *)shader.Code.data();
+    VkShaderModule module;
+    if (vkCreateShaderModule(device, &moduleInfo, nullptr, &module) !=
+        VK_SUCCESS) {
+      return false;
+    }
+    _objects.ShaderModules[0][hash] = module;
+    _objects.ShaderModules[1][hash] = module;
+
+    // Shaders whose files are gone keep their captured code.
+    std::vector<uint8_t> code;
+    if (!_reloadShaders || !readFile(createShaderPath(shader.FilePath), code) ||
+        code == shader.Code) {
+      continue;
+    }
+    moduleInfo.codeSize = code.size();
+    moduleInfo.pCode = (const uint32_t *)code.data();
+    if (vkCreateShaderModule(device, &moduleInfo, nullptr, &module) !=
+        VK_SUCCESS) {
+      printLine("Failed to create the reloaded {}", shader.FilePath);
+      return false;
+    }
+    _objects.ShaderModules[1][hash] = module;
+    _objects.ChangedShaders.insert(hash);
+  }
+
+  for (const CapturedObject &object :
+       _capture.Objects[CaptureObjectType::Pipeline]) {
+    VkPipeline pipeline =
+        createReplayPipeline(_renderer, _objects, _capture, object, 0);
+    if (pipeline == VK_NULL_HANDLE) {
+      return false;
+    }
+    _objects.Pipelines[0][object.Id] = pipeline;
+    _objects.Pipelines[1][object.Id] = pipeline;
+
+    CaptureReader reader = {object.CreateInfo.data(),
+                            object.CreateInfo.size()};
+    uint32_t numShaders = reader.read<uint32_t>();
+    for (uint32_t i = 0; i < numShaders; ++i) {
+      if (_objects.ChangedShaders.count(reader.read<uint64_t>())) {
+        _objects.ChangedPipelines.insert(object.Id);
+      }
+    }
+    if (_objects.ChangedPipelines.count(object.Id)) {
+      pipeline = createReplayPipeline(_renderer, _objects, _capture, object, 1);
+      if (pipeline == VK_NULL_HANDLE) {
+        return false;
+      }
+      _objects.Pipelines[1][object.Id] = pipeline;
+    }
+  }
+
+  return true;
+}
+
+static void destroyReplayObjects(const Renderer &_renderer,
+                                 ReplayObjects &_objects) {
+  VkDevice device = _renderer.Device;
+  for (const auto &[id, pipeline] : _objects.Pipelines[1]) {
+    if (_objects.ChangedPipelines.count(id)) {
+      vkDestroyPipeline(device, pipeline, nullptr);
+    }
+  }
+  for (const auto &[id, pipeline] : _objects.Pipelines[0]) {
+    vkDestroyPipeline(device, pipeline, nullptr);
+  }
+  for (const auto &[hash, module] : _objects.ShaderModules[1]) {
+    if (_objects.ChangedShaders.count(hash)) {
+      vkDestroyShaderModule(device, module, nullptr);
+    }
+  }
+  for (const auto &[hash, module] : _objects.ShaderModules[0]) {
+    vkDestroyShaderModule(device, module, nullptr);
+  }
+  if (_objects.DescriptorPool != VK_NULL_HANDLE) {
+    vkDestroyDescriptorPool(device, _objects.DescriptorPool, nullptr);
+  }
+
+  for (const auto &[id, handle] :
+       _objects.Handles[CaptureObjectType::PipelineLayout]) {
+    vkDestroyPipelineLayout(device, fromId<VkPipelineLayout>(handle), nullptr);
+  }
+  for (const auto &[id, handle] :
+       _objects.Handles[CaptureObjectType::DescriptorSetLayout]) {
+    vkDestroyDescriptorSetLayout(device, fromId<VkDescriptorSetLayout>(handle),
+                                 nullptr);
+  }
+  for (const auto &[id, handle] :
+       _objects.Handles[CaptureObjectType::Framebuffer]) {
+    vkDestroyFramebuffer(device, fromId<VkFramebuffer>(handle), nullptr);
+  }
+  for (const auto &[id, handle] :
+       _objects.Handles[CaptureObjectType::RenderPass]) {
+    vkDestroyRenderPass(device, fromId<VkRenderPass>(handle), nullptr);
+  }
+  for (const auto &[id, handle] :
+       _objects.Handles[CaptureObjectType::ImageView]) {
+    vkDestroyImageView(device, fromId<VkImageView>(handle), nullptr);
+  }
+  for (const auto &[id, handle] :
+       _objects.Handles[CaptureObjectType::Buffer]) {
+    vkDestroyBuffer(device, fromId<VkBuffer>(handle), nullptr);
+  }
+  for (const auto &[id, handle] : _objects.Handles[CaptureObjectType::Image]) {
+    vkDestroyImage(device, fromId<VkImage>(handle), nullptr);
+  }
+  for (const auto &[id, handle] :
+       _objects.Handles[CaptureObjectType::Sampler]) {
+    vkDestroySampler(device, fromId<VkSampler>(handle), nullptr);
+  }
+  for (VkDeviceMemory memory : _objects.Memories) {
+    vkFreeMemory(device, memory, nullptr);
+  }
+}
+
+// Records the captured commands with the replay's objects, and the pipelines
+// of _variant.
+static bool recordReplayCommands(VkCommandBuffer _cmdBuffer,
+                                 const FrameCapture &_capture,
+                                 const ReplayObjects &_objects, int _variant) {
+  CaptureReader reader = {_capture.Commands.data(), _capture.Commands.size()};
+  auto getBuffer = [&](uint64_t _id) {
+    return getReplayHandle(_objects, CaptureObjectType::Buffer,
+                           fromId<VkBuffer>(_id));
+  };
+  auto getImage = [&](uint64_t _id) {
+    return getReplayHandle(_objects, CaptureObjectType::Image,
+                           fromId<VkImage>(_id));
+  };
+  auto getPipelineLayout = [&](uint64_t _id) {
+    return getReplayHandle(_objects, CaptureObjectType::PipelineLayout,
+                           fromId<VkPipelineLayout>(_id));
+  };
+
+  for (uint32_t i = 0; i < _capture.NumCommands && !reader.HasFailed; ++i) {
+    switch (reader.read<CaptureCommandType>()) {
+    case CaptureCommandType::BeginRenderPass: {
+      VkRenderPassBeginInfo info = reader.read<VkRenderPassBeginInfo>();
+      std::vector<VkClearValue> clearValues = reader.readArray<VkClearValue>();
+      VkSubpassContents contents = reader.read<VkSubpassContents>();
+      info.pNext = nullptr;
+      info.renderPass = getReplayHandle(
+          _objects, CaptureObjectType::RenderPass, info.renderPass);
+      info.framebuffer = getReplayHandle(
+          _objects, CaptureObjectType::Framebuffer, info.framebuffer);
+      info.clearValueCount = (uint32_t)clearValues.size();
+      info.pClearValues = clearValues.data();
+      vkCmdBeginRenderPass(_cmdBuffer, &info, contents);
+      break;
+    }
+    case CaptureCommandType::NextSubpass:
+      vkCmdNextSubpass(_cmdBuffer, reader.read<VkSubpassContents>());
+      break;
+    case CaptureCommandType::EndRenderPass:
+      vkCmdEndRenderPass(_cmdBuffer);
+      break;
+    case CaptureCommandType::BindPipeline: {
+      VkPipelineBindPoint bindPoint = reader.read<VkPipelineBindPoint>();
+      const auto &pipelines = _objects.Pipelines[_variant];
+      auto pipeline = pipelines.find(reader.read<uint64_t>());
+      if (pipeline == pipelines.end()) {
+        return false;
+      }
+      vkCmdBindPipeline(_cmdBuffer, bindPoint, pipeline->second);
+      break;
+    }
+    case CaptureCommandType::BindDescriptorSets: {
+      VkPipelineBindPoint bindPoint = reader.read<VkPipelineBindPoint>();
+      VkPipelineLayout layout = getPipelineLayout(reader.read<uint64_t>());
+      uint32_t firstSet = reader.read<uint32_t>();
+      std::vector<VkDescriptorSet> sets = reader.readArray<VkDescriptorSet>();
+      std::vector<uint32_t> dynamicOffsets = reader.readArray<uint32_t>();
+      for (VkDescriptorSet &set : sets) {
+        set = getReplayHandle(_objects, CaptureObjectType::DescriptorSet, set);
+      }
+      vkCmdBindDescriptorSets(_cmdBuffer, bindPoint, layout, firstSet,
+                              (uint32_t)sets.size(), sets.data(),
+                              (uint32_t)dynamicOffsets.size(),
+                              dynamicOffsets.data());
+      break;
+    }
+    case CaptureCommandType::BindVertexBuffers: {
+      uint32_t firstBinding = reader.read<uint32_t>();
+      std::vector<VkBuffer> buffers = reader.readArray<VkBuffer>();
+      std::vector<VkDeviceSize> offsets = reader.readArray<VkDeviceSize>();
+      for (VkBuffer &buffer : buffers) {
+        buffer = getBuffer(toId(buffer));
+      }
+      vkCmdBindVertexBuffers(_cmdBuffer, firstBinding, (uint32_t)buffers.size(),
+                             buffers.data(), offsets.data());
+      break;
+    }
+    case CaptureCommandType::BindIndexBuffer: {
+      VkBuffer buffer = getBuffer(reader.read<uint64_t>());
+      VkDeviceSize offset = reader.read<VkDeviceSize>();
+      VkIndexType indexType = reader.read<VkIndexType>();
+      vkCmdBindIndexBuffer(_cmdBuffer, buffer, offset, indexType);
+      break;
+    }
+    case CaptureCommandType::PushConstants: {
+      VkPipelineLayout layout = getPipelineLayout(reader.read<uint64_t>());
+      VkShaderStageFlags stages = reader.read<VkShaderStageFlags>();
+      uint32_t offset = reader.read<uint32_t>();
+      std::vector<uint8_t> values = reader.readArray<uint8_t>();
+      vkCmdPushConstants(_cmdBuffer, layout, stages, offset,
+                         (uint32_t)values.size(), values.data());
+      break;
+    }
+    case CaptureCommandType::SetViewport: {
+      uint32_t firstViewport = reader.read<uint32_t>();
+      std::vector<VkViewport> viewports = reader.readArray<VkViewport>();
+      vkCmdSetViewport(_cmdBuffer, firstViewport, (uint32_t)viewports.size(),
+                       viewports.data());
+      break;
+    }
+    case CaptureCommandType::SetScissor: {
+      uint32_t firstScissor = reader.read<uint32_t>();
+      std::vector<VkRect2D> scissors = reader.readArray<VkRect2D>();
+      vkCmdSetScissor(_cmdBuffer, firstScissor, (uint32_t)scissors.size(),
+                      scissors.data());
+      break;
+    }
+    case CaptureCommandType::Draw: {
+      uint32_t numVertices = reader.read<uint32_t>();
+      uint32_t numInstances = reader.read<uint32_t>();
+      uint32_t firstVertex = reader.read<uint32_t>();
+      uint32_t firstInstance = reader.read<uint32_t>();
+      vkCmdDraw(_cmdBuffer, numVertices, numInstances, firstVertex,
+                firstInstance);
+      break;
+    }
+    case CaptureCommandType::DrawIndexed: {
+      uint32_t numIndices = reader.read<uint32_t>();
+      uint32_t numInstances = reader.read<uint32_t>();
+      uint32_t firstIndex = reader.read<uint32_t>();
+      int32_t vertexOffset = reader.read<int32_t>();
+      uint32_t firstInstance = reader.read<uint32_t>();
+      vkCmdDrawIndexed(_cmdBuffer, numIndices, numInstances, firstIndex,
+                       vertexOffset, firstInstance);
+      break;
+    }
+    case CaptureCommandType::PipelineBarrier: {
+      VkPipelineStageFlags srcStages = reader.read<VkPipelineStageFlags>();
+      VkPipelineStageFlags dstStages = reader.read<VkPipelineStageFlags>();
+      VkDependencyFlags dependencyFlags = reader.read<VkDependencyFlags>();
+      std::vector<VkMemoryBarrier> memoryBarriers =
+          reader.readArray<VkMemoryBarrier>();
+      std::vector<VkBufferMemoryBarrier> bufferBarriers =
+          reader.readArray<VkBufferMemoryBarrier>();
+      std::vector<VkImageMemoryBarrier> imageBarriers =
+          reader.readArray<VkImageMemoryBarrier>();
+      for (VkMemoryBarrier &barrier : memoryBarriers) {
+        barrier.pNext = nullptr;
+      }
+      for (VkBufferMemoryBarrier &barrier : bufferBarriers) {
+        barrier.pNext = nullptr;
+        barrier.buffer = getBuffer(toId(barrier.buffer));
+      }
+      for (VkImageMemoryBarrier &barrier : imageBarriers) {
+        barrier.pNext = nullptr;
+        barrier.image = getImage(toId(barrier.image));
+        barrier.oldLayout = patchLayout(barrier.oldLayout);
+        barrier.newLayout = patchLayout(barrier.newLayout);
+      }
+      vkCmdPipelineBarrier(
+          _cmdBuffer, srcStages, dstStages, dependencyFlags,
+          (uint32_t)memoryBarriers.size(), memoryBarriers.data(),
+          (uint32_t)bufferBarriers.size(), bufferBarriers.data(),
+          (uint32_t)imageBarriers.size(), imageBarriers.data());
+      break;
+    }
+    case CaptureCommandType::ClearAttachments: {
+      std::vector<VkClearAttachment> attachments =
+          reader.readArray<VkClearAttachment>();
+      std::vector<VkClearRect> rects = reader.readArray<VkClearRect>();
+      vkCmdClearAttachments(_cmdBuffer, (uint32_t)attachments.size(),
+                            attachments.data(), (uint32_t)rects.size(),
+                            rects.data());
+      break;
+    }
+    case CaptureCommandType::ClearDepthStencilImage: {
+      VkImage image = getImage(reader.read<uint64_t>());
+      VkImageLayout layout = reader.read<VkImageLayout>();
+      VkClearDepthStencilValue value = reader.read<VkClearDepthStencilValue>();
+      std::vector<VkImageSubresourceRange> ranges =
+          reader.readArray<VkImageSubresourceRange>();
+      vkCmdClearDepthStencilImage(_cmdBuffer, image, layout, &value,
+                                  (uint32_t)ranges.size(), ranges.data());
+      break;
+    }
+    case CaptureCommandType::CopyBuffer: {
+      VkBuffer srcBuffer = getBuffer(reader.read<uint64_t>());
+      VkBuffer dstBuffer = getBuffer(reader.read<uint64_t>());
+      std::vector<VkBufferCopy> regions = reader.readArray<VkBufferCopy>();
+      vkCmdCopyBuffer(_cmdBuffer, srcBuffer, dstBuffer,
+                      (uint32_t)regions.size(), regions.data());
+      break;
+    }
+    case CaptureCommandType::CopyBufferToImage: {
+      VkBuffer srcBuffer = getBuffer(reader.read<uint64_t>());
+      VkImage dstImage = getImage(reader.read<uint64_t>());
+      VkImageLayout dstLayout = reader.read<VkImageLayout>();
+      std::vector<VkBufferImageCopy> regions =
+          reader.readArray<VkBufferImageCopy>();
+      vkCmdCopyBufferToImage(_cmdBuffer, srcBuffer, dstImage, dstLayout,
+                             (uint32_t)regions.size(), regions.data());
+      break;
+    }
+    case CaptureCommandType::CopyImage: {
+      VkImage srcImage = getImage(reader.read<uint64_t>());
+      VkImageLayout srcLayout = reader.read<VkImageLayout>();
+      VkImage dstImage = getImage(reader.read<uint64_t>());
+      VkImageLayout dstLayout = reader.read<VkImageLayout>();
+      std::vector<VkImageCopy> regions = reader.readArray<VkImageCopy>();
+      vkCmdCopyImage(_cmdBuffer, srcImage, srcLayout, dstImage, dstLayout,
+                     (uint32_t)regions.size(), regions.data());
+      break;
+    }
+    default:
+      return false;
+    }
+  }
+  return !reader.HasFailed;
+}
+
+static VkDeviceSize alignContentOffset(VkDeviceSize _offset) {
+  return (_offset + 15) & ~(VkDeviceSize)15;
+}
+
+// Fills _stagingBuffer with the captured contents and records copying them
+// back, leaving every image in the layout the frame finds it in.
+static bool recordReplayRestore(const Renderer &_renderer,
+                                VkCommandBuffer _cmdBuffer,
+                                const FrameCapture &_capture,
+                                const ReplayObjects &_objects,
+                                const Buffer &_stagingBuffer) {
+  uint8_t *stagingData = nullptr;
+  if (_stagingBuffer.Size > 0) {
+    BB_VK_ASSERT(vkMapMemory(_renderer.Device, _stagingBuffer.Memory, 0,
+                             _stagingBuffer.Size, 0, (void **)&stagingData));
+  }
+  BB_DEFER(if (stagingData) {
+    vkUnmapMemory(_renderer.Device, _stagingBuffer.Memory);
+  });
+
+  // Whatever the previous replay did is done before the restore overwrites
+  // it.
+  VkMemoryBarrier memoryBarrier = {};
+  memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  memoryBarrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+  memoryBarrier.dstAccessMask =
+      VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+  vkCmdPipelineBarrier(_cmdBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0,
+                       nullptr, 0, nullptr);
+
+  VkDeviceSize offset = 0;
+  for (const CapturedContents &contents : _capture.BufferContents) {
+    memcpy(stagingData + offset, contents.Data, (size_t)contents.Size);
+    VkBufferCopy region = {offset, 0, contents.Size};
+    vkCmdCopyBuffer(_cmdBuffer, _stagingBuffer.Handle,
+                    getReplayHandle(_objects, CaptureObjectType::Buffer,
+                                    fromId<VkBuffer>(contents.Id)),
+                    1, &region);
+    offset = alignContentOffset(offset + contents.Size);
+  }
+
+  std::unordered_map<uint64_t, const CapturedContents *> imageContents;
+  for (const CapturedContents &contents : _capture.ImageContents) {
+    imageContents[contents.Id] = &contents;
+  }
+
+  std::vector<VkBufferImageCopy> regions;
+  for (const CapturedObject &object :
+       _capture.Objects[CaptureObjectType::Image]) {
+    VkImageLayout layout = patchLayout(object.InitialLayout);
+    if (layout == VK_IMAGE_LAYOUT_UNDEFINED ||
+        layout == VK_IMAGE_LAYOUT_PREINITIALIZED) {
+      continue;
+    }
+
+    VkImageCreateInfo info =
+        CaptureReader{object.CreateInfo.data(), object.CreateInfo.size()}
+            .read<VkImageCreateInfo>();
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = layout;
+    barrier.dstAccessMask =
+        VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = getReplayHandle(_objects, CaptureObjectType::Image,
+                                    fromId<VkImage>(object.Id));
+    barrier.subresourceRange = getWholeImageRange(info);
+
+    auto contents = imageContents.find(object.Id);
+    if (contents != imageContents.end()) {
+      if (getImageCopyRegions(info, regions) != contents->second->Size) {
+        return false;
+      }
+      memcpy(stagingData + offset, contents->second->Data,
+             (size_t)contents->second->Size);
+      for (VkBufferImageCopy &region : regions) {
+        region.bufferOffset += offset;
+      }
+      offset = alignContentOffset(offset + contents->second->Size);
+
+      VkImageMemoryBarrier copyBarrier = barrier;
+      copyBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+      copyBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      vkCmdPipelineBarrier(_cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                           VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                           nullptr, 1, &copyBarrier);
+      vkCmdCopyBufferToImage(_cmdBuffer, _stagingBuffer.Handle,
+                             barrier.image,
+                             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                             (uint32_t)regions.size(), regions.data());
+      barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+      barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    }
+    vkCmdPipelineBarrier(_cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0,
+                         nullptr, 1, &barrier);
+  }
+
+  memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  memoryBarrier.dstAccessMask =
+      VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+  vkCmdPipelineBarrier(_cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1,
+                       &memoryBarrier, 0, nullptr, 0, nullptr);
+  return true;
+}
+
+static VkDeviceSize getRestoreSize(const FrameCapture &_capture) {
+  VkDeviceSize size = 0;
+  for (const auto *contents :
+       {&_capture.BufferContents, &_capture.ImageContents}) {
+    for (const CapturedContents &content : *contents) {
+      size = alignContentOffset(size + content.Size);
+    }
+  }
+  return size;
+}
+
+static void submitAndWait(const Renderer &_renderer,
+                          VkCommandBuffer _cmdBuffer) {
+  VkSubmitInfo submitInfo = {};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &_cmdBuffer;
+  BB_VK_ASSERT(
+      vkQueueSubmit(_renderer.Queue, 1, &submitInfo, VK_NULL_HANDLE));
+  BB_VK_ASSERT(vkQueueWaitIdle(_renderer.Queue));
+}
+
+static void printReplayTimes(const char *_name, std::vector<float> &_timesMs) {
+  std::sort(_timesMs.begin(), _timesMs.end());
+  float sumMs = 0.f;
+  for (float ms : _timesMs) {
+    sumMs += ms;
+  }
+  printLine("{:10} min {:.3f} ms, median {:.3f} ms, mean {:.3f} ms, max "
+            "{:.3f} ms",
+            _name, _timesMs.front(), _timesMs[_timesMs.size() / 2],
+            sumMs / _timesMs.size(), _timesMs.back());
+}
+
+bool replayFrameCapture(const std::string &_filePath,
+                        const FrameReplayParams &_params) {
+  FrameCapture capture;
+  if (!readFrameCapture(_filePath, capture)) {
+    return false;
+  }
+
+  Renderer renderer = createRenderer(nullptr);
+  BB_DEFER(destroyRenderer(renderer));
+  VkDevice device = renderer.Device;
+
+  VkPhysicalDeviceProperties deviceProperties;
+  vkGetPhysicalDeviceProperties(renderer.PhysicalDevice, &deviceProperties);
+  uint32_t numQueueFamilies;
+  vkGetPhysicalDeviceQueueFamilyProperties(renderer.PhysicalDevice,
+                                           &numQueueFamilies, nullptr);
+  std::vector<VkQueueFamilyProperties> queueFamilies(numQueueFamilies);
+  vkGetPhysicalDeviceQueueFamilyProperties(
+      renderer.PhysicalDevice, &numQueueFamilies, queueFamilies.data());
+  // Software drivers may not have timestamps, so the CPU times the frame's
+  // submission instead.
+  bool hasTimestamps =
+      queueFamilies[renderer.QueueFamilyIndex].timestampValidBits > 0;
+  printLine("Replaying {} on {}, timed with {}", _filePath,
+            deviceProperties.deviceName,
+            hasTimestamps ? "timestamps" : "the CPU");
+
+  ReplayObjects objects = {};
+  BB_DEFER(destroyReplayObjects(renderer, objects));
+  if (!createReplayObjects(renderer, capture,
+                           _params.CompareWithReloadedShaders, objects)) {
+    printLine("Failed to create the captured objects");
+    return false;
+  }
+
+  VkDeviceSize restoreSize = getRestoreSize(capture);
+  Buffer stagingBuffer = {};
+  if (restoreSize > 0) {
+    stagingBuffer =
+        createBuffer(renderer, restoreSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                         VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  }
+  BB_DEFER(if (restoreSize > 0) { destroyBuffer(renderer, stagingBuffer); });
+
+  VkCommandPoolCreateInfo cmdPoolInfo = {};
+  cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  cmdPoolInfo.queueFamilyIndex = renderer.QueueFamilyIndex;
+  VkCommandPool cmdPool;
+  BB_VK_ASSERT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &cmdPool));
+  BB_DEFER(vkDestroyCommandPool(device, cmdPool, nullptr));
+
+  // The restore, then the frame with each variant.
+  int numVariants = _params.CompareWithReloadedShaders ? 2 : 1;
+  VkCommandBuffer cmdBuffers[3];
+  VkCommandBufferAllocateInfo cmdBufferInfo = {};
+  cmdBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  cmdBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  cmdBufferInfo.commandPool = cmdPool;
+  cmdBufferInfo.commandBufferCount = 1 + numVariants;
+  BB_VK_ASSERT(vkAllocateCommandBuffers(device, &cmdBufferInfo, cmdBuffers));
+
+  VkQueryPoolCreateInfo queryPoolInfo = {};
+  queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  queryPoolInfo.queryCount = 2 * numVariants;
+  VkQueryPool queryPool;
+  BB_VK_ASSERT(
+      vkCreateQueryPool(device, &queryPoolInfo, nullptr, &queryPool));
+  BB_DEFER(vkDestroyQueryPool(device, queryPool, nullptr));
+
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  BB_VK_ASSERT(vkBeginCommandBuffer(cmdBuffers[0], &beginInfo));
+  bool isRecorded = recordReplayRestore(renderer, cmdBuffers[0], capture,
+                                        objects, stagingBuffer);
+  BB_VK_ASSERT(vkEndCommandBuffer(cmdBuffers[0]));
+
+  for (int i = 0; i < numVariants && isRecorded; ++i) {
+    VkCommandBuffer cmdBuffer = cmdBuffers[1 + i];
+    uint32_t firstQuery = 2 * i;
+    BB_VK_ASSERT(vkBeginCommandBuffer(cmdBuffer, &beginInfo));
+    vkCmdResetQueryPool(cmdBuffer, queryPool, firstQuery, 2);
+    vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                        queryPool, firstQuery);
+    isRecorded = recordReplayCommands(cmdBuffer, capture, objects, i);
+    vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                        queryPool, firstQuery + 1);
+    BB_VK_ASSERT(vkEndCommandBuffer(cmdBuffer));
+  }
+  if (!isRecorded) {
+    printLine("Failed to record the captured frame");
+    return false;
+  }
+
+  // Variants alternate, so that both see the device in the same state.
+  std::vector<float> timesMs[2];
+  uint32_t numIterations =
+      _params.NumWarmupIterations + std::max(_params.NumIterations, 1u);
+  for (uint32_t iteration = 0; iteration < numIterations; ++iteration) {
+    for (int i = 0; i < numVariants; ++i) {
+      submitAndWait(renderer, cmdBuffers[0]);
+
+      Time startTime = getCurrentTime();
+      submitAndWait(renderer, cmdBuffers[1 + i]);
+      float ms = getElapsedTimeInSeconds(startTime, getCurrentTime()) * 1000.f;
+
+      if (hasTimestamps) {
+        uint64_t timestamps[2];
+        BB_VK_ASSERT(vkGetQueryPoolResults(
+            device, queryPool, 2 * i, 2, sizeof(timestamps), timestamps,
+            sizeof(uint64_t),
+            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+        ms = (float)((double)(timestamps[1] - timestamps[0]) *
+                     deviceProperties.limits.timestampPeriod * 1e-6);
+      }
+      if (iteration >= _params.NumWarmupIterations) {
+        timesMs[i].push_back(ms);
+      }
+    }
+  }
+
+  printLine("{} commands, {} pipelines, {} iterations",
+            capture.NumCommands,
+            capture.Objects[CaptureObjectType::Pipeline].size(),
+            timesMs[0].size());
+  printReplayTimes("captured", timesMs[0]);
+  if (numVariants == 2) {
+    printReplayTimes("reloaded", timesMs[1]);
+    float deltaMs = timesMs[1][timesMs[1].size() / 2] -
+                    timesMs[0][timesMs[0].size() / 2];
+    printLine("median delta {:+.3f} ms ({:+.1f}%), {} of {} shaders changed",
+              deltaMs, 100.f * deltaMs / timesMs[0][timesMs[0].size() / 2],
+              objects.ChangedShaders.size(), capture.Shaders.size());
+  }
+
+  for (const CapturedObject &object :
+       capture.Objects[CaptureObjectType::Pipeline]) {
+    CaptureReader reader = {object.CreateInfo.data(),
+                            object.CreateInfo.size()};
+    uint32_t numShaders = reader.read<uint32_t>();
+    std::string shaderPaths;
+    for (uint32_t i = 0; i < numShaders; ++i) {
+      auto shader = capture.Shaders.find(reader.read<uint64_t>());
+      if (shader != capture.Shaders.end()) {
+        shaderPaths += " " + shader->second.FilePath;
+      }
+    }
+    printLine("pipeline {:016x}{}{}", object.ParamsHash, shaderPaths,
+              objects.ChangedPipelines.count(object.Id) ? " (changed)" : "");
+  }
+  return true;
+}
+
+} // namespace bb
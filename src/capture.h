@@ -0,0 +1,50 @@
+#pragma once
+#include "render.h"
+#include <string>
+
+namespace bb {
+
+// Frame capture: the commands the renderer records for one frame, and every
+// object and piece of memory they reach, are written to a file. The replay
+// executes them again on a renderer of its own, without a window, so that a
+// frame can be timed in isolation and against changed shaders.
+//
+// Objects are tracked from startup through the Vulkan entry points volk
+// loaded, except for pipelines and shaders, which are tracked by their params
+// and files. Commands are only hooked while capturing. Query commands aren't
+// captured, since the replay times the frame itself.
+
+// Call right after the renderer is created, as objects created before aren't
+// tracked. Tracking adds transfer usage to buffers and images, so that their
+// contents can be read back and restored.
+void initFrameCapture(const Renderer &_renderer);
+void destroyFrameCapture();
+bool isFrameCaptureEnabled();
+
+// Called by createShaderFromFile() and createPipeline().
+void trackShader(const Shader &_shader, const std::string &_filePath,
+                 const void *_code, size_t _codeSize);
+void trackPipeline(VkPipeline _pipeline, const PipelineParams &_params);
+
+// Captures the commands recorded into _cmdBuffer from now on.
+void beginFrameCapture(VkCommandBuffer _cmdBuffer);
+// Commands recorded while paused, such as the GUI's, are left out.
+void pauseFrameCapture(bool _isPaused);
+// Call after recording and before submitting the frame. Waits for the device
+// to be idle, and writes the capture with memory as the frame will find it.
+bool endFrameCapture(const std::string &_filePath);
+
+struct FrameReplayParams {
+  uint32_t NumWarmupIterations = 4;
+  uint32_t NumIterations = 100;
+  // Also replays with every shader reloaded from its file, alternating with
+  // the captured shaders each iteration.
+  bool CompareWithReloadedShaders = false;
+};
+
+// Prints the GPU time of the frame. Returns false if the capture can't be
+// read or replayed.
+bool replayFrameCapture(const std::string &_filePath,
+                        const FrameReplayParams &_params);
+
+} // namespace bb
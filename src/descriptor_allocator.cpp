@@ -0,0 +1,331 @@
+#include "descriptor_allocator.h"
+#include <algorithm>
+#include <string.h>
+
+namespace bb {
+
+DescriptorAllocator createDescriptorAllocator(uint32_t _numSetsPerFirstPool,
+                                              uint32_t _maxNumSetsPerPool) {
+  BB_ASSERT(_numSetsPerFirstPool > 0 &&
+            _numSetsPerFirstPool <= _maxNumSetsPerPool);
+  DescriptorAllocator allocator = {};
+  allocator.NumSetsPerFirstPool = _numSetsPerFirstPool;
+  allocator.MaxNumSetsPerPool = _maxNumSetsPerPool;
+  return allocator;
+}
+
+void destroyDescriptorAllocator(const Renderer &_renderer,
+                                DescriptorAllocator &_allocator) {
+  for (auto &[layout, chain] : _allocator.Chains) {
+    for (VkDescriptorPool pool : chain.Pools) {
+      vkDestroyDescriptorPool(_renderer.Device, pool, nullptr);
+    }
+  }
+  _allocator = {};
+}
+
+static DescriptorPoolChain
+createDescriptorPoolChain(const DescriptorSetLayout &_layout) {
+  DescriptorPoolChain chain = {};
+  for (uint32_t i = 0; i < _layout.NumBindings; ++i) {
+    const DescriptorBinding &binding = _layout.Bindings[i];
+    auto it = std::find_if(chain.SetSizes.begin(), chain.SetSizes.end(),
+                           [&](const VkDescriptorPoolSize &_size) {
+                             return _size.type == binding.Type;
+                           });
+    if (it != chain.SetSizes.end()) {
+      it->descriptorCount += binding.NumDescriptors;
+    } else {
+      chain.SetSizes.push_back({binding.Type, binding.NumDescriptors});
+    }
+  }
+  return chain;
+}
+
+static void addDescriptorPool(const Renderer &_renderer,
+                              DescriptorAllocator &_allocator,
+                              DescriptorPoolChain &_chain) {
+  uint32_t numSets =
+      _chain.PoolNumSets.empty()
+          ? _allocator.NumSetsPerFirstPool
+          : std::min(_chain.PoolNumSets.back() * 2,
+                     _allocator.MaxNumSetsPerPool);
+
+  std::vector<VkDescriptorPoolSize> poolSizes = _chain.SetSizes;
+  for (VkDescriptorPoolSize &poolSize : poolSizes) {
+    poolSize.descriptorCount *= numSets;
+  }
+
+  VkDescriptorPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.maxSets = numSets;
+  poolInfo.poolSizeCount = (uint32_t)poolSizes.size();
+  poolInfo.pPoolSizes = poolSizes.data();
+
+  VkDescriptorPool pool;
+  BB_VK_ASSERT(
+      vkCreateDescriptorPool(_renderer.Device, &poolInfo, nullptr, &pool));
+  if (!_chain.Pools.empty()) {
+    ++_allocator.Stats.NumGrowths;
+  }
+  _chain.Pools.push_back(pool);
+  _chain.PoolNumSets.push_back(numSets);
+  ++_allocator.Stats.NumPools;
+  _allocator.Stats.NumSetsCapacity += numSets;
+}
+
+VkDescriptorSet allocateDescriptorSet(const Renderer &_renderer,
+                                      DescriptorAllocator &_allocator,
+                                      const DescriptorSetLayout &_layout) {
+  BB_ASSERT(_layout.NumBindings > 0);
+  auto it = _allocator.Chains.find(_layout.Handle);
+  if (it == _allocator.Chains.end()) {
+    it = _allocator.Chains
+             .emplace(_layout.Handle, createDescriptorPoolChain(_layout))
+             .first;
+  }
+  DescriptorPoolChain &chain = it->second;
+
+  VkDescriptorSetAllocateInfo allocInfo = {};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts = &_layout.Handle;
+
+  // Pools are filled in order, so a pool that failed once stays full until
+  // the next reset.
+  for (;;) {
+    if (chain.CurrentPool == chain.Pools.size()) {
+      addDescriptorPool(_renderer, _allocator, chain);
+    }
+    allocInfo.descriptorPool = chain.Pools[chain.CurrentPool];
+    VkDescriptorSet set;
+    VkResult result =
+        vkAllocateDescriptorSets(_renderer.Device, &allocInfo, &set);
+    if (result == VK_SUCCESS) {
+      ++_allocator.Stats.NumSets;
+      ++_allocator.Stats.NumAllocations;
+      return set;
+    }
+    // A pool sized in whole sets of one layout shouldn't fragment, but
+    // drivers may report either.
+    BB_ASSERT(result == VK_ERROR_OUT_OF_POOL_MEMORY ||
+              result == VK_ERROR_FRAGMENTED_POOL);
+    ++chain.CurrentPool;
+  }
+}
+
+void resetDescriptorAllocator(const Renderer &_renderer,
+                              DescriptorAllocator &_allocator) {
+  for (auto &[layout, chain] : _allocator.Chains) {
+    // Pools past the current one haven't been allocated from.
+    uint32_t numUsedPools =
+        std::min(chain.CurrentPool + 1, (uint32_t)chain.Pools.size());
+    for (uint32_t i = 0; i < numUsedPools; ++i) {
+      BB_VK_ASSERT(vkResetDescriptorPool(_renderer.Device, chain.Pools[i], 0));
+    }
+    chain.CurrentPool = 0;
+  }
+  _allocator.Stats.NumSets = 0;
+  ++_allocator.Stats.NumResets;
+}
+
+// FNV-1a
+size_t DescriptorSetCache::KeyHash::operator()(
+    const std::vector<uint64_t> &_key) const {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (uint64_t word : _key) {
+    for (int i = 0; i < 8; ++i) {
+      hash = (hash ^ ((word >> (i * 8)) & 0xff)) * 0x100000001b3ull;
+    }
+  }
+  return (size_t)hash;
+}
+
+static void appendDescriptorSetKey(const DescriptorSetLayout &_layout,
+                                   const uint8_t *_descriptors,
+                                   std::vector<uint64_t> &_key) {
+  // The infos' padding may be uninitialized, so only their fields are keyed.
+  for (uint32_t i = 0; i < _layout.NumBindings; ++i) {
+    const DescriptorBinding &binding = _layout.Bindings[i];
+    if (binding.HasImmutableSamplers) {
+      continue;
+    }
+    uint32_t infoSize = getDescriptorInfoSize(binding.Type);
+    for (uint32_t j = 0; j < binding.NumDescriptors; ++j) {
+      switch (binding.Type) {
+      case VK_DESCRIPTOR_TYPE_SAMPLER:
+      case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+      case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+      case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+      case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT: {
+        VkDescriptorImageInfo info;
+        memcpy(&info, _descriptors, sizeof(info));
+        _key.push_back((uint64_t)info.sampler);
+        _key.push_back((uint64_t)info.imageView);
+        _key.push_back((uint64_t)info.imageLayout);
+        break;
+      }
+      case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+      case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER: {
+        VkBufferView view;
+        memcpy(&view, _descriptors, sizeof(view));
+        _key.push_back((uint64_t)view);
+        break;
+      }
+      default: {
+        VkDescriptorBufferInfo info;
+        memcpy(&info, _descriptors, sizeof(info));
+        _key.push_back((uint64_t)info.buffer);
+        _key.push_back(info.offset);
+        _key.push_back(info.range);
+        break;
+      }
+      }
+      _descriptors += infoSize;
+    }
+  }
+}
+
+VkDescriptorSet getCachedDescriptorSet(const Renderer &_renderer,
+                                       DescriptorSetCache &_cache,
+                                       DescriptorAllocator &_allocator,
+                                       const DescriptorSetLayout &_layout,
+                                       const void *_descriptors,
+                                       [[maybe_unused]] uint32_t _size) {
+  BB_ASSERT(_size == _layout.UpdateTemplateDataSize);
+  std::vector<uint64_t> key;
+  key.push_back((uint64_t)_layout.Handle);
+  appendDescriptorSetKey(_layout, (const uint8_t *)_descriptors, key);
+
+  auto it = _cache.Sets.find(key);
+  if (it != _cache.Sets.end()) {
+    ++_cache.NumHits;
+    return it->second;
+  }
+  ++_cache.NumMisses;
+
+  VkDescriptorSet set = allocateDescriptorSet(_renderer, _allocator, _layout);
+  vkUpdateDescriptorSetWithTemplate(_renderer.Device, set,
+                                    _layout.UpdateTemplate, _descriptors);
+  _cache.Sets.emplace(std::move(key), set);
+  return set;
+}
+
+void clearDescriptorSetCache(DescriptorSetCache &_cache) {
+  _cache.Sets.clear();
+}
+
+DescriptorChurnStats measureDescriptorChurn(const Renderer &_renderer,
+                                            const DescriptorSetLayout &_layout,
+                                            uint32_t _numSetsPerRound,
+                                            uint32_t _numRounds,
+                                            const DescriptorSetCache &_cache) {
+  DescriptorAllocator allocator = createDescriptorAllocator(16, 1024);
+  BB_DEFER(destroyDescriptorAllocator(_renderer, allocator));
+
+  auto churn = [&](float &_allocSeconds, float &_resetSeconds) {
+    Time startTime = getCurrentTime();
+    for (uint32_t i = 0; i < _numSetsPerRound; ++i) {
+      allocateDescriptorSet(_renderer, allocator, _layout);
+    }
+    Time allocatedTime = getCurrentTime();
+    resetDescriptorAllocator(_renderer, allocator);
+    _allocSeconds += getElapsedTimeInSeconds(startTime, allocatedTime);
+    _resetSeconds += getElapsedTimeInSeconds(allocatedTime, getCurrentTime());
+  };
+
+  float allocSeconds = 0.f;
+  float resetSeconds = 0.f;
+  churn(allocSeconds, resetSeconds);
+  allocSeconds = 0.f;
+  resetSeconds = 0.f;
+  for (uint32_t round = 0; round < _numRounds; ++round) {
+    churn(allocSeconds, resetSeconds);
+  }
+
+  DescriptorChurnStats stats = {};
+  stats.SetsPerSecond = allocSeconds > 0.f ? (double)_numSetsPerRound *
+                                                 _numRounds / allocSeconds
+                                           : 0.0;
+  stats.ResetsPerSecond =
+      resetSeconds > 0.f ? (double)_numRounds / resetSeconds : 0.0;
+  stats.NumPools = allocator.Stats.NumPools;
+  stats.NumGrowths = allocator.Stats.NumGrowths;
+
+  uint64_t numLookups = 0;
+  Time startTime = getCurrentTime();
+  for (uint32_t round = 0; round < _numRounds; ++round) {
+    for (const auto &[key, set] : _cache.Sets) {
+      numLookups += _cache.Sets.count(key);
+    }
+  }
+  float lookupSeconds = getElapsedTimeInSeconds(startTime, getCurrentTime());
+  stats.CacheLookupsPerSecond =
+      lookupSeconds > 0.f ? (double)numLookups / lookupSeconds : 0.0;
+  return stats;
+}
+
+DescriptorUpdateStats measureDescriptorUpdates(
+    const Renderer &_renderer, const DescriptorSetLayout &_layout,
+    const void *_descriptors, uint32_t _numSets, uint32_t _numRounds) {
+  DescriptorAllocator allocator = createDescriptorAllocator(_numSets, _numSets);
+  BB_DEFER(destroyDescriptorAllocator(_renderer, allocator));
+  std::vector<VkDescriptorSet> sets(_numSets);
+  for (VkDescriptorSet &set : sets) {
+    set = allocateDescriptorSet(_renderer, allocator, _layout);
+  }
+
+  DescriptorUpdateStats stats = {};
+  auto writeSets = [&]() {
+    for (VkDescriptorSet set : sets) {
+      std::vector<VkWriteDescriptorSet> writes;
+      const uint8_t *descriptors = (const uint8_t *)_descriptors;
+      for (uint32_t i = 0; i < _layout.NumBindings; ++i) {
+        const DescriptorBinding &binding = _layout.Bindings[i];
+        if (binding.HasImmutableSamplers) {
+          continue;
+        }
+        VkWriteDescriptorSet write = {};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = set;
+        write.dstBinding = i;
+        write.descriptorType = binding.Type;
+        write.descriptorCount = binding.NumDescriptors;
+        // Only the pointer the type calls for is read.
+        write.pImageInfo = (const VkDescriptorImageInfo *)descriptors;
+        write.pBufferInfo = (const VkDescriptorBufferInfo *)descriptors;
+        write.pTexelBufferView = (const VkBufferView *)descriptors;
+        writes.push_back(write);
+        descriptors += getDescriptorInfoSize(binding.Type) *
+                       binding.NumDescriptors;
+      }
+      vkUpdateDescriptorSets(_renderer.Device, (uint32_t)writes.size(),
+                             writes.data(), 0, nullptr);
+    }
+  };
+  auto updateSets = [&]() {
+    for (VkDescriptorSet set : sets) {
+      vkUpdateDescriptorSetWithTemplate(_renderer.Device, set,
+                                        _layout.UpdateTemplate, _descriptors);
+    }
+  };
+  auto measure = [&](auto &&_update) {
+    _update();
+    Time startTime = getCurrentTime();
+    for (uint32_t round = 0; round < _numRounds; ++round) {
+      _update();
+    }
+    float seconds = getElapsedTimeInSeconds(startTime, getCurrentTime());
+    return seconds > 0.f ? (double)_numSets * _numRounds / seconds : 0.0;
+  };
+  stats.WriteSetsPerSecond = measure(writeSets);
+  stats.TemplateSetsPerSecond = measure(updateSets);
+  for (uint32_t i = 0; i < _layout.NumBindings; ++i) {
+    if (!_layout.Bindings[i].HasImmutableSamplers) {
+      stats.NumDescriptorsPerSet += _layout.Bindings[i].NumDescriptors;
+    }
+  }
+  return stats;
+}
+
+} // namespace bb
@@ -0,0 +1,131 @@
+#pragma once
+#include "render.h"
+#include <unordered_map>
+#include <vector>
+
+namespace bb {
+
+// Allocates descriptor sets from pools that grow with demand. Each layout
+// has a chain of pools of its own, sized in whole sets of it, so that no
+// descriptor type runs out while others are left over. When the current pool
+// of a chain is out of memory the next one is used, or a new one created,
+// each new pool holding twice the sets of the previous one up to
+// MaxNumSetsPerPool.
+//
+// Sets aren't freed one by one. resetDescriptorAllocator() frees all of them
+// at once and keeps the pools, so that an allocator reset once its sets are
+// retired, such as per frame in flight, stops creating pools once it has
+// grown to what it's asked for.
+
+struct DescriptorPoolChain {
+  // Descriptors of a single set.
+  std::vector<VkDescriptorPoolSize> SetSizes;
+  std::vector<VkDescriptorPool> Pools;
+  // Sets each of Pools was created for.
+  std::vector<uint32_t> PoolNumSets;
+  // Pools before it are full until the next reset.
+  uint32_t CurrentPool;
+};
+
+struct DescriptorAllocatorStats {
+  uint32_t NumPools;
+  // Room for, in every pool.
+  uint64_t NumSetsCapacity;
+  // Since the last reset.
+  uint64_t NumSets;
+  uint64_t NumAllocations;
+  // Pools created because the others were full, not counting the first one
+  // of each layout.
+  uint32_t NumGrowths;
+  uint32_t NumResets;
+};
+
+struct DescriptorAllocator {
+  std::unordered_map<VkDescriptorSetLayout, DescriptorPoolChain> Chains;
+  uint32_t NumSetsPerFirstPool;
+  uint32_t MaxNumSetsPerPool;
+  DescriptorAllocatorStats Stats;
+};
+
+DescriptorAllocator createDescriptorAllocator(uint32_t _numSetsPerFirstPool,
+                                              uint32_t _maxNumSetsPerPool);
+void destroyDescriptorAllocator(const Renderer &_renderer,
+                                DescriptorAllocator &_allocator);
+
+VkDescriptorSet allocateDescriptorSet(const Renderer &_renderer,
+                                      DescriptorAllocator &_allocator,
+                                      const DescriptorSetLayout &_layout);
+// Every set of _allocator must be retired: no longer used by pending command
+// buffers.
+void resetDescriptorAllocator(const Renderer &_renderer,
+                              DescriptorAllocator &_allocator);
+
+// Sets that are written once and never updated, such as materials', shared
+// by content: asking for a layout with the same descriptors again gives the
+// set made the first time. Sets come from the allocator passed in, which
+// must outlive the cache without being reset. Clear the cache when
+// resources that cached sets refer to are destroyed, since their handles
+// may be reused.
+struct DescriptorSetCache {
+  struct KeyHash {
+    size_t operator()(const std::vector<uint64_t> &_key) const;
+  };
+
+  // By the layout and descriptors, see getCachedDescriptorSet().
+  std::unordered_map<std::vector<uint64_t>, VkDescriptorSet, KeyHash> Sets;
+  uint64_t NumHits;
+  uint64_t NumMisses;
+};
+
+// _descriptors are packed the way _layout.UpdateTemplate reads them. Writes
+// the set only when it isn't cached yet.
+VkDescriptorSet getCachedDescriptorSet(const Renderer &_renderer,
+                                       DescriptorSetCache &_cache,
+                                       DescriptorAllocator &_allocator,
+                                       const DescriptorSetLayout &_layout,
+                                       const void *_descriptors,
+                                       uint32_t _size);
+template <typename T>
+VkDescriptorSet getCachedDescriptorSet(const Renderer &_renderer,
+                                       DescriptorSetCache &_cache,
+                                       DescriptorAllocator &_allocator,
+                                       const DescriptorSetLayout &_layout,
+                                       const T &_descriptors) {
+  return getCachedDescriptorSet(_renderer, _cache, _allocator, _layout,
+                                &_descriptors, sizeof(T));
+}
+void clearDescriptorSetCache(DescriptorSetCache &_cache);
+
+// Allocation and reset throughput of an allocator churned the way per frame
+// allocators are: _numSetsPerRound sets of _layout, then a reset, _numRounds
+// times. The first round, which grows the pools, isn't measured. Lookups
+// are of every set in _cache, by content.
+struct DescriptorChurnStats {
+  double SetsPerSecond;
+  double ResetsPerSecond;
+  double CacheLookupsPerSecond;
+  uint32_t NumPools;
+  uint32_t NumGrowths;
+};
+
+DescriptorChurnStats measureDescriptorChurn(const Renderer &_renderer,
+                                            const DescriptorSetLayout &_layout,
+                                            uint32_t _numSetsPerRound,
+                                            uint32_t _numRounds,
+                                            const DescriptorSetCache &_cache);
+
+// Update throughput of _numSets sets of _layout written from _descriptors,
+// packed as for its UpdateTemplate, _numRounds times: with a
+// VkWriteDescriptorSet per binding built for every set, and with the
+// template.
+struct DescriptorUpdateStats {
+  double WriteSetsPerSecond;
+  double TemplateSetsPerSecond;
+  uint32_t NumDescriptorsPerSet;
+};
+
+DescriptorUpdateStats measureDescriptorUpdates(
+    const Renderer &_renderer, const DescriptorSetLayout &_layout,
+    const void *_descriptors, uint32_t _numSets, uint32_t _numRounds);
+
+} // namespace bb
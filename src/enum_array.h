@@ -1,5 +1,6 @@
 #pragma once
 #include <type_traits>
+#include <stddef.h>
 #include <stdint.h>
 
 namespace bb {
@@ -92,6 +93,6 @@ template <typename E> struct EnumCountImpl {
 };
 
 template <typename E>
-static constexpr auto EnumCount = typename EnumCountImpl<E>::Value;
+static constexpr auto EnumCount = EnumCountImpl<E>::Value;
 
 } // namespace bb
\ No newline at end of file
@@ -0,0 +1,178 @@
+#include "frame_encode.h"
+#include <algorithm>
+#include <array>
+#include <vector>
+
+namespace bb {
+
+static const uint32_t *getCrcTable() {
+  static const std::array<uint32_t, 256> table = []() {
+    std::array<uint32_t, 256> result;
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; ++k) {
+        c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+      }
+      result[i] = c;
+    }
+    return result;
+  }();
+  return table.data();
+}
+
+static uint32_t updateCrc(uint32_t _crc, const uint8_t *_data, size_t _size) {
+  const uint32_t *table = getCrcTable();
+  for (size_t i = 0; i < _size; ++i) {
+    _crc = table[(_crc ^ _data[i]) & 0xff] ^ (_crc >> 8);
+  }
+  return _crc;
+}
+
+static void appendBigEndian(std::vector<uint8_t> &_bytes, uint32_t _value) {
+  _bytes.push_back((uint8_t)(_value >> 24));
+  _bytes.push_back((uint8_t)(_value >> 16));
+  _bytes.push_back((uint8_t)(_value >> 8));
+  _bytes.push_back((uint8_t)_value);
+}
+
+static void writePNGChunk(FILE *_file, const char *_type,
+                          const std::vector<uint8_t> &_data) {
+  std::vector<uint8_t> header;
+  appendBigEndian(header, (uint32_t)_data.size());
+  header.insert(header.end(), _type, _type + 4);
+  fwrite(header.data(), 1, header.size(), _file);
+  fwrite(_data.data(), 1, _data.size(), _file);
+
+  uint32_t crc = updateCrc(0xffffffffu, header.data() + 4, 4);
+  crc = updateCrc(crc, _data.data(), _data.size()) ^ 0xffffffffu;
+  std::vector<uint8_t> footer;
+  appendBigEndian(footer, crc);
+  fwrite(footer.data(), 1, footer.size(), _file);
+}
+
+void writePNG(FILE *_file, const uint8_t *_texels, uint32_t _width,
+              uint32_t _height, bool _isBGRA) {
+  static const uint8_t signature[] = {0x89, 'P',  'N',  'G',
+                                      '\r', '\n', 0x1a, '\n'};
+  fwrite(signature, 1, sizeof(signature), _file);
+
+  std::vector<uint8_t> header;
+  appendBigEndian(header, _width);
+  appendBigEndian(header, _height);
+  // 8 bit RGB, default compression and filter, not interlaced
+  header.insert(header.end(), {8, 2, 0, 0, 0});
+  writePNGChunk(_file, "IHDR", header);
+
+  // Every row starts with its filter type, none.
+  size_t rowSize = 1 + (size_t)_width * 3;
+  std::vector<uint8_t> rows(rowSize * _height);
+  for (uint32_t y = 0; y < _height; ++y) {
+    uint8_t *row = &rows[rowSize * y];
+    const uint8_t *texel = _texels + (size_t)_width * 4 * y;
+    row[0] = 0;
+    for (uint32_t x = 0; x < _width; ++x, texel += 4) {
+      row[1 + x * 3 + 0] = texel[_isBGRA ? 2 : 0];
+      row[1 + x * 3 + 1] = texel[1];
+      row[1 + x * 3 + 2] = texel[_isBGRA ? 0 : 2];
+    }
+  }
+
+  constexpr size_t maxBlockSize = 65535;
+  std::vector<uint8_t> data = {0x78, 0x01};
+  data.reserve(rows.size() + rows.size() / maxBlockSize * 5 + 16);
+  uint32_t adlerA = 1;
+  uint32_t adlerB = 0;
+  for (size_t offset = 0; offset < rows.size(); offset += maxBlockSize) {
+    size_t size = std::min(maxBlockSize, rows.size() - offset);
+    bool isFinal = offset + size == rows.size();
+    data.push_back(isFinal ? 1 : 0);
+    data.push_back((uint8_t)size);
+    data.push_back((uint8_t)(size >> 8));
+    data.push_back((uint8_t)~size);
+    data.push_back((uint8_t)(~size >> 8));
+    data.insert(data.end(), rows.begin() + offset,
+                rows.begin() + offset + size);
+    for (size_t i = offset; i < offset + size; ++i) {
+      adlerA = (adlerA + rows[i]) % 65521;
+      adlerB = (adlerB + adlerA) % 65521;
+    }
+  }
+  appendBigEndian(data, (adlerB << 16) | adlerA);
+  writePNGChunk(_file, "IDAT", data);
+  writePNGChunk(_file, "IEND", {});
+}
+
+void writeRaw(FILE *_file, const uint8_t *_texels, uint32_t _width,
+              uint32_t _height, bool _isBGRA) {
+  size_t size = (size_t)_width * _height * 4;
+  if (!_isBGRA) {
+    fwrite(_texels, 1, size, _file);
+    return;
+  }
+  std::vector<uint8_t> texels(_texels, _texels + size);
+  for (size_t i = 0; i < size; i += 4) {
+    std::swap(texels[i], texels[i + 2]);
+  }
+  fwrite(texels.data(), 1, size, _file);
+}
+
+void writeY4MHeader(FILE *_file, uint32_t _width, uint32_t _height,
+                    uint32_t _frameRate) {
+  fprintf(_file,
+          "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg XYSCSS=420JPEG "
+          "XCOLORRANGE=FULL\n",
+          _width, _height, _frameRate);
+}
+
+// Chroma is averaged over each 2x2 block.
+void writeY4MFrame(FILE *_file, const uint8_t *_texels, uint32_t _width,
+                   uint32_t _height, bool _isBGRA) {
+  uint32_t width = _width;
+  uint32_t height = _height;
+  uint32_t chromaWidth = (width + 1) / 2;
+  uint32_t chromaHeight = (height + 1) / 2;
+  std::vector<uint8_t> planes((size_t)width * height +
+                              (size_t)chromaWidth * chromaHeight * 2);
+  uint8_t *yPlane = planes.data();
+  uint8_t *uPlane = yPlane + (size_t)width * height;
+  uint8_t *vPlane = uPlane + (size_t)chromaWidth * chromaHeight;
+  int r = _isBGRA ? 2 : 0;
+  int b = _isBGRA ? 0 : 2;
+
+  // Weights in 16.16 fixed point.
+  for (uint32_t y = 0; y < height; ++y) {
+    const uint8_t *texel = _texels + (size_t)width * 4 * y;
+    for (uint32_t x = 0; x < width; ++x, texel += 4) {
+      int luma = 19595 * texel[r] + 38470 * texel[1] + 7471 * texel[b];
+      yPlane[(size_t)width * y + x] = (uint8_t)((luma + 32768) >> 16);
+    }
+  }
+  for (uint32_t cy = 0; cy < chromaHeight; ++cy) {
+    for (uint32_t cx = 0; cx < chromaWidth; ++cx) {
+      int sum[3] = {};
+      int numTexels = 0;
+      for (uint32_t y = cy * 2; y < std::min(cy * 2 + 2, height); ++y) {
+        for (uint32_t x = cx * 2; x < std::min(cx * 2 + 2, width); ++x) {
+          const uint8_t *texel = _texels + ((size_t)width * y + x) * 4;
+          sum[0] += texel[r];
+          sum[1] += texel[1];
+          sum[2] += texel[b];
+          ++numTexels;
+        }
+      }
+      int u = -11059 * sum[0] - 21709 * sum[1] + 32768 * sum[2];
+      int v = 32768 * sum[0] - 27439 * sum[1] - 5329 * sum[2];
+      size_t i = (size_t)chromaWidth * cy + cx;
+      uPlane[i] = (uint8_t)std::clamp(
+          (u / numTexels + (128 << 16) + 32768) >> 16, 0, 255);
+      vPlane[i] = (uint8_t)std::clamp(
+          (v / numTexels + (128 << 16) + 32768) >> 16, 0, 255);
+    }
+  }
+
+  fputs("FRAME\n", _file);
+  fwrite(planes.data(), 1, planes.size(), _file);
+}
+
+
+} // namespace bb
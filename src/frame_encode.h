@@ -0,0 +1,26 @@
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+
+namespace bb {
+
+// Writers of RGBA8 or BGRA8 frames, free of the renderer so that they can be
+// benchmarked on their own. Texels are tightly packed rows, top first.
+
+// Uncompressed RGB. Deflate blocks are stored, since compressing would make
+// the writer fall behind at high resolutions.
+void writePNG(FILE *_file, const uint8_t *_texels, uint32_t _width,
+              uint32_t _height, bool _isBGRA);
+// Tightly packed RGBA8 texels.
+void writeRaw(FILE *_file, const uint8_t *_texels, uint32_t _width,
+              uint32_t _height, bool _isBGRA);
+
+// A Y4M stream is a header followed by frames of the same size. Frames are
+// full range BT.601 4:2:0, which the header spells out as the JPEG chroma
+// siting and XCOLORRANGE=FULL, so that players don't assume video range.
+void writeY4MHeader(FILE *_file, uint32_t _width, uint32_t _height,
+                    uint32_t _frameRate);
+void writeY4MFrame(FILE *_file, const uint8_t *_texels, uint32_t _width,
+                   uint32_t _height, bool _isBGRA);
+
+} // namespace bb
@@ -0,0 +1,322 @@
+#include "geometry_pool.h"
+#include "asset_report.h"
+#include "util.h"
+#include <algorithm>
+
+namespace bb {
+
+RangeAllocator createRangeAllocator(uint32_t _capacity) {
+  RangeAllocator allocator = {};
+  allocator.Capacity = _capacity;
+  allocator.NumAllocated = 0;
+  if (_capacity > 0) {
+    allocator.FreeRanges.push_back({0, _capacity});
+  }
+  return allocator;
+}
+
+bool allocateRange(RangeAllocator &_allocator, uint32_t _size,
+                   uint32_t &_offset) {
+  if (_size == 0) {
+    _offset = 0;
+    return true;
+  }
+
+  for (size_t i = 0; i < _allocator.FreeRanges.size(); ++i) {
+    RangeAllocator::Range &range = _allocator.FreeRanges[i];
+    if (range.Size < _size) {
+      continue;
+    }
+
+    _offset = range.Offset;
+    range.Offset += _size;
+    range.Size -= _size;
+    if (range.Size == 0) {
+      _allocator.FreeRanges.erase(_allocator.FreeRanges.begin() + i);
+    }
+    _allocator.NumAllocated += _size;
+    return true;
+  }
+
+  return false;
+}
+
+void freeRange(RangeAllocator &_allocator, uint32_t _offset, uint32_t _size) {
+  if (_size == 0) {
+    return;
+  }
+
+  std::vector<RangeAllocator::Range> &ranges = _allocator.FreeRanges;
+  auto next = std::lower_bound(
+      ranges.begin(), ranges.end(), _offset,
+      [](const RangeAllocator::Range &_range, uint32_t _offset) {
+        return _range.Offset < _offset;
+      });
+  BB_ASSERT(next == ranges.end() || next->Offset >= _offset + _size);
+
+  bool mergesWithPrev = false;
+  if (next != ranges.begin()) {
+    RangeAllocator::Range &prev = *(next - 1);
+    BB_ASSERT(prev.Offset + prev.Size <= _offset);
+    mergesWithPrev = (prev.Offset + prev.Size == _offset);
+  }
+  bool mergesWithNext =
+      (next != ranges.end()) && (_offset + _size == next->Offset);
+
+  if (mergesWithPrev && mergesWithNext) {
+    RangeAllocator::Range &prev = *(next - 1);
+    prev.Size += _size + next->Size;
+    ranges.erase(next);
+  } else if (mergesWithPrev) {
+    (next - 1)->Size += _size;
+  } else if (mergesWithNext) {
+    next->Offset = _offset;
+    next->Size += _size;
+  } else {
+    ranges.insert(next, {_offset, _size});
+  }
+
+  BB_ASSERT(_allocator.NumAllocated >= _size);
+  _allocator.NumAllocated -= _size;
+}
+
+RangeAllocatorStats getRangeAllocatorStats(const RangeAllocator &_allocator) {
+  RangeAllocatorStats stats = {};
+  stats.Capacity = _allocator.Capacity;
+  stats.NumAllocated = _allocator.NumAllocated;
+  stats.NumFreeRanges = (uint32_t)_allocator.FreeRanges.size();
+
+  uint32_t numFree = 0;
+  for (const RangeAllocator::Range &range : _allocator.FreeRanges) {
+    stats.LargestFreeRange = std::max(stats.LargestFreeRange, range.Size);
+    numFree += range.Size;
+  }
+  stats.Fragmentation =
+      (numFree > 0) ? 1.f - (float)stats.LargestFreeRange / (float)numFree
+                    : 0.f;
+
+  return stats;
+}
+
+GeometryPool createGeometryPool(const Renderer &_renderer,
+                                uint32_t _maxNumVertices,
+                                uint32_t _maxNumIndices,
+                                VertexStreamLayout _layout) {
+  GeometryPool pool = {};
+  pool.Layout = _layout;
+
+  // Storage usage lets the visibility buffer resolve refetch triangles.
+  VkDeviceSize vertexSize = sizeof(Vertex);
+  if (_layout == VertexStreamLayout::Split) {
+    vertexSize = sizeof(VertexAttributes);
+    pool.PositionBuffer =
+        createBuffer(_renderer, sizeof(Float3) * _maxNumVertices,
+                     VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                         VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  }
+  pool.VertexBuffer =
+      createBuffer(_renderer, vertexSize * _maxNumVertices,
+                   VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                       VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  pool.IndexBuffer =
+      createBuffer(_renderer, sizeof(uint32_t) * _maxNumIndices,
+                   VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                       VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  pool.VertexAllocator = createRangeAllocator(_maxNumVertices);
+  pool.IndexAllocator = createRangeAllocator(_maxNumIndices);
+  return pool;
+}
+
+void destroyGeometryPool(const Renderer &_renderer, GeometryPool &_pool) {
+  BB_ASSERT(_pool.VertexAllocator.NumAllocated == 0);
+  BB_ASSERT(_pool.IndexAllocator.NumAllocated == 0);
+  destroyBuffer(_renderer, _pool.IndexBuffer);
+  destroyBuffer(_renderer, _pool.VertexBuffer);
+  if (_pool.Layout == VertexStreamLayout::Split) {
+    destroyBuffer(_renderer, _pool.PositionBuffer);
+  }
+  _pool = {};
+}
+
+static Buffer createStagingBufferFromMemory(const Renderer &_renderer,
+                                            const void *_data,
+                                            VkDeviceSize _size) {
+  Buffer stagingBuffer =
+      createBuffer(_renderer, _size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                       VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  void *dst;
+  vkMapMemory(_renderer.Device, stagingBuffer.Memory, 0, _size, 0, &dst);
+  memcpy(dst, _data, _size);
+  vkUnmapMemory(_renderer.Device, stagingBuffer.Memory);
+  return stagingBuffer;
+}
+
+GeometryStaging stageGeometry(const Renderer &_renderer,
+                              VertexStreamLayout _layout,
+                              const std::vector<Vertex> &_vertices,
+                              const std::vector<uint32_t> &_indices) {
+  GeometryStaging staging = {};
+  staging.NumVertices = (uint32_t)_vertices.size();
+  staging.NumIndices = (uint32_t)_indices.size();
+
+  if (staging.NumVertices > 0 && _layout == VertexStreamLayout::Split) {
+    std::vector<Float3> positions(staging.NumVertices);
+    std::vector<VertexAttributes> attributes(staging.NumVertices);
+    for (uint32_t i = 0; i < staging.NumVertices; ++i) {
+      const Vertex &v = _vertices[i];
+      positions[i] = v.Pos;
+      attributes[i].UV = v.UV;
+      attributes[i].Normal = v.Normal;
+      attributes[i].Tangent = v.Tangent;
+    }
+    staging.PositionBuffer = createStagingBufferFromMemory(
+        _renderer, positions.data(), sizeBytes32(positions));
+    staging.VertexBuffer = createStagingBufferFromMemory(
+        _renderer, attributes.data(), sizeBytes32(attributes));
+  } else if (staging.NumVertices > 0) {
+    staging.VertexBuffer = createStagingBufferFromMemory(
+        _renderer, _vertices.data(), sizeBytes32(_vertices));
+  }
+  if (staging.NumIndices > 0) {
+    staging.IndexBuffer = createStagingBufferFromMemory(
+        _renderer, _indices.data(), sizeBytes32(_indices));
+  }
+  return staging;
+}
+
+uint64_t getGeometryStagingSize(const GeometryStaging &_staging) {
+  return (uint64_t)_staging.VertexBuffer.Size + _staging.PositionBuffer.Size +
+         _staging.IndexBuffer.Size;
+}
+
+void destroyGeometryStaging(const Renderer &_renderer,
+                            GeometryStaging &_staging) {
+  destroyBuffer(_renderer, _staging.VertexBuffer);
+  destroyBuffer(_renderer, _staging.PositionBuffer);
+  destroyBuffer(_renderer, _staging.IndexBuffer);
+  _staging = {};
+}
+
+static void recordCopy(VkCommandBuffer _cmd, const Buffer &_src,
+                       const Buffer &_dst, VkDeviceSize _dstOffset) {
+  VkBufferCopy region = {};
+  region.dstOffset = _dstOffset;
+  region.size = _src.Size;
+  vkCmdCopyBuffer(_cmd, _src.Handle, _dst.Handle, 1, &region);
+}
+
+GeometryAllocation recordGeometryUpload(VkCommandBuffer _cmd,
+                                        GeometryPool &_pool,
+                                        const GeometryStaging &_staging) {
+  GeometryAllocation allocation = {};
+
+  uint32_t numVertices = _staging.NumVertices;
+  uint32_t numIndices = _staging.NumIndices;
+  uint32_t vertexOffset;
+  uint32_t firstIndex;
+  if (!allocateRange(_pool.VertexAllocator, numVertices, vertexOffset)) {
+    BB_LOG_ERROR("Geometry pool is out of vertices ({} requested)",
+                 numVertices);
+    return allocation;
+  }
+  if (!allocateRange(_pool.IndexAllocator, numIndices, firstIndex)) {
+    BB_LOG_ERROR("Geometry pool is out of indices ({} requested)",
+                 numIndices);
+    freeRange(_pool.VertexAllocator, vertexOffset, numVertices);
+    return allocation;
+  }
+
+  if (numVertices > 0 && _pool.Layout == VertexStreamLayout::Split) {
+    recordCopy(_cmd, _staging.PositionBuffer, _pool.PositionBuffer,
+               sizeof(Float3) * vertexOffset);
+    recordCopy(_cmd, _staging.VertexBuffer, _pool.VertexBuffer,
+               sizeof(VertexAttributes) * vertexOffset);
+  } else if (numVertices > 0) {
+    recordCopy(_cmd, _staging.VertexBuffer, _pool.VertexBuffer,
+               sizeof(Vertex) * vertexOffset);
+  }
+  if (numIndices > 0) {
+    recordCopy(_cmd, _staging.IndexBuffer, _pool.IndexBuffer,
+               sizeof(uint32_t) * firstIndex);
+  }
+
+  allocation.FirstIndex = firstIndex;
+  allocation.NumIndices = numIndices;
+  allocation.VertexOffset = (int32_t)vertexOffset;
+  allocation.NumVertices = numVertices;
+  return allocation;
+}
+
+GeometryAllocation allocateGeometry(const Renderer &_renderer,
+                                    VkCommandPool _cmdPool,
+                                    GeometryPool &_pool,
+                                    const std::vector<Vertex> &_vertices,
+                                    const std::vector<uint32_t> &_indices,
+                                    std::string_view _name) {
+  AssetLoad load = beginAssetLoad(AssetType::Mesh, _name);
+  GeometryStaging staging =
+      stageGeometry(_renderer, _pool.Layout, _vertices, _indices);
+  load.NumDecodedBytes = getGeometryStagingSize(staging);
+  markAssetLoadStage(load, AssetLoadStage::Stage);
+
+  VkCommandBufferAllocateInfo cmdBufferAllocInfo = {};
+  cmdBufferAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  cmdBufferAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  cmdBufferAllocInfo.commandPool = _cmdPool;
+  cmdBufferAllocInfo.commandBufferCount = 1;
+  VkCommandBuffer cmdBuffer;
+  BB_VK_ASSERT(vkAllocateCommandBuffers(_renderer.Device, &cmdBufferAllocInfo,
+                                        &cmdBuffer));
+
+  VkCommandBufferBeginInfo cmdBeginInfo = {};
+  cmdBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  cmdBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  BB_VK_ASSERT(vkBeginCommandBuffer(cmdBuffer, &cmdBeginInfo));
+  GeometryAllocation allocation =
+      recordGeometryUpload(cmdBuffer, _pool, staging);
+  BB_VK_ASSERT(vkEndCommandBuffer(cmdBuffer));
+
+  VkSubmitInfo submitInfo = {};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &cmdBuffer;
+  BB_VK_ASSERT(vkQueueSubmit(_renderer.Queue, 1, &submitInfo, VK_NULL_HANDLE));
+  BB_VK_ASSERT(vkQueueWaitIdle(_renderer.Queue));
+  vkFreeCommandBuffers(_renderer.Device, _cmdPool, 1, &cmdBuffer);
+  load.Queue = (int)_renderer.QueueFamilyIndex;
+  markAssetLoadStage(load, AssetLoadStage::Submit);
+  endAssetLoad(load);
+
+  destroyGeometryStaging(_renderer, staging);
+  return allocation;
+}
+
+void freeGeometry(GeometryPool &_pool, GeometryAllocation &_allocation) {
+  freeRange(_pool.VertexAllocator, (uint32_t)_allocation.VertexOffset,
+            _allocation.NumVertices);
+  freeRange(_pool.IndexAllocator, _allocation.FirstIndex,
+            _allocation.NumIndices);
+  _allocation = {};
+}
+
+void bindGeometryPool(VkCommandBuffer _cmd, const GeometryPool &_pool) {
+  VkDeviceSize offset = 0;
+  if (_pool.Layout == VertexStreamLayout::Split) {
+    vkCmdBindVertexBuffers(_cmd, 0, 1, &_pool.PositionBuffer.Handle, &offset);
+    vkCmdBindVertexBuffers(_cmd, vertexAttributesBinding, 1,
+                           &_pool.VertexBuffer.Handle, &offset);
+  } else {
+    vkCmdBindVertexBuffers(_cmd, 0, 1, &_pool.VertexBuffer.Handle, &offset);
+  }
+  vkCmdBindIndexBuffer(_cmd, _pool.IndexBuffer.Handle, 0,
+                       VK_INDEX_TYPE_UINT32);
+}
+
+} // namespace bb
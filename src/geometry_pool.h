@@ -0,0 +1,104 @@
+#pragma once
+#include "render.h"
+#include <string_view>
+#include <vector>
+
+namespace bb {
+
+// First-fit allocator over a range of elements. Free ranges are kept sorted by
+// offset and merged with their neighbours on free.
+struct RangeAllocator {
+  struct Range {
+    uint32_t Offset;
+    uint32_t Size;
+  };
+
+  uint32_t Capacity;
+  uint32_t NumAllocated;
+  std::vector<Range> FreeRanges;
+};
+
+RangeAllocator createRangeAllocator(uint32_t _capacity);
+// Returns false if there is no free range large enough.
+bool allocateRange(RangeAllocator &_allocator, uint32_t _size,
+                   uint32_t &_offset);
+void freeRange(RangeAllocator &_allocator, uint32_t _offset, uint32_t _size);
+
+// A mesh living in a GeometryPool. Draw it with
+// vkCmdDrawIndexed(NumIndices, ..., FirstIndex, VertexOffset, ...).
+struct GeometryAllocation {
+  uint32_t FirstIndex;
+  uint32_t NumIndices;
+  int32_t VertexOffset;
+  uint32_t NumVertices;
+};
+
+// Large shared vertex and index buffers for static geometry. Everything
+// allocated from the pool is drawn after a single bindGeometryPool() call.
+struct GeometryPool {
+  VertexStreamLayout Layout;
+  // Holds Vertex, or VertexAttributes when the layout is Split.
+  Buffer VertexBuffer;
+  // Split layout only.
+  Buffer PositionBuffer;
+  Buffer IndexBuffer;
+  RangeAllocator VertexAllocator;
+  RangeAllocator IndexAllocator;
+};
+
+GeometryPool createGeometryPool(const Renderer &_renderer,
+                                uint32_t _maxNumVertices,
+                                uint32_t _maxNumIndices,
+                                VertexStreamLayout _layout);
+void destroyGeometryPool(const Renderer &_renderer, GeometryPool &_pool);
+
+// Returns an allocation with NumIndices == 0 if the pool is full. _name is
+// what the upload is reported as, see asset_report.h.
+GeometryAllocation allocateGeometry(const Renderer &_renderer,
+                                    VkCommandPool _cmdPool,
+                                    GeometryPool &_pool,
+                                    const std::vector<Vertex> &_vertices,
+                                    const std::vector<uint32_t> &_indices,
+                                    std::string_view _name);
+void freeGeometry(GeometryPool &_pool, GeometryAllocation &_allocation);
+
+// A mesh in host visible buffers, laid out for a pool of _layout. Staging
+// touches no pool, so it can happen on any thread ahead of the upload.
+struct GeometryStaging {
+  Buffer VertexBuffer;
+  // Split layout only.
+  Buffer PositionBuffer;
+  Buffer IndexBuffer;
+  uint32_t NumVertices;
+  uint32_t NumIndices;
+};
+
+GeometryStaging stageGeometry(const Renderer &_renderer,
+                              VertexStreamLayout _layout,
+                              const std::vector<Vertex> &_vertices,
+                              const std::vector<uint32_t> &_indices);
+void destroyGeometryStaging(const Renderer &_renderer,
+                            GeometryStaging &_staging);
+// Bytes across the staging buffers.
+uint64_t getGeometryStagingSize(const GeometryStaging &_staging);
+// Allocates from _pool and records the copies from _staging into it. The
+// staging buffers must outlive the commands. Returns an allocation with
+// NumIndices == 0 if the pool is full.
+GeometryAllocation recordGeometryUpload(VkCommandBuffer _cmd,
+                                        GeometryPool &_pool,
+                                        const GeometryStaging &_staging);
+
+void bindGeometryPool(VkCommandBuffer _cmd, const GeometryPool &_pool);
+
+struct RangeAllocatorStats {
+  uint32_t Capacity;
+  uint32_t NumAllocated;
+  uint32_t NumFreeRanges;
+  uint32_t LargestFreeRange;
+  // 0 when all free space is contiguous, approaching 1 as it gets scattered.
+  float Fragmentation;
+};
+
+RangeAllocatorStats getRangeAllocatorStats(const RangeAllocator &_allocator);
+
+} // namespace bb
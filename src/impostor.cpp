@@ -0,0 +1,441 @@
+#include "impostor.h"
+#include <algorithm>
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+namespace bb {
+
+// Inverse of the encoding in impostor.vert.
+static Float3 decodeOctahedral(float _u, float _v) {
+  float x = _u * 2.f - 1.f;
+  float z = _v * 2.f - 1.f;
+  float y = 1.f - fabsf(x) - fabsf(z);
+  if (y < 0.f) {
+    float foldedX = x;
+    x = (1.f - fabsf(z)) * (foldedX >= 0.f ? 1.f : -1.f);
+    z = (1.f - fabsf(foldedX)) * (z >= 0.f ? 1.f : -1.f);
+  }
+  return Float3{x, y, z}.normalize();
+}
+
+// Same as impostor.vert, which rebuilds each cell's axes from it.
+static Float3 getImpostorUpAxis(const Float3 &_dir) {
+  return fabsf(_dir.Y) > 0.99f ? Float3{0, 0, 1} : Float3{0, 1, 0};
+}
+
+// Reverse-Z orthographic projection of the bounding sphere seen from twice
+// its radius away, so that depth is 1 at its front and 0 at its back.
+static Mat4 getImpostorProjMat(float _radius) {
+  float nearZ = _radius;
+  float farZ = 3.f * _radius;
+  Mat4 proj = {};
+  proj.M[0][0] = 1.f / _radius;
+  proj.M[1][1] = -1.f / _radius;
+  proj.M[2][2] = -1.f / (farZ - nearZ);
+  proj.M[3][2] = farZ / (farZ - nearZ);
+  proj.M[3][3] = 1.f;
+  return proj;
+}
+
+// Attachments follow the G-buffer's locations, then depth. Only the maps
+// kept by atlases are stored.
+static VkRenderPass createBakeRenderPass(const Renderer &_renderer) {
+  VkAttachmentDescription attachments[numGBufferAttachments + 1] = {};
+  for (VkAttachmentDescription &attachment : attachments) {
+    attachment.format = gbufferAttachmentFormat;
+    attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    attachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  }
+  for (DeferredAttachmentType type :
+       {DeferredAttachmentType::GBufferPosition,
+        DeferredAttachmentType::GBufferBakedLighting}) {
+    VkAttachmentDescription &attachment =
+        attachments[(uint32_t)type -
+                    (uint32_t)DeferredAttachmentType::GBufferPosition];
+    attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  }
+  attachments[numGBufferAttachments].format = impostorDepthFormat;
+
+  VkAttachmentReference colorRefs[numGBufferAttachments] = {};
+  for (uint32_t i = 0; i < numGBufferAttachments; ++i) {
+    colorRefs[i].attachment = i;
+    colorRefs[i].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  }
+  VkAttachmentReference depthRef = {};
+  depthRef.attachment = numGBufferAttachments;
+  depthRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+  VkSubpassDescription subpass = {};
+  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpass.colorAttachmentCount = numGBufferAttachments;
+  subpass.pColorAttachments = colorRefs;
+  subpass.pDepthStencilAttachment = &depthRef;
+
+  VkSubpassDependency dependency = {};
+  dependency.srcSubpass = 0;
+  dependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+  dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                            VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  dependency.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                             VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  dependency.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+  VkRenderPassCreateInfo renderPassCreateInfo = {};
+  renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  renderPassCreateInfo.attachmentCount = (uint32_t)std::size(attachments);
+  renderPassCreateInfo.pAttachments = attachments;
+  renderPassCreateInfo.subpassCount = 1;
+  renderPassCreateInfo.pSubpasses = &subpass;
+  renderPassCreateInfo.dependencyCount = 1;
+  renderPassCreateInfo.pDependencies = &dependency;
+
+  VkRenderPass renderPass;
+  BB_VK_ASSERT(vkCreateRenderPass(_renderer.Device, &renderPassCreateInfo,
+                                  nullptr, &renderPass));
+  return renderPass;
+}
+
+ImpostorBaker createImpostorBaker(const Renderer &_renderer,
+                                  const StandardPipelineLayout &_layout,
+                                  DescriptorAllocator &_descriptorAllocator,
+                                  DescriptorSetCache &_descriptorSetCache,
+                                  const PBRMaterialSet &_materialSet,
+                                  VertexStreamLayout _vertexLayout,
+                                  const Shader &_gBufferVertShader,
+                                  const Shader &_gBufferFragShader) {
+  ImpostorBaker baker = {};
+  baker.PipelineLayout = _layout.Handle;
+  baker.MaterialDescriptorSetLayout =
+      _layout.DescriptorSetLayouts[DescriptorFrequency::PerMaterial].Handle;
+
+  baker.RenderPass = createBakeRenderPass(_renderer);
+
+  PipelineParams pipelineParams = {};
+  const Shader *shaders[] = {&_gBufferVertShader, &_gBufferFragShader};
+  pipelineParams.Shaders = shaders;
+  pipelineParams.NumShaders = std::size(shaders);
+  setVertexInput(pipelineParams, _vertexLayout);
+  pipelineParams.InputAssembly.Topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  pipelineParams.Viewport.IsDynamic = true;
+  pipelineParams.Rasterizer.PolygonMode = VK_POLYGON_MODE_FILL;
+  pipelineParams.Rasterizer.CullMode = VK_CULL_MODE_BACK_BIT;
+  pipelineParams.DepthStencil.DepthTestEnable = true;
+  pipelineParams.DepthStencil.DepthWriteEnable = true;
+  pipelineParams.Blend.NumColorBlends = numGBufferAttachments;
+  pipelineParams.Subpass = 0;
+  pipelineParams.PipelineLayout = _layout.Handle;
+  pipelineParams.RenderPass = baker.RenderPass;
+  baker.Pipeline = createPipeline(_renderer, pipelineParams);
+
+  ImageParams imageParams = {};
+  imageParams.Format = gbufferAttachmentFormat;
+  imageParams.Width = impostorAtlasExtent;
+  imageParams.Height = impostorAtlasExtent;
+  imageParams.Usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+  baker.PositionImage = createImage(_renderer, imageParams);
+  baker.BakedLightingImage = createImage(_renderer, imageParams);
+
+  baker.FrameDescriptorSet = allocateDescriptorSet(
+      _renderer, _descriptorAllocator,
+      _layout.DescriptorSetLayouts[DescriptorFrequency::PerFrame]);
+  for (VkDescriptorSet &viewDescriptorSet : baker.ViewDescriptorSets) {
+    viewDescriptorSet = allocateDescriptorSet(
+        _renderer, _descriptorAllocator,
+        _layout.DescriptorSetLayouts[DescriptorFrequency::PerView]);
+  }
+  // The same sets as the frames'.
+  baker.MaterialDescriptorSets =
+      getMaterialDescriptorSets(_renderer, _descriptorSetCache,
+                                _descriptorAllocator, _layout, _materialSet);
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(_renderer.PhysicalDevice, &properties);
+  uint32_t alignment =
+      (uint32_t)properties.limits.minUniformBufferOffsetAlignment;
+  baker.ViewUniformStride =
+      (sizeof(ViewUniformBlock) + alignment - 1) / alignment * alignment;
+  baker.ViewUniformBuffer =
+      createBuffer(_renderer, baker.ViewUniformStride * numImpostorCells,
+                   VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                       VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+  // Lightmapped draws aren't baked, but the G-buffer shaders still reference
+  // the lightmap.
+  VkDescriptorImageInfo lightmapInfo = {};
+  lightmapInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  lightmapInfo.imageView =
+      _materialSet.DefaultMaterial.Maps[PBRMapType::Albedo].View;
+
+  std::vector<VkWriteDescriptorSet> writeInfos;
+  VkWriteDescriptorSet writeInfo = {};
+  writeInfo.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  writeInfo.dstSet = baker.FrameDescriptorSet;
+  writeInfo.dstBinding = 11;
+  writeInfo.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+  writeInfo.descriptorCount = 1;
+  writeInfo.pImageInfo = &lightmapInfo;
+  writeInfos.push_back(writeInfo);
+
+  VkDescriptorBufferInfo viewBufferInfos[numImpostorCells] = {};
+  for (uint32_t cell = 0; cell < numImpostorCells; ++cell) {
+    viewBufferInfos[cell].buffer = baker.ViewUniformBuffer.Handle;
+    viewBufferInfos[cell].offset = cell * baker.ViewUniformStride;
+    viewBufferInfos[cell].range = sizeof(ViewUniformBlock);
+
+    writeInfo = {};
+    writeInfo.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writeInfo.dstSet = baker.ViewDescriptorSets[cell];
+    writeInfo.dstBinding = 0;
+    writeInfo.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    writeInfo.descriptorCount = 1;
+    writeInfo.pBufferInfo = &viewBufferInfos[cell];
+    writeInfos.push_back(writeInfo);
+  }
+  vkUpdateDescriptorSets(_renderer.Device, (uint32_t)writeInfos.size(),
+                         writeInfos.data(), 0, nullptr);
+
+  return baker;
+}
+
+void destroyImpostorBaker(const Renderer &_renderer, ImpostorBaker &_baker) {
+  destroyImage(_renderer, _baker.BakedLightingImage);
+  destroyImage(_renderer, _baker.PositionImage);
+  destroyBuffer(_renderer, _baker.ViewUniformBuffer);
+  vkDestroyPipeline(_renderer.Device, _baker.Pipeline, nullptr);
+  vkDestroyRenderPass(_renderer.Device, _baker.RenderPass, nullptr);
+  _baker = {};
+}
+
+static void createAtlasDescriptorSet(const Renderer &_renderer,
+                                     const ImpostorBaker &_baker,
+                                     ImpostorAtlas &_atlas) {
+  VkDescriptorPoolSize poolSize = {};
+  poolSize.type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+  poolSize.descriptorCount = PBRMaterial::NumImages;
+
+  VkDescriptorPoolCreateInfo poolCreateInfo = {};
+  poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolCreateInfo.maxSets = 1;
+  poolCreateInfo.poolSizeCount = 1;
+  poolCreateInfo.pPoolSizes = &poolSize;
+  BB_VK_ASSERT(vkCreateDescriptorPool(_renderer.Device, &poolCreateInfo,
+                                      nullptr, &_atlas.DescriptorPool));
+
+  VkDescriptorSetAllocateInfo allocInfo = {};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = _atlas.DescriptorPool;
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts = &_baker.MaterialDescriptorSetLayout;
+  BB_VK_ASSERT(vkAllocateDescriptorSets(_renderer.Device, &allocInfo,
+                                        &_atlas.DescriptorSet));
+
+  // The material set has more slots than there are maps, the rest repeat
+  // the albedo.
+  VkDescriptorImageInfo imageInfos[PBRMaterial::NumImages] = {};
+  for (uint32_t i = 0; i < PBRMaterial::NumImages; ++i) {
+    ImpostorMap map =
+        i < EnumCount<ImpostorMap> ? (ImpostorMap)i : ImpostorMap::Albedo;
+    imageInfos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageInfos[i].imageView = _atlas.Maps[map].View;
+  }
+
+  VkWriteDescriptorSet writeInfo = {};
+  writeInfo.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  writeInfo.dstSet = _atlas.DescriptorSet;
+  writeInfo.dstBinding = 0;
+  writeInfo.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+  writeInfo.descriptorCount = PBRMaterial::NumImages;
+  writeInfo.pImageInfo = imageInfos;
+  vkUpdateDescriptorSets(_renderer.Device, 1, &writeInfo, 0, nullptr);
+}
+
+ImpostorAtlas
+bakeImpostorAtlas(const Renderer &_renderer, VkCommandPool _cmdPool,
+                  const ImpostorBaker &_baker, const Float3 &_center,
+                  float _radius,
+                  const std::function<void(VkCommandBuffer)> &_drawMesh) {
+  ImpostorAtlas atlas = {};
+  atlas.Center = _center;
+  atlas.Radius = _radius;
+
+  ImageParams imageParams = {};
+  imageParams.Format = gbufferAttachmentFormat;
+  imageParams.Width = impostorAtlasExtent;
+  imageParams.Height = impostorAtlasExtent;
+  imageParams.Usage =
+      VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  atlas.Maps[ImpostorMap::Albedo] = createImage(_renderer, imageParams);
+  atlas.Maps[ImpostorMap::Normal] = createImage(_renderer, imageParams);
+  atlas.Maps[ImpostorMap::MRAH] = createImage(_renderer, imageParams);
+  imageParams.Format = impostorDepthFormat;
+  imageParams.Usage =
+      VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  imageParams.Aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+  atlas.Maps[ImpostorMap::Depth] = createImage(_renderer, imageParams);
+
+  VkImageView attachments[] = {
+      _baker.PositionImage.View,
+      atlas.Maps[ImpostorMap::Normal].View,
+      atlas.Maps[ImpostorMap::Albedo].View,
+      atlas.Maps[ImpostorMap::MRAH].View,
+      _baker.BakedLightingImage.View,
+      atlas.Maps[ImpostorMap::Depth].View,
+  };
+  VkFramebufferCreateInfo fbCreateInfo = {};
+  fbCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+  fbCreateInfo.renderPass = _baker.RenderPass;
+  fbCreateInfo.attachmentCount = (uint32_t)std::size(attachments);
+  fbCreateInfo.pAttachments = attachments;
+  fbCreateInfo.width = impostorAtlasExtent;
+  fbCreateInfo.height = impostorAtlasExtent;
+  fbCreateInfo.layers = 1;
+  VkFramebuffer framebuffer;
+  BB_VK_ASSERT(vkCreateFramebuffer(_renderer.Device, &fbCreateInfo, nullptr,
+                                   &framebuffer));
+
+  {
+    uint8_t *data;
+    vkMapMemory(_renderer.Device, _baker.ViewUniformBuffer.Memory, 0,
+                _baker.ViewUniformBuffer.Size, 0, (void **)&data);
+    Mat4 projMat = getImpostorProjMat(_radius);
+    for (uint32_t y = 0; y < impostorGridSize; ++y) {
+      for (uint32_t x = 0; x < impostorGridSize; ++x) {
+        Float3 dir = decodeOctahedral(((float)x + 0.5f) / impostorGridSize,
+                                      ((float)y + 0.5f) / impostorGridSize);
+        ViewUniformBlock view = {};
+        view.ViewPos = _center + dir * (2.f * _radius);
+        view.ViewMat =
+            Mat4::lookAt(view.ViewPos, _center, getImpostorUpAxis(dir));
+        view.ProjMat = projMat;
+        view.EnableNormalMap = 1;
+        memcpy(data + (y * impostorGridSize + x) * _baker.ViewUniformStride,
+               &view, sizeof(view));
+      }
+    }
+    vkUnmapMemory(_renderer.Device, _baker.ViewUniformBuffer.Memory);
+  }
+
+  VkCommandBufferAllocateInfo cmdBufferAllocInfo = {};
+  cmdBufferAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  cmdBufferAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  cmdBufferAllocInfo.commandPool = _cmdPool;
+  cmdBufferAllocInfo.commandBufferCount = 1;
+
+  VkCommandBuffer cmdBuffer;
+  BB_VK_ASSERT(vkAllocateCommandBuffers(_renderer.Device, &cmdBufferAllocInfo,
+                                        &cmdBuffer));
+
+  VkCommandBufferBeginInfo cmdBeginInfo = {};
+  cmdBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  cmdBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  BB_VK_ASSERT(vkBeginCommandBuffer(cmdBuffer, &cmdBeginInfo));
+
+  // Reverse-Z, so depth clears to the far plane at 0, which also marks
+  // texels the mesh doesn't cover.
+  VkClearValue clearValues[numGBufferAttachments + 1] = {};
+  clearValues[numGBufferAttachments].depthStencil = {0.f, 0};
+
+  VkRenderPassBeginInfo renderPassInfo = {};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+  renderPassInfo.renderPass = _baker.RenderPass;
+  renderPassInfo.framebuffer = framebuffer;
+  renderPassInfo.renderArea.extent = {impostorAtlasExtent, impostorAtlasExtent};
+  renderPassInfo.clearValueCount = (uint32_t)std::size(clearValues);
+  renderPassInfo.pClearValues = clearValues;
+  vkCmdBeginRenderPass(cmdBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+  vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    _baker.Pipeline);
+  vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          _baker.PipelineLayout, 0, 1,
+                          &_baker.FrameDescriptorSet, 0, nullptr);
+  StandardPushConstants pushConstants = {};
+  vkCmdPushConstants(cmdBuffer, _baker.PipelineLayout,
+                     VK_SHADER_STAGE_VERTEX_BIT, 0,
+                     offsetof(StandardPushConstants, ShadowViewProj),
+                     &pushConstants);
+
+  for (uint32_t cell = 0; cell < numImpostorCells; ++cell) {
+    VkViewport viewport = {};
+    viewport.x = (float)(cell % impostorGridSize * impostorCellExtent);
+    viewport.y = (float)(cell / impostorGridSize * impostorCellExtent);
+    viewport.width = (float)impostorCellExtent;
+    viewport.height = (float)impostorCellExtent;
+    viewport.minDepth = 0.f;
+    viewport.maxDepth = 1.f;
+    vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor = {};
+    scissor.offset = {(int32_t)viewport.x, (int32_t)viewport.y};
+    scissor.extent = {impostorCellExtent, impostorCellExtent};
+    vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            _baker.PipelineLayout, 1, 1,
+                            &_baker.ViewDescriptorSets[cell], 0, nullptr);
+    _drawMesh(cmdBuffer);
+  }
+
+  vkCmdEndRenderPass(cmdBuffer);
+  BB_VK_ASSERT(vkEndCommandBuffer(cmdBuffer));
+
+  VkSubmitInfo submitInfo = {};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &cmdBuffer;
+  BB_VK_ASSERT(vkQueueSubmit(_renderer.Queue, 1, &submitInfo, VK_NULL_HANDLE));
+  BB_VK_ASSERT(vkQueueWaitIdle(_renderer.Queue));
+  vkFreeCommandBuffers(_renderer.Device, _cmdPool, 1, &cmdBuffer);
+  vkDestroyFramebuffer(_renderer.Device, framebuffer, nullptr);
+
+  createAtlasDescriptorSet(_renderer, _baker, atlas);
+  return atlas;
+}
+
+void destroyImpostorAtlas(const Renderer &_renderer, ImpostorAtlas &_atlas) {
+  vkDestroyDescriptorPool(_renderer.Device, _atlas.DescriptorPool, nullptr);
+  for (Image &map : _atlas.Maps) {
+    destroyImage(_renderer, map);
+  }
+  _atlas = {};
+}
+
+Mat4 getImpostorModelMat(const ImpostorAtlas &_atlas, const Mat4 &_modelMat) {
+  return _modelMat * Mat4::translate(_atlas.Center) *
+         Mat4::scale(_atlas.Radius);
+}
+
+void setImpostorVertexInput(PipelineParams &_params) {
+  static std::vector<VkVertexInputBindingDescription> bindings;
+  static std::vector<VkVertexInputAttributeDescription> attributes;
+  if (bindings.empty()) {
+    for (const VkVertexInputBindingDescription &binding :
+         MeshVertexInput::Bindings) {
+      if (binding.inputRate == VK_VERTEX_INPUT_RATE_INSTANCE) {
+        bindings.push_back(binding);
+      }
+    }
+    for (const VkVertexInputAttributeDescription &attribute :
+         MeshVertexInput::Attributes) {
+      if (attribute.binding == bindings[0].binding) {
+        attributes.push_back(attribute);
+      }
+    }
+  }
+
+  _params.VertexInput.Bindings = bindings.data();
+  _params.VertexInput.NumBindings = (int)bindings.size();
+  _params.VertexInput.Attributes = attributes.data();
+  _params.VertexInput.NumAttributes = (int)attributes.size();
+}
+
+} // namespace bb
@@ -0,0 +1,93 @@
+#pragma once
+#include "render.h"
+#include "descriptor_allocator.h"
+#include <functional>
+
+namespace bb {
+
+// Octahedral impostors: a mesh is rendered into one atlas cell per direction
+// of an impostorGridSize x impostorGridSize grid over the octahedral map of
+// the sphere, y up. Each cell is an orthographic view of the mesh's bounding
+// sphere from that direction, through the G-buffer shaders, keeping normal,
+// albedo, MRAH and depth. Drawn as camera-facing quads, impostor.frag picks
+// the cell closest to the view direction and writes G-buffer data at the
+// depth it read, so that impostors are lit like the mesh they stand in for.
+//
+// Impostors live in unit space: the bounding sphere is the unit sphere, and
+// getImpostorModelMat() moves it to where the mesh is.
+
+constexpr uint32_t impostorGridSize = 8;
+constexpr uint32_t numImpostorCells = impostorGridSize * impostorGridSize;
+constexpr uint32_t impostorCellExtent = 128;
+constexpr uint32_t impostorAtlasExtent = impostorGridSize * impostorCellExtent;
+constexpr VkFormat impostorDepthFormat = VK_FORMAT_D32_SFLOAT;
+
+// Normal is in the mesh's space, depth is 1 at the front of the bounding
+// sphere as seen from the cell's direction and 0 at the back or where the
+// mesh wasn't drawn.
+enum class ImpostorMap { Albedo, Normal, MRAH, Depth, COUNT };
+
+struct ImpostorAtlas {
+  EnumArray<ImpostorMap, Image> Maps;
+  // Bound as the material set, in ImpostorMap order.
+  VkDescriptorPool DescriptorPool;
+  VkDescriptorSet DescriptorSet;
+  // Bounding sphere of the mesh in its own space.
+  Float3 Center;
+  float Radius;
+};
+
+// Renders atlases with the G-buffer shaders. A pipeline is tied to the
+// render pass it was created for, so the baker has its own, compatible with
+// the G-buffer attachments, and its own descriptor sets.
+struct ImpostorBaker {
+  VkRenderPass RenderPass;
+  VkPipeline Pipeline;
+  VkPipelineLayout PipelineLayout;
+  VkDescriptorSetLayout MaterialDescriptorSetLayout;
+
+  // The sets come from the allocator the baker was created with, and go
+  // with it rather than with the baker.
+  VkDescriptorSet FrameDescriptorSet;
+  // One view per cell, at ViewUniformStride apart in ViewUniformBuffer.
+  VkDescriptorSet ViewDescriptorSets[numImpostorCells];
+  Buffer ViewUniformBuffer;
+  uint32_t ViewUniformStride;
+  // Indexed like PBRMaterialSet::Materials.
+  std::vector<VkDescriptorSet> MaterialDescriptorSets;
+
+  // The G-buffer attachments that atlases don't keep.
+  Image PositionImage;
+  Image BakedLightingImage;
+};
+
+ImpostorBaker createImpostorBaker(const Renderer &_renderer,
+                                  const StandardPipelineLayout &_layout,
+                                  DescriptorAllocator &_descriptorAllocator,
+                                  DescriptorSetCache &_descriptorSetCache,
+                                  const PBRMaterialSet &_materialSet,
+                                  VertexStreamLayout _vertexLayout,
+                                  const Shader &_gBufferVertShader,
+                                  const Shader &_gBufferFragShader);
+void destroyImpostorBaker(const Renderer &_renderer, ImpostorBaker &_baker);
+
+// Bakes whatever _drawMesh draws inside the sphere at _center of _radius.
+// _drawMesh is called once per cell, with the baker's pipeline and standard
+// descriptor sets bound, and binds its own vertex, index and instance
+// buffers and materials, see ImpostorBaker::MaterialDescriptorSets. Waits
+// for the bake to finish.
+ImpostorAtlas
+bakeImpostorAtlas(const Renderer &_renderer, VkCommandPool _cmdPool,
+                  const ImpostorBaker &_baker, const Float3 &_center,
+                  float _radius,
+                  const std::function<void(VkCommandBuffer)> &_drawMesh);
+void destroyImpostorAtlas(const Renderer &_renderer, ImpostorAtlas &_atlas);
+
+// Instance transform that draws _atlas where _modelMat puts the mesh.
+Mat4 getImpostorModelMat(const ImpostorAtlas &_atlas, const Mat4 &_modelMat);
+
+// Points _params.VertexInput at InstanceBlock alone. Impostors make their
+// quads from gl_VertexIndex, six vertices per instance.
+void setImpostorVertexInput(PipelineParams &_params);
+
+} // namespace bb
@@ -0,0 +1,97 @@
+#include "job.h"
+#include "util.h"
+
+namespace bb {
+
+static bool popJob(JobSystem &_jobSystem, Job &_job) {
+  std::lock_guard<std::mutex> lock(_jobSystem.QueueMutex);
+  if (_jobSystem.Queue.empty()) {
+    return false;
+  }
+  _job = std::move(_jobSystem.Queue.front());
+  _jobSystem.Queue.pop_front();
+  return true;
+}
+
+static void executeJob(Job &_job) {
+  _job.Func();
+  _job.Counter->NumPendingJobs.fetch_sub(1, std::memory_order_release);
+}
+
+static void runWorker(JobSystem *_jobSystem) {
+  for (;;) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(_jobSystem->QueueMutex);
+      _jobSystem->QueueCondition.wait(lock, [_jobSystem]() {
+        return _jobSystem->IsShuttingDown || !_jobSystem->Queue.empty();
+      });
+      if (_jobSystem->Queue.empty()) {
+        return;
+      }
+      job = std::move(_jobSystem->Queue.front());
+      _jobSystem->Queue.pop_front();
+    }
+    executeJob(job);
+  }
+}
+
+void initJobSystem(JobSystem &_jobSystem, int _numWorkers) {
+  if (_numWorkers <= 0) {
+    _numWorkers = std::max((int)std::thread::hardware_concurrency() - 1, 1);
+  }
+
+  _jobSystem.IsShuttingDown = false;
+  _jobSystem.Workers.reserve(_numWorkers);
+  for (int i = 0; i < _numWorkers; ++i) {
+    _jobSystem.Workers.emplace_back(runWorker, &_jobSystem);
+  }
+
+  BB_LOG_INFO("Job system started with {} workers", _numWorkers);
+}
+
+void destroyJobSystem(JobSystem &_jobSystem) {
+  {
+    std::lock_guard<std::mutex> lock(_jobSystem.QueueMutex);
+    _jobSystem.IsShuttingDown = true;
+  }
+  _jobSystem.QueueCondition.notify_all();
+
+  for (std::thread &worker : _jobSystem.Workers) {
+    worker.join();
+  }
+  _jobSystem.Workers.clear();
+  BB_ASSERT(_jobSystem.Queue.empty());
+}
+
+int getNumJobThreads(const JobSystem &_jobSystem) {
+  return (int)_jobSystem.Workers.size() + 1;
+}
+
+void runJob(JobSystem &_jobSystem, JobCounter &_counter, JobFunc _func) {
+  _counter.NumPendingJobs.fetch_add(1, std::memory_order_relaxed);
+  {
+    std::lock_guard<std::mutex> lock(_jobSystem.QueueMutex);
+    _jobSystem.Queue.push_back({std::move(_func), &_counter});
+  }
+  _jobSystem.QueueCondition.notify_one();
+}
+
+void waitForCounter(JobSystem &_jobSystem, JobCounter &_counter) {
+  while (_counter.NumPendingJobs.load(std::memory_order_acquire) > 0) {
+    if (!tryRunJob(_jobSystem)) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+bool tryRunJob(JobSystem &_jobSystem) {
+  Job job;
+  if (!popJob(_jobSystem, job)) {
+    return false;
+  }
+  executeJob(job);
+  return true;
+}
+
+} // namespace bb
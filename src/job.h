@@ -0,0 +1,72 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace bb {
+
+using JobFunc = std::function<void()>;
+
+// Counts jobs that haven't finished yet. A counter may be reused after
+// waitForCounter() returns.
+struct JobCounter {
+  std::atomic<int> NumPendingJobs{0};
+};
+
+struct Job {
+  JobFunc Func;
+  JobCounter *Counter;
+};
+
+struct JobSystem {
+  std::vector<std::thread> Workers;
+  std::deque<Job> Queue;
+  std::mutex QueueMutex;
+  std::condition_variable QueueCondition;
+  bool IsShuttingDown = false;
+};
+
+// _numWorkers == 0 spawns one worker per hardware thread except the calling
+// one, which joins in while it waits on a counter.
+void initJobSystem(JobSystem &_jobSystem, int _numWorkers = 0);
+void destroyJobSystem(JobSystem &_jobSystem);
+
+int getNumJobThreads(const JobSystem &_jobSystem);
+
+void runJob(JobSystem &_jobSystem, JobCounter &_counter, JobFunc _func);
+// Executes queued jobs on the calling thread until _counter reaches zero.
+void waitForCounter(JobSystem &_jobSystem, JobCounter &_counter);
+// Executes one queued job on the calling thread. Returns false if there was
+// none.
+bool tryRunJob(JobSystem &_jobSystem);
+
+// Calls _func(i) for every i in [0, _count), splitting the range into batches
+// of _batchSize. Blocks until every batch is done.
+template <typename Fn>
+void parallelFor(JobSystem &_jobSystem, int _count, int _batchSize,
+                 const Fn &_func) {
+  if (_count <= 0) {
+    return;
+  }
+  if (_batchSize <= 0) {
+    _batchSize = 1;
+  }
+
+  JobCounter counter;
+  for (int begin = 0; begin < _count; begin += _batchSize) {
+    int end = std::min(begin + _batchSize, _count);
+    runJob(_jobSystem, counter, [begin, end, &_func]() {
+      for (int i = begin; i < end; ++i) {
+        _func(i);
+      }
+    });
+  }
+  waitForCounter(_jobSystem, counter);
+}
+
+} // namespace bb
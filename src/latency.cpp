@@ -0,0 +1,266 @@
+#include "latency.h"
+#include "util.h"
+#include <algorithm>
+#include <chrono>
+
+namespace bb {
+
+static const char *latencyStageNames[] = {"input", "update", "record",
+                                          "submit", "present"};
+static_assert(std::size(latencyStageNames) == EnumCount<LatencyStage>);
+
+void initLatencyTracker(LatencyTracker &_tracker, const Renderer &_renderer,
+                        const SwapChain &_swapChain, int _refreshRate) {
+  _tracker.UsesDisplayTiming = _renderer.SupportsDisplayTiming;
+  _tracker.RefreshNs = 1000000000ll / std::max(_refreshRate, 1);
+  if (_tracker.UsesDisplayTiming) {
+    VkRefreshCycleDurationGOOGLE refreshCycle;
+    if (vkGetRefreshCycleDurationGOOGLE(_renderer.Device, _swapChain.Handle,
+                                        &refreshCycle) == VK_SUCCESS) {
+      _tracker.RefreshNs = (int64_t)refreshCycle.refreshDuration;
+    }
+  }
+  _tracker.NextFrameId = 1;
+  _tracker.SamplesMs.reserve(LatencyTracker::MaxNumSamples);
+  _tracker.StageSamplesMs.reserve(LatencyTracker::MaxNumSamples);
+}
+
+int64_t getLatencyTimeNs() {
+  // The clock display timing reports in, on the platforms that have it.
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void onLatencyEvent(LatencyTracker &_tracker, const SDL_Event &_event) {
+  switch (_event.type) {
+  case SDL_MOUSEBUTTONDOWN:
+  case SDL_MOUSEBUTTONUP:
+  case SDL_MOUSEMOTION:
+  case SDL_MOUSEWHEEL:
+  case SDL_KEYDOWN:
+  case SDL_KEYUP:
+    break;
+  default:
+    return;
+  }
+
+  // Event timestamps are SDL_GetTicks() milliseconds.
+  int64_t ageNs = (int64_t)(SDL_GetTicks() - _event.common.timestamp) * 1000000;
+  int64_t timeNs = getLatencyTimeNs() - ageNs;
+  if (_tracker.PendingInputNs == 0 || timeNs < _tracker.PendingInputNs) {
+    _tracker.PendingInputNs = timeNs;
+  }
+}
+
+void beginLatencyFrame(LatencyTracker &_tracker) {
+  LatencyFrame &frame = _tracker.CurrentFrame;
+  frame = {};
+  frame.Id = _tracker.NextFrameId++;
+  frame.HasInput = _tracker.PendingInputNs != 0;
+  frame.TimesNs[LatencyStage::Input] = _tracker.PendingInputNs;
+  frame.TimesNs[LatencyStage::Update] = getLatencyTimeNs();
+  _tracker.PendingInputNs = 0;
+}
+
+void markLatencyStage(LatencyTracker &_tracker, LatencyStage _stage) {
+  _tracker.CurrentFrame.TimesNs[_stage] = getLatencyTimeNs();
+}
+
+uint64_t getLatencyFrameId(const LatencyTracker &_tracker) {
+  return _tracker.CurrentFrame.Id;
+}
+
+void submitLatencyFrame(LatencyTracker &_tracker, uint32_t _frameIndex) {
+  markLatencyStage(_tracker, LatencyStage::Submit);
+  _tracker.CurrentFrame.FrameIndex = _frameIndex;
+  _tracker.InFlightFrames.push_back(_tracker.CurrentFrame);
+}
+
+void setLatencyPresentInfo(const LatencyTracker &_tracker,
+                           VkPresentInfoKHR &_presentInfo,
+                           VkPresentTimesInfoGOOGLE &_info,
+                           VkPresentTimeGOOGLE &_time) {
+  if (!_tracker.UsesDisplayTiming) {
+    return;
+  }
+  _time = {};
+  _time.presentID = (uint32_t)_tracker.CurrentFrame.Id;
+  _info = {};
+  _info.sType = VK_STRUCTURE_TYPE_PRESENT_TIMES_INFO_GOOGLE;
+  _info.pNext = _presentInfo.pNext;
+  _info.swapchainCount = 1;
+  _info.pTimes = &_time;
+  _presentInfo.pNext = &_info;
+}
+
+static float getPercentile(const std::vector<float> &_sortedMs,
+                           float _percentile) {
+  size_t i = (size_t)(_percentile * (float)(_sortedMs.size() - 1) + 0.5f);
+  return _sortedMs[i];
+}
+
+static LatencyStats
+computeLatencyStats(std::vector<float> _samplesMs,
+                    const std::vector<EnumArray<LatencyStage, float>>
+                        &_stageSamplesMs) {
+  LatencyStats stats = {};
+  stats.NumSamples = (uint32_t)_samplesMs.size();
+  if (_samplesMs.empty()) {
+    return stats;
+  }
+
+  std::sort(_samplesMs.begin(), _samplesMs.end());
+  for (float ms : _samplesMs) {
+    stats.MeanMs += ms;
+  }
+  stats.MeanMs /= (float)_samplesMs.size();
+  stats.P50Ms = getPercentile(_samplesMs, 0.5f);
+  stats.P95Ms = getPercentile(_samplesMs, 0.95f);
+  stats.P99Ms = getPercentile(_samplesMs, 0.99f);
+  stats.MaxMs = _samplesMs.back();
+
+  for (const EnumArray<LatencyStage, float> &stageMs : _stageSamplesMs) {
+    for (int i = 0; i < (int)EnumCount<LatencyStage>; ++i) {
+      stats.StageMs.Elems[i] += stageMs.Elems[i];
+    }
+  }
+  for (float &ms : stats.StageMs) {
+    ms /= (float)_stageSamplesMs.size();
+  }
+  return stats;
+}
+
+static void printLatencyStats(const LatencyStats &_stats, bool _isEstimated) {
+  printLine("Input to present over {} frames{}: mean {:.2f} ms, p50 {:.2f} "
+            "ms, p95 {:.2f} ms, p99 {:.2f} ms, max {:.2f} ms",
+            _stats.NumSamples, _isEstimated ? " (estimated)" : "",
+            _stats.MeanMs, _stats.P50Ms, _stats.P95Ms, _stats.P99Ms,
+            _stats.MaxMs);
+  for (int i = 0; i + 1 < (int)EnumCount<LatencyStage>; ++i) {
+    printLine("  {} to {}: {:.2f} ms", latencyStageNames[i],
+              latencyStageNames[i + 1], _stats.StageMs.Elems[i]);
+  }
+}
+
+static void addLatencySample(LatencyTracker &_tracker,
+                             const LatencyFrame &_frame) {
+  _tracker.LastPresentNs = _frame.TimesNs[LatencyStage::Present];
+  if (!_frame.HasInput) {
+    return;
+  }
+
+  float latencyMs = (float)(_frame.TimesNs[LatencyStage::Present] -
+                            _frame.TimesNs[LatencyStage::Input]) *
+                    1e-6f;
+  EnumArray<LatencyStage, float> stageMs = {};
+  for (int i = 0; i + 1 < (int)EnumCount<LatencyStage>; ++i) {
+    stageMs.Elems[i] =
+        (float)(_frame.TimesNs.Elems[i + 1] - _frame.TimesNs.Elems[i]) * 1e-6f;
+  }
+
+  if (_tracker.SamplesMs.size() < LatencyTracker::MaxNumSamples) {
+    _tracker.SamplesMs.push_back(latencyMs);
+    _tracker.StageSamplesMs.push_back(stageMs);
+  } else {
+    _tracker.SamplesMs[_tracker.NextSample] = latencyMs;
+    _tracker.StageSamplesMs[_tracker.NextSample] = stageMs;
+  }
+  _tracker.NextSample =
+      (_tracker.NextSample + 1) % LatencyTracker::MaxNumSamples;
+
+  if (_tracker.IsMeasuring) {
+    _tracker.MeasuredMs.push_back(latencyMs);
+    _tracker.MeasuredStageMs.push_back(stageMs);
+    if (_tracker.MeasuredMs.size() >= _tracker.MeasureNumSamples) {
+      _tracker.IsMeasuring = false;
+      _tracker.HasMeasured = true;
+      _tracker.MeasuredStats =
+          computeLatencyStats(_tracker.MeasuredMs, _tracker.MeasuredStageMs);
+      printLatencyStats(_tracker.MeasuredStats, !_tracker.UsesDisplayTiming);
+    }
+  }
+}
+
+void updateLatencyTracker(LatencyTracker &_tracker, const Renderer &_renderer,
+                          const SwapChain &_swapChain,
+                          const std::vector<FrameSync> &_frameSyncs) {
+  std::vector<LatencyFrame> &frames = _tracker.InFlightFrames;
+
+  if (_tracker.UsesDisplayTiming) {
+    uint32_t numTimings = 0;
+    vkGetPastPresentationTimingGOOGLE(_renderer.Device, _swapChain.Handle,
+                                      &numTimings, nullptr);
+    std::vector<VkPastPresentationTimingGOOGLE> timings(numTimings);
+    vkGetPastPresentationTimingGOOGLE(_renderer.Device, _swapChain.Handle,
+                                      &numTimings, timings.data());
+    for (uint32_t i = 0; i < numTimings; ++i) {
+      for (LatencyFrame &frame : frames) {
+        if ((uint32_t)frame.Id == timings[i].presentID) {
+          frame.TimesNs[LatencyStage::Present] =
+              (int64_t)timings[i].actualPresentTime;
+        }
+      }
+    }
+
+    // Frames whose timing never comes, such as those presented to a swap
+    // chain since recreated, are given up on.
+    constexpr uint64_t maxNumPendingFrames = 64;
+    size_t numDone = 0;
+    for (const LatencyFrame &frame : frames) {
+      bool isPresented = frame.TimesNs[LatencyStage::Present] != 0;
+      if (!isPresented &&
+          frame.Id + maxNumPendingFrames > _tracker.CurrentFrame.Id) {
+        break;
+      }
+      if (isPresented) {
+        addLatencySample(_tracker, frame);
+      }
+      ++numDone;
+    }
+    frames.erase(frames.begin(), frames.begin() + numDone);
+    return;
+  }
+
+  // The fence of each frame in flight belongs to its latest submission until
+  // it's reset, so a signaled one means that frame is done.
+  int64_t nowNs = getLatencyTimeNs();
+  size_t numDone = 0;
+  for (LatencyFrame &frame : frames) {
+    if (vkGetFenceStatus(_renderer.Device,
+                         _frameSyncs[frame.FrameIndex].FrameAvailableFence) !=
+        VK_SUCCESS) {
+      break;
+    }
+    frame.TimesNs[LatencyStage::Present] =
+        std::max(nowNs, _tracker.LastPresentNs + _tracker.RefreshNs);
+    frame.IsPresentEstimated = true;
+    addLatencySample(_tracker, frame);
+    ++numDone;
+  }
+  frames.erase(frames.begin(), frames.begin() + numDone);
+}
+
+LatencyStats getLatencyStats(const LatencyTracker &_tracker) {
+  return computeLatencyStats(_tracker.SamplesMs, _tracker.StageSamplesMs);
+}
+
+void getLatencyHistory(const LatencyTracker &_tracker,
+                       std::vector<float> &_samplesMs) {
+  _samplesMs.clear();
+  size_t numSamples = _tracker.SamplesMs.size();
+  size_t first = numSamples < LatencyTracker::MaxNumSamples
+                     ? 0
+                     : (size_t)_tracker.NextSample;
+  for (size_t i = 0; i < numSamples; ++i) {
+    _samplesMs.push_back(_tracker.SamplesMs[(first + i) % numSamples]);
+  }
+}
+
+void beginLatencyMeasurement(LatencyTracker &_tracker) {
+  _tracker.IsMeasuring = true;
+  _tracker.MeasuredMs.clear();
+  _tracker.MeasuredStageMs.clear();
+}
+
+} // namespace bb
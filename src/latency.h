@@ -0,0 +1,110 @@
+#pragma once
+#include "render.h"
+#include "external/SDL2/SDL_events.h"
+#include <vector>
+
+namespace bb {
+
+// Measures how long input takes to reach the screen. Every frame gets an ID
+// that follows it through update, record, submit and present, along with the
+// time of the earliest input event it consumed.
+//
+// With VK_GOOGLE_display_timing the frame ID is the present ID, and the
+// present time is what the display engine reports. Without it the present
+// time is estimated on the CPU: the first time the frame's fence is seen
+// signaled, pushed back to one refresh after the previous frame's present,
+// as FIFO presents at most one frame per refresh.
+
+// In frame order.
+enum class LatencyStage { Input, Update, Record, Submit, Present, COUNT };
+
+struct LatencyFrame {
+  uint64_t Id;
+  // Nanoseconds on the steady clock, 0 for stages not reached yet.
+  EnumArray<LatencyStage, int64_t> TimesNs;
+  uint32_t FrameIndex;
+  bool HasInput;
+  bool IsPresentEstimated;
+};
+
+struct LatencyStats {
+  uint32_t NumSamples;
+  // Input to present.
+  float MeanMs;
+  float P50Ms;
+  float P95Ms;
+  float P99Ms;
+  float MaxMs;
+  // Mean time from each stage to the next, the last one left at 0.
+  EnumArray<LatencyStage, float> StageMs;
+};
+
+struct LatencyTracker {
+  static constexpr uint32_t MaxNumSamples = 512;
+
+  bool UsesDisplayTiming;
+  int64_t RefreshNs;
+
+  uint64_t NextFrameId;
+  // Earliest input event polled since the last frame began, 0 if none.
+  int64_t PendingInputNs;
+  LatencyFrame CurrentFrame;
+  // Submitted, not presented yet.
+  std::vector<LatencyFrame> InFlightFrames;
+  int64_t LastPresentNs;
+
+  // Input to present of the most recent frames with input, as a ring.
+  std::vector<float> SamplesMs;
+  std::vector<EnumArray<LatencyStage, float>> StageSamplesMs;
+  uint32_t NextSample;
+
+  // Collects MeasureNumSamples frames with input, then prints their stats.
+  bool IsMeasuring;
+  uint32_t MeasureNumSamples = 300;
+  std::vector<float> MeasuredMs;
+  std::vector<EnumArray<LatencyStage, float>> MeasuredStageMs;
+  bool HasMeasured;
+  LatencyStats MeasuredStats;
+};
+
+// _refreshRate is only used to estimate present times, pass the display's.
+void initLatencyTracker(LatencyTracker &_tracker, const Renderer &_renderer,
+                        const SwapChain &_swapChain, int _refreshRate);
+
+int64_t getLatencyTimeNs();
+
+// Call for every polled event. Only input events are timed, back dated by how
+// long they sat in the queue.
+void onLatencyEvent(LatencyTracker &_tracker, const SDL_Event &_event);
+
+// Starts the next frame and hands it the input polled so far. Call right after
+// polling.
+void beginLatencyFrame(LatencyTracker &_tracker);
+void markLatencyStage(LatencyTracker &_tracker, LatencyStage _stage);
+uint64_t getLatencyFrameId(const LatencyTracker &_tracker);
+
+// Call right after submitting the frame. _frameIndex is the frame in flight
+// whose fence the submission signals.
+void submitLatencyFrame(LatencyTracker &_tracker, uint32_t _frameIndex);
+
+// Fills _time and chains _info to _presentInfo when display timing is used.
+// Both have to live until vkQueuePresentKHR() returns.
+void setLatencyPresentInfo(const LatencyTracker &_tracker,
+                           VkPresentInfoKHR &_presentInfo,
+                           VkPresentTimesInfoGOOGLE &_info,
+                           VkPresentTimeGOOGLE &_time);
+
+// Resolves the present times of the frames in flight. Call after waiting for
+// the fence of the frame about to be recorded, and before resetting it.
+void updateLatencyTracker(LatencyTracker &_tracker, const Renderer &_renderer,
+                          const SwapChain &_swapChain,
+                          const std::vector<FrameSync> &_frameSyncs);
+
+LatencyStats getLatencyStats(const LatencyTracker &_tracker);
+// Samples in the order they were taken, for plotting.
+void getLatencyHistory(const LatencyTracker &_tracker,
+                       std::vector<float> &_samplesMs);
+
+void beginLatencyMeasurement(LatencyTracker &_tracker);
+
+} // namespace bb
@@ -0,0 +1,21 @@
+#pragma once
+#include "vector_math.h"
+
+namespace bb {
+
+// Lights as the shaders read them, free of Vulkan so that the lightmap baker
+// can run without a renderer.
+
+enum class LightType : int { Point = 0, Spot, Directional };
+
+struct alignas(16) Light {
+  Float3 Pos;
+  LightType Type;
+  Float3 Dir;
+  float Intensity;
+  Float3 Color;
+  float InnerCutOff;
+  float OuterCutOff;
+};
+
+} // namespace bb
@@ -0,0 +1,1142 @@
+#include "lightmap.h"
+#include <algorithm>
+#include <atomic>
+#include <emmintrin.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace bb {
+
+// Triangles whose normals are within about 25 degrees of a chart's first
+// triangle may join it, which keeps the projection from folding over.
+constexpr float chartNormalThreshold = 0.9f;
+constexpr int maxChartPackingAttempts = 64;
+constexpr int numProgressSteps = 100;
+constexpr const char *lightmapChartTag = "#BB_LIGHTMAP_CHART";
+
+static Float3 multiply(const Float3 &_a, const Float3 &_b) {
+  return {_a.X * _b.X, _a.Y * _b.Y, _a.Z * _b.Z};
+}
+
+static Float3 lerp(const Float3 &_a, const Float3 &_b, float _t) {
+  return _a + (_b - _a) * _t;
+}
+
+// These four mirror brdf.glsl.
+
+static float distributionGGX(const Float3 &_N, const Float3 &_H,
+                             float _roughness) {
+  float a = _roughness * _roughness;
+  float a2 = a * a;
+  float NdotH = std::max(dot(_N, _H), 0.f);
+  float NdotH2 = NdotH * NdotH;
+
+  float denom = NdotH2 * (a2 - 1.f) + 1.f;
+  denom = pi32 * denom * denom;
+  return a2 / denom;
+}
+
+static float geometrySchlickGGX(float _NdotV, float _roughness) {
+  float r = _roughness + 1.f;
+  float k = (r * r) / 8.f;
+  return _NdotV / (_NdotV * (1.f - k) + k);
+}
+
+static float geometrySmith(const Float3 &_N, const Float3 &_V,
+                           const Float3 &_L, float _roughness) {
+  float NdotV = std::max(dot(_N, _V), 0.f);
+  float NdotL = std::max(dot(_N, _L), 0.f);
+  return geometrySchlickGGX(NdotV, _roughness) *
+         geometrySchlickGGX(NdotL, _roughness);
+}
+
+static Float3 fresnelSchlick(const Float3 &_H, const Float3 &_V,
+                             const Float3 &_F0) {
+  float f = powf(1.f - std::max(dot(_H, _V), 0.f), 5.f);
+  return _F0 + (Float3{1, 1, 1} - _F0) * f;
+}
+
+static Float3 getF0(const LightmapMaterial &_material) {
+  return lerp({0.04f, 0.04f, 0.04f}, _material.Albedo, _material.Metallic);
+}
+
+// kD of evaluateLight().
+static Float3 getDiffuseWeight(const Float3 &_F, float _metallic) {
+  return (Float3{1, 1, 1} - _F) * (1.f - _metallic);
+}
+
+// Direction towards _light and its radiance at _pos before shadowing, as in
+// evaluateLight(). _distance is FLT_MAX for directional lights.
+static Float3 sampleLight(const Light &_light, const Float3 &_pos, Float3 &_L,
+                          float &_distance) {
+  float att = 1.f;
+  if (_light.Type == LightType::Directional) {
+    _L = (_light.Dir * -1.f).normalize();
+    _distance = FLT_MAX;
+  } else {
+    _L = _light.Pos - _pos;
+    _distance = _L.length();
+    if (_distance < epsilon32) {
+      return {};
+    }
+    _L = _L / _distance;
+    att = 1.f / (_distance * _distance);
+    if (_light.Type == LightType::Spot) {
+      float theta = dot(_L, (_light.Dir * -1.f).normalize());
+      float epsilon = _light.InnerCutOff - _light.OuterCutOff;
+      att *= std::clamp((theta - _light.OuterCutOff) / epsilon, 0.f, 1.f);
+    }
+  }
+  return _light.Color * (att * _light.Intensity);
+}
+
+// Diffuse part of evaluateLight() looking straight at the surface.
+static Float3 shadeReceiver(const Float3 &_N, const Float3 &_L,
+                            const Float3 &_radiance,
+                            const LightmapMaterial &_material) {
+  Float3 H = (_L + _N).normalize();
+  Float3 F = fresnelSchlick(H, _N, getF0(_material));
+  Float3 kD = getDiffuseWeight(F, _material.Metallic);
+  return multiply(kD, _radiance) * (std::max(dot(_N, _L), 0.f) / pi32);
+}
+
+// Radiance leaving towards _V, combined as brdf.frag does.
+static Float3 shadeSurface(const Float3 &_N, const Float3 &_V, const Float3 &_L,
+                           const Float3 &_radiance,
+                           const LightmapMaterial &_material) {
+  Float3 H = (_L + _V).normalize();
+  float D = distributionGGX(_N, H, _material.Roughness);
+  Float3 F = fresnelSchlick(H, _V, getF0(_material));
+  float G = geometrySmith(_N, _V, _L, _material.Roughness);
+  float NdotL = std::max(dot(_N, _L), 0.f);
+
+  Float3 diffuse = multiply(getDiffuseWeight(F, _material.Metallic),
+                            _material.Albedo) /
+                   pi32;
+  Float3 specular =
+      F * (D * G /
+           std::max(4.f * std::max(dot(_V, _N), 0.f) * NdotL, 0.001f));
+  return multiply(diffuse + specular, _radiance) * NdotL;
+}
+
+// Tangents of a unit vector without branching on its direction, from "Building
+// an Orthonormal Basis, Revisited" (Duff et al. 2017).
+static void buildBasis(const Float3 &_N, Float3 &_T, Float3 &_B) {
+  float sign = copysignf(1.f, _N.Z);
+  float a = -1.f / (sign + _N.Z);
+  float b = _N.X * _N.Y * a;
+  _T = {1.f + sign * _N.X * _N.X * a, sign * b, -sign * _N.X};
+  _B = {b, sign + _N.Y * _N.Y * a, -_N.Y};
+}
+
+static Float3 sampleCosineHemisphere(const Float3 &_N, float _u1, float _u2) {
+  Float3 T, B;
+  buildBasis(_N, T, B);
+  float r = sqrtf(_u1);
+  float phi = twoPi32 * _u2;
+  return T * (r * cosf(phi)) + B * (r * sinf(phi)) +
+         _N * sqrtf(std::max(1.f - _u1, 0.f));
+}
+
+static uint32_t hashUint(uint32_t _x) {
+  uint32_t state = _x * 747796405u + 2891336453u;
+  uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+  return (word >> 22u) ^ word;
+}
+
+static float toUnitFloat(uint32_t _bits) {
+  return (float)(_bits >> 8) * (1.f / 16777216.f);
+}
+
+static float radicalInverse(uint32_t _bits) {
+  _bits = (_bits << 16u) | (_bits >> 16u);
+  _bits = ((_bits & 0x55555555u) << 1u) | ((_bits & 0xAAAAAAAAu) >> 1u);
+  _bits = ((_bits & 0x33333333u) << 2u) | ((_bits & 0xCCCCCCCCu) >> 2u);
+  _bits = ((_bits & 0x0F0F0F0Fu) << 4u) | ((_bits & 0xF0F0F0F0u) >> 4u);
+  _bits = ((_bits & 0x00FF00FFu) << 8u) | ((_bits & 0xFF00FF00u) >> 8u);
+  return toUnitFloat(_bits);
+}
+
+static float wrapUnit(float _value) { return _value - floorf(_value); }
+
+static int countLanes(int _mask) {
+  int count = 0;
+  for (; _mask != 0; _mask &= _mask - 1) {
+    ++count;
+  }
+  return count;
+}
+
+// Every triangle of every mesh in world space.
+struct BakeScene {
+  BVH Tree;
+  // Three corners per triangle in leaf order, as in MeshBVH.
+  std::vector<Float3> Corners;
+  // Mesh of each triangle in leaf order.
+  std::vector<uint32_t> TriangleMeshes;
+  // Rays start this far off surfaces so that they don't hit them.
+  float RayBias;
+};
+
+static BakeScene buildBakeScene(JobSystem &_jobSystem,
+                                const std::vector<LightmapMesh> &_meshes) {
+  std::vector<Float3> corners;
+  std::vector<uint32_t> triangleMeshes;
+  for (uint32_t m = 0; m < (uint32_t)_meshes.size(); ++m) {
+    const LightmapMesh &mesh = _meshes[m];
+    BB_ASSERT(mesh.Indices.size() % 3 == 0);
+    for (uint32_t index : mesh.Indices) {
+      corners.push_back(transformPoint(mesh.Transform, mesh.Positions[index]));
+    }
+    triangleMeshes.insert(triangleMeshes.end(), mesh.Indices.size() / 3, m);
+  }
+
+  uint32_t numTriangles = (uint32_t)triangleMeshes.size();
+  std::vector<AABB> triangleBounds(numTriangles);
+  AABB sceneBounds;
+  for (uint32_t t = 0; t < numTriangles; ++t) {
+    for (int k = 0; k < 3; ++k) {
+      triangleBounds[t].extend(corners[t * 3 + k]);
+    }
+    sceneBounds.extend(triangleBounds[t]);
+  }
+
+  BakeScene scene = {};
+  scene.Tree = buildBVH(_jobSystem, triangleBounds);
+  scene.Corners.resize(corners.size());
+  scene.TriangleMeshes.resize(numTriangles);
+  for (uint32_t i = 0; i < numTriangles; ++i) {
+    uint32_t t = scene.Tree.Items[i];
+    for (int k = 0; k < 3; ++k) {
+      scene.Corners[i * 3 + k] = corners[t * 3 + k];
+    }
+    scene.TriangleMeshes[i] = triangleMeshes[t];
+  }
+  scene.RayBias = sceneBounds.isValid()
+                      ? (sceneBounds.Max - sceneBounds.Min).length() * 5e-5f
+                      : 0.f;
+  return scene;
+}
+
+// Four rays traced together. Lanes with a negative MaxT are inactive.
+struct RayPacket {
+  __m128 Origin[3];
+  __m128 Dir[3];
+  __m128 InvDir[3];
+  __m128 MaxT;
+};
+
+static RayPacket loadRayPacket(const Float3 (&_origins)[4],
+                               const Float3 (&_dirs)[4],
+                               const float (&_maxT)[4]) {
+  RayPacket packet;
+  packet.Origin[0] = _mm_setr_ps(_origins[0].X, _origins[1].X, _origins[2].X,
+                                 _origins[3].X);
+  packet.Origin[1] = _mm_setr_ps(_origins[0].Y, _origins[1].Y, _origins[2].Y,
+                                 _origins[3].Y);
+  packet.Origin[2] = _mm_setr_ps(_origins[0].Z, _origins[1].Z, _origins[2].Z,
+                                 _origins[3].Z);
+  packet.Dir[0] =
+      _mm_setr_ps(_dirs[0].X, _dirs[1].X, _dirs[2].X, _dirs[3].X);
+  packet.Dir[1] =
+      _mm_setr_ps(_dirs[0].Y, _dirs[1].Y, _dirs[2].Y, _dirs[3].Y);
+  packet.Dir[2] =
+      _mm_setr_ps(_dirs[0].Z, _dirs[1].Z, _dirs[2].Z, _dirs[3].Z);
+  for (int a = 0; a < 3; ++a) {
+    packet.InvDir[a] = _mm_div_ps(_mm_set1_ps(1.f), packet.Dir[a]);
+  }
+  packet.MaxT = _mm_loadu_ps(_maxT);
+  return packet;
+}
+
+// Mask of the lanes that enter _bounds before their MaxT, and where they do.
+static __m128 intersectPacketAABB(const RayPacket &_packet,
+                                  const AABB &_bounds, __m128 &_tEnter) {
+  const float mins[3] = {_bounds.Min.X, _bounds.Min.Y, _bounds.Min.Z};
+  const float maxs[3] = {_bounds.Max.X, _bounds.Max.Y, _bounds.Max.Z};
+  __m128 tMin = _mm_setzero_ps();
+  __m128 tMax = _packet.MaxT;
+  for (int a = 0; a < 3; ++a) {
+    __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(mins[a]), _packet.Origin[a]),
+                           _packet.InvDir[a]);
+    __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(maxs[a]), _packet.Origin[a]),
+                           _packet.InvDir[a]);
+    tMin = _mm_max_ps(tMin, _mm_min_ps(t0, t1));
+    tMax = _mm_min_ps(tMax, _mm_max_ps(t0, t1));
+  }
+  _tEnter = tMin;
+  return _mm_cmple_ps(tMin, tMax);
+}
+
+// Hit distance of each lane, FLT_MAX where it misses or hits beyond MaxT.
+// Both sides are hit, as in intersectRayTriangle().
+static __m128 intersectPacketTriangle(const RayPacket &_packet,
+                                      const Float3 *_corners) {
+  Float3 edge1 = _corners[1] - _corners[0];
+  Float3 edge2 = _corners[2] - _corners[0];
+  __m128 e1x = _mm_set1_ps(edge1.X);
+  __m128 e1y = _mm_set1_ps(edge1.Y);
+  __m128 e1z = _mm_set1_ps(edge1.Z);
+  __m128 e2x = _mm_set1_ps(edge2.X);
+  __m128 e2y = _mm_set1_ps(edge2.Y);
+  __m128 e2z = _mm_set1_ps(edge2.Z);
+  const __m128 &dx = _packet.Dir[0];
+  const __m128 &dy = _packet.Dir[1];
+  const __m128 &dz = _packet.Dir[2];
+
+  __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+  __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+  __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+  __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)),
+                          _mm_mul_ps(e1z, pz));
+  __m128 invDet = _mm_div_ps(_mm_set1_ps(1.f), det);
+
+  __m128 sx = _mm_sub_ps(_packet.Origin[0], _mm_set1_ps(_corners[0].X));
+  __m128 sy = _mm_sub_ps(_packet.Origin[1], _mm_set1_ps(_corners[0].Y));
+  __m128 sz = _mm_sub_ps(_packet.Origin[2], _mm_set1_ps(_corners[0].Z));
+  __m128 u = _mm_mul_ps(
+      _mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)),
+                 _mm_mul_ps(sz, pz)),
+      invDet);
+
+  __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+  __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+  __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+  __m128 v = _mm_mul_ps(
+      _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)),
+                 _mm_mul_ps(dz, qz)),
+      invDet);
+  __m128 t = _mm_mul_ps(
+      _mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)),
+                 _mm_mul_ps(e2z, qz)),
+      invDet);
+
+  const __m128 zero = _mm_setzero_ps();
+  __m128 absDet = _mm_andnot_ps(_mm_set1_ps(-0.f), det);
+  __m128 hit = _mm_cmpgt_ps(absDet, _mm_set1_ps(1e-12f));
+  hit = _mm_and_ps(hit, _mm_cmpge_ps(u, zero));
+  hit = _mm_and_ps(hit, _mm_cmpge_ps(v, zero));
+  hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.f)));
+  hit = _mm_and_ps(hit, _mm_cmpge_ps(t, zero));
+  hit = _mm_and_ps(hit, _mm_cmplt_ps(t, _packet.MaxT));
+  return _mm_or_ps(_mm_and_ps(hit, t),
+                   _mm_andnot_ps(hit, _mm_set1_ps(FLT_MAX)));
+}
+
+// Closest entry distance among the lanes in _mask.
+static float getNearestEntry(__m128 _tEnter, __m128 _mask) {
+  float t[4];
+  _mm_storeu_ps(t, _mm_or_ps(_mm_and_ps(_mask, _tEnter),
+                             _mm_andnot_ps(_mask, _mm_set1_ps(FLT_MAX))));
+  return std::min(std::min(t[0], t[1]), std::min(t[2], t[3]));
+}
+
+// Visits the nodes any lane hits, closest first, calling _visitLeaf(node) on
+// leaves. Traversal stops once _visitLeaf returns false.
+template <typename Fn>
+static void traversePacket(const BVH &_bvh, const RayPacket &_packet,
+                           const Fn &_visitLeaf) {
+  if (_bvh.Nodes.empty()) {
+    return;
+  }
+  __m128 tEnter;
+  if (_mm_movemask_ps(intersectPacketAABB(_packet, _bvh.Nodes[0].Bounds,
+                                          tEnter)) == 0) {
+    return;
+  }
+
+  uint32_t stack[bvhStackSize];
+  int stackSize = 0;
+  stack[stackSize++] = 0;
+  while (stackSize > 0) {
+    const BVHNode &node = _bvh.Nodes[stack[--stackSize]];
+    if (node.NumItems > 0) {
+      if (!_visitLeaf(node)) {
+        return;
+      }
+      continue;
+    }
+
+    uint32_t near = node.First;
+    uint32_t far = node.First + 1;
+    __m128 nearEnter, farEnter;
+    __m128 nearMask =
+        intersectPacketAABB(_packet, _bvh.Nodes[near].Bounds, nearEnter);
+    __m128 farMask =
+        intersectPacketAABB(_packet, _bvh.Nodes[far].Bounds, farEnter);
+    float nearT = _mm_movemask_ps(nearMask) != 0
+                      ? getNearestEntry(nearEnter, nearMask)
+                      : FLT_MAX;
+    float farT = _mm_movemask_ps(farMask) != 0
+                     ? getNearestEntry(farEnter, farMask)
+                     : FLT_MAX;
+    if (farT < nearT) {
+      std::swap(near, far);
+      std::swap(nearT, farT);
+    }
+    BB_ASSERT(stackSize + 2 <= (int)std::size(stack));
+    if (farT != FLT_MAX) {
+      stack[stackSize++] = far;
+    }
+    if (nearT != FLT_MAX) {
+      stack[stackSize++] = near;
+    }
+  }
+}
+
+// Shortens each lane's MaxT to its closest hit and returns the triangles hit,
+// in leaf order, or UINT32_MAX.
+static void tracePacketClosest(const BakeScene &_scene, RayPacket &_packet,
+                               uint32_t (&_triangles)[4]) {
+  std::fill(std::begin(_triangles), std::end(_triangles), UINT32_MAX);
+  traversePacket(_scene.Tree, _packet, [&](const BVHNode &_node) {
+    for (uint32_t i = _node.First; i < _node.First + _node.NumItems; ++i) {
+      __m128 t = intersectPacketTriangle(_packet, &_scene.Corners[i * 3]);
+      int closerMask = _mm_movemask_ps(_mm_cmplt_ps(t, _packet.MaxT));
+      if (closerMask == 0) {
+        continue;
+      }
+      _packet.MaxT = _mm_min_ps(t, _packet.MaxT);
+      for (int k = 0; k < 4; ++k) {
+        if (closerMask & (1 << k)) {
+          _triangles[k] = i;
+        }
+      }
+    }
+    return true;
+  });
+}
+
+// Mask of the lanes that hit anything before their MaxT.
+static int tracePacketOcclusion(const BakeScene &_scene, RayPacket _packet) {
+  int activeMask =
+      _mm_movemask_ps(_mm_cmpge_ps(_packet.MaxT, _mm_setzero_ps()));
+  int occludedMask = 0;
+  if (activeMask == 0) {
+    return occludedMask;
+  }
+  traversePacket(_scene.Tree, _packet, [&](const BVHNode &_node) {
+    for (uint32_t i = _node.First; i < _node.First + _node.NumItems; ++i) {
+      __m128 t = intersectPacketTriangle(_packet, &_scene.Corners[i * 3]);
+      __m128 hit = _mm_cmplt_ps(t, _mm_set1_ps(FLT_MAX));
+      if (_mm_movemask_ps(hit) == 0) {
+        continue;
+      }
+      // Occluded lanes are done.
+      occludedMask |= _mm_movemask_ps(hit);
+      _packet.MaxT = _mm_or_ps(_mm_and_ps(hit, _mm_set1_ps(-1.f)),
+                               _mm_andnot_ps(hit, _packet.MaxT));
+      if (occludedMask == activeMask) {
+        return false;
+      }
+    }
+    return true;
+  });
+  return occludedMask;
+}
+
+// Where a texel's center lies on a receiver.
+struct BakeTexel {
+  Float3 Pos;
+  Float3 Normal;
+  uint32_t Mesh = UINT32_MAX;
+};
+
+struct BakeContext {
+  const std::vector<LightmapMesh> *Meshes;
+  const Light *Lights;
+  uint32_t NumLights;
+  const LightmapBakeParams *Params;
+  BakeScene Scene;
+  uint32_t Width;
+  uint32_t Height;
+  std::vector<BakeTexel> Texels;
+};
+
+// Calls _shade(lane, L, radiance) for every light that reaches the lanes in
+// _activeMask unoccluded. Shadow rays of one light go out as a packet.
+template <typename Fn>
+static void gatherDirectLight(const BakeContext &_ctx,
+                              const Float3 (&_positions)[4],
+                              const Float3 (&_normals)[4], int _activeMask,
+                              uint64_t &_numRays, const Fn &_shade) {
+  float bias = _ctx.Scene.RayBias;
+  for (uint32_t l = 0; l < _ctx.NumLights; ++l) {
+    Float3 origins[4];
+    Float3 dirs[4];
+    Float3 radiance[4];
+    float maxT[4];
+    int lightMask = 0;
+    for (int k = 0; k < 4; ++k) {
+      dirs[k] = {0, 0, 1};
+      maxT[k] = -1.f;
+      if ((_activeMask & (1 << k)) == 0) {
+        continue;
+      }
+      float distance;
+      radiance[k] = sampleLight(_ctx.Lights[l], _positions[k], dirs[k],
+                                distance);
+      if (dot(_normals[k], dirs[k]) <= 0.f ||
+          std::max(std::max(radiance[k].X, radiance[k].Y), radiance[k].Z) <=
+              0.f) {
+        continue;
+      }
+      origins[k] = _positions[k] + _normals[k] * bias;
+      maxT[k] = distance == FLT_MAX ? FLT_MAX : std::max(distance - bias, 0.f);
+      lightMask |= 1 << k;
+    }
+    if (lightMask == 0) {
+      continue;
+    }
+
+    _numRays += countLanes(lightMask);
+    int litMask = lightMask & ~tracePacketOcclusion(
+                                  _ctx.Scene,
+                                  loadRayPacket(origins, dirs, maxT));
+    for (int k = 0; k < 4; ++k) {
+      if (litMask & (1 << k)) {
+        _shade(k, dirs[k], radiance[k]);
+      }
+    }
+  }
+}
+
+// Bakes the 2x2 texels at _blockX, _blockY as one packet. Every lane takes
+// the same random numbers, so that the rays of a packet stay together.
+static void bakeTexelBlock(const BakeContext &_ctx, uint32_t _blockX,
+                           uint32_t _blockY, std::vector<Float3> &_texels,
+                           uint64_t &_numRays) {
+  const std::vector<LightmapMesh> &meshes = *_ctx.Meshes;
+  const LightmapBakeParams &params = *_ctx.Params;
+  float bias = _ctx.Scene.RayBias;
+
+  Float3 positions[4];
+  Float3 normals[4];
+  uint32_t texelIndices[4] = {};
+  const LightmapMaterial *materials[4] = {};
+  int activeMask = 0;
+  for (int k = 0; k < 4; ++k) {
+    uint32_t x = _blockX * 2 + (k & 1);
+    uint32_t y = _blockY * 2 + (k >> 1);
+    if (x >= _ctx.Width || y >= _ctx.Height) {
+      continue;
+    }
+    texelIndices[k] = y * _ctx.Width + x;
+    const BakeTexel &texel = _ctx.Texels[texelIndices[k]];
+    if (texel.Mesh == UINT32_MAX) {
+      continue;
+    }
+    positions[k] = texel.Pos;
+    normals[k] = texel.Normal;
+    materials[k] = &meshes[texel.Mesh].Material;
+    activeMask |= 1 << k;
+  }
+  if (activeMask == 0) {
+    return;
+  }
+
+  Float3 direct[4] = {};
+  gatherDirectLight(_ctx, positions, normals, activeMask, _numRays,
+                    [&](int _k, const Float3 &_L, const Float3 &_radiance) {
+                      direct[_k] += shadeReceiver(normals[_k], _L, _radiance,
+                                                  *materials[_k]);
+                    });
+
+  // First bounces are stratified, with a random shift per block.
+  uint32_t seed = hashUint(_blockY * ((_ctx.Width + 1) / 2) + _blockX);
+  float shift1 = toUnitFloat(hashUint(seed));
+  float shift2 = toUnitFloat(hashUint(seed ^ 0x9e3779b9u));
+  uint32_t rng = seed;
+
+  Float3 indirect[4] = {};
+  for (uint32_t s = 0; s < params.NumSamples; ++s) {
+    float u1 = wrapUnit((s + 0.5f) / params.NumSamples + shift1);
+    float u2 = wrapUnit(radicalInverse(s) + shift2);
+
+    Float3 origins[4];
+    Float3 dirs[4];
+    Float3 throughput[4];
+    float maxT[4];
+    for (int k = 0; k < 4; ++k) {
+      dirs[k] = {0, 0, 1};
+      throughput[k] = {1, 1, 1};
+      if (activeMask & (1 << k)) {
+        origins[k] = positions[k] + normals[k] * bias;
+        dirs[k] = sampleCosineHemisphere(normals[k], u1, u2);
+      }
+    }
+
+    int pathMask = activeMask;
+    for (uint32_t bounce = 0; bounce < params.MaxBounces && pathMask != 0;
+         ++bounce) {
+      for (int k = 0; k < 4; ++k) {
+        maxT[k] = (pathMask & (1 << k)) ? FLT_MAX : -1.f;
+      }
+      RayPacket packet = loadRayPacket(origins, dirs, maxT);
+      _numRays += countLanes(pathMask);
+      uint32_t triangles[4];
+      tracePacketClosest(_ctx.Scene, packet, triangles);
+      float hitT[4];
+      _mm_storeu_ps(hitT, packet.MaxT);
+
+      Float3 hitPositions[4];
+      Float3 hitNormals[4];
+      const LightmapMaterial *hitMaterials[4] = {};
+      int hitMask = 0;
+      for (int k = 0; k < 4; ++k) {
+        if ((pathMask & (1 << k)) == 0 || triangles[k] == UINT32_MAX) {
+          continue;
+        }
+        const Float3 *corners = &_ctx.Scene.Corners[triangles[k] * 3];
+        Float3 N =
+            cross(corners[1] - corners[0], corners[2] - corners[0]).normalize();
+        if (dot(N, dirs[k]) > 0.f) {
+          N = N * -1.f;
+        }
+        hitNormals[k] = N;
+        hitPositions[k] = origins[k] + dirs[k] * hitT[k];
+        hitMaterials[k] =
+            &meshes[_ctx.Scene.TriangleMeshes[triangles[k]]].Material;
+        hitMask |= 1 << k;
+      }
+      pathMask = hitMask;
+
+      gatherDirectLight(
+          _ctx, hitPositions, hitNormals, hitMask, _numRays,
+          [&](int _k, const Float3 &_L, const Float3 &_radiance) {
+            Float3 V = dirs[_k] * -1.f;
+            indirect[_k] += multiply(
+                throughput[_k], shadeSurface(hitNormals[_k], V, _L, _radiance,
+                                             *hitMaterials[_k]));
+          });
+
+      // Paths go on diffusely, weighted by what the surface reflects that
+      // way.
+      rng = hashUint(rng);
+      float v1 = toUnitFloat(rng);
+      rng = hashUint(rng);
+      float v2 = toUnitFloat(rng);
+      for (int k = 0; k < 4; ++k) {
+        if ((hitMask & (1 << k)) == 0) {
+          continue;
+        }
+        const LightmapMaterial &material = *hitMaterials[k];
+        Float3 kD = getDiffuseWeight(getF0(material), material.Metallic);
+        throughput[k] = multiply(throughput[k], multiply(kD, material.Albedo));
+        origins[k] = hitPositions[k] + hitNormals[k] * bias;
+        dirs[k] = sampleCosineHemisphere(hitNormals[k], v1, v2);
+      }
+    }
+  }
+
+  // Cosine weighted samples leave kD / PI * irradiance as the mean radiance
+  // times kD.
+  for (int k = 0; k < 4; ++k) {
+    if ((activeMask & (1 << k)) == 0) {
+      continue;
+    }
+    const LightmapMaterial &material = *materials[k];
+    Float3 kD = getDiffuseWeight(getF0(material), material.Metallic);
+    Float3 indirectDiffuse = multiply(kD, indirect[k]);
+    if (params.NumSamples > 0) {
+      indirectDiffuse = indirectDiffuse / (float)params.NumSamples;
+    }
+    _texels[texelIndices[k]] = direct[k] + indirectDiffuse;
+  }
+}
+
+struct ChartBuild {
+  LightmapChart Chart;
+  std::vector<uint32_t> Triangles;
+  Float3 Tangent;
+  Float3 Bitangent;
+  // Bounds along Tangent and Bitangent, in world units.
+  Float2 Min;
+  Float2 Max;
+};
+
+// Splits _mesh into charts of triangles that share edges and face roughly
+// the same way. Degenerate triangles are left out.
+static void createCharts(const LightmapMesh &_mesh, uint32_t _meshIndex,
+                         std::vector<ChartBuild> &_charts) {
+  uint32_t numVertices = (uint32_t)_mesh.Positions.size();
+  uint32_t numTriangles = (uint32_t)_mesh.Indices.size() / 3;
+
+  std::vector<Float3> positions(numVertices);
+  for (uint32_t v = 0; v < numVertices; ++v) {
+    positions[v] = transformPoint(_mesh.Transform, _mesh.Positions[v]);
+  }
+
+  // Vertices split for other attributes are welded back by position.
+  std::vector<uint32_t> welded(numVertices);
+  {
+    std::vector<uint32_t> order(numVertices);
+    for (uint32_t v = 0; v < numVertices; ++v) {
+      order[v] = v;
+    }
+    auto isLess = [&](uint32_t _a, uint32_t _b) {
+      const Float3 &a = positions[_a];
+      const Float3 &b = positions[_b];
+      if (a.X != b.X) {
+        return a.X < b.X;
+      }
+      if (a.Y != b.Y) {
+        return a.Y < b.Y;
+      }
+      return a.Z < b.Z;
+    };
+    std::sort(order.begin(), order.end(), isLess);
+    for (uint32_t i = 0; i < numVertices; ++i) {
+      bool isSame = i > 0 && !isLess(order[i - 1], order[i]);
+      welded[order[i]] = isSame ? welded[order[i - 1]] : order[i];
+    }
+  }
+
+  std::vector<Float3> faceNormals(numTriangles);
+  for (uint32_t t = 0; t < numTriangles; ++t) {
+    const uint32_t *triangle = &_mesh.Indices[t * 3];
+    faceNormals[t] = cross(positions[triangle[1]] - positions[triangle[0]],
+                           positions[triangle[2]] - positions[triangle[0]]);
+  }
+
+  std::vector<std::vector<uint32_t>> neighbours(numTriangles);
+  {
+    struct Edge {
+      uint64_t Key;
+      uint32_t Triangle;
+    };
+    std::vector<Edge> edges;
+    edges.reserve(numTriangles * 3);
+    for (uint32_t t = 0; t < numTriangles; ++t) {
+      for (int k = 0; k < 3; ++k) {
+        uint32_t a = welded[_mesh.Indices[t * 3 + k]];
+        uint32_t b = welded[_mesh.Indices[t * 3 + (k + 1) % 3]];
+        if (a == b) {
+          continue;
+        }
+        uint64_t key = ((uint64_t)std::min(a, b) << 32) | std::max(a, b);
+        edges.push_back({key, t});
+      }
+    }
+    std::sort(edges.begin(), edges.end(),
+              [](const Edge &_a, const Edge &_b) { return _a.Key < _b.Key; });
+    for (size_t begin = 0; begin < edges.size();) {
+      size_t end = begin + 1;
+      while (end < edges.size() && edges[end].Key == edges[begin].Key) {
+        ++end;
+      }
+      for (size_t i = begin; i < end; ++i) {
+        for (size_t j = begin; j < end; ++j) {
+          if (i != j) {
+            neighbours[edges[i].Triangle].push_back(edges[j].Triangle);
+          }
+        }
+      }
+      begin = end;
+    }
+  }
+
+  std::vector<bool> isAssigned(numTriangles, false);
+  std::vector<uint32_t> queue;
+  for (uint32_t seed = 0; seed < numTriangles; ++seed) {
+    if (isAssigned[seed] || faceNormals[seed].lengthSq() <= 0.f) {
+      continue;
+    }
+    Float3 seedNormal = faceNormals[seed].normalize();
+
+    ChartBuild chart = {};
+    chart.Chart.MeshIndex = _meshIndex;
+    isAssigned[seed] = true;
+    queue.assign(1, seed);
+    Float3 normalSum = {};
+    while (!queue.empty()) {
+      uint32_t t = queue.back();
+      queue.pop_back();
+      chart.Triangles.push_back(t);
+      // Weighted by area.
+      normalSum += faceNormals[t];
+      for (uint32_t n : neighbours[t]) {
+        if (isAssigned[n] || faceNormals[n].lengthSq() <= 0.f ||
+            dot(faceNormals[n].normalize(), seedNormal) <
+                chartNormalThreshold) {
+          continue;
+        }
+        isAssigned[n] = true;
+        queue.push_back(n);
+      }
+    }
+
+    buildBasis(normalSum.normalize(), chart.Tangent, chart.Bitangent);
+    chart.Min = {FLT_MAX, FLT_MAX};
+    chart.Max = {-FLT_MAX, -FLT_MAX};
+    for (uint32_t t : chart.Triangles) {
+      for (int k = 0; k < 3; ++k) {
+        const Float3 &p = positions[_mesh.Indices[t * 3 + k]];
+        float u = dot(chart.Tangent, p);
+        float v = dot(chart.Bitangent, p);
+        chart.Min = {std::min(chart.Min.X, u), std::min(chart.Min.Y, v)};
+        chart.Max = {std::max(chart.Max.X, u), std::max(chart.Max.Y, v)};
+      }
+    }
+    _charts.push_back(std::move(chart));
+  }
+}
+
+// Shelf packing, tallest charts first. Returns false if they don't fit.
+static bool packCharts(std::vector<ChartBuild> &_charts, float _texelsPerUnit,
+                       uint32_t _padding, uint32_t _size) {
+  for (ChartBuild &chart : _charts) {
+    int width = (int)ceilf((chart.Max.X - chart.Min.X) * _texelsPerUnit);
+    int height = (int)ceilf((chart.Max.Y - chart.Min.Y) * _texelsPerUnit);
+    chart.Chart.Size = {std::max(width, 1) + (int)_padding * 2,
+                        std::max(height, 1) + (int)_padding * 2};
+  }
+
+  std::vector<uint32_t> order(_charts.size());
+  for (uint32_t i = 0; i < (uint32_t)order.size(); ++i) {
+    order[i] = i;
+  }
+  std::sort(order.begin(), order.end(), [&](uint32_t _a, uint32_t _b) {
+    return _charts[_a].Chart.Size.Y > _charts[_b].Chart.Size.Y;
+  });
+
+  int x = 0;
+  int y = 0;
+  int shelfHeight = 0;
+  for (uint32_t i : order) {
+    LightmapChart &chart = _charts[i].Chart;
+    if (x + chart.Size.X > (int)_size) {
+      x = 0;
+      y += shelfHeight;
+      shelfHeight = 0;
+    }
+    if (x + chart.Size.X > (int)_size || y + chart.Size.Y > (int)_size) {
+      return false;
+    }
+    chart.Offset = {x, y};
+    x += chart.Size.X;
+    shelfHeight = std::max(shelfHeight, chart.Size.Y);
+  }
+  return true;
+}
+
+// _axis dotted with world positions, offset, then scaled, as a function of
+// object space positions.
+static Float4 getObjectSpaceAxis(const Mat4 &_transform, const Float3 &_axis,
+                                 float _offset, float _scale) {
+  Float4 row;
+  row.X = dot(_axis, {_transform.M[0][0], _transform.M[0][1],
+                      _transform.M[0][2]}) *
+          _scale;
+  row.Y = dot(_axis, {_transform.M[1][0], _transform.M[1][1],
+                      _transform.M[1][2]}) *
+          _scale;
+  row.Z = dot(_axis, {_transform.M[2][0], _transform.M[2][1],
+                      _transform.M[2][2]}) *
+          _scale;
+  row.W = (dot(_axis, {_transform.M[3][0], _transform.M[3][1],
+                       _transform.M[3][2]}) +
+           _offset) *
+          _scale;
+  return row;
+}
+
+// Fills the texels whose center lies on one of the chart's triangles.
+static void rasterizeChart(const ChartBuild &_chart, const LightmapMesh &_mesh,
+                           float _texelsPerUnit, uint32_t _padding,
+                           BakeContext &_ctx) {
+  Mat4 normalMat = _mesh.Transform.inverse().transpose();
+  const LightmapChart &chart = _chart.Chart;
+  Int2 contentMin = {chart.Offset.X + (int)_padding,
+                     chart.Offset.Y + (int)_padding};
+  Int2 contentMax = {chart.Offset.X + chart.Size.X - (int)_padding,
+                     chart.Offset.Y + chart.Size.Y - (int)_padding};
+
+  for (uint32_t t : _chart.Triangles) {
+    const uint32_t *triangle = &_mesh.Indices[t * 3];
+    Float3 corners[3];
+    Float3 normals[3];
+    Float2 texelCorners[3];
+    for (int k = 0; k < 3; ++k) {
+      corners[k] = transformPoint(_mesh.Transform, _mesh.Positions[triangle[k]]);
+      texelCorners[k] = {
+          (dot(_chart.Tangent, corners[k]) - _chart.Min.X) * _texelsPerUnit +
+              contentMin.X,
+          (dot(_chart.Bitangent, corners[k]) - _chart.Min.Y) * _texelsPerUnit +
+              contentMin.Y};
+    }
+    Float3 faceNormal =
+        cross(corners[1] - corners[0], corners[2] - corners[0]).normalize();
+    for (int k = 0; k < 3; ++k) {
+      normals[k] =
+          _mesh.Normals.empty()
+              ? faceNormal
+              : transformDirection(normalMat, _mesh.Normals[triangle[k]]);
+    }
+
+    Float2 e1 = texelCorners[1] - texelCorners[0];
+    Float2 e2 = texelCorners[2] - texelCorners[0];
+    float area = e1.X * e2.Y - e1.Y * e2.X;
+    if (fabsf(area) < 1e-12f) {
+      continue;
+    }
+
+    float minX = std::min({texelCorners[0].X, texelCorners[1].X,
+                           texelCorners[2].X});
+    float maxX = std::max({texelCorners[0].X, texelCorners[1].X,
+                           texelCorners[2].X});
+    float minY = std::min({texelCorners[0].Y, texelCorners[1].Y,
+                           texelCorners[2].Y});
+    float maxY = std::max({texelCorners[0].Y, texelCorners[1].Y,
+                           texelCorners[2].Y});
+    int x0 = std::max((int)floorf(minX), contentMin.X);
+    int x1 = std::min((int)ceilf(maxX), contentMax.X - 1);
+    int y0 = std::max((int)floorf(minY), contentMin.Y);
+    int y1 = std::min((int)ceilf(maxY), contentMax.Y - 1);
+
+    for (int y = y0; y <= y1; ++y) {
+      for (int x = x0; x <= x1; ++x) {
+        Float2 p = Float2{x + 0.5f, y + 0.5f} - texelCorners[0];
+        float b1 = (p.X * e2.Y - p.Y * e2.X) / area;
+        float b2 = (e1.X * p.Y - e1.Y * p.X) / area;
+        float b0 = 1.f - b1 - b2;
+        if (b0 < -1e-4f || b1 < -1e-4f || b2 < -1e-4f) {
+          continue;
+        }
+        BakeTexel &texel = _ctx.Texels[y * _ctx.Width + x];
+        texel.Pos = corners[0] * b0 + corners[1] * b1 + corners[2] * b2;
+        Float3 normal = normals[0] * b0 + normals[1] * b1 + normals[2] * b2;
+        texel.Normal =
+            normal.lengthSq() > 0.f ? normal.normalize() : faceNormal;
+        texel.Mesh = chart.MeshIndex;
+      }
+    }
+  }
+}
+
+// Grows every chart into its padding, a texel per pass.
+static void dilateLightmap(std::vector<Float3> &_texels,
+                           std::vector<bool> &_isCovered, uint32_t _width,
+                           uint32_t _height, uint32_t _numPasses) {
+  for (uint32_t pass = 0; pass < _numPasses; ++pass) {
+    std::vector<bool> wasCovered = _isCovered;
+    for (uint32_t y = 0; y < _height; ++y) {
+      for (uint32_t x = 0; x < _width; ++x) {
+        if (wasCovered[y * _width + x]) {
+          continue;
+        }
+        Float3 sum = {};
+        int numNeighbours = 0;
+        for (int dy = -1; dy <= 1; ++dy) {
+          for (int dx = -1; dx <= 1; ++dx) {
+            int nx = (int)x + dx;
+            int ny = (int)y + dy;
+            if (nx < 0 || ny < 0 || nx >= (int)_width || ny >= (int)_height ||
+                !wasCovered[ny * _width + nx]) {
+              continue;
+            }
+            sum += _texels[ny * _width + nx];
+            ++numNeighbours;
+          }
+        }
+        if (numNeighbours > 0) {
+          _texels[y * _width + x] = sum / (float)numNeighbours;
+          _isCovered[y * _width + x] = true;
+        }
+      }
+    }
+  }
+}
+
+Lightmap bakeLightmap(JobSystem &_jobSystem,
+                      const std::vector<LightmapMesh> &_meshes,
+                      const Light *_lights, uint32_t _numLights,
+                      const LightmapBakeParams &_params,
+                      const LightmapProgressFunc &_reportProgress) {
+  Time startTime = getCurrentTime();
+
+  std::vector<ChartBuild> charts;
+  for (uint32_t m = 0; m < (uint32_t)_meshes.size(); ++m) {
+    if (_meshes[m].IsReceiver) {
+      createCharts(_meshes[m], m, charts);
+    }
+  }
+
+  float texelsPerUnit = _params.TexelsPerUnit;
+  for (int attempt = 0;
+       !packCharts(charts, texelsPerUnit, _params.Padding, _params.Size);
+       ++attempt) {
+    if (attempt == maxChartPackingAttempts) {
+      BB_LOG_ERROR("{} lightmap charts don't fit in {}x{} texels",
+                   charts.size(), _params.Size, _params.Size);
+      return {};
+    }
+    texelsPerUnit *= 0.9f;
+  }
+
+  BakeContext ctx = {};
+  ctx.Meshes = &_meshes;
+  ctx.Lights = _lights;
+  ctx.NumLights = _numLights;
+  ctx.Params = &_params;
+  ctx.Width = _params.Size;
+  ctx.Height = _params.Size;
+  ctx.Texels.resize(ctx.Width * ctx.Height);
+
+  Lightmap lightmap = {};
+  lightmap.Width = ctx.Width;
+  lightmap.Height = ctx.Height;
+  for (ChartBuild &chart : charts) {
+    const LightmapMesh &mesh = _meshes[chart.Chart.MeshIndex];
+    float offsetU =
+        (chart.Chart.Offset.X + _params.Padding) / texelsPerUnit - chart.Min.X;
+    float offsetV =
+        (chart.Chart.Offset.Y + _params.Padding) / texelsPerUnit - chart.Min.Y;
+    chart.Chart.UVTransform[0] = getObjectSpaceAxis(
+        mesh.Transform, chart.Tangent, offsetU, texelsPerUnit / ctx.Width);
+    chart.Chart.UVTransform[1] = getObjectSpaceAxis(
+        mesh.Transform, chart.Bitangent, offsetV, texelsPerUnit / ctx.Height);
+    rasterizeChart(chart, mesh, texelsPerUnit, _params.Padding, ctx);
+    lightmap.Charts.push_back(chart.Chart);
+  }
+
+  ctx.Scene = buildBakeScene(_jobSystem, _meshes);
+
+  lightmap.Texels.resize(ctx.Width * ctx.Height);
+  std::atomic<uint64_t> numRays{0};
+  int blocksPerRow = (int)(ctx.Width + 1) / 2;
+  int numBlockRows = (int)(ctx.Height + 1) / 2;
+  int rowsPerStep = std::max(
+      (numBlockRows + numProgressSteps - 1) / numProgressSteps, 1);
+  for (int row = 0; row < numBlockRows; row += rowsPerStep) {
+    int numRows = std::min(rowsPerStep, numBlockRows - row);
+    parallelFor(_jobSystem, numRows * blocksPerRow, 8, [&](int _block) {
+      uint64_t blockRays = 0;
+      bakeTexelBlock(ctx, (uint32_t)(_block % blocksPerRow),
+                     (uint32_t)(row + _block / blocksPerRow), lightmap.Texels,
+                     blockRays);
+      numRays += blockRays;
+    });
+    if (_reportProgress) {
+      _reportProgress((float)(row + numRows) / numBlockRows, numRays.load(),
+                      getElapsedTimeInSeconds(startTime, getCurrentTime()));
+    }
+  }
+
+  std::vector<bool> isCovered(ctx.Texels.size());
+  uint32_t numTexels = 0;
+  for (size_t i = 0; i < ctx.Texels.size(); ++i) {
+    isCovered[i] = ctx.Texels[i].Mesh != UINT32_MAX;
+    numTexels += isCovered[i] ? 1 : 0;
+  }
+  dilateLightmap(lightmap.Texels, isCovered, ctx.Width, ctx.Height,
+                 _params.Padding);
+
+  lightmap.Stats.NumCharts = (uint32_t)lightmap.Charts.size();
+  lightmap.Stats.NumTexels = numTexels;
+  lightmap.Stats.TexelsPerUnit = texelsPerUnit;
+  lightmap.Stats.NumRays = numRays.load();
+  lightmap.Stats.Seconds =
+      getElapsedTimeInSeconds(startTime, getCurrentTime());
+  return lightmap;
+}
+
+static void encodeRGBE(const Float3 &_color, uint8_t (&_rgbe)[4]) {
+  float maxComponent = std::max(std::max(_color.X, _color.Y), _color.Z);
+  if (maxComponent < 1e-32f) {
+    _rgbe[0] = _rgbe[1] = _rgbe[2] = _rgbe[3] = 0;
+    return;
+  }
+  int exponent;
+  float scale = frexpf(maxComponent, &exponent) * 256.f / maxComponent;
+  _rgbe[0] = (uint8_t)(std::max(_color.X, 0.f) * scale);
+  _rgbe[1] = (uint8_t)(std::max(_color.Y, 0.f) * scale);
+  _rgbe[2] = (uint8_t)(std::max(_color.Z, 0.f) * scale);
+  _rgbe[3] = (uint8_t)(exponent + 128);
+}
+
+bool writeLightmap(const Lightmap &_lightmap, const std::string &_filePath) {
+  // Readers only take run-length encoded scanlines at these widths.
+  BB_ASSERT(_lightmap.Width >= 8 && _lightmap.Width < 32768);
+
+  FILE *f = fopen(_filePath.c_str(), "wb");
+  if (!f) {
+    return false;
+  }
+
+  fprintf(f, "#?RADIANCE\n");
+  for (const LightmapChart &chart : _lightmap.Charts) {
+    const Float4 *uv = chart.UVTransform;
+    fprintf(f, "%s %u %.9g %.9g %.9g %.9g %.9g %.9g %.9g %.9g %d %d %d %d\n",
+            lightmapChartTag, chart.MeshIndex, uv[0].X, uv[0].Y, uv[0].Z,
+            uv[0].W, uv[1].X, uv[1].Y, uv[1].Z, uv[1].W, chart.Offset.X,
+            chart.Offset.Y, chart.Size.X, chart.Size.Y);
+  }
+  fprintf(f, "FORMAT=32-bit_rle_rgbe\n\n");
+  fprintf(f, "-Y %u +X %u\n", _lightmap.Height, _lightmap.Width);
+
+  // Each component of a scanline is stored apart, as literal runs of up to
+  // 128 bytes.
+  std::vector<uint8_t> components(_lightmap.Width * 4);
+  std::vector<uint8_t> scanline;
+  for (uint32_t y = 0; y < _lightmap.Height; ++y) {
+    for (uint32_t x = 0; x < _lightmap.Width; ++x) {
+      uint8_t rgbe[4];
+      encodeRGBE(_lightmap.Texels[y * _lightmap.Width + x], rgbe);
+      for (int c = 0; c < 4; ++c) {
+        components[c * _lightmap.Width + x] = rgbe[c];
+      }
+    }
+
+    scanline.assign({2, 2, (uint8_t)(_lightmap.Width >> 8),
+                     (uint8_t)(_lightmap.Width & 0xff)});
+    for (int c = 0; c < 4; ++c) {
+      const uint8_t *component = &components[c * _lightmap.Width];
+      for (uint32_t x = 0; x < _lightmap.Width; x += 128) {
+        uint32_t count = std::min(_lightmap.Width - x, 128u);
+        scanline.push_back((uint8_t)count);
+        scanline.insert(scanline.end(), component + x, component + x + count);
+      }
+    }
+    fwrite(scanline.data(), 1, scanline.size(), f);
+  }
+
+  bool isWritten = ferror(f) == 0;
+  fclose(f);
+  return isWritten;
+}
+
+bool readLightmapCharts(const std::string &_filePath,
+                        std::vector<LightmapChart> &_charts) {
+  FILE *f = fopen(_filePath.c_str(), "rb");
+  if (!f) {
+    return false;
+  }
+
+  _charts.clear();
+  char line[512];
+  size_t tagLength = strlen(lightmapChartTag);
+  // The header ends at the first empty line.
+  while (fgets(line, sizeof(line), f) && line[0] != '\n') {
+    if (strncmp(line, lightmapChartTag, tagLength) != 0) {
+      continue;
+    }
+    LightmapChart chart = {};
+    Float4 *uv = chart.UVTransform;
+    int numRead = sscanf(line + tagLength,
+                         "%u %f %f %f %f %f %f %f %f %d %d %d %d",
+                         &chart.MeshIndex, &uv[0].X, &uv[0].Y, &uv[0].Z,
+                         &uv[0].W, &uv[1].X, &uv[1].Y, &uv[1].Z, &uv[1].W,
+                         &chart.Offset.X, &chart.Offset.Y, &chart.Size.X,
+                         &chart.Size.Y);
+    if (numRead == 13) {
+      _charts.push_back(chart);
+    }
+  }
+
+  fclose(f);
+  return !_charts.empty();
+}
+
+} // namespace bb
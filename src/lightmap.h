@@ -0,0 +1,97 @@
+#pragma once
+#include "bvh.h"
+#include "light.h"
+#include "job.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace bb {
+
+// Offline bake of static lighting into a lightmap. Everything runs on the CPU
+// across the job system, so baking needs neither a window nor a GPU.
+//
+// Receivers are split into charts that get their own texels. Each texel is
+// lit directly by every light and indirectly by paths bouncing off every
+// mesh, using the same BRDF as lighting.glsl.
+
+// Constant surface properties a mesh is baked with, as evaluateLight() takes
+// them.
+struct LightmapMaterial {
+  Float3 Albedo = {0.8f, 0.8f, 0.8f};
+  float Metallic = 0.f;
+  float Roughness = 0.5f;
+};
+
+struct LightmapMesh {
+  // In object space. Normals may be left empty to use face normals.
+  std::vector<Float3> Positions;
+  std::vector<Float3> Normals;
+  std::vector<uint32_t> Indices;
+  Mat4 Transform = Mat4::identity();
+  LightmapMaterial Material;
+  // Other meshes only block and bounce light.
+  bool IsReceiver = false;
+};
+
+// Connected triangles of a receiver that face roughly the same way, projected
+// onto their average plane. A point p in the mesh's object space lands at
+// UV (dot(UVTransform[0], p'), dot(UVTransform[1], p')) with p' = (p, 1).
+struct LightmapChart {
+  uint32_t MeshIndex;
+  Float4 UVTransform[2];
+  // Texel rectangle, padding included.
+  Int2 Offset;
+  Int2 Size;
+};
+
+struct LightmapBakeParams {
+  uint32_t Size = 1024;
+  // Lowered for every chart alike until they fit.
+  float TexelsPerUnit = 8.f;
+  // Paths per texel for indirect lighting.
+  uint32_t NumSamples = 64;
+  uint32_t MaxBounces = 2;
+  // Texels around each chart, filled by dilation so that bilinear filtering
+  // doesn't reach into another chart.
+  uint32_t Padding = 2;
+};
+
+struct LightmapBakeStats {
+  uint32_t NumCharts;
+  // Texels whose center lies on a receiver.
+  uint32_t NumTexels;
+  float TexelsPerUnit;
+  uint64_t NumRays;
+  float Seconds;
+};
+
+struct Lightmap {
+  uint32_t Width;
+  uint32_t Height;
+  // What evaluateLight() returns as diffuse, summed over lights and bounces:
+  // lighting without albedo. kD is taken looking straight at the surface.
+  std::vector<Float3> Texels;
+  std::vector<LightmapChart> Charts;
+  LightmapBakeStats Stats;
+};
+
+// Called on the baking thread between batches of texels.
+using LightmapProgressFunc = std::function<void(
+    float _fractionDone, uint64_t _numRays, float _seconds)>;
+
+// Rays are traced four at a time from neighbouring texels, with SSE.
+Lightmap bakeLightmap(JobSystem &_jobSystem,
+                      const std::vector<LightmapMesh> &_meshes,
+                      const Light *_lights, uint32_t _numLights,
+                      const LightmapBakeParams &_params,
+                      const LightmapProgressFunc &_reportProgress);
+
+// Writes a Radiance .hdr, which createImageFromFile() loads as floats, with
+// the charts in its header.
+bool writeLightmap(const Lightmap &_lightmap, const std::string &_filePath);
+// Returns false if the file can't be read or holds no charts.
+bool readLightmapCharts(const std::string &_filePath,
+                        std::vector<LightmapChart> &_charts);
+
+} // namespace bb
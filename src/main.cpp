@@ -6,8 +6,19 @@
 #include "input.h"
 #include "render.h"
 #include "type_conversion.h"
+#include "model_convert.h"
 #include "resource.h"
 #include "scene.h"
+#include "scene_convert.h"
+#include "job.h"
+#include "geometry_pool.h"
+#include "descriptor_allocator.h"
+#include "multiview.h"
+#include "capture.h"
+#include "readback.h"
+#include "latency.h"
+#include "block_codec.h"
+#include "asset_report.h"
 #include "external/volk.h"
 #include "external/SDL2/SDL.h"
 #include "external/SDL2/SDL_main.h"
@@ -30,6 +41,8 @@
 #include <optional>
 #include <numeric>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <stdint.h>
 #include <assert.h>
 
@@ -41,21 +54,52 @@ static Gizmo gGizmo;
 static GBufferVisualize gBufferVisualize;
 static TBNVisualize gTBN;
 static LightSources gLightSources;
+static DepthPrepass gDepthPrepass;
+static VertexPulling gVertexPulling;
+static VertexPullingBenchmark gVertexPullingBenchmark;
+static ImpostorPass gImpostorPass;
+static VisibilityBuffer gVisibilityBuffer;
+static HalfResLighting gHalfResLighting;
+static LightingBenchmark gLightingBenchmark;
+static ShadowAtlas gShadowAtlas;
+static MultiviewCapture gMultiview;
+static MultiviewBenchmark gMultiviewBenchmark;
+static FrameReadback gFrameReadback;
+static LatencyTracker gLatencyTracker;
+static ImTextureID gMultiviewTextureIds[maxNumMultiviews];
 
 static StandardPipelineLayout gStandardPipelineLayout;
-
-enum class SceneType { Triangle, ShaderBalls, COUNT };
-
-static EnumArray<SceneType, const char *> gSceneLabels = {"Triangle",
-                                                          "Shader Balls"};
+static JobSystem gJobSystem;
+static GeometryPool gGeometryPool;
+static DescriptorAllocator gDescriptorAllocator;
+static DescriptorSetCache gDescriptorSetCache;
+static DescriptorChurnStats gDescriptorChurnStats;
+static DescriptorUpdateStats gDescriptorUpdateStats;
+static AsyncContext gAsync;
+static BlockDecompressor gBlockDecompressor;
+static ImageLoadStats gStartupLoadStats;
+// Indexed by whether the GPU decompressed.
+static ImageLoadStats gMeasuredLoadStats[2];
+// The latest, shown in the overlay.
+static AssetLoadReport gAssetLoadReport;
+static EnumArray<ScenePassStat, uint64_t> gScenePassVertexInvocations;
+static EnumArray<ScenePassTimestamp, uint64_t> gScenePassTimestamps;
+
+enum class SceneType { Triangle, ShaderBalls, File, COUNT };
+
+static EnumArray<SceneType, const char *> gSceneLabels = {
+    "Triangle", "Shader Balls", "Scene File"};
 static EnumArray<SceneType, SceneBase *> gScenes;
 static SceneType gCurrentSceneType = SceneType::ShaderBalls;
+// Given by --scene, or defaultSceneFileName in the common resources.
+static std::string gSceneFilePath;
 
 void recordCommand(VkRenderPass _deferredRenderPass,
                    VkFramebuffer _deferredFramebuffer,
                    VkPipeline _forwardPipeline, VkPipeline _gBufferPipeline,
                    VkPipeline _brdfPipeline, VkPipeline _hdrToneMappingPipeline,
-                   VkExtent2D _swapChainExtent, const Frame &_frame) {
+                   VkExtent2D _swapChainExtent, VkImage _swapChainImage,
+                   VkFormat _swapChainFormat, const Frame &_frame) {
   SceneBase *currentScene = gScenes[gCurrentSceneType];
 
   VkCommandBufferBeginInfo cmdBeginInfo = {};
@@ -75,6 +119,85 @@ void recordCommand(VkRenderPass _deferredRenderPass,
                           gStandardPipelineLayout.Handle, 1, 1,
                           &_frame.ViewDescriptorSet, 0, nullptr);
 
+  // Every scene mesh lives in the pool, so its vertex and index buffers are
+  // bound once here and only overridden by the light sources and the gizmo.
+  bindGeometryPool(cmdBuffer, gGeometryPool);
+
+  // Scenes only push their own base when drawing several instanced draws,
+  // their lightmap charts around lightmapped draws and draw transforms
+  // before single instance draws.
+  StandardPushConstants pushConstants = {};
+  vkCmdPushConstants(cmdBuffer, gStandardPipelineLayout.Handle,
+                     VK_SHADER_STAGE_VERTEX_BIT, 0,
+                     offsetof(StandardPushConstants, ShadowViewProj),
+                     &pushConstants);
+  currentScene->beginSceneCommands(cmdBuffer);
+
+  if (gShadowAtlas.IsEnabled) {
+    recordShadowAtlasUpdate(cmdBuffer, gShadowAtlas,
+                            gStandardPipelineLayout.Handle,
+                            [&](ShadowCasterType _casterType) {
+                              currentScene->drawShadowCasters(cmdBuffer,
+                                                              _casterType);
+                            });
+  }
+
+  if (gMultiview.IsEnabled) {
+    Time recordStartTime = getCurrentTime();
+    recordMultiviewCapture(cmdBuffer, gMultiview,
+                           gStandardPipelineLayout.Handle,
+                           [&] { currentScene->drawScene(_frame); });
+    gMultiview.Stats.RecordMs =
+        getElapsedTimeInSeconds(recordStartTime, getCurrentTime()) * 1000.f;
+  } else {
+    gMultiview.Stats.RecordMs = 0;
+  }
+
+  VkQueryPool statsQueryPool = _frame.ScenePassStatsQueryPool;
+  if (statsQueryPool != VK_NULL_HANDLE) {
+    vkCmdResetQueryPool(cmdBuffer, statsQueryPool, 0,
+                        EnumCount<ScenePassStat>);
+  }
+
+  VkQueryPool timestampQueryPool = _frame.ScenePassTimestampQueryPool;
+  if (timestampQueryPool != VK_NULL_HANDLE) {
+    vkCmdResetQueryPool(cmdBuffer, timestampQueryPool, 0,
+                        EnumCount<ScenePassTimestamp>);
+  }
+  auto writeTimestamp = [&](ScenePassTimestamp _timestamp) {
+    if (timestampQueryPool != VK_NULL_HANDLE) {
+      vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                          timestampQueryPool, (uint32_t)_timestamp);
+    }
+  };
+
+  // Draws the scene with a position-only depth pass in front if enabled,
+  // counting vertex shader invocations of both.
+  auto drawSceneWithPrepass = [&](VkPipeline _scenePipeline) {
+    if (statsQueryPool != VK_NULL_HANDLE) {
+      vkCmdBeginQuery(cmdBuffer, statsQueryPool,
+                      (uint32_t)ScenePassStat::DepthPrepass, 0);
+    }
+    if (gDepthPrepass.IsEnabled) {
+      vkCmdBindPipeline(
+          cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+          gDepthPrepass.Pipelines[currentScene->SceneRenderPassType]);
+      currentScene->drawScene(_frame);
+    }
+    if (statsQueryPool != VK_NULL_HANDLE) {
+      vkCmdEndQuery(cmdBuffer, statsQueryPool,
+                    (uint32_t)ScenePassStat::DepthPrepass);
+      vkCmdBeginQuery(cmdBuffer, statsQueryPool,
+                      (uint32_t)ScenePassStat::Scene, 0);
+    }
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                      _scenePipeline);
+    currentScene->drawScene(_frame);
+    if (statsQueryPool != VK_NULL_HANDLE) {
+      vkCmdEndQuery(cmdBuffer, statsQueryPool, (uint32_t)ScenePassStat::Scene);
+    }
+  };
+
   VkRenderPassBeginInfo renderPassInfo = {};
   renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
   renderPassInfo.renderPass = _deferredRenderPass;
@@ -85,17 +208,34 @@ void recordCommand(VkRenderPass _deferredRenderPass,
   renderPassInfo.clearValueCount = clearValues.size();
   renderPassInfo.pClearValues = clearValues.data();
   vkCmdBeginRenderPass(cmdBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+  writeTimestamp(ScenePassTimestamp::Begin);
 
   if (currentScene->SceneRenderPassType == RenderPassType::Deferred) {
+    drawSceneWithPrepass(_gBufferPipeline);
     vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                      _gBufferPipeline);
-    currentScene->drawScene(_frame);
+                      gImpostorPass.Pipeline);
+    currentScene->drawImpostors(_frame);
+  }
+
+  vkCmdNextSubpass(cmdBuffer, VK_SUBPASS_CONTENTS_INLINE);
+  if (currentScene->SceneRenderPassType == RenderPassType::Visibility) {
+    drawSceneWithPrepass(gVisibilityBuffer.WritePipeline);
+  }
+  writeTimestamp(ScenePassTimestamp::Geometry);
+
+  bool isLightingDeferred =
+      currentScene->SceneRenderPassType == RenderPassType::Deferred &&
+      gBufferVisualize.CurrentOption == GBufferVisualizingOption::RenderedScene;
+
+  vkCmdNextSubpass(cmdBuffer, VK_SUBPASS_CONTENTS_INLINE);
+  if (isLightingDeferred && gHalfResLighting.IsEnabled) {
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                      gHalfResLighting.DiffusePipeline);
+    vkCmdDraw(cmdBuffer, 3, 1, 0, 0);
   }
 
   vkCmdNextSubpass(cmdBuffer, VK_SUBPASS_CONTENTS_INLINE);
-  if (currentScene->SceneRenderPassType == RenderPassType::Deferred &&
-      gBufferVisualize.CurrentOption ==
-          GBufferVisualizingOption::RenderedScene) {
+  if (isLightingDeferred) {
 
     vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
                       _brdfPipeline);
@@ -103,12 +243,25 @@ void recordCommand(VkRenderPass _deferredRenderPass,
     vkCmdDraw(cmdBuffer, 3, 1, 0, 0);
   }
 
+  if (currentScene->SceneRenderPassType == RenderPassType::Visibility) {
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                      gVisibilityBuffer.ResolvePipeline);
+
+    // The material goes in as the first instance so the resolve can skip
+    // pixels of other materials.
+    for (uint32_t material : gVisibilityBuffer.Materials) {
+      vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                              gStandardPipelineLayout.Handle, 2, 1,
+                              &_frame.MaterialDescriptorSets[material], 0,
+                              nullptr);
+      vkCmdDraw(cmdBuffer, 3, 1, 0, material);
+    }
+  }
+
   vkCmdNextSubpass(cmdBuffer, VK_SUBPASS_CONTENTS_INLINE);
 
   if (currentScene->SceneRenderPassType == RenderPassType::Forward) {
-    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                      _forwardPipeline);
-    currentScene->drawScene(_frame);
+    drawSceneWithPrepass(_forwardPipeline);
   }
 
   if (gBufferVisualize.CurrentOption !=
@@ -119,6 +272,7 @@ void recordCommand(VkRenderPass _deferredRenderPass,
 
     vkCmdDraw(cmdBuffer, 3, 1, 0, 0);
   }
+  writeTimestamp(ScenePassTimestamp::Lighting);
 
   vkCmdNextSubpass(cmdBuffer, VK_SUBPASS_CONTENTS_INLINE);
   vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
@@ -169,13 +323,172 @@ void recordCommand(VkRenderPass _deferredRenderPass,
   }
 
   vkCmdDrawIndexed(cmdBuffer, gGizmo.NumIndices, 1, 0, 0, 0);
+  // The GUI's objects aren't created through the renderer, so they can't be
+  // captured.
+  pauseFrameCapture(true);
   ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmdBuffer);
+  pauseFrameCapture(false);
 
   vkCmdEndRenderPass(cmdBuffer);
 
+  if (gFrameReadback.IsCapturing) {
+    pauseFrameCapture(true);
+    recordFrameReadback(gFrameReadback, cmdBuffer, _swapChainImage,
+                        VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, _swapChainExtent,
+                        _swapChainFormat);
+    pauseFrameCapture(false);
+  }
+
   BB_VK_ASSERT(vkEndCommandBuffer(cmdBuffer));
 }
 
+static double getElapsedMs(ScenePassTimestamp _from, ScenePassTimestamp _to,
+                           float _timestampPeriod) {
+  return (double)(gScenePassTimestamps[_to] - gScenePassTimestamps[_from]) *
+         _timestampPeriod / 1e6;
+}
+
+// Advances the light count sweep by a frame, given the lighting time of the
+// frame just read back. Returns the number of lights to render with.
+static int updateLightingBenchmark(double _lightingMs) {
+  LightingBenchmark &benchmark = gLightingBenchmark;
+  constexpr int numSteps = 2 * (int)std::size(LightingBenchmark::LightCounts);
+
+  if (benchmark.Frame >= LightingBenchmark::NumWarmupFrames) {
+    benchmark.SumMs += _lightingMs;
+  }
+  if (++benchmark.Frame == LightingBenchmark::NumWarmupFrames +
+                               LightingBenchmark::NumMeasuredFrames) {
+    benchmark.ResultMs[benchmark.Step / 2][benchmark.Step % 2] =
+        (float)(benchmark.SumMs / LightingBenchmark::NumMeasuredFrames);
+    benchmark.Frame = 0;
+    benchmark.SumMs = 0;
+    if (++benchmark.Step == numSteps) {
+      benchmark.IsRunning = false;
+      gHalfResLighting.IsEnabled = benchmark.WasHalfResEnabled;
+      return LightingBenchmark::LightCounts[numSteps / 2 - 1];
+    }
+  }
+
+  gHalfResLighting.IsEnabled = benchmark.Step % 2 == 1;
+  return LightingBenchmark::LightCounts[benchmark.Step / 2];
+}
+
+// Advances the vertex pulling benchmark by a frame, given the geometry time
+// and scene pass vertex invocations of the frame just read back.
+static void updateVertexPullingBenchmark(double _geometryMs,
+                                         uint64_t _numVertices) {
+  VertexPullingBenchmark &benchmark = gVertexPullingBenchmark;
+
+  if (benchmark.Frame >= VertexPullingBenchmark::NumWarmupFrames) {
+    benchmark.SumMs += _geometryMs;
+    benchmark.SumNumVertices += _numVertices;
+  }
+  if (++benchmark.Frame == VertexPullingBenchmark::NumWarmupFrames +
+                               VertexPullingBenchmark::NumMeasuredFrames) {
+    benchmark.ResultMs[benchmark.Step] =
+        (float)(benchmark.SumMs / VertexPullingBenchmark::NumMeasuredFrames);
+    // 0 if pipeline statistics aren't supported.
+    benchmark.NsPerVertex[benchmark.Step] =
+        benchmark.SumNumVertices > 0
+            ? (float)(benchmark.SumMs * 1e6 / benchmark.SumNumVertices)
+            : 0.f;
+    benchmark.Frame = 0;
+    benchmark.SumMs = 0;
+    benchmark.SumNumVertices = 0;
+    if (++benchmark.Step == 2) {
+      benchmark.IsRunning = false;
+      benchmark.HasResults = true;
+      gVertexPulling.IsEnabled = benchmark.WasEnabled;
+      gDepthPrepass.IsEnabled = benchmark.WasPrepassEnabled;
+      return;
+    }
+  }
+
+  gVertexPulling.IsEnabled = benchmark.Step == 1;
+}
+
+// Steps on the multiview path are skipped for view counts without a pipeline.
+static void skipUnavailableMultiviewSteps() {
+  MultiviewBenchmark &benchmark = gMultiviewBenchmark;
+  constexpr int numSteps = 2 * (int)maxNumMultiviews;
+  while (benchmark.Step < numSteps && benchmark.Step % 2 == 0 &&
+         gMultiview.MultiviewPipelines[benchmark.Step / 2] == VK_NULL_HANDLE) {
+    benchmark.ResultMs[benchmark.Step / 2][MultiviewPath::Multiview] = -1.f;
+    ++benchmark.Step;
+  }
+}
+
+// Advances the view count sweep by a frame, given the capture's CPU time of
+// the frame before, and sets the capture up for the next one.
+static void updateMultiviewBenchmark(double _cpuMs) {
+  MultiviewBenchmark &benchmark = gMultiviewBenchmark;
+  constexpr int numSteps = 2 * (int)maxNumMultiviews;
+
+  if (benchmark.Frame >= MultiviewBenchmark::NumWarmupFrames) {
+    benchmark.SumMs += _cpuMs;
+  }
+  if (++benchmark.Frame == MultiviewBenchmark::NumWarmupFrames +
+                               MultiviewBenchmark::NumMeasuredFrames) {
+    MultiviewPath path = (MultiviewPath)(benchmark.Step % 2);
+    benchmark.ResultMs[benchmark.Step / 2][path] =
+        (float)(benchmark.SumMs / MultiviewBenchmark::NumMeasuredFrames);
+    benchmark.Frame = 0;
+    benchmark.SumMs = 0;
+    ++benchmark.Step;
+    skipUnavailableMultiviewSteps();
+  }
+
+  if (benchmark.Step == numSteps) {
+    benchmark.IsRunning = false;
+    gMultiview.IsEnabled = benchmark.WasEnabled;
+    gMultiview.Path = benchmark.SavedPath;
+    gMultiview.Arrangement = benchmark.SavedArrangement;
+    gMultiview.NumOrbitViews = benchmark.SavedNumOrbitViews;
+    return;
+  }
+
+  gMultiview.IsEnabled = true;
+  gMultiview.Path = (MultiviewPath)(benchmark.Step % 2);
+  gMultiview.Arrangement = MultiviewArrangement::Orbit;
+  gMultiview.NumOrbitViews = benchmark.Step / 2 + 1;
+}
+
+// World-space ray through the center of a pixel. With reverse-Z the near
+// plane is at depth 1, and a MaxT of 1 ends the ray at the far plane.
+static Ray createPickRay(const ViewUniformBlock &_view, const Int2 &_cursor,
+                         int _width, int _height) {
+  Mat4 invViewProj = (_view.ProjMat * _view.ViewMat).inverse();
+  float ndcX = 2.f * ((float)_cursor.X + 0.5f) / (float)_width - 1.f;
+  float ndcY = 2.f * ((float)_cursor.Y + 0.5f) / (float)_height - 1.f;
+  auto unproject = [&](float _depth) {
+    Float4 p = {ndcX, ndcY, _depth, 1};
+    float w = dot(invViewProj.row(3), p);
+    return Float3{dot(invViewProj.row(0), p) / w,
+                  dot(invViewProj.row(1), p) / w,
+                  dot(invViewProj.row(2), p) / w};
+  };
+
+  Ray ray;
+  ray.Origin = unproject(1.f);
+  ray.Dir = unproject(0.f) - ray.Origin;
+  ray.MaxT = 1.f;
+  return ray;
+}
+
+// Writes the loads since the previous report to asset_loads_<label>.json.
+static void reportAssetLoads(std::string_view _label) {
+  gAssetLoadReport = takeAssetLoadReport(_label);
+  std::string fileName = fmt::format("asset_loads_{}.json", _label);
+  std::replace(fileName.begin(), fileName.end(), ' ', '_');
+  std::transform(fileName.begin(), fileName.end(), fileName.begin(),
+                 [](char _ch) { return (char)tolower(_ch); });
+  if (writeAssetLoadReport(gAssetLoadReport, fileName)) {
+    BB_LOG_INFO("Wrote {}: {} loads in {:.1f} ms", fileName,
+                gAssetLoadReport.Loads.size(), gAssetLoadReport.Ms);
+  }
+}
+
 } // namespace bb
 
 int main(int _argc, char **_argv) {
@@ -186,6 +499,17 @@ int main(int _argc, char **_argv) {
 
   CommonSceneResources commonSceneResources = {};
 
+  initAssetLoadReport();
+  initJobSystem(gJobSystem);
+  commonSceneResources.JobSystem = &gJobSystem;
+
+  // Headless mode: --convert-scene <description.toml> <scene.bbscene>
+  if (_argc >= 4 && strcmp(_argv[1], "--convert-scene") == 0) {
+    bool isConverted = convertSceneDescription(_argv[2], _argv[3]);
+    destroyJobSystem(gJobSystem);
+    return isConverted ? 0 : 1;
+  }
+
   BB_VK_ASSERT(volkInitialize());
 
   SDL_Init(SDL_INIT_VIDEO);
@@ -197,6 +521,16 @@ int main(int _argc, char **_argv) {
 
   Renderer renderer = createRenderer(window);
   commonSceneResources.Renderer = &renderer;
+  if (_argc >= 2 && strcmp(_argv[1], "--frame-capture") == 0) {
+    initFrameCapture(renderer);
+  }
+  if (_argc >= 3 && strcmp(_argv[1], "--scene") == 0) {
+    gSceneFilePath = _argv[2];
+    gCurrentSceneType = SceneType::File;
+  }
+  initFrameReadback(gFrameReadback, renderer);
+  initAsyncContext(gAsync, renderer, gJobSystem);
+  commonSceneResources.Async = &gAsync;
 
   VkCommandPoolCreateInfo transientCmdPoolCreateInfo = {};
   transientCmdPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
@@ -208,6 +542,12 @@ int main(int _argc, char **_argv) {
                                    nullptr, &transientCmdPool));
   commonSceneResources.TransientCmdPool = transientCmdPool;
 
+  commonSceneResources.NumFrames = numFrames;
+
+  gGeometryPool = createGeometryPool(renderer, 1 << 21, 3 << 21,
+                                     VertexStreamLayout::Split);
+  commonSceneResources.GeometryPool = &gGeometryPool;
+
   gStandardPipelineLayout = createStandardPipelineLayout(renderer);
   commonSceneResources.StandardPipelineLayout = &gStandardPipelineLayout;
 
@@ -287,12 +627,19 @@ int main(int _argc, char **_argv) {
 
   Shader brdfVertShader = createShaderFromFile(renderer, "brdf.vert.spv");
   Shader brdfFragShader = createShaderFromFile(renderer, "brdf.frag.spv");
+  gHalfResLighting.DiffuseFragShader =
+      createShaderFromFile(renderer, "brdf_diffuse.frag.spv");
 
   Shader forwardBrdfVertShader =
       createShaderFromFile(renderer, "forward_brdf.vert.spv");
   Shader forwardBrdfFragShader =
       createShaderFromFile(renderer, "forward_brdf.frag.spv");
 
+  gVertexPulling.ForwardVertShader =
+      createShaderFromFile(renderer, "forward_brdf_pulled.vert.spv");
+  gVertexPulling.GBufferVertShader =
+      createShaderFromFile(renderer, "gbuffer_pulled.vert.spv");
+
   Shader hdrToneMappingVertShader =
       createShaderFromFile(renderer, "hdr_tone_mapping.vert.spv");
   Shader hdrToneMappingFragShader =
@@ -307,6 +654,45 @@ int main(int _argc, char **_argv) {
   gGizmo.VertShader = createShaderFromFile(renderer, "gizmo.vert.spv");
   gGizmo.FragShader = createShaderFromFile(renderer, "gizmo.frag.spv");
 
+  gDepthPrepass.VertShader = createShaderFromFile(renderer, "depth.vert.spv");
+
+  {
+    Shader shadowVertShader = createShaderFromFile(renderer, "shadow.vert.spv");
+    gShadowAtlas =
+        createShadowAtlas(renderer, transientCmdPool,
+                          gStandardPipelineLayout.Handle, gGeometryPool.Layout,
+                          shadowVertShader);
+    destroyShader(renderer, shadowVertShader);
+  }
+
+  {
+    Shader multiviewVertShader = {};
+    if (renderer.SupportsMultiview) {
+      multiviewVertShader =
+          createShaderFromFile(renderer, "multiview.vert.spv");
+    }
+    Shader layeredVertShader =
+        createShaderFromFile(renderer, "multiview_layered.vert.spv");
+    Shader fragShader = createShaderFromFile(renderer, "multiview.frag.spv");
+    gMultiview = createMultiviewCapture(
+        renderer, gStandardPipelineLayout.Handle, gGeometryPool.Layout,
+        multiviewVertShader, layeredVertShader, fragShader);
+    if (renderer.SupportsMultiview) {
+      destroyShader(renderer, multiviewVertShader);
+    }
+    destroyShader(renderer, layeredVertShader);
+    destroyShader(renderer, fragShader);
+  }
+
+  gVisibilityBuffer.WriteVertShader =
+      createShaderFromFile(renderer, "visibility.vert.spv");
+  gVisibilityBuffer.WriteFragShader =
+      createShaderFromFile(renderer, "visibility.frag.spv");
+  gVisibilityBuffer.ResolveVertShader =
+      createShaderFromFile(renderer, "visibility_resolve.vert.spv");
+  gVisibilityBuffer.ResolveFragShader =
+      createShaderFromFile(renderer, "visibility_resolve.frag.spv");
+
   gLightSources.VertShader = createShaderFromFile(renderer, "light.vert.spv");
   gLightSources.FragShader = createShaderFromFile(renderer, "light.frag.spv");
 
@@ -315,13 +701,26 @@ int main(int _argc, char **_argv) {
   gBufferVisualize.FragShader =
       createShaderFromFile(renderer, "buffer_visualize.frag.spv");
 
-  PBRMaterialSet materialSet = createPBRMaterialSet(renderer, transientCmdPool);
+  gBlockDecompressor = createBlockDecompressor(renderer);
+  PBRMaterialSet materialSet = createPBRMaterialSet(
+      renderer, transientCmdPool, &gBlockDecompressor, &gStartupLoadStats);
   commonSceneResources.MaterialSet = &materialSet;
 
-  // Create a descriptor pool corresponding to the standard pipeline layout
-  VkDescriptorPool standardDescriptorPool = createStandardDescriptorPool(
-      renderer, gStandardPipelineLayout,
-      {numFrames, 1, (uint32_t)materialSet.Materials.size(), 1});
+  gImpostorPass.VertShader =
+      createShaderFromFile(renderer, "impostor.vert.spv");
+  gImpostorPass.FragShader =
+      createShaderFromFile(renderer, "impostor.frag.spv");
+  // Sets that live as long as the app. Material sets are cached, so frames
+  // and the impostor baker share them.
+  gDescriptorAllocator = createDescriptorAllocator(16, 256);
+  gImpostorPass.Baker = createImpostorBaker(
+      renderer, gStandardPipelineLayout, gDescriptorAllocator,
+      gDescriptorSetCache, materialSet, gGeometryPool.Layout,
+      gBufferVertShader, gBufferFragShader);
+  commonSceneResources.ImpostorBaker = &gImpostorPass.Baker;
+  commonSceneResources.DescriptorAllocator = &gDescriptorAllocator;
+  commonSceneResources.DescriptorSetCache = &gDescriptorSetCache;
+
   RenderPass deferredRenderPass;
 
   VkPipeline forwardPipeline;
@@ -334,10 +733,7 @@ int main(int _argc, char **_argv) {
                                     &forwardBrdfFragShader};
   forwardPipelineParams.Shaders = forwardShaders;
   forwardPipelineParams.NumShaders = std::size(forwardShaders);
-  forwardPipelineParams.VertexInput.Bindings = Vertex::Bindings.data();
-  forwardPipelineParams.VertexInput.NumBindings = Vertex::Bindings.size();
-  forwardPipelineParams.VertexInput.Attributes = Vertex::Attributes.data();
-  forwardPipelineParams.VertexInput.NumAttributes = Vertex::Attributes.size();
+  setVertexInput(forwardPipelineParams, gGeometryPool.Layout);
   forwardPipelineParams.InputAssembly.Topology =
       VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
   forwardPipelineParams.Rasterizer.PolygonMode = VK_POLYGON_MODE_FILL;
@@ -353,10 +749,7 @@ int main(int _argc, char **_argv) {
   const Shader *gBufferShaders[] = {&gBufferVertShader, &gBufferFragShader};
   gBufferPipelineParams.Shaders = gBufferShaders;
   gBufferPipelineParams.NumShaders = std::size(gBufferShaders);
-  gBufferPipelineParams.VertexInput.Bindings = Vertex::Bindings.data();
-  gBufferPipelineParams.VertexInput.NumBindings = Vertex::Bindings.size();
-  gBufferPipelineParams.VertexInput.Attributes = Vertex::Attributes.data();
-  gBufferPipelineParams.VertexInput.NumAttributes = Vertex::Attributes.size();
+  setVertexInput(gBufferPipelineParams, gGeometryPool.Layout);
   gBufferPipelineParams.InputAssembly.Topology =
       VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
   gBufferPipelineParams.Rasterizer.PolygonMode = VK_POLYGON_MODE_FILL;
@@ -367,6 +760,27 @@ int main(int _argc, char **_argv) {
   gBufferPipelineParams.DepthStencil.DepthWriteEnable = true;
   gBufferPipelineParams.PipelineLayout = gStandardPipelineLayout.Handle;
 
+  // Same as the two above, fetching vertices in the vertex shader
+  PipelineParams pulledForwardPipelineParams = forwardPipelineParams;
+  const Shader *pulledForwardShaders[] = {&gVertexPulling.ForwardVertShader,
+                                          &forwardBrdfFragShader};
+  pulledForwardPipelineParams.Shaders = pulledForwardShaders;
+  pulledForwardPipelineParams.VertexInput = {};
+  PipelineParams pulledGBufferPipelineParams = gBufferPipelineParams;
+  const Shader *pulledGBufferShaders[] = {&gVertexPulling.GBufferVertShader,
+                                          &gBufferFragShader};
+  pulledGBufferPipelineParams.Shaders = pulledGBufferShaders;
+  pulledGBufferPipelineParams.VertexInput = {};
+
+  // Quads in front of their meshes, facing the view
+  PipelineParams impostorPipelineParams = gBufferPipelineParams;
+  const Shader *impostorShaders[] = {&gImpostorPass.VertShader,
+                                     &gImpostorPass.FragShader};
+  impostorPipelineParams.Shaders = impostorShaders;
+  impostorPipelineParams.NumShaders = std::size(impostorShaders);
+  setImpostorVertexInput(impostorPipelineParams);
+  impostorPipelineParams.Rasterizer.CullMode = VK_CULL_MODE_NONE;
+
   PipelineParams brdfPipelineParams = {};
   const Shader *brdfShaders[] = {&brdfVertShader, &brdfFragShader};
   brdfPipelineParams.Shaders = brdfShaders;
@@ -381,6 +795,43 @@ int main(int _argc, char **_argv) {
   brdfPipelineParams.DepthStencil.DepthWriteEnable = true;
   brdfPipelineParams.PipelineLayout = gStandardPipelineLayout.Handle;
 
+  // The triangle is refetched from the pool's position and attribute
+  // streams, which only exist separately in the split layout.
+  BB_ASSERT(gGeometryPool.Layout == VertexStreamLayout::Split);
+
+  PipelineParams visibilityWritePipelineParams = {};
+  const Shader *visibilityWriteShaders[] = {&gVisibilityBuffer.WriteVertShader,
+                                            &gVisibilityBuffer.WriteFragShader};
+  visibilityWritePipelineParams.Shaders = visibilityWriteShaders;
+  visibilityWritePipelineParams.NumShaders = std::size(visibilityWriteShaders);
+  setVertexInput(visibilityWritePipelineParams, gGeometryPool.Layout, true);
+  visibilityWritePipelineParams.InputAssembly.Topology =
+      VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  visibilityWritePipelineParams.Rasterizer.PolygonMode = VK_POLYGON_MODE_FILL;
+  visibilityWritePipelineParams.Rasterizer.CullMode = VK_CULL_MODE_BACK_BIT;
+  visibilityWritePipelineParams.Blend.NumColorBlends = 1;
+  visibilityWritePipelineParams.Subpass =
+      (uint32_t)DeferredSubpassType::VisibilityWrite;
+  visibilityWritePipelineParams.DepthStencil.DepthTestEnable = true;
+  visibilityWritePipelineParams.DepthStencil.DepthWriteEnable = true;
+  visibilityWritePipelineParams.PipelineLayout = gStandardPipelineLayout.Handle;
+
+  PipelineParams visibilityResolvePipelineParams = brdfPipelineParams;
+  const Shader *visibilityResolveShaders[] = {
+      &gVisibilityBuffer.ResolveVertShader,
+      &gVisibilityBuffer.ResolveFragShader};
+  visibilityResolvePipelineParams.Shaders = visibilityResolveShaders;
+  visibilityResolvePipelineParams.NumShaders =
+      std::size(visibilityResolveShaders);
+
+  PipelineParams brdfDiffusePipelineParams = brdfPipelineParams;
+  const Shader *brdfDiffuseShaders[] = {&brdfVertShader,
+                                        &gHalfResLighting.DiffuseFragShader};
+  brdfDiffusePipelineParams.Shaders = brdfDiffuseShaders;
+  brdfDiffusePipelineParams.NumShaders = std::size(brdfDiffuseShaders);
+  brdfDiffusePipelineParams.Subpass =
+      (uint32_t)DeferredSubpassType::DiffuseLighting;
+
   PipelineParams hdrToneMappingPipelineParams = {};
   const Shader *hdrToneMappingShaders[] = {&hdrToneMappingVertShader,
                                            &hdrToneMappingFragShader};
@@ -400,6 +851,9 @@ int main(int _argc, char **_argv) {
   std::vector<VkFramebuffer> deferredFramebuffers;
   Image gbufferAttachmentImages[numGBufferAttachments] = {};
   Image hdrAttachmentImage = {};
+  Image visibilityAttachmentImage = {};
+  // Full size, as every attachment of the render pass must be.
+  Image halfResDiffuseAttachmentImage = {};
 
   auto initReloadableResources = [&] {
     swapChain = createSwapChain(renderer, width, height, nullptr);
@@ -457,7 +911,7 @@ int main(int _argc, char **_argv) {
       attachments[DeferredAttachmentType::GBufferAlbedo] =
           gbufferColorAttachment;
       attachments[DeferredAttachmentType::GBufferMRAH] = gbufferColorAttachment;
-      attachments[DeferredAttachmentType::GBufferMaterialIndex] =
+      attachments[DeferredAttachmentType::GBufferBakedLighting] =
           gbufferColorAttachment;
 
       VkAttachmentDescription &hdrAttachment =
@@ -471,6 +925,31 @@ int main(int _argc, char **_argv) {
       hdrAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
       hdrAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
+      VkAttachmentDescription &visibilityAttachment =
+          attachments[DeferredAttachmentType::Visibility];
+      visibilityAttachment.format = visibilityAttachmentFormat;
+      visibilityAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+      visibilityAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+      visibilityAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+      visibilityAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+      visibilityAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+      visibilityAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+      visibilityAttachment.finalLayout =
+          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+      VkAttachmentDescription &halfResDiffuseAttachment =
+          attachments[DeferredAttachmentType::HalfResDiffuse];
+      halfResDiffuseAttachment.format = hdrAttachmentFormat;
+      halfResDiffuseAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+      halfResDiffuseAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+      halfResDiffuseAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+      halfResDiffuseAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+      halfResDiffuseAttachment.stencilStoreOp =
+          VK_ATTACHMENT_STORE_OP_DONT_CARE;
+      halfResDiffuseAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+      halfResDiffuseAttachment.finalLayout =
+          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
       VkAttachmentReference finalColorAttachmentRef = {
           (uint32_t)DeferredAttachmentType::Color,
           VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
@@ -499,7 +978,16 @@ int main(int _argc, char **_argv) {
               VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
           },
           {
-              (uint32_t)DeferredAttachmentType::GBufferMaterialIndex,
+              (uint32_t)DeferredAttachmentType::GBufferBakedLighting,
+              VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+          },
+          // Read by the visibility resolve instead of the G-buffer
+          {
+              (uint32_t)DeferredAttachmentType::Visibility,
+              VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+          },
+          {
+              (uint32_t)DeferredAttachmentType::HalfResDiffuse,
               VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
           },
       };
@@ -522,11 +1010,21 @@ int main(int _argc, char **_argv) {
               VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
           },
           {
-              (uint32_t)DeferredAttachmentType::GBufferMaterialIndex,
+              (uint32_t)DeferredAttachmentType::GBufferBakedLighting,
               VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
           },
       };
 
+      VkAttachmentReference visibilityColorAttachmentRef = {
+          (uint32_t)DeferredAttachmentType::Visibility,
+          VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+      };
+
+      VkAttachmentReference halfResDiffuseColorAttachmentRef = {
+          (uint32_t)DeferredAttachmentType::HalfResDiffuse,
+          VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+      };
+
       VkAttachmentReference hdrColorAttachmentRef = {
           (uint32_t)DeferredAttachmentType::HDR,
           VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
@@ -548,6 +1046,40 @@ int main(int _argc, char **_argv) {
       subpasses[DeferredSubpassType::GBufferWrite].pDepthStencilAttachment =
           &depthAttachmentRef;
 
+      subpasses[DeferredSubpassType::VisibilityWrite].pipelineBindPoint =
+          VK_PIPELINE_BIND_POINT_GRAPHICS;
+      subpasses[DeferredSubpassType::VisibilityWrite].colorAttachmentCount = 1;
+      subpasses[DeferredSubpassType::VisibilityWrite].pColorAttachments =
+          &visibilityColorAttachmentRef;
+      subpasses[DeferredSubpassType::VisibilityWrite].pDepthStencilAttachment =
+          &depthAttachmentRef;
+      // The G-buffer is read again by the Lighting subpass.
+      uint32_t gbufferAttachmentIndices[numGBufferAttachments];
+      for (uint32_t i = 0; i < numGBufferAttachments; ++i) {
+        gbufferAttachmentIndices[i] =
+            (uint32_t)DeferredAttachmentType::GBufferPosition + i;
+      }
+      subpasses[DeferredSubpassType::VisibilityWrite].preserveAttachmentCount =
+          numGBufferAttachments;
+      subpasses[DeferredSubpassType::VisibilityWrite].pPreserveAttachments =
+          gbufferAttachmentIndices;
+
+      subpasses[DeferredSubpassType::DiffuseLighting].pipelineBindPoint =
+          VK_PIPELINE_BIND_POINT_GRAPHICS;
+      subpasses[DeferredSubpassType::DiffuseLighting].inputAttachmentCount =
+          numGBufferAttachments;
+      subpasses[DeferredSubpassType::DiffuseLighting].pInputAttachments =
+          gbufferReadonlyAttachmentRefs;
+      subpasses[DeferredSubpassType::DiffuseLighting].colorAttachmentCount = 1;
+      subpasses[DeferredSubpassType::DiffuseLighting].pColorAttachments =
+          &halfResDiffuseColorAttachmentRef;
+      uint32_t visibilityAttachmentIndex =
+          (uint32_t)DeferredAttachmentType::Visibility;
+      subpasses[DeferredSubpassType::DiffuseLighting].preserveAttachmentCount =
+          1;
+      subpasses[DeferredSubpassType::DiffuseLighting].pPreserveAttachments =
+          &visibilityAttachmentIndex;
+
       subpasses[DeferredSubpassType::Lighting].pipelineBindPoint =
           VK_PIPELINE_BIND_POINT_GRAPHICS;
       subpasses[DeferredSubpassType::Lighting].inputAttachmentCount =
@@ -583,7 +1115,7 @@ int main(int _argc, char **_argv) {
       subpasses[DeferredSubpassType::Overlay].pDepthStencilAttachment =
           &depthAttachmentRef;
 
-      VkSubpassDependency subpassDependencies[6] = {};
+      VkSubpassDependency subpassDependencies[11] = {};
       subpassDependencies[0].srcSubpass =
           (uint32_t)DeferredSubpassType::GBufferWrite;
       subpassDependencies[0].dstSubpass =
@@ -660,6 +1192,72 @@ int main(int _argc, char **_argv) {
           VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
           VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 
+      subpassDependencies[6].srcSubpass =
+          (uint32_t)DeferredSubpassType::GBufferWrite;
+      subpassDependencies[6].dstSubpass =
+          (uint32_t)DeferredSubpassType::VisibilityWrite;
+      subpassDependencies[6].srcStageMask =
+          VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+      subpassDependencies[6].dstStageMask =
+          VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+      subpassDependencies[6].srcAccessMask =
+          VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+      subpassDependencies[6].dstAccessMask =
+          VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+          VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+      subpassDependencies[7].srcSubpass =
+          (uint32_t)DeferredSubpassType::VisibilityWrite;
+      subpassDependencies[7].dstSubpass =
+          (uint32_t)DeferredSubpassType::Lighting;
+      subpassDependencies[7].srcStageMask =
+          VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+      subpassDependencies[7].dstStageMask =
+          VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+      subpassDependencies[7].srcAccessMask =
+          VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+      subpassDependencies[7].dstAccessMask =
+          VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+
+      subpassDependencies[8].srcSubpass =
+          (uint32_t)DeferredSubpassType::VisibilityWrite;
+      subpassDependencies[8].dstSubpass =
+          (uint32_t)DeferredSubpassType::ForwardLighting;
+      subpassDependencies[8].srcStageMask =
+          VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+      subpassDependencies[8].dstStageMask =
+          VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+      subpassDependencies[8].srcAccessMask =
+          VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+      subpassDependencies[8].dstAccessMask =
+          VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+
+      subpassDependencies[9].srcSubpass =
+          (uint32_t)DeferredSubpassType::GBufferWrite;
+      subpassDependencies[9].dstSubpass =
+          (uint32_t)DeferredSubpassType::DiffuseLighting;
+      subpassDependencies[9].srcStageMask =
+          VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+      subpassDependencies[9].dstStageMask =
+          VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+      subpassDependencies[9].srcAccessMask =
+          VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+      subpassDependencies[9].dstAccessMask =
+          VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+
+      subpassDependencies[10].srcSubpass =
+          (uint32_t)DeferredSubpassType::DiffuseLighting;
+      subpassDependencies[10].dstSubpass =
+          (uint32_t)DeferredSubpassType::Lighting;
+      subpassDependencies[10].srcStageMask =
+          VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+      subpassDependencies[10].dstStageMask =
+          VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+      subpassDependencies[10].srcAccessMask =
+          VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+      subpassDependencies[10].dstAccessMask =
+          VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+
       VkRenderPassCreateInfo renderPassCreateInfo = {};
       renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
       renderPassCreateInfo.attachmentCount = attachments.size();
@@ -694,6 +1292,19 @@ int main(int _argc, char **_argv) {
                            VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
     hdrAttachmentImage = createImage(renderer, hdrImageParams);
 
+    ImageParams visibilityImageParams = {};
+    visibilityImageParams.Format = visibilityAttachmentFormat;
+    visibilityImageParams.Width = swapChain.Extent.width;
+    visibilityImageParams.Height = swapChain.Extent.height;
+    visibilityImageParams.Usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                                  VK_IMAGE_USAGE_SAMPLED_BIT |
+                                  VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+    visibilityAttachmentImage = createImage(renderer, visibilityImageParams);
+
+    ImageParams halfResDiffuseImageParams = hdrImageParams;
+    halfResDiffuseAttachmentImage =
+        createImage(renderer, halfResDiffuseImageParams);
+
     deferredFramebuffers.resize(swapChain.NumColorImages);
     // Create deferred framebuffer
     for (uint32_t i = 0; i < swapChain.NumColorImages; ++i) {
@@ -705,6 +1316,7 @@ int main(int _argc, char **_argv) {
           gbufferAttachmentImages[0].View, gbufferAttachmentImages[1].View,
           gbufferAttachmentImages[2].View, gbufferAttachmentImages[3].View,
           gbufferAttachmentImages[4].View, hdrAttachmentImage.View,
+          visibilityAttachmentImage.View, halfResDiffuseAttachmentImage.View,
       };
       fbCreateInfo.attachmentCount = attachments.size();
       fbCreateInfo.pAttachments = attachments.data();
@@ -728,6 +1340,17 @@ int main(int _argc, char **_argv) {
         (int)swapChain.Extent.width, (int)swapChain.Extent.height};
     gBufferPipelineParams.RenderPass = deferredRenderPass.Handle;
     gBufferPipeline = createPipeline(renderer, gBufferPipelineParams);
+    pulledForwardPipelineParams.Viewport = forwardPipelineParams.Viewport;
+    pulledForwardPipelineParams.RenderPass = deferredRenderPass.Handle;
+    gVertexPulling.ForwardPipeline =
+        createPipeline(renderer, pulledForwardPipelineParams);
+    pulledGBufferPipelineParams.Viewport = gBufferPipelineParams.Viewport;
+    pulledGBufferPipelineParams.RenderPass = deferredRenderPass.Handle;
+    gVertexPulling.GBufferPipeline =
+        createPipeline(renderer, pulledGBufferPipelineParams);
+    impostorPipelineParams.Viewport = gBufferPipelineParams.Viewport;
+    impostorPipelineParams.RenderPass = deferredRenderPass.Handle;
+    gImpostorPass.Pipeline = createPipeline(renderer, impostorPipelineParams);
     brdfPipelineParams.Viewport.Extent = {(float)swapChain.Extent.width,
                                           (float)swapChain.Extent.height};
     brdfPipelineParams.Viewport.ScissorExtent = {(int)swapChain.Extent.width,
@@ -741,6 +1364,46 @@ int main(int _argc, char **_argv) {
     hdrToneMappingPipelineParams.RenderPass = deferredRenderPass.Handle;
     hdrToneMappingPipeline =
         createPipeline(renderer, hdrToneMappingPipelineParams);
+    visibilityWritePipelineParams.Viewport.Extent = {
+        (float)swapChain.Extent.width, (float)swapChain.Extent.height};
+    visibilityWritePipelineParams.Viewport.ScissorExtent = {
+        (int)swapChain.Extent.width, (int)swapChain.Extent.height};
+    visibilityWritePipelineParams.RenderPass = deferredRenderPass.Handle;
+    gVisibilityBuffer.WritePipeline =
+        createPipeline(renderer, visibilityWritePipelineParams);
+    visibilityResolvePipelineParams.Viewport = brdfPipelineParams.Viewport;
+    visibilityResolvePipelineParams.RenderPass = deferredRenderPass.Handle;
+    gVisibilityBuffer.ResolvePipeline =
+        createPipeline(renderer, visibilityResolvePipelineParams);
+    // Rounded up so that odd sizes still cover the last pixel row and column.
+    uint32_t halfWidth = (swapChain.Extent.width + 1) / 2;
+    uint32_t halfHeight = (swapChain.Extent.height + 1) / 2;
+    brdfDiffusePipelineParams.Viewport.Extent = {(float)halfWidth,
+                                                 (float)halfHeight};
+    brdfDiffusePipelineParams.Viewport.ScissorExtent = {(int)halfWidth,
+                                                        (int)halfHeight};
+    brdfDiffusePipelineParams.RenderPass = deferredRenderPass.Handle;
+    gHalfResLighting.DiffusePipeline =
+        createPipeline(renderer, brdfDiffusePipelineParams);
+
+    // Depth prepass pipelines, one per subpass the scene can be drawn in
+    {
+      const Shader *shaders[] = {&gDepthPrepass.VertShader};
+      EnumArray<RenderPassType, const PipelineParams *> scenePipelineParams = {
+          &forwardPipelineParams, &gBufferPipelineParams,
+          &visibilityWritePipelineParams};
+
+      for (RenderPassType renderPassType : AllEnums<RenderPassType>) {
+        PipelineParams pipelineParams = *scenePipelineParams[renderPassType];
+        pipelineParams.Shaders = shaders;
+        pipelineParams.NumShaders = std::size(shaders);
+        setVertexInput(pipelineParams, gGeometryPool.Layout, true);
+        pipelineParams.Blend.DisableColorWrites = true;
+
+        gDepthPrepass.Pipelines[renderPassType] =
+            createPipeline(renderer, pipelineParams);
+      }
+    }
 
     // Gizmo Pipeline
     {
@@ -796,12 +1459,7 @@ int main(int _argc, char **_argv) {
       tbnPipelineParams.InputAssembly.Topology =
           VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 
-      auto bindings = Vertex::getBindingDescs();
-      auto attributes = Vertex::getAttributeDescs();
-      tbnPipelineParams.VertexInput.Bindings = bindings.data();
-      tbnPipelineParams.VertexInput.NumBindings = bindings.size();
-      tbnPipelineParams.VertexInput.Attributes = attributes.data();
-      tbnPipelineParams.VertexInput.NumAttributes = attributes.size();
+      setVertexInput(tbnPipelineParams, gGeometryPool.Layout);
 
       tbnPipelineParams.Viewport.Extent = {(float)swapChain.Extent.width,
                                            (float)swapChain.Extent.height};
@@ -920,6 +1578,13 @@ int main(int _argc, char **_argv) {
     vkDestroyPipeline(renderer.Device, gTBN.Pipeline, nullptr);
     gTBN.Pipeline = VK_NULL_HANDLE;
 
+    for (VkPipeline &pipeline : gDepthPrepass.Pipelines) {
+      vkDestroyPipeline(renderer.Device, pipeline, nullptr);
+      pipeline = VK_NULL_HANDLE;
+    }
+
+    destroyImage(renderer, halfResDiffuseAttachmentImage);
+    destroyImage(renderer, visibilityAttachmentImage);
     destroyImage(renderer, hdrAttachmentImage);
     for (Image &image : gbufferAttachmentImages) {
       destroyImage(renderer, image);
@@ -933,11 +1598,28 @@ int main(int _argc, char **_argv) {
     vkDestroyPipeline(renderer.Device, hdrToneMappingPipeline, nullptr);
     vkDestroyPipeline(renderer.Device, forwardPipeline, nullptr);
     vkDestroyPipeline(renderer.Device, gBufferPipeline, nullptr);
+    vkDestroyPipeline(renderer.Device, gVertexPulling.ForwardPipeline,
+                      nullptr);
+    vkDestroyPipeline(renderer.Device, gVertexPulling.GBufferPipeline,
+                      nullptr);
     vkDestroyPipeline(renderer.Device, brdfPipeline, nullptr);
+    vkDestroyPipeline(renderer.Device, gImpostorPass.Pipeline, nullptr);
+    vkDestroyPipeline(renderer.Device, gVisibilityBuffer.WritePipeline,
+                      nullptr);
+    vkDestroyPipeline(renderer.Device, gVisibilityBuffer.ResolvePipeline,
+                      nullptr);
+    vkDestroyPipeline(renderer.Device, gHalfResLighting.DiffusePipeline,
+                      nullptr);
 
     forwardPipeline = VK_NULL_HANDLE;
     gBufferPipeline = VK_NULL_HANDLE;
+    gVertexPulling.ForwardPipeline = VK_NULL_HANDLE;
+    gVertexPulling.GBufferPipeline = VK_NULL_HANDLE;
     brdfPipeline = VK_NULL_HANDLE;
+    gImpostorPass.Pipeline = VK_NULL_HANDLE;
+    gVisibilityBuffer.WritePipeline = VK_NULL_HANDLE;
+    gVisibilityBuffer.ResolvePipeline = VK_NULL_HANDLE;
+    gHalfResLighting.DiffusePipeline = VK_NULL_HANDLE;
 
     vkDestroyRenderPass(renderer.Device, deferredRenderPass.Handle, nullptr);
     deferredRenderPass.Handle = VK_NULL_HANDLE;
@@ -1012,10 +1694,18 @@ int main(int _argc, char **_argv) {
       gbufferAttachments[i] = gbufferAttachmentImages[i].View;
     }
     frames.push_back(createFrame(renderer, gStandardPipelineLayout,
-                                 standardDescriptorPool, materialSet,
-                                 gbufferAttachments, hdrAttachmentImage.View));
+                                 gDescriptorAllocator, gDescriptorSetCache,
+                                 materialSet, gbufferAttachments,
+                                 hdrAttachmentImage.View,
+                                 visibilityAttachmentImage.View,
+                                 halfResDiffuseAttachmentImage.View));
+    linkShadowAtlas(frames.back(), gShadowAtlas.SampledImage.View);
+    updateFrameDescriptorSet(renderer, gStandardPipelineLayout, frames.back());
   }
 
+  // Queries of a frame may only be read back once it has been submitted.
+  std::vector<bool> isFrameSubmitted(frames.size(), false);
+
   std::vector<FrameSync> frameSyncObjects;
   for (int i = 0; i < numFrames; ++i) {
     FrameSync syncObject = {};
@@ -1065,12 +1755,16 @@ int main(int _argc, char **_argv) {
         gbufferAttachments[i] = gbufferAttachmentImages[i].View;
       }
       linkExternalAttachmentsToDescriptorSet(
-          renderer, frame, gbufferAttachments, hdrAttachmentImage.View);
+          frame, gbufferAttachments, hdrAttachmentImage.View,
+          visibilityAttachmentImage.View, halfResDiffuseAttachmentImage.View);
+      updateFrameDescriptorSet(renderer, gStandardPipelineLayout, frame);
     }
   };
 
   uint32_t currentFrameIndex = 0;
   uint32_t currentSwapChainImageIndex = 0;
+  bool captureNextFrame = false;
+  uint32_t numCapturedFrames = 0;
 
   IMGUI_CHECKVERSION();
   ImGui::CreateContext();
@@ -1093,6 +1787,13 @@ int main(int _argc, char **_argv) {
   initInfo.CheckVkResultFn = nullptr;
   ImGui_ImplVulkan_Init(&initInfo, deferredRenderPass.Handle);
 
+  for (uint32_t i = 0; i < maxNumMultiviews; ++i) {
+    gMultiviewTextureIds[i] = ImGui_ImplVulkan_AddTexture(
+        gStandardPipelineLayout.ImmutableSamplers[SamplerType::Linear],
+        gMultiview.ColorLayerViews[i],
+        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+  }
+
   {
     VkCommandBufferAllocateInfo cmdBufferAllocInfo = {};
     cmdBufferAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -1122,19 +1823,59 @@ int main(int _argc, char **_argv) {
 
   FreeLookCamera cam = {};
   Input input = {};
+  // Dragging rotates the camera, so only a release close to where the button
+  // went down counts as a click.
+  Int2 clickStartPos = {};
+  bool isClickPending = false;
+  bool shouldPick = false;
+  Int2 pickPos = {};
 
   bool running = true;
 
+  reportAssetLoads("startup");
+
   Time lastTime = getCurrentTime();
 
+  std::vector<VisibilityDraw> visibilityDraws;
+  float timestampPeriod;
+  {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(renderer.PhysicalDevice, &properties);
+    timestampPeriod = properties.limits.timestampPeriod;
+  }
+
+  {
+    SDL_DisplayMode displayMode = {};
+    SDL_GetWindowDisplayMode(window, &displayMode);
+    int refreshRate =
+        displayMode.refresh_rate > 0 ? displayMode.refresh_rate : 60;
+    initLatencyTracker(gLatencyTracker, renderer, swapChain, refreshRate);
+  }
+  std::vector<float> latencyHistory;
+
   SDL_Event e = {};
   while (running) {
     while (SDL_PollEvent(&e) != 0) {
       ImGui_ImplSDL2_ProcessEvent(&e);
+      onLatencyEvent(gLatencyTracker, e);
       switch (e.type) {
       case SDL_MOUSEBUTTONDOWN:
       case SDL_MOUSEBUTTONUP:
         input.MouseDown = (e.button.state == SDL_PRESSED);
+        if (e.button.button == SDL_BUTTON_LEFT) {
+          Int2 pos = {e.button.x, e.button.y};
+          if (input.MouseDown) {
+            clickStartPos = pos;
+            isClickPending = !ImGui::GetIO().WantCaptureMouse;
+          } else if (isClickPending) {
+            constexpr int maxClickDistance = 3;
+            Int2 moved = pos - clickStartPos;
+            shouldPick = std::abs(moved.X) <= maxClickDistance &&
+                         std::abs(moved.Y) <= maxClickDistance;
+            pickPos = pos;
+            isClickPending = false;
+          }
+        }
         break;
       case SDL_KEYDOWN:
       case SDL_KEYUP:
@@ -1146,6 +1887,8 @@ int main(int _argc, char **_argv) {
       }
     }
 
+    beginLatencyFrame(gLatencyTracker);
+
     Time currentTime = getCurrentTime();
     float dt = getElapsedTimeInSeconds(lastTime, currentTime);
     lastTime = currentTime;
@@ -1161,6 +1904,10 @@ int main(int _argc, char **_argv) {
           if (ImGui::Selectable(gSceneLabels[sceneType],
                                 sceneType == gCurrentSceneType)) {
 
+            // Tiles hold the casters of the previous scene.
+            if (sceneType != gCurrentSceneType) {
+              resetShadowAtlas(gShadowAtlas);
+            }
             gCurrentSceneType = sceneType;
             ImGui::SetItemDefaultFocus();
           }
@@ -1178,14 +1925,22 @@ int main(int _argc, char **_argv) {
       case SceneType::ShaderBalls:
         gScenes[gCurrentSceneType] = new ShaderBallScene(&commonSceneResources);
         break;
+      case SceneType::File:
+        if (gSceneFilePath.empty()) {
+          gSceneFilePath = createCommonResourcePath(defaultSceneFileName);
+        }
+        gScenes[gCurrentSceneType] =
+            new FileScene(&commonSceneResources, gSceneFilePath);
+        break;
       }
+      reportAssetLoads(gSceneLabels[gCurrentSceneType]);
     }
 
     SceneBase *currentScene = gScenes[gCurrentSceneType];
 
     if (ImGui::Begin("Render Setting")) {
       EnumArray<RenderPassType, const char *> renderPassOptionLabels = {
-          "Forward", "Deferred"};
+          "Forward", "Deferred", "Visibility"};
       if (ImGui::BeginCombo(
               "Scene Render Pass",
               renderPassOptionLabels[currentScene->SceneRenderPassType])) {
@@ -1225,7 +1980,405 @@ int main(int _argc, char **_argv) {
     }
     ImGui::End();
 
+    if (ImGui::Begin("Depth Prepass")) {
+      ImGui::Checkbox("Enable", &gDepthPrepass.IsEnabled);
+
+      // Vertex shader invocations approximate fetched vertices, as both
+      // skip vertices that hit the post-transform cache.
+      auto guiVertexFetch = [](const char *_label, uint64_t _numVertices,
+                               uint32_t _stride) {
+        guiTextFmt("{}: {} vertices, {:.2f} MB fetched", _label, _numVertices,
+                   (double)(_numVertices * _stride) / (1024.0 * 1024.0));
+      };
+      VertexStreamLayout layout = gGeometryPool.Layout;
+      uint64_t numPrepassVertices =
+          gScenePassVertexInvocations[ScenePassStat::DepthPrepass];
+      guiVertexFetch("Prepass", numPrepassVertices,
+                     getVertexFetchStride(layout, true));
+      guiVertexFetch("Scene", gScenePassVertexInvocations[ScenePassStat::Scene],
+                     getVertexFetchStride(layout, false));
+      guiTextFmt("Prepass with interleaved vertices: {:.2f} MB",
+                 (double)(numPrepassVertices *
+                          getVertexFetchStride(VertexStreamLayout::Interleaved,
+                                               true)) /
+                     (1024.0 * 1024.0));
+    }
+    ImGui::End();
+
+    if (ImGui::Begin("Vertex Pulling")) {
+      ImGui::TextUnformatted("Forward and deferred");
+      VertexPullingBenchmark &benchmark = gVertexPullingBenchmark;
+      if (benchmark.IsRunning) {
+        guiTextFmt("Benchmarking {} vertices",
+                   benchmark.Step == 1 ? "pulled" : "fixed function");
+      } else {
+        ImGui::Checkbox("Pull Vertices", &gVertexPulling.IsEnabled);
+        if (ImGui::Button("Benchmark Fetch")) {
+          benchmark.IsRunning = true;
+          benchmark.Step = 0;
+          benchmark.Frame = 0;
+          benchmark.SumMs = 0;
+          benchmark.SumNumVertices = 0;
+          benchmark.WasEnabled = gVertexPulling.IsEnabled;
+          benchmark.WasPrepassEnabled = gDepthPrepass.IsEnabled;
+          gVertexPulling.IsEnabled = false;
+          gDepthPrepass.IsEnabled = false;
+          currentScene->SceneRenderPassType = RenderPassType::Deferred;
+        }
+      }
+      if (benchmark.HasResults) {
+        const char *labels[] = {"Fixed function", "Pulled"};
+        for (int i = 0; i < 2; ++i) {
+          guiTextFmt("{}: {:.3f} ms geometry, {:.3f} ns per vertex",
+                     labels[i], benchmark.ResultMs[i],
+                     benchmark.NsPerVertex[i]);
+        }
+      }
+    }
+    ImGui::End();
+
+    if (ImGui::Begin("Deferred vs Visibility")) {
+      // Geometry covers the visibility and G-buffer subpasses, lighting
+      // everything up to tone mapping, so forward shading counts as lighting.
+      guiTextFmt("Geometry: {:.3f} ms",
+                 getElapsedMs(ScenePassTimestamp::Begin,
+                              ScenePassTimestamp::Geometry, timestampPeriod));
+      guiTextFmt("Lighting: {:.3f} ms",
+                 getElapsedMs(ScenePassTimestamp::Geometry,
+                              ScenePassTimestamp::Lighting, timestampPeriod));
+
+      // Attachment traffic of one covered pixel each, ignoring overdraw and
+      // framebuffer compression.
+      double numPixels = (double)width * (double)height;
+      double depthBytes = 4.0;
+      double gbufferBytes = numGBufferAttachments * 8.0;
+      double visibilityBytes = 4.0;
+      auto guiTraffic = [&](const char *_label, double _writtenBytes,
+                            double _readBytes) {
+        guiTextFmt("{}: {:.1f} MB written, {:.1f} MB read", _label,
+                   _writtenBytes * numPixels / (1024.0 * 1024.0),
+                   _readBytes * numPixels / (1024.0 * 1024.0));
+      };
+      guiTraffic("Deferred", gbufferBytes + depthBytes, gbufferBytes);
+      // Every material pass reads the whole visibility buffer.
+      size_t numMaterialPasses = std::max<size_t>(
+          gVisibilityBuffer.Materials.size(), 1);
+      guiTraffic("Visibility", visibilityBytes + depthBytes,
+                 visibilityBytes * (double)numMaterialPasses);
+      guiTextFmt("Visibility material passes: {}",
+                 gVisibilityBuffer.Materials.size());
+    }
+    ImGui::End();
+
+    if (ImGui::Begin("Half Resolution Lighting")) {
+      ImGui::TextUnformatted("Deferred only");
+      if (!gLightingBenchmark.IsRunning) {
+        ImGui::Checkbox("Half Resolution Diffuse", &gHalfResLighting.IsEnabled);
+      }
+      ImGui::Checkbox("Measure Error", &gHalfResLighting.MeasureError);
+      if (gHalfResLighting.IsEnabled && gHalfResLighting.MeasureError) {
+        const LightingErrorStats &error = gHalfResLighting.Error;
+        guiTextFmt("RMSE: {:.3f} steps, PSNR: {:.1f} dB", error.RMSE,
+                   error.PSNR);
+        guiTextFmt("Max error: {} steps, over 2 steps: {:.3f}%",
+                   error.MaxError, error.VisibleErrorRatio * 100.f);
+      }
+
+      if (gLightingBenchmark.IsRunning) {
+        guiTextFmt("Benchmarking {} lights, {} resolution diffuse",
+                   LightingBenchmark::LightCounts[gLightingBenchmark.Step / 2],
+                   gLightingBenchmark.Step % 2 == 1 ? "half" : "full");
+      } else if (ImGui::Button("Benchmark Light Counts")) {
+        gLightingBenchmark.IsRunning = true;
+        gLightingBenchmark.Step = 0;
+        gLightingBenchmark.Frame = 0;
+        gLightingBenchmark.SumMs = 0;
+        gLightingBenchmark.WasHalfResEnabled = gHalfResLighting.IsEnabled;
+        currentScene->SceneRenderPassType = RenderPassType::Deferred;
+        gBufferVisualize.CurrentOption =
+            GBufferVisualizingOption::RenderedScene;
+      }
+      for (size_t i = 0; i < std::size(LightingBenchmark::LightCounts); ++i) {
+        const float *resultMs = gLightingBenchmark.ResultMs[i];
+        guiTextFmt("{:3} lights: full {:.3f} ms, half {:.3f} ms",
+                   LightingBenchmark::LightCounts[i], resultMs[0], resultMs[1]);
+      }
+    }
+    ImGui::End();
+
+    if (ImGui::Begin("Shadow Atlas")) {
+      ImGui::Checkbox("Enable Shadows", &gShadowAtlas.IsEnabled);
+      ImGui::SliderInt("Tile Renders per Frame",
+                       &gShadowAtlas.MaxTileRendersPerFrame, 1, 96);
+      const ShadowAtlasStats &stats = gShadowAtlas.Stats;
+      guiTextFmt("Occupancy: {:.1f}% of {}x{}", stats.Occupancy * 100.f,
+                 shadowAtlasSize, shadowAtlasSize);
+      guiTextFmt("Shadowed lights: {}", stats.NumShadowedLights);
+      guiTextFmt("Cached: {}, over budget: {}", stats.NumCachedLights,
+                 stats.NumPendingLights);
+      guiTextFmt("Static tile renders: {}",
+                 stats.NumTileRenders[ShadowCasterType::Static]);
+      guiTextFmt("Dynamic tile renders: {}",
+                 stats.NumTileRenders[ShadowCasterType::Dynamic]);
+    }
+    ImGui::End();
+
+    if (ImGui::Begin("Multiview")) {
+      if (renderer.SupportsMultiview) {
+        guiTextFmt("Multiview: up to {} views",
+                   renderer.MaxMultiviewViewCount);
+      } else {
+        ImGui::TextUnformatted("Multiview unsupported, using the fallback");
+      }
+
+      if (!gMultiviewBenchmark.IsRunning) {
+        ImGui::Checkbox("Enable Capture", &gMultiview.IsEnabled);
+        if (renderer.SupportsMultiview) {
+          const char *pathLabels[] = {"Multiview", "Layered"};
+          ImGui::Combo("Path", (int *)&gMultiview.Path, pathLabels,
+                       (int)std::size(pathLabels));
+        }
+        const char *arrangementLabels[] = {"Stereo", "Cubemap", "Orbit"};
+        ImGui::Combo("Arrangement", (int *)&gMultiview.Arrangement,
+                     arrangementLabels, (int)std::size(arrangementLabels));
+        if (gMultiview.Arrangement == MultiviewArrangement::Stereo) {
+          ImGui::SliderFloat("Eye Separation", &gMultiview.EyeSeparation, 0.f,
+                             1.f);
+        } else if (gMultiview.Arrangement == MultiviewArrangement::Orbit) {
+          ImGui::SliderInt("Views", &gMultiview.NumOrbitViews, 1,
+                           (int)maxNumMultiviews);
+          ImGui::SliderFloat("Distance", &gMultiview.OrbitDistance, 1.f,
+                             20.f);
+        }
+      }
+
+      const MultiviewStats &stats = gMultiview.Stats;
+      guiTextFmt("Culling: {:.3f} ms, recording: {:.3f} ms", stats.CullMs,
+                 stats.RecordMs);
+
+      if (gMultiviewBenchmark.IsRunning) {
+        guiTextFmt("Benchmarking {} views, {} path",
+                   gMultiviewBenchmark.Step / 2 + 1,
+                   gMultiviewBenchmark.Step % 2 == 0 ? "multiview"
+                                                     : "layered");
+      } else if (ImGui::Button("Benchmark View Counts")) {
+        gMultiviewBenchmark.IsRunning = true;
+        gMultiviewBenchmark.Step = 0;
+        gMultiviewBenchmark.Frame = 0;
+        gMultiviewBenchmark.SumMs = 0;
+        gMultiviewBenchmark.WasEnabled = gMultiview.IsEnabled;
+        gMultiviewBenchmark.SavedPath = gMultiview.Path;
+        gMultiviewBenchmark.SavedArrangement = gMultiview.Arrangement;
+        gMultiviewBenchmark.SavedNumOrbitViews = gMultiview.NumOrbitViews;
+        skipUnavailableMultiviewSteps();
+      }
+      // CPU time of culling and recording, the main view's culling included.
+      for (uint32_t i = 0; i < maxNumMultiviews; ++i) {
+        const EnumArray<MultiviewPath, float> &resultMs =
+            gMultiviewBenchmark.ResultMs[i];
+        guiTextFmt("{} views: multiview {:.3f} ms, layered {:.3f} ms", i + 1,
+                   resultMs[MultiviewPath::Multiview],
+                   resultMs[MultiviewPath::Layered]);
+      }
+      for (MultiviewPath path : {MultiviewPath::Multiview,
+                                 MultiviewPath::Layered}) {
+        float firstMs = gMultiviewBenchmark.ResultMs[0][path];
+        float lastMs = gMultiviewBenchmark.ResultMs[maxNumMultiviews - 1][path];
+        if (firstMs > 0 && lastMs > 0) {
+          guiTextFmt("{}: {:.3f} ms per additional view",
+                     path == MultiviewPath::Multiview ? "Multiview"
+                                                      : "Layered",
+                     (lastMs - firstMs) / (float)(maxNumMultiviews - 1));
+        }
+      }
+
+      if (gMultiview.IsEnabled) {
+        for (uint32_t i = 0; i < gMultiview.NumViews; ++i) {
+          if (i % 3 != 0) {
+            ImGui::SameLine();
+          }
+          ImGui::Image(gMultiviewTextureIds[i], {128, 128});
+        }
+      }
+    }
+    ImGui::End();
+
+    if (ImGui::Begin("Geometry Pool")) {
+      const char *labels[2] = {"Vertices", "Indices"};
+      const RangeAllocator *allocators[2] = {&gGeometryPool.VertexAllocator,
+                                             &gGeometryPool.IndexAllocator};
+      for (int i = 0; i < 2; ++i) {
+        RangeAllocatorStats stats = getRangeAllocatorStats(*allocators[i]);
+        guiTextFmt("{}: {} / {} ({:.1f}%)", labels[i], stats.NumAllocated,
+                   stats.Capacity,
+                   100.f * (float)stats.NumAllocated / (float)stats.Capacity);
+        guiTextFmt("  Free ranges: {}, largest: {}, fragmentation: {:.1f}%",
+                   stats.NumFreeRanges, stats.LargestFreeRange,
+                   stats.Fragmentation * 100.f);
+      }
+    }
+    ImGui::End();
+
+    if (ImGui::Begin("Descriptors")) {
+      const DescriptorAllocatorStats &stats = gDescriptorAllocator.Stats;
+      guiTextFmt("Sets: {} / {} in {} pools, {} growths", stats.NumSets,
+                 stats.NumSetsCapacity, stats.NumPools, stats.NumGrowths);
+      guiTextFmt("Cached sets: {}, hits: {}, misses: {}",
+                 gDescriptorSetCache.Sets.size(), gDescriptorSetCache.NumHits,
+                 gDescriptorSetCache.NumMisses);
+      if (ImGui::Button("Measure Churn")) {
+        gDescriptorChurnStats = measureDescriptorChurn(
+            renderer,
+            gStandardPipelineLayout
+                .DescriptorSetLayouts[DescriptorFrequency::PerMaterial],
+            4096, 64, gDescriptorSetCache);
+      }
+      const DescriptorChurnStats &churn = gDescriptorChurnStats;
+      if (churn.NumPools > 0) {
+        guiTextFmt("Allocations: {:.2f} M/s, resets: {:.0f} /s",
+                   churn.SetsPerSecond / 1e6, churn.ResetsPerSecond);
+        guiTextFmt("Cache lookups: {:.2f} M/s",
+                   churn.CacheLookupsPerSecond / 1e6);
+        guiTextFmt("Pools: {}, growths: {}", churn.NumPools,
+                   churn.NumGrowths);
+      }
+      if (ImGui::Button("Measure Updates")) {
+        gDescriptorUpdateStats = measureDescriptorUpdates(
+            renderer,
+            gStandardPipelineLayout
+                .DescriptorSetLayouts[DescriptorFrequency::PerFrame],
+            &frames[0].Descriptors, 1024, 64);
+      }
+      const DescriptorUpdateStats &updates = gDescriptorUpdateStats;
+      if (updates.NumDescriptorsPerSet > 0) {
+        guiTextFmt("Frame sets of {} descriptors:",
+                   updates.NumDescriptorsPerSet);
+        guiTextFmt("  Writes: {:.2f} M/s, template: {:.2f} M/s ({:.1f}x)",
+                   updates.WriteSetsPerSecond / 1e6,
+                   updates.TemplateSetsPerSecond / 1e6,
+                   updates.WriteSetsPerSecond > 0.0
+                       ? updates.TemplateSetsPerSecond /
+                             updates.WriteSetsPerSecond
+                       : 0.0);
+      }
+    }
+    ImGui::End();
+
+    if (ImGui::Begin("Asset Loading")) {
+      auto showLoadStats = [](const char *_label,
+                              const ImageLoadStats &_stats) {
+        guiTextFmt("{}: {} images, {:.1f} MB in {:.1f} ms, {:.0f} MB/s", _label,
+                   _stats.NumImages, (double)_stats.NumBytes / 1e6, _stats.Ms,
+                   getLoadBandwidth(_stats));
+      };
+      showLoadStats("Startup", gStartupLoadStats);
+      guiTextFmt("  Cooked: {}, compressed to {:.1f}%",
+                 gStartupLoadStats.NumCooked,
+                 100.0 * (double)gStartupLoadStats.NumCompressedBytes /
+                     (double)std::max(gStartupLoadStats.NumBytes, (uint64_t)1));
+
+      static bool verifiesDecompression = true;
+      ImGui::Checkbox("Verify GPU Decompression", &verifiesDecompression);
+      if (ImGui::Button("Measure Material Loads")) {
+        measurePBRMaterialSetLoad(renderer, transientCmdPool, materialSet,
+                                  nullptr, false, gMeasuredLoadStats[0]);
+        measurePBRMaterialSetLoad(renderer, transientCmdPool, materialSet,
+                                  &gBlockDecompressor, verifiesDecompression,
+                                  gMeasuredLoadStats[1]);
+        reportAssetLoads("material measurement");
+      }
+      if (gMeasuredLoadStats[0].NumImages > 0) {
+        showLoadStats("CPU decompression", gMeasuredLoadStats[0]);
+        showLoadStats("GPU decompression", gMeasuredLoadStats[1]);
+        guiTextFmt("GPU mismatches: {}", gMeasuredLoadStats[1].NumMismatches);
+      }
+
+      ImGui::Separator();
+      const AssetLoadReport &report = gAssetLoadReport;
+      guiTextFmt("Report \"{}\": {} loads in {:.1f} ms", report.Label,
+                 report.Loads.size(), report.Ms);
+      guiTextFmt("  Read {:.1f}, decode {:.1f}, stage {:.1f}, create {:.1f}, "
+                 "submit {:.1f} ms",
+                 report.StageMs[AssetLoadStage::Read],
+                 report.StageMs[AssetLoadStage::Decode],
+                 report.StageMs[AssetLoadStage::Stage],
+                 report.StageMs[AssetLoadStage::Create],
+                 report.StageMs[AssetLoadStage::Submit]);
+      constexpr size_t numSlowestShown = 10;
+      for (size_t i = 0;
+           i < std::min(numSlowestShown, report.Slowest.size()); ++i) {
+        const AssetLoad &load = report.Loads[report.Slowest[i]];
+        guiTextFmt("{:8.2f} ms  {:8} {}", getAssetLoadMs(load),
+                   assetTypeLabels[load.Type], load.Name);
+      }
+    }
+    ImGui::End();
+
+    static ReadbackFormat readbackFormat = ReadbackFormat::PNG;
+    static int readbackFrameRate = 60;
+    if (ImGui::Begin("Frame Readback")) {
+      if (!swapChain.CanCopyColorImages ||
+          !isReadbackFormatSupported(swapChain.ColorFormat)) {
+        ImGui::TextUnformatted("The swap chain images can't be read back");
+      } else if (!gFrameReadback.IsCapturing) {
+        const char *formatLabels[] = {"PNG", "Raw RGBA8", "Y4M"};
+        ImGui::Combo("Format", (int *)&readbackFormat, formatLabels,
+                     (int)std::size(formatLabels));
+        if (readbackFormat == ReadbackFormat::Y4M) {
+          ImGui::SliderInt("Frame Rate", &readbackFrameRate, 1, 240);
+        }
+        if (ImGui::Button("Start Capture")) {
+          beginFrameReadbackCapture(gFrameReadback, readbackFormat, "readback",
+                                    (uint32_t)readbackFrameRate);
+        }
+      } else if (ImGui::Button("Stop Capture")) {
+        endFrameReadbackCapture(gFrameReadback);
+      }
+      guiTextFmt("Written: {}, dropped: {}, late: {}",
+                 gFrameReadback.NumWritten.load(), gFrameReadback.NumDropped,
+                 gFrameReadback.NumLate.load());
+      guiTextFmt("Encoding: {:.2f} ms", gFrameReadback.LastEncodeMs.load());
+    }
+    ImGui::End();
+
+    if (ImGui::Begin("Latency")) {
+      ImGui::TextUnformatted(gLatencyTracker.UsesDisplayTiming
+                                 ? "Present times: display timing"
+                                 : "Present times: estimated");
+      LatencyStats stats = getLatencyStats(gLatencyTracker);
+      guiTextFmt("Input to present over {} frames", stats.NumSamples);
+      guiTextFmt("  mean {:.2f} ms, max {:.2f} ms", stats.MeanMs, stats.MaxMs);
+      guiTextFmt("  p50 {:.2f} ms, p95 {:.2f} ms, p99 {:.2f} ms", stats.P50Ms,
+                 stats.P95Ms, stats.P99Ms);
+      // Each stage lasts until the next one begins.
+      guiTextFmt("  queued {:.2f}, update {:.2f}, record {:.2f}, "
+                 "present {:.2f} ms",
+                 stats.StageMs[LatencyStage::Input],
+                 stats.StageMs[LatencyStage::Update],
+                 stats.StageMs[LatencyStage::Record],
+                 stats.StageMs[LatencyStage::Submit]);
+      getLatencyHistory(gLatencyTracker, latencyHistory);
+      ImGui::PlotLines("History", latencyHistory.data(),
+                       (int)latencyHistory.size(), 0, nullptr, 0.f,
+                       std::numeric_limits<float>::max(),
+                       ImVec2(0, 60));
+
+      if (gLatencyTracker.IsMeasuring) {
+        guiTextFmt("Measuring... {} / {}", gLatencyTracker.MeasuredMs.size(),
+                   gLatencyTracker.MeasureNumSamples);
+      } else if (ImGui::Button("Measure")) {
+        beginLatencyMeasurement(gLatencyTracker);
+      }
+      if (gLatencyTracker.HasMeasured) {
+        const LatencyStats &measured = gLatencyTracker.MeasuredStats;
+        guiTextFmt("Measured: p50 {:.2f} ms, p95 {:.2f} ms, p99 {:.2f} ms",
+                   measured.P50Ms, measured.P95Ms, measured.P99Ms);
+      }
+    }
+    ImGui::End();
+
     currentScene->updateGUI(dt);
+    currentScene->takeCameraPreset(cam);
 
     SDL_GetWindowSize(window, &width, &height);
 
@@ -1263,6 +2416,7 @@ int main(int _argc, char **_argv) {
 
     Frame &currentFrame = frames[currentFrameIndex];
     const FrameSync &frameSyncObject = frameSyncObjects[currentFrameIndex];
+    uint32_t submittedFrameIndex = currentFrameIndex;
 
     VkResult acquireNextImageResult =
         vkAcquireNextImageKHR(renderer.Device, swapChain.Handle, UINT64_MAX,
@@ -1276,7 +2430,34 @@ int main(int _argc, char **_argv) {
 
     vkWaitForFences(renderer.Device, 1, &frameSyncObject.FrameAvailableFence,
                     VK_TRUE, UINT64_MAX);
+    updateLatencyTracker(gLatencyTracker, renderer, swapChain,
+                         frameSyncObjects);
     vkResetFences(renderer.Device, 1, &frameSyncObject.FrameAvailableFence);
+    collectFrameReadbacks(gFrameReadback, currentFrameIndex);
+
+    if (currentFrame.ScenePassStatsQueryPool != VK_NULL_HANDLE &&
+        isFrameSubmitted[currentFrameIndex]) {
+      vkGetQueryPoolResults(
+          renderer.Device, currentFrame.ScenePassStatsQueryPool, 0,
+          EnumCount<ScenePassStat>, sizeof(gScenePassVertexInvocations),
+          gScenePassVertexInvocations.data(), sizeof(uint64_t),
+          VK_QUERY_RESULT_64_BIT);
+    }
+    if (currentFrame.ScenePassTimestampQueryPool != VK_NULL_HANDLE &&
+        isFrameSubmitted[currentFrameIndex]) {
+      vkGetQueryPoolResults(
+          renderer.Device, currentFrame.ScenePassTimestampQueryPool, 0,
+          EnumCount<ScenePassTimestamp>, sizeof(gScenePassTimestamps),
+          gScenePassTimestamps.data(), sizeof(uint64_t),
+          VK_QUERY_RESULT_64_BIT);
+    }
+    if (isFrameSubmitted[currentFrameIndex]) {
+      LightingErrorStats error = readLightingError(renderer, currentFrame);
+      if (error.NumPixels > 0) {
+        gHalfResLighting.Error = error;
+      }
+    }
+    isFrameSubmitted[currentFrameIndex] = true;
 
     VkFramebuffer currentDeferredFramebuffer =
         deferredFramebuffers[currentSwapChainImageIndex];
@@ -1284,14 +2465,41 @@ int main(int _argc, char **_argv) {
     currentFrameIndex = (currentFrameIndex + 1) % (uint32_t)frames.size();
 
     currentScene->updateScene(dt);
+    currentScene->onGeometryPassTimed(getElapsedMs(
+        ScenePassTimestamp::Begin, ScenePassTimestamp::Geometry,
+        timestampPeriod));
+    if (gVertexPullingBenchmark.IsRunning) {
+      updateVertexPullingBenchmark(
+          getElapsedMs(ScenePassTimestamp::Begin,
+                       ScenePassTimestamp::Geometry, timestampPeriod),
+          gScenePassVertexInvocations[ScenePassStat::Scene]);
+    }
 
     FrameUniformBlock frameUniformBlock = {};
     BB_ASSERT(currentScene->Lights.size() <
               std::size(frameUniformBlock.Lights));
-    frameUniformBlock.NumLights = currentScene->Lights.size();
+    int numLights = (int)currentScene->Lights.size();
+    if (gLightingBenchmark.IsRunning) {
+      numLights = updateLightingBenchmark(
+          getElapsedMs(ScenePassTimestamp::Geometry,
+                       ScenePassTimestamp::Lighting, timestampPeriod));
+    }
+    frameUniformBlock.NumLights = numLights;
     gLightSources.NumLights = frameUniformBlock.NumLights;
+    int numSceneLights = std::min(numLights, (int)currentScene->Lights.size());
     memcpy(frameUniformBlock.Lights, currentScene->Lights.data(),
-           sizeBytes32(currentScene->Lights));
+           sizeof(Light) * numSceneLights);
+    // Benchmark lights on a spiral above the scene
+    for (int i = numSceneLights; i < numLights; ++i) {
+      Light &light = frameUniformBlock.Lights[i];
+      float angle = (float)i * 2.4f;
+      float radius = 1.f + 0.15f * (float)i;
+      light = {};
+      light.Pos = {radius * std::cos(angle), 2, radius * std::sin(angle)};
+      light.Type = LightType::Point;
+      light.Color = {1, 1, 1};
+      light.Intensity = 10;
+    }
 
     if (gBufferVisualize.CurrentOption !=
         GBufferVisualizingOption::RenderedScene) {
@@ -1312,11 +2520,20 @@ int main(int _argc, char **_argv) {
       if (enableToneMapping) {
         ImGui::SliderFloat("Exposure", &exposure, 0.1f, 10.f);
       }
+      if (isFrameCaptureEnabled() && ImGui::Button("Capture Frame")) {
+        captureNextFrame = true;
+      }
     }
     ImGui::End();
 
     frameUniformBlock.EnableToneMapping = enableToneMapping;
     frameUniformBlock.Exposure = exposure;
+    frameUniformBlock.EnableHalfResDiffuse = gHalfResLighting.IsEnabled;
+    // Measuring computes full resolution diffuse too, so not while timing.
+    frameUniformBlock.MeasureLightingError = gHalfResLighting.IsEnabled &&
+                                             gHalfResLighting.MeasureError &&
+                                             !gLightingBenchmark.IsRunning;
+    frameUniformBlock.EnableShadows = gShadowAtlas.IsEnabled;
 
     {
       void *data;
@@ -1333,6 +2550,99 @@ int main(int _argc, char **_argv) {
     viewUniformBlock.ViewPos = cam.Pos;
     viewUniformBlock.EnableNormalMap = enableNormalMap;
 
+    if (shouldPick) {
+      currentScene->pickObject(
+          createPickRay(viewUniformBlock, pickPos, width, height));
+      shouldPick = false;
+    }
+
+    if (gMultiviewBenchmark.IsRunning) {
+      updateMultiviewBenchmark(gMultiview.Stats.CullMs +
+                               gMultiview.Stats.RecordMs);
+    }
+
+    // The capture's views are culled together with the main view, so each
+    // draw is only tested and drawn once for all of them.
+    ViewUniformBlock views[1 + maxNumMultiviews];
+    views[0] = viewUniformBlock;
+    uint32_t numViews = 1;
+    MultiviewUniformBlock multiviewUniformBlock = {};
+    if (gMultiview.IsEnabled) {
+      updateMultiviewViews(gMultiview, viewUniformBlock,
+                           multiviewUniformBlock);
+      for (uint32_t i = 0; i < gMultiview.NumViews; ++i) {
+        views[numViews++] = gMultiview.Views[i];
+      }
+    }
+
+    {
+      Time cullStartTime = getCurrentTime();
+      currentScene->cullScene(views, numViews, submittedFrameIndex);
+      gMultiview.Stats.CullMs =
+          getElapsedTimeInSeconds(cullStartTime, getCurrentTime()) * 1000.f;
+    }
+
+    if (gShadowAtlas.IsEnabled) {
+      void *data;
+      vkMapMemory(renderer.Device, currentFrame.ShadowBuffer.Memory, 0,
+                  currentFrame.ShadowBuffer.Size, 0, &data);
+      updateShadowAtlas(gShadowAtlas, frameUniformBlock.Lights,
+                        (uint32_t)numLights, viewUniformBlock,
+                        currentScene->ShadowCasterVersions,
+                        (ShadowLightBlock *)data);
+      vkUnmapMemory(renderer.Device, currentFrame.ShadowBuffer.Memory);
+    }
+
+    gVisibilityBuffer.Materials.clear();
+    VkBuffer sceneIndexBuffer = gGeometryPool.IndexBuffer.Handle;
+    if (currentScene->SceneRenderPassType == RenderPassType::Visibility) {
+      visibilityDraws.clear();
+      currentScene->getVisibilityDraws(visibilityDraws, sceneIndexBuffer);
+      // Neither the ids of further draws fit in a visibility texel, nor their
+      // records in VisibilityDrawBuffer.
+      if (visibilityDraws.size() > maxNumVisibilityDraws) {
+        BB_LOG_WARNING("{} visibility draws, the most is {}. Falling back to "
+                       "the deferred pass.",
+                       visibilityDraws.size(), maxNumVisibilityDraws);
+        currentScene->SceneRenderPassType = RenderPassType::Deferred;
+      }
+    }
+    if (currentScene->SceneRenderPassType == RenderPassType::Visibility) {
+      void *data;
+      vkMapMemory(renderer.Device, currentFrame.VisibilityDrawBuffer.Memory, 0,
+                  sizeBytes32(visibilityDraws), 0, &data);
+      memcpy(data, visibilityDraws.data(), sizeBytes32(visibilityDraws));
+      vkUnmapMemory(renderer.Device, currentFrame.VisibilityDrawBuffer.Memory);
+
+      for (const VisibilityDraw &draw : visibilityDraws) {
+        gVisibilityBuffer.Materials.push_back(draw.Material);
+      }
+      std::sort(gVisibilityBuffer.Materials.begin(),
+                gVisibilityBuffer.Materials.end());
+      gVisibilityBuffer.Materials.erase(
+          std::unique(gVisibilityBuffer.Materials.begin(),
+                      gVisibilityBuffer.Materials.end()),
+          gVisibilityBuffer.Materials.end());
+
+      // The culled index buffer changes between frames.
+      linkVisibilityStorageBuffers(currentFrame,
+                                   {gGeometryPool.PositionBuffer.Handle,
+                                    gGeometryPool.VertexBuffer.Handle,
+                                    gGeometryPool.IndexBuffer.Handle,
+                                    sceneIndexBuffer});
+    }
+
+    // Scenes without a lightmap never sample it, but the binding must stay
+    // valid.
+    {
+      VkImageView lightmap = gScenes[gCurrentSceneType]->getLightmap();
+      if (lightmap == VK_NULL_HANDLE) {
+        lightmap = materialSet.DefaultMaterial.Maps[PBRMapType::Albedo].View;
+      }
+      linkLightmap(currentFrame, lightmap);
+    }
+    updateFrameDescriptorSet(renderer, gStandardPipelineLayout, currentFrame);
+
     {
       void *data;
       vkMapMemory(renderer.Device, currentFrame.ViewUniformBuffer.Memory, 0,
@@ -1341,13 +2651,36 @@ int main(int _argc, char **_argv) {
       vkUnmapMemory(renderer.Device, currentFrame.ViewUniformBuffer.Memory);
     }
 
+    if (gMultiview.IsEnabled) {
+      void *data;
+      vkMapMemory(renderer.Device, currentFrame.MultiviewUniformBuffer.Memory,
+                  0, sizeof(MultiviewUniformBlock), 0, &data);
+      memcpy(data, &multiviewUniformBlock, sizeof(MultiviewUniformBlock));
+      vkUnmapMemory(renderer.Device,
+                    currentFrame.MultiviewUniformBuffer.Memory);
+    }
+
     vkResetCommandPool(renderer.Device, currentFrame.CmdPool,
                        VK_COMMAND_POOL_RESET_RELEASE_RESOURCES_BIT);
 
     ImGui::Render();
+    markLatencyStage(gLatencyTracker, LatencyStage::Record);
+    if (captureNextFrame) {
+      beginFrameCapture(currentFrame.CmdBuffer);
+    }
+    bool pullsVertices = gVertexPulling.IsEnabled;
     recordCommand(deferredRenderPass.Handle, currentDeferredFramebuffer,
-                  forwardPipeline, gBufferPipeline, brdfPipeline,
-                  hdrToneMappingPipeline, swapChain.Extent, currentFrame);
+                  pullsVertices ? gVertexPulling.ForwardPipeline
+                                : forwardPipeline,
+                  pullsVertices ? gVertexPulling.GBufferPipeline
+                                : gBufferPipeline,
+                  brdfPipeline, hdrToneMappingPipeline, swapChain.Extent,
+                  swapChain.ColorImages[currentSwapChainImageIndex],
+                  swapChain.ColorFormat, currentFrame);
+    if (captureNextFrame) {
+      endFrameCapture(fmt::format("frame{}.capture", numCapturedFrames++));
+      captureNextFrame = false;
+    }
 
     VkSubmitInfo submitInfo = {};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -1363,6 +2696,7 @@ int main(int _argc, char **_argv) {
 
     BB_VK_ASSERT(vkQueueSubmit(renderer.Queue, 1, &submitInfo,
                                frameSyncObject.FrameAvailableFence));
+    submitLatencyFrame(gLatencyTracker, submittedFrameIndex);
 
     VkPresentInfoKHR presentInfo = {};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -1371,6 +2705,10 @@ int main(int _argc, char **_argv) {
     presentInfo.swapchainCount = 1;
     presentInfo.pSwapchains = &swapChain.Handle;
     presentInfo.pImageIndices = &currentSwapChainImageIndex;
+    VkPresentTimesInfoGOOGLE presentTimesInfo;
+    VkPresentTimeGOOGLE presentTime;
+    setLatencyPresentInfo(gLatencyTracker, presentInfo, presentTimesInfo,
+                          presentTime);
 
     VkResult queuePresentResult =
         vkQueuePresentKHR(renderer.Queue, &presentInfo);
@@ -1381,12 +2719,15 @@ int main(int _argc, char **_argv) {
   }
 
   vkDeviceWaitIdle(renderer.Device);
+  destroyFrameReadback(gFrameReadback);
 
   for (SceneBase *&scene : gScenes) {
     delete scene;
     scene = nullptr;
   }
 
+  destroyGeometryPool(renderer, gGeometryPool);
+
   ImGui_ImplVulkan_Shutdown();
   ImGui_ImplSDL2_Shutdown();
   ImGui::DestroyContext();
@@ -1404,8 +2745,11 @@ int main(int _argc, char **_argv) {
   for (Frame &frame : frames) {
     destroyFrame(renderer, frame);
   }
+  destroyShadowAtlas(renderer, gShadowAtlas);
+  destroyMultiviewCapture(renderer, gMultiview);
 
-  vkDestroyDescriptorPool(renderer.Device, standardDescriptorPool, nullptr);
+  clearDescriptorSetCache(gDescriptorSetCache);
+  destroyDescriptorAllocator(renderer, gDescriptorAllocator);
   vkDestroyDescriptorPool(renderer.Device, imguiDescriptorPool, nullptr);
 
   destroyBuffer(renderer, gLightSources.InstanceBuffer);
@@ -1416,12 +2760,21 @@ int main(int _argc, char **_argv) {
 
   cleanupReloadableResources();
 
+  destroyImpostorBaker(renderer, gImpostorPass.Baker);
   destroyStandardPipelineLayout(renderer, gStandardPipelineLayout);
 
   destroyPBRMaterialSet(renderer, materialSet);
+  destroyBlockDecompressor(renderer, gBlockDecompressor);
 
   vkDestroyCommandPool(renderer.Device, transientCmdPool, nullptr);
 
+  destroyShader(renderer, gDepthPrepass.VertShader);
+  destroyShader(renderer, gImpostorPass.VertShader);
+  destroyShader(renderer, gImpostorPass.FragShader);
+  destroyShader(renderer, gVisibilityBuffer.WriteVertShader);
+  destroyShader(renderer, gVisibilityBuffer.WriteFragShader);
+  destroyShader(renderer, gVisibilityBuffer.ResolveVertShader);
+  destroyShader(renderer, gVisibilityBuffer.ResolveFragShader);
   destroyShader(renderer, gLightSources.VertShader);
   destroyShader(renderer, gLightSources.FragShader);
   destroyShader(renderer, gGizmo.VertShader);
@@ -1430,19 +2783,26 @@ int main(int _argc, char **_argv) {
   destroyShader(renderer, hdrToneMappingVertShader);
   destroyShader(renderer, brdfVertShader);
   destroyShader(renderer, brdfFragShader);
+  destroyShader(renderer, gHalfResLighting.DiffuseFragShader);
   destroyShader(renderer, gBufferVertShader);
   destroyShader(renderer, gBufferFragShader);
   destroyShader(renderer, forwardBrdfVertShader);
   destroyShader(renderer, forwardBrdfFragShader);
+  destroyShader(renderer, gVertexPulling.ForwardVertShader);
+  destroyShader(renderer, gVertexPulling.GBufferVertShader);
   destroyShader(renderer, gBufferVisualize.VertShader);
   destroyShader(renderer, gBufferVisualize.FragShader);
   destroyShader(renderer, gTBN.VertShader);
   destroyShader(renderer, gTBN.GeomShader);
   destroyShader(renderer, gTBN.FragShader);
+  destroyFrameCapture();
+  destroyAsyncContext(gAsync);
   destroyRenderer(renderer);
 
   SDL_DestroyWindow(window);
   SDL_Quit();
 
+  destroyJobSystem(gJobSystem);
+
   return 0;
 }
\ No newline at end of file
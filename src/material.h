@@ -0,0 +1,17 @@
+#pragma once
+
+namespace bb {
+
+// Maps of a PBR material, free of Vulkan so that models can be imported
+// without a renderer. See PBRMaterial in render.h for the maps themselves.
+enum class PBRMapType {
+  Albedo,
+  Metallic,
+  Roughness,
+  AO,
+  Normal,
+  Height,
+  COUNT
+};
+
+} // namespace bb
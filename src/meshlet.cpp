@@ -0,0 +1,126 @@
+#include "meshlet.h"
+#include <algorithm>
+#include <math.h>
+
+namespace bb {
+
+static void finishMeshlet(const Vertex *_vertices, const uint32_t *_indices,
+                          const std::vector<uint32_t> &_meshletVertices,
+                          Meshlet &_meshlet) {
+  _meshlet.NumVertices = (uint32_t)_meshletVertices.size();
+
+  AABB bounds;
+  for (uint32_t v : _meshletVertices) {
+    bounds.extend(_vertices[v].Pos);
+  }
+  _meshlet.Center = bounds.center();
+  _meshlet.Radius = 0.f;
+  for (uint32_t v : _meshletVertices) {
+    _meshlet.Radius = std::max(_meshlet.Radius,
+                               (_vertices[v].Pos - _meshlet.Center).length());
+  }
+
+  // Face normals are taken from the winding, but flipped to agree with the
+  // vertex normals so that the cone matches what back-face culling sees.
+  std::vector<Float3> faceNormals;
+  faceNormals.reserve(_meshlet.NumTriangles);
+  Float3 normalSum;
+  const uint32_t *triangle = _indices + _meshlet.FirstIndex;
+  for (uint32_t i = 0; i < _meshlet.NumTriangles; ++i, triangle += 3) {
+    const Vertex &a = _vertices[triangle[0]];
+    const Vertex &b = _vertices[triangle[1]];
+    const Vertex &c = _vertices[triangle[2]];
+    Float3 normal = cross(b.Pos - a.Pos, c.Pos - a.Pos);
+    float length = normal.length();
+    if (!(length > 0.f)) {
+      continue;
+    }
+    normal = normal / length;
+    if (dot(normal, a.Normal + b.Normal + c.Normal) < 0.f) {
+      normal = normal * -1.f;
+    }
+    faceNormals.push_back(normal);
+    normalSum += normal;
+  }
+
+  _meshlet.ConeAxis = {0, 0, 1};
+  _meshlet.ConeCutoff = 1.f;
+  float axisLength = normalSum.length();
+  if (faceNormals.empty() || !(axisLength > 0.f)) {
+    return;
+  }
+
+  Float3 axis = normalSum / axisLength;
+  float minDot = 1.f;
+  for (const Float3 &normal : faceNormals) {
+    minDot = std::min(minDot, dot(axis, normal));
+  }
+  _meshlet.ConeAxis = axis;
+  if (minDot > 0.f) {
+    _meshlet.ConeCutoff = sqrtf(1.f - minDot * minDot);
+  }
+}
+
+void buildMeshlets(const Vertex *_vertices, const uint32_t *_indices,
+                   uint32_t _firstIndex, uint32_t _numIndices,
+                   std::vector<Meshlet> &_meshlets) {
+  BB_ASSERT(_numIndices % 3 == 0);
+  if (_numIndices == 0) {
+    return;
+  }
+
+  uint32_t maxVertex = 0;
+  for (uint32_t i = _firstIndex; i < _firstIndex + _numIndices; ++i) {
+    maxVertex = std::max(maxVertex, _indices[i]);
+  }
+
+  // Which meshlet last referenced each vertex, to count unique vertices
+  // without clearing a set for every meshlet.
+  std::vector<uint32_t> vertexOwner(maxVertex + 1, UINT32_MAX);
+  std::vector<uint32_t> meshletVertices;
+  meshletVertices.reserve(meshletMaxVertices);
+
+  uint32_t meshletIndex = (uint32_t)_meshlets.size();
+  Meshlet meshlet = {};
+  meshlet.FirstIndex = _firstIndex;
+
+  for (uint32_t i = _firstIndex; i < _firstIndex + _numIndices; i += 3) {
+    const uint32_t *triangle = _indices + i;
+    uint32_t numNewVertices = 0;
+    for (int k = 0; k < 3; ++k) {
+      if (vertexOwner[triangle[k]] != meshletIndex) {
+        ++numNewVertices;
+      }
+    }
+
+    if (meshletVertices.size() + numNewVertices > meshletMaxVertices ||
+        meshlet.NumTriangles == meshletMaxTriangles) {
+      finishMeshlet(_vertices, _indices, meshletVertices, meshlet);
+      _meshlets.push_back(meshlet);
+
+      ++meshletIndex;
+      meshletVertices.clear();
+      meshlet = {};
+      meshlet.FirstIndex = i;
+    }
+
+    for (int k = 0; k < 3; ++k) {
+      if (vertexOwner[triangle[k]] != meshletIndex) {
+        vertexOwner[triangle[k]] = meshletIndex;
+        meshletVertices.push_back(triangle[k]);
+      }
+    }
+    ++meshlet.NumTriangles;
+  }
+
+  finishMeshlet(_vertices, _indices, meshletVertices, meshlet);
+  _meshlets.push_back(meshlet);
+}
+
+bool isMeshletBackFacing(const Meshlet &_meshlet, const Float3 &_viewPos) {
+  Float3 toCenter = _meshlet.Center - _viewPos;
+  return dot(toCenter, _meshlet.ConeAxis) >=
+         _meshlet.ConeCutoff * toCenter.length() + _meshlet.Radius;
+}
+
+} // namespace bb
@@ -0,0 +1,39 @@
+#pragma once
+#include "vertex.h"
+#include <vector>
+
+namespace bb {
+
+constexpr uint32_t meshletMaxVertices = 64;
+constexpr uint32_t meshletMaxTriangles = 124;
+
+// A run of consecutive triangles of a mesh touching at most
+// meshletMaxVertices unique vertices. Bounds are in mesh space.
+struct Meshlet {
+  // Into the index list the meshlet was built from.
+  uint32_t FirstIndex;
+  uint32_t NumTriangles;
+  uint32_t NumVertices;
+
+  Float3 Center;
+  float Radius;
+
+  // Average facing of the triangles. ConeCutoff is the sine of the angle
+  // between ConeAxis and the widest triangle normal, or 1 if the normals are
+  // too spread out for the meshlet to ever be entirely back-facing.
+  Float3 ConeAxis;
+  float ConeCutoff;
+};
+
+// Splits the triangles in _indices[_firstIndex, _firstIndex + _numIndices)
+// into meshlets, in order, and appends them to _meshlets. Indices are
+// relative to _vertices.
+void buildMeshlets(const Vertex *_vertices, const uint32_t *_indices,
+                   uint32_t _firstIndex, uint32_t _numIndices,
+                   std::vector<Meshlet> &_meshlets);
+
+// True if every triangle of the meshlet faces away from _viewPos, which must
+// be in the same space as the meshlet.
+bool isMeshletBackFacing(const Meshlet &_meshlet, const Float3 &_viewPos);
+
+} // namespace bb
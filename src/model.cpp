@@ -0,0 +1,209 @@
+#include "model.h"
+#include "model_convert.h"
+#include "path.h"
+#include "resource_root.h"
+#include "asset_report.h"
+#include "util.h"
+#include "external/assimp/Importer.hpp"
+#include "external/assimp/scene.h"
+#include "external/assimp/postprocess.h"
+#include <math.h>
+
+namespace bb {
+
+static void collectParts(const aiNode *_node, const Mat4 &_parentTransform,
+                         Model &_model) {
+  Mat4 transform =
+      _parentTransform * aiMatrix4x4ToMat4(_node->mTransformation);
+
+  for (unsigned int i = 0; i < _node->mNumMeshes; ++i) {
+    uint32_t subMeshIndex = _node->mMeshes[i];
+    const SubMesh &subMesh = _model.SubMeshes[subMeshIndex];
+    if (subMesh.NumIndices == 0) {
+      continue;
+    }
+
+    ModelPart part = {};
+    part.SubMeshIndex = subMeshIndex;
+    part.Transform = transform;
+    _model.Parts.push_back(part);
+    _model.Bounds.extend(transformAABB(transform, subMesh.Bounds));
+  }
+
+  for (unsigned int i = 0; i < _node->mNumChildren; ++i) {
+    collectParts(_node->mChildren[i], transform, _model);
+  }
+}
+
+static void importMaterial(const aiMaterial *_material,
+                           ModelMaterial &_dstMaterial) {
+  aiString name;
+  if (_material->Get(AI_MATKEY_NAME, name) == aiReturn_SUCCESS) {
+    _dstMaterial.Name = name.C_Str();
+  }
+
+  aiColor3D diffuse;
+  if (_material->Get(AI_MATKEY_COLOR_DIFFUSE, diffuse) == aiReturn_SUCCESS) {
+    _dstMaterial.BaseColor = {diffuse.r, diffuse.g, diffuse.b};
+  }
+
+  // The first texture type found wins. PBR types come first since exporters
+  // often fill the legacy slots as well.
+  EnumArray<PBRMapType, std::vector<aiTextureType>> textureTypes = {{
+      {aiTextureType_BASE_COLOR, aiTextureType_DIFFUSE},
+      {aiTextureType_METALNESS},
+      {aiTextureType_DIFFUSE_ROUGHNESS},
+      {aiTextureType_AMBIENT_OCCLUSION, aiTextureType_LIGHTMAP},
+      {aiTextureType_NORMAL_CAMERA, aiTextureType_NORMALS},
+      {aiTextureType_HEIGHT, aiTextureType_DISPLACEMENT},
+  }};
+
+  for (PBRMapType mapType : AllEnums<PBRMapType>) {
+    for (aiTextureType textureType : textureTypes[mapType]) {
+      aiString path;
+      if (_material->GetTexture(textureType, 0, &path) == aiReturn_SUCCESS) {
+        _dstMaterial.MapPaths[mapType] = path.C_Str();
+        break;
+      }
+    }
+  }
+}
+
+Model importModel(JobSystem &_jobSystem, const std::string &_filePath) {
+  Model model = {};
+
+  [[maybe_unused]] Time startTime = getCurrentTime();
+  AssetLoad load = beginAssetLoad(AssetType::Mesh, getAssetName(_filePath));
+  BB_DEFER(endAssetLoad(load));
+
+  // Read apart from parsing, so that the two are reported separately.
+  std::vector<uint8_t> contents;
+  if (!readFile(_filePath, contents)) {
+    BB_LOG_ERROR("Failed to read {}", _filePath);
+    return model;
+  }
+  load.NumBytesRead = contents.size();
+  markAssetLoadStage(load, AssetLoadStage::Read);
+
+  size_t extensionPos = _filePath.rfind('.');
+  std::string extension = extensionPos != std::string::npos
+                              ? _filePath.substr(extensionPos + 1)
+                              : std::string();
+  Assimp::Importer importer;
+  const aiScene *scene = importer.ReadFileFromMemory(
+      contents.data(), contents.size(),
+      aiProcess_Triangulate | aiProcess_CalcTangentSpace |
+          aiProcess_JoinIdenticalVertices | aiProcess_SortByPType |
+          aiProcess_GenSmoothNormals,
+      extension.c_str());
+  if (!scene || !scene->mRootNode) {
+    BB_LOG_ERROR("Failed to import {}: {}", _filePath,
+                 importer.GetErrorString());
+    return model;
+  }
+
+  [[maybe_unused]] Time parseEndTime = getCurrentTime();
+
+  // Reserve a range in the shared vertex/index arrays for every mesh up
+  // front, so that workers can write their results in place.
+  model.SubMeshes.resize(scene->mNumMeshes);
+  std::vector<ModelImportChunk> chunks;
+  uint32_t numVertices = 0;
+  uint32_t numIndices = 0;
+  for (unsigned int meshIndex = 0; meshIndex < scene->mNumMeshes;
+       ++meshIndex) {
+    const aiMesh *mesh = scene->mMeshes[meshIndex];
+    SubMesh &subMesh = model.SubMeshes[meshIndex];
+    subMesh.FirstIndex = numIndices;
+    subMesh.VertexOffset = (int32_t)numVertices;
+    subMesh.MaterialIndex = mesh->mMaterialIndex;
+
+    // Points and lines are split off by aiProcess_SortByPType; skip them.
+    if (mesh->mPrimitiveTypes != aiPrimitiveType_TRIANGLE) {
+      continue;
+    }
+
+    subMesh.NumVertices = mesh->mNumVertices;
+    subMesh.NumIndices = mesh->mNumFaces * 3;
+    numVertices += subMesh.NumVertices;
+    numIndices += subMesh.NumIndices;
+
+    uint32_t numElements = std::max(mesh->mNumVertices, mesh->mNumFaces);
+    uint32_t numChunks =
+        (numElements + modelImportChunkSize - 1) / modelImportChunkSize;
+    for (uint32_t i = 0; i < numChunks; ++i) {
+      ModelImportChunk chunk = {};
+      chunk.MeshIndex = meshIndex;
+      chunk.FirstVertex =
+          (uint32_t)((uint64_t)mesh->mNumVertices * i / numChunks);
+      chunk.NumVertices =
+          (uint32_t)((uint64_t)mesh->mNumVertices * (i + 1) / numChunks) -
+          chunk.FirstVertex;
+      chunk.FirstFace = (uint32_t)((uint64_t)mesh->mNumFaces * i / numChunks);
+      chunk.NumFaces =
+          (uint32_t)((uint64_t)mesh->mNumFaces * (i + 1) / numChunks) -
+          chunk.FirstFace;
+      chunks.push_back(chunk);
+    }
+  }
+
+  model.Vertices.resize(numVertices);
+  model.Indices.resize(numIndices);
+
+  parallelFor(_jobSystem, (int)chunks.size(), 1, [&](int _chunkIndex) {
+    ModelImportChunk &chunk = chunks[_chunkIndex];
+    const SubMesh &subMesh = model.SubMeshes[chunk.MeshIndex];
+    convertModelChunk(*scene->mMeshes[chunk.MeshIndex],
+                      model.Vertices.data() + subMesh.VertexOffset,
+                      model.Indices.data() + subMesh.FirstIndex, chunk);
+  });
+
+  model.NumRepairedTangents = 0;
+  for (const ModelImportChunk &chunk : chunks) {
+    model.SubMeshes[chunk.MeshIndex].Bounds.extend(chunk.Bounds);
+    model.NumRepairedTangents += chunk.NumRepairedTangents;
+  }
+
+  std::vector<std::vector<Meshlet>> subMeshMeshlets(model.SubMeshes.size());
+  parallelFor(_jobSystem, (int)model.SubMeshes.size(), 1, [&](int _index) {
+    const SubMesh &subMesh = model.SubMeshes[_index];
+    buildMeshlets(model.Vertices.data() + subMesh.VertexOffset,
+                  model.Indices.data(), subMesh.FirstIndex, subMesh.NumIndices,
+                  subMeshMeshlets[_index]);
+  });
+  for (size_t i = 0; i < model.SubMeshes.size(); ++i) {
+    SubMesh &subMesh = model.SubMeshes[i];
+    subMesh.FirstMeshlet = (uint32_t)model.Meshlets.size();
+    subMesh.NumMeshlets = (uint32_t)subMeshMeshlets[i].size();
+    model.Meshlets.insert(model.Meshlets.end(), subMeshMeshlets[i].begin(),
+                          subMeshMeshlets[i].end());
+  }
+
+  model.Materials.resize(scene->mNumMaterials);
+  for (unsigned int i = 0; i < scene->mNumMaterials; ++i) {
+    importMaterial(scene->mMaterials[i], model.Materials[i]);
+  }
+
+  collectParts(scene->mRootNode, Mat4::identity(), model);
+
+  [[maybe_unused]] Time endTime = getCurrentTime();
+  load.NumDecodedBytes =
+      (uint64_t)sizeBytes32(model.Vertices) + sizeBytes32(model.Indices);
+  markAssetLoadStage(load, AssetLoadStage::Decode);
+
+  BB_LOG_INFO("Imported {} ({} meshes, {} parts, {} materials, {} vertices, {} "
+              "triangles, {} meshlets, {} repaired tangents) in {:.2f} ms: "
+              "parse {:.2f} ms, convert {:.2f} ms on {} threads",
+              getFileName(_filePath), model.SubMeshes.size(),
+              model.Parts.size(), model.Materials.size(),
+              model.Vertices.size(), model.Indices.size() / 3,
+              model.Meshlets.size(), model.NumRepairedTangents,
+              getElapsedTimeInSeconds(startTime, endTime) * 1000.f,
+              getElapsedTimeInSeconds(startTime, parseEndTime) * 1000.f,
+              getElapsedTimeInSeconds(parseEndTime, endTime) * 1000.f,
+              getNumJobThreads(_jobSystem));
+
+  return model;
+}
+
+} // namespace bb
\ No newline at end of file
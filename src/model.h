@@ -0,0 +1,57 @@
+#pragma once
+#include "enum_array.h"
+#include "material.h"
+#include "vertex.h"
+#include "job.h"
+#include "meshlet.h"
+#include <string>
+#include <vector>
+
+namespace bb {
+
+// A contiguous range in Model::Indices. Indices are relative to VertexOffset,
+// so a submesh can be drawn with vkCmdDrawIndexed(NumIndices, ..., FirstIndex,
+// VertexOffset, ...) against buffers holding the whole model.
+struct SubMesh {
+  uint32_t FirstIndex;
+  uint32_t NumIndices;
+  int32_t VertexOffset;
+  uint32_t NumVertices;
+  uint32_t MaterialIndex;
+  AABB Bounds;
+  // Range in Model::Meshlets covering every triangle of the submesh.
+  uint32_t FirstMeshlet;
+  uint32_t NumMeshlets;
+};
+
+// One placement of a submesh in the node hierarchy. A submesh referenced by
+// several nodes gets several parts.
+struct ModelPart {
+  uint32_t SubMeshIndex;
+  Mat4 Transform;
+};
+
+struct ModelMaterial {
+  std::string Name;
+  Float3 BaseColor = {1, 1, 1};
+  // Paths as written in the source file. Empty if the map isn't assigned.
+  EnumArray<PBRMapType, std::string> MapPaths;
+};
+
+struct Model {
+  std::vector<Vertex> Vertices;
+  std::vector<uint32_t> Indices;
+  std::vector<SubMesh> SubMeshes;
+  // Meshlet index ranges point into Indices.
+  std::vector<Meshlet> Meshlets;
+  std::vector<ModelPart> Parts;
+  std::vector<ModelMaterial> Materials;
+  // Bounds of all parts in model space.
+  AABB Bounds;
+  uint32_t NumRepairedTangents;
+};
+
+// Returns an empty model if the file can't be read.
+Model importModel(JobSystem &_jobSystem, const std::string &_filePath);
+
+} // namespace bb
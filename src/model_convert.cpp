@@ -0,0 +1,89 @@
+#include "model_convert.h"
+#include "util.h"
+#include "external/assimp/mesh.h"
+#include <math.h>
+
+namespace bb {
+
+Float3 aiVector3DToFloat3(const aiVector3D &_aiVec3) {
+  Float3 result = {_aiVec3.x, _aiVec3.y, _aiVec3.z};
+  return result;
+}
+
+Float2 aiVector3DToFloat2(const aiVector3D &_aiVec3) {
+  Float2 result = {_aiVec3.x, _aiVec3.y};
+  return result;
+}
+
+// aiMatrix4x4 is row major, Mat4 is column major.
+Mat4 aiMatrix4x4ToMat4(const aiMatrix4x4 &_aiMat4) {
+  Mat4 result;
+  for (int c = 0; c < 4; ++c) {
+    for (int r = 0; r < 4; ++r) {
+      result.M[c][r] = _aiMat4[r][c];
+    }
+  }
+  return result;
+}
+
+// Makes _tangent a unit vector orthogonal to _normal. Returns false if the
+// tangent was missing or degenerate and had to be rebuilt from scratch.
+static bool orthonormalizeTangent(const Float3 &_normal, Float3 &_tangent) {
+  Float3 tangent = _tangent - _normal * dot(_normal, _tangent);
+  float lengthSq = tangent.lengthSq();
+  if (isfinite(lengthSq) && lengthSq > 1e-8f) {
+    _tangent = tangent / sqrtf(lengthSq);
+    return true;
+  }
+
+  Float3 axis = (fabsf(_normal.X) < 0.9f) ? Float3{1, 0, 0} : Float3{0, 1, 0};
+  _tangent = cross(_normal, axis).normalize();
+  return false;
+}
+
+void convertModelChunk(const aiMesh &_mesh, Vertex *_dstVertices,
+                       uint32_t *_dstIndices, ModelImportChunk &_chunk) {
+  bool hasUVs = _mesh.HasTextureCoords(0);
+  bool hasNormals = _mesh.HasNormals();
+  bool hasTangents = _mesh.HasTangentsAndBitangents();
+
+  Vertex *dstVertex = _dstVertices + _chunk.FirstVertex;
+  for (uint32_t i = _chunk.FirstVertex;
+       i < _chunk.FirstVertex + _chunk.NumVertices; ++i) {
+    Vertex v = {};
+    v.Pos = aiVector3DToFloat3(_mesh.mVertices[i]);
+    if (hasUVs) {
+      v.UV = {_mesh.mTextureCoords[0][i].x, _mesh.mTextureCoords[0][i].y};
+    }
+    if (hasNormals) {
+      v.Normal = aiVector3DToFloat3(_mesh.mNormals[i]);
+      float lengthSq = v.Normal.lengthSq();
+      if (isfinite(lengthSq) && lengthSq > 1e-8f) {
+        v.Normal = v.Normal / sqrtf(lengthSq);
+      } else {
+        v.Normal = Vertex{}.Normal;
+      }
+    }
+    if (hasTangents) {
+      v.Tangent = aiVector3DToFloat3(_mesh.mTangents[i]);
+    }
+    if (!orthonormalizeTangent(v.Normal, v.Tangent) || !hasTangents) {
+      ++_chunk.NumRepairedTangents;
+    }
+
+    _chunk.Bounds.extend(v.Pos);
+    *dstVertex++ = v;
+  }
+
+  uint32_t *dstIndex = _dstIndices + (size_t)_chunk.FirstFace * 3;
+  for (uint32_t i = _chunk.FirstFace; i < _chunk.FirstFace + _chunk.NumFaces;
+       ++i) {
+    const aiFace &face = _mesh.mFaces[i];
+    BB_ASSERT(face.mNumIndices == 3);
+    *dstIndex++ = face.mIndices[0];
+    *dstIndex++ = face.mIndices[1];
+    *dstIndex++ = face.mIndices[2];
+  }
+}
+
+} // namespace bb
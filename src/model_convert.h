@@ -0,0 +1,38 @@
+#pragma once
+#include "vertex.h"
+#include "external/assimp/vector3.h"
+#include "external/assimp/matrix4x4.h"
+#include <stdint.h>
+
+struct aiMesh;
+
+namespace bb {
+
+// Conversion of Assimp meshes to Vertex, apart from the importer so that it
+// can be measured without one.
+
+Float3 aiVector3DToFloat3(const aiVector3D &_aiVec3);
+Float2 aiVector3DToFloat2(const aiVector3D &_aiVec3);
+Mat4 aiMatrix4x4ToMat4(const aiMatrix4x4 &_aiMat4);
+
+// Meshes are split into chunks of at most this many vertices (and faces), so
+// that a single huge mesh still spreads across all workers.
+constexpr uint32_t modelImportChunkSize = 16384;
+
+struct ModelImportChunk {
+  uint32_t MeshIndex;
+  uint32_t FirstVertex;
+  uint32_t NumVertices;
+  uint32_t FirstFace;
+  uint32_t NumFaces;
+
+  AABB Bounds;
+  uint32_t NumRepairedTangents;
+};
+
+// Converts the chunk's vertices and triangles. _dstVertices and _dstIndices
+// point at where the mesh's first vertex and index go.
+void convertModelChunk(const aiMesh &_mesh, Vertex *_dstVertices,
+                       uint32_t *_dstIndices, ModelImportChunk &_chunk);
+
+} // namespace bb
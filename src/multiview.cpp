@@ -0,0 +1,350 @@
+#include "multiview.h"
+#include <algorithm>
+#include <math.h>
+#include <stddef.h>
+
+namespace bb {
+
+constexpr float multiviewNearZ = 0.1f;
+constexpr float multiviewFarZ = 1000.f;
+
+// Color and depth are cleared at the start and color is left for sampling.
+// The dependencies order the pass after the previous frame's sampling and
+// before this frame's.
+static VkRenderPass createCaptureRenderPass(const Renderer &_renderer,
+                                            uint32_t _viewMask) {
+  VkAttachmentDescription attachments[2] = {};
+  attachments[0].format = multiviewColorFormat;
+  attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+  attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  attachments[0].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  attachments[1] = attachments[0];
+  attachments[1].format = multiviewDepthFormat;
+  attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+  VkAttachmentReference colorRef = {};
+  colorRef.attachment = 0;
+  colorRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  VkAttachmentReference depthRef = {};
+  depthRef.attachment = 1;
+  depthRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+  VkSubpassDescription subpass = {};
+  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpass.colorAttachmentCount = 1;
+  subpass.pColorAttachments = &colorRef;
+  subpass.pDepthStencilAttachment = &depthRef;
+
+  VkSubpassDependency dependencies[2] = {};
+  dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+  dependencies[0].dstSubpass = 0;
+  dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                                 VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                                 VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+  dependencies[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                  VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                                  VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  dependencies[1].srcSubpass = 0;
+  dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+  dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+  VkRenderPassCreateInfo renderPassCreateInfo = {};
+  renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  renderPassCreateInfo.attachmentCount = (uint32_t)std::size(attachments);
+  renderPassCreateInfo.pAttachments = attachments;
+  renderPassCreateInfo.subpassCount = 1;
+  renderPassCreateInfo.pSubpasses = &subpass;
+  renderPassCreateInfo.dependencyCount = (uint32_t)std::size(dependencies);
+  renderPassCreateInfo.pDependencies = dependencies;
+
+  // All views are also marked as correlated, which lets stereo
+  // implementations share work between them.
+  VkRenderPassMultiviewCreateInfo multiviewCreateInfo = {};
+  multiviewCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO;
+  multiviewCreateInfo.subpassCount = 1;
+  multiviewCreateInfo.pViewMasks = &_viewMask;
+  multiviewCreateInfo.correlationMaskCount = 1;
+  multiviewCreateInfo.pCorrelationMasks = &_viewMask;
+  if (_viewMask != 0) {
+    renderPassCreateInfo.pNext = &multiviewCreateInfo;
+  }
+
+  VkRenderPass renderPass;
+  BB_VK_ASSERT(vkCreateRenderPass(_renderer.Device, &renderPassCreateInfo,
+                                  nullptr, &renderPass));
+  return renderPass;
+}
+
+static VkFramebuffer createCaptureFramebuffer(const Renderer &_renderer,
+                                              VkRenderPass _renderPass,
+                                              VkImageView _colorView,
+                                              VkImageView _depthView) {
+  VkImageView attachments[] = {_colorView, _depthView};
+  VkFramebufferCreateInfo fbCreateInfo = {};
+  fbCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+  fbCreateInfo.renderPass = _renderPass;
+  fbCreateInfo.attachmentCount = (uint32_t)std::size(attachments);
+  fbCreateInfo.pAttachments = attachments;
+  fbCreateInfo.width = multiviewExtent;
+  fbCreateInfo.height = multiviewExtent;
+  // Multiview takes its layers from the view mask instead.
+  fbCreateInfo.layers = 1;
+
+  VkFramebuffer framebuffer;
+  BB_VK_ASSERT(vkCreateFramebuffer(_renderer.Device, &fbCreateInfo, nullptr,
+                                   &framebuffer));
+  return framebuffer;
+}
+
+static VkImageView createLayerView(const Renderer &_renderer,
+                                   const Image &_image, VkFormat _format,
+                                   VkImageAspectFlags _aspect,
+                                   uint32_t _layer) {
+  VkImageViewCreateInfo viewCreateInfo = {};
+  viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  viewCreateInfo.image = _image.Handle;
+  viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  viewCreateInfo.format = _format;
+  viewCreateInfo.subresourceRange.aspectMask = _aspect;
+  viewCreateInfo.subresourceRange.baseMipLevel = 0;
+  viewCreateInfo.subresourceRange.levelCount = 1;
+  viewCreateInfo.subresourceRange.baseArrayLayer = _layer;
+  viewCreateInfo.subresourceRange.layerCount = 1;
+
+  VkImageView view;
+  BB_VK_ASSERT(
+      vkCreateImageView(_renderer.Device, &viewCreateInfo, nullptr, &view));
+  return view;
+}
+
+MultiviewCapture createMultiviewCapture(const Renderer &_renderer,
+                                        VkPipelineLayout _pipelineLayout,
+                                        VertexStreamLayout _vertexLayout,
+                                        const Shader &_multiviewVertShader,
+                                        const Shader &_layeredVertShader,
+                                        const Shader &_fragShader) {
+  MultiviewCapture capture = {};
+
+  ImageParams params = {};
+  params.Format = multiviewColorFormat;
+  params.Width = multiviewExtent;
+  params.Height = multiviewExtent;
+  params.Usage =
+      VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  params.NumLayers = maxNumMultiviews;
+  capture.ColorImage = createImage(_renderer, params);
+  params.Format = multiviewDepthFormat;
+  params.Usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+  params.Aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+  capture.DepthImage = createImage(_renderer, params);
+
+  for (uint32_t layer = 0; layer < maxNumMultiviews; ++layer) {
+    capture.ColorLayerViews[layer] =
+        createLayerView(_renderer, capture.ColorImage, multiviewColorFormat,
+                        VK_IMAGE_ASPECT_COLOR_BIT, layer);
+    capture.DepthLayerViews[layer] =
+        createLayerView(_renderer, capture.DepthImage, multiviewDepthFormat,
+                        VK_IMAGE_ASPECT_DEPTH_BIT, layer);
+  }
+
+  PipelineParams pipelineParams = {};
+  const Shader *shaders[] = {&_layeredVertShader, &_fragShader};
+  pipelineParams.Shaders = shaders;
+  pipelineParams.NumShaders = std::size(shaders);
+  setVertexInput(pipelineParams, _vertexLayout);
+  pipelineParams.InputAssembly.Topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  pipelineParams.Viewport.Extent = {(float)multiviewExtent,
+                                    (float)multiviewExtent};
+  pipelineParams.Viewport.ScissorExtent = {(int)multiviewExtent,
+                                           (int)multiviewExtent};
+  pipelineParams.Rasterizer.PolygonMode = VK_POLYGON_MODE_FILL;
+  pipelineParams.Rasterizer.CullMode = VK_CULL_MODE_BACK_BIT;
+  pipelineParams.DepthStencil.DepthTestEnable = true;
+  pipelineParams.DepthStencil.DepthWriteEnable = true;
+  pipelineParams.Blend.NumColorBlends = 1;
+  pipelineParams.Subpass = 0;
+  pipelineParams.PipelineLayout = _pipelineLayout;
+
+  capture.LayeredRenderPass = createCaptureRenderPass(_renderer, 0);
+  for (uint32_t layer = 0; layer < maxNumMultiviews; ++layer) {
+    capture.LayeredFramebuffers[layer] = createCaptureFramebuffer(
+        _renderer, capture.LayeredRenderPass, capture.ColorLayerViews[layer],
+        capture.DepthLayerViews[layer]);
+  }
+  pipelineParams.RenderPass = capture.LayeredRenderPass;
+  capture.LayeredPipeline = createPipeline(_renderer, pipelineParams);
+
+  if (!_renderer.SupportsMultiview) {
+    capture.Path = MultiviewPath::Layered;
+    return capture;
+  }
+
+  shaders[0] = &_multiviewVertShader;
+  uint32_t maxNumViews =
+      std::min(maxNumMultiviews, _renderer.MaxMultiviewViewCount);
+  for (uint32_t numViews = 1; numViews <= maxNumViews; ++numViews) {
+    uint32_t i = numViews - 1;
+    capture.MultiviewRenderPasses[i] =
+        createCaptureRenderPass(_renderer, (1u << numViews) - 1);
+    capture.MultiviewFramebuffers[i] = createCaptureFramebuffer(
+        _renderer, capture.MultiviewRenderPasses[i], capture.ColorImage.View,
+        capture.DepthImage.View);
+    pipelineParams.RenderPass = capture.MultiviewRenderPasses[i];
+    capture.MultiviewPipelines[i] = createPipeline(_renderer, pipelineParams);
+  }
+
+  return capture;
+}
+
+void destroyMultiviewCapture(const Renderer &_renderer,
+                             MultiviewCapture &_capture) {
+  for (uint32_t i = 0; i < maxNumMultiviews; ++i) {
+    vkDestroyPipeline(_renderer.Device, _capture.MultiviewPipelines[i],
+                      nullptr);
+    vkDestroyFramebuffer(_renderer.Device, _capture.MultiviewFramebuffers[i],
+                         nullptr);
+    vkDestroyRenderPass(_renderer.Device, _capture.MultiviewRenderPasses[i],
+                        nullptr);
+    vkDestroyFramebuffer(_renderer.Device, _capture.LayeredFramebuffers[i],
+                         nullptr);
+    vkDestroyImageView(_renderer.Device, _capture.ColorLayerViews[i], nullptr);
+    vkDestroyImageView(_renderer.Device, _capture.DepthLayerViews[i], nullptr);
+  }
+  vkDestroyPipeline(_renderer.Device, _capture.LayeredPipeline, nullptr);
+  vkDestroyRenderPass(_renderer.Device, _capture.LayeredRenderPass, nullptr);
+  destroyImage(_renderer, _capture.DepthImage);
+  destroyImage(_renderer, _capture.ColorImage);
+  _capture = {};
+}
+
+void updateMultiviewViews(MultiviewCapture &_capture,
+                          const ViewUniformBlock &_mainView,
+                          MultiviewUniformBlock &_block) {
+  // Rows of the view matrix are the main view's axes.
+  const Mat4 &mainViewMat = _mainView.ViewMat;
+  Float3 forward = {mainViewMat.M[0][2], mainViewMat.M[1][2],
+                    mainViewMat.M[2][2]};
+  Mat4 proj =
+      Mat4::perspective(60.f, 1.f, multiviewNearZ, multiviewFarZ);
+
+  ViewUniformBlock *views = _capture.Views;
+  switch (_capture.Arrangement) {
+  case MultiviewArrangement::Stereo: {
+    _capture.NumViews = 2;
+    for (uint32_t eye = 0; eye < 2; ++eye) {
+      float offset = (eye == 0 ? 0.5f : -0.5f) * _capture.EyeSeparation;
+      views[eye].ViewMat = Mat4::translate({offset, 0, 0}) * mainViewMat;
+      views[eye].ProjMat = proj;
+    }
+    break;
+  }
+  case MultiviewArrangement::Cubemap: {
+    _capture.NumViews = 6;
+    const Float3 faceDirs[6] = {{1, 0, 0},  {-1, 0, 0}, {0, 1, 0},
+                                {0, -1, 0}, {0, 0, 1},  {0, 0, -1}};
+    Mat4 faceProj =
+        Mat4::perspective(90.f, 1.f, multiviewNearZ, multiviewFarZ);
+    for (uint32_t face = 0; face < 6; ++face) {
+      Float3 up = face == 2 || face == 3 ? Float3{0, 0, 1} : Float3{0, 1, 0};
+      views[face].ViewMat = Mat4::lookAt(
+          _mainView.ViewPos, _mainView.ViewPos + faceDirs[face], up);
+      views[face].ProjMat = faceProj;
+    }
+    break;
+  }
+  case MultiviewArrangement::Orbit: {
+    _capture.NumViews = (uint32_t)std::clamp(_capture.NumOrbitViews, 1,
+                                             (int)maxNumMultiviews);
+    Float3 target = _mainView.ViewPos + forward * _capture.OrbitDistance;
+    Float3 toMain = _mainView.ViewPos - target;
+    float height = toMain.Y;
+    float radius = std::max(sqrtf(toMain.X * toMain.X + toMain.Z * toMain.Z),
+                            0.1f * _capture.OrbitDistance);
+    float startAngle = atan2f(toMain.Z, toMain.X);
+    for (uint32_t i = 0; i < _capture.NumViews; ++i) {
+      float angle =
+          startAngle + twoPi32 * (float)i / (float)_capture.NumViews;
+      Float3 eye = target + Float3{radius * cosf(angle), height,
+                                   radius * sinf(angle)};
+      views[i].ViewMat = Mat4::lookAt(eye, target);
+      views[i].ProjMat = proj;
+    }
+    break;
+  }
+  default:
+    BB_ASSERT(false);
+    break;
+  }
+
+  _block = {};
+  for (uint32_t i = 0; i < _capture.NumViews; ++i) {
+    ViewUniformBlock &view = views[i];
+    view.ViewPos = transformPoint(view.ViewMat.inverse(), {0, 0, 0});
+    view.EnableNormalMap = _mainView.EnableNormalMap;
+    _block.ViewProj[i] = view.ProjMat * view.ViewMat;
+    _block.ViewPos[i] = {view.ViewPos.X, view.ViewPos.Y, view.ViewPos.Z, 1};
+  }
+}
+
+void recordMultiviewCapture(VkCommandBuffer _cmdBuffer,
+                            const MultiviewCapture &_capture,
+                            VkPipelineLayout _pipelineLayout,
+                            const std::function<void()> &_drawScene) {
+  BB_ASSERT(_capture.NumViews > 0 && _capture.NumViews <= maxNumMultiviews);
+
+  VkClearValue clearValues[2] = {};
+  // Reverse-Z, so depth clears to the far plane at 0.
+  clearValues[1].depthStencil = {0.f, 0};
+
+  VkRenderPassBeginInfo renderPassInfo = {};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+  renderPassInfo.renderArea.extent = {multiviewExtent, multiviewExtent};
+  renderPassInfo.clearValueCount = (uint32_t)std::size(clearValues);
+  renderPassInfo.pClearValues = clearValues;
+
+  uint32_t i = _capture.NumViews - 1;
+  if (_capture.Path == MultiviewPath::Multiview &&
+      _capture.MultiviewPipelines[i] != VK_NULL_HANDLE) {
+    renderPassInfo.renderPass = _capture.MultiviewRenderPasses[i];
+    renderPassInfo.framebuffer = _capture.MultiviewFramebuffers[i];
+    vkCmdBeginRenderPass(_cmdBuffer, &renderPassInfo,
+                         VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBindPipeline(_cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                      _capture.MultiviewPipelines[i]);
+    _drawScene();
+    vkCmdEndRenderPass(_cmdBuffer);
+    return;
+  }
+
+  renderPassInfo.renderPass = _capture.LayeredRenderPass;
+  for (uint32_t layer = 0; layer < _capture.NumViews; ++layer) {
+    renderPassInfo.framebuffer = _capture.LayeredFramebuffers[layer];
+    vkCmdBeginRenderPass(_cmdBuffer, &renderPassInfo,
+                         VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBindPipeline(_cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                      _capture.LayeredPipeline);
+    int32_t viewIndex = (int32_t)layer;
+    vkCmdPushConstants(_cmdBuffer, _pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT,
+                       offsetof(StandardPushConstants, ViewIndex),
+                       sizeof(viewIndex), &viewIndex);
+    _drawScene();
+    vkCmdEndRenderPass(_cmdBuffer);
+  }
+
+  int32_t viewIndex = 0;
+  vkCmdPushConstants(_cmdBuffer, _pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT,
+                     offsetof(StandardPushConstants, ViewIndex),
+                     sizeof(viewIndex), &viewIndex);
+}
+
+} // namespace bb
@@ -0,0 +1,119 @@
+#pragma once
+#include "render.h"
+#include <functional>
+
+namespace bb {
+
+// Renders the scene from up to maxNumMultiviews extra views per frame, each
+// into its own layer of one image array, forward shaded.
+//
+// With multiview every draw is recorded once for all views, which the vertex
+// shader tells apart by gl_ViewIndex. Devices without it get the layered
+// fallback, where the whole pass is recorded again per layer with the view
+// index pushed as a constant.
+
+constexpr uint32_t multiviewExtent = 256;
+constexpr VkFormat multiviewColorFormat = VK_FORMAT_R8G8B8A8_SRGB;
+constexpr VkFormat multiviewDepthFormat = VK_FORMAT_D32_SFLOAT;
+
+enum class MultiviewPath { Multiview, Layered, COUNT };
+
+// Where the views are placed, relative to the main view.
+enum class MultiviewArrangement {
+  // Two eyes either side of the main view.
+  Stereo,
+  // Six faces around the main view's position, ordered +X, -X, +Y, -Y, +Z,
+  // -Z.
+  Cubemap,
+  // NumOrbitViews views circling the point the main view looks at, the first
+  // one from about where the main view is.
+  Orbit,
+  COUNT
+};
+
+struct MultiviewStats {
+  // CPU time of culling the scene once over every view, the main view
+  // included.
+  float CullMs;
+  // CPU time of recording the capture pass.
+  float RecordMs;
+};
+
+struct MultiviewCapture {
+  // Layer i holds view i, SHADER_READ_ONLY_OPTIMAL after the pass.
+  Image ColorImage;
+  Image DepthImage;
+  VkImageView ColorLayerViews[maxNumMultiviews];
+  VkImageView DepthLayerViews[maxNumMultiviews];
+
+  // Element n - 1 renders the first n layers at once. Render passes of
+  // different view masks aren't compatible, so each count has its own.
+  // VK_NULL_HANDLE without multiview support.
+  VkRenderPass MultiviewRenderPasses[maxNumMultiviews];
+  VkFramebuffer MultiviewFramebuffers[maxNumMultiviews];
+  VkPipeline MultiviewPipelines[maxNumMultiviews];
+
+  // One layer per framebuffer.
+  VkRenderPass LayeredRenderPass;
+  VkFramebuffer LayeredFramebuffers[maxNumMultiviews];
+  VkPipeline LayeredPipeline;
+
+  bool IsEnabled = false;
+  MultiviewPath Path = MultiviewPath::Multiview;
+  MultiviewArrangement Arrangement = MultiviewArrangement::Orbit;
+  int NumOrbitViews = 4;
+  float EyeSeparation = 0.064f;
+  float OrbitDistance = 5.f;
+
+  // Filled by updateMultiviewViews().
+  uint32_t NumViews;
+  ViewUniformBlock Views[maxNumMultiviews];
+
+  MultiviewStats Stats;
+};
+
+// Times culling and recording the capture for every view count of the Orbit
+// arrangement on both paths, so that the cost of each additional view shows.
+struct MultiviewBenchmark {
+  static constexpr int NumWarmupFrames = 8;
+  static constexpr int NumMeasuredFrames = 32;
+
+  bool IsRunning = false;
+  // View count minus one times 2, plus the path
+  int Step;
+  int Frame;
+  double SumMs;
+  // Capture settings to restore afterwards.
+  bool WasEnabled;
+  MultiviewPath SavedPath;
+  MultiviewArrangement SavedArrangement;
+  int SavedNumOrbitViews;
+  // Negative where the path wasn't available.
+  EnumArray<MultiviewPath, float> ResultMs[maxNumMultiviews] = {};
+};
+
+// _multiviewVertShader is only used with multiview support, and may be left
+// empty without it.
+MultiviewCapture createMultiviewCapture(const Renderer &_renderer,
+                                        VkPipelineLayout _pipelineLayout,
+                                        VertexStreamLayout _vertexLayout,
+                                        const Shader &_multiviewVertShader,
+                                        const Shader &_layeredVertShader,
+                                        const Shader &_fragShader);
+void destroyMultiviewCapture(const Renderer &_renderer,
+                             MultiviewCapture &_capture);
+
+// Places this frame's views around _mainView and writes them to _block.
+void updateMultiviewViews(MultiviewCapture &_capture,
+                          const ViewUniformBlock &_mainView,
+                          MultiviewUniformBlock &_block);
+
+// Records the capture pass outside of any render pass, with the standard
+// descriptor sets and the geometry pool already bound. _drawScene draws the
+// scene with the bound pipeline, and is called once per recorded pass.
+void recordMultiviewCapture(VkCommandBuffer _cmdBuffer,
+                            const MultiviewCapture &_capture,
+                            VkPipelineLayout _pipelineLayout,
+                            const std::function<void()> &_drawScene);
+
+} // namespace bb
@@ -0,0 +1,428 @@
+#include "occlusion.h"
+#include <algorithm>
+#include <emmintrin.h>
+#include <math.h>
+#include <unordered_map>
+
+namespace bb {
+
+constexpr int occlusionBandHeight = 16;
+
+struct ClipVertex {
+  float X, Y, Z, W;
+};
+
+// A triangle in buffer pixels with reverse-Z depth.
+struct ScreenTriangle {
+  Float3 V[3];
+  uint32_t Id;
+};
+
+static ClipVertex transformToClip(const Mat4 &_m, const Float3 &_p) {
+  ClipVertex result;
+  result.X = _m.M[0][0] * _p.X + _m.M[1][0] * _p.Y + _m.M[2][0] * _p.Z +
+             _m.M[3][0];
+  result.Y = _m.M[0][1] * _p.X + _m.M[1][1] * _p.Y + _m.M[2][1] * _p.Z +
+             _m.M[3][1];
+  result.Z = _m.M[0][2] * _p.X + _m.M[1][2] * _p.Y + _m.M[2][2] * _p.Z +
+             _m.M[3][2];
+  result.W = _m.M[0][3] * _p.X + _m.M[1][3] * _p.Y + _m.M[2][3] * _p.Z +
+             _m.M[3][3];
+  return result;
+}
+
+// Signed distance to the near plane (z <= w), positive in front of it.
+static float nearPlaneDistance(const ClipVertex &_v) { return _v.W - _v.Z; }
+
+static Float3 clipToScreen(const OcclusionBuffer &_buffer,
+                           const ClipVertex &_v) {
+  float invW = 1.f / _v.W;
+  return {(_v.X * invW * 0.5f + 0.5f) * (float)_buffer.Width,
+          (_v.Y * invW * 0.5f + 0.5f) * (float)_buffer.Height, _v.Z * invW};
+}
+
+// Clips the triangle against the near plane and appends the 0 to 2
+// resulting triangles in screen space.
+static void setupTriangle(const OcclusionBuffer &_buffer,
+                          const ClipVertex (&_clip)[3], uint32_t _id,
+                          std::vector<ScreenTriangle> &_triangles) {
+  ClipVertex polygon[4];
+  int numVertices = 0;
+  for (int i = 0; i < 3; ++i) {
+    const ClipVertex &a = _clip[i];
+    const ClipVertex &b = _clip[(i + 1) % 3];
+    float da = nearPlaneDistance(a);
+    float db = nearPlaneDistance(b);
+    if (da >= 0.f) {
+      polygon[numVertices++] = a;
+    }
+    if ((da >= 0.f) != (db >= 0.f)) {
+      float t = da / (da - db);
+      polygon[numVertices++] = {a.X + (b.X - a.X) * t, a.Y + (b.Y - a.Y) * t,
+                                a.Z + (b.Z - a.Z) * t, a.W + (b.W - a.W) * t};
+    }
+  }
+
+  for (int i = 1; i + 1 < numVertices; ++i) {
+    if (polygon[0].W <= 0.f || polygon[i].W <= 0.f || polygon[i + 1].W <= 0.f) {
+      continue;
+    }
+    ScreenTriangle triangle;
+    triangle.V[0] = clipToScreen(_buffer, polygon[0]);
+    triangle.V[1] = clipToScreen(_buffer, polygon[i]);
+    triangle.V[2] = clipToScreen(_buffer, polygon[i + 1]);
+    triangle.Id = _id;
+    _triangles.push_back(triangle);
+  }
+}
+
+// Rasterizes the part of _triangle within rows [_minY, _maxY) of _depth, four
+// pixels at a time. Pixels are covered when their center is inside or on an
+// edge.
+static void rasterizeTriangle(const OcclusionBuffer &_buffer, float *_depth,
+                              uint32_t *_ids, const ScreenTriangle &_triangle,
+                              int _minY, int _maxY) {
+  Float3 v0 = _triangle.V[0];
+  Float3 v1 = _triangle.V[1];
+  Float3 v2 = _triangle.V[2];
+
+  float area = (v1.X - v0.X) * (v2.Y - v0.Y) - (v1.Y - v0.Y) * (v2.X - v0.X);
+  if (!(fabsf(area) > 1e-8f)) {
+    return;
+  }
+  // Occluders are double-sided; orient every triangle the same way.
+  if (area < 0.f) {
+    std::swap(v1, v2);
+    area = -area;
+  }
+
+  float minX = std::min({v0.X, v1.X, v2.X});
+  float maxX = std::max({v0.X, v1.X, v2.X});
+  float minY = std::min({v0.Y, v1.Y, v2.Y});
+  float maxY = std::max({v0.Y, v1.Y, v2.Y});
+
+  int x0 = std::max(0, (int)floorf(minX)) & ~3;
+  int x1 = std::min(_buffer.Width - 1, (int)ceilf(maxX));
+  int y0 = std::max(_minY, (int)floorf(minY));
+  int y1 = std::min(_maxY - 1, (int)ceilf(maxY));
+  if (x0 > x1 || y0 > y1) {
+    return;
+  }
+
+  // Edge i is opposite vertex i, so its value over the area is the weight of
+  // vertex i.
+  float a0 = v1.Y - v2.Y, b0 = v2.X - v1.X, c0 = v1.X * v2.Y - v1.Y * v2.X;
+  float a1 = v2.Y - v0.Y, b1 = v0.X - v2.X, c1 = v2.X * v0.Y - v2.Y * v0.X;
+  float a2 = v0.Y - v1.Y, b2 = v1.X - v0.X, c2 = v0.X * v1.Y - v0.Y * v1.X;
+
+  float invArea = 1.f / area;
+  float za = (a0 * v0.Z + a1 * v1.Z + a2 * v2.Z) * invArea;
+  float zb = (b0 * v0.Z + b1 * v1.Z + b2 * v2.Z) * invArea;
+  float zc = (c0 * v0.Z + c1 * v1.Z + c2 * v2.Z) * invArea;
+
+  const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+  const __m128 zero = _mm_setzero_ps();
+
+  for (int y = y0; y <= y1; ++y) {
+    float py = (float)y + 0.5f;
+    __m128 rowE0 = _mm_set1_ps(b0 * py + c0);
+    __m128 rowE1 = _mm_set1_ps(b1 * py + c1);
+    __m128 rowE2 = _mm_set1_ps(b2 * py + c2);
+    __m128 rowZ = _mm_set1_ps(zb * py + zc);
+
+    float *depthRow = _depth + (size_t)y * _buffer.Width;
+    for (int x = x0; x <= x1; x += 4) {
+      __m128 px = _mm_add_ps(_mm_set1_ps((float)x), laneOffsets);
+      __m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a0), px), rowE0);
+      __m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a1), px), rowE1);
+      __m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a2), px), rowE2);
+      __m128 inside = _mm_and_ps(
+          _mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)),
+          _mm_cmpge_ps(e2, zero));
+      if (_mm_movemask_ps(inside) == 0) {
+        continue;
+      }
+
+      __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(za), px), rowZ);
+      __m128 dst = _mm_loadu_ps(depthRow + x);
+      __m128 closer = _mm_and_ps(inside, _mm_cmpgt_ps(z, dst));
+      int closerMask = _mm_movemask_ps(closer);
+      if (closerMask == 0) {
+        continue;
+      }
+      _mm_storeu_ps(depthRow + x, _mm_or_ps(_mm_and_ps(closer, z),
+                                            _mm_andnot_ps(closer, dst)));
+
+      if (_ids) {
+        uint32_t *idRow = _ids + (size_t)y * _buffer.Width;
+        for (int lane = 0; lane < 4; ++lane) {
+          if (closerMask & (1 << lane)) {
+            idRow[x + lane] = _triangle.Id;
+          }
+        }
+      }
+    }
+  }
+}
+
+OccluderMesh simplifyOccluder(const Vertex *_vertices, const uint32_t *_indices,
+                              uint32_t _firstIndex, uint32_t _numIndices,
+                              int _gridResolution) {
+  BB_ASSERT(_gridResolution > 0 && _gridResolution <= 1024);
+  OccluderMesh mesh = {};
+
+  AABB bounds;
+  for (uint32_t i = _firstIndex; i < _firstIndex + _numIndices; ++i) {
+    bounds.extend(_vertices[_indices[i]].Pos);
+  }
+  if (!bounds.isValid()) {
+    return mesh;
+  }
+
+  Float3 extent = bounds.Max - bounds.Min;
+  auto toCell = [&](float _value, float _min, float _extent) -> uint64_t {
+    if (!(_extent > 0.f)) {
+      return 0;
+    }
+    int cell = (int)((_value - _min) / _extent * (float)_gridResolution);
+    return (uint64_t)std::clamp(cell, 0, _gridResolution - 1);
+  };
+
+  std::unordered_map<uint64_t, uint32_t> cellVertices;
+  std::vector<uint32_t> numClusteredVertices;
+  std::vector<Float3> clusterNormals;
+  std::unordered_map<uint32_t, uint32_t> remap;
+  auto getClusterVertex = [&](uint32_t _vertex) -> uint32_t {
+    auto found = remap.find(_vertex);
+    if (found != remap.end()) {
+      return found->second;
+    }
+
+    const Float3 &pos = _vertices[_vertex].Pos;
+    uint64_t key = (toCell(pos.X, bounds.Min.X, extent.X) << 40) |
+                   (toCell(pos.Y, bounds.Min.Y, extent.Y) << 20) |
+                   toCell(pos.Z, bounds.Min.Z, extent.Z);
+    auto [cell, isNew] =
+        cellVertices.try_emplace(key, (uint32_t)mesh.Positions.size());
+    if (isNew) {
+      mesh.Positions.push_back({});
+      numClusteredVertices.push_back(0);
+      clusterNormals.push_back({});
+    }
+    mesh.Positions[cell->second] += pos;
+    ++numClusteredVertices[cell->second];
+    clusterNormals[cell->second] += _vertices[_vertex].Normal;
+    remap[_vertex] = cell->second;
+    return cell->second;
+  };
+
+  std::vector<uint32_t> clusterIndices;
+  for (uint32_t i = _firstIndex; i < _firstIndex + _numIndices; i += 3) {
+    uint32_t a = getClusterVertex(_indices[i]);
+    uint32_t b = getClusterVertex(_indices[i + 1]);
+    uint32_t c = getClusterVertex(_indices[i + 2]);
+    if (a == b || b == c || c == a) {
+      continue;
+    }
+    clusterIndices.insert(clusterIndices.end(), {a, b, c});
+  }
+
+  // Normals that mostly cancel out can't tell which way is inward.
+  constexpr float minNormalAgreement = 0.5f;
+  float erosion = (extent / (float)_gridResolution).length();
+  std::vector<uint8_t> isClusterKept(mesh.Positions.size());
+  for (size_t i = 0; i < mesh.Positions.size(); ++i) {
+    float numVertices = (float)numClusteredVertices[i];
+    mesh.Positions[i] = mesh.Positions[i] / numVertices;
+    float normalLength = clusterNormals[i].length();
+    isClusterKept[i] = normalLength > minNormalAgreement * numVertices;
+    if (isClusterKept[i]) {
+      mesh.Positions[i] =
+          mesh.Positions[i] - clusterNormals[i] * (erosion / normalLength);
+    }
+  }
+
+  for (size_t i = 0; i < clusterIndices.size(); i += 3) {
+    if (isClusterKept[clusterIndices[i]] &&
+        isClusterKept[clusterIndices[i + 1]] &&
+        isClusterKept[clusterIndices[i + 2]]) {
+      mesh.Indices.insert(mesh.Indices.end(), clusterIndices.begin() + i,
+                          clusterIndices.begin() + i + 3);
+    }
+  }
+
+  return mesh;
+}
+
+OcclusionBuffer createOcclusionBuffer(int _width, int _height) {
+  BB_ASSERT(_width % 4 == 0 && _width % occlusionTileSize == 0);
+  BB_ASSERT(_height % occlusionTileSize == 0);
+
+  OcclusionBuffer buffer = {};
+  buffer.Width = _width;
+  buffer.Height = _height;
+  buffer.Depth.resize((size_t)_width * _height, 0.f);
+  buffer.CenterDepth.resize(buffer.Depth.size(), 0.f);
+  buffer.NumTilesX = _width / occlusionTileSize;
+  buffer.NumTilesY = _height / occlusionTileSize;
+  buffer.TileMinDepth.resize((size_t)buffer.NumTilesX * buffer.NumTilesY, 0.f);
+  return buffer;
+}
+
+void rasterizeOccluders(JobSystem &_jobSystem, OcclusionBuffer &_buffer,
+                        const std::vector<OccluderInstance> &_occluders,
+                        uint32_t *_ids, OcclusionCoverage _coverage) {
+  std::vector<std::vector<ScreenTriangle>> occluderTriangles(
+      _occluders.size());
+  parallelFor(_jobSystem, (int)_occluders.size(), 1, [&](int _index) {
+    const OccluderInstance &occluder = _occluders[_index];
+    const OccluderMesh &mesh = *occluder.Mesh;
+
+    std::vector<ClipVertex> clipVertices(mesh.Positions.size());
+    for (size_t i = 0; i < mesh.Positions.size(); ++i) {
+      clipVertices[i] =
+          transformToClip(occluder.ModelViewProj, mesh.Positions[i]);
+    }
+
+    std::vector<ScreenTriangle> &triangles = occluderTriangles[_index];
+    for (size_t i = 0; i + 2 < mesh.Indices.size(); i += 3) {
+      ClipVertex clip[3] = {clipVertices[mesh.Indices[i]],
+                            clipVertices[mesh.Indices[i + 1]],
+                            clipVertices[mesh.Indices[i + 2]]};
+      setupTriangle(_buffer, clip, occluder.Id, triangles);
+    }
+  });
+
+  bool isConservative = _coverage == OcclusionCoverage::Conservative;
+  std::vector<float> &depth =
+      isConservative ? _buffer.CenterDepth : _buffer.Depth;
+
+  // Bands own disjoint rows, so they can be filled without synchronization.
+  int numBands = (_buffer.Height + occlusionBandHeight - 1) / occlusionBandHeight;
+  parallelFor(_jobSystem, numBands, 1, [&](int _band) {
+    int minY = _band * occlusionBandHeight;
+    int maxY = std::min(minY + occlusionBandHeight, _buffer.Height);
+
+    std::fill(depth.begin() + (size_t)minY * _buffer.Width,
+              depth.begin() + (size_t)maxY * _buffer.Width, 0.f);
+    if (_ids) {
+      std::fill(_ids + (size_t)minY * _buffer.Width,
+                _ids + (size_t)maxY * _buffer.Width, 0u);
+    }
+
+    for (const std::vector<ScreenTriangle> &triangles : occluderTriangles) {
+      for (const ScreenTriangle &triangle : triangles) {
+        rasterizeTriangle(_buffer, depth.data(), _ids, triangle, minY, maxY);
+      }
+    }
+  });
+
+  // A pixel whose center an occluder covers may still be partly uncovered,
+  // or hold a farther depth off center. Its 3x3 neighborhood of centers
+  // spans the whole pixel though: if every one of them is covered, so is the
+  // pixel wherever the occluders are convex across it, and the farthest of
+  // their depths bounds the pixel's own. Beyond the buffer counts as
+  // uncovered.
+  if (isConservative) {
+    parallelFor(_jobSystem, numBands, 1, [&](int _band) {
+      int minY = _band * occlusionBandHeight;
+      int maxY = std::min(minY + occlusionBandHeight, _buffer.Height);
+      for (int y = minY; y < maxY; ++y) {
+        float *dstRow = _buffer.Depth.data() + (size_t)y * _buffer.Width;
+        if (y == 0 || y == _buffer.Height - 1) {
+          std::fill(dstRow, dstRow + _buffer.Width, 0.f);
+          continue;
+        }
+        const float *srcRows[3] = {
+            depth.data() + (size_t)(y - 1) * _buffer.Width,
+            depth.data() + (size_t)y * _buffer.Width,
+            depth.data() + (size_t)(y + 1) * _buffer.Width};
+        dstRow[0] = 0.f;
+        dstRow[_buffer.Width - 1] = 0.f;
+        for (int x = 1; x < _buffer.Width - 1; ++x) {
+          float minDepth = 1.f;
+          for (const float *row : srcRows) {
+            minDepth = std::min({minDepth, row[x - 1], row[x], row[x + 1]});
+          }
+          dstRow[x] = minDepth;
+        }
+      }
+    });
+  }
+
+  for (int ty = 0; ty < _buffer.NumTilesY; ++ty) {
+    for (int tx = 0; tx < _buffer.NumTilesX; ++tx) {
+      float minDepth = 1.f;
+      for (int y = ty * occlusionTileSize; y < (ty + 1) * occlusionTileSize;
+           ++y) {
+        const float *row = _buffer.Depth.data() + (size_t)y * _buffer.Width +
+                           tx * occlusionTileSize;
+        for (int x = 0; x < occlusionTileSize; ++x) {
+          minDepth = std::min(minDepth, row[x]);
+        }
+      }
+      _buffer.TileMinDepth[ty * _buffer.NumTilesX + tx] = minDepth;
+    }
+  }
+}
+
+bool isAABBOccluded(const OcclusionBuffer &_buffer, const Mat4 &_modelViewProj,
+                    const AABB &_bounds) {
+  if (!_bounds.isValid()) {
+    return false;
+  }
+
+  float minX = FLT_MAX, minY = FLT_MAX;
+  float maxX = -FLT_MAX, maxY = -FLT_MAX;
+  float maxDepth = 0.f;
+  for (int i = 0; i < 8; ++i) {
+    Float3 corner = {(i & 1) ? _bounds.Max.X : _bounds.Min.X,
+                     (i & 2) ? _bounds.Max.Y : _bounds.Min.Y,
+                     (i & 4) ? _bounds.Max.Z : _bounds.Min.Z};
+    ClipVertex clip = transformToClip(_modelViewProj, corner);
+    if (nearPlaneDistance(clip) <= 0.f || clip.W <= 0.f) {
+      return false;
+    }
+    Float3 screen = clipToScreen(_buffer, clip);
+    minX = std::min(minX, screen.X);
+    maxX = std::max(maxX, screen.X);
+    minY = std::min(minY, screen.Y);
+    maxY = std::max(maxY, screen.Y);
+    maxDepth = std::max(maxDepth, screen.Z);
+  }
+
+  // Same pixel centers the rasterizer samples.
+  int x0 = std::max(0, (int)floorf(minX));
+  int x1 = std::min(_buffer.Width - 1, (int)ceilf(maxX));
+  int y0 = std::max(0, (int)floorf(minY));
+  int y1 = std::min(_buffer.Height - 1, (int)ceilf(maxY));
+  if (x0 > x1 || y0 > y1) {
+    // Entirely off screen.
+    return true;
+  }
+
+  for (int ty = y0 / occlusionTileSize; ty <= y1 / occlusionTileSize; ++ty) {
+    for (int tx = x0 / occlusionTileSize; tx <= x1 / occlusionTileSize; ++tx) {
+      if (_buffer.TileMinDepth[ty * _buffer.NumTilesX + tx] > maxDepth) {
+        continue;
+      }
+
+      int tileX0 = std::max(x0, tx * occlusionTileSize);
+      int tileX1 = std::min(x1, (tx + 1) * occlusionTileSize - 1);
+      int tileY0 = std::max(y0, ty * occlusionTileSize);
+      int tileY1 = std::min(y1, (ty + 1) * occlusionTileSize - 1);
+      for (int y = tileY0; y <= tileY1; ++y) {
+        const float *row = _buffer.Depth.data() + (size_t)y * _buffer.Width;
+        for (int x = tileX0; x <= tileX1; ++x) {
+          if (row[x] <= maxDepth) {
+            return false;
+          }
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
+} // namespace bb
@@ -0,0 +1,80 @@
+#pragma once
+#include "vertex.h"
+#include "job.h"
+#include <vector>
+
+namespace bb {
+
+// Software occlusion culling. Occluders are rasterized into a small depth
+// buffer on the CPU, and bounding boxes are then tested against it before
+// any draw is recorded. Nothing here touches the GPU.
+
+constexpr int occlusionBufferWidth = 256;
+constexpr int occlusionBufferHeight = 128;
+constexpr int occlusionTileSize = 8;
+
+// Positions only; usually a simplified version of the drawn mesh.
+struct OccluderMesh {
+  std::vector<Float3> Positions;
+  std::vector<uint32_t> Indices;
+};
+
+// Simplifies the triangles in _indices[_firstIndex, _firstIndex + _numIndices)
+// by clustering vertices on a grid of _gridResolution^3 cells over their
+// bounds. Each cluster collapses to the average of its vertices, which is at
+// most a cell diagonal away from any of them, and is then pushed inward along
+// their average normal by that diagonal. For closed meshes thicker than two
+// cells, the result thus stays inside the source and never hides more than
+// it does. Clusters whose normals cancel out, as on thin sheets, are dropped
+// along with their triangles.
+OccluderMesh simplifyOccluder(const Vertex *_vertices, const uint32_t *_indices,
+                              uint32_t _firstIndex, uint32_t _numIndices,
+                              int _gridResolution);
+
+struct OccluderInstance {
+  const OccluderMesh *Mesh;
+  Mat4 ModelViewProj;
+  // Written to the id buffer where this occluder is the closest, if one is
+  // passed to rasterizeOccluders().
+  uint32_t Id;
+};
+
+// Reverse-Z like the renderer: 1 at the near plane, 0 at the far plane.
+// Larger values are closer.
+struct OcclusionBuffer {
+  int Width;
+  int Height;
+  std::vector<float> Depth;
+  // Depth at pixel centers, which conservative coverage erodes into Depth.
+  std::vector<float> CenterDepth;
+
+  // Farthest depth of each occlusionTileSize^2 tile, so that tests can skip
+  // tiles that occlude everything behind a given depth.
+  int NumTilesX;
+  int NumTilesY;
+  std::vector<float> TileMinDepth;
+};
+
+// _width must be a multiple of 4 and of occlusionTileSize.
+OcclusionBuffer createOcclusionBuffer(int _width, int _height);
+
+// Conservative coverage only keeps pixels that the occluders cover entirely,
+// at the farthest depth they have within them, so that the buffer never
+// hides more than the occluders do. PixelCenter samples pixel centers, as the
+// GPU does, for measuring what is actually visible.
+enum class OcclusionCoverage { Conservative, PixelCenter };
+
+// Clears the buffer and rasterizes every occluder, in bands of rows spread
+// across the job system. With _ids, the buffer of _width * _height receives
+// the Id of the closest occluder per pixel, or 0 where nothing was drawn.
+void rasterizeOccluders(
+    JobSystem &_jobSystem, OcclusionBuffer &_buffer,
+    const std::vector<OccluderInstance> &_occluders, uint32_t *_ids = nullptr,
+    OcclusionCoverage _coverage = OcclusionCoverage::Conservative);
+
+// True if every pixel the box covers holds a closer occluder. Boxes crossing
+// the near plane are never occluded.
+bool isAABBOccluded(const OcclusionBuffer &_buffer, const Mat4 &_modelViewProj,
+                    const AABB &_bounds);
+
+} // namespace bb
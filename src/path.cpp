@@ -0,0 +1,105 @@
+#include "path.h"
+#include <algorithm>
+#include <vector>
+
+namespace bb {
+
+bool isPathSeparator(char _ch) { return (_ch == '\\') || (_ch == '/'); }
+
+static void replaceSeparatorsWithNative(std::string &_str, int _offset = 0) {
+  std::replace_if(_str.begin() + _offset, _str.end(), isPathSeparator,
+                  nativePathSeparator);
+}
+
+std::string_view trimPathSeparators(std::string_view _str) {
+  bool isValidPath = false;
+  int trimBegin = 0;
+  int trimEnd = 0;
+  for (int i = 0; i < (int)_str.length(); ++i) {
+    if (!isPathSeparator(_str[i])) {
+      trimBegin = i;
+      isValidPath = true;
+      break;
+    }
+  }
+  if (!isValidPath) {
+    return {};
+  }
+  for (int i = (int)_str.length() - 1; i >= 0; --i) {
+    if (!isPathSeparator(_str[i])) {
+      trimEnd = i + 1;
+      break;
+    }
+  }
+
+  return _str.substr(trimBegin, trimEnd - trimBegin);
+}
+
+// Removes ".." s. Leading ones, which have nothing to remove, are kept.
+static std::string simplifyPath(std::string_view _path) {
+  std::vector<std::string_view> dirs;
+  dirs.reserve(_path.size());
+
+  size_t lastAppendedIndex = 0;
+  for (size_t i = 0; i <= _path.length(); ++i) {
+    if (i == _path.length() || isPathSeparator(_path[i])) {
+      std::string_view dir =
+          _path.substr(lastAppendedIndex, i - lastAppendedIndex);
+      lastAppendedIndex = i + 1;
+      if (dir == ".." && !dirs.empty() && dirs.back() != "..") {
+        dirs.pop_back();
+      } else {
+        dirs.push_back(dir);
+      }
+    }
+  }
+
+  std::string result;
+  result.reserve(_path.size());
+  size_t i = 0;
+  for (const std::string_view &dir : dirs) {
+    result += dir;
+    if (i < dirs.size() - 1) {
+      result += nativePathSeparator;
+    }
+    ++i;
+  }
+
+  return result;
+}
+
+bool isAbsolutePath(std::string_view _path) {
+  return (_path.length() >= 2) && (_path[1] == ':');
+}
+
+std::string joinPaths(std::string_view _a, std::string_view _b) {
+  std::string joined;
+  joined.reserve((_a.size() + _b.size()) * 2);
+  // Absolute paths off Windows start with their separator.
+  if (!_a.empty() && isPathSeparator(_a[0])) {
+    joined += nativePathSeparator;
+  }
+  _a = trimPathSeparators(_a);
+  _b = trimPathSeparators(_b);
+  joined += _a;
+  joined += nativePathSeparator;
+  joined += _b;
+  replaceSeparatorsWithNative(joined);
+  joined = simplifyPath(joined);
+  return joined;
+}
+
+std::string getFileName(std::string_view _path) {
+  int i = (int)_path.length() - 1;
+  for (; i >= 0; --i) {
+    if (isPathSeparator(_path[i])) {
+      break;
+    }
+  }
+
+  std::string fileName(_path.substr(i + 1));
+
+  return fileName;
+}
+
+} // namespace bb
@@ -0,0 +1,23 @@
+#pragma once
+#include <string>
+#include <string_view>
+
+namespace bb {
+
+// Path utilities, free of platform headers and the renderer.
+
+#ifdef BB_WINDOWS
+inline static const char nativePathSeparator = '\\';
+#else
+inline static const char nativePathSeparator = '/';
+#endif
+
+bool isPathSeparator(char _ch);
+std::string_view trimPathSeparators(std::string_view _str);
+
+bool isAbsolutePath(std::string_view _path);
+// Joins with the native separator and resolves "..".
+std::string joinPaths(std::string_view _a, std::string_view _b);
+std::string getFileName(std::string_view _path);
+
+} // namespace bb
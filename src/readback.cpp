@@ -0,0 +1,286 @@
+#include "readback.h"
+#include "frame_encode.h"
+#include "util.h"
+
+namespace bb {
+
+static EnumArray<ReadbackFormat, const char *> readbackFileExtensions = {
+    "png", "rgba", "y4m"};
+
+bool isReadbackFormatSupported(VkFormat _format) {
+  return _format == VK_FORMAT_R8G8B8A8_UNORM ||
+         _format == VK_FORMAT_R8G8B8A8_SRGB ||
+         _format == VK_FORMAT_B8G8R8A8_UNORM ||
+         _format == VK_FORMAT_B8G8R8A8_SRGB;
+}
+
+static bool isBGRAFormat(VkFormat _format) {
+  return _format == VK_FORMAT_B8G8R8A8_UNORM ||
+         _format == VK_FORMAT_B8G8R8A8_SRGB;
+}
+
+//
+// Encoding
+//
+
+static void encodeSlot(FrameReadback &_readback, ReadbackSlot &_slot) {
+  // The fence has signaled by now. Harmless on coherent memory.
+  VkMappedMemoryRange range = {};
+  range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+  range.memory = _slot.StagingBuffer.Memory;
+  range.size = VK_WHOLE_SIZE;
+  BB_VK_ASSERT(
+      vkInvalidateMappedMemoryRanges(_readback.Renderer->Device, 1, &range));
+
+  const uint8_t *texels = (const uint8_t *)_slot.MappedData;
+  bool isBGRA = isBGRAFormat(_slot.Format);
+
+  if (_readback.Format == ReadbackFormat::Y4M) {
+    writeY4MFrame(_readback.StreamFile, texels, _slot.Extent.width,
+                  _slot.Extent.height, isBGRA);
+    return;
+  }
+
+  std::string filePath = fmt::format(
+      "{}{:05}.{}", _readback.OutputPrefix, _slot.FrameNumber,
+      readbackFileExtensions[_readback.Format]);
+  FILE *f = fopen(filePath.c_str(), "wb");
+  if (!f) {
+    BB_LOG_ERROR("Failed to write {}", filePath);
+    return;
+  }
+  if (_readback.Format == ReadbackFormat::PNG) {
+    writePNG(f, texels, _slot.Extent.width, _slot.Extent.height, isBGRA);
+  } else {
+    writeRaw(f, texels, _slot.Extent.width, _slot.Extent.height, isBGRA);
+  }
+  fclose(f);
+}
+
+static void runEncoder(FrameReadback &_readback) {
+  std::unique_lock<std::mutex> lock(_readback.QueueMutex);
+  while (true) {
+    _readback.QueueCondition.wait(lock, [&]() {
+      return !_readback.Queue.empty() || _readback.IsShuttingDown;
+    });
+    if (_readback.Queue.empty()) {
+      return;
+    }
+
+    ReadbackSlot &slot = _readback.Slots[_readback.Queue.front()];
+    _readback.Queue.pop_front();
+    _readback.IsEncoding = true;
+    lock.unlock();
+
+    Time startTime = getCurrentTime();
+    encodeSlot(_readback, slot);
+    _readback.LastEncodeMs =
+        getElapsedTimeInSeconds(startTime, getCurrentTime()) * 1000.f;
+    ++_readback.NumWritten;
+    if (_readback.FrameNumber > slot.FrameNumber + numReadbackSlots) {
+      ++_readback.NumLate;
+    }
+    slot.State = ReadbackSlotState::Free;
+
+    lock.lock();
+    _readback.IsEncoding = false;
+    _readback.IdleCondition.notify_all();
+  }
+}
+
+//
+// Capturing
+//
+
+void initFrameReadback(FrameReadback &_readback, const Renderer &_renderer) {
+  _readback.Renderer = &_renderer;
+  _readback.Encoder = std::thread(runEncoder, std::ref(_readback));
+}
+
+void destroyFrameReadback(FrameReadback &_readback) {
+  if (_readback.IsCapturing) {
+    endFrameReadbackCapture(_readback);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(_readback.QueueMutex);
+    _readback.IsShuttingDown = true;
+  }
+  _readback.QueueCondition.notify_all();
+  _readback.Encoder.join();
+
+  for (ReadbackSlot &slot : _readback.Slots) {
+    if (slot.StagingBuffer.Handle != VK_NULL_HANDLE) {
+      vkUnmapMemory(_readback.Renderer->Device, slot.StagingBuffer.Memory);
+      destroyBuffer(*_readback.Renderer, slot.StagingBuffer);
+    }
+  }
+}
+
+void beginFrameReadbackCapture(FrameReadback &_readback, ReadbackFormat _format,
+                               const std::string &_outputPrefix,
+                               uint32_t _frameRate) {
+  BB_ASSERT(!_readback.IsCapturing);
+  _readback.IsCapturing = true;
+  _readback.Format = _format;
+  _readback.OutputPrefix = _outputPrefix;
+  _readback.FrameRate = _frameRate;
+  _readback.StreamFile = nullptr;
+  _readback.StreamExtent = {};
+  _readback.FrameNumber = 0;
+  _readback.NumDropped = 0;
+  _readback.NumWritten = 0;
+  _readback.NumLate = 0;
+
+  if (_format == ReadbackFormat::Y4M) {
+    std::string filePath = fmt::format("{}.y4m", _outputPrefix);
+    _readback.StreamFile = fopen(filePath.c_str(), "wb");
+    if (!_readback.StreamFile) {
+      BB_LOG_ERROR("Failed to write {}", filePath);
+      _readback.IsCapturing = false;
+    }
+  }
+}
+
+// Hands the slots copied in frame in flight _frameIndex to the encoder, or all
+// of them if _frameIndex is UINT32_MAX.
+static void queueCopiedSlots(FrameReadback &_readback, uint32_t _frameIndex) {
+  bool hasQueued = false;
+  {
+    std::lock_guard<std::mutex> lock(_readback.QueueMutex);
+    // In ring order, which is the order the frames were rendered in.
+    for (uint32_t i = 0; i < numReadbackSlots; ++i) {
+      uint32_t slotIndex = (_readback.NextSlot + i) % numReadbackSlots;
+      ReadbackSlot &slot = _readback.Slots[slotIndex];
+      if (slot.State == ReadbackSlotState::Copying &&
+          (_frameIndex == UINT32_MAX || slot.FrameIndex == _frameIndex)) {
+        slot.State = ReadbackSlotState::Encoding;
+        _readback.Queue.push_back(slotIndex);
+        hasQueued = true;
+      }
+    }
+  }
+  if (hasQueued) {
+    _readback.QueueCondition.notify_one();
+  }
+}
+
+void endFrameReadbackCapture(FrameReadback &_readback) {
+  BB_ASSERT(_readback.IsCapturing);
+  vkDeviceWaitIdle(_readback.Renderer->Device);
+  queueCopiedSlots(_readback, UINT32_MAX);
+
+  {
+    std::unique_lock<std::mutex> lock(_readback.QueueMutex);
+    _readback.IdleCondition.wait(lock, [&]() {
+      return _readback.Queue.empty() && !_readback.IsEncoding;
+    });
+  }
+
+  if (_readback.StreamFile) {
+    fclose(_readback.StreamFile);
+    _readback.StreamFile = nullptr;
+  }
+  _readback.IsCapturing = false;
+}
+
+void collectFrameReadbacks(FrameReadback &_readback, uint32_t _frameIndex) {
+  _readback.FrameIndex = _frameIndex;
+  if (_readback.IsCapturing) {
+    queueCopiedSlots(_readback, _frameIndex);
+  }
+}
+
+void recordFrameReadback(FrameReadback &_readback, VkCommandBuffer _cmdBuffer,
+                         VkImage _image, VkImageLayout _layout,
+                         VkExtent2D _extent, VkFormat _format) {
+  BB_ASSERT(_readback.IsCapturing && isReadbackFormatSupported(_format));
+  uint64_t frameNumber = _readback.FrameNumber++;
+
+  // A stream can't change its extent.
+  if (_readback.Format == ReadbackFormat::Y4M) {
+    if (_readback.StreamExtent.width == 0) {
+      _readback.StreamExtent = _extent;
+      writeY4MHeader(_readback.StreamFile, _extent.width, _extent.height,
+                     _readback.FrameRate);
+    } else if (_readback.StreamExtent.width != _extent.width ||
+               _readback.StreamExtent.height != _extent.height) {
+      ++_readback.NumDropped;
+      return;
+    }
+  }
+
+  ReadbackSlot &slot = _readback.Slots[_readback.NextSlot];
+  if (slot.State != ReadbackSlotState::Free) {
+    ++_readback.NumDropped;
+    return;
+  }
+  _readback.NextSlot = (_readback.NextSlot + 1) % numReadbackSlots;
+
+  const Renderer &renderer = *_readback.Renderer;
+  VkDeviceSize size = (VkDeviceSize)_extent.width * _extent.height * 4;
+  if (slot.StagingBuffer.Size < size) {
+    if (slot.StagingBuffer.Handle != VK_NULL_HANDLE) {
+      vkUnmapMemory(renderer.Device, slot.StagingBuffer.Memory);
+      destroyBuffer(renderer, slot.StagingBuffer);
+    }
+    // Uncached memory makes the encoder's reads crawl. Cached memory may not
+    // be coherent, which the encoder makes up for by invalidating.
+    slot.StagingBuffer =
+        createBuffer(renderer, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                     VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+    BB_VK_ASSERT(vkMapMemory(renderer.Device, slot.StagingBuffer.Memory, 0,
+                             size, 0, &slot.MappedData));
+  }
+  slot.State = ReadbackSlotState::Copying;
+  slot.FrameIndex = _readback.FrameIndex;
+  slot.FrameNumber = frameNumber;
+  slot.Extent = _extent;
+  slot.Format = _format;
+
+  VkImageMemoryBarrier imageBarrier = {};
+  imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  imageBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  imageBarrier.oldLayout = _layout;
+  imageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  imageBarrier.image = _image;
+  imageBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  imageBarrier.subresourceRange.levelCount = 1;
+  imageBarrier.subresourceRange.layerCount = 1;
+  vkCmdPipelineBarrier(_cmdBuffer,
+                       VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &imageBarrier);
+
+  VkBufferImageCopy region = {};
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.layerCount = 1;
+  region.imageExtent = {_extent.width, _extent.height, 1};
+  vkCmdCopyImageToBuffer(_cmdBuffer, _image,
+                         VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                         slot.StagingBuffer.Handle, 1, &region);
+
+  // Presentation waits on the semaphore, so the way back needs no access.
+  imageBarrier.srcAccessMask = 0;
+  imageBarrier.dstAccessMask = 0;
+  imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  imageBarrier.newLayout = _layout;
+  VkBufferMemoryBarrier bufferBarrier = {};
+  bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  bufferBarrier.buffer = slot.StagingBuffer.Handle;
+  bufferBarrier.size = VK_WHOLE_SIZE;
+  vkCmdPipelineBarrier(_cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_HOST_BIT |
+                           VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                       0, 0, nullptr, 1, &bufferBarrier, 1, &imageBarrier);
+}
+
+} // namespace bb
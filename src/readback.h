@@ -0,0 +1,105 @@
+#pragma once
+#include "render.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <stdio.h>
+#include <thread>
+
+namespace bb {
+
+// Gets rendered frames out of the app without stalling it. At the end of a
+// frame the image is copied into the next slot of a ring of host visible
+// buffers. The slot is only read once the fence of that frame signals, when
+// its frame in flight comes around again, and is then handed to an encoder
+// thread that writes it out. When the encoder falls behind and no slot is
+// free, frames are dropped and counted instead of waited for.
+
+enum class ReadbackFormat {
+  // One uncompressed RGB PNG per frame.
+  PNG,
+  // One file of tightly packed RGBA8 texels per frame.
+  Raw,
+  // One YUV 4:2:0 stream for the whole capture, playable as is.
+  Y4M,
+  COUNT
+};
+
+// Enough for the encoder to take a few frames longer than the GPU now and then
+// on top of the frames in flight.
+constexpr uint32_t numReadbackSlots = 8;
+
+enum class ReadbackSlotState : uint32_t { Free, Copying, Encoding };
+
+struct ReadbackSlot {
+  Buffer StagingBuffer;
+  void *MappedData;
+  std::atomic<ReadbackSlotState> State{ReadbackSlotState::Free};
+  // The frame in flight whose fence guards the copy.
+  uint32_t FrameIndex;
+  uint64_t FrameNumber;
+  VkExtent2D Extent;
+  VkFormat Format;
+};
+
+struct FrameReadback {
+  const struct Renderer *Renderer;
+  ReadbackSlot Slots[numReadbackSlots];
+  uint32_t NextSlot;
+
+  bool IsCapturing = false;
+  ReadbackFormat Format;
+  std::string OutputPrefix;
+  uint32_t FrameRate;
+  FILE *StreamFile;
+  VkExtent2D StreamExtent;
+
+  // Frames since the capture began, and the frame in flight being recorded.
+  std::atomic<uint64_t> FrameNumber{0};
+  uint32_t FrameIndex;
+
+  // Frames without a free slot, or of a different extent than the stream.
+  uint64_t NumDropped;
+  std::atomic<uint64_t> NumWritten{0};
+  // Written more than numReadbackSlots frames after they were rendered.
+  std::atomic<uint64_t> NumLate{0};
+  std::atomic<float> LastEncodeMs{0.f};
+
+  std::thread Encoder;
+  std::deque<uint32_t> Queue;
+  std::mutex QueueMutex;
+  std::condition_variable QueueCondition;
+  // Signaled whenever the encoder finishes a frame.
+  std::condition_variable IdleCondition;
+  bool IsEncoding = false;
+  bool IsShuttingDown = false;
+};
+
+void initFrameReadback(FrameReadback &_readback, const Renderer &_renderer);
+// Ends a running capture first.
+void destroyFrameReadback(FrameReadback &_readback);
+
+// Files are named _outputPrefix followed by the frame number. _frameRate is
+// only written to Y4M streams.
+void beginFrameReadbackCapture(FrameReadback &_readback, ReadbackFormat _format,
+                               const std::string &_outputPrefix,
+                               uint32_t _frameRate);
+// Waits for the device to be idle and every captured frame to be written.
+void endFrameReadbackCapture(FrameReadback &_readback);
+
+// Call once the fence of frame in flight _frameIndex has signaled, before
+// recording it again. Hands the frames it copied to the encoder.
+void collectFrameReadbacks(FrameReadback &_readback, uint32_t _frameIndex);
+
+// Copies _image, a single sample RGBA8 or BGRA8 image with transfer source
+// usage, into a free slot, leaving it in _layout. Records nothing when no
+// slot is free.
+void recordFrameReadback(FrameReadback &_readback, VkCommandBuffer _cmdBuffer,
+                         VkImage _image, VkImageLayout _layout,
+                         VkExtent2D _extent, VkFormat _format);
+
+bool isReadbackFormatSupported(VkFormat _format);
+
+} // namespace bb
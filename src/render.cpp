@@ -1,8 +1,16 @@
 #include "render.h"
+#include "capture.h"
 #include "resource.h"
+#include "asset_report.h"
+#include "block_codec.h"
+#include "descriptor_allocator.h"
 #include "type_conversion.h"
 #include "external/SDL2/SDL_vulkan.h"
 #include "external/stb_image.h"
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <unordered_map>
 
 namespace bb {
 
@@ -16,9 +24,12 @@ checkPhysicalDevice(VkPhysicalDevice _physicalDevice, VkSurfaceKHR _surface,
                     VkPhysicalDeviceFeatures *_outDeviceFeatures,
                     uint32_t *_outQueueFamilyIndex,
                     SwapChainSupportDetails *_outSwapChainSupportDetails);
+static bool getQueueFamily(VkPhysicalDevice _physicalDevice,
+                           VkSurfaceKHR _surface,
+                           uint32_t *_outQueueFamilyIndex);
 
 Renderer createRenderer(SDL_Window *_window) {
-  Renderer result;
+  Renderer result = {};
 
   VkApplicationInfo appinfo = {};
   appinfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
@@ -68,7 +79,9 @@ Renderer createRenderer(SDL_Window *_window) {
   std::vector<const char *> extensions;
   // TODO: ADD vk_win32_surface extension.
   unsigned numInstantExtensions = 0;
-  SDL_Vulkan_GetInstanceExtensions(_window, &numInstantExtensions, nullptr);
+  if (_window) {
+    SDL_Vulkan_GetInstanceExtensions(_window, &numInstantExtensions, nullptr);
+  }
   if (enableValidationLayers) {
     extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
   }
@@ -76,9 +89,11 @@ Renderer createRenderer(SDL_Window *_window) {
   unsigned numExtraInstantExtensions = extensions.size();
   extensions.resize(numExtraInstantExtensions + numInstantExtensions);
 
-  SDL_Vulkan_GetInstanceExtensions(_window, &numInstantExtensions,
-                                   extensions.data() +
-                                       numExtraInstantExtensions);
+  if (_window) {
+    SDL_Vulkan_GetInstanceExtensions(_window, &numInstantExtensions,
+                                     extensions.data() +
+                                         numExtraInstantExtensions);
+  }
 
   instanceCreateInfo.enabledExtensionCount = (uint32_t)extensions.size();
   instanceCreateInfo.ppEnabledExtensionNames = extensions.data();
@@ -106,9 +121,11 @@ Renderer createRenderer(SDL_Window *_window) {
                                                 &result.DebugMessenger));
   }
 
-  BB_VK_ASSERT(!SDL_Vulkan_CreateSurface(
-      _window, result.Instance,
-      &result.Surface)); // ! to convert SDL_bool to VkResult
+  if (_window) {
+    BB_VK_ASSERT(!SDL_Vulkan_CreateSurface(
+        _window, result.Instance,
+        &result.Surface)); // ! to convert SDL_bool to VkResult
+  }
 
   uint32_t numPhysicalDevices = 0;
   std::vector<VkPhysicalDevice> physicalDevices;
@@ -118,11 +135,23 @@ Renderer createRenderer(SDL_Window *_window) {
   BB_VK_ASSERT(vkEnumeratePhysicalDevices(result.Instance, &numPhysicalDevices,
                                           physicalDevices.data()));
 
-  std::vector<const char *> deviceExtensions = {
-      VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+  std::vector<const char *> deviceExtensions;
+  if (_window) {
+    deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+  }
 
   for (VkPhysicalDevice currentPhysicalDevice : physicalDevices) {
-    if (checkPhysicalDevice(currentPhysicalDevice, result.Surface,
+    // Without a window any device with a graphics queue will do, software
+    // ones included.
+    if (!_window) {
+      if (getQueueFamily(currentPhysicalDevice, VK_NULL_HANDLE,
+                         &result.QueueFamilyIndex)) {
+        vkGetPhysicalDeviceFeatures(currentPhysicalDevice,
+                                    &result.PhysicalDeviceFeatures);
+        result.PhysicalDevice = currentPhysicalDevice;
+        break;
+      }
+    } else if (checkPhysicalDevice(currentPhysicalDevice, result.Surface,
                             deviceExtensions, &result.PhysicalDeviceFeatures,
                             &result.QueueFamilyIndex,
                             &result.SwapChainSupportDetails)) {
@@ -132,6 +161,22 @@ Renderer createRenderer(SDL_Window *_window) {
   }
   BB_ASSERT(result.PhysicalDevice != VK_NULL_HANDLE);
 
+  if (_window) {
+    uint32_t numExtensions = 0;
+    vkEnumerateDeviceExtensionProperties(result.PhysicalDevice, nullptr,
+                                         &numExtensions, nullptr);
+    std::vector<VkExtensionProperties> extensions(numExtensions);
+    vkEnumerateDeviceExtensionProperties(result.PhysicalDevice, nullptr,
+                                         &numExtensions, extensions.data());
+    for (const VkExtensionProperties &extension : extensions) {
+      if (strcmp(extension.extensionName,
+                 VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME) == 0) {
+        deviceExtensions.push_back(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME);
+        result.SupportsDisplayTiming = true;
+      }
+    }
+  }
+
   std::unordered_map<uint32_t, VkQueue> queueMap;
   float queuePriority = 1.f;
   VkDeviceQueueCreateInfo queueCreateInfo = {};
@@ -148,6 +193,37 @@ Renderer createRenderer(SDL_Window *_window) {
   deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();
   deviceCreateInfo.pEnabledFeatures = &result.PhysicalDeviceFeatures;
 
+  // Features beyond Vulkan 1.0 can only be queried on 1.1 devices.
+  VkPhysicalDeviceMultiviewFeatures multiviewFeatures = {};
+  multiviewFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES;
+  {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(result.PhysicalDevice, &properties);
+    if (properties.apiVersion >= VK_API_VERSION_1_1) {
+      VkPhysicalDeviceFeatures2 features2 = {};
+      features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+      features2.pNext = &multiviewFeatures;
+      vkGetPhysicalDeviceFeatures2(result.PhysicalDevice, &features2);
+
+      VkPhysicalDeviceMultiviewProperties multiviewProperties = {};
+      multiviewProperties.sType =
+          VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_PROPERTIES;
+      VkPhysicalDeviceProperties2 properties2 = {};
+      properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+      properties2.pNext = &multiviewProperties;
+      vkGetPhysicalDeviceProperties2(result.PhysicalDevice, &properties2);
+      result.MaxMultiviewViewCount = multiviewProperties.maxMultiviewViewCount;
+    }
+  }
+  result.SupportsMultiview = multiviewFeatures.multiview == VK_TRUE;
+  if (result.SupportsMultiview) {
+    // Only plain multiview is used.
+    multiviewFeatures.multiviewGeometryShader = VK_FALSE;
+    multiviewFeatures.multiviewTessellationShader = VK_FALSE;
+    deviceCreateInfo.pNext = &multiviewFeatures;
+  }
+
   BB_VK_ASSERT(vkCreateDevice(result.PhysicalDevice, &deviceCreateInfo, nullptr,
                               &result.Device));
 
@@ -158,7 +234,9 @@ Renderer createRenderer(SDL_Window *_window) {
 
 void destroyRenderer(Renderer &_renderer) {
   vkDestroyDevice(_renderer.Device, nullptr);
-  vkDestroySurfaceKHR(_renderer.Instance, _renderer.Surface, nullptr);
+  if (_renderer.Surface != VK_NULL_HANDLE) {
+    vkDestroySurfaceKHR(_renderer.Instance, _renderer.Surface, nullptr);
+  }
   if (_renderer.DebugMessenger != VK_NULL_HANDLE) {
     vkDestroyDebugUtilsMessengerEXT(_renderer.Instance,
                                     _renderer.DebugMessenger, nullptr);
@@ -169,9 +247,9 @@ void destroyRenderer(Renderer &_renderer) {
 
 VKAPI_ATTR VkBool32 VKAPI_CALL
 vulkanDebugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT _severity,
-                    VkDebugUtilsMessageTypeFlagsEXT _type,
+                    [[maybe_unused]] VkDebugUtilsMessageTypeFlagsEXT _type,
                     const VkDebugUtilsMessengerCallbackDataEXT *_callbackData,
-                    void *_userData) {
+                    [[maybe_unused]] void *_userData) {
   printf("%s\n", _callbackData->pMessage);
   switch (_severity) {
   case VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT:
@@ -209,9 +287,13 @@ static bool getQueueFamily(VkPhysicalDevice _physicalDevice,
     VkQueueFlags flags = queueFamilyProperties[i].queueFlags;
     if (flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_TRANSFER_BIT |
                  VK_QUEUE_COMPUTE_BIT)) {
-      VkBool32 supportPresent = VK_FALSE;
-      vkGetPhysicalDeviceSurfaceSupportKHR(_physicalDevice, i, _surface,
-                                           &supportPresent);
+      // Without a surface there's nothing to present to.
+      VkBool32 supportPresent =
+          _surface == VK_NULL_HANDLE && (flags & VK_QUEUE_GRAPHICS_BIT);
+      if (_surface != VK_NULL_HANDLE) {
+        vkGetPhysicalDeviceSurfaceSupportKHR(_physicalDevice, i, _surface,
+                                             &supportPresent);
+      }
       if (supportPresent) {
         *_outQueueFamilyIndex = i;
         return true;
@@ -223,10 +305,19 @@ static bool getQueueFamily(VkPhysicalDevice _physicalDevice,
 }
 
 uint32_t findMemoryType(const Renderer &_renderer, uint32_t _typeFilter,
-                        VkMemoryPropertyFlags _properties) {
+                        VkMemoryPropertyFlags _properties,
+                        VkMemoryPropertyFlags _preferredProperties) {
   VkPhysicalDeviceMemoryProperties memProperties;
   vkGetPhysicalDeviceMemoryProperties(_renderer.PhysicalDevice, &memProperties);
 
+  VkMemoryPropertyFlags preferred = _properties | _preferredProperties;
+  for (uint32_t i = 0; i < memProperties.memoryTypeCount; ++i) {
+    if ((_typeFilter & (1 << i)) &&
+        ((memProperties.memoryTypes[i].propertyFlags & preferred) ==
+         preferred)) {
+      return i;
+    }
+  }
   for (uint32_t i = 0; i < memProperties.memoryTypeCount; ++i) {
     if ((_typeFilter & (1 << i)) &&
         ((memProperties.memoryTypes[i].propertyFlags & _properties) ==
@@ -385,6 +476,12 @@ SwapChain createSwapChain(const Renderer &_renderer, uint32_t _width,
       _renderer.SwapChainSupportDetails.chooseExtent(_width, _height);
   swapChainCreateInfo.imageArrayLayers = 1;
   swapChainCreateInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+  bool canCopyColorImages =
+      _renderer.SwapChainSupportDetails.Capabilities.supportedUsageFlags &
+      VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+  if (canCopyColorImages) {
+    swapChainCreateInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+  }
   swapChainCreateInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
   swapChainCreateInfo.preTransform =
       _renderer.SwapChainSupportDetails.Capabilities.currentTransform;
@@ -401,6 +498,7 @@ SwapChain createSwapChain(const Renderer &_renderer, uint32_t _width,
   SwapChain swapChain;
   swapChain.ColorFormat = swapChainCreateInfo.imageFormat;
   swapChain.Extent = swapChainCreateInfo.imageExtent;
+  swapChain.CanCopyColorImages = canCopyColorImages;
   BB_VK_ASSERT(vkCreateSwapchainKHR(_renderer.Device, &swapChainCreateInfo,
                                     nullptr, &swapChain.Handle));
 
@@ -499,7 +597,7 @@ void destroySwapChain(const Renderer &_renderer, SwapChain &_swapChain) {
   _swapChain = {};
 }
 
-Vertex::BindingDescs Vertex::getBindingDescs() {
+MeshVertexInput::BindingDescs MeshVertexInput::getBindingDescs() {
   BindingDescs bindingDescs = {};
   // Vertex
   bindingDescs[0].binding = 0;
@@ -513,13 +611,14 @@ Vertex::BindingDescs Vertex::getBindingDescs() {
   return bindingDescs;
 }
 
-Vertex::AttributeDescs Vertex::getAttributeDescs() {
+MeshVertexInput::AttributeDescs MeshVertexInput::getAttributeDescs() {
   AttributeDescs attributeDescs = {};
 
   int lastAttributeIndex = 0;
 
-  auto pushIntAttribute = [&](uint32_t _binding, int _numComponents,
-                              uint32_t _offset) {
+  [[maybe_unused]] auto pushIntAttribute = [&](uint32_t _binding,
+                                               int _numComponents,
+                                               uint32_t _offset) {
     BB_ASSERT(_numComponents >= 1 && _numComponents <= 4);
     VkFormat format;
     switch (_numComponents) {
@@ -601,6 +700,82 @@ Vertex::AttributeDescs Vertex::getAttributeDescs() {
   return attributeDescs;
 }
 
+static_assert(sizeof(VertexAttributes) == sizeof(Vertex) - sizeof(Float3) &&
+                  offsetof(Vertex, Pos) == 0,
+              "VertexAttributes must match Vertex without Pos");
+
+uint32_t getVertexFetchStride(VertexStreamLayout _layout, bool _positionOnly) {
+  if (_layout == VertexStreamLayout::Interleaved) {
+    // Position-only passes still pull whole interleaved vertices into cache.
+    return sizeof(Vertex);
+  }
+  return _positionOnly ? sizeof(Float3) : sizeof(Vertex);
+}
+
+struct VertexInputDescs {
+  std::vector<VkVertexInputBindingDescription> Bindings;
+  std::vector<VkVertexInputAttributeDescription> Attributes;
+};
+
+// Derives the other layouts from the interleaved descriptions, keeping
+// every location so that shaders don't care how the mesh is stored.
+static VertexInputDescs buildVertexInputDescs(VertexStreamLayout _layout,
+                                              bool _positionOnly) {
+  VertexInputDescs descs = {};
+  bool isSplit = (_layout == VertexStreamLayout::Split);
+
+  for (VkVertexInputBindingDescription binding : MeshVertexInput::Bindings) {
+    if (binding.binding == 0 && isSplit) {
+      binding.stride = sizeof(Float3);
+    }
+    descs.Bindings.push_back(binding);
+  }
+  if (isSplit && !_positionOnly) {
+    VkVertexInputBindingDescription binding = {};
+    binding.binding = vertexAttributesBinding;
+    binding.stride = sizeof(VertexAttributes);
+    binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    descs.Bindings.push_back(binding);
+  }
+
+  for (VkVertexInputAttributeDescription attribute :
+       MeshVertexInput::Attributes) {
+    if (attribute.binding == 0 && attribute.offset != offsetof(Vertex, Pos)) {
+      if (_positionOnly) {
+        continue;
+      }
+      if (isSplit) {
+        attribute.binding = vertexAttributesBinding;
+        attribute.offset -= offsetof(Vertex, UV);
+      }
+    }
+    descs.Attributes.push_back(attribute);
+  }
+
+  return descs;
+}
+
+void setVertexInput(PipelineParams &_params, VertexStreamLayout _layout,
+                    bool _positionOnly) {
+  static EnumArray<VertexStreamLayout, VertexInputDescs> fullDescs;
+  static EnumArray<VertexStreamLayout, VertexInputDescs> positionOnlyDescs;
+  static bool isInitialized = false;
+  if (!isInitialized) {
+    for (VertexStreamLayout layout : AllEnums<VertexStreamLayout>) {
+      fullDescs[layout] = buildVertexInputDescs(layout, false);
+      positionOnlyDescs[layout] = buildVertexInputDescs(layout, true);
+    }
+    isInitialized = true;
+  }
+
+  VertexInputDescs &descs =
+      _positionOnly ? positionOnlyDescs[_layout] : fullDescs[_layout];
+  _params.VertexInput.Bindings = descs.Bindings.data();
+  _params.VertexInput.NumBindings = (int)descs.Bindings.size();
+  _params.VertexInput.Attributes = descs.Attributes.data();
+  _params.VertexInput.NumAttributes = (int)descs.Attributes.size();
+}
+
 GizmoVertex::BindingDescs GizmoVertex::getBindingDescs() {
   BindingDescs bindingDescs = {};
 
@@ -662,7 +837,8 @@ LightSourceVertex::AttributeDescs LightSourceVertex::getAttributeDescs() {
 
 Buffer createBuffer(const Renderer &_renderer, VkDeviceSize _size,
                     VkBufferUsageFlags _usage,
-                    VkMemoryPropertyFlags _properties) {
+                    VkMemoryPropertyFlags _properties,
+                    VkMemoryPropertyFlags _preferredProperties) {
   Buffer result = {};
 
   VkBufferCreateInfo bufferCreateInfo = {};
@@ -682,7 +858,8 @@ Buffer createBuffer(const Renderer &_renderer, VkDeviceSize _size,
   allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
   allocInfo.allocationSize = memRequirements.size;
   allocInfo.memoryTypeIndex =
-      findMemoryType(_renderer, memRequirements.memoryTypeBits, _properties);
+      findMemoryType(_renderer, memRequirements.memoryTypeBits, _properties,
+                     _preferredProperties);
 
   BB_VK_ASSERT(
       vkAllocateMemory(_renderer.Device, &allocInfo, nullptr, &result.Memory));
@@ -733,7 +910,8 @@ void destroyBuffer(const Renderer &_renderer, Buffer &_buffer) {
 }
 
 void copyBuffer(const Renderer &_renderer, VkCommandPool _cmdPool,
-                Buffer &_dstBuffer, Buffer &_srcBuffer, VkDeviceSize _size) {
+                Buffer &_dstBuffer, Buffer &_srcBuffer, VkDeviceSize _size,
+                VkDeviceSize _dstOffset) {
   VkCommandBufferAllocateInfo cmdBufferAllocInfo = {};
   cmdBufferAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
   cmdBufferAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
@@ -750,7 +928,7 @@ void copyBuffer(const Renderer &_renderer, VkCommandPool _cmdPool,
 
   VkBufferCopy copyRegion = {};
   copyRegion.srcOffset = 0;
-  copyRegion.dstOffset = 0;
+  copyRegion.dstOffset = _dstOffset;
   copyRegion.size = _size;
   vkCmdCopyBuffer(cmdBuffer, _srcBuffer.Handle, _dstBuffer.Handle, 1,
                   &copyRegion);
@@ -777,8 +955,8 @@ Image createImage(const Renderer &_renderer, const ImageParams &_params) {
   imageCreateInfo.extent.width = _params.Width;
   imageCreateInfo.extent.height = _params.Height;
   imageCreateInfo.extent.depth = 1;
-  imageCreateInfo.mipLevels = 1;
-  imageCreateInfo.arrayLayers = 1;
+  imageCreateInfo.mipLevels = _params.NumMips;
+  imageCreateInfo.arrayLayers = _params.NumLayers;
   imageCreateInfo.format = _params.Format;
   imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
   imageCreateInfo.usage = _params.Usage;
@@ -809,45 +987,102 @@ Image createImage(const Renderer &_renderer, const ImageParams &_params) {
   VkImageViewCreateInfo imageViewCreateInfo = {};
   imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
   imageViewCreateInfo.image = image.Handle;
-  imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  imageViewCreateInfo.viewType = _params.NumLayers > 1
+                                     ? VK_IMAGE_VIEW_TYPE_2D_ARRAY
+                                     : VK_IMAGE_VIEW_TYPE_2D;
   imageViewCreateInfo.format = _params.Format;
-  imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  imageViewCreateInfo.subresourceRange.aspectMask = _params.Aspect;
   imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
-  imageViewCreateInfo.subresourceRange.levelCount = 1;
+  imageViewCreateInfo.subresourceRange.levelCount = _params.NumMips;
   imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
-  imageViewCreateInfo.subresourceRange.layerCount = 1;
+  imageViewCreateInfo.subresourceRange.layerCount = _params.NumLayers;
   BB_VK_ASSERT(vkCreateImageView(_renderer.Device, &imageViewCreateInfo,
                                  nullptr, &image.View));
 
   return image;
 }
 
+// Denormals flush to zero and NaNs become infinities, which is all image
+// data needs.
+static uint16_t floatToHalf(float _value) {
+  uint32_t bits;
+  memcpy(&bits, &_value, sizeof(bits));
+  uint32_t sign = (bits >> 16) & 0x8000;
+  int32_t exponent = (int32_t)((bits >> 23) & 0xff) - 127 + 15;
+  uint32_t mantissa = bits & 0x7fffff;
+  if (exponent <= 0) {
+    return (uint16_t)sign;
+  }
+  if (exponent >= 31) {
+    return (uint16_t)(sign | 0x7c00);
+  }
+  return (uint16_t)(sign | (exponent << 10) | (mantissa >> 13));
+}
+
 Image createImageFromFile(const Renderer &_renderer,
                           VkCommandPool _transientCmdPool,
                           const std::string &_filePath) {
   Image result = {};
+  AssetLoad load =
+      beginAssetLoad(AssetType::Texture, getAssetName(_filePath));
+  BB_DEFER(endAssetLoad(load));
+
+  std::vector<uint8_t> contents;
+  if (!readFile(_filePath, contents))
+    return {};
+  load.NumBytesRead = contents.size();
+  markAssetLoadStage(load, AssetLoadStage::Read);
 
   Int2 textureDims = {};
   int numChannels;
-  stbi_uc *pixels = stbi_load(_filePath.c_str(), &textureDims.X, &textureDims.Y,
-                              &numChannels, STBI_rgb_alpha);
-  if (!pixels)
-    return {};
+  bool isHDR =
+      stbi_is_hdr_from_memory(contents.data(), (int)contents.size()) != 0;
+  VkFormat format =
+      isHDR ? VK_FORMAT_R16G16B16A16_SFLOAT : VK_FORMAT_R8G8B8A8_UNORM;
+  std::vector<uint16_t> halfPixels;
+  void *pixels;
+  if (isHDR) {
+    float *floatPixels = stbi_loadf_from_memory(
+        contents.data(), (int)contents.size(), &textureDims.X, &textureDims.Y,
+        &numChannels, STBI_rgb_alpha);
+    if (!floatPixels)
+      return {};
+    // Linear filtering of 32-bit floats is optional, of halves it isn't.
+    halfPixels.resize(textureDims.X * textureDims.Y * 4);
+    for (size_t i = 0; i < halfPixels.size(); ++i) {
+      halfPixels[i] = floatToHalf(floatPixels[i]);
+    }
+    stbi_image_free(floatPixels);
+    pixels = halfPixels.data();
+  } else {
+    pixels = stbi_load_from_memory(contents.data(), (int)contents.size(),
+                                   &textureDims.X, &textureDims.Y,
+                                   &numChannels, STBI_rgb_alpha);
+    if (!pixels)
+      return {};
+  }
 
-  VkDeviceSize textureSize = textureDims.X * textureDims.Y * 4;
+  VkDeviceSize textureSize = textureDims.X * textureDims.Y * 4 *
+                             (isHDR ? sizeof(uint16_t) : sizeof(stbi_uc));
+  load.NumDecodedBytes = textureSize;
+  markAssetLoadStage(load, AssetLoadStage::Decode);
 
   Buffer textureStagingBuffer =
       createBuffer(_renderer, textureSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
                        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  markAssetLoadStage(load, AssetLoadStage::Create);
 
   void *data;
   vkMapMemory(_renderer.Device, textureStagingBuffer.Memory, 0, textureSize, 0,
               &data);
   memcpy(data, pixels, textureSize);
   vkUnmapMemory(_renderer.Device, textureStagingBuffer.Memory);
+  markAssetLoadStage(load, AssetLoadStage::Stage);
 
-  stbi_image_free(pixels);
+  if (!isHDR) {
+    stbi_image_free(pixels);
+  }
 
   VkImageCreateInfo imageCreateInfo = {};
   imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -857,7 +1092,7 @@ Image createImageFromFile(const Renderer &_renderer,
   imageCreateInfo.extent.depth = 1;
   imageCreateInfo.mipLevels = 1;
   imageCreateInfo.arrayLayers = 1;
-  imageCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+  imageCreateInfo.format = format;
   imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
   imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
   imageCreateInfo.usage =
@@ -886,6 +1121,7 @@ Image createImageFromFile(const Renderer &_renderer,
 
   BB_VK_ASSERT(
       vkBindImageMemory(_renderer.Device, result.Handle, result.Memory, 0));
+  markAssetLoadStage(load, AssetLoadStage::Create);
 
   VkCommandBufferAllocateInfo cmdBufferAllocInfo = {};
   cmdBufferAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -951,6 +1187,8 @@ Image createImageFromFile(const Renderer &_renderer,
   BB_VK_ASSERT(vkQueueSubmit(_renderer.Queue, 1, &submitInfo, VK_NULL_HANDLE));
   BB_VK_ASSERT(vkQueueWaitIdle(_renderer.Queue));
   vkFreeCommandBuffers(_renderer.Device, _transientCmdPool, 1, &cmdBuffer);
+  load.Queue = (int)_renderer.QueueFamilyIndex;
+  markAssetLoadStage(load, AssetLoadStage::Submit);
 
   destroyBuffer(_renderer, textureStagingBuffer);
 
@@ -958,7 +1196,7 @@ Image createImageFromFile(const Renderer &_renderer,
   imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
   imageViewCreateInfo.image = result.Handle;
   imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-  imageViewCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+  imageViewCreateInfo.format = format;
   imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
   imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
   imageViewCreateInfo.subresourceRange.levelCount = 1;
@@ -966,6 +1204,7 @@ Image createImageFromFile(const Renderer &_renderer,
   imageViewCreateInfo.subresourceRange.layerCount = 1;
   BB_VK_ASSERT(vkCreateImageView(_renderer.Device, &imageViewCreateInfo,
                                  nullptr, &result.View));
+  markAssetLoadStage(load, AssetLoadStage::Create);
 
   return result;
 }
@@ -986,6 +1225,29 @@ VkPipelineShaderStageCreateInfo Shader::getStageInfo() const {
   return stageInfo;
 }
 
+// Names pipelines after their shaders in load reports.
+static std::mutex gShaderAssetNamesMutex;
+static std::unordered_map<VkShaderModule, std::string> gShaderAssetNames;
+
+static void setShaderAssetName(const Shader &_shader, std::string_view _name) {
+  std::lock_guard<std::mutex> lock(gShaderAssetNamesMutex);
+  gShaderAssetNames[_shader.Handle] = _name;
+}
+
+std::string getPipelineAssetName(const Shader *const *_shaders,
+                                 int _numShaders) {
+  std::lock_guard<std::mutex> lock(gShaderAssetNamesMutex);
+  std::string name;
+  for (int i = 0; i < _numShaders; ++i) {
+    auto it = gShaderAssetNames.find(_shaders[i]->Handle);
+    if (i > 0) {
+      name += '+';
+    }
+    name += it != gShaderAssetNames.end() ? it->second : "?";
+  }
+  return name;
+}
+
 Shader createShaderFromFile(const Renderer &_renderer,
                             const std::string &_filePath) {
   Shader result;
@@ -996,11 +1258,14 @@ Shader createShaderFromFile(const Renderer &_renderer,
     result.Stage = VK_SHADER_STAGE_FRAGMENT_BIT;
   } else if (endsWith(_filePath, ".geom.spv")) {
     result.Stage = VK_SHADER_STAGE_GEOMETRY_BIT;
+  } else if (endsWith(_filePath, ".comp.spv")) {
+    result.Stage = VK_SHADER_STAGE_COMPUTE_BIT;
   } else {
     BB_ASSERT(false);
   }
 
   std::string fileAbsPath = createShaderPath(_filePath);
+  AssetLoad load = beginAssetLoad(AssetType::Shader, getAssetName(_filePath));
 
   FILE *f = fopen(fileAbsPath.c_str(), "rb");
   BB_ASSERT(f);
@@ -1009,6 +1274,9 @@ Shader createShaderFromFile(const Renderer &_renderer,
   rewind(f);
   uint8_t *contents = new uint8_t[fileSize];
   fread(contents, sizeof(*contents), fileSize, f);
+  load.NumBytesRead = fileSize;
+  load.NumDecodedBytes = fileSize;
+  markAssetLoadStage(load, AssetLoadStage::Read);
 
   VkShaderModuleCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
@@ -1017,6 +1285,10 @@ Shader createShaderFromFile(const Renderer &_renderer,
 
   BB_VK_ASSERT(vkCreateShaderModule(_renderer.Device, &createInfo, nullptr,
                                     &result.Handle));
+  markAssetLoadStage(load, AssetLoadStage::Create);
+  endAssetLoad(load);
+  setShaderAssetName(result, load.Name);
+  trackShader(result, _filePath, contents, fileSize);
 
 #if BB_DEBUG
   {
@@ -1043,6 +1315,9 @@ void destroyShader(const Renderer &_renderer, Shader &_shader) {
 
 VkPipeline createPipeline(const Renderer &_renderer,
                           const PipelineParams &_params) {
+  AssetLoad load = beginAssetLoad(
+      AssetType::Pipeline,
+      getPipelineAssetName(_params.Shaders, _params.NumShaders));
   std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
   shaderStages.reserve(_params.NumShaders);
   for (int i = 0; i < _params.NumShaders; ++i) {
@@ -1083,9 +1358,16 @@ VkPipeline createPipeline(const Renderer &_renderer,
   VkPipelineViewportStateCreateInfo viewportState = {};
   viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
   viewportState.viewportCount = 1;
-  viewportState.pViewports = &viewport;
+  viewportState.pViewports = _params.Viewport.IsDynamic ? nullptr : &viewport;
   viewportState.scissorCount = 1;
-  viewportState.pScissors = &scissor;
+  viewportState.pScissors = _params.Viewport.IsDynamic ? nullptr : &scissor;
+
+  VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT,
+                                    VK_DYNAMIC_STATE_SCISSOR};
+  VkPipelineDynamicStateCreateInfo dynamicState = {};
+  dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dynamicState.dynamicStateCount = (uint32_t)std::size(dynamicStates);
+  dynamicState.pDynamicStates = dynamicStates;
 
   VkPipelineRasterizationStateCreateInfo rasterizationState = {};
   rasterizationState.sType =
@@ -1126,8 +1408,10 @@ VkPipeline createPipeline(const Renderer &_renderer,
 
   VkPipelineColorBlendAttachmentState colorBlendAttachmentState = {};
   colorBlendAttachmentState.colorWriteMask =
-      VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
-      VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+      _params.Blend.DisableColorWrites
+          ? 0
+          : VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
   colorBlendAttachmentState.blendEnable = VK_FALSE;
   colorBlendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
   colorBlendAttachmentState.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
@@ -1162,7 +1446,8 @@ VkPipeline createPipeline(const Renderer &_renderer,
   pipelineCreateInfo.pMultisampleState = &multisampleState;
   pipelineCreateInfo.pDepthStencilState = &depthStencilState;
   pipelineCreateInfo.pColorBlendState = &colorBlendState;
-  pipelineCreateInfo.pDynamicState = nullptr;
+  pipelineCreateInfo.pDynamicState =
+      _params.Viewport.IsDynamic ? &dynamicState : nullptr;
   pipelineCreateInfo.layout = _params.PipelineLayout;
   pipelineCreateInfo.renderPass = _params.RenderPass;
   pipelineCreateInfo.subpass = _params.Subpass;
@@ -1173,10 +1458,201 @@ VkPipeline createPipeline(const Renderer &_renderer,
   BB_VK_ASSERT(vkCreateGraphicsPipelines(_renderer.Device, VK_NULL_HANDLE, 1,
                                          &pipelineCreateInfo, nullptr,
                                          &pipeline));
+  markAssetLoadStage(load, AssetLoadStage::Create);
+  endAssetLoad(load);
+  trackPipeline(pipeline, _params);
 
   return pipeline;
 }
 
+ThumbnailAtlas
+createThumbnailAtlas(const Renderer &_renderer, VkCommandPool _cmdPool,
+                     const std::vector<std::vector<uint8_t>> &_tiles) {
+  ThumbnailAtlas atlas = {};
+  atlas.NumTiles = (uint32_t)_tiles.size();
+  atlas.NumTilesPerRow =
+      std::max((uint32_t)std::ceil(std::sqrt((float)atlas.NumTiles)), 1u);
+  atlas.NumRows = std::max(
+      (atlas.NumTiles + atlas.NumTilesPerRow - 1) / atlas.NumTilesPerRow, 1u);
+
+  uint32_t width = atlas.NumTilesPerRow * thumbnailExtent;
+  uint32_t height = atlas.NumRows * thumbnailExtent;
+
+  // Every mip level is stored back to back in a single staging buffer. Tiles
+  // are power of two sized, so each of them stays inside its own cell all the
+  // way down to 1x1 and mips never bleed into neighbouring tiles.
+  VkDeviceSize mipOffsets[thumbnailNumMips];
+  VkDeviceSize stagingSize = 0;
+  for (uint32_t mip = 0; mip < thumbnailNumMips; ++mip) {
+    mipOffsets[mip] = stagingSize;
+    stagingSize += (VkDeviceSize)(width >> mip) * (height >> mip) * 4;
+  }
+
+  Buffer stagingBuffer =
+      createBuffer(_renderer, stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                       VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+  {
+    uint8_t *staging;
+    vkMapMemory(_renderer.Device, stagingBuffer.Memory, 0, stagingSize, 0,
+                (void **)&staging);
+    memset(staging, 0, stagingSize);
+
+    for (uint32_t tile = 0; tile < atlas.NumTiles; ++tile) {
+      BB_ASSERT(_tiles[tile].size() == thumbnailExtent * thumbnailExtent * 4);
+      uint32_t col = tile % atlas.NumTilesPerRow;
+      uint32_t row = tile / atlas.NumTilesPerRow;
+
+      std::vector<uint8_t> level = _tiles[tile];
+      for (uint32_t mip = 0; mip < thumbnailNumMips; ++mip) {
+        uint32_t extent = thumbnailExtent >> mip;
+        if (mip > 0) {
+          uint32_t prevExtent = extent * 2;
+          std::vector<uint8_t> prevLevel = std::move(level);
+          level.resize(extent * extent * 4);
+          for (uint32_t y = 0; y < extent; ++y) {
+            for (uint32_t x = 0; x < extent; ++x) {
+              const uint8_t *src = &prevLevel[(y * 2 * prevExtent + x * 2) * 4];
+              for (uint32_t c = 0; c < 4; ++c) {
+                uint32_t sum = src[c] + src[4 + c] + src[prevExtent * 4 + c] +
+                               src[prevExtent * 4 + 4 + c];
+                level[(y * extent + x) * 4 + c] = (uint8_t)((sum + 2) / 4);
+              }
+            }
+          }
+        }
+
+        uint32_t levelWidth = width >> mip;
+        uint8_t *dst = staging + mipOffsets[mip] +
+                       ((size_t)row * extent * levelWidth + col * extent) * 4;
+        for (uint32_t y = 0; y < extent; ++y) {
+          memcpy(dst + (size_t)y * levelWidth * 4, &level[y * extent * 4],
+                 extent * 4);
+        }
+      }
+    }
+
+    vkUnmapMemory(_renderer.Device, stagingBuffer.Memory);
+  }
+
+  ImageParams params = {};
+  params.Format = VK_FORMAT_R8G8B8A8_UNORM;
+  params.Width = width;
+  params.Height = height;
+  params.Usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  params.NumMips = thumbnailNumMips;
+  atlas.Image = createImage(_renderer, params);
+
+  VkCommandBufferAllocateInfo cmdBufferAllocInfo = {};
+  cmdBufferAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  cmdBufferAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  cmdBufferAllocInfo.commandPool = _cmdPool;
+  cmdBufferAllocInfo.commandBufferCount = 1;
+
+  VkCommandBuffer cmdBuffer;
+  BB_VK_ASSERT(vkAllocateCommandBuffers(_renderer.Device, &cmdBufferAllocInfo,
+                                        &cmdBuffer));
+
+  VkCommandBufferBeginInfo cmdBeginInfo = {};
+  cmdBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  cmdBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  BB_VK_ASSERT(vkBeginCommandBuffer(cmdBuffer, &cmdBeginInfo));
+  VkImageMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.image = atlas.Image.Handle;
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barrier.subresourceRange.baseMipLevel = 0;
+  barrier.subresourceRange.levelCount = thumbnailNumMips;
+  barrier.subresourceRange.baseArrayLayer = 0;
+  barrier.subresourceRange.layerCount = 1;
+  vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &barrier);
+
+  VkBufferImageCopy regions[thumbnailNumMips] = {};
+  for (uint32_t mip = 0; mip < thumbnailNumMips; ++mip) {
+    VkBufferImageCopy &region = regions[mip];
+    region.bufferOffset = mipOffsets[mip];
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = mip;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = {0, 0, 0};
+    region.imageExtent = {width >> mip, height >> mip, 1};
+  }
+  vkCmdCopyBufferToImage(cmdBuffer, stagingBuffer.Handle, atlas.Image.Handle,
+                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                         (uint32_t)std::size(regions), regions);
+
+  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &barrier);
+  BB_VK_ASSERT(vkEndCommandBuffer(cmdBuffer));
+
+  VkSubmitInfo submitInfo = {};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &cmdBuffer;
+  BB_VK_ASSERT(vkQueueSubmit(_renderer.Queue, 1, &submitInfo, VK_NULL_HANDLE));
+  BB_VK_ASSERT(vkQueueWaitIdle(_renderer.Queue));
+  vkFreeCommandBuffers(_renderer.Device, _cmdPool, 1, &cmdBuffer);
+
+  destroyBuffer(_renderer, stagingBuffer);
+
+  VkSamplerCreateInfo samplerCreateInfo = {};
+  samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+  samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+  samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerCreateInfo.anisotropyEnable = VK_FALSE;
+  samplerCreateInfo.maxAnisotropy = 1.f;
+  samplerCreateInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+  samplerCreateInfo.unnormalizedCoordinates = VK_FALSE;
+  samplerCreateInfo.compareEnable = VK_FALSE;
+  samplerCreateInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+  samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+  samplerCreateInfo.mipLodBias = 0.f;
+  samplerCreateInfo.minLod = 0.f;
+  samplerCreateInfo.maxLod = (float)thumbnailNumMips;
+  BB_VK_ASSERT(vkCreateSampler(_renderer.Device, &samplerCreateInfo, nullptr,
+                               &atlas.Sampler));
+
+#if BB_DEBUG
+  labelGPUResource(_renderer, atlas.Image, "Thumbnail Atlas");
+#endif
+
+  return atlas;
+}
+
+void destroyThumbnailAtlas(const Renderer &_renderer, ThumbnailAtlas &_atlas) {
+  vkDestroySampler(_renderer.Device, _atlas.Sampler, nullptr);
+  destroyImage(_renderer, _atlas.Image);
+  _atlas = {};
+}
+
+void getThumbnailUVRect(const ThumbnailAtlas &_atlas, int _tile, Float2 &_uv0,
+                        Float2 &_uv1) {
+  Float2 tileSize = {1.f / (float)_atlas.NumTilesPerRow,
+                     1.f / (float)_atlas.NumRows};
+  _uv0.X = (float)((uint32_t)_tile % _atlas.NumTilesPerRow) * tileSize.X;
+  _uv0.Y = (float)((uint32_t)_tile / _atlas.NumTilesPerRow) * tileSize.Y;
+  _uv1.X = _uv0.X + tileSize.X;
+  _uv1.Y = _uv0.Y + tileSize.Y;
+}
+
 PBRMaterial createPBRMaterialFromFiles(const Renderer &_renderer,
                                        VkCommandPool _transientCmdPool,
                                        const std::string &_rootPath) {
@@ -1240,66 +1716,67 @@ void destroyPBRMaterial(const Renderer &_renderer, PBRMaterial &_material) {
   _material = {};
 }
 
+static const EnumArray<PBRMapType, const char *> gPBRMapFileNames = {
+    "albedo.png", "metallic.png", "roughness.png",
+    "ao.png",     "normal.png",   "height.png",
+};
+
 PBRMaterialSet createPBRMaterialSet(const Renderer &_renderer,
-                                    VkCommandPool _cmdPool) {
+                                    VkCommandPool _cmdPool,
+                                    const BlockDecompressor *_decompressor,
+                                    ImageLoadStats *_loadStats) {
   PBRMaterialSet materialSet = {};
 
   std::vector<std::string> pbrDirs;
 
-  {
-    WIN32_FIND_DATA fileFindData;
-    std::string pbrRoot = createCommonResourcePath("pbr/*");
-    HANDLE findHandle = FindFirstFileA(pbrRoot.c_str(), &fileFindData);
-
-    do {
-      if ((strcmp(fileFindData.cFileName, ".") != 0) &&
-          (strcmp(fileFindData.cFileName, "..") != 0) &&
-          (fileFindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
-
-        pbrDirs.push_back(
-            createCommonResourcePath(joinPaths("pbr", fileFindData.cFileName)));
-#if 0
-        PBRMaterial material = createPBRMaterialFromFiles(
-            _renderer, _cmdPool,
-            createCommonResourcePath(joinPaths("pbr", fileFindData.cFileName)));
-
-        if (strcmp(fileFindData.cFileName, "default") == 0) {
-          materialSet.DefaultMaterial = std::move(material);
-        } else {
-          materialSet.Materials.push_back(std::move(material));
-        }
-#endif
-      }
-    } while (FindNextFileA(findHandle, &fileFindData));
-    FindClose(findHandle);
+  for (const std::string &name :
+       listSubdirectories(createCommonResourcePath("pbr"))) {
+    pbrDirs.push_back(createCommonResourcePath(joinPaths("pbr", name)));
   }
 
   ImageLoader loader;
   BB_DEFER(destroyImageLoader(loader));
+  loader.Decompressor = _decompressor;
 
   materialSet.Materials.resize(pbrDirs.size());
+  std::vector<std::vector<uint8_t>> thumbnails(materialSet.Materials.size() *
+                                               PBRMaterial::NumImages);
   for (size_t i = 0; i < materialSet.Materials.size(); ++i) {
     PBRMaterial &material = materialSet.Materials[i];
 
     material.Name = getFileName(pbrDirs[i]);
 
-    enqueueImageLoadTask(loader, _renderer, joinPaths(pbrDirs[i], "albedo.png"),
-                         material.Maps[PBRMapType::Albedo]);
-    enqueueImageLoadTask(loader, _renderer,
-                         joinPaths(pbrDirs[i], "metallic.png"),
-                         material.Maps[PBRMapType::Metallic]);
-    enqueueImageLoadTask(loader, _renderer,
-                         joinPaths(pbrDirs[i], "roughness.png"),
-                         material.Maps[PBRMapType::Roughness]);
-    enqueueImageLoadTask(loader, _renderer, joinPaths(pbrDirs[i], "ao.png"),
-                         material.Maps[PBRMapType::AO]);
-    enqueueImageLoadTask(loader, _renderer, joinPaths(pbrDirs[i], "normal.png"),
-                         material.Maps[PBRMapType::Normal]);
-    enqueueImageLoadTask(loader, _renderer, joinPaths(pbrDirs[i], "height.png"),
-                         material.Maps[PBRMapType::Height]);
+    for (PBRMapType mapType : AllEnums<PBRMapType>) {
+      enqueueImageLoadTask(
+          loader, _renderer, joinPaths(pbrDirs[i], gPBRMapFileNames[mapType]),
+          material.Maps[mapType],
+          &thumbnails[i * PBRMaterial::NumImages + (size_t)mapType]);
+    }
   }
 
   finalizeAllImageLoads(loader, _renderer, _cmdPool);
+  if (_loadStats) {
+    *_loadStats = loader.Stats;
+  }
+
+  // Pack only the maps that actually exist.
+  std::vector<std::vector<uint8_t>> thumbnailTiles;
+  for (size_t i = 0; i < materialSet.Materials.size(); ++i) {
+    PBRMaterial &material = materialSet.Materials[i];
+    for (PBRMapType mapType : AllEnums<PBRMapType>) {
+      std::vector<uint8_t> &thumbnail =
+          thumbnails[i * PBRMaterial::NumImages + (size_t)mapType];
+      if (thumbnail.empty()) {
+        material.ThumbnailTiles[mapType] = -1;
+      } else {
+        material.ThumbnailTiles[mapType] = (int)thumbnailTiles.size();
+        thumbnailTiles.push_back(std::move(thumbnail));
+      }
+    }
+  }
+
+  materialSet.Thumbnails =
+      createThumbnailAtlas(_renderer, _cmdPool, thumbnailTiles);
 
   for (size_t i = 0; i < materialSet.Materials.size(); ++i) {
     PBRMaterial &material = materialSet.Materials[i];
@@ -1315,8 +1792,44 @@ PBRMaterialSet createPBRMaterialSet(const Renderer &_renderer,
   return materialSet;
 }
 
+void measurePBRMaterialSetLoad(const Renderer &_renderer,
+                               VkCommandPool _cmdPool,
+                               const PBRMaterialSet &_materialSet,
+                               const BlockDecompressor *_decompressor,
+                               bool _verifiesDecompression,
+                               ImageLoadStats &_loadStats) {
+  ImageLoader loader;
+  BB_DEFER(destroyImageLoader(loader));
+  loader.Decompressor = _decompressor;
+  loader.VerifiesDecompression = _verifiesDecompression;
+
+  std::vector<const PBRMaterial *> materials;
+  materials.push_back(&_materialSet.DefaultMaterial);
+  for (const PBRMaterial &material : _materialSet.Materials) {
+    materials.push_back(&material);
+  }
+  std::vector<Image> images(materials.size() * PBRMaterial::NumImages);
+  for (size_t i = 0; i < materials.size(); ++i) {
+    std::string dir =
+        createCommonResourcePath(joinPaths("pbr", materials[i]->Name));
+    for (PBRMapType mapType : AllEnums<PBRMapType>) {
+      enqueueImageLoadTask(
+          loader, _renderer, joinPaths(dir, gPBRMapFileNames[mapType]),
+          images[i * PBRMaterial::NumImages + (size_t)mapType]);
+    }
+  }
+
+  finalizeAllImageLoads(loader, _renderer, _cmdPool);
+  _loadStats = loader.Stats;
+
+  for (Image &image : images) {
+    destroyImage(_renderer, image);
+  }
+}
+
 void destroyPBRMaterialSet(const Renderer &_renderer,
                            PBRMaterialSet &_materialSet) {
+  destroyThumbnailAtlas(_renderer, _materialSet.Thumbnails);
   destroyPBRMaterial(_renderer, _materialSet.DefaultMaterial);
   for (PBRMaterial &material : _materialSet.Materials) {
     destroyPBRMaterial(_renderer, material);
@@ -1335,6 +1848,16 @@ Image getPBRMapOrDefault(const PBRMaterialSet &_materialSet, int _materialIndex,
   return *map;
 }
 
+int getPBRThumbnailOrDefault(const PBRMaterialSet &_materialSet,
+                             int _materialIndex, PBRMapType _mapType) {
+  int tile = _materialSet.Materials[_materialIndex].ThumbnailTiles[_mapType];
+  if (tile < 0) {
+    tile = _materialSet.DefaultMaterial.ThumbnailTiles[_mapType];
+  }
+
+  return tile;
+}
+
 EnumArray<SamplerType, VkSampler>
 createImmutableSamplers(const Renderer &_renderer) {
   EnumArray<SamplerType, VkSampler> immutableSamplers;
@@ -1367,9 +1890,79 @@ createImmutableSamplers(const Renderer &_renderer) {
   BB_VK_ASSERT(vkCreateSampler(_renderer.Device, &samplerCreateInfo, nullptr,
                                &immutableSamplers[SamplerType::Linear]));
 
+  // Reverse-Z, so a receiver is lit where it's at least as close as the
+  // stored occluder.
+  samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerCreateInfo.anisotropyEnable = VK_FALSE;
+  samplerCreateInfo.maxAnisotropy = 1.f;
+  samplerCreateInfo.compareEnable = VK_TRUE;
+  samplerCreateInfo.compareOp = VK_COMPARE_OP_GREATER_OR_EQUAL;
+  samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+
+  BB_VK_ASSERT(vkCreateSampler(_renderer.Device, &samplerCreateInfo, nullptr,
+                               &immutableSamplers[SamplerType::Shadow]));
+
   return immutableSamplers;
 }
 
+uint32_t getDescriptorInfoSize(VkDescriptorType _type) {
+  switch (_type) {
+  case VK_DESCRIPTOR_TYPE_SAMPLER:
+  case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+  case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+  case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+  case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+    return sizeof(VkDescriptorImageInfo);
+  case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+  case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+    return sizeof(VkBufferView);
+  default:
+    return sizeof(VkDescriptorBufferInfo);
+  }
+}
+
+void createDescriptorUpdateTemplate(const Renderer &_renderer,
+                                    DescriptorSetLayout &_layout) {
+  std::vector<VkDescriptorUpdateTemplateEntry> entries;
+  uint32_t offset = 0;
+  for (uint32_t i = 0; i < _layout.NumBindings; ++i) {
+    const DescriptorBinding &binding = _layout.Bindings[i];
+    if (binding.HasImmutableSamplers) {
+      continue;
+    }
+    VkDescriptorUpdateTemplateEntry entry = {};
+    entry.dstBinding = i;
+    entry.dstArrayElement = 0;
+    entry.descriptorCount = binding.NumDescriptors;
+    entry.descriptorType = binding.Type;
+    entry.offset = offset;
+    entry.stride = getDescriptorInfoSize(binding.Type);
+    entries.push_back(entry);
+    offset += entry.stride * binding.NumDescriptors;
+  }
+  BB_ASSERT(!entries.empty());
+
+  VkDescriptorUpdateTemplateCreateInfo templateInfo = {};
+  templateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+  templateInfo.descriptorUpdateEntryCount = (uint32_t)entries.size();
+  templateInfo.pDescriptorUpdateEntries = entries.data();
+  templateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+  templateInfo.descriptorSetLayout = _layout.Handle;
+  BB_VK_ASSERT(vkCreateDescriptorUpdateTemplate(
+      _renderer.Device, &templateInfo, nullptr, &_layout.UpdateTemplate));
+  _layout.UpdateTemplateDataSize = offset;
+}
+
+void destroyDescriptorSetLayout(const Renderer &_renderer,
+                                DescriptorSetLayout &_layout) {
+  vkDestroyDescriptorUpdateTemplate(_renderer.Device, _layout.UpdateTemplate,
+                                    nullptr);
+  vkDestroyDescriptorSetLayout(_renderer.Device, _layout.Handle, nullptr);
+  _layout = {};
+}
+
 StandardPipelineLayout createStandardPipelineLayout(const Renderer &_renderer) {
   StandardPipelineLayout layout = {};
 
@@ -1392,35 +1985,55 @@ StandardPipelineLayout createStandardPipelineLayout(const Renderer &_renderer) {
         bindingsTable = {{
             // PerFrame
             {
-                {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1},
+                {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, false},
                 {VK_DESCRIPTOR_TYPE_SAMPLER,
-                 (uint32_t)layout.ImmutableSamplers.size()},
-                {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, numGBufferAttachments},
-                {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1},
+                 (uint32_t)layout.ImmutableSamplers.size(), true},
+                {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, numGBufferAttachments,
+                 false},
+                {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1, false},
+                // Visibility buffer, its draw records and the vertex data
+                // it's resolved from
+                {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1, false},
+                {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, false},
+                {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                 EnumCount<VisibilityStorageBuffer>, false},
+                // Half resolution diffuse and the error measured against it
+                {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1, false},
+                {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, false},
+                // Shadow tiles per light and the atlas they're in
+                {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, false},
+                {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1, false},
+                // Lightmap of the current scene
+                {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1, false},
             },
             // PerView
             {
-                {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1},
+                {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, false},
+                // Views of the multiview capture
+                {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, false},
             },
             // PerMaterial
             {
                 {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
-                 (uint32_t)PBRMaterial::NumImages},
+                 (uint32_t)PBRMaterial::NumImages, false},
             },
             // PerDraw
-            {},
+            {
+                // Instances, for vertex shaders that pull their vertices
+                {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, false},
+            },
         }};
 
     for (auto frequency : AllEnums<DescriptorFrequency>) {
 
       uint32_t numBindings = 0;
 
-      for (auto [descriptorType, numDescriptors] : bindingsTable[frequency]) {
+      for (const DescriptorBinding &descriptorBinding :
+           bindingsTable[frequency]) {
         VkDescriptorSetLayoutBinding &binding = bindings[numBindings++];
-        binding.descriptorType = descriptorType;
-        binding.descriptorCount = numDescriptors;
-        if ((frequency == DescriptorFrequency::PerFrame) &&
-            (descriptorType == VK_DESCRIPTOR_TYPE_SAMPLER)) {
+        binding.descriptorType = descriptorBinding.Type;
+        binding.descriptorCount = descriptorBinding.NumDescriptors;
+        if (descriptorBinding.HasImmutableSamplers) {
           binding.pImmutableSamplers = layout.ImmutableSamplers.data();
         }
       }
@@ -1435,6 +2048,10 @@ StandardPipelineLayout createStandardPipelineLayout(const Renderer &_renderer) {
                 layout.DescriptorSetLayouts[frequency].Bindings);
       layout.DescriptorSetLayouts[frequency].NumBindings =
           bindingsTable[frequency].size();
+      if (!bindingsTable[frequency].empty()) {
+        createDescriptorUpdateTemplate(_renderer,
+                                       layout.DescriptorSetLayouts[frequency]);
+      }
     }
   }
 
@@ -1451,6 +2068,13 @@ StandardPipelineLayout createStandardPipelineLayout(const Renderer &_renderer) {
   pipelineLayoutCreateInfo.setLayoutCount =
       (uint32_t)descriptorSetLayouts.size();
   pipelineLayoutCreateInfo.pSetLayouts = descriptorSetLayouts.data();
+
+  VkPushConstantRange pushConstantRange = {};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = sizeof(StandardPushConstants);
+  pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+  pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
   vkCreatePipelineLayout(_renderer.Device, &pipelineLayoutCreateInfo, nullptr,
                          &layout.Handle);
 
@@ -1460,10 +2084,9 @@ StandardPipelineLayout createStandardPipelineLayout(const Renderer &_renderer) {
 void destroyStandardPipelineLayout(const Renderer &_renderer,
                                    StandardPipelineLayout &_layout) {
   vkDestroyPipelineLayout(_renderer.Device, _layout.Handle, nullptr);
-  for (const DescriptorSetLayout &descriptorSetLayout :
+  for (DescriptorSetLayout &descriptorSetLayout :
        _layout.DescriptorSetLayouts) {
-    vkDestroyDescriptorSetLayout(_renderer.Device, descriptorSetLayout.Handle,
-                                 nullptr);
+    destroyDescriptorSetLayout(_renderer, descriptorSetLayout);
   }
   for (VkSampler sampler : _layout.ImmutableSamplers) {
     vkDestroySampler(_renderer.Device, sampler, nullptr);
@@ -1471,106 +2094,29 @@ void destroyStandardPipelineLayout(const Renderer &_renderer,
   _layout = {};
 }
 
-VkDescriptorPool createStandardDescriptorPool(
-    const Renderer &_renderer, const StandardPipelineLayout &_layout,
-    const EnumArray<DescriptorFrequency, uint32_t> &_numSets) {
-
-  EnumArray<DescriptorFrequency, uint32_t> numTotalSets;
-  uint32_t numAllSets = 0;
-  for (DescriptorFrequency frequency : AllEnums<DescriptorFrequency>) {
-    if (frequency == DescriptorFrequency::PerFrame) {
-      numTotalSets[frequency] = _numSets[frequency];
-    } else {
-      numTotalSets[frequency] =
-          _numSets[frequency] * _numSets[DescriptorFrequency::PerFrame];
-    }
-    numAllSets += numTotalSets[frequency];
-  }
-
-  // Create a descriptor pool corresponding to the standard pipeline layout
-  VkDescriptorPool standardDescriptorPool;
-  {
-    std::unordered_map<VkDescriptorType, uint32_t> numDescriptorsTable;
-
-    for (DescriptorFrequency frequency : AllEnums<DescriptorFrequency>) {
-      const DescriptorSetLayout &descriptorSetLayout =
-          _layout.DescriptorSetLayouts[frequency];
-
-      for (uint32_t i = 0; i < descriptorSetLayout.NumBindings; ++i) {
-        const DescriptorBinding &binding = descriptorSetLayout.Bindings[i];
-        numDescriptorsTable[binding.Type] +=
-            binding.NumDescriptors * numTotalSets[frequency];
-      }
-    }
-
-    std::vector<VkDescriptorPoolSize> poolSizes;
-    poolSizes.reserve(numDescriptorsTable.size());
-    for (auto [type, num] : numDescriptorsTable) {
-      VkDescriptorPoolSize poolSize = {};
-      poolSize.type = type;
-      poolSize.descriptorCount = num;
-      poolSizes.push_back(poolSize);
-    }
-
-    VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {};
-    descriptorPoolCreateInfo.sType =
-        VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    descriptorPoolCreateInfo.poolSizeCount = (uint32_t)poolSizes.size();
-    descriptorPoolCreateInfo.pPoolSizes = poolSizes.data();
-
-    descriptorPoolCreateInfo.maxSets = numAllSets;
-    BB_VK_ASSERT(vkCreateDescriptorPool(_renderer.Device,
-                                        &descriptorPoolCreateInfo, nullptr,
-                                        &standardDescriptorPool));
-  }
-
-  return standardDescriptorPool;
-}
-
 Frame createFrame(
     const Renderer &_renderer,
     const StandardPipelineLayout &_standardPipelineLayout,
-    VkDescriptorPool _descriptorPool, const PBRMaterialSet &_materialSet,
+    DescriptorAllocator &_descriptorAllocator,
+    DescriptorSetCache &_descriptorSetCache,
+    const PBRMaterialSet &_materialSet,
     const VkImageView (&_gbufferAttachments)[numGBufferAttachments],
-    VkImageView _hdrAttachment) {
+    VkImageView _hdrAttachment, VkImageView _visibilityAttachment,
+    VkImageView _halfResDiffuseAttachment) {
   Frame frame = {};
 
-  // Allocate descriptor sets
-  {
-    VkDescriptorSetAllocateInfo descriptorSetAllocInfo = {};
-    descriptorSetAllocInfo.sType =
-        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    descriptorSetAllocInfo.descriptorPool = _descriptorPool;
-
-    descriptorSetAllocInfo.descriptorSetCount = 1;
-    descriptorSetAllocInfo.pSetLayouts =
-        &_standardPipelineLayout
-             .DescriptorSetLayouts[DescriptorFrequency::PerFrame]
-             .Handle;
-    BB_VK_ASSERT(vkAllocateDescriptorSets(
-        _renderer.Device, &descriptorSetAllocInfo, &frame.FrameDescriptorSet));
-
-    descriptorSetAllocInfo.descriptorSetCount = 1;
-    descriptorSetAllocInfo.pSetLayouts =
-        &_standardPipelineLayout
-             .DescriptorSetLayouts[DescriptorFrequency::PerView]
-             .Handle;
-    BB_VK_ASSERT(vkAllocateDescriptorSets(
-        _renderer.Device, &descriptorSetAllocInfo, &frame.ViewDescriptorSet));
-
-    std::vector<VkDescriptorSetLayout> materialDescriptorSetLayouts(
-        _materialSet.Materials.size(),
-        _standardPipelineLayout
-            .DescriptorSetLayouts[DescriptorFrequency::PerMaterial]
-            .Handle);
-    frame.MaterialDescriptorSets.resize(_materialSet.Materials.size());
-    descriptorSetAllocInfo.descriptorSetCount =
-        materialDescriptorSetLayouts.size();
-    descriptorSetAllocInfo.pSetLayouts = materialDescriptorSetLayouts.data();
-    BB_VK_ASSERT(vkAllocateDescriptorSets(_renderer.Device,
-                                          &descriptorSetAllocInfo,
-                                          frame.MaterialDescriptorSets.data()));
-  }
+  frame.FrameDescriptorSet = allocateDescriptorSet(
+      _renderer, _descriptorAllocator,
+      _standardPipelineLayout
+          .DescriptorSetLayouts[DescriptorFrequency::PerFrame]);
+  frame.ViewDescriptorSet = allocateDescriptorSet(
+      _renderer, _descriptorAllocator,
+      _standardPipelineLayout
+          .DescriptorSetLayouts[DescriptorFrequency::PerView]);
+  frame.MaterialDescriptorSets =
+      getMaterialDescriptorSets(_renderer, _descriptorSetCache,
+                                _descriptorAllocator, _standardPipelineLayout,
+                                _materialSet);
 
   frame.FrameUniformBuffer = createBuffer(
       _renderer, sizeof(FrameUniformBlock), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
@@ -1582,85 +2128,74 @@ Frame createFrame(
       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
           VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
-  // Link descriptor sets to actual resources
-  {
-    std::vector<VkWriteDescriptorSet> writeInfos;
-    VkWriteDescriptorSet writeInfo = {};
-    writeInfo.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-
-    // FrameData
-    writeInfo.dstSet = frame.FrameDescriptorSet;
-    writeInfo.dstBinding = 0;
-    writeInfo.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    writeInfo.descriptorCount = 1;
-    VkDescriptorBufferInfo frameUniformBufferInfo = {};
-    frameUniformBufferInfo.buffer = frame.FrameUniformBuffer.Handle;
-    frameUniformBufferInfo.offset = 0;
-    frameUniformBufferInfo.range = frame.FrameUniformBuffer.Size;
-    writeInfo.pBufferInfo = &frameUniformBufferInfo;
-    writeInfos.push_back(writeInfo);
-
-    // ViewData
-    writeInfo.dstSet = frame.ViewDescriptorSet;
-    writeInfo.dstBinding = 0;
-    writeInfo.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    writeInfo.descriptorCount = 1;
-    VkDescriptorBufferInfo viewUniformBufferInfo = {};
-    viewUniformBufferInfo.buffer = frame.ViewUniformBuffer.Handle;
-    viewUniformBufferInfo.offset = 0;
-    viewUniformBufferInfo.range = frame.ViewUniformBuffer.Size;
-    writeInfo.pBufferInfo = &viewUniformBufferInfo;
-    writeInfos.push_back(writeInfo);
-
-    // uMaterialTextures
-    std::vector<EnumArray<PBRMapType, VkDescriptorImageInfo>>
-        materialImagesInfos;
-    materialImagesInfos.reserve(_materialSet.Materials.size());
-    for (int i = 0; i < _materialSet.Materials.size(); ++i) {
-      EnumArray<PBRMapType, VkDescriptorImageInfo> imageInfos = {};
-      imageInfos[PBRMapType::Albedo].imageLayout =
-          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-      imageInfos[PBRMapType::Albedo].imageView =
-          getPBRMapOrDefault(_materialSet, i, PBRMapType::Albedo).View;
-      imageInfos[PBRMapType::Metallic].imageLayout =
-          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-      imageInfos[PBRMapType::Metallic].imageView =
-          getPBRMapOrDefault(_materialSet, i, PBRMapType::Metallic).View;
-      imageInfos[PBRMapType::Roughness].imageLayout =
-          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-      imageInfos[PBRMapType::Roughness].imageView =
-          getPBRMapOrDefault(_materialSet, i, PBRMapType::Roughness).View;
-      imageInfos[PBRMapType::AO].imageLayout =
-          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-      imageInfos[PBRMapType::AO].imageView =
-          getPBRMapOrDefault(_materialSet, i, PBRMapType::AO).View;
-      imageInfos[PBRMapType::Normal].imageLayout =
-          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-      imageInfos[PBRMapType::Normal].imageView =
-          getPBRMapOrDefault(_materialSet, i, PBRMapType::Normal).View;
-      imageInfos[PBRMapType::Height].imageLayout =
-          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-      imageInfos[PBRMapType::Height].imageView =
-          getPBRMapOrDefault(_materialSet, i, PBRMapType::Height).View;
+  frame.MultiviewUniformBuffer = createBuffer(
+      _renderer, sizeof(MultiviewUniformBlock),
+      VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
-      materialImagesInfos.push_back(imageInfos);
-    }
+  frame.VisibilityDrawBuffer =
+      createBuffer(_renderer, sizeof(VisibilityDraw) * maxNumVisibilityDraws,
+                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                       VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
-    int materialIndex = 0;
-    for (const auto &materialImagesInfo : materialImagesInfos) {
-      writeInfo.dstSet = frame.MaterialDescriptorSets[materialIndex++];
-      writeInfo.dstBinding = 0;
-      writeInfo.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
-      writeInfo.descriptorCount = PBRMaterial::NumImages;
-      writeInfo.pImageInfo = materialImagesInfo.data();
-      writeInfos.push_back(writeInfo);
-    }
+  frame.LightingErrorBuffer = createBuffer(
+      _renderer, sizeof(LightingErrorBlock), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  {
+    void *data;
+    vkMapMemory(_renderer.Device, frame.LightingErrorBuffer.Memory, 0,
+                sizeof(LightingErrorBlock), 0, &data);
+    memset(data, 0, sizeof(LightingErrorBlock));
+    vkUnmapMemory(_renderer.Device, frame.LightingErrorBuffer.Memory);
+  }
 
-    vkUpdateDescriptorSets(_renderer.Device, writeInfos.size(),
-                           writeInfos.data(), 0, nullptr);
+  frame.ShadowBuffer =
+      createBuffer(_renderer, sizeof(ShadowLightBlock) * MAX_NUM_LIGHTS,
+                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                       VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
-    linkExternalAttachmentsToDescriptorSet(_renderer, frame,
-                                           _gbufferAttachments, _hdrAttachment);
+  // Link descriptor sets to actual resources
+  {
+    auto getWholeBufferInfo = [](const Buffer &_buffer) {
+      VkDescriptorBufferInfo bufferInfo = {};
+      bufferInfo.buffer = _buffer.Handle;
+      bufferInfo.offset = 0;
+      bufferInfo.range = _buffer.Size;
+      return bufferInfo;
+    };
+
+    FrameDescriptors &descriptors = frame.Descriptors;
+    descriptors.FrameData = getWholeBufferInfo(frame.FrameUniformBuffer);
+    descriptors.VisibilityDraws =
+        getWholeBufferInfo(frame.VisibilityDrawBuffer);
+    descriptors.LightingError = getWholeBufferInfo(frame.LightingErrorBuffer);
+    descriptors.ShadowLights = getWholeBufferInfo(frame.ShadowBuffer);
+    // Placeholders until linked
+    for (VkDescriptorBufferInfo &bufferInfo : descriptors.VisibilityBuffers) {
+      bufferInfo = descriptors.VisibilityDraws;
+    }
+    VkImageView defaultView =
+        _materialSet.DefaultMaterial.Maps[PBRMapType::Albedo].View;
+    linkShadowAtlas(frame, defaultView);
+    linkLightmap(frame, defaultView);
+    linkExternalAttachmentsToDescriptorSet(
+        frame, _gbufferAttachments, _hdrAttachment, _visibilityAttachment,
+        _halfResDiffuseAttachment);
+    updateFrameDescriptorSet(_renderer, _standardPipelineLayout, frame);
+
+    ViewDescriptors viewDescriptors = {};
+    viewDescriptors.ViewData = getWholeBufferInfo(frame.ViewUniformBuffer);
+    viewDescriptors.MultiviewData =
+        getWholeBufferInfo(frame.MultiviewUniformBuffer);
+    updateDescriptorSet(
+        _renderer,
+        _standardPipelineLayout
+            .DescriptorSetLayouts[DescriptorFrequency::PerView],
+        frame.ViewDescriptorSet, viewDescriptors);
   }
 
   {
@@ -1681,185 +2216,155 @@ Frame createFrame(
                                           &frame.CmdBuffer));
   }
 
+  if (_renderer.PhysicalDeviceFeatures.pipelineStatisticsQuery) {
+    VkQueryPoolCreateInfo queryPoolCreateInfo = {};
+    queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolCreateInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+    queryPoolCreateInfo.queryCount = EnumCount<ScenePassStat>;
+    queryPoolCreateInfo.pipelineStatistics =
+        VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT;
+    BB_VK_ASSERT(vkCreateQueryPool(_renderer.Device, &queryPoolCreateInfo,
+                                   nullptr, &frame.ScenePassStatsQueryPool));
+  }
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(_renderer.PhysicalDevice, &properties);
+  if (properties.limits.timestampComputeAndGraphics) {
+    VkQueryPoolCreateInfo queryPoolCreateInfo = {};
+    queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolCreateInfo.queryCount = EnumCount<ScenePassTimestamp>;
+    BB_VK_ASSERT(vkCreateQueryPool(_renderer.Device, &queryPoolCreateInfo,
+                                   nullptr,
+                                   &frame.ScenePassTimestampQueryPool));
+  }
+
   return frame;
 }
 
 void destroyFrame(const Renderer &_renderer, Frame &_frame) {
+  vkDestroyQueryPool(_renderer.Device, _frame.ScenePassStatsQueryPool, nullptr);
+  vkDestroyQueryPool(_renderer.Device, _frame.ScenePassTimestampQueryPool,
+                     nullptr);
   vkDestroyCommandPool(_renderer.Device, _frame.CmdPool, nullptr);
 
+  destroyBuffer(_renderer, _frame.ShadowBuffer);
+  destroyBuffer(_renderer, _frame.LightingErrorBuffer);
+  destroyBuffer(_renderer, _frame.VisibilityDrawBuffer);
+  destroyBuffer(_renderer, _frame.MultiviewUniformBuffer);
   destroyBuffer(_renderer, _frame.ViewUniformBuffer);
   destroyBuffer(_renderer, _frame.FrameUniformBuffer);
   _frame = {};
 }
 
+static void linkImage(Frame &_frame, VkDescriptorImageInfo &_imageInfo,
+                      VkImageView _view) {
+  if (_imageInfo.imageView != _view) {
+    _imageInfo.imageView = _view;
+    _imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    _frame.HasDescriptorChanges = true;
+  }
+}
+
 void linkExternalAttachmentsToDescriptorSet(
-    const Renderer &_renderer, Frame &_frame,
+    Frame &_frame,
     const VkImageView (&_gbufferAttachments)[numGBufferAttachments],
-    VkImageView _hdrAttachment) {
-  std::vector<VkWriteDescriptorSet> writeInfos;
-
-  VkDescriptorImageInfo gbufferImageInfos[numGBufferAttachments] = {};
+    VkImageView _hdrAttachment, VkImageView _visibilityAttachment,
+    VkImageView _halfResDiffuseAttachment) {
+  FrameDescriptors &descriptors = _frame.Descriptors;
   for (size_t i = 0; i < numGBufferAttachments; ++i) {
-    gbufferImageInfos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    gbufferImageInfos[i].imageView = _gbufferAttachments[i];
-  }
-
-  VkWriteDescriptorSet writeInfo = {};
-  writeInfo.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-  writeInfo.dstSet = _frame.FrameDescriptorSet;
-  writeInfo.dstBinding = 2;
-  writeInfo.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
-  writeInfo.descriptorCount = std::size(gbufferImageInfos);
-  writeInfo.pImageInfo = gbufferImageInfos;
-  writeInfos.push_back(writeInfo);
-
-  VkDescriptorImageInfo hdrImageInfo = {};
-  hdrImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-  hdrImageInfo.imageView = _hdrAttachment;
-  writeInfo.dstBinding = 3;
-  writeInfo.descriptorCount = 1;
-  writeInfo.pImageInfo = &hdrImageInfo;
-  writeInfos.push_back(writeInfo);
-
-  vkUpdateDescriptorSets(_renderer.Device, writeInfos.size(), writeInfos.data(),
-                         0, nullptr);
+    linkImage(_frame, descriptors.GBuffer[i], _gbufferAttachments[i]);
+  }
+  linkImage(_frame, descriptors.HDR, _hdrAttachment);
+  linkImage(_frame, descriptors.Visibility, _visibilityAttachment);
+  linkImage(_frame, descriptors.HalfResDiffuse, _halfResDiffuseAttachment);
 }
 
-template <typename VertexContainer, typename IndexContainer>
-void appendMesh(std::vector<Vertex> &_dstVertices,
-                std::vector<uint32_t> &_dstIndices,
-                const VertexContainer &_srcVertices,
-                const IndexContainer &_srcIndices) {
-  uint32_t baseIndex = (uint32_t)_dstIndices.size();
-
-  _dstVertices.insert(_dstVertices.end(), std::begin(_srcVertices),
-                      std::end(_srcVertices));
-
-  for (uint32_t index : _srcIndices) {
-    _dstIndices.push_back(index + baseIndex);
+void linkVisibilityStorageBuffers(
+    Frame &_frame,
+    const EnumArray<VisibilityStorageBuffer, VkBuffer> &_buffers) {
+  for (VisibilityStorageBuffer buffer : AllEnums<VisibilityStorageBuffer>) {
+    VkDescriptorBufferInfo &bufferInfo =
+        _frame.Descriptors.VisibilityBuffers[buffer];
+    if (bufferInfo.buffer != _buffers[buffer] ||
+        bufferInfo.range != VK_WHOLE_SIZE) {
+      bufferInfo.buffer = _buffers[buffer];
+      bufferInfo.offset = 0;
+      bufferInfo.range = VK_WHOLE_SIZE;
+      _frame.HasDescriptorChanges = true;
+    }
   }
 }
 
-void generatePlaneMesh(std::vector<Vertex> &_vertices,
-                       std::vector<uint32_t> &_indices) {
-  // clang-format off
-  Vertex newVertices[] = {
-    {{-0.5f, 0, -0.5f}, {0, 0}, {0, 1, 0}, {1, 0, 0}},
-    {{-0.5f, 0,  0.5f}, {0, 1}, {0, 1, 0}, {1, 0, 0}},
-    {{ 0.5f, 0,  0.5f}, {1, 1}, {0, 1, 0}, {1, 0, 0}},
-    {{ 0.5f, 0, -0.5f}, {1, 0}, {0, 1, 0}, {1, 0, 0}},
-  };
-  // clang-format on
-
-  uint32_t newIndices[] = {0, 1, 2, 2, 3, 0};
-
-  appendMesh(_vertices, _indices, newVertices, newIndices);
+void linkShadowAtlas(Frame &_frame, VkImageView _shadowAtlas) {
+  linkImage(_frame, _frame.Descriptors.ShadowAtlas, _shadowAtlas);
 }
 
-void generateQuadMesh(std::vector<Vertex> &_vertices,
-                      std::vector<uint32_t> &_indices) {
-  // clang-format off
-  Vertex newVertices[] = {
-      {{-0.5f, -0.5f, 0}, {0, 0}, {0, 0, -1}, {1, 0, 0}},
-      {{-0.5f,  0.5f, 0}, {0, 1}, {0, 0, -1}, {1, 0, 0}},
-      {{ 0.5f,  0.5f, 0}, {1, 1}, {0, 0, -1}, {1, 0, 0}},
-      {{ 0.5f, -0.5f, 0}, {1, 0}, {0, 0, -1}, {1, 0, 0}}};
-  // clang-format on
-
-  uint32_t newIndices[] = {0, 1, 2, 2, 3, 0};
-
-  appendMesh(_vertices, _indices, newVertices, newIndices);
+void linkLightmap(Frame &_frame, VkImageView _lightmap) {
+  linkImage(_frame, _frame.Descriptors.Lightmap, _lightmap);
 }
 
-void generateUVSphereMesh(std::vector<Vertex> &_vertices,
-                          std::vector<uint32_t> &_indices, float _radius,
-                          int _horizontalDivision, int _verticalDivision) {
-  BB_ASSERT((_horizontalDivision >= 3) && (_verticalDivision >= 2));
-
-  Float3 top = {0, _radius, 0};
-  Float3 bottom = {0, -_radius, 0};
-
-  std::vector<Vertex> newVertices;
-  newVertices.reserve((_horizontalDivision + 1) * (_verticalDivision + 1));
-  std::vector<uint32_t> newIndices;
-  newIndices.reserve(6 * _horizontalDivision * (_verticalDivision - 1));
-
-  std::vector<Float3> tangents(_horizontalDivision);
-  for (int i = 0; i < _horizontalDivision; ++i) {
-    float rad = twoPi32 * ((float)i / (float)_horizontalDivision);
-    tangents[i] = Float3{-sinf(rad), 0, cosf(rad)}.normalize();
-  }
-
-  std::vector<Float3> topTangents(_horizontalDivision);
-  for (int i = 0; i < _horizontalDivision; ++i) {
-    float rad = twoPi32 * (((float)i + 0.5f) / (float)_horizontalDivision);
-    topTangents[i] = Float3{-sinf(rad), 0, cosf(rad)}.normalize();
-  }
-
-  std::vector<Float3> bottomTangents(_horizontalDivision);
-  for (int i = 0; i < _horizontalDivision; ++i) {
-    float rad = twoPi32 * (((float)i + 0.5f) / (float)_horizontalDivision);
-    bottomTangents[i] = Float3{-sinf(rad), 0, cosf(rad)}.normalize();
-  }
-
-  for (int v = 0; v <= _verticalDivision; ++v) {
-    float theta = -halfPi32 + pi32 * ((float)v / (float)_verticalDivision);
-    for (int h = 0; h <= _horizontalDivision; ++h) {
-      float phi = twoPi32 * ((float)h / (float)_horizontalDivision);
-
-      Vertex vertex = {};
-      vertex.Pos = sphericalToCartesian({_radius, theta, phi});
-      vertex.Normal = vertex.Pos.normalize();
-      vertex.UV.X = (float)h / (float)_horizontalDivision;
-      vertex.UV.Y = (float)v / (float)_verticalDivision;
-      if (v == 0) {
-        vertex.Tangent = bottomTangents[h % _horizontalDivision];
-      } else if (v == _verticalDivision) {
-        vertex.Tangent = topTangents[h % _horizontalDivision];
-      } else {
-        vertex.Tangent = tangents[h % _horizontalDivision];
-      }
-
-      newVertices.push_back(vertex);
-    }
+void updateFrameDescriptorSet(const Renderer &_renderer,
+                              const StandardPipelineLayout &_layout,
+                              Frame &_frame) {
+  if (!_frame.HasDescriptorChanges) {
+    return;
   }
+  updateDescriptorSet(
+      _renderer, _layout.DescriptorSetLayouts[DescriptorFrequency::PerFrame],
+      _frame.FrameDescriptorSet, _frame.Descriptors);
+  _frame.HasDescriptorChanges = false;
+}
 
-  for (int v = 0; v < _verticalDivision; ++v) {
-    for (int h = 0; h < _horizontalDivision; ++h) {
-      int baseIndex = (_horizontalDivision + 1) * v + h;
-      if (v < _verticalDivision - 1) {
-        newIndices.push_back(baseIndex);
-        newIndices.push_back(baseIndex + _horizontalDivision + 1);
-        newIndices.push_back(baseIndex + _horizontalDivision + 2);
-      }
-      if (v > 0) {
-        newIndices.push_back(baseIndex + _horizontalDivision + 2);
-        newIndices.push_back(baseIndex + 1);
-        newIndices.push_back(baseIndex);
-      }
+std::vector<VkDescriptorSet> getMaterialDescriptorSets(
+    const Renderer &_renderer, DescriptorSetCache &_cache,
+    DescriptorAllocator &_allocator, const StandardPipelineLayout &_layout,
+    const PBRMaterialSet &_materialSet) {
+  std::vector<VkDescriptorSet> descriptorSets(_materialSet.Materials.size());
+  for (size_t i = 0; i < _materialSet.Materials.size(); ++i) {
+    MaterialDescriptors descriptors = {};
+    for (PBRMapType mapType : AllEnums<PBRMapType>) {
+      descriptors.Maps[mapType].imageLayout =
+          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+      descriptors.Maps[mapType].imageView =
+          getPBRMapOrDefault(_materialSet, i, mapType).View;
     }
+    descriptorSets[i] = getCachedDescriptorSet(
+        _renderer, _cache, _allocator,
+        _layout.DescriptorSetLayouts[DescriptorFrequency::PerMaterial],
+        descriptors);
   }
+  return descriptorSets;
+}
 
-  for (size_t i = 0; i < newIndices.size(); i += 3) {
-    Vertex &v0 = newVertices[newIndices[i]];
-    Vertex &v1 = newVertices[newIndices[i + 1]];
-    Vertex &v2 = newVertices[newIndices[i + 2]];
+LightingErrorStats readLightingError(const Renderer &_renderer, Frame &_frame) {
+  void *data;
+  vkMapMemory(_renderer.Device, _frame.LightingErrorBuffer.Memory, 0,
+              sizeof(LightingErrorBlock), 0, &data);
+  LightingErrorBlock *block = (LightingErrorBlock *)data;
 
-    Float3 e0 = v2.Pos - v0.Pos;
-    Float3 e1 = v1.Pos - v0.Pos;
-    Float2 duv0 = v2.UV - v0.UV;
-    Float2 duv1 = v1.UV - v0.UV;
-    float f = 1.0f / (duv0.X * duv1.Y - duv1.X * duv0.Y);
+  uint64_t sumSquaredError = 0;
+  for (uint32_t bucket : block->SumSquaredError) {
+    sumSquaredError += bucket;
+  }
 
-    Float3 tangent = {f * (duv1.Y * e0.X - duv0.Y * e1.X),
-                      f * (duv1.Y * e0.Y - duv0.Y * e1.Y),
-                      f * (duv1.Y * e0.Z - duv0.Y * e1.Z)};
-    v0.Tangent = tangent;
-    v1.Tangent = tangent;
-    v2.Tangent = tangent;
+  LightingErrorStats stats = {};
+  stats.NumPixels = block->NumPixels;
+  stats.MaxError = block->MaxError;
+  if (stats.NumPixels > 0) {
+    double meanSquaredError = (double)sumSquaredError / (double)stats.NumPixels;
+    stats.RMSE = (float)std::sqrt(meanSquaredError);
+    stats.PSNR = meanSquaredError > 0
+                     ? (float)(10.0 * std::log10(255.0 * 255.0 /
+                                                 meanSquaredError))
+                     : INFINITY;
+    stats.VisibleErrorRatio =
+        (float)block->NumVisibleErrors / (float)stats.NumPixels;
   }
 
-  appendMesh(_vertices, _indices, newVertices, newIndices);
+  memset(block, 0, sizeof(LightingErrorBlock));
+  vkUnmapMemory(_renderer.Device, _frame.LightingErrorBuffer.Memory);
+  return stats;
 }
 
 #if BB_DEBUG
@@ -5,6 +5,10 @@
 // - Both are null references (either a null pointer or VK_ATTACHMENT_UNUSED)
 // - Color
 #include "vector_math.h"
+#include "vertex.h"
+#include "light.h"
+#include "material.h"
+#include "mesh_gen.h"
 #include "enum_array.h"
 #include "external/volk.h"
 #include "external/SDL2/SDL.h"
@@ -30,18 +34,31 @@ struct Renderer {
   VkPhysicalDevice PhysicalDevice;
   VkPhysicalDeviceFeatures PhysicalDeviceFeatures;
 
-  SwapChainSupportDetails
+  struct SwapChainSupportDetails
       SwapChainSupportDetails; // TODO(ilgwon): I'm not sure if this field has
                                // to belong to Renderer, because it's value
                                // changes when a window is resized.
   uint32_t QueueFamilyIndex;
   VkQueue Queue;
+
+  // VK_KHR_multiview, core since Vulkan 1.1, is enabled when the device has
+  // it.
+  bool SupportsMultiview;
+  uint32_t MaxMultiviewViewCount;
+
+  // VK_GOOGLE_display_timing is enabled when the device has it, to report
+  // when presented images reached the display.
+  bool SupportsDisplayTiming;
 };
 
+// A null _window creates a headless renderer, without a surface or swap chain
+// support, on the first device with a graphics queue.
 Renderer createRenderer(SDL_Window *_window);
 void destroyRenderer(Renderer &_renderer);
+// Prefers a type that also has _preferredProperties if there is one.
 uint32_t findMemoryType(const Renderer &_renderer, uint32_t _typeFilter,
-                        VkMemoryPropertyFlags _properties);
+                        VkMemoryPropertyFlags _properties,
+                        VkMemoryPropertyFlags _preferredProperties = 0);
 
 struct SwapChain {
   VkSwapchainKHR Handle;
@@ -54,6 +71,8 @@ struct SwapChain {
   uint32_t NumColorImages;
   std::vector<VkImage> ColorImages;
   std::vector<VkImageView> ColorImageViews;
+  // The color images have transfer source usage, for frame readback.
+  bool CanCopyColorImages;
   VkImage DepthImage;
   VkImageView DepthImageView;
   VkDeviceMemory DepthImageMemory;
@@ -64,8 +83,6 @@ SwapChain createSwapChain(const Renderer &_renderer, uint32_t _width,
                           const SwapChain *_oldSwapChain = nullptr);
 void destroySwapChain(const Renderer &_renderer, SwapChain &_swapChain);
 
-enum class LightType : int { Point = 0, Spot, Directional };
-
 enum class DeferredAttachmentType {
   Color,
   Depth,
@@ -73,8 +90,11 @@ enum class DeferredAttachmentType {
   GBufferNormal,
   GBufferAlbedo,
   GBufferMRAH,
-  GBufferMaterialIndex,
+  // Lightmap lighting in rgb, alpha 1 where a lightmap was sampled.
+  GBufferBakedLighting,
   HDR,
+  Visibility,
+  HalfResDiffuse,
   COUNT
 };
 constexpr uint32_t numGBufferAttachments =
@@ -83,6 +103,8 @@ constexpr uint32_t numGBufferAttachments =
 
 enum class DeferredSubpassType {
   GBufferWrite,
+  VisibilityWrite,
+  DiffuseLighting,
   Lighting,
   ForwardLighting,
   HDR,
@@ -92,10 +114,38 @@ enum class DeferredSubpassType {
 
 constexpr VkFormat gbufferAttachmentFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
 constexpr VkFormat hdrAttachmentFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
-
-struct InstanceBlock {
+constexpr VkFormat visibilityAttachmentFormat = VK_FORMAT_R32_UINT;
+
+// A visibility buffer texel packs the visibility draw id plus one into the
+// high bits and the triangle within the draw into the low bits. 0 means
+// nothing was drawn.
+constexpr uint32_t visibilityTriangleBits = 22;
+constexpr uint32_t maxNumVisibilityDraws =
+    (1u << (32 - visibilityTriangleBits)) - 1;
+
+enum class VisibilityIndexSource : uint32_t { GeometryPool, Scene };
+
+// Everything the visibility resolve needs to refetch a drawn triangle. The
+// visibility pass finds its record as the push constant plus
+// gl_InstanceIndex, so scenes push recordIndex - firstInstance before each
+// draw. Laid out for std430.
+struct VisibilityDraw {
   Mat4 ModelMat;
   Mat4 InvModelMat;
+  uint32_t FirstIndex;
+  int32_t VertexOffset;
+  VisibilityIndexSource IndexSource;
+  uint32_t Material;
+};
+
+// Storage buffers the visibility resolve reads vertices from. SceneIndices
+// is whatever index buffer the current scene draws from besides the pool's.
+enum class VisibilityStorageBuffer {
+  Positions,
+  Attributes,
+  PoolIndices,
+  SceneIndices,
+  COUNT
 };
 
 #define VERTEX_BINDINGS_DECL(numBindings)                                      \
@@ -109,16 +159,22 @@ struct InstanceBlock {
   static AttributeDescs getAttributeDescs();                                   \
   inline static AttributeDescs Attributes = getAttributeDescs();
 
-struct Vertex {
-  Float3 Pos;
-  Float2 UV;
-  Float3 Normal = {0, 0, -1};
-  Float3 Tangent = {0, -1, 0};
-
+// Vertex in binding 0, interleaved, and InstanceBlock in binding 1.
+struct MeshVertexInput {
   VERTEX_BINDINGS_DECL(2);
   VERTEX_ATTRIBUTES_DECL(12);
 };
 
+// Split stores positions in binding 0 and VertexAttributes in binding 2, so
+// that position-only passes fetch 12 bytes per vertex instead of
+// sizeof(Vertex). Instance data stays in binding 1 either way.
+enum class VertexStreamLayout { Interleaved, Split, COUNT };
+
+constexpr uint32_t vertexAttributesBinding = 2;
+
+// Number of bytes fetched per vertex from the per-vertex bindings.
+uint32_t getVertexFetchStride(VertexStreamLayout _layout, bool _positionOnly);
+
 struct GizmoVertex {
   Float3 Pos;
   Float3 Color;
@@ -143,7 +199,8 @@ struct Buffer {
 
 Buffer createBuffer(const Renderer &_renderer, VkDeviceSize _size,
                     VkBufferUsageFlags _usage,
-                    VkMemoryPropertyFlags _properties);
+                    VkMemoryPropertyFlags _properties,
+                    VkMemoryPropertyFlags _preferredProperties = 0);
 Buffer createStagingBuffer(const Renderer &_renderer, const Buffer &_orgBuffer);
 Buffer createDeviceLocalBufferFromMemory(const Renderer &_renderer,
                                          VkCommandPool _cmdPool,
@@ -152,7 +209,8 @@ Buffer createDeviceLocalBufferFromMemory(const Renderer &_renderer,
 
 void destroyBuffer(const Renderer &_renderer, Buffer &_buffer);
 void copyBuffer(const Renderer &_renderer, VkCommandPool _cmdPool,
-                Buffer &_dstBuffer, Buffer &_srcBuffer, VkDeviceSize _size);
+                Buffer &_dstBuffer, Buffer &_srcBuffer, VkDeviceSize _size,
+                VkDeviceSize _dstOffset = 0);
 
 struct Image {
   VkImage Handle;
@@ -165,9 +223,15 @@ struct ImageParams {
   uint32_t Width;
   uint32_t Height;
   VkImageUsageFlags Usage;
+  uint32_t NumMips = 1;
+  // The view of an image with more than one layer is a 2D array.
+  uint32_t NumLayers = 1;
+  VkImageAspectFlags Aspect = VK_IMAGE_ASPECT_COLOR_BIT;
 };
 
 Image createImage(const Renderer &_renderer, const ImageParams &_params);
+// Radiance .hdr files are loaded as R16G16B16A16_SFLOAT, anything else as
+// R8G8B8A8_UNORM.
 Image createImageFromFile(const Renderer &_renderer,
                           VkCommandPool _transientCmdPool,
                           const std::string &_filePath);
@@ -183,6 +247,9 @@ struct Shader {
 Shader createShaderFromFile(const Renderer &_renderer,
                             const std::string &_filePath);
 void destroyShader(const Renderer &_renderer, Shader &_shader);
+// The asset names of _shaders joined with '+', for pipeline load reports.
+std::string getPipelineAssetName(const Shader *const *_shaders,
+                                 int _numShaders);
 
 struct RenderPass {
   VkRenderPass Handle;
@@ -208,6 +275,9 @@ struct PipelineParams {
     Float2 Extent;
     Int2 ScissorOffset;
     Int2 ScissorExtent;
+    // Viewport and scissor are set with vkCmdSetViewport/vkCmdSetScissor
+    // instead, and the fields above are ignored.
+    bool IsDynamic;
   } Viewport;
 
   struct {
@@ -222,6 +292,7 @@ struct PipelineParams {
 
   struct {
     uint32_t NumColorBlends;
+    bool DisableColorWrites;
   } Blend;
 
   uint32_t Subpass;
@@ -230,22 +301,19 @@ struct PipelineParams {
   VkRenderPass RenderPass;
 };
 
+// Points _params.VertexInput at the Vertex and InstanceBlock input for
+// _layout. With _positionOnly, Pos is the only per-vertex attribute.
+void setVertexInput(PipelineParams &_params, VertexStreamLayout _layout,
+                    bool _positionOnly = false);
+
 VkPipeline createPipeline(const Renderer &_renderer,
                           const PipelineParams &_params);
-enum class PBRMapType {
-  Albedo,
-  Metallic,
-  Roughness,
-  AO,
-  Normal,
-  Height,
-  COUNT
-};
-
 struct PBRMaterial {
   static constexpr auto NumImages = EnumCount<PBRMapType>;
   std::string Name;
   EnumArray<PBRMapType, Image> Maps;
+  // Tile indices into PBRMaterialSet::Thumbnails. -1 if the map is missing.
+  EnumArray<PBRMapType, int> ThumbnailTiles;
 };
 
 PBRMaterial createPBRMaterialFromFiles(const Renderer &_renderer,
@@ -253,18 +321,53 @@ PBRMaterial createPBRMaterialFromFiles(const Renderer &_renderer,
                                        const std::string &_rootPath);
 void destroyPBRMaterial(const Renderer &_renderer, PBRMaterial &_material);
 
+constexpr uint32_t thumbnailExtent = 64;
+constexpr uint32_t thumbnailNumMips = 7; // 64x64 down to 1x1
+
+// Small mipmapped previews of every material map packed into one image, so
+// that GUI code can show them with a single descriptor.
+struct ThumbnailAtlas {
+  struct Image Image;
+  VkSampler Sampler;
+  uint32_t NumTilesPerRow;
+  uint32_t NumRows;
+  uint32_t NumTiles;
+};
+
+// Each element of _tiles is a thumbnailExtent x thumbnailExtent RGBA8 image.
+ThumbnailAtlas
+createThumbnailAtlas(const Renderer &_renderer, VkCommandPool _cmdPool,
+                     const std::vector<std::vector<uint8_t>> &_tiles);
+void destroyThumbnailAtlas(const Renderer &_renderer, ThumbnailAtlas &_atlas);
+void getThumbnailUVRect(const ThumbnailAtlas &_atlas, int _tile, Float2 &_uv0,
+                        Float2 &_uv1);
+
 struct PBRMaterialSet {
   std::vector<PBRMaterial> Materials;
   PBRMaterial DefaultMaterial;
+  ThumbnailAtlas Thumbnails;
 };
 
-PBRMaterialSet createPBRMaterialSet(const Renderer &_renderer,
-                                    VkCommandPool _cmdPool);
+// Maps are decompressed on the GPU if _decompressor is given, see
+// ImageLoader.
+PBRMaterialSet
+createPBRMaterialSet(const Renderer &_renderer, VkCommandPool _cmdPool,
+                     const struct BlockDecompressor *_decompressor = nullptr,
+                     struct ImageLoadStats *_loadStats = nullptr);
+// Loads every map of _materialSet again, into images that are thrown away,
+// to time loading with or without GPU decompression.
+void measurePBRMaterialSetLoad(
+    const Renderer &_renderer, VkCommandPool _cmdPool,
+    const PBRMaterialSet &_materialSet,
+    const struct BlockDecompressor *_decompressor, bool _verifiesDecompression,
+    struct ImageLoadStats &_loadStats);
 void destroyPBRMaterialSet(const Renderer &_renderer,
                            PBRMaterialSet &_materialSet);
 
 Image getPBRMapOrDefault(const PBRMaterialSet &_materialSet, int _materialIndex,
                          PBRMapType _mapType);
+int getPBRThumbnailOrDefault(const PBRMaterialSet &_materialSet,
+                             int _materialIndex, PBRMapType _mapType);
 
 enum class DescriptorFrequency {
   PerFrame,
@@ -274,21 +377,52 @@ enum class DescriptorFrequency {
   COUNT
 };
 
-enum class SamplerType { Nearest, Linear, COUNT };
+// Shadow is a linear depth comparison sampler, see ShadowLightBlock.
+enum class SamplerType { Nearest, Linear, Shadow, COUNT };
 
 struct DescriptorBinding {
   VkDescriptorType Type;
   uint32_t NumDescriptors;
+  // Never written, so left out of the update template.
+  bool HasImmutableSamplers;
 };
 
 constexpr uint32_t maxNumDescriptorBindings = 16;
 
+// Binding i of a layout is Bindings[i].
+//
+// UpdateTemplate writes every binding but immutable samplers from a packed
+// struct: one VkDescriptorImageInfo, VkDescriptorBufferInfo or VkBufferView
+// per descriptor, by binding then array element, with no padding between
+// them. See FrameDescriptors for one.
 struct DescriptorSetLayout {
   VkDescriptorSetLayout Handle;
   DescriptorBinding Bindings[maxNumDescriptorBindings];
   uint32_t NumBindings;
+  VkDescriptorUpdateTemplate UpdateTemplate;
+  uint32_t UpdateTemplateDataSize;
 };
 
+// Of the info a descriptor of _type is written from.
+uint32_t getDescriptorInfoSize(VkDescriptorType _type);
+
+// Creates _layout's UpdateTemplate once its Handle and Bindings are set.
+void createDescriptorUpdateTemplate(const Renderer &_renderer,
+                                    DescriptorSetLayout &_layout);
+void destroyDescriptorSetLayout(const Renderer &_renderer,
+                                DescriptorSetLayout &_layout);
+
+// Writes every descriptor of _set at once from _descriptors, packed the way
+// _layout.UpdateTemplate reads them.
+template <typename T>
+void updateDescriptorSet(const Renderer &_renderer,
+                         const DescriptorSetLayout &_layout,
+                         VkDescriptorSet _set, const T &_descriptors) {
+  BB_ASSERT(sizeof(T) == _layout.UpdateTemplateDataSize);
+  vkUpdateDescriptorSetWithTemplate(_renderer.Device, _set,
+                                    _layout.UpdateTemplate, &_descriptors);
+}
+
 struct StandardPipelineLayout {
   EnumArray<SamplerType, VkSampler> ImmutableSamplers;
   EnumArray<DescriptorFrequency, DescriptorSetLayout> DescriptorSetLayouts;
@@ -303,20 +437,6 @@ StandardPipelineLayout createStandardPipelineLayout(const Renderer &_renderer);
 void destroyStandardPipelineLayout(const Renderer &_renderer,
                                    StandardPipelineLayout &_layout);
 
-VkDescriptorPool createStandardDescriptorPool(
-    const Renderer &_renderer, const StandardPipelineLayout &_layout,
-    const EnumArray<DescriptorFrequency, uint32_t> &_numSets);
-
-struct alignas(16) Light {
-  Float3 Pos;
-  LightType Type;
-  Float3 Dir;
-  float Intensity;
-  Float3 Color;
-  float InnerCutOff;
-  float OuterCutOff;
-};
-
 #define MAX_NUM_LIGHTS 100
 struct FrameUniformBlock {
   int NumLights;
@@ -324,6 +444,74 @@ struct FrameUniformBlock {
   int VisualizedGBufferAttachmentIndex;
   int EnableToneMapping;
   float Exposure;
+  int EnableHalfResDiffuse;
+  int MeasureLightingError;
+  int EnableShadows;
+};
+
+// Vertex stage push constants of the standard pipeline layout, 128 bytes so
+// that every device takes them. Fields that no pass reads together share
+// their bytes.
+struct StandardPushConstants {
+  // Nonzero while drawing a single instance whose model matrix is
+  // DrawTransform, in place of the instance attributes.
+  int32_t HasDrawTransform;
+  // See VisibilityDraw.
+  int32_t VisibilityDrawIdBase;
+  // Nonzero while drawing a lightmapped mesh, read by gbuffer.vert.
+  int32_t IsLightmapped;
+  // View rendered by the layered multiview fallback, see MultiviewCapture.
+  int32_t ViewIndex;
+  // The first three rows of the model matrix, the last one being
+  // (0, 0, 0, 1).
+  Float4 DrawTransform[3];
+  union {
+    // Only read by shadow.vert.
+    Mat4 ShadowViewProj = {};
+    // Object space position to lightmap UV, see LightmapChart. Only read by
+    // gbuffer.vert.
+    Float4 LightmapUVTransform[2];
+  };
+};
+
+static_assert(sizeof(StandardPushConstants) == 128,
+              "StandardPushConstants must fit the minimum push constant size");
+
+// Point lights use one tile per cube face, ordered +X, -X, +Y, -Y, +Z, -Z.
+constexpr uint32_t maxNumShadowTilesPerLight = 6;
+
+// Where a light's shadow map lives in the shadow atlas, one per light in
+// Frame::ShadowBuffer. NumTiles is 0 for lights that cast no shadow.
+struct ShadowLightBlock {
+  Mat4 ViewProj[maxNumShadowTilesPerLight];
+  // xy is the tile's offset and zw its size, in atlas UV.
+  Float4 Tiles[maxNumShadowTilesPerLight];
+  uint32_t NumTiles;
+  // World size of a texel one unit away from the light, for normal offsets.
+  float TexelScale;
+  float Pad[2];
+};
+
+// Written by the Lighting subpass when MeasureLightingError is set, comparing
+// upsampled half resolution diffuse with full resolution diffuse. Errors are
+// in 8-bit steps, squared sums are split across buckets by pixel row so that
+// none of them overflows.
+constexpr uint32_t numLightingErrorBuckets = 1024;
+
+struct LightingErrorBlock {
+  uint32_t SumSquaredError[numLightingErrorBuckets];
+  uint32_t MaxError;
+  uint32_t NumPixels;
+  uint32_t NumVisibleErrors;
+};
+
+struct LightingErrorStats {
+  uint32_t NumPixels;
+  float RMSE;
+  float PSNR;
+  uint32_t MaxError;
+  // Pixels off by more than two steps.
+  float VisibleErrorRatio;
 };
 
 struct ViewUniformBlock {
@@ -333,16 +521,81 @@ struct ViewUniformBlock {
   int EnableNormalMap;
 };
 
+constexpr uint32_t maxNumMultiviews = 6;
+
+// Views of the multiview capture, picked by view index. Bound next to
+// ViewUniformBlock, which stays the main view.
+struct MultiviewUniformBlock {
+  Mat4 ViewProj[maxNumMultiviews];
+  // w is unused.
+  Float4 ViewPos[maxNumMultiviews];
+};
+
+// Scene passes whose vertex shader invocations are counted every frame.
+enum class ScenePassStat { DepthPrepass, Scene, COUNT };
+
+// Written around the scene's geometry and lighting subpasses.
+enum class ScenePassTimestamp { Begin, Geometry, Lighting, COUNT };
+
+// Packed descriptors of the standard layout's sets, in binding order, see
+// DescriptorSetLayout::UpdateTemplate.
+struct FrameDescriptors {
+  VkDescriptorBufferInfo FrameData;
+  VkDescriptorImageInfo GBuffer[numGBufferAttachments];
+  VkDescriptorImageInfo HDR;
+  VkDescriptorImageInfo Visibility;
+  VkDescriptorBufferInfo VisibilityDraws;
+  EnumArray<VisibilityStorageBuffer, VkDescriptorBufferInfo> VisibilityBuffers;
+  VkDescriptorImageInfo HalfResDiffuse;
+  VkDescriptorBufferInfo LightingError;
+  VkDescriptorBufferInfo ShadowLights;
+  VkDescriptorImageInfo ShadowAtlas;
+  VkDescriptorImageInfo Lightmap;
+};
+
+struct ViewDescriptors {
+  VkDescriptorBufferInfo ViewData;
+  VkDescriptorBufferInfo MultiviewData;
+};
+
+struct MaterialDescriptors {
+  EnumArray<PBRMapType, VkDescriptorImageInfo> Maps;
+};
+
+struct DrawDescriptors {
+  // InstanceBlocks
+  VkDescriptorBufferInfo Instances;
+};
+
 struct Frame {
   VkDescriptorSet FrameDescriptorSet;
   VkDescriptorSet ViewDescriptorSet;
   std::vector<VkDescriptorSet> MaterialDescriptorSets;
+  // What FrameDescriptorSet points at once updateFrameDescriptorSet() is
+  // called, which it only writes when the link functions changed it.
+  FrameDescriptors Descriptors;
+  bool HasDescriptorChanges;
 
   Buffer FrameUniformBuffer;
   Buffer ViewUniformBuffer;
+  Buffer MultiviewUniformBuffer;
 
   VkCommandPool CmdPool;
   VkCommandBuffer CmdBuffer;
+
+  // One pipeline statistics query per ScenePassStat. VK_NULL_HANDLE if the
+  // device doesn't support pipelineStatisticsQuery.
+  VkQueryPool ScenePassStatsQueryPool;
+  // One timestamp per ScenePassTimestamp. VK_NULL_HANDLE if the device
+  // doesn't support timestampComputeAndGraphics.
+  VkQueryPool ScenePassTimestampQueryPool;
+
+  // maxNumVisibilityDraws records, host visible.
+  Buffer VisibilityDrawBuffer;
+  // One LightingErrorBlock, host visible.
+  Buffer LightingErrorBuffer;
+  // MAX_NUM_LIGHTS ShadowLightBlocks, host visible.
+  Buffer ShadowBuffer;
 };
 
 struct FrameSync {
@@ -351,30 +604,45 @@ struct FrameSync {
   VkSemaphore ImagePresentedSemaphore;
 };
 
+// The frame's sets come from _descriptorAllocator, its material sets from
+// _descriptorSetCache, shared with other frames.
 Frame createFrame(
     const Renderer &_renderer,
     const StandardPipelineLayout &_standardPipelineLayout,
-    VkDescriptorPool _descriptorPool, const PBRMaterialSet &_materialSet,
+    struct DescriptorAllocator &_descriptorAllocator,
+    struct DescriptorSetCache &_descriptorSetCache,
+    const PBRMaterialSet &_materialSet,
     const VkImageView (&_gbufferAttachments)[numGBufferAttachments],
-    VkImageView _hdrAttachment);
+    VkImageView _hdrAttachment, VkImageView _visibilityAttachment,
+    VkImageView _halfResDiffuseAttachment);
 void destroyFrame(const Renderer &_renderer, Frame &_frame);
 
+// The link functions only change _frame.Descriptors, bindings that were
+// never linked point at placeholders so that the set can be written whole.
 void linkExternalAttachmentsToDescriptorSet(
-    const Renderer &_renderer, Frame &_frame,
+    Frame &_frame,
     const VkImageView (&_gbufferAttachments)[numGBufferAttachments],
-    VkImageView _hdrAttachment);
-
-void generatePlaneMesh(std::vector<Vertex> &_vertices,
-                       std::vector<uint32_t> &_indices);
-void generateQuadMesh(std::vector<Vertex> &_vertices,
-                      std::vector<uint32_t> &_indices);
-
-// The tangent vector of UV Sphere will be broken at the top and the bottom
-// side, because of how UV Sphere is constructed.
-void generateUVSphereMesh(std::vector<Vertex> &_vertices,
-                          std::vector<uint32_t> &_indices, float _radius = 1.f,
-                          int _horizontalDivision = 16,
-                          int _verticalDivision = 16);
+    VkImageView _hdrAttachment, VkImageView _visibilityAttachment,
+    VkImageView _halfResDiffuseAttachment);
+void linkVisibilityStorageBuffers(
+    Frame &_frame,
+    const EnumArray<VisibilityStorageBuffer, VkBuffer> &_buffers);
+void linkShadowAtlas(Frame &_frame, VkImageView _shadowAtlas);
+void linkLightmap(Frame &_frame, VkImageView _lightmap);
+// Writes what was linked since the last call with a single template update.
+// _frame's commands must have finished.
+void updateFrameDescriptorSet(const Renderer &_renderer,
+                              const StandardPipelineLayout &_layout,
+                              Frame &_frame);
+// One set per material, pointing at its maps. The sets are cached, so asking
+// again for the same materials gives the same sets.
+std::vector<VkDescriptorSet> getMaterialDescriptorSets(
+    const Renderer &_renderer, struct DescriptorSetCache &_cache,
+    struct DescriptorAllocator &_allocator,
+    const StandardPipelineLayout &_layout, const PBRMaterialSet &_materialSet);
+// Sums up what the GPU wrote since the last call and clears the buffer. Only
+// call this once _frame's commands have finished.
+LightingErrorStats readLightingError(const Renderer &_renderer, Frame &_frame);
 
 #if BB_DEBUG
 void labelGPUResource(const Renderer &_renderer, const Image &_image,
@@ -3,113 +3,22 @@
 #include "vector_math.h"
 #include "render.h"
 #include "type_conversion.h"
+#include "block_codec.h"
+#include "descriptor_allocator.h"
 #include "external/stb_image.h"
 #include "external/SDL2/SDL.h"
 #include "external/toml.h"
 #include <string_view>
+#include <algorithm>
+#include <thread>
 #ifdef BB_WINDOWS
 #include <Windows.h>
+#else
+#include <sys/stat.h>
 #endif
 
 namespace bb {
 
-static std::string gCommonResourceRoot;
-static std::string gShaderRoot;
-
-static bool isSeparator(char _ch) { return (_ch == '\\') || (_ch == '/'); }
-
-static void replaceSeparatorsWithNative(std::string &_str, int _offset = 0) {
-  std::replace_if(_str.begin() + _offset, _str.end(), isSeparator,
-                  nativePathSeparator);
-}
-
-static std::string_view trimSeparators(std::string_view _str) {
-  bool isValidPath = false;
-  int trimBegin = 0;
-  int trimEnd = 0;
-  for (int i = 0; i < (int)_str.length(); ++i) {
-    if (!isSeparator(_str[i])) {
-      trimBegin = i;
-      isValidPath = true;
-      break;
-    }
-  }
-  if (!isValidPath) {
-    return {};
-  }
-  for (int i = (int)_str.length() - 1; i >= 0; --i) {
-    if (!isSeparator(_str[i])) {
-      trimEnd = i + 1;
-      break;
-    }
-  }
-
-  return _str.substr(trimBegin, trimEnd - trimBegin);
-}
-
-// Removes ".." s
-static std::string simplifyPath(std::string_view _path) {
-  std::vector<std::string_view> dirs;
-  dirs.reserve(_path.size());
-
-  int lastAppendedIndex = 0;
-  for (int i = 0; i <= (int)_path.length(); ++i) {
-    if (i == _path.length() || isSeparator(_path[i])) {
-      std::string_view dir =
-          _path.substr(lastAppendedIndex, i - lastAppendedIndex);
-      lastAppendedIndex = i + 1;
-      if (dir == "..") {
-        dirs.pop_back();
-      } else {
-        dirs.push_back(dir);
-      }
-    }
-  }
-
-  std::string result;
-  result.reserve(_path.size());
-  size_t i = 0;
-  for (const std::string_view &dir : dirs) {
-    result += dir;
-    if (i < dirs.size() - 1) {
-      result += nativePathSeparator;
-    }
-    ++i;
-  }
-
-  return result;
-}
-
-bool isAbsolutePath(std::string_view _path) {
-  return (_path.length() >= 2) && (_path[1] == ':');
-}
-
-std::string joinPaths(std::string_view _a, std::string_view _b) {
-  std::string joined;
-  joined.reserve((_a.size() + _b.size()) * 2);
-  _a = trimSeparators(_a);
-  _b = trimSeparators(_b);
-  joined = _a;
-  joined += nativePathSeparator;
-  joined += _b;
-  replaceSeparatorsWithNative(joined);
-  joined = simplifyPath(joined);
-  return joined;
-}
-
-std::string getFileName(std::string_view _path) {
-  int i = (int)_path.length() - 1;
-  for (; i >= 0; --i) {
-    if (isSeparator(_path[i])) {
-      break;
-    }
-  }
-
-  std::string fileName(_path.substr(i + 1));
-
-  return fileName;
-}
-
 void initResourceRoot() {
   std::string exeDir;
   {
@@ -137,48 +46,236 @@ void initResourceRoot() {
     return str;
   };
 
-  gCommonResourceRoot =
-      joinPaths(exeDir, getString(tomlResourcePath, "common_root"));
-  gShaderRoot = joinPaths(exeDir, getString(tomlResourcePath, "shader_root"));
+  setResourceRoots(
+      joinPaths(exeDir, getString(tomlResourcePath, "common_root")),
+      joinPaths(exeDir, getString(tomlResourcePath, "shader_root")));
 
   toml_free(config);
 }
 
-std::string createCommonResourcePath(std::string_view _relPath) {
-  std::string absPath = joinPaths(gCommonResourceRoot, _relPath);
-  return absPath;
+// Box filter, so every source texel contributes to the thumbnail.
+static void downsampleRGBA8(const uint8_t *_src, Int2 _srcDims, uint8_t *_dst,
+                            Int2 _dstDims) {
+  for (int y = 0; y < _dstDims.Y; ++y) {
+    int y0 = y * _srcDims.Y / _dstDims.Y;
+    int y1 = std::max((y + 1) * _srcDims.Y / _dstDims.Y, y0 + 1);
+    for (int x = 0; x < _dstDims.X; ++x) {
+      int x0 = x * _srcDims.X / _dstDims.X;
+      int x1 = std::max((x + 1) * _srcDims.X / _dstDims.X, x0 + 1);
+
+      uint32_t sum[4] = {};
+      for (int sy = y0; sy < y1; ++sy) {
+        const uint8_t *row = _src + ((size_t)sy * _srcDims.X + x0) * 4;
+        for (int sx = x0; sx < x1; ++sx) {
+          for (int c = 0; c < 4; ++c) {
+            sum[c] += *row++;
+          }
+        }
+      }
+
+      uint32_t numTexels = (uint32_t)((y1 - y0) * (x1 - x0));
+      uint8_t *dst = _dst + ((size_t)y * _dstDims.X + x) * 4;
+      for (int c = 0; c < 4; ++c) {
+        dst[c] = (uint8_t)((sum[c] + numTexels / 2) / numTexels);
+      }
+    }
+  }
 }
 
-std::string createShaderPath(std::string_view _relPath) {
-  std::string absPath = joinPaths(gShaderRoot, _relPath);
-  return absPath;
+constexpr uint32_t cookedImageMagic = 0x58544242; // "BBTX"
+constexpr uint32_t cookedImageVersion = 2;
+constexpr uint32_t cookedImageHeaderSize = 8 * sizeof(uint32_t);
+constexpr uint32_t thumbnailSize = thumbnailExtent * thumbnailExtent * 4;
+
+// Identifies the version of a source file a cooked file was made from.
+struct SourceStamp {
+  uint64_t Size;
+  // In the platform's own units, only ever compared for equality.
+  uint64_t ModifiedTime;
+};
+
+static bool getSourceStamp(const std::string &_filePath,
+                           SourceStamp &_stamp) {
+#ifdef BB_WINDOWS
+  WIN32_FILE_ATTRIBUTE_DATA attributes;
+  if (!GetFileAttributesExA(_filePath.c_str(), GetFileExInfoStandard,
+                            &attributes)) {
+    return false;
+  }
+  _stamp.Size = ((uint64_t)attributes.nFileSizeHigh << 32) |
+                attributes.nFileSizeLow;
+  _stamp.ModifiedTime =
+      ((uint64_t)attributes.ftLastWriteTime.dwHighDateTime << 32) |
+      attributes.ftLastWriteTime.dwLowDateTime;
+#else
+  struct stat status;
+  if (stat(_filePath.c_str(), &status) != 0) {
+    return false;
+  }
+  _stamp.Size = (uint64_t)status.st_size;
+  _stamp.ModifiedTime = (uint64_t)status.st_mtim.tv_sec * 1000000000ull +
+                        (uint64_t)status.st_mtim.tv_nsec;
+#endif
+  return true;
+}
+
+// Magic, version, width, height, the size and modification time of the
+// source as two words each, the thumbnail and the RGBA8 texels as a block
+// compressed payload, see block_codec.h.
+static bool writeCookedImage(const std::string &_filePath, Int2 _dims,
+                             const SourceStamp &_source,
+                             const std::vector<uint8_t> &_thumbnail,
+                             const std::vector<uint32_t> &_compressed) {
+  FILE *f = fopen(_filePath.c_str(), "wb");
+  if (!f) {
+    return false;
+  }
+  uint32_t header[] = {cookedImageMagic,
+                       cookedImageVersion,
+                       (uint32_t)_dims.X,
+                       (uint32_t)_dims.Y,
+                       (uint32_t)_source.Size,
+                       (uint32_t)(_source.Size >> 32),
+                       (uint32_t)_source.ModifiedTime,
+                       (uint32_t)(_source.ModifiedTime >> 32)};
+  static_assert(sizeof(header) == cookedImageHeaderSize);
+  fwrite(header, sizeof(header), 1, f);
+  fwrite(_thumbnail.data(), 1, thumbnailSize, f);
+  fwrite(_compressed.data(), sizeof(uint32_t), _compressed.size(), f);
+  bool isWritten = ferror(f) == 0;
+  fclose(f);
+  return isWritten;
+}
+
+// Fails if the file was cooked from another version of the source. Without
+// a source to compare against, the cooked file is taken as is.
+static bool readCookedImage(const std::string &_filePath, Int2 &_dims,
+                            const SourceStamp *_source,
+                            std::vector<uint8_t> &_thumbnail,
+                            std::vector<uint32_t> &_compressed) {
+  FILE *f = fopen(_filePath.c_str(), "rb");
+  if (!f) {
+    return false;
+  }
+  BB_DEFER(fclose(f));
+
+  fseek(f, 0, SEEK_END);
+  long fileSize = ftell(f);
+  rewind(f);
+  uint32_t header[cookedImageHeaderSize / sizeof(uint32_t)];
+  size_t payloadSize = (size_t)fileSize - sizeof(header) - thumbnailSize;
+  if (fileSize < (long)(sizeof(header) + thumbnailSize) ||
+      payloadSize % sizeof(uint32_t) != 0 ||
+      fread(header, sizeof(header), 1, f) != 1 ||
+      header[0] != cookedImageMagic || header[1] != cookedImageVersion) {
+    return false;
+  }
+  if (_source &&
+      (header[4] != (uint32_t)_source->Size ||
+       header[5] != (uint32_t)(_source->Size >> 32) ||
+       header[6] != (uint32_t)_source->ModifiedTime ||
+       header[7] != (uint32_t)(_source->ModifiedTime >> 32))) {
+    return false;
+  }
+
+  _thumbnail.resize(thumbnailSize);
+  _compressed.resize(payloadSize / sizeof(uint32_t));
+  if (fread(_thumbnail.data(), 1, thumbnailSize, f) != thumbnailSize ||
+      fread(_compressed.data(), sizeof(uint32_t), _compressed.size(), f) !=
+          _compressed.size()) {
+    return false;
+  }
+  _dims = {(int)header[2], (int)header[3]};
+  return isValidCompressedPayload(_compressed) &&
+         getDecompressedSize(_compressed) ==
+             (uint64_t)_dims.X * (uint64_t)_dims.Y * 4;
 }
 
 void runImageLoadTask(ImageLoadFromFileTask &_task) {
-  int numChannels;
-  stbi_uc *pixels = stbi_load(_task.FilePath.c_str(), &_task.ImageDims.X,
-                              &_task.ImageDims.Y, &numChannels, STBI_rgb_alpha);
-  if (!pixels) {
-    return;
+  AssetLoad &load = _task.Load;
+  load = beginAssetLoad(AssetType::Texture, getAssetName(_task.FilePath));
+  std::string cookedPath = _task.FilePath + cookedImageExtension;
+  std::vector<uint8_t> thumbnail;
+  std::vector<uint32_t> compressed;
+  SourceStamp source;
+  bool hasSource = getSourceStamp(_task.FilePath, source);
+  if (readCookedImage(cookedPath, _task.ImageDims,
+                      hasSource ? &source : nullptr, thumbnail, compressed)) {
+    load.NumBytesRead = cookedImageHeaderSize + thumbnailSize +
+                        sizeBytes32(compressed);
+    markAssetLoadStage(load, AssetLoadStage::Read);
+  } else {
+    std::vector<uint8_t> contents;
+    if (!readFile(_task.FilePath, contents)) {
+      return;
+    }
+    load.NumBytesRead = contents.size();
+    markAssetLoadStage(load, AssetLoadStage::Read);
+
+    int numChannels;
+    stbi_uc *pixels = stbi_load_from_memory(
+        contents.data(), (int)contents.size(), &_task.ImageDims.X,
+        &_task.ImageDims.Y, &numChannels, STBI_rgb_alpha);
+    if (!pixels) {
+      return;
+    }
+    BB_DEFER(stbi_image_free(pixels));
+
+    Int2 thumbnailDims = {(int)thumbnailExtent, (int)thumbnailExtent};
+    thumbnail.resize(thumbnailSize);
+    downsampleRGBA8(pixels, _task.ImageDims, thumbnail.data(), thumbnailDims);
+    compressed = compressBlocks(
+        pixels, (size_t)_task.ImageDims.X * _task.ImageDims.Y * 4);
+    markAssetLoadStage(load, AssetLoadStage::Decode);
+    _task.IsCooked = writeCookedImage(cookedPath, _task.ImageDims, source,
+                                      thumbnail, compressed);
+    if (!_task.IsCooked) {
+      BB_LOG_WARNING("Failed to write {}", cookedPath);
+    }
+    markAssetLoadStage(load, AssetLoadStage::Read);
   }
 
-  BB_DEFER(stbi_image_free(pixels));
+  if (_task.TargetThumbnail) {
+    *_task.TargetThumbnail = std::move(thumbnail);
+  }
 
-  VkDeviceSize textureSize = _task.ImageDims.X * _task.ImageDims.Y * 4;
+  _task.NumBytes = getDecompressedSize(compressed);
+  _task.NumCompressedBytes = sizeBytes32(compressed);
+  _task.NumBlocks = getNumCompressedBlocks(compressed);
+  load.NumDecodedBytes = _task.NumBytes;
   const Renderer &renderer = *_task.Renderer;
 
+  // Either the compressed payload for the GPU to expand or texels the CPU
+  // decoder expanded.
+  VkDeviceSize stagingSize =
+      _task.Decompressor ? _task.NumCompressedBytes : _task.NumBytes;
+  VkBufferUsageFlags stagingUsage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+  if (_task.Decompressor) {
+    stagingUsage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+  }
   _task.StagingBuffer =
-      createBuffer(renderer, textureSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+      createBuffer(renderer, stagingSize, stagingUsage,
                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
                        VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  markAssetLoadStage(load, AssetLoadStage::Create);
 
   {
     void *data;
-    vkMapMemory(renderer.Device, _task.StagingBuffer.Memory, 0, textureSize, 0,
+    vkMapMemory(renderer.Device, _task.StagingBuffer.Memory, 0, stagingSize, 0,
                 &data);
-    memcpy(data, pixels, textureSize);
+    // The CPU decoder writes straight to the staging buffer.
+    if (_task.Decompressor) {
+      memcpy(data, compressed.data(), stagingSize);
+      markAssetLoadStage(load, AssetLoadStage::Stage);
+    } else {
+      decompressBlocks(compressed, data);
+      markAssetLoadStage(load, AssetLoadStage::Decode);
+    }
     vkUnmapMemory(renderer.Device, _task.StagingBuffer.Memory);
   }
+  if (_task.VerifiesDecompression) {
+    _task.Compressed = std::move(compressed);
+  }
 
   Image *targetImage = _task.TargetImage;
 
@@ -219,6 +316,7 @@ void runImageLoadTask(ImageLoadFromFileTask &_task) {
 
   BB_VK_ASSERT(vkBindImageMemory(renderer.Device, targetImage->Handle,
                                  targetImage->Memory, 0));
+  markAssetLoadStage(load, AssetLoadStage::Create);
 }
 
 void destroyImageLoader(ImageLoader &_loader) {
@@ -229,48 +327,77 @@ void destroyImageLoader(ImageLoader &_loader) {
 }
 
 void enqueueImageLoadTask(ImageLoader &_loader, const Renderer &_renderer,
-                          std::string_view _filePath, Image &_targetImage) {
+                          std::string_view _filePath, Image &_targetImage,
+                          std::vector<uint8_t> *_targetThumbnail) {
   ImageLoadFromFileTask *task = new ImageLoadFromFileTask();
   task->Renderer = &_renderer;
   task->FilePath = _filePath;
   task->TargetImage = &_targetImage;
+  task->TargetThumbnail = _targetThumbnail;
+  task->Decompressor = _loader.Decompressor;
+  task->VerifiesDecompression =
+      _loader.Decompressor && _loader.VerifiesDecompression;
 
   _loader.Tasks.push_back(task);
 }
 
+float getLoadBandwidth(const ImageLoadStats &_stats) {
+  return _stats.Ms > 0.f ? (float)_stats.NumBytes / (_stats.Ms * 1000.f) : 0.f;
+}
+
 void finalizeAllImageLoads(ImageLoader &_loader, const Renderer &_renderer,
                            VkCommandPool _cmdPool) {
-  std::vector<HANDLE> threads;
-  std::vector<DWORD> threadIds;
-  threads.resize(_loader.Tasks.size());
-  threadIds.resize(_loader.Tasks.size());
-
-  SYSTEM_INFO sysinfo;
-  GetSystemInfo(&sysinfo);
-  int numCPUs = sysinfo.dwNumberOfProcessors;
-  int batch = MAXIMUM_WAIT_OBJECTS;
-
+  Time startTime = getCurrentTime();
+  _loader.Stats = {};
+  _loader.Stats.UsedGPUDecompression = _loader.Decompressor != nullptr;
+  // Every decompression is waited for before the next one is recorded, so
+  // its set is retired and the pool can be reset and reused right away.
+  DescriptorAllocator decompressionDescriptorAllocator =
+      createDescriptorAllocator(1, 1);
+
+  // Every task gets a thread, at most this many at a time.
+  constexpr size_t maxNumLoadThreads = 64;
+  std::vector<std::thread> threads;
+  threads.reserve(std::min(_loader.Tasks.size(), maxNumLoadThreads));
   for (size_t i = 0; i < _loader.Tasks.size(); ++i) {
-    threads[i % batch] = CreateThread(
-        nullptr, 0,
-        [](LPVOID _param) -> DWORD {
-          ImageLoadFromFileTask *task = (ImageLoadFromFileTask *)_param;
-          runImageLoadTask(*task);
-          return 0;
-        },
-        _loader.Tasks[i], 0, &threadIds[i % batch]);
-    if ((i + 1) % batch == 0) {
-      WaitForMultipleObjects(batch, threads.data(), TRUE, INFINITE);
-    } else if (i == _loader.Tasks.size() - 1) {
-      WaitForMultipleObjects((i + 1) % batch, threads.data(), TRUE, INFINITE);
+    threads.emplace_back(runImageLoadTask, std::ref(*_loader.Tasks[i]));
+    if (threads.size() == maxNumLoadThreads ||
+        i == _loader.Tasks.size() - 1) {
+      for (std::thread &thread : threads) {
+        thread.join();
+      }
+      threads.clear();
     }
   }
 
   for (size_t i = 0; i < _loader.Tasks.size(); ++i) {
     ImageLoadFromFileTask &task = *_loader.Tasks[i];
+    AssetLoad &load = task.Load;
     if (task.TargetImage->Handle == VK_NULL_HANDLE) {
+      // Failed loads are reported too, having decoded nothing.
+      endAssetLoad(load);
       continue;
     }
+    skipAssetLoadTime(load);
+    ++_loader.Stats.NumImages;
+    _loader.Stats.NumCooked += task.IsCooked ? 1 : 0;
+    _loader.Stats.NumBytes += task.NumBytes;
+    _loader.Stats.NumCompressedBytes += task.NumCompressedBytes;
+
+    // Texels are copied to the image from here.
+    const Buffer *texelBuffer = &task.StagingBuffer;
+    if (task.Decompressor) {
+      VkMemoryPropertyFlags memoryFlags =
+          task.VerifiesDecompression ? VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                           VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+                                     : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+      task.DecompressedBuffer = createBuffer(
+          _renderer, (task.NumBytes + 3) & ~3u,
+          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+          memoryFlags);
+      texelBuffer = &task.DecompressedBuffer;
+      markAssetLoadStage(load, AssetLoadStage::Create);
+    }
 
     VkCommandBufferAllocateInfo cmdBufferAllocInfo = {};
     cmdBufferAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -286,6 +413,12 @@ void finalizeAllImageLoads(ImageLoader &_loader, const Renderer &_renderer,
     cmdBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     cmdBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
     BB_VK_ASSERT(vkBeginCommandBuffer(cmdBuffer, &cmdBeginInfo));
+    if (task.Decompressor) {
+      recordBlockDecompression(_renderer, cmdBuffer, *task.Decompressor,
+                               decompressionDescriptorAllocator,
+                               task.StagingBuffer, task.DecompressedBuffer,
+                               task.NumBlocks);
+    }
     VkImageMemoryBarrier barrier = {};
     barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
     barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -315,7 +448,7 @@ void finalizeAllImageLoads(ImageLoader &_loader, const Renderer &_renderer,
     region.imageSubresource.layerCount = 1;
     region.imageOffset = {0, 0, 0};
     region.imageExtent = int2ToExtent3D(task.ImageDims);
-    vkCmdCopyBufferToImage(cmdBuffer, task.StagingBuffer.Handle,
+    vkCmdCopyBufferToImage(cmdBuffer, texelBuffer->Handle,
                            task.TargetImage->Handle,
                            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
     barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
@@ -338,8 +471,31 @@ void finalizeAllImageLoads(ImageLoader &_loader, const Renderer &_renderer,
         vkQueueSubmit(_renderer.Queue, 1, &submitInfo, VK_NULL_HANDLE));
     BB_VK_ASSERT(vkQueueWaitIdle(_renderer.Queue));
     vkFreeCommandBuffers(_renderer.Device, _cmdPool, 1, &cmdBuffer);
+    if (task.Decompressor) {
+      resetDescriptorAllocator(_renderer, decompressionDescriptorAllocator);
+    }
+    load.Queue = (int)_renderer.QueueFamilyIndex;
+    markAssetLoadStage(load, AssetLoadStage::Submit);
+
+    if (task.VerifiesDecompression) {
+      std::vector<uint8_t> expected(task.NumBytes);
+      decompressBlocks(task.Compressed, expected.data());
+      void *data;
+      vkMapMemory(_renderer.Device, task.DecompressedBuffer.Memory, 0,
+                  task.NumBytes, 0, &data);
+      if (memcmp(data, expected.data(), task.NumBytes) != 0) {
+        BB_LOG_ERROR("GPU decompression of {} doesn't match", task.FilePath);
+        ++_loader.Stats.NumMismatches;
+      }
+      vkUnmapMemory(_renderer.Device, task.DecompressedBuffer.Memory);
+      // Checking isn't part of the load.
+      skipAssetLoadTime(load);
+    }
 
     destroyBuffer(_renderer, task.StagingBuffer);
+    if (task.Decompressor) {
+      destroyBuffer(_renderer, task.DecompressedBuffer);
+    }
 
     VkImageViewCreateInfo imageViewCreateInfo = {};
     imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -353,11 +509,21 @@ void finalizeAllImageLoads(ImageLoader &_loader, const Renderer &_renderer,
     imageViewCreateInfo.subresourceRange.layerCount = 1;
     BB_VK_ASSERT(vkCreateImageView(_renderer.Device, &imageViewCreateInfo,
                                    nullptr, &task.TargetImage->View));
+    markAssetLoadStage(load, AssetLoadStage::Create);
+    endAssetLoad(load);
   }
 
-  for (HANDLE thread : threads) {
-    CloseHandle(thread);
-  }
+  destroyDescriptorAllocator(_renderer, decompressionDescriptorAllocator);
+
+  _loader.Stats.Ms =
+      getElapsedTimeInSeconds(startTime, getCurrentTime()) * 1000.f;
+  BB_LOG_INFO("Loaded {} images, {} cooked, {:.1f} MB from {:.1f} MB in "
+              "{:.1f} ms with {} decompression: {:.0f} MB/s",
+              _loader.Stats.NumImages, _loader.Stats.NumCooked,
+              (double)_loader.Stats.NumBytes / 1e6,
+              (double)_loader.Stats.NumCompressedBytes / 1e6, _loader.Stats.Ms,
+              _loader.Stats.UsedGPUDecompression ? "GPU" : "CPU",
+              getLoadBandwidth(_loader.Stats));
 
   for (ImageLoadFromFileTask *task : _loader.Tasks) {
     delete task;
@@ -1,39 +1,74 @@
 #pragma once
 #include "render.h"
+#include "asset_report.h"
+#include "path.h"
+#include "resource_root.h"
 #include <string>
 #include <string_view>
 #include <vector>
 
 namespace bb {
 
-inline static const char nativePathSeparator = '\\';
-bool isAbsolutePath(std::string_view _path);
-std::string joinPaths(std::string_view _a, std::string_view _b);
-std::string getFileName(std::string_view _path);
-
 void initResourceRoot();
 
-std::string createCommonResourcePath(std::string_view _relPath);
-std::string createShaderPath(std::string_view _relPath);
+// Images are cooked on first load into a file next to the source, with this
+// appended to its name. It is cooked again once the source's size or
+// modification time changes.
+inline static const char cookedImageExtension[] = ".bbtex";
 
 struct ImageLoadFromFileTask {
   const struct Renderer *Renderer;
   std::string FilePath;
   Image *TargetImage;
+  // Optional. Receives a thumbnailExtent x thumbnailExtent RGBA8 preview.
+  std::vector<uint8_t> *TargetThumbnail;
+  // Optional. Decompresses on the GPU rather than while loading.
+  const struct BlockDecompressor *Decompressor;
+  // Keeps Compressed to check the GPU decompression against.
+  bool VerifiesDecompression;
 
   Int2 ImageDims;
+  // Holds the compressed payload if Decompressor is set.
   Buffer StagingBuffer;
+  Buffer DecompressedBuffer;
+  std::vector<uint32_t> Compressed;
+  uint32_t NumBlocks;
+  uint32_t NumBytes;
+  uint32_t NumCompressedBytes;
+  bool IsCooked;
+  AssetLoad Load;
 };
 
 void runImageLoadTask(ImageLoadFromFileTask &_task);
 
+struct ImageLoadStats {
+  uint32_t NumImages;
+  // Cooked by this load rather than read cooked.
+  uint32_t NumCooked;
+  uint64_t NumBytes;
+  uint64_t NumCompressedBytes;
+  float Ms;
+  bool UsedGPUDecompression;
+  // GPU decompressions that didn't match the CPU decoder.
+  uint32_t NumMismatches;
+};
+
+// Decompressed bytes per second, in MB/s.
+float getLoadBandwidth(const ImageLoadStats &_stats);
+
 struct ImageLoader {
   std::vector<ImageLoadFromFileTask *> Tasks;
+  const BlockDecompressor *Decompressor = nullptr;
+  // Reads GPU decompressions back and compares them with the CPU decoder.
+  bool VerifiesDecompression = false;
+  // Of the last finalizeAllImageLoads().
+  ImageLoadStats Stats = {};
 };
 
 void destroyImageLoader(ImageLoader &_loader);
 void enqueueImageLoadTask(ImageLoader &_loader, const Renderer &_renderer,
-                          std::string_view _filePath, Image &_targetImage);
+                          std::string_view _filePath, Image &_targetImage,
+                          std::vector<uint8_t> *_targetThumbnail = nullptr);
 void finalizeAllImageLoads(ImageLoader &_loader, const Renderer &_renderer,
                            VkCommandPool _cmdPool);
 
@@ -0,0 +1,94 @@
+#include "resource_root.h"
+#include "path.h"
+#include "util.h"
+#include <algorithm>
+#include <string.h>
+#ifdef BB_WINDOWS
+#include <Windows.h>
+#else
+#include <dirent.h>
+#endif
+
+namespace bb {
+
+static std::string gCommonResourceRoot;
+static std::string gShaderRoot;
+
+void setResourceRoots(std::string_view _commonRoot,
+                      std::string_view _shaderRoot) {
+  gCommonResourceRoot = _commonRoot;
+  gShaderRoot = _shaderRoot;
+}
+
+std::string createCommonResourcePath(std::string_view _relPath) {
+  std::string absPath = joinPaths(gCommonResourceRoot, _relPath);
+  return absPath;
+}
+
+std::string createShaderPath(std::string_view _relPath) {
+  std::string absPath = joinPaths(gShaderRoot, _relPath);
+  return absPath;
+}
+
+std::string getAssetName(std::string_view _path) {
+  std::string name(_path);
+  for (const std::string *root : {&gCommonResourceRoot, &gShaderRoot}) {
+    if (!root->empty() && name.compare(0, root->size(), *root) == 0) {
+      std::string relPath = name.substr(root->size());
+      name = trimPathSeparators(relPath);
+      break;
+    }
+  }
+  std::replace_if(name.begin(), name.end(), isPathSeparator, '/');
+  return name;
+}
+
+bool readFile(const std::string &_filePath, std::vector<uint8_t> &_contents) {
+  FILE *f = fopen(_filePath.c_str(), "rb");
+  if (!f) {
+    return false;
+  }
+  BB_DEFER(fclose(f));
+  fseek(f, 0, SEEK_END);
+  long fileSize = ftell(f);
+  rewind(f);
+  _contents.resize(fileSize > 0 ? (size_t)fileSize : 0);
+  return fread(_contents.data(), 1, _contents.size(), f) == _contents.size();
+}
+
+std::vector<std::string> listSubdirectories(const std::string &_dirPath) {
+  std::vector<std::string> names;
+  auto isListed = [](const char *_name) {
+    return strcmp(_name, ".") != 0 && strcmp(_name, "..") != 0;
+  };
+#ifdef BB_WINDOWS
+  WIN32_FIND_DATAA findData;
+  std::string pattern = joinPaths(_dirPath, "*");
+  HANDLE findHandle = FindFirstFileA(pattern.c_str(), &findData);
+  if (findHandle == INVALID_HANDLE_VALUE) {
+    return names;
+  }
+  do {
+    if ((findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) &&
+        isListed(findData.cFileName)) {
+      names.push_back(findData.cFileName);
+    }
+  } while (FindNextFileA(findHandle, &findData));
+  FindClose(findHandle);
+#else
+  DIR *dir = opendir(_dirPath.c_str());
+  if (!dir) {
+    return names;
+  }
+  while (const dirent *entry = readdir(dir)) {
+    if (entry->d_type == DT_DIR && isListed(entry->d_name)) {
+      names.push_back(entry->d_name);
+    }
+  }
+  closedir(dir);
+#endif
+  std::sort(names.begin(), names.end());
+  return names;
+}
+
+} // namespace bb
@@ -0,0 +1,26 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace bb {
+
+// Where resources are found, free of Vulkan and SDL so that tools can load
+// them headless. initResourceRoot() in resource.h reads the roots from the
+// config next to the executable.
+void setResourceRoots(std::string_view _commonRoot,
+                      std::string_view _shaderRoot);
+
+std::string createCommonResourcePath(std::string_view _relPath);
+std::string createShaderPath(std::string_view _relPath);
+// Strips the common resource or shader root off _path, with '/' separators,
+// for names that are the same on every machine.
+std::string getAssetName(std::string_view _path);
+
+bool readFile(const std::string &_filePath, std::vector<uint8_t> &_contents);
+// Names of the directories in _dirPath, sorted so that every platform lists
+// them alike.
+std::vector<std::string> listSubdirectories(const std::string &_dirPath);
+
+} // namespace bb
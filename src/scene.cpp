@@ -1,135 +1,256 @@
 #include "scene.h"
 #include "resource.h"
+#include "gui.h"
 #include "type_conversion.h"
-#include "external/assimp/Importer.hpp"
-#include "external/assimp/scene.h"
-#include "external/assimp/postprocess.h"
 #include "external/imgui/imgui_impl_vulkan.h"
+#include <algorithm>
 #include <numeric>
 
 namespace bb {
 
+// Where crowd instance _instance stands, without getShaderBallBaseTransform().
+// The crowd is a square grid around _center, every ball turned its own way.
+static Mat4 getCrowdPlacement(int _instance, int _numPerRow, float _spacing,
+                              const Float3 &_center) {
+  float halfExtent = 0.5f * (float)(_numPerRow - 1) * _spacing;
+  Float3 pos = {(float)(_instance % _numPerRow) * _spacing - halfExtent, 0,
+                (float)(_instance / _numPerRow) * _spacing - halfExtent};
+  uint32_t hash = (uint32_t)_instance * 2654435761u;
+  float angle = (float)(hash >> 16) / 65536.f * 360.f;
+  return Mat4::translate(_center + pos) * Mat4::rotateY(angle);
+}
+
 ShaderBallScene::ShaderBallScene(CommonSceneResources *_common)
     : SceneBase(_common) {
   const Renderer &renderer = *Common->Renderer;
   VkCommandPool transientCmdPool = Common->TransientCmdPool;
   const PBRMaterialSet &materialSet = *Common->MaterialSet;
 
-  Lights.resize(3);
-  Light *light = &Lights[0];
-  light->Dir = {-1, -1, 0};
-  light->Type = LightType::Directional;
-  light->Color = {0.2347f, 0.2131f, 0.2079f};
-  light->Intensity = 10.f;
-  ++light;
-  light->Pos = {0, 2, 0};
-  light->Type = LightType::Point;
-  light->Color = {1, 0.8f, 0.8f};
-  light->Intensity = 50;
-  ++light;
-  light->Pos = {4, 2, 0};
-  light->Dir = {0, -1, 0};
-  light->Type = LightType::Point;
-  light->Color = {0.8f, 1, 0.8f};
-  light->Intensity = 50;
-  light->InnerCutOff = degToRad(30);
-  light->OuterCutOff = degToRad(25);
+  setupShaderBallLights(Lights);
+
+  // Nothing else may submit until the meshes are loaded.
+  Model model = syncWait(*Common->Async, loadMeshes());
 
   // Setup plane buffers
   {
-    std::vector<Vertex> planeVertices;
-    std::vector<uint32_t> planeIndices;
-    generatePlaneMesh(planeVertices, planeIndices);
-    Plane.VertexBuffer = createVertexBuffer(planeVertices);
-    Plane.IndexBuffer = createIndexBuffer(planeIndices);
-    Plane.NumIndices = planeIndices.size();
-
-    Plane.InstanceData.resize(Plane.NumInstances);
-    InstanceBlock &planeInstanceData = Plane.InstanceData[0];
-    planeInstanceData.ModelMat =
-        Mat4::translate({0, -10, 0}) * Mat4::scale({100.f, 100.f, 100.f});
-    planeInstanceData.InvModelMat = planeInstanceData.ModelMat.inverse();
-    Plane.InstanceBuffer = createInstanceBuffer(Plane.NumInstances);
-    updateInstanceBufferMemory(Plane.InstanceBuffer, Plane.InstanceData);
+    Plane.Instance.ModelMat = getPlaneTransform();
+    Plane.Instance.InvModelMat = Plane.Instance.ModelMat.inverse();
+  }
+
+  // The plane is lit as usual until a lightmap has been baked.
+  {
+    std::string lightmapPath =
+        createCommonResourcePath(shaderBallLightmapFileName);
+    std::vector<LightmapChart> charts;
+    if (readLightmapCharts(lightmapPath, charts) && charts.size() == 1) {
+      BakedLighting.Texture =
+          createImageFromFile(renderer, transientCmdPool, lightmapPath);
+      std::copy(std::begin(charts[0].UVTransform),
+                std::end(charts[0].UVTransform),
+                std::begin(BakedLighting.UVTransform));
+      BakedLighting.IsLoaded =
+          BakedLighting.Texture.Handle != VK_NULL_HANDLE;
+    }
   }
 
   // Setup shaderball buffers
   {
-    Assimp::Importer importer;
-    const aiScene *shaderBallScene =
-        importer.ReadFile(createCommonResourcePath("ShaderBall.fbx"),
-                          aiProcess_Triangulate | aiProcess_CalcTangentSpace);
-    const aiMesh *shaderBallMesh = shaderBallScene->mMeshes[0];
-    std::vector<Vertex> shaderBallVertices;
-    shaderBallVertices.reserve(shaderBallMesh->mNumFaces * 3);
-    for (unsigned int i = 0; i < shaderBallMesh->mNumFaces; ++i) {
-      const aiFace &face = shaderBallMesh->mFaces[i];
-      BB_ASSERT(face.mNumIndices == 3);
+    constexpr int occluderGridResolution = 24;
+    for (const SubMesh &subMesh : model.SubMeshes) {
+      const Vertex *vertices = model.Vertices.data() + subMesh.VertexOffset;
+      Occlusion.SubMeshOccluders.push_back(
+          simplifyOccluder(vertices, model.Indices.data(), subMesh.FirstIndex,
+                           subMesh.NumIndices, occluderGridResolution));
+
+      OccluderMesh fullMesh;
+      for (uint32_t i = 0; i < subMesh.NumVertices; ++i) {
+        fullMesh.Positions.push_back(vertices[i].Pos);
+      }
+      fullMesh.Indices.assign(
+          model.Indices.begin() + subMesh.FirstIndex,
+          model.Indices.begin() + subMesh.FirstIndex + subMesh.NumIndices);
+      Occlusion.SubMeshFullMeshes.push_back(std::move(fullMesh));
+    }
+
+    // Each build also splits its largest subtrees into jobs.
+    Spatial.SubMeshBVHs.resize(model.SubMeshes.size());
+    parallelFor(*Common->JobSystem, (int)model.SubMeshes.size(), 1,
+                [&](int _subMeshIndex) {
+                  const SubMesh &subMesh = model.SubMeshes[_subMeshIndex];
+                  Spatial.SubMeshBVHs[_subMeshIndex] = buildMeshBVH(
+                      *Common->JobSystem,
+                      model.Vertices.data() + subMesh.VertexOffset,
+                      model.Indices.data(), subMesh.FirstIndex,
+                      subMesh.NumIndices);
+                });
+    ShaderBall.SubMeshes = std::move(model.SubMeshes);
+    ShaderBall.Meshlets = std::move(model.Meshlets);
+    ShaderBall.Indices = std::move(model.Indices);
 
-      for (int j = 0; j < 3; ++j) {
-        unsigned int vi = face.mIndices[j];
+    makePartsRelativeToFirst(model.Parts);
+    ShaderBall.Parts = std::move(model.Parts);
 
-        Vertex v = {};
-        v.Pos = aiVector3DToFloat3(shaderBallMesh->mVertices[vi]);
-        v.UV = aiVector3DToFloat2(shaderBallMesh->mTextureCoords[0][vi]);
-        v.Normal = aiVector3DToFloat3(shaderBallMesh->mNormals[vi]);
-        v.Tangent = aiVector3DToFloat3(shaderBallMesh->mTangents[vi]);
-        shaderBallVertices.push_back(v);
+    ShaderBall.MaterialMapping.resize(model.Materials.size(), -1);
+    for (size_t i = 0; i < model.Materials.size(); ++i) {
+      for (size_t j = 0; j < materialSet.Materials.size(); ++j) {
+        if (materialSet.Materials[j].Name == model.Materials[i].Name) {
+          ShaderBall.MaterialMapping[i] = (int)j;
+          break;
+        }
       }
     }
 
-    ShaderBall.VertexBuffer = createVertexBuffer(shaderBallVertices);
-    ShaderBall.NumVertices = shaderBallVertices.size();
+    uint32_t numInstanceBlocks =
+        ShaderBall.NumInstances * (uint32_t)ShaderBall.Parts.size();
+    ShaderBall.InstanceData.resize(numInstanceBlocks);
+    ShaderBall.InstanceBuffer = createInstanceBuffer(numInstanceBlocks);
 
-    ShaderBall.InstanceData.resize(ShaderBall.NumInstances);
-    ShaderBall.InstanceBuffer = createInstanceBuffer(ShaderBall.NumInstances);
+    uint32_t maxNumCulledIndices = 0;
+    Culling.Draws.resize(numInstanceBlocks);
+    for (uint32_t d = 0; d < numInstanceBlocks; ++d) {
+      const SubMesh &subMesh =
+          ShaderBall.SubMeshes[ShaderBall.Parts[d / ShaderBall.NumInstances]
+                                   .SubMeshIndex];
+      auto &draw = Culling.Draws[d];
+      draw.FirstWorkItem = (uint32_t)Culling.WorkItemDraws.size();
+      draw.NumWorkItems = subMesh.NumMeshlets;
+      Culling.WorkItemDraws.resize(draw.FirstWorkItem + draw.NumWorkItems, d);
+      maxNumCulledIndices += subMesh.NumIndices;
+    }
+    Occlusion.Buffer =
+        createOcclusionBuffer(occlusionBufferWidth, occlusionBufferHeight);
+    Occlusion.IsDrawOccluded.resize(numInstanceBlocks);
+    Spatial.InstanceBounds.resize(numInstanceBlocks);
+    Culling.WorkItemResults.resize(Culling.WorkItemDraws.size());
+    Culling.WorkItemFirstIndices.resize(Culling.WorkItemDraws.size());
+
+    Culling.IndexBuffers.resize(Common->NumFrames);
+    for (Buffer &indexBuffer : Culling.IndexBuffers) {
+      indexBuffer = createBuffer(
+          renderer, sizeof(uint32_t) * std::max(maxNumCulledIndices, 1u),
+          VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+              VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    }
   }
 
-  VkSampler materialImageSampler =
-      Common->StandardPipelineLayout->ImmutableSamplers[SamplerType::Nearest];
+  // The crowd's impostor is baked from a whole shader ball in the space
+  // getCrowdPlacement() leaves it in.
+  {
+    size_t numParts = ShaderBall.Parts.size();
+    std::vector<InstanceBlock> bakeInstanceData(numParts);
+    AABB bounds;
+    for (size_t p = 0; p < numParts; ++p) {
+      InstanceBlock &instance = bakeInstanceData[p];
+      instance.ModelMat =
+          getShaderBallBaseTransform() * ShaderBall.Parts[p].Transform;
+      instance.InvModelMat = instance.ModelMat.inverse();
+      const SubMesh &subMesh =
+          ShaderBall.SubMeshes[ShaderBall.Parts[p].SubMeshIndex];
+      bounds.extend(transformAABB(instance.ModelMat, subMesh.Bounds));
+    }
+    Buffer bakeInstanceBuffer = createInstanceBuffer((uint32_t)numParts);
+    updateInstanceBufferMemory(bakeInstanceBuffer, bakeInstanceData);
 
-  for (auto mapType : AllEnums<PBRMapType>) {
-    const Image &image = materialSet.DefaultMaterial.Maps[mapType];
-    if (image.Handle != VK_NULL_HANDLE) {
-      GUI.DefaultMaterialTextureId[mapType] =
-          ImGui_ImplVulkan_AddTexture(materialImageSampler, image.View,
-                                      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    const ImpostorBaker &baker = *Common->ImpostorBaker;
+    Crowd.Atlas = bakeImpostorAtlas(
+        renderer, transientCmdPool, baker, bounds.center(),
+        bounds.halfExtent().length(), [&](VkCommandBuffer _cmd) {
+          bindGeometryPool(_cmd, *Common->GeometryPool);
+          VkDeviceSize offset = 0;
+          vkCmdBindVertexBuffers(_cmd, 1, 1, &bakeInstanceBuffer.Handle,
+                                 &offset);
+          for (size_t p = 0; p < numParts; ++p) {
+            const SubMesh &subMesh =
+                ShaderBall.SubMeshes[ShaderBall.Parts[p].SubMeshIndex];
+            vkCmdBindDescriptorSets(
+                _cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, baker.PipelineLayout,
+                2, 1, &baker.MaterialDescriptorSets[getPartMaterial(p)], 0,
+                nullptr);
+            vkCmdDrawIndexed(
+                _cmd, subMesh.NumIndices, 1,
+                ShaderBall.Mesh.FirstIndex + subMesh.FirstIndex,
+                ShaderBall.Mesh.VertexOffset + subMesh.VertexOffset,
+                (uint32_t)p);
+          }
+        });
+    destroyBuffer(renderer, bakeInstanceBuffer);
+
+    Crowd.MeshInstanceBuffers.resize(Common->NumFrames);
+    Crowd.ImpostorInstanceBuffers.resize(Common->NumFrames);
+    for (int i = 0; i < Common->NumFrames; ++i) {
+      Crowd.MeshInstanceBuffers[i] =
+          createInstanceBuffer(maxNumCrowdInstances * (uint32_t)numParts);
+      Crowd.ImpostorInstanceBuffers[i] =
+          createInstanceBuffer(maxNumCrowdInstances);
     }
   }
 
-  for (const PBRMaterial &material : materialSet.Materials) {
-    EnumArray<PBRMapType, ImTextureID> textureIds;
-    for (PBRMapType mapType : AllEnums<PBRMapType>) {
-      const Image &image = material.Maps[mapType];
-      if (image.Handle != VK_NULL_HANDLE) {
-        textureIds[mapType] = ImGui_ImplVulkan_AddTexture(
-            materialImageSampler, image.View,
-            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-      } else {
-        textureIds[mapType] = GUI.DefaultMaterialTextureId[mapType];
-      }
-    }
+  const ThumbnailAtlas &thumbnails = materialSet.Thumbnails;
+  GUI.ThumbnailAtlasTextureId =
+      ImGui_ImplVulkan_AddTexture(thumbnails.Sampler, thumbnails.Image.View,
+                                  VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+}
+
+Task<Model> ShaderBallScene::loadMeshes() {
+  AsyncContext &async = *Common->Async;
+  GeometryPool &geometryPool = *Common->GeometryPool;
+  Task<Model> modelTask = importModelAsync(
+      async, createCommonResourcePath("ShaderBall.fbx"));
 
-    GUI.MaterialTextureIds.push_back(textureIds);
+  std::vector<Vertex> planeVertices;
+  std::vector<uint32_t> planeIndices;
+  generatePlaneMesh(planeVertices, planeIndices);
+  Task<GeometryAllocation> planeMeshTask =
+      uploadGeometryAsync(async, geometryPool, planeVertices, planeIndices,
+                          "plane");
+  for (const Vertex &vertex : planeVertices) {
+    Occlusion.PlaneOccluder.Positions.push_back(vertex.Pos);
   }
+  Occlusion.PlaneOccluder.Indices = planeIndices;
+
+  Model model = co_await modelTask;
+  BB_ASSERT(!model.Parts.empty());
+  Task<GeometryAllocation> shaderBallMeshTask =
+      uploadGeometryAsync(async, geometryPool, model.Vertices, model.Indices,
+                          "ShaderBall.fbx");
+
+  Plane.Mesh = co_await planeMeshTask;
+  ShaderBall.Mesh = co_await shaderBallMeshTask;
+  BB_ASSERT(Plane.Mesh.NumIndices > 0 && ShaderBall.Mesh.NumIndices > 0);
+  co_return model;
 }
 
 ShaderBallScene::~ShaderBallScene() {
   const Renderer &renderer = *Common->Renderer;
 
+  for (Buffer &instanceBuffer : Crowd.MeshInstanceBuffers) {
+    destroyBuffer(renderer, instanceBuffer);
+  }
+  for (Buffer &instanceBuffer : Crowd.ImpostorInstanceBuffers) {
+    destroyBuffer(renderer, instanceBuffer);
+  }
+  destroyImpostorAtlas(renderer, Crowd.Atlas);
+
+  for (Buffer &indexBuffer : Culling.IndexBuffers) {
+    destroyBuffer(renderer, indexBuffer);
+  }
+
   destroyBuffer(renderer, ShaderBall.InstanceBuffer);
-  destroyBuffer(renderer, ShaderBall.VertexBuffer);
+  freeMesh(ShaderBall.Mesh);
 
-  destroyBuffer(renderer, Plane.IndexBuffer);
-  destroyBuffer(renderer, Plane.InstanceBuffer);
-  destroyBuffer(renderer, Plane.VertexBuffer);
+  freeMesh(Plane.Mesh);
+
+  if (BakedLighting.IsLoaded) {
+    destroyImage(renderer, BakedLighting.Texture);
+  }
 }
 
 void ShaderBallScene::updateGUI(float _dt) {
   const PBRMaterialSet &materialSet = *Common->MaterialSet;
 
   if (ImGui::Begin("Shader Balls")) {
-    for (size_t i = 0; i < ShaderBall.InstanceData.size(); ++i) {
+    for (size_t i = 0; i < ShaderBall.NumInstances; ++i) {
       std::string label = fmt::format("Shader Ball {}", i);
       if (ImGui::Selectable(label.c_str(),
                             i == GUI.SelectedShaderBallInstance)) {
@@ -139,8 +260,130 @@ void ShaderBallScene::updateGUI(float _dt) {
   }
   ImGui::End();
 
+  if (ImGui::Begin("Lightmap")) {
+    if (BakedLighting.IsLoaded) {
+      ImGui::Checkbox("Baked plane lighting", &BakedLighting.IsEnabled);
+      ImGui::TextWrapped("Shadows of the shader balls are baked at their "
+                         "initial angle.");
+    } else {
+      guiTextFmt("Run the bake_lightmap tool to bake {}",
+                 shaderBallLightmapFileName);
+    }
+  }
+  ImGui::End();
+
+  if (ImGui::Begin("Meshlet Culling")) {
+    ImGui::Checkbox("Enable", &Culling.IsEnabled);
+    ImGui::Checkbox("Frustum", &Culling.EnableFrustumCulling);
+    ImGui::Checkbox("Back-facing Cone", &Culling.EnableConeCulling);
+
+    if (Culling.IsEnabled) {
+      float numTriangles = (float)std::max(Culling.NumTriangles, 1u);
+      uint32_t numRejected =
+          Culling.NumFrustumCulledTriangles + Culling.NumBackFacingTriangles;
+      guiTextFmt("Meshlets: {} per view", Culling.WorkItemDraws.size());
+      guiTextFmt("Triangles rejected: {} / {} ({:.1f}%)", numRejected,
+                 Culling.NumTriangles, 100.f * numRejected / numTriangles);
+      guiTextFmt("  Outside frustum: {:.1f}%",
+                 100.f * Culling.NumFrustumCulledTriangles / numTriangles);
+      guiTextFmt("  Back-facing: {:.1f}%",
+                 100.f * Culling.NumBackFacingTriangles / numTriangles);
+      guiTextFmt("  Occluded: {:.1f}%",
+                 100.f * Culling.NumOccludedTriangles / numTriangles);
+    }
+
+    ImGui::Separator();
+    ImGui::Checkbox("Occlusion", &Occlusion.IsEnabled);
+    if (Culling.IsEnabled && Occlusion.IsEnabled) {
+      guiTextFmt("Occluded draws: {} / {}", Occlusion.NumOccludedDraws,
+                 Culling.Draws.size());
+      guiTextFmt("Occluder rasterization: {:.3f} ms",
+                 Occlusion.RasterizeTimeMs);
+
+      if (ImGui::Button("Measure Accuracy")) {
+        Occlusion.ShouldMeasureAccuracy = true;
+      }
+      if (Occlusion.HasAccuracy) {
+        uint32_t numHiddenDraws =
+            (uint32_t)Culling.Draws.size() - Occlusion.NumVisibleDraws;
+        guiTextFmt("Hidden draws culled: {} / {}",
+                   Occlusion.NumCulledDraws - Occlusion.NumFalselyCulledDraws,
+                   numHiddenDraws);
+        guiTextFmt("Visible draws culled by mistake: {} / {}",
+                   Occlusion.NumFalselyCulledDraws, Occlusion.NumVisibleDraws);
+      }
+    }
+  }
+  ImGui::End();
+
+  if (ImGui::Begin("Spatial Queries")) {
+    guiTextFmt("Instance BVH: {} nodes over {} draws",
+               Spatial.InstanceBVH.Nodes.size(), Spatial.InstanceBounds.size());
+    guiTextFmt("SAH cost: {:.2f} (built at {:.2f}, {} rebuilds)", Spatial.Cost,
+               Spatial.BuiltCost, Spatial.NumRebuilds);
+    size_t numTriangleNodes = 0;
+    for (const MeshBVH &meshBVH : Spatial.SubMeshBVHs) {
+      numTriangleNodes += meshBVH.Tree.Nodes.size();
+    }
+    guiTextFmt("Triangle BVHs: {} nodes over {} submeshes", numTriangleNodes,
+               Spatial.SubMeshBVHs.size());
+
+    if (ImGui::Button("Run Benchmark")) {
+      benchmarkSpatialQueries();
+    }
+    for (const std::string &result : Spatial.BenchmarkResults) {
+      ImGui::TextUnformatted(result.c_str());
+    }
+  }
+  ImGui::End();
+
+  if (ImGui::Begin("Crowd")) {
+    CrowdBenchmark &benchmark = Crowd.Benchmark;
+    if (!benchmark.IsRunning) {
+      ImGui::Checkbox("Enable", &Crowd.IsEnabled);
+      ImGui::SliderInt("Instances", &Crowd.NumInstances, 1,
+                       maxNumCrowdInstances);
+      ImGui::Checkbox("Impostors", &Crowd.UseImpostors);
+      ImGui::SliderFloat("Impostor Distance", &Crowd.ImpostorDistance, 0.f,
+                         200.f);
+    }
+    if (SceneRenderPassType != RenderPassType::Deferred) {
+      ImGui::TextUnformatted("Impostors are deferred only");
+    }
+    guiTextFmt("Meshes: {}, impostors: {}", Crowd.NumMeshes,
+               Crowd.NumImpostors);
+
+    ImGui::Separator();
+    if (benchmark.IsRunning) {
+      guiTextFmt("Benchmarking step {} of {}", benchmark.Step + 1,
+                 1 + 2 * std::size(CrowdBenchmark::InstanceCounts));
+    } else if (ImGui::Button("Benchmark Far Instances")) {
+      benchmark.IsRunning = true;
+      benchmark.Step = 0;
+      benchmark.Frame = 0;
+      benchmark.SumMs = 0;
+      benchmark.SumNumDrawn = 0;
+      benchmark.WasEnabled = Crowd.IsEnabled;
+      benchmark.UsedImpostors = Crowd.UseImpostors;
+      benchmark.SavedNumInstances = Crowd.NumInstances;
+      benchmark.SavedImpostorDistance = Crowd.ImpostorDistance;
+      SceneRenderPassType = RenderPassType::Deferred;
+      setCrowdBenchmarkStep();
+    }
+    if (benchmark.HasResults) {
+      guiTextFmt("Baseline: {:.3f} ms", benchmark.BaselineMs);
+      for (size_t i = 0; i < std::size(CrowdBenchmark::InstanceCounts); ++i) {
+        const float *instancesPerMs = benchmark.InstancesPerMs[i];
+        guiTextFmt("{:5} instances: meshes {:.0f}/ms, impostors {:.0f}/ms",
+                   CrowdBenchmark::InstanceCounts[i], instancesPerMs[0],
+                   instancesPerMs[1]);
+      }
+    }
+  }
+  ImGui::End();
+
   if (ImGui::Begin("Material Selector")) {
-    for (int i = 0; i < GUI.MaterialTextureIds.size(); ++i) {
+    for (int i = 0; i < materialSet.Materials.size(); ++i) {
 
       if (ImGui::Selectable(materialSet.Materials[i].Name.c_str(),
                             GUI.SelectedMaterial == i)) {
@@ -154,10 +397,17 @@ void ShaderBallScene::updateGUI(float _dt) {
   int col = 0;
 
   if (ImGui::Begin("Current Material")) {
-    const auto &textureIds = GUI.MaterialTextureIds[GUI.SelectedMaterial];
-
-    for (auto textureId : textureIds) {
-      ImGui::Image(textureId, {50, 50});
+    for (PBRMapType mapType : AllEnums<PBRMapType>) {
+      int tile =
+          getPBRThumbnailOrDefault(materialSet, GUI.SelectedMaterial, mapType);
+      if (tile >= 0) {
+        Float2 uv0, uv1;
+        getThumbnailUVRect(materialSet.Thumbnails, tile, uv0, uv1);
+        ImGui::Image(GUI.ThumbnailAtlasTextureId, {50, 50}, {uv0.X, uv0.Y},
+                     {uv1.X, uv1.Y});
+      } else {
+        ImGui::Dummy({50, 50});
+      }
       ++col;
       if (col < numCols) {
         ImGui::SameLine();
@@ -177,17 +427,578 @@ void ShaderBallScene::updateScene(float _dt) {
     ShaderBall.Angle -= 360;
   }
 
-  for (int i = 0; i < ShaderBall.InstanceData.size(); i++) {
-    ShaderBall.InstanceData[i].ModelMat =
-        Mat4::translate({(float)(i * 2), -1, 2}) *
-        Mat4::rotateY(ShaderBall.Angle) * Mat4::rotateX(-90) *
-        Mat4::scale({0.01f, 0.01f, 0.01f});
-    ShaderBall.InstanceData[i].InvModelMat =
-        ShaderBall.InstanceData[i].ModelMat.inverse();
+  for (int i = 0; i < ShaderBall.NumInstances; i++) {
+    Mat4 instanceMat = getShaderBallTransform(i, ShaderBall.Angle);
+    for (size_t p = 0; p < ShaderBall.Parts.size(); ++p) {
+      InstanceBlock &instance =
+          ShaderBall.InstanceData[p * ShaderBall.NumInstances + i];
+      instance.ModelMat = instanceMat * ShaderBall.Parts[p].Transform;
+      instance.InvModelMat = instance.ModelMat.inverse();
+    }
   }
 
   updateInstanceBufferMemory(ShaderBall.InstanceBuffer,
                              ShaderBall.InstanceData);
+  updateInstanceBVH();
+}
+
+void ShaderBallScene::updateInstanceBVH() {
+  // Rebuilding is only worth it once refits have let the tree get this much
+  // worse than a fresh build.
+  constexpr float maxCostIncrease = 1.5f;
+
+  bool hasMoved = false;
+  for (size_t d = 0; d < Spatial.InstanceBounds.size(); ++d) {
+    const SubMesh &subMesh =
+        ShaderBall.SubMeshes[ShaderBall.Parts[d / ShaderBall.NumInstances]
+                                 .SubMeshIndex];
+    AABB bounds =
+        transformAABB(ShaderBall.InstanceData[d].ModelMat, subMesh.Bounds);
+    AABB &oldBounds = Spatial.InstanceBounds[d];
+    if (memcmp(&bounds, &oldBounds, sizeof(AABB)) == 0) {
+      continue;
+    }
+    oldBounds = bounds;
+    hasMoved = true;
+    if (!Spatial.InstanceBVH.Nodes.empty()) {
+      updateBVHItem(Spatial.InstanceBVH, (uint32_t)d, Spatial.InstanceBounds);
+    }
+  }
+  if (!hasMoved) {
+    return;
+  }
+  ++ShadowCasterVersions[ShadowCasterType::Dynamic];
+
+  Spatial.Cost = computeBVHCost(Spatial.InstanceBVH);
+  if (Spatial.InstanceBVH.Nodes.empty() ||
+      Spatial.Cost > Spatial.BuiltCost * maxCostIncrease) {
+    Spatial.InstanceBVH =
+        buildBVH(*Common->JobSystem, Spatial.InstanceBounds, 1);
+    Spatial.BuiltCost = computeBVHCost(Spatial.InstanceBVH);
+    Spatial.Cost = Spatial.BuiltCost;
+    ++Spatial.NumRebuilds;
+  }
+}
+
+enum class MeshletCullResult : uint8_t {
+  Visible,
+  Occluded,
+  OutsideFrustum,
+  BackFacing
+};
+
+void ShaderBallScene::cullScene(const ViewUniformBlock *_views,
+                                uint32_t _numViews, uint32_t _frameIndex) {
+  const ViewUniformBlock &mainView = _views[0];
+  Spatial.ViewFrustum = extractFrustum(mainView.ProjMat * mainView.ViewMat);
+  cullCrowd(_views, _numViews);
+
+  // The frame's own buffer, whose last use the frame's fence has waited for.
+  Culling.CurrentIndexBuffer = _frameIndex;
+  if (!Culling.IsEnabled) {
+    return;
+  }
+
+  // Meshlet bounds are in submesh space, so each draw gets the frustums and
+  // view positions transformed into its own space, view by view.
+  size_t numDrawViews = Culling.Draws.size() * _numViews;
+  std::vector<Frustum> drawFrustums(numDrawViews);
+  std::vector<Float3> drawViewPositions(numDrawViews);
+  for (size_t d = 0; d < Culling.Draws.size(); ++d) {
+    const InstanceBlock &instance = ShaderBall.InstanceData[d];
+    for (uint32_t v = 0; v < _numViews; ++v) {
+      const ViewUniformBlock &view = _views[v];
+      drawFrustums[d * _numViews + v] =
+          extractFrustum(view.ProjMat * view.ViewMat * instance.ModelMat);
+      drawViewPositions[d * _numViews + v] =
+          transformPoint(instance.InvModelMat, view.ViewPos);
+    }
+  }
+
+  // The occlusion buffer only holds the main view, and a draw hidden there
+  // may still be seen by the others.
+  std::fill(Occlusion.IsDrawOccluded.begin(), Occlusion.IsDrawOccluded.end(),
+            0);
+  Occlusion.NumOccludedDraws = 0;
+  if (Occlusion.IsEnabled && _numViews == 1) {
+    Mat4 viewProj = mainView.ProjMat * mainView.ViewMat;
+    cullOccludedDraws(viewProj);
+    if (Occlusion.ShouldMeasureAccuracy) {
+      measureOcclusionAccuracy(viewProj);
+      Occlusion.ShouldMeasureAccuracy = false;
+    }
+  }
+
+  constexpr int batchSize = 256;
+  parallelFor(
+      *Common->JobSystem, (int)Culling.WorkItemDraws.size(), batchSize,
+      [&](int _item) {
+        uint32_t d = Culling.WorkItemDraws[_item];
+        const SubMesh &subMesh =
+            ShaderBall.SubMeshes[ShaderBall.Parts[d / ShaderBall.NumInstances]
+                                     .SubMeshIndex];
+        const Meshlet &meshlet =
+            ShaderBall.Meshlets[subMesh.FirstMeshlet + _item -
+                                Culling.Draws[d].FirstWorkItem];
+
+        // Culled meshlets count as back facing if any view had them in its
+        // frustum.
+        MeshletCullResult result = MeshletCullResult::OutsideFrustum;
+        if (Occlusion.IsDrawOccluded[d]) {
+          result = MeshletCullResult::Occluded;
+        } else {
+          for (uint32_t v = 0; v < _numViews; ++v) {
+            size_t drawView = d * _numViews + v;
+            if (Culling.EnableFrustumCulling &&
+                !isSphereInFrustum(drawFrustums[drawView], meshlet.Center,
+                                   meshlet.Radius)) {
+              continue;
+            }
+            if (Culling.EnableConeCulling &&
+                isMeshletBackFacing(meshlet, drawViewPositions[drawView])) {
+              result = MeshletCullResult::BackFacing;
+              continue;
+            }
+            result = MeshletCullResult::Visible;
+            break;
+          }
+        }
+        Culling.WorkItemResults[_item] = (uint8_t)result;
+      });
+
+  Culling.NumTriangles = 0;
+  Culling.NumFrustumCulledTriangles = 0;
+  Culling.NumBackFacingTriangles = 0;
+  Culling.NumOccludedTriangles = 0;
+  uint32_t numIndices = 0;
+  for (size_t d = 0; d < Culling.Draws.size(); ++d) {
+    auto &draw = Culling.Draws[d];
+    const SubMesh &subMesh =
+        ShaderBall.SubMeshes[ShaderBall.Parts[d / ShaderBall.NumInstances]
+                                 .SubMeshIndex];
+    draw.FirstIndex = numIndices;
+    for (uint32_t i = 0; i < draw.NumWorkItems; ++i) {
+      uint32_t item = draw.FirstWorkItem + i;
+      const Meshlet &meshlet = ShaderBall.Meshlets[subMesh.FirstMeshlet + i];
+      Culling.NumTriangles += meshlet.NumTriangles;
+      switch ((MeshletCullResult)Culling.WorkItemResults[item]) {
+      case MeshletCullResult::Visible:
+        Culling.WorkItemFirstIndices[item] = numIndices;
+        numIndices += meshlet.NumTriangles * 3;
+        break;
+      case MeshletCullResult::Occluded:
+        Culling.NumOccludedTriangles += meshlet.NumTriangles;
+        break;
+      case MeshletCullResult::OutsideFrustum:
+        Culling.NumFrustumCulledTriangles += meshlet.NumTriangles;
+        break;
+      case MeshletCullResult::BackFacing:
+        Culling.NumBackFacingTriangles += meshlet.NumTriangles;
+        break;
+      }
+    }
+    draw.NumIndices = numIndices - draw.FirstIndex;
+  }
+
+  const Buffer &indexBuffer = Culling.IndexBuffers[Culling.CurrentIndexBuffer];
+  if (numIndices == 0) {
+    return;
+  }
+
+  const Renderer &renderer = *Common->Renderer;
+  uint32_t *dstIndices;
+  vkMapMemory(renderer.Device, indexBuffer.Memory, 0,
+              sizeof(uint32_t) * numIndices, 0, (void **)&dstIndices);
+  parallelFor(
+      *Common->JobSystem, (int)Culling.WorkItemDraws.size(), batchSize,
+      [&](int _item) {
+        if (Culling.WorkItemResults[_item] !=
+            (uint8_t)MeshletCullResult::Visible) {
+          return;
+        }
+        uint32_t d = Culling.WorkItemDraws[_item];
+        const SubMesh &subMesh =
+            ShaderBall.SubMeshes[ShaderBall.Parts[d / ShaderBall.NumInstances]
+                                     .SubMeshIndex];
+        const Meshlet &meshlet =
+            ShaderBall.Meshlets[subMesh.FirstMeshlet + _item -
+                                Culling.Draws[d].FirstWorkItem];
+        memcpy(dstIndices + Culling.WorkItemFirstIndices[_item],
+               ShaderBall.Indices.data() + meshlet.FirstIndex,
+               sizeof(uint32_t) * meshlet.NumTriangles * 3);
+      });
+  vkUnmapMemory(renderer.Device, indexBuffer.Memory);
+}
+
+void ShaderBallScene::cullCrowd(const ViewUniformBlock *_views,
+                                uint32_t _numViews) {
+  Crowd.NumMeshes = 0;
+  Crowd.NumImpostors = 0;
+  if (!Crowd.IsEnabled ||
+      SceneRenderPassType == RenderPassType::Visibility) {
+    return;
+  }
+  Crowd.CurrentBuffer =
+      (Crowd.CurrentBuffer + 1) % (uint32_t)Crowd.MeshInstanceBuffers.size();
+
+  const ViewUniformBlock &mainView = _views[0];
+  int numInstances = std::clamp(Crowd.NumInstances, 1, maxNumCrowdInstances);
+  int numPerRow = (int)ceilf(sqrtf((float)numInstances));
+  float halfExtent = 0.5f * (float)(numPerRow - 1) * Crowd.Spacing;
+  Float3 center = {0, -1, 8.f + halfExtent};
+  if (Crowd.Benchmark.IsRunning) {
+    // Rows of the view matrix are the main view's axes.
+    const Mat4 &viewMat = mainView.ViewMat;
+    Float3 forward = {viewMat.M[0][2], viewMat.M[1][2], viewMat.M[2][2]};
+    center = mainView.ViewPos +
+             forward * (CrowdBenchmark::Distance + halfExtent);
+  }
+
+  std::vector<Frustum> frustums(_numViews);
+  for (uint32_t v = 0; v < _numViews; ++v) {
+    frustums[v] = extractFrustum(_views[v].ProjMat * _views[v].ViewMat);
+  }
+  bool useImpostors = Crowd.UseImpostors &&
+                      SceneRenderPassType == RenderPassType::Deferred &&
+                      _numViews == 1;
+
+  std::vector<Mat4> placements(numInstances);
+  std::vector<uint32_t> meshes;
+  std::vector<uint32_t> impostors;
+  for (int i = 0; i < numInstances; ++i) {
+    placements[i] =
+        getCrowdPlacement(i, numPerRow, Crowd.Spacing, center);
+    Float3 sphereCenter = transformPoint(placements[i], Crowd.Atlas.Center);
+    bool isVisible = false;
+    for (const Frustum &frustum : frustums) {
+      if (isSphereInFrustum(frustum, sphereCenter, Crowd.Atlas.Radius)) {
+        isVisible = true;
+        break;
+      }
+    }
+    if (!isVisible) {
+      continue;
+    }
+    if (useImpostors && (sphereCenter - mainView.ViewPos).length() >=
+                            Crowd.ImpostorDistance) {
+      impostors.push_back((uint32_t)i);
+    } else {
+      meshes.push_back((uint32_t)i);
+    }
+  }
+  Crowd.NumMeshes = (uint32_t)meshes.size();
+  Crowd.NumImpostors = (uint32_t)impostors.size();
+
+  const Renderer &renderer = *Common->Renderer;
+  constexpr int batchSize = 256;
+  if (!meshes.empty()) {
+    const Buffer &instanceBuffer =
+        Crowd.MeshInstanceBuffers[Crowd.CurrentBuffer];
+    InstanceBlock *instances;
+    vkMapMemory(renderer.Device, instanceBuffer.Memory, 0,
+                instanceBuffer.Size, 0, (void **)&instances);
+    size_t numParts = ShaderBall.Parts.size();
+    parallelFor(*Common->JobSystem, (int)meshes.size(), batchSize,
+                [&](int _mesh) {
+                  Mat4 ballMat =
+                      placements[meshes[_mesh]] * getShaderBallBaseTransform();
+                  for (size_t p = 0; p < numParts; ++p) {
+                    InstanceBlock &instance =
+                        instances[p * maxNumCrowdInstances + _mesh];
+                    instance.ModelMat =
+                        ballMat * ShaderBall.Parts[p].Transform;
+                    instance.InvModelMat = instance.ModelMat.inverse();
+                  }
+                });
+    vkUnmapMemory(renderer.Device, instanceBuffer.Memory);
+  }
+  if (!impostors.empty()) {
+    const Buffer &instanceBuffer =
+        Crowd.ImpostorInstanceBuffers[Crowd.CurrentBuffer];
+    InstanceBlock *instances;
+    vkMapMemory(renderer.Device, instanceBuffer.Memory, 0,
+                instanceBuffer.Size, 0, (void **)&instances);
+    parallelFor(*Common->JobSystem, (int)impostors.size(), batchSize,
+                [&](int _impostor) {
+                  InstanceBlock &instance = instances[_impostor];
+                  instance.ModelMat = getImpostorModelMat(
+                      Crowd.Atlas, placements[impostors[_impostor]]);
+                  instance.InvModelMat = instance.ModelMat.inverse();
+                });
+    vkUnmapMemory(renderer.Device, instanceBuffer.Memory);
+  }
+}
+
+void ShaderBallScene::cullOccludedDraws(const Mat4 &_viewProj) {
+  Time startTime = getCurrentTime();
+
+  std::vector<OccluderInstance> occluders;
+  occluders.reserve(Culling.Draws.size() + 1);
+  occluders.push_back(
+      {&Occlusion.PlaneOccluder, _viewProj * Plane.Instance.ModelMat});
+  for (size_t d = 0; d < Culling.Draws.size(); ++d) {
+    uint32_t subMeshIndex =
+        ShaderBall.Parts[d / ShaderBall.NumInstances].SubMeshIndex;
+    occluders.push_back({&Occlusion.SubMeshOccluders[subMeshIndex],
+                         _viewProj * ShaderBall.InstanceData[d].ModelMat});
+  }
+  rasterizeOccluders(*Common->JobSystem, Occlusion.Buffer, occluders);
+
+  // A draw never occludes itself: its simplified occluder lies inside the
+  // bounds being tested, so it is never strictly closer than them.
+  for (size_t d = 0; d < Culling.Draws.size(); ++d) {
+    const SubMesh &subMesh =
+        ShaderBall.SubMeshes[ShaderBall.Parts[d / ShaderBall.NumInstances]
+                                 .SubMeshIndex];
+    if (isAABBOccluded(Occlusion.Buffer,
+                       occluders[d + 1].ModelViewProj, subMesh.Bounds)) {
+      Occlusion.IsDrawOccluded[d] = 1;
+      ++Occlusion.NumOccludedDraws;
+    }
+  }
+
+  Occlusion.RasterizeTimeMs =
+      getElapsedTimeInSeconds(startTime, getCurrentTime()) * 1000.f;
+}
+
+void ShaderBallScene::measureOcclusionAccuracy(const Mat4 &_viewProj) {
+  constexpr int groundTruthScale = 4;
+  OcclusionBuffer groundTruth =
+      createOcclusionBuffer(occlusionBufferWidth * groundTruthScale,
+                            occlusionBufferHeight * groundTruthScale);
+  std::vector<uint32_t> ids(groundTruth.Depth.size());
+
+  // Id 0 is the background and 1 the plane; draw d gets d + 2.
+  std::vector<OccluderInstance> meshes;
+  meshes.push_back({&Occlusion.PlaneOccluder,
+                    _viewProj * Plane.Instance.ModelMat, 1});
+  for (size_t d = 0; d < Culling.Draws.size(); ++d) {
+    uint32_t subMeshIndex =
+        ShaderBall.Parts[d / ShaderBall.NumInstances].SubMeshIndex;
+    meshes.push_back({&Occlusion.SubMeshFullMeshes[subMeshIndex],
+                      _viewProj * ShaderBall.InstanceData[d].ModelMat,
+                      (uint32_t)d + 2});
+  }
+  rasterizeOccluders(*Common->JobSystem, groundTruth, meshes, ids.data(),
+                     OcclusionCoverage::PixelCenter);
+
+  std::vector<uint8_t> isDrawVisible(Culling.Draws.size(), 0);
+  for (uint32_t id : ids) {
+    if (id >= 2) {
+      isDrawVisible[id - 2] = 1;
+    }
+  }
+
+  Occlusion.NumVisibleDraws = 0;
+  Occlusion.NumCulledDraws = 0;
+  Occlusion.NumFalselyCulledDraws = 0;
+  for (size_t d = 0; d < Culling.Draws.size(); ++d) {
+    Occlusion.NumVisibleDraws += isDrawVisible[d];
+    Occlusion.NumCulledDraws += Occlusion.IsDrawOccluded[d];
+    Occlusion.NumFalselyCulledDraws +=
+        isDrawVisible[d] && Occlusion.IsDrawOccluded[d];
+  }
+  Occlusion.HasAccuracy = true;
+
+  BB_LOG_INFO("Occlusion accuracy: {} of {} draws visible, {} culled, {} of "
+              "them visible",
+              Occlusion.NumVisibleDraws, Culling.Draws.size(),
+              Occlusion.NumCulledDraws, Occlusion.NumFalselyCulledDraws);
+}
+
+void ShaderBallScene::pickObject(const Ray &_ray) {
+  RayHit hit = raycastShaderBalls(_ray);
+  GUI.SelectedShaderBallInstance =
+      hit.Item == UINT32_MAX ? -1 : (int)(hit.Item % ShaderBall.NumInstances);
+}
+
+RayHit ShaderBallScene::raycastShaderBalls(const Ray &_ray) const {
+  // Hit items are draws. The ray goes into each draw's own space instead of
+  // moving the triangles; distances stay comparable since Dir isn't
+  // renormalized.
+  return raycastBVH(
+      Spatial.InstanceBVH, _ray, [this](uint32_t _draw, const Ray &_worldRay) {
+        const InstanceBlock &instance = ShaderBall.InstanceData[_draw];
+        uint32_t subMeshIndex =
+            ShaderBall.Parts[_draw / ShaderBall.NumInstances].SubMeshIndex;
+        Ray localRay;
+        localRay.Origin = transformPoint(instance.InvModelMat, _worldRay.Origin);
+        localRay.Dir = transformDirection(instance.InvModelMat, _worldRay.Dir);
+        localRay.MaxT = _worldRay.MaxT;
+        return raycastMeshBVH(Spatial.SubMeshBVHs[subMeshIndex], localRay).T;
+      });
+}
+
+void ShaderBallScene::benchmarkSpatialQueries() {
+  JobSystem &jobSystem = *Common->JobSystem;
+  Spatial.BenchmarkResults.clear();
+  auto addResult = [this](std::string _result) {
+    BB_LOG_INFO("{}", _result);
+    Spatial.BenchmarkResults.push_back(std::move(_result));
+  };
+
+  // Every test repeats until it has run for a while, so that a single slow
+  // iteration or preemption doesn't skew the rate.
+  constexpr float minSeconds = 0.25f;
+
+  {
+    std::vector<std::vector<AABB>> triangleBounds;
+    uint32_t numTriangles = 0;
+    for (const MeshBVH &meshBVH : Spatial.SubMeshBVHs) {
+      std::vector<AABB> &bounds = triangleBounds.emplace_back();
+      bounds.resize(meshBVH.Corners.size() / 3);
+      for (size_t t = 0; t < bounds.size(); ++t) {
+        for (int k = 0; k < 3; ++k) {
+          bounds[t].extend(meshBVH.Corners[t * 3 + k]);
+        }
+      }
+      numTriangles += (uint32_t)bounds.size();
+    }
+
+    Time startTime = getCurrentTime();
+    uint32_t numBuilds = 0;
+    float seconds;
+    do {
+      for (const std::vector<AABB> &bounds : triangleBounds) {
+        buildBVH(jobSystem, bounds);
+      }
+      ++numBuilds;
+      seconds = getElapsedTimeInMs(startTime, getCurrentTime()) / 1000.f;
+    } while (seconds < minSeconds);
+    addResult(fmt::format("Triangle BVH build: {:.2f} M triangles/s",
+                          numTriangles * numBuilds / seconds / 1e6f));
+  }
+
+  if (Spatial.InstanceBVH.Nodes.empty()) {
+    return;
+  }
+  const AABB &sceneBounds = Spatial.InstanceBVH.Nodes[0].Bounds;
+  Float3 sceneCenter = sceneBounds.center();
+  Float3 sceneExtent = sceneBounds.halfExtent();
+  float sceneRadius = sceneExtent.length();
+
+  // Rays from a sphere around the scene towards random points inside it, so
+  // that most of them hit something.
+  constexpr int numRays = 1 << 14;
+  std::vector<Ray> rays(numRays);
+  uint32_t seed = 1;
+  auto random = [&seed]() {
+    seed = seed * 1664525u + 1013904223u;
+    return (float)(seed >> 8) / (float)(1 << 24) * 2.f - 1.f;
+  };
+  for (Ray &ray : rays) {
+    Float3 from = {random(), random(), random()};
+    Float3 to = {random() * sceneExtent.X, random() * sceneExtent.Y,
+                 random() * sceneExtent.Z};
+    ray.Origin = sceneCenter + from / std::max(from.length(), 1e-3f) *
+                                   (sceneRadius * 2.f);
+    ray.Dir = sceneCenter + to - ray.Origin;
+  }
+
+  {
+    std::vector<uint32_t> hits(numRays);
+    Time startTime = getCurrentTime();
+    uint32_t numPasses = 0;
+    float seconds;
+    do {
+      parallelFor(jobSystem, numRays, 256, [&](int _ray) {
+        hits[_ray] = raycastShaderBalls(rays[_ray]).Item != UINT32_MAX;
+      });
+      ++numPasses;
+      seconds = getElapsedTimeInMs(startTime, getCurrentTime()) / 1000.f;
+    } while (seconds < minSeconds);
+    uint32_t numHits = std::accumulate(hits.begin(), hits.end(), 0u);
+    addResult(fmt::format("Raycasts: {:.2f} M rays/s ({:.0f}% hit)",
+                          numRays * numPasses / seconds / 1e6f,
+                          100.f * numHits / numRays));
+  }
+
+  {
+    std::vector<uint32_t> items;
+    Time startTime = getCurrentTime();
+    uint32_t numQueries = 0;
+    float seconds;
+    do {
+      for (int i = 0; i < 1000; ++i) {
+        items.clear();
+        queryBVH(Spatial.InstanceBVH, Spatial.InstanceBounds,
+                 Spatial.ViewFrustum, items);
+      }
+      numQueries += 1000;
+      seconds = getElapsedTimeInMs(startTime, getCurrentTime()) / 1000.f;
+    } while (seconds < minSeconds);
+    addResult(fmt::format("Frustum queries: {:.2f} M/s ({} draws in view)",
+                          numQueries / seconds / 1e6f, items.size()));
+  }
+
+  {
+    std::vector<uint32_t> items;
+    size_t numFound = 0;
+    Time startTime = getCurrentTime();
+    uint32_t numQueries = 0;
+    float seconds;
+    do {
+      for (const Ray &ray : rays) {
+        items.clear();
+        queryBVH(Spatial.InstanceBVH, Spatial.InstanceBounds,
+                 ray.Origin + ray.Dir, sceneRadius * 0.25f, items);
+        numFound += items.size();
+      }
+      numQueries += numRays;
+      seconds = getElapsedTimeInMs(startTime, getCurrentTime()) / 1000.f;
+    } while (seconds < minSeconds);
+    addResult(fmt::format("Sphere queries: {:.2f} M/s ({:.1f} draws each)",
+                          numQueries / seconds / 1e6f,
+                          (float)numFound / numQueries));
+  }
+}
+
+int ShaderBallScene::getPartMaterial(size_t _part) const {
+  const SubMesh &subMesh =
+      ShaderBall.SubMeshes[ShaderBall.Parts[_part].SubMeshIndex];
+  if (subMesh.MaterialIndex < ShaderBall.MaterialMapping.size() &&
+      ShaderBall.MaterialMapping[subMesh.MaterialIndex] >= 0) {
+    return ShaderBall.MaterialMapping[subMesh.MaterialIndex];
+  }
+  return GUI.SelectedMaterial;
+}
+
+// Records follow InstanceData, then the plane, matching the instance indices
+// drawScene() draws with.
+void ShaderBallScene::getVisibilityDraws(std::vector<VisibilityDraw> &_draws,
+                                         VkBuffer &_sceneIndexBuffer) const {
+  if (Culling.IsEnabled) {
+    _sceneIndexBuffer = Culling.IndexBuffers[Culling.CurrentIndexBuffer].Handle;
+  }
+
+  for (size_t d = 0; d < ShaderBall.InstanceData.size(); ++d) {
+    size_t p = d / ShaderBall.NumInstances;
+    const SubMesh &subMesh =
+        ShaderBall.SubMeshes[ShaderBall.Parts[p].SubMeshIndex];
+
+    VisibilityDraw draw = {};
+    draw.ModelMat = ShaderBall.InstanceData[d].ModelMat;
+    draw.InvModelMat = ShaderBall.InstanceData[d].InvModelMat;
+    draw.VertexOffset = ShaderBall.Mesh.VertexOffset + subMesh.VertexOffset;
+    draw.Material = (uint32_t)getPartMaterial(p);
+    if (Culling.IsEnabled) {
+      draw.FirstIndex = Culling.Draws[d].FirstIndex;
+      draw.IndexSource = VisibilityIndexSource::Scene;
+    } else {
+      draw.FirstIndex = ShaderBall.Mesh.FirstIndex + subMesh.FirstIndex;
+      draw.IndexSource = VisibilityIndexSource::GeometryPool;
+    }
+    _draws.push_back(draw);
+  }
+
+  VisibilityDraw planeDraw = {};
+  planeDraw.ModelMat = Plane.Instance.ModelMat;
+  planeDraw.InvModelMat = Plane.Instance.InvModelMat;
+  planeDraw.FirstIndex = Plane.Mesh.FirstIndex;
+  planeDraw.VertexOffset = Plane.Mesh.VertexOffset;
+  planeDraw.IndexSource = VisibilityIndexSource::GeometryPool;
+  planeDraw.Material = (uint32_t)GUI.SelectedMaterial;
+  _draws.push_back(planeDraw);
 }
 
 void ShaderBallScene::drawScene(const Frame &_frame) {
@@ -195,19 +1006,494 @@ void ShaderBallScene::drawScene(const Frame &_frame) {
   const StandardPipelineLayout &standardPipelineLayout =
       *Common->StandardPipelineLayout;
 
+  bindInstanceBuffer(cmd, ShaderBall.InstanceBuffer.Handle);
+  // Shader ball draws start at the instance of their first record.
+  pushVisibilityDrawIdBase(cmd, 0);
+
+  if (Culling.IsEnabled) {
+    vkCmdBindIndexBuffer(
+        cmd, Culling.IndexBuffers[Culling.CurrentIndexBuffer].Handle, 0,
+        VK_INDEX_TYPE_UINT32);
+  }
+
+  int boundMaterial = -1;
+  for (size_t p = 0; p < ShaderBall.Parts.size(); ++p) {
+    const SubMesh &subMesh =
+        ShaderBall.SubMeshes[ShaderBall.Parts[p].SubMeshIndex];
+
+    int material = getPartMaterial(p);
+    if (material != boundMaterial) {
+      vkCmdBindDescriptorSets(
+          cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, standardPipelineLayout.Handle,
+          2, 1, &_frame.MaterialDescriptorSets[material], 0, nullptr);
+      boundMaterial = material;
+    }
+
+    int32_t vertexOffset = ShaderBall.Mesh.VertexOffset + subMesh.VertexOffset;
+    if (!Culling.IsEnabled) {
+      vkCmdDrawIndexed(cmd, subMesh.NumIndices, ShaderBall.NumInstances,
+                       ShaderBall.Mesh.FirstIndex + subMesh.FirstIndex,
+                       vertexOffset, (uint32_t)p * ShaderBall.NumInstances);
+      continue;
+    }
+
+    for (uint32_t i = 0; i < ShaderBall.NumInstances; ++i) {
+      uint32_t d = (uint32_t)p * ShaderBall.NumInstances + i;
+      const auto &draw = Culling.Draws[d];
+      if (draw.NumIndices > 0) {
+        vkCmdDrawIndexed(cmd, draw.NumIndices, 1, draw.FirstIndex,
+                         vertexOffset, d);
+      }
+    }
+  }
+
+  if (Culling.IsEnabled) {
+    vkCmdBindIndexBuffer(cmd, Common->GeometryPool->IndexBuffer.Handle, 0,
+                         VK_INDEX_TYPE_UINT32);
+  }
+
   vkCmdBindDescriptorSets(
       cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, standardPipelineLayout.Handle, 2, 1,
       &_frame.MaterialDescriptorSets[GUI.SelectedMaterial], 0, nullptr);
 
+  pushVisibilityDrawIdBase(cmd, (int32_t)ShaderBall.InstanceData.size());
+  bool isPlaneLightmapped = BakedLighting.IsLoaded && BakedLighting.IsEnabled;
+  if (isPlaneLightmapped) {
+    pushLightmapChart(cmd, BakedLighting.UVTransform);
+  }
+  drawMesh(cmd, Plane.Mesh, &Plane.Instance, 1);
+  if (isPlaneLightmapped) {
+    pushLightmapChart(cmd, nullptr);
+  }
+
+  if (Crowd.NumMeshes > 0) {
+    bindInstanceBuffer(cmd,
+                       Crowd.MeshInstanceBuffers[Crowd.CurrentBuffer].Handle);
+    boundMaterial = GUI.SelectedMaterial;
+    for (size_t p = 0; p < ShaderBall.Parts.size(); ++p) {
+      const SubMesh &subMesh =
+          ShaderBall.SubMeshes[ShaderBall.Parts[p].SubMeshIndex];
+      int material = getPartMaterial(p);
+      if (material != boundMaterial) {
+        vkCmdBindDescriptorSets(
+            cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+            standardPipelineLayout.Handle, 2, 1,
+            &_frame.MaterialDescriptorSets[material], 0, nullptr);
+        boundMaterial = material;
+      }
+      vkCmdDrawIndexed(cmd, subMesh.NumIndices, Crowd.NumMeshes,
+                       ShaderBall.Mesh.FirstIndex + subMesh.FirstIndex,
+                       ShaderBall.Mesh.VertexOffset + subMesh.VertexOffset,
+                       (uint32_t)p * maxNumCrowdInstances);
+    }
+  }
+}
+
+void ShaderBallScene::drawImpostors(const Frame &_frame) {
+  if (Crowd.NumImpostors == 0) {
+    return;
+  }
+  VkCommandBuffer cmd = _frame.CmdBuffer;
+  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          Common->StandardPipelineLayout->Handle, 2, 1,
+                          &Crowd.Atlas.DescriptorSet, 0, nullptr);
   VkDeviceSize offset = 0;
-  vkCmdBindVertexBuffers(cmd, 0, 1, &ShaderBall.VertexBuffer.Handle, &offset);
-  vkCmdBindVertexBuffers(cmd, 1, 1, &ShaderBall.InstanceBuffer.Handle, &offset);
-  vkCmdDraw(cmd, ShaderBall.NumVertices, ShaderBall.NumInstances, 0, 0);
+  vkCmdBindVertexBuffers(
+      cmd, 1, 1, &Crowd.ImpostorInstanceBuffers[Crowd.CurrentBuffer].Handle,
+      &offset);
+  vkCmdDraw(cmd, 6, Crowd.NumImpostors, 0, 0);
+}
+
+void ShaderBallScene::drawShadowCasters(VkCommandBuffer _cmd,
+                                        ShadowCasterType _casterType) {
+  if (_casterType == ShadowCasterType::Static) {
+    drawMesh(_cmd, Plane.Mesh, &Plane.Instance, 1);
+    return;
+  }
+
+  // Unculled, as shadows fall from outside the view too.
+  bindInstanceBuffer(_cmd, ShaderBall.InstanceBuffer.Handle);
+  for (size_t p = 0; p < ShaderBall.Parts.size(); ++p) {
+    const SubMesh &subMesh =
+        ShaderBall.SubMeshes[ShaderBall.Parts[p].SubMeshIndex];
+    vkCmdDrawIndexed(_cmd, subMesh.NumIndices, ShaderBall.NumInstances,
+                     ShaderBall.Mesh.FirstIndex + subMesh.FirstIndex,
+                     ShaderBall.Mesh.VertexOffset + subMesh.VertexOffset,
+                     (uint32_t)p * ShaderBall.NumInstances);
+  }
+}
+
+VkImageView ShaderBallScene::getLightmap() const {
+  return BakedLighting.IsLoaded ? BakedLighting.Texture.View : VK_NULL_HANDLE;
+}
+
+void ShaderBallScene::setCrowdBenchmarkStep() {
+  const CrowdBenchmark &benchmark = Crowd.Benchmark;
+  Crowd.IsEnabled = benchmark.Step > 0;
+  if (benchmark.Step > 0) {
+    Crowd.NumInstances =
+        CrowdBenchmark::InstanceCounts[(benchmark.Step - 1) / 2];
+    Crowd.UseImpostors = (benchmark.Step - 1) % 2 == 1;
+    Crowd.ImpostorDistance = 0.f;
+  }
+}
+
+void ShaderBallScene::onGeometryPassTimed(double _gpuMs) {
+  CrowdBenchmark &benchmark = Crowd.Benchmark;
+  if (!benchmark.IsRunning) {
+    return;
+  }
+  constexpr int numSteps =
+      1 + 2 * (int)std::size(CrowdBenchmark::InstanceCounts);
+
+  if (benchmark.Frame >= CrowdBenchmark::NumWarmupFrames) {
+    benchmark.SumMs += _gpuMs;
+    benchmark.SumNumDrawn += Crowd.NumMeshes + Crowd.NumImpostors;
+  }
+  if (++benchmark.Frame < CrowdBenchmark::NumWarmupFrames +
+                              CrowdBenchmark::NumMeasuredFrames) {
+    return;
+  }
+
+  float ms = (float)(benchmark.SumMs / CrowdBenchmark::NumMeasuredFrames);
+  if (benchmark.Step == 0) {
+    benchmark.BaselineMs = ms;
+    BB_LOG_INFO("Crowd benchmark baseline: {:.3f} ms", ms);
+  } else {
+    int count = (benchmark.Step - 1) / 2;
+    int useImpostors = (benchmark.Step - 1) % 2;
+    float numDrawn = (float)benchmark.SumNumDrawn /
+                     (float)CrowdBenchmark::NumMeasuredFrames;
+    // Guards against instances too cheap to rise above timer noise.
+    float crowdMs = std::max(ms - benchmark.BaselineMs, 1e-3f);
+    benchmark.InstancesPerMs[count][useImpostors] = numDrawn / crowdMs;
+    BB_LOG_INFO("Crowd benchmark: {} {} drawn of {} in {:.3f} ms, {:.0f} "
+                "per ms",
+                numDrawn, useImpostors ? "impostors" : "meshes",
+                CrowdBenchmark::InstanceCounts[count], crowdMs,
+                numDrawn / crowdMs);
+  }
+
+  benchmark.Frame = 0;
+  benchmark.SumMs = 0;
+  benchmark.SumNumDrawn = 0;
+  if (++benchmark.Step == numSteps) {
+    benchmark.IsRunning = false;
+    benchmark.HasResults = true;
+    Crowd.IsEnabled = benchmark.WasEnabled;
+    Crowd.UseImpostors = benchmark.UsedImpostors;
+    Crowd.NumInstances = benchmark.SavedNumInstances;
+    Crowd.ImpostorDistance = benchmark.SavedImpostorDistance;
+    return;
+  }
+  setCrowdBenchmarkStep();
+}
+
+FileScene::FileScene(CommonSceneResources *_common,
+                     const std::string &_filePath)
+    : SceneBase(_common), FilePath(_filePath) {
+  Time startTime = getCurrentTime();
+  SceneFile file;
+  if (!openSceneFile(FilePath, file)) {
+    return;
+  }
+  Stats.OpenMs = getElapsedTimeInMs(startTime, getCurrentTime());
+  loadSceneFile(file);
+  closeSceneFile(file);
+  Stats.IsLoaded = true;
+}
+
+FileScene::~FileScene() {
+  if (InstanceBuffer.Handle != VK_NULL_HANDLE) {
+    destroyBuffer(*Common->Renderer, InstanceBuffer);
+  }
+  for (Mesh &mesh : Meshes) {
+    if (mesh.Allocation.NumIndices > 0) {
+      freeMesh(mesh.Allocation);
+    }
+  }
+}
+
+void FileScene::loadSceneFile(const SceneFile &_file) {
+  const SceneFileHeader &header = *_file.Header;
+  const PBRMaterialSet &materialSet = *Common->MaterialSet;
+  Stats.NumFileInstances = header.NumInstances;
+
+  // Meshes that fail to import are left empty, and their instances out.
+  Time startTime = getCurrentTime();
+  for (uint32_t m = 0; m < header.NumMeshes; ++m) {
+    const SceneFileMesh &fileMesh = _file.Meshes[m];
+    Model model = importModel(
+        *Common->JobSystem,
+        createCommonResourcePath(getSceneFileString(_file, fileMesh.Path)));
+    Mesh &mesh = Meshes.emplace_back();
+    if (model.Indices.empty()) {
+      continue;
+    }
+    mesh.Allocation = uploadMesh(model.Vertices, model.Indices,
+                                 getSceneFileString(_file, fileMesh.Name));
+    mesh.SubMeshes = std::move(model.SubMeshes);
+    mesh.Parts = std::move(model.Parts);
+  }
+  Stats.MeshLoadMs = getElapsedTimeInMs(startTime, getCurrentTime());
+
+  // Materials the set doesn't have fall back to its first one.
+  std::vector<int> materials(header.NumMaterials, 0);
+  for (uint32_t m = 0; m < header.NumMaterials; ++m) {
+    const char *name = getSceneFileString(_file, _file.Materials[m].Name);
+    auto it = std::find_if(
+        materialSet.Materials.begin(), materialSet.Materials.end(),
+        [&](const PBRMaterial &_material) { return _material.Name == name; });
+    if (it != materialSet.Materials.end()) {
+      materials[m] = (int)(it - materialSet.Materials.begin());
+    } else {
+      Stats.NumUnknownMaterials++;
+    }
+  }
+
+  // Counting sort of instances by mesh, then material. Instances whose
+  // indices are out of range are left out.
+  startTime = getCurrentTime();
+  uint32_t numKeys = header.NumMeshes * header.NumMaterials;
+  auto getKey = [&](uint32_t _instance) {
+    uint32_t mesh = _file.InstanceMeshes[_instance];
+    uint32_t material = _file.InstanceMaterials[_instance];
+    if (mesh >= header.NumMeshes || material >= header.NumMaterials) {
+      return numKeys;
+    }
+    return mesh * header.NumMaterials + material;
+  };
+  // One more key for those left out.
+  std::vector<uint32_t> keyOffsets(numKeys + 2, 0);
+  for (uint32_t i = 0; i < header.NumInstances; ++i) {
+    keyOffsets[getKey(i) + 1]++;
+  }
+  std::partial_sum(keyOffsets.begin(), keyOffsets.end(), keyOffsets.begin());
+  std::vector<uint32_t> sortedInstances(header.NumInstances);
+  std::vector<uint32_t> cursors(keyOffsets.begin(), keyOffsets.end() - 1);
+  for (uint32_t i = 0; i < header.NumInstances; ++i) {
+    sortedInstances[cursors[getKey(i)]++] = i;
+  }
+
+  // Groups take blocks in order until the budget runs out.
+  std::vector<uint32_t> groupFirstInstances;
+  for (uint32_t key = 0; key < numKeys; ++key) {
+    uint32_t mesh = key / header.NumMaterials;
+    uint32_t numParts = (uint32_t)Meshes[mesh].Parts.size();
+    if (numParts == 0) {
+      continue;
+    }
+    uint32_t numInstances = std::min(
+        keyOffsets[key + 1] - keyOffsets[key],
+        (maxNumFileSceneInstanceBlocks - NumInstanceBlocks) / numParts);
+    if (numInstances == 0) {
+      continue;
+    }
+    DrawGroups.push_back({mesh, materials[key % header.NumMaterials],
+                          NumInstanceBlocks, numInstances});
+    groupFirstInstances.push_back(keyOffsets[key]);
+    NumInstanceBlocks += numInstances * numParts;
+    Stats.NumDrawnInstances += numInstances;
+  }
+  Stats.GroupMs = getElapsedTimeInMs(startTime, getCurrentTime());
+
+  startTime = getCurrentTime();
+  if (NumInstanceBlocks > 0) {
+    const Renderer &renderer = *Common->Renderer;
+    InstanceBuffer = createInstanceBuffer(NumInstanceBlocks);
+    InstanceBlock *blocks;
+    vkMapMemory(renderer.Device, InstanceBuffer.Memory, 0, InstanceBuffer.Size,
+                0, (void **)&blocks);
 
-  vkCmdBindVertexBuffers(cmd, 0, 1, &Plane.VertexBuffer.Handle, &offset);
-  vkCmdBindVertexBuffers(cmd, 1, 1, &Plane.InstanceBuffer.Handle, &offset);
-  vkCmdBindIndexBuffer(cmd, Plane.IndexBuffer.Handle, 0, VK_INDEX_TYPE_UINT32);
-  vkCmdDrawIndexed(cmd, Plane.NumIndices, Plane.NumInstances, 0, 0, 0);
+    constexpr uint32_t batchSize = 4096;
+    for (size_t g = 0; g < DrawGroups.size(); ++g) {
+      const DrawGroup &group = DrawGroups[g];
+      const uint32_t *instances = &sortedInstances[groupFirstInstances[g]];
+      const std::vector<ModelPart> &parts = Meshes[group.Mesh].Parts;
+      for (size_t p = 0; p < parts.size(); ++p) {
+        InstanceBlock *dst =
+            blocks + group.FirstBlock + (uint32_t)p * group.NumInstances;
+        int numBatches =
+            (int)((group.NumInstances + batchSize - 1) / batchSize);
+        parallelFor(*Common->JobSystem, numBatches, 1, [&](int _batch) {
+          uint32_t first = (uint32_t)_batch * batchSize;
+          expandSceneFileInstances(
+              _file, instances + first,
+              std::min(batchSize, group.NumInstances - first),
+              parts[p].Transform, dst + first);
+        });
+      }
+    }
+    VisibilityInstances.assign(
+        blocks, blocks + std::min(NumInstanceBlocks, maxNumVisibilityDraws));
+    vkUnmapMemory(renderer.Device, InstanceBuffer.Memory);
+  }
+  Stats.ExpandMs = getElapsedTimeInMs(startTime, getCurrentTime());
+
+  for (uint32_t i = 0; i < header.NumLights; ++i) {
+    const SceneFileLight &fileLight = _file.Lights[i];
+    if (Lights.size() + 1 >= MAX_NUM_LIGHTS) {
+      break;
+    }
+    if (fileLight.Type < 0 || fileLight.Type > (int)LightType::Directional) {
+      continue;
+    }
+    Light &light = Lights.emplace_back();
+    light.Pos = fileLight.Pos;
+    light.Type = (LightType)fileLight.Type;
+    light.Dir = fileLight.Dir;
+    light.Intensity = fileLight.Intensity;
+    light.Color = fileLight.Color;
+    light.InnerCutOff = fileLight.InnerCutOff;
+    light.OuterCutOff = fileLight.OuterCutOff;
+  }
+
+  for (uint32_t i = 0; i < header.NumCameras; ++i) {
+    const SceneFileCamera &fileCamera = _file.Cameras[i];
+    CameraNames.push_back(getSceneFileString(_file, fileCamera.Name));
+    Cameras.push_back({fileCamera.Pos, fileCamera.Yaw, fileCamera.Pitch});
+  }
+  // The view starts at the first preset.
+  PendingCamera = Cameras.empty() ? -1 : 0;
+}
+
+void FileScene::updateGUI(float _dt) {
+  if (ImGui::Begin("Scene File")) {
+    ImGui::TextUnformatted(FilePath.c_str());
+    if (!Stats.IsLoaded) {
+      ImGui::TextUnformatted("Failed to open, see --convert-scene.");
+    } else {
+      guiTextFmt("Instances: {} drawn of {}", Stats.NumDrawnInstances,
+                 Stats.NumFileInstances);
+      guiTextFmt("Draw groups: {}, instance blocks: {}", DrawGroups.size(),
+                 NumInstanceBlocks);
+      if (Stats.NumUnknownMaterials > 0) {
+        guiTextFmt("Unknown materials: {}", Stats.NumUnknownMaterials);
+      }
+      guiTextFmt("Open: {:.3f} ms", Stats.OpenMs);
+      guiTextFmt("Group: {:.2f} ms, expand: {:.2f} ms", Stats.GroupMs,
+                 Stats.ExpandMs);
+      guiTextFmt("Meshes: {:.0f} ms", Stats.MeshLoadMs);
+      if (SceneRenderPassType == RenderPassType::Visibility &&
+          NumInstanceBlocks > maxNumVisibilityDraws) {
+        guiTextFmt("Visibility draws only the first {} blocks",
+                   maxNumVisibilityDraws);
+      }
+
+      if (!Cameras.empty()) {
+        ImGui::Separator();
+        ImGui::TextUnformatted("Cameras");
+        for (size_t i = 0; i < Cameras.size(); ++i) {
+          ImGui::PushID((int)i);
+          if (ImGui::Button(CameraNames[i].c_str())) {
+            PendingCamera = (int)i;
+          }
+          ImGui::PopID();
+        }
+      }
+    }
+  }
+  ImGui::End();
+}
+
+template <typename Fn>
+void FileScene::forEachDraw(uint32_t _maxNumBlocks, const Fn &_fn) const {
+  for (const DrawGroup &group : DrawGroups) {
+    const Mesh &mesh = Meshes[group.Mesh];
+    for (size_t p = 0; p < mesh.Parts.size(); ++p) {
+      uint32_t firstBlock = group.FirstBlock + (uint32_t)p * group.NumInstances;
+      if (firstBlock >= _maxNumBlocks) {
+        return;
+      }
+      const SubMesh &subMesh = mesh.SubMeshes[mesh.Parts[p].SubMeshIndex];
+      _fn(group, subMesh, firstBlock,
+          std::min(group.NumInstances, _maxNumBlocks - firstBlock));
+    }
+  }
+}
+
+uint32_t FileScene::getNumDrawnBlocks() const {
+  return SceneRenderPassType == RenderPassType::Visibility
+             ? std::min(NumInstanceBlocks, maxNumVisibilityDraws)
+             : NumInstanceBlocks;
+}
+
+// Records follow the instance buffer, matching the instance indices
+// drawScene() draws with.
+void FileScene::getVisibilityDraws(std::vector<VisibilityDraw> &_draws,
+                                   VkBuffer &_sceneIndexBuffer) const {
+  forEachDraw(getNumDrawnBlocks(), [&](const DrawGroup &_group,
+                                       const SubMesh &_subMesh,
+                                       uint32_t _firstBlock,
+                                       uint32_t _numBlocks) {
+    const Mesh &mesh = Meshes[_group.Mesh];
+    for (uint32_t b = _firstBlock; b < _firstBlock + _numBlocks; ++b) {
+      VisibilityDraw draw = {};
+      draw.ModelMat = VisibilityInstances[b].ModelMat;
+      draw.InvModelMat = VisibilityInstances[b].InvModelMat;
+      draw.FirstIndex = mesh.Allocation.FirstIndex + _subMesh.FirstIndex;
+      draw.VertexOffset = mesh.Allocation.VertexOffset + _subMesh.VertexOffset;
+      draw.IndexSource = VisibilityIndexSource::GeometryPool;
+      draw.Material = (uint32_t)_group.Material;
+      _draws.push_back(draw);
+    }
+  });
+}
+
+void FileScene::drawScene(const Frame &_frame) {
+  if (NumInstanceBlocks == 0) {
+    return;
+  }
+  VkCommandBuffer cmd = _frame.CmdBuffer;
+  const StandardPipelineLayout &standardPipelineLayout =
+      *Common->StandardPipelineLayout;
+
+  bindInstanceBuffer(cmd, InstanceBuffer.Handle);
+  pushVisibilityDrawIdBase(cmd, 0);
+  int boundMaterial = -1;
+  forEachDraw(getNumDrawnBlocks(), [&](const DrawGroup &_group,
+                                       const SubMesh &_subMesh,
+                                       uint32_t _firstBlock,
+                                       uint32_t _numBlocks) {
+    if (_group.Material != boundMaterial) {
+      vkCmdBindDescriptorSets(
+          cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, standardPipelineLayout.Handle,
+          2, 1, &_frame.MaterialDescriptorSets[_group.Material], 0, nullptr);
+      boundMaterial = _group.Material;
+    }
+    const Mesh &mesh = Meshes[_group.Mesh];
+    vkCmdDrawIndexed(cmd, _subMesh.NumIndices, _numBlocks,
+                     mesh.Allocation.FirstIndex + _subMesh.FirstIndex,
+                     mesh.Allocation.VertexOffset + _subMesh.VertexOffset,
+                     _firstBlock);
+  });
+}
+
+void FileScene::drawShadowCasters(VkCommandBuffer _cmd,
+                                  ShadowCasterType _casterType) {
+  if (_casterType != ShadowCasterType::Static || NumInstanceBlocks == 0) {
+    return;
+  }
+  bindInstanceBuffer(_cmd, InstanceBuffer.Handle);
+  forEachDraw(NumInstanceBlocks, [&](const DrawGroup &_group,
+                                     const SubMesh &_subMesh,
+                                     uint32_t _firstBlock,
+                                     uint32_t _numBlocks) {
+    const Mesh &mesh = Meshes[_group.Mesh];
+    vkCmdDrawIndexed(_cmd, _subMesh.NumIndices, _numBlocks,
+                     mesh.Allocation.FirstIndex + _subMesh.FirstIndex,
+                     mesh.Allocation.VertexOffset + _subMesh.VertexOffset,
+                     _firstBlock);
+  });
+}
+
+bool FileScene::takeCameraPreset(FreeLookCamera &_camera) {
+  if (PendingCamera < 0) {
+    return false;
+  }
+  _camera = Cameras[PendingCamera];
+  PendingCamera = -1;
+  return true;
 }
 
-} // namespace bb
\ No newline at end of file
+} // namespace bb
@@ -1,5 +1,18 @@
 #pragma once
 #include "render.h"
+#include "descriptor_allocator.h"
+#include "job.h"
+#include "geometry_pool.h"
+#include "model.h"
+#include "occlusion.h"
+#include "bvh.h"
+#include "shadow.h"
+#include "lightmap.h"
+#include "shader_ball.h"
+#include "impostor.h"
+#include "async.h"
+#include "camera.h"
+#include "scene_file.h"
 #include "external/imgui/imgui.h"
 
 namespace bb {
@@ -29,7 +42,7 @@ enum class GBufferVisualizingOption {
   Normal,
   Albedo,
   MRHA,
-  MaterialIndex,
+  BakedLighting,
   RenderedScene,
   COUNT
 };
@@ -45,7 +58,7 @@ struct GBufferVisualize {
 
   EnumArray<GBufferVisualizingOption, const char *> OptionLabels = {
       "Position", "Normal",         "Albedo",
-      "MRHA",     "Material index", "Rendered Scene"};
+      "MRHA",     "Baked lighting", "Rendered Scene"};
   GBufferVisualizingOption CurrentOption =
       GBufferVisualizingOption::RenderedScene;
 };
@@ -61,7 +74,137 @@ struct LightSources {
   uint32_t NumLights;
 };
 
-enum class RenderPassType { Forward, Deferred, COUNT };
+enum class RenderPassType { Forward, Deferred, Visibility, COUNT };
+
+// Draws the impostors of scenes that have them at the end of the
+// GBufferWrite subpass, and bakes their atlases, see ImpostorAtlas.
+struct ImpostorPass {
+  VkPipeline Pipeline;
+  Shader VertShader;
+  Shader FragShader;
+  ImpostorBaker Baker;
+};
+
+// Lays down depth with position-only vertex input before the scene pass of
+// each render pass type, so the scene pass only shades visible fragments.
+struct DepthPrepass {
+  EnumArray<RenderPassType, VkPipeline> Pipelines;
+  Shader VertShader;
+
+  bool IsEnabled = false;
+};
+
+// Forward and G-buffer pipelines without vertex input: their vertex shaders
+// decode vertices from the geometry pool's storage buffers by vertex index,
+// and instances from the draw set by instance index, see
+// vertex_pulling.glsl. Since nothing about the vertex format is baked into
+// the pipelines, meshes of every format could share them and a single
+// buffer, with the decode picked per draw.
+struct VertexPulling {
+  VkPipeline ForwardPipeline;
+  VkPipeline GBufferPipeline;
+  Shader ForwardVertShader;
+  Shader GBufferVertShader;
+
+  bool IsEnabled = false;
+};
+
+// The Visibility render pass type rasterizes only depth and a 32-bit draw and
+// triangle id per pixel. The resolve then runs one fullscreen pass per
+// material in the Lighting subpass: pixels of other materials are discarded
+// right after reading their id, and the rest refetch their triangle from the
+// geometry pool, interpolate its attributes and shade.
+struct VisibilityBuffer {
+  VkPipeline WritePipeline;
+  VkPipeline ResolvePipeline;
+  Shader WriteVertShader;
+  Shader WriteFragShader;
+  Shader ResolveVertShader;
+  Shader ResolveFragShader;
+
+  // Materials referenced by this frame's draw records, one resolve pass each.
+  std::vector<uint32_t> Materials;
+};
+
+// Optional deferred lighting where the DiffuseLighting subpass accumulates
+// diffuse light at half resolution, which the Lighting subpass upsamples
+// with depth and normal aware weights while specular stays at full
+// resolution.
+struct HalfResLighting {
+  VkPipeline DiffusePipeline;
+  Shader DiffuseFragShader;
+
+  bool IsEnabled = false;
+  bool MeasureError = false;
+  LightingErrorStats Error;
+};
+
+// Times the lighting subpasses over a range of light counts, with full and
+// half resolution diffuse. Lights beyond the scene's own are generated.
+struct LightingBenchmark {
+  static constexpr int LightCounts[] = {1, 4, 16, 32, 64, MAX_NUM_LIGHTS - 1};
+  static constexpr int NumWarmupFrames = 8;
+  static constexpr int NumMeasuredFrames = 32;
+
+  bool IsRunning = false;
+  bool WasHalfResEnabled;
+  // Light count index times 2, plus 1 with half resolution diffuse
+  int Step;
+  int Frame;
+  double SumMs;
+  float ResultMs[std::size(LightCounts)][2] = {};
+};
+
+// Times the geometry subpasses with ShaderBallScene's crowd far ahead of the
+// view, all meshes or all impostors, against a baseline without the crowd.
+struct CrowdBenchmark {
+  static constexpr int InstanceCounts[] = {1024, 4096, 16384};
+  static constexpr int NumWarmupFrames = 8;
+  static constexpr int NumMeasuredFrames = 32;
+  static constexpr float Distance = 150.f;
+
+  bool IsRunning = false;
+  // 0 is the baseline, then instance count index times 2, plus 1 with
+  // impostors, plus 1
+  int Step;
+  int Frame;
+  double SumMs;
+  uint64_t SumNumDrawn;
+  // Crowd settings to restore afterwards.
+  bool WasEnabled;
+  bool UsedImpostors;
+  int SavedNumInstances;
+  float SavedImpostorDistance;
+
+  bool HasResults = false;
+  float BaselineMs;
+  // Instances drawn per millisecond of geometry time over the baseline,
+  // meshes then impostors.
+  float InstancesPerMs[std::size(InstanceCounts)][2] = {};
+};
+
+// Times the geometry subpasses of the deferred render pass with fixed
+// function vertex input, then with pulled vertices. The depth prepass, which
+// fetches the same way either way, is left out.
+struct VertexPullingBenchmark {
+  static constexpr int NumWarmupFrames = 8;
+  static constexpr int NumMeasuredFrames = 64;
+
+  bool IsRunning = false;
+  // 1 with pulled vertices
+  int Step;
+  int Frame;
+  double SumMs;
+  uint64_t SumNumVertices;
+  // Settings to restore afterwards.
+  bool WasEnabled;
+  bool WasPrepassEnabled;
+
+  bool HasResults = false;
+  // Fixed function then pulled.
+  float ResultMs[2] = {};
+  float NsPerVertex[2] = {};
+};
 
 // CommonSceneResources doesn't own actual resources, but only references of
 // them.
@@ -70,48 +213,185 @@ struct CommonSceneResources {
   VkCommandPool TransientCmdPool;
   StandardPipelineLayout *StandardPipelineLayout;
   PBRMaterialSet *MaterialSet;
+  JobSystem *JobSystem;
+  GeometryPool *GeometryPool;
+  AsyncContext *Async;
+  ImpostorBaker *ImpostorBaker;
+  // Where draw sets come from, see SceneBase::bindInstanceBuffer().
+  DescriptorAllocator *DescriptorAllocator;
+  DescriptorSetCache *DescriptorSetCache;
+  int NumFrames;
 };
 
 struct SceneBase {
   CommonSceneResources *Common;
   RenderPassType SceneRenderPassType = RenderPassType::Deferred;
   std::vector<Light> Lights;
+  // Bumped whenever casters of that type change, so that shadow tiles
+  // holding them are rendered again.
+  EnumArray<ShadowCasterType, uint64_t> ShadowCasterVersions;
+  // HasDrawTransform as last pushed into the command buffer being recorded.
+  mutable bool HasPushedDrawTransform = false;
 
   explicit SceneBase(CommonSceneResources *_common) : Common(_common) {}
   virtual ~SceneBase() = default;
   virtual void updateGUI(float _dt) = 0;
   virtual void updateScene(float _dt) = 0;
+  // Called once per frame with every view the scene is about to be drawn
+  // from, the main view first, after updateScene(). Whatever any of them
+  // sees must survive culling. _frameIndex is the frame in flight being
+  // recorded, which per-frame buffers are picked by.
+  virtual void cullScene(const ViewUniformBlock *_views, uint32_t _numViews,
+                         uint32_t _frameIndex) {}
+  // _ray is in world space, from a click that the GUI didn't take.
+  virtual void pickObject(const Ray &_ray) {}
+  // Called after cullScene(). Fills a record for every instance drawScene()
+  // is about to draw, see VisibilityDraw, and the index buffer that records
+  // with VisibilityIndexSource::Scene refer to. The base pushed before
+  // drawScene() is 0.
+  virtual void getVisibilityDraws(std::vector<VisibilityDraw> &_draws,
+                                  VkBuffer &_sceneIndexBuffer) const {}
   virtual void drawScene(const Frame &_frame) = 0;
+  // Called after drawScene() in the GBufferWrite subpass only, with the
+  // impostor pipeline bound.
+  virtual void drawImpostors(const Frame &_frame) {}
+  // Draws every caster of _casterType whatever the view, with the shadow
+  // pipeline and its view projection already set. Only positions and
+  // instances are read.
+  virtual void drawShadowCasters(VkCommandBuffer _cmd,
+                                 ShadowCasterType _casterType) {}
+  // Sampled where drawScene() marks draws as lightmapped, or null if the
+  // scene has no lightmap.
+  virtual VkImageView getLightmap() const { return VK_NULL_HANDLE; }
+  // Called once per frame with the GPU time of the geometry subpasses of the
+  // latest frame read back.
+  virtual void onGeometryPassTimed(double _gpuMs) {}
+  // Called once per frame after updateGUI(). Returns true with _camera set
+  // if the scene wants the view moved, as when a camera preset is picked.
+  virtual bool takeCameraPreset(FreeLookCamera &_camera) { return false; }
+
+  // Static meshes live in the shared geometry pool, which is bound once per
+  // frame before drawScene() is called.
+  GeometryAllocation uploadMesh(const std::vector<Vertex> &_vertices,
+                                const std::vector<uint32_t> &_indices,
+                                std::string_view _name) const {
+    GeometryAllocation mesh = allocateGeometry(
+        *Common->Renderer, Common->TransientCmdPool, *Common->GeometryPool,
+        _vertices, _indices, _name);
+    BB_ASSERT(mesh.NumIndices > 0);
+    return mesh;
+  }
 
-  template <typename Container>
-  Buffer createVertexBuffer(const Container &_vertices) const {
-    static_assert(std::is_same_v<ELEMENT_TYPE(_vertices), Vertex>,
-                  "Element type for _vertices is not Vertex!");
-    const Renderer &renderer = *Common->Renderer;
-    VkCommandPool transientCmdPool = Common->TransientCmdPool;
-    Buffer vertexBuffer = createDeviceLocalBufferFromMemory(
-        renderer, transientCmdPool, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-        sizeBytes32(_vertices), std::data(_vertices));
-    return vertexBuffer;
+  void freeMesh(GeometryAllocation &_mesh) const {
+    freeGeometry(*Common->GeometryPool, _mesh);
   }
 
-  template <typename Container>
-  Buffer createIndexBuffer(const Container &_indices) const {
-    static_assert(std::is_same_v<ELEMENT_TYPE(_indices), uint32_t>,
-                  "Element type for _indices is not uint32_t!");
-    const Renderer &renderer = *Common->Renderer;
-    VkCommandPool transientCmdPool = Common->TransientCmdPool;
-    Buffer indexBuffer = createDeviceLocalBufferFromMemory(
-        renderer, transientCmdPool, VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-        sizeBytes32(_indices), std::data(_indices));
-    return indexBuffer;
+  void pushVisibilityDrawIdBase(VkCommandBuffer _cmd, int32_t _base) const {
+    vkCmdPushConstants(_cmd, Common->StandardPipelineLayout->Handle,
+                       VK_SHADER_STAGE_VERTEX_BIT,
+                       offsetof(StandardPushConstants, VisibilityDrawIdBase),
+                       sizeof(_base), &_base);
+  }
+
+  // Marks the following draws as lightmapped through _uvTransform, see
+  // LightmapChart, or as not lightmapped if it's null.
+  void pushLightmapChart(VkCommandBuffer _cmd,
+                         const Float4 *_uvTransform) const {
+    VkPipelineLayout layout = Common->StandardPipelineLayout->Handle;
+    int32_t isLightmapped = _uvTransform != nullptr;
+    vkCmdPushConstants(_cmd, layout, VK_SHADER_STAGE_VERTEX_BIT,
+                       offsetof(StandardPushConstants, IsLightmapped),
+                       sizeof(isLightmapped), &isLightmapped);
+    if (_uvTransform) {
+      vkCmdPushConstants(_cmd, layout, VK_SHADER_STAGE_VERTEX_BIT,
+                         offsetof(StandardPushConstants, LightmapUVTransform),
+                         sizeof(StandardPushConstants::LightmapUVTransform),
+                         _uvTransform);
+    }
+  }
+
+  // Marks the following draws as single instances with _modelMat, or as
+  // reading the instance attributes if it's null. HasDrawTransform is only
+  // pushed when it changes.
+  void pushDrawTransform(VkCommandBuffer _cmd, const Mat4 *_modelMat) const {
+    VkPipelineLayout layout = Common->StandardPipelineLayout->Handle;
+    bool hasDrawTransform = _modelMat != nullptr;
+    if (hasDrawTransform != HasPushedDrawTransform) {
+      int32_t value = hasDrawTransform;
+      vkCmdPushConstants(_cmd, layout, VK_SHADER_STAGE_VERTEX_BIT,
+                         offsetof(StandardPushConstants, HasDrawTransform),
+                         sizeof(value), &value);
+      HasPushedDrawTransform = hasDrawTransform;
+    }
+    if (_modelMat) {
+      Float4 rows[3] = {_modelMat->row(0), _modelMat->row(1),
+                        _modelMat->row(2)};
+      vkCmdPushConstants(_cmd, layout, VK_SHADER_STAGE_VERTEX_BIT,
+                         offsetof(StandardPushConstants, DrawTransform),
+                         sizeof(rows), rows);
+    }
+  }
+
+  // Called once per command buffer the scene draws into, after the geometry
+  // pool is bound and the push constants are zeroed. Pipelines fetch
+  // binding 1 and declare the draw set even for draws with a pushed
+  // transform, which ignore what's there, so a placeholder is bound here for
+  // them, and instanced draws replace it with bindInstanceBuffer().
+  void beginSceneCommands(VkCommandBuffer _cmd) const {
+    HasPushedDrawTransform = false;
+    bindInstanceBuffer(_cmd, Common->GeometryPool->VertexBuffer.Handle);
+  }
+
+  // Binds _instanceBuffer, InstanceBlocks, at vertex binding 1 and in the
+  // draw set, so that pipelines that pull their vertices read the same
+  // instances, see VertexPulling. Draw sets are cached until the app exits,
+  // so _instanceBuffer must live as long as the scene. The following draws
+  // read the instance attributes.
+  void bindInstanceBuffer(VkCommandBuffer _cmd,
+                          VkBuffer _instanceBuffer) const {
+    pushDrawTransform(_cmd, nullptr);
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(_cmd, 1, 1, &_instanceBuffer, &offset);
+
+    const StandardPipelineLayout &layout = *Common->StandardPipelineLayout;
+    DrawDescriptors descriptors = {};
+    descriptors.Instances = {_instanceBuffer, 0, VK_WHOLE_SIZE};
+    VkDescriptorSet drawSet = getCachedDescriptorSet(
+        *Common->Renderer, *Common->DescriptorSetCache,
+        *Common->DescriptorAllocator,
+        layout.DescriptorSetLayouts[DescriptorFrequency::PerDraw],
+        descriptors);
+    vkCmdBindDescriptorSets(_cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            layout.Handle,
+                            (uint32_t)DescriptorFrequency::PerDraw, 1,
+                            &drawSet, 0, nullptr);
+  }
+
+  // Draws _numInstances of _mesh. Several instances read their matrices
+  // from _instanceBuffer, see bindInstanceBuffer(). A single one has its
+  // model matrix pushed from _instances instead, so that it needs no buffer
+  // nor binding, see beginSceneCommands().
+  void drawMesh(VkCommandBuffer _cmd, const GeometryAllocation &_mesh,
+                const InstanceBlock *_instances, uint32_t _numInstances,
+                VkBuffer _instanceBuffer = VK_NULL_HANDLE) const {
+    if (_numInstances > 1) {
+      BB_ASSERT(_instanceBuffer != VK_NULL_HANDLE);
+      bindInstanceBuffer(_cmd, _instanceBuffer);
+      vkCmdDrawIndexed(_cmd, _mesh.NumIndices, _numInstances,
+                       _mesh.FirstIndex, _mesh.VertexOffset, 0);
+      return;
+    }
+    pushDrawTransform(_cmd, &_instances[0].ModelMat);
+    vkCmdDrawIndexed(_cmd, _mesh.NumIndices, 1, _mesh.FirstIndex,
+                     _mesh.VertexOffset, 0);
   }
 
   Buffer createInstanceBuffer(uint32_t _numInstances) const {
     const Renderer &renderer = *Common->Renderer;
     Buffer instanceBuffer =
         createBuffer(renderer, sizeof(InstanceBlock) * _numInstances,
-                     VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                     VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
                      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
     return instanceBuffer;
@@ -133,9 +413,8 @@ struct SceneBase {
 };
 
 struct TriangleScene : SceneBase {
-  Buffer VertexBuffer;
-  uint32_t NumVertices;
-  Buffer InstanceBuffer;
+  GeometryAllocation Mesh;
+  InstanceBlock Instance;
 
   explicit TriangleScene(CommonSceneResources *_common) : SceneBase(_common) {
     Lights.resize(1);
@@ -146,27 +425,30 @@ struct TriangleScene : SceneBase {
     light->Intensity = 10.f;
 
     // clang-format off
-    Vertex vertices[] = {
+    std::vector<Vertex> vertices = {
         {{0, 1, 5}, {0.5, 1}},
         {{1, -1, 5}, {1, 0}},
         {{-1, -1, 5}, {0, 0}}};
     // clang-format on
-    VertexBuffer = createVertexBuffer(vertices);
-    NumVertices = std::size(vertices);
-    InstanceBuffer = createInstanceBuffer(1);
-    InstanceBlock instanceData[1] = {};
-    instanceData[0].ModelMat = Mat4::identity();
-    instanceData[0].InvModelMat = Mat4::identity();
-    updateInstanceBufferMemory(InstanceBuffer, instanceData);
+    Mesh = uploadMesh(vertices, {0, 1, 2}, "triangle");
+    Instance.ModelMat = Mat4::identity();
+    Instance.InvModelMat = Mat4::identity();
   }
 
-  ~TriangleScene() override {
-    const Renderer &renderer = *Common->Renderer;
-    destroyBuffer(renderer, InstanceBuffer);
-    destroyBuffer(renderer, VertexBuffer);
-  }
+  ~TriangleScene() override { freeMesh(Mesh); }
   void updateGUI(float _dt) override {}
   void updateScene(float _dt) override {}
+  void getVisibilityDraws(std::vector<VisibilityDraw> &_draws,
+                          VkBuffer &_sceneIndexBuffer) const override {
+    VisibilityDraw draw = {};
+    draw.ModelMat = Instance.ModelMat;
+    draw.InvModelMat = Instance.InvModelMat;
+    draw.FirstIndex = Mesh.FirstIndex;
+    draw.VertexOffset = Mesh.VertexOffset;
+    draw.IndexSource = VisibilityIndexSource::GeometryPool;
+    draw.Material = 0;
+    _draws.push_back(draw);
+  }
   void drawScene(const Frame &_frame) override {
     VkCommandBuffer cmd = _frame.CmdBuffer;
     const StandardPipelineLayout &standardPipelineLayout =
@@ -175,39 +457,154 @@ struct TriangleScene : SceneBase {
     vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
                             standardPipelineLayout.Handle, 2, 1,
                             &_frame.MaterialDescriptorSets[0], 0, nullptr);
-
-    VkDeviceSize offset = 0;
-    vkCmdBindVertexBuffers(cmd, 0, 1, &VertexBuffer.Handle, &offset);
-    vkCmdBindVertexBuffers(cmd, 1, 1, &InstanceBuffer.Handle, &offset);
-    vkCmdDraw(cmd, NumVertices, 1, 0, 0);
+    drawMesh(cmd, Mesh, &Instance, 1);
+  }
+  void drawShadowCasters(VkCommandBuffer _cmd,
+                         ShadowCasterType _casterType) override {
+    if (_casterType != ShadowCasterType::Static) {
+      return;
+    }
+    drawMesh(_cmd, Mesh, &Instance, 1);
   }
 };
 
+constexpr int maxNumCrowdInstances = 16384;
+
 struct ShaderBallScene : SceneBase {
   struct {
-    Buffer VertexBuffer;
-    Buffer IndexBuffer;
-    uint32_t NumIndices;
+    GeometryAllocation Mesh;
 
-    uint32_t NumInstances = 1;
-    std::vector<InstanceBlock> InstanceData;
-    Buffer InstanceBuffer;
+    InstanceBlock Instance;
   } Plane;
 
   struct {
-    Buffer VertexBuffer;
-    uint32_t NumVertices;
+    // Submesh ranges are relative to Mesh.
+    GeometryAllocation Mesh;
+    std::vector<SubMesh> SubMeshes;
+    // CPU copies for culling. Meshlets index into Indices.
+    std::vector<Meshlet> Meshlets;
+    std::vector<uint32_t> Indices;
+    std::vector<ModelPart> Parts;
+    // Index into the PBR material set for each model material, or -1 to use
+    // the material selected in the GUI.
+    std::vector<int> MaterialMapping;
 
     uint32_t NumInstances = 1;
+    // Grouped by part: NumInstances blocks for Parts[0], then for Parts[1]...
     std::vector<InstanceBlock> InstanceData;
     Buffer InstanceBuffer;
 
-    float Angle = -90;
+    float Angle = shaderBallRestAngle;
   } ShaderBall;
 
+  // Meshlets of every shader ball part and instance are tested against the
+  // view each frame, and the survivors' indices are packed into a per-frame
+  // index buffer that replaces the pool's for the shader ball draws.
+  struct {
+    bool IsEnabled = true;
+    bool EnableFrustumCulling = true;
+    bool EnableConeCulling = true;
+
+    std::vector<Buffer> IndexBuffers;
+    uint32_t CurrentIndexBuffer = 0;
+
+    // One draw per part and instance, in InstanceData order. Work items are
+    // the meshlets of every draw, grouped by draw.
+    struct Draw {
+      uint32_t FirstWorkItem;
+      uint32_t NumWorkItems;
+      uint32_t FirstIndex;
+      uint32_t NumIndices;
+    };
+    std::vector<Draw> Draws;
+    std::vector<uint32_t> WorkItemDraws;
+    std::vector<uint8_t> WorkItemResults;
+    std::vector<uint32_t> WorkItemFirstIndices;
+
+    uint32_t NumTriangles;
+    uint32_t NumFrustumCulledTriangles;
+    uint32_t NumBackFacingTriangles;
+    uint32_t NumOccludedTriangles;
+  } Culling;
+
+  // Whole draws are tested against simplified occluders before the meshlet
+  // pass. Only active while meshlet culling is.
+  struct {
+    bool IsEnabled = true;
+
+    // Indexed like ShaderBall.SubMeshes.
+    std::vector<OccluderMesh> SubMeshOccluders;
+    OccluderMesh PlaneOccluder;
+    OcclusionBuffer Buffer;
+    // Indexed like Culling.Draws.
+    std::vector<uint8_t> IsDrawOccluded;
+    uint32_t NumOccludedDraws;
+    float RasterizeTimeMs;
+
+    // Ground truth comes from rasterizing the full meshes with draw ids at a
+    // higher resolution, on request from the GUI.
+    std::vector<OccluderMesh> SubMeshFullMeshes;
+    bool ShouldMeasureAccuracy = false;
+    bool HasAccuracy = false;
+    uint32_t NumVisibleDraws;
+    uint32_t NumCulledDraws;
+    uint32_t NumFalselyCulledDraws;
+  } Occlusion;
+
+  // Triangle BVHs per submesh under an instance BVH over the world bounds of
+  // every shader ball draw, for picking and spatial queries. The instance BVH
+  // is refitted as draws move and rebuilt once refitting has degraded it.
+  struct {
+    // Indexed like ShaderBall.SubMeshes.
+    std::vector<MeshBVH> SubMeshBVHs;
+    // Items are indices into ShaderBall.InstanceData.
+    BVH InstanceBVH;
+    std::vector<AABB> InstanceBounds;
+    float BuiltCost = 0;
+    float Cost = 0;
+    uint32_t NumRebuilds = 0;
+
+    Frustum ViewFrustum;
+    std::vector<std::string> BenchmarkResults;
+  } Spatial;
+
+  // Lighting of the plane from bakeShaderBallLightmap(), with the shader
+  // balls as they were placed then. The plane is a single chart.
+  struct {
+    Image Texture;
+    Float4 UVTransform[2];
+    bool IsLoaded = false;
+    bool IsEnabled = true;
+  } BakedLighting;
+
+  // Whole shader balls on a grid behind the others, drawn as meshes up close
+  // and as impostors from ImpostorDistance on. Impostors only exist in the
+  // G-buffer, so the crowd is all meshes in the Forward render pass type and
+  // with extra views, and left out of the Visibility one and of shadows.
+  struct {
+    bool IsEnabled = false;
+    bool UseImpostors = true;
+    int NumInstances = 4096;
+    float ImpostorDistance = 30.f;
+    float Spacing = 2.5f;
+
+    // Baked from the shader ball at its rest pose, with the materials it had
+    // when the scene was loaded.
+    ImpostorAtlas Atlas;
+
+    // Per frame. Mesh instances are grouped by part, maxNumCrowdInstances
+    // blocks for each.
+    std::vector<Buffer> MeshInstanceBuffers;
+    std::vector<Buffer> ImpostorInstanceBuffers;
+    uint32_t CurrentBuffer = 0;
+    uint32_t NumMeshes;
+    uint32_t NumImpostors;
+
+    CrowdBenchmark Benchmark;
+  } Crowd;
+
   struct {
-    EnumArray<PBRMapType, ImTextureID> DefaultMaterialTextureId;
-    std::vector<EnumArray<PBRMapType, ImTextureID>> MaterialTextureIds;
+    ImTextureID ThumbnailAtlasTextureId;
     int SelectedMaterial = 1;
     int SelectedShaderBallInstance = -1;
   } GUI;
@@ -216,7 +613,103 @@ struct ShaderBallScene : SceneBase {
   ~ShaderBallScene() override;
   void updateGUI(float _dt) override;
   void updateScene(float _dt) override;
+  void cullScene(const ViewUniformBlock *_views, uint32_t _numViews,
+                 uint32_t _frameIndex) override;
+  void pickObject(const Ray &_ray) override;
+  void getVisibilityDraws(std::vector<VisibilityDraw> &_draws,
+                          VkBuffer &_sceneIndexBuffer) const override;
+  void drawScene(const Frame &_frame) override;
+  void drawImpostors(const Frame &_frame) override;
+  // The plane is static, shader balls are dynamic.
+  void drawShadowCasters(VkCommandBuffer _cmd,
+                         ShadowCasterType _casterType) override;
+  VkImageView getLightmap() const override;
+  void onGeometryPassTimed(double _gpuMs) override;
+
+  // Imports the shader ball while uploading the plane, then uploads the
+  // shader ball. Returns the model for the rest of the setup.
+  Task<Model> loadMeshes();
+  // Index into the PBR material set.
+  int getPartMaterial(size_t _part) const;
+  void cullOccludedDraws(const Mat4 &_viewProj);
+  void measureOcclusionAccuracy(const Mat4 &_viewProj);
+  void cullCrowd(const ViewUniformBlock *_views, uint32_t _numViews);
+  void setCrowdBenchmarkStep();
+
+  void updateInstanceBVH();
+  RayHit raycastShaderBalls(const Ray &_ray) const;
+  void benchmarkSpatialQueries();
+};
+
+// Opened when no other scene file is given, see FileScene.
+constexpr const char *defaultSceneFileName = "Scene.bbscene";
+// Instance buffer budget of FileScene. Instances past it are left out.
+constexpr uint32_t maxNumFileSceneInstanceBlocks = 1 << 20;
+
+// A scene read from a scene file, see scene_file.h. Instances are grouped by
+// mesh and material when loading, and expanded straight from the mapped file
+// into the instance buffer, a block per instance and part of its mesh. The
+// file is closed once loaded.
+struct FileScene : SceneBase {
+  struct Mesh {
+    GeometryAllocation Allocation;
+    std::vector<SubMesh> SubMeshes;
+    std::vector<ModelPart> Parts;
+  };
+  // Instances of one mesh with one material. InstanceBuffer holds
+  // NumInstances blocks for the mesh's Parts[0] from FirstBlock on, then for
+  // Parts[1]...
+  struct DrawGroup {
+    uint32_t Mesh;
+    // Index into the PBR material set.
+    int Material;
+    uint32_t FirstBlock;
+    uint32_t NumInstances;
+  };
+
+  std::string FilePath;
+  std::vector<Mesh> Meshes;
+  std::vector<DrawGroup> DrawGroups;
+  Buffer InstanceBuffer = {};
+  uint32_t NumInstanceBlocks = 0;
+  // CPU copies of the blocks the Visibility render pass type draws.
+  std::vector<InstanceBlock> VisibilityInstances;
+
+  std::vector<std::string> CameraNames;
+  std::vector<FreeLookCamera> Cameras;
+  int PendingCamera = -1;
+
+  struct {
+    bool IsLoaded = false;
+    uint32_t NumFileInstances;
+    uint32_t NumDrawnInstances;
+    uint32_t NumUnknownMaterials;
+    float OpenMs;
+    float GroupMs;
+    float ExpandMs;
+    float MeshLoadMs;
+  } Stats;
+
+  FileScene(CommonSceneResources *_common, const std::string &_filePath);
+  ~FileScene() override;
+  void updateGUI(float _dt) override;
+  void updateScene(float _dt) override {}
+  void getVisibilityDraws(std::vector<VisibilityDraw> &_draws,
+                          VkBuffer &_sceneIndexBuffer) const override;
   void drawScene(const Frame &_frame) override;
+  // Everything in a scene file stands still.
+  void drawShadowCasters(VkCommandBuffer _cmd,
+                         ShadowCasterType _casterType) override;
+  bool takeCameraPreset(FreeLookCamera &_camera) override;
+
+  void loadSceneFile(const SceneFile &_file);
+  // The Visibility render pass type draws as many blocks as there can be
+  // records.
+  uint32_t getNumDrawnBlocks() const;
+  // Calls _fn(group, subMesh, firstBlock, numBlocks) for every part of every
+  // group, in instance buffer order, up to _maxNumBlocks blocks.
+  template <typename Fn>
+  void forEachDraw(uint32_t _maxNumBlocks, const Fn &_fn) const;
 };
 
 } // namespace bb
\ No newline at end of file
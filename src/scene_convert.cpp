@@ -0,0 +1,284 @@
+#include "scene_convert.h"
+#include "util.h"
+#include "external/toml.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unordered_map>
+
+namespace bb {
+
+namespace {
+
+// Reads keys of one table of the description, remembering the first error.
+struct SceneTableReader {
+  const toml_table_t *Table;
+  const char *TableName;
+  int Index;
+  std::string Error;
+
+  void fail(const char *_key, const char *_expected) {
+    if (Error.empty()) {
+      Error = fmt::format("{} {}: \"{}\" must be {}", TableName, Index, _key,
+                          _expected);
+    }
+  }
+
+  std::string readString(const char *_key) {
+    char *str = nullptr;
+    if (toml_rtos(toml_raw_in(Table, _key), &str) != 0) {
+      fail(_key, "a string");
+      return {};
+    }
+    std::string result = str;
+    free(str);
+    return result;
+  }
+
+  static bool toFloat(toml_raw_t _raw, float &_value) {
+    double d;
+    int64_t i;
+    if (toml_rtod(_raw, &d) == 0) {
+      _value = (float)d;
+      return true;
+    }
+    if (toml_rtoi(_raw, &i) == 0) {
+      _value = (float)i;
+      return true;
+    }
+    return false;
+  }
+
+  float readFloat(const char *_key, float _default) {
+    toml_raw_t raw = toml_raw_in(Table, _key);
+    if (!raw) {
+      return _default;
+    }
+    float value = _default;
+    if (!toFloat(raw, value)) {
+      fail(_key, "a number");
+    }
+    return value;
+  }
+
+  bool readBool(const char *_key, bool _default) {
+    toml_raw_t raw = toml_raw_in(Table, _key);
+    int value = _default;
+    if (raw && toml_rtob(raw, &value) != 0) {
+      fail(_key, "true or false");
+    }
+    return value != 0;
+  }
+
+  // A single number is repeated if _allowsScalar.
+  Float3 readFloat3(const char *_key, const Float3 &_default,
+                    bool _allowsScalar = false) {
+    if (_allowsScalar && toml_raw_in(Table, _key)) {
+      float value = readFloat(_key, 1.f);
+      return {value, value, value};
+    }
+    toml_array_t *array = toml_array_in(Table, _key);
+    if (!array) {
+      return _default;
+    }
+    float values[3];
+    if (toml_array_nelem(array) != 3) {
+      fail(_key, "an array of 3 numbers");
+      return _default;
+    }
+    for (int i = 0; i < 3; ++i) {
+      if (!toFloat(toml_raw_at(array, i), values[i])) {
+        fail(_key, "an array of 3 numbers");
+        return _default;
+      }
+    }
+    return {values[0], values[1], values[2]};
+  }
+};
+
+} // namespace
+
+static Mat4 getSceneRotation(const Float3 &_degrees) {
+  return Mat4::rotateY(_degrees.Y) * Mat4::rotateX(_degrees.X) *
+         Mat4::rotateZ(_degrees.Z);
+}
+
+bool readSceneDescription(const std::string &_filePath,
+                          SceneDescription &_scene) {
+  _scene = {};
+  FILE *f = fopen(_filePath.c_str(), "r");
+  if (!f) {
+    printLine("Failed to open {}", _filePath);
+    return false;
+  }
+  char parseError[256] = {};
+  toml_table_t *root =
+      toml_parse_file(f, parseError, (int)std::size(parseError));
+  fclose(f);
+  if (!root) {
+    printLine("{}: {}", _filePath, parseError);
+    return false;
+  }
+  BB_DEFER(toml_free(root));
+
+  std::string error;
+  // Calls _fn with a reader of every table in the array of tables _name,
+  // until one fails.
+  auto forEachTable = [&](const char *_name, auto &&_fn) {
+    toml_array_t *tables = toml_array_in(root, _name);
+    int numTables = tables ? toml_array_nelem(tables) : 0;
+    for (int i = 0; i < numTables && error.empty(); ++i) {
+      SceneTableReader reader = {toml_table_at(tables, i), _name, i};
+      if (!reader.Table) {
+        error = fmt::format("{} must be an array of tables", _name);
+        break;
+      }
+      _fn(reader);
+      error = reader.Error;
+    }
+  };
+
+  std::unordered_map<std::string, uint32_t> meshIndices;
+  forEachTable("mesh", [&](SceneTableReader &_reader) {
+    SceneDescription::Mesh mesh;
+    mesh.Name = _reader.readString("name");
+    mesh.Path = _reader.readString("path");
+    if (!meshIndices.try_emplace(mesh.Name, (uint32_t)_scene.Meshes.size())
+             .second) {
+      _reader.fail("name", "unique");
+    }
+    _scene.Meshes.push_back(std::move(mesh));
+  });
+
+  std::unordered_map<std::string, uint32_t> materialIndices;
+  // Mesh and material indices of the instances of _reader's table.
+  auto readReferences = [&](SceneTableReader &_reader, uint32_t &_mesh,
+                            uint32_t &_material) {
+    auto it = meshIndices.find(_reader.readString("mesh"));
+    if (it == meshIndices.end()) {
+      _reader.fail("mesh", "the name of a [[mesh]]");
+      return false;
+    }
+    _mesh = it->second;
+    std::string material = _reader.readString("material");
+    auto [materialIt, isNew] = materialIndices.try_emplace(
+        material, (uint32_t)_scene.Materials.size());
+    if (isNew) {
+      _scene.Materials.push_back(material);
+    }
+    _material = materialIt->second;
+    return _reader.Error.empty();
+  };
+
+  forEachTable("instance", [&](SceneTableReader &_reader) {
+    uint32_t mesh, material;
+    if (!readReferences(_reader, mesh, material)) {
+      return;
+    }
+    Mat4 transform =
+        Mat4::translate(_reader.readFloat3("position", {})) *
+        getSceneRotation(_reader.readFloat3("rotation", {})) *
+        Mat4::scale(_reader.readFloat3("scale", {1, 1, 1}, true));
+    addSceneInstance(_scene, mesh, material, transform);
+  });
+
+  forEachTable("instance_grid", [&](SceneTableReader &_reader) {
+    uint32_t mesh, material;
+    if (!readReferences(_reader, mesh, material)) {
+      return;
+    }
+    Float3 origin = _reader.readFloat3("origin", {});
+    Float3 spacing = _reader.readFloat3("spacing", {1, 1, 1});
+    Float3 count = _reader.readFloat3("count", {1, 1, 1});
+    Mat4 localTransform =
+        getSceneRotation(_reader.readFloat3("rotation", {})) *
+        Mat4::scale(_reader.readFloat3("scale", {1, 1, 1}, true));
+    bool hasRandomYaw = _reader.readBool("random_yaw", false);
+    int numX = (int)count.X, numY = (int)count.Y, numZ = (int)count.Z;
+    if (numX < 1 || numY < 1 || numZ < 1 ||
+        (uint64_t)numX * numY * numZ > UINT32_MAX) {
+      _reader.fail("count", "3 positive numbers");
+      return;
+    }
+    for (int z = 0; z < numZ; ++z) {
+      for (int y = 0; y < numY; ++y) {
+        for (int x = 0; x < numX; ++x) {
+          Float3 pos = {origin.X + (float)x * spacing.X,
+                        origin.Y + (float)y * spacing.Y,
+                        origin.Z + (float)z * spacing.Z};
+          Mat4 transform = Mat4::translate(pos);
+          if (hasRandomYaw) {
+            uint32_t hash =
+                (uint32_t)(((uint64_t)z * numY + y) * numX + x) * 2654435761u;
+            transform = transform *
+                        Mat4::rotateY((float)(hash >> 16) / 65536.f * 360.f);
+          }
+          addSceneInstance(_scene, mesh, material,
+                           transform * localTransform);
+        }
+      }
+    }
+  });
+
+  forEachTable("light", [&](SceneTableReader &_reader) {
+    static const char *typeNames[] = {"point", "spot", "directional"};
+    std::string type = _reader.readString("type");
+    SceneFileLight light = {};
+    light.Type = -1;
+    for (int i = 0; i < (int)std::size(typeNames); ++i) {
+      if (type == typeNames[i]) {
+        light.Type = i;
+      }
+    }
+    if (light.Type < 0) {
+      _reader.fail("type", "\"point\", \"spot\" or \"directional\"");
+    }
+    light.Pos = _reader.readFloat3("position", {});
+    light.Dir = _reader.readFloat3("direction", {0, -1, 0});
+    light.Color = _reader.readFloat3("color", {1, 1, 1});
+    light.Intensity = _reader.readFloat("intensity", 1.f);
+    light.InnerCutOff =
+        cosf(degToRad(_reader.readFloat("inner_cutoff", 0.f)));
+    light.OuterCutOff =
+        cosf(degToRad(_reader.readFloat("outer_cutoff", 0.f)));
+    _scene.Lights.push_back(light);
+  });
+
+  forEachTable("camera", [&](SceneTableReader &_reader) {
+    SceneDescription::Camera camera;
+    camera.Name = _reader.readString("name");
+    camera.Pos = _reader.readFloat3("position", {});
+    camera.Yaw = _reader.readFloat("yaw", 0.f);
+    camera.Pitch = _reader.readFloat("pitch", 0.f);
+    _scene.Cameras.push_back(std::move(camera));
+  });
+
+  if (!error.empty()) {
+    printLine("{}: {}", _filePath, error);
+    return false;
+  }
+  return true;
+}
+
+bool convertSceneDescription(const std::string &_srcPath,
+                             const std::string &_dstPath) {
+  Time startTime = getCurrentTime();
+  SceneDescription scene;
+  if (!readSceneDescription(_srcPath, scene)) {
+    return false;
+  }
+  if (!writeSceneFile(scene, _dstPath)) {
+    printLine("Failed to write {}", _dstPath);
+    return false;
+  }
+  printLine("Converted {} meshes, {} materials, {} instances, {} lights and "
+            "{} cameras into {} in {:.0f} ms",
+            scene.Meshes.size(), scene.Materials.size(),
+            scene.InstanceMeshes.size(), scene.Lights.size(),
+            scene.Cameras.size(), _dstPath,
+            getElapsedTimeInMs(startTime, getCurrentTime()));
+  return true;
+}
+
+} // namespace bb
@@ -0,0 +1,54 @@
+#pragma once
+#include "scene_file.h"
+#include <string>
+
+namespace bb {
+
+// Converts a TOML scene description into a scene file, see scene_file.h.
+// Meshes and materials are referred to by name, rotations are in degrees
+// around X, Y and Z, applied in Z, X, Y order, and cameras take
+// FreeLookCamera's yaw and pitch in degrees. As in TOML 0.5, arrays don't mix
+// integers and floats:
+//
+//   [[mesh]]
+//   name = "ball"
+//   path = "ShaderBall.fbx"  # Relative to the common resource root
+//
+//   [[instance]]
+//   mesh = "ball"
+//   material = "rusted_iron"  # Declared by its first use
+//   position = [0, 0, 0]
+//   rotation = [0, 90, 0]     # Optional
+//   scale = 0.01              # Optional, a number or [x, y, z]
+//
+//   [[instance_grid]]         # count[0] x count[1] x count[2] instances
+//   mesh = "ball"
+//   material = "rusted_iron"
+//   origin = [0, 0, 0]
+//   spacing = [2, 2, 2]
+//   count = [1000, 1, 1000]
+//   rotation = [-90, 0, 0]    # Optional, as are scale and random_yaw
+//   random_yaw = true         # Turns each instance its own way around Y
+//
+//   [[light]]
+//   type = "spot"             # "point", "spot" or "directional"
+//   position = [0, 2, 0]
+//   direction = [0, -1, 0]
+//   color = [1, 1, 1]
+//   intensity = 50
+//   inner_cutoff = 20         # Degrees off the direction, spot lights only
+//   outer_cutoff = 30
+//
+//   [[camera]]
+//   name = "overview"
+//   position = [0, 10, -20]
+//   yaw = 0
+//   pitch = -20
+//
+// Prints what's wrong and returns false if the description can't be read.
+bool readSceneDescription(const std::string &_filePath,
+                          SceneDescription &_scene);
+bool convertSceneDescription(const std::string &_srcPath,
+                             const std::string &_dstPath);
+
+} // namespace bb
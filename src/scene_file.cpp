@@ -0,0 +1,321 @@
+#include "scene_file.h"
+#include "util.h"
+#include <stdio.h>
+#include <string.h>
+#include <unordered_map>
+#ifdef BB_WINDOWS
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace bb {
+
+constexpr uint64_t sceneFileAlignment = 16;
+
+static uint64_t getSceneFileSectionSize(const SceneFileHeader &_header,
+                                        SceneFileSection _section) {
+  switch (_section) {
+  case SceneFileSection::Strings:
+    return _header.NumStringBytes;
+  case SceneFileSection::Meshes:
+    return (uint64_t)_header.NumMeshes * sizeof(SceneFileMesh);
+  case SceneFileSection::Materials:
+    return (uint64_t)_header.NumMaterials * sizeof(SceneFileMaterial);
+  case SceneFileSection::InstanceMeshes:
+  case SceneFileSection::InstanceMaterials:
+    return (uint64_t)_header.NumInstances * sizeof(uint32_t);
+  case SceneFileSection::InstanceRow0:
+  case SceneFileSection::InstanceRow1:
+  case SceneFileSection::InstanceRow2:
+    return (uint64_t)_header.NumInstances * sizeof(Float4);
+  case SceneFileSection::Lights:
+    return (uint64_t)_header.NumLights * sizeof(SceneFileLight);
+  case SceneFileSection::Cameras:
+    return (uint64_t)_header.NumCameras * sizeof(SceneFileCamera);
+  default:
+    BB_ASSERT(false);
+    return 0;
+  }
+}
+
+bool mapFile(const std::string &_filePath, MappedFile &_file) {
+  _file = {};
+#ifdef BB_WINDOWS
+  HANDLE file = CreateFileA(_filePath.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                            nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  LARGE_INTEGER size;
+  // Empty files can't be mapped.
+  if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+    CloseHandle(file);
+    return false;
+  }
+  HANDLE mapping =
+      CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!mapping) {
+    CloseHandle(file);
+    return false;
+  }
+  void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (!data) {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+  }
+  _file.Data = (const uint8_t *)data;
+  _file.Size = (uint64_t)size.QuadPart;
+  _file.FileHandle = file;
+  _file.MappingHandle = mapping;
+#else
+  int fd = open(_filePath.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat status;
+  if (fstat(fd, &status) != 0 || status.st_size == 0) {
+    close(fd);
+    return false;
+  }
+  void *data = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE,
+                    fd, 0);
+  // The mapping keeps the file open.
+  close(fd);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+  _file.Data = (const uint8_t *)data;
+  _file.Size = (uint64_t)status.st_size;
+#endif
+  return true;
+}
+
+void unmapFile(MappedFile &_file) {
+  if (!_file.Data) {
+    return;
+  }
+#ifdef BB_WINDOWS
+  UnmapViewOfFile(_file.Data);
+  CloseHandle((HANDLE)_file.MappingHandle);
+  CloseHandle((HANDLE)_file.FileHandle);
+#else
+  munmap((void *)_file.Data, (size_t)_file.Size);
+#endif
+  _file = {};
+}
+
+bool openSceneFile(const std::string &_filePath, SceneFile &_scene) {
+  _scene = {};
+  if (!mapFile(_filePath, _scene.File)) {
+    BB_LOG_ERROR("Failed to map {}", _filePath);
+    return false;
+  }
+  const MappedFile &file = _scene.File;
+
+  auto fail = [&]([[maybe_unused]] const char *_reason) {
+    BB_LOG_ERROR("{} isn't a valid scene file: {}", _filePath, _reason);
+    closeSceneFile(_scene);
+    return false;
+  };
+
+  if (file.Size < sizeof(SceneFileHeader)) {
+    return fail("too small");
+  }
+  const SceneFileHeader &header = *(const SceneFileHeader *)file.Data;
+  if (header.Magic != sceneFileMagic || header.Version != sceneFileVersion) {
+    return fail("wrong magic or version");
+  }
+
+  for (SceneFileSection section : AllEnums<SceneFileSection>) {
+    uint64_t offset = header.Offsets[section];
+    if (offset % sceneFileAlignment != 0 || offset > file.Size ||
+        getSceneFileSectionSize(header, section) > file.Size - offset) {
+      return fail("section out of bounds");
+    }
+  }
+  auto getSection = [&](SceneFileSection _section) {
+    return file.Data + header.Offsets[_section];
+  };
+
+  _scene.Header = &header;
+  _scene.Strings = (const char *)getSection(SceneFileSection::Strings);
+  _scene.Meshes = (const SceneFileMesh *)getSection(SceneFileSection::Meshes);
+  _scene.Materials =
+      (const SceneFileMaterial *)getSection(SceneFileSection::Materials);
+  _scene.InstanceMeshes =
+      (const uint32_t *)getSection(SceneFileSection::InstanceMeshes);
+  _scene.InstanceMaterials =
+      (const uint32_t *)getSection(SceneFileSection::InstanceMaterials);
+  _scene.InstanceRows[0] =
+      (const Float4 *)getSection(SceneFileSection::InstanceRow0);
+  _scene.InstanceRows[1] =
+      (const Float4 *)getSection(SceneFileSection::InstanceRow1);
+  _scene.InstanceRows[2] =
+      (const Float4 *)getSection(SceneFileSection::InstanceRow2);
+  _scene.Lights = (const SceneFileLight *)getSection(SceneFileSection::Lights);
+  _scene.Cameras =
+      (const SceneFileCamera *)getSection(SceneFileSection::Cameras);
+
+  // Names are checked once here so that getSceneFileString() needn't be.
+  if (header.NumStringBytes == 0 ||
+      _scene.Strings[header.NumStringBytes - 1] != '\0') {
+    return fail("unterminated string table");
+  }
+  auto isString = [&](uint32_t _offset) {
+    return _offset < header.NumStringBytes;
+  };
+  for (uint32_t i = 0; i < header.NumMeshes; ++i) {
+    if (!isString(_scene.Meshes[i].Name) || !isString(_scene.Meshes[i].Path)) {
+      return fail("mesh name out of bounds");
+    }
+  }
+  for (uint32_t i = 0; i < header.NumMaterials; ++i) {
+    if (!isString(_scene.Materials[i].Name)) {
+      return fail("material name out of bounds");
+    }
+  }
+  for (uint32_t i = 0; i < header.NumCameras; ++i) {
+    if (!isString(_scene.Cameras[i].Name)) {
+      return fail("camera name out of bounds");
+    }
+  }
+  return true;
+}
+
+void closeSceneFile(SceneFile &_scene) {
+  unmapFile(_scene.File);
+  _scene = {};
+}
+
+const char *getSceneFileString(const SceneFile &_scene, uint32_t _offset) {
+  BB_ASSERT(_offset < _scene.Header->NumStringBytes);
+  return _scene.Strings + _offset;
+}
+
+Mat4 getSceneFileInstanceTransform(const SceneFile &_scene,
+                                   uint32_t _instance) {
+  BB_ASSERT(_instance < _scene.Header->NumInstances);
+  Mat4 transform = Mat4::identity();
+  for (int r = 0; r < 3; ++r) {
+    const Float4 &row = _scene.InstanceRows[r][_instance];
+    transform.M[0][r] = row.X;
+    transform.M[1][r] = row.Y;
+    transform.M[2][r] = row.Z;
+    transform.M[3][r] = row.W;
+  }
+  return transform;
+}
+
+void expandSceneFileInstances(const SceneFile &_scene,
+                              const uint32_t *_instances,
+                              uint32_t _numInstances,
+                              const Mat4 &_partTransform,
+                              InstanceBlock *_dst) {
+  for (uint32_t i = 0; i < _numInstances; ++i) {
+    InstanceBlock &instance = _dst[i];
+    instance.ModelMat =
+        getSceneFileInstanceTransform(_scene, _instances[i]) *
+        _partTransform;
+    instance.InvModelMat = instance.ModelMat.inverseAffine();
+  }
+}
+
+void addSceneInstance(SceneDescription &_scene, uint32_t _mesh,
+                      uint32_t _material, const Mat4 &_transform) {
+  _scene.InstanceMeshes.push_back(_mesh);
+  _scene.InstanceMaterials.push_back(_material);
+  for (int r = 0; r < 3; ++r) {
+    _scene.InstanceRows[r].push_back(_transform.row(r));
+  }
+}
+
+bool writeSceneFile(const SceneDescription &_scene,
+                    const std::string &_filePath) {
+  uint32_t numInstances = (uint32_t)_scene.InstanceMeshes.size();
+  BB_ASSERT(_scene.InstanceMaterials.size() == numInstances);
+  for ([[maybe_unused]] const std::vector<Float4> &rows :
+       _scene.InstanceRows) {
+    BB_ASSERT(rows.size() == numInstances);
+  }
+
+  // Offset 0 is the empty string, and equal names share an entry.
+  std::string strings(1, '\0');
+  std::unordered_map<std::string, uint32_t> stringOffsets = {{"", 0}};
+  auto addString = [&](const std::string &_str) {
+    auto [it, isNew] =
+        stringOffsets.try_emplace(_str, (uint32_t)strings.size());
+    if (isNew) {
+      strings.append(_str.c_str(), _str.size() + 1);
+    }
+    return it->second;
+  };
+
+  std::vector<SceneFileMesh> meshes;
+  for (const SceneDescription::Mesh &mesh : _scene.Meshes) {
+    meshes.push_back({addString(mesh.Name), addString(mesh.Path)});
+  }
+  std::vector<SceneFileMaterial> materials;
+  for (const std::string &material : _scene.Materials) {
+    materials.push_back({addString(material)});
+  }
+  std::vector<SceneFileCamera> cameras;
+  for (const SceneDescription::Camera &camera : _scene.Cameras) {
+    cameras.push_back(
+        {addString(camera.Name), camera.Pos, camera.Yaw, camera.Pitch});
+  }
+
+  SceneFileHeader header = {};
+  header.Magic = sceneFileMagic;
+  header.Version = sceneFileVersion;
+  header.NumStringBytes = (uint32_t)strings.size();
+  header.NumMeshes = (uint32_t)meshes.size();
+  header.NumMaterials = (uint32_t)materials.size();
+  header.NumInstances = numInstances;
+  header.NumLights = (uint32_t)_scene.Lights.size();
+  header.NumCameras = (uint32_t)cameras.size();
+
+  EnumArray<SceneFileSection, const void *> sectionData = {{
+      strings.data(),
+      meshes.data(),
+      materials.data(),
+      _scene.InstanceMeshes.data(),
+      _scene.InstanceMaterials.data(),
+      _scene.InstanceRows[0].data(),
+      _scene.InstanceRows[1].data(),
+      _scene.InstanceRows[2].data(),
+      _scene.Lights.data(),
+      cameras.data(),
+  }};
+  auto alignOffset = [](uint64_t _offset) {
+    return (_offset + sceneFileAlignment - 1) & ~(sceneFileAlignment - 1);
+  };
+  uint64_t offset = alignOffset(sizeof(SceneFileHeader));
+  for (SceneFileSection section : AllEnums<SceneFileSection>) {
+    header.Offsets[section] = offset;
+    offset = alignOffset(offset + getSceneFileSectionSize(header, section));
+  }
+
+  FILE *f = fopen(_filePath.c_str(), "wb");
+  if (!f) {
+    return false;
+  }
+  static const uint8_t padding[sceneFileAlignment] = {};
+  uint64_t written = fwrite(&header, 1, sizeof(header), f);
+  for (SceneFileSection section : AllEnums<SceneFileSection>) {
+    fwrite(padding, 1, header.Offsets[section] - written, f);
+    uint64_t size = getSceneFileSectionSize(header, section);
+    fwrite(sectionData[section], 1, size, f);
+    written = header.Offsets[section] + size;
+  }
+  bool isWritten = ferror(f) == 0;
+  fclose(f);
+  return isWritten;
+}
+
+} // namespace bb
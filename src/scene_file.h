@@ -0,0 +1,155 @@
+#pragma once
+#include "enum_array.h"
+#include "vector_math.h"
+#include "vertex.h"
+#include <string>
+#include <vector>
+
+namespace bb {
+
+// Binary scene files: which meshes and materials a scene uses, where their
+// instances stand, its lights and camera presets. The file is mapped and used
+// in place. Every array starts 16-byte aligned at an offset given in the
+// header, and instances are stored one array per field, so that loading
+// doesn't visit instances one by one however many there are. Names are
+// byte offsets into a table of NUL-terminated strings.
+//
+// Files are written by writeSceneFile(), usually from a text description,
+// see convertSceneDescription().
+
+inline static const char sceneFileExtension[] = ".bbscene";
+constexpr uint32_t sceneFileMagic = 0x43534242; // "BBSC"
+constexpr uint32_t sceneFileVersion = 1;
+
+enum class SceneFileSection {
+  Strings,
+  Meshes,
+  Materials,
+  InstanceMeshes,
+  InstanceMaterials,
+  // The top three rows of each instance's model matrix, whose bottom row is
+  // 0 0 0 1.
+  InstanceRow0,
+  InstanceRow1,
+  InstanceRow2,
+  Lights,
+  Cameras,
+  COUNT
+};
+
+struct SceneFileHeader {
+  uint32_t Magic;
+  uint32_t Version;
+  uint32_t NumStringBytes;
+  uint32_t NumMeshes;
+  uint32_t NumMaterials;
+  uint32_t NumInstances;
+  uint32_t NumLights;
+  uint32_t NumCameras;
+  // From the start of the file.
+  EnumArray<SceneFileSection, uint64_t> Offsets;
+};
+
+struct SceneFileMesh {
+  uint32_t Name;
+  // Relative to the common resource root.
+  uint32_t Path;
+};
+
+// Matched with the PBR material set by name.
+struct SceneFileMaterial {
+  uint32_t Name;
+};
+
+// As Light in light.h. Cutoffs are cosines, as the shaders compare them.
+struct SceneFileLight {
+  Float3 Pos;
+  int32_t Type;
+  Float3 Dir;
+  float Intensity;
+  Float3 Color;
+  float InnerCutOff;
+  float OuterCutOff;
+};
+
+// As FreeLookCamera.
+struct SceneFileCamera {
+  uint32_t Name;
+  Float3 Pos;
+  float Yaw;
+  float Pitch;
+};
+
+// A read-only view of a whole file, which stays valid until unmapFile().
+struct MappedFile {
+  const uint8_t *Data;
+  uint64_t Size;
+  void *FileHandle;
+  void *MappingHandle;
+};
+
+bool mapFile(const std::string &_filePath, MappedFile &_file);
+void unmapFile(MappedFile &_file);
+
+// Arrays point into File. Section bounds and names are checked when the file
+// is opened, but mesh and material indices of instances aren't, as that
+// would read every instance.
+struct SceneFile {
+  MappedFile File;
+  const SceneFileHeader *Header;
+  const char *Strings;
+  const SceneFileMesh *Meshes;
+  const SceneFileMaterial *Materials;
+  const uint32_t *InstanceMeshes;
+  const uint32_t *InstanceMaterials;
+  const Float4 *InstanceRows[3];
+  const SceneFileLight *Lights;
+  const SceneFileCamera *Cameras;
+};
+
+// Returns false if the file can't be mapped or isn't a scene file of this
+// version.
+bool openSceneFile(const std::string &_filePath, SceneFile &_scene);
+void closeSceneFile(SceneFile &_scene);
+
+const char *getSceneFileString(const SceneFile &_scene, uint32_t _offset);
+Mat4 getSceneFileInstanceTransform(const SceneFile &_scene,
+                                   uint32_t _instance);
+
+// Fills _dst with _partTransform applied to the _numInstances instances listed
+// in _instances, with their inverses, as instance buffers hold them.
+void expandSceneFileInstances(const SceneFile &_scene,
+                              const uint32_t *_instances,
+                              uint32_t _numInstances,
+                              const Mat4 &_partTransform,
+                              InstanceBlock *_dst);
+
+// What writeSceneFile() writes, with names as strings and an array per
+// instance field like the file.
+struct SceneDescription {
+  struct Mesh {
+    std::string Name;
+    std::string Path;
+  };
+  struct Camera {
+    std::string Name;
+    Float3 Pos;
+    float Yaw;
+    float Pitch;
+  };
+
+  std::vector<Mesh> Meshes;
+  std::vector<std::string> Materials;
+  std::vector<uint32_t> InstanceMeshes;
+  std::vector<uint32_t> InstanceMaterials;
+  std::vector<Float4> InstanceRows[3];
+  std::vector<SceneFileLight> Lights;
+  std::vector<Camera> Cameras;
+};
+
+void addSceneInstance(SceneDescription &_scene, uint32_t _mesh,
+                      uint32_t _material, const Mat4 &_transform);
+bool writeSceneFile(const SceneDescription &_scene,
+                    const std::string &_filePath);
+
+} // namespace bb
@@ -0,0 +1,129 @@
+#include "shader_ball.h"
+#include "mesh_gen.h"
+#include "resource_root.h"
+#include "util.h"
+
+namespace bb {
+
+void setupShaderBallLights(std::vector<Light> &_lights) {
+  _lights.resize(3);
+  Light *light = &_lights[0];
+  light->Dir = {-1, -1, 0};
+  light->Type = LightType::Directional;
+  light->Color = {0.2347f, 0.2131f, 0.2079f};
+  light->Intensity = 10.f;
+  ++light;
+  light->Pos = {0, 2, 0};
+  light->Type = LightType::Point;
+  light->Color = {1, 0.8f, 0.8f};
+  light->Intensity = 50;
+  ++light;
+  light->Pos = {4, 2, 0};
+  light->Dir = {0, -1, 0};
+  light->Type = LightType::Point;
+  light->Color = {0.8f, 1, 0.8f};
+  light->Intensity = 50;
+  light->InnerCutOff = degToRad(30);
+  light->OuterCutOff = degToRad(25);
+}
+
+Mat4 getPlaneTransform() {
+  return Mat4::translate({0, -10, 0}) * Mat4::scale({100.f, 100.f, 100.f});
+}
+
+Mat4 getShaderBallBaseTransform() {
+  return Mat4::rotateX(-90) * Mat4::scale({0.01f, 0.01f, 0.01f});
+}
+
+Mat4 getShaderBallTransform(int _instance, float _angle) {
+  return Mat4::translate({(float)(_instance * 2), -1, 2}) *
+         Mat4::rotateY(_angle) * getShaderBallBaseTransform();
+}
+
+void makePartsRelativeToFirst(std::vector<ModelPart> &_parts) {
+  Mat4 invFirstPartTransform = _parts[0].Transform.inverse();
+  for (ModelPart &part : _parts) {
+    part.Transform = invFirstPartTransform * part.Transform;
+  }
+}
+
+bool bakeShaderBallLightmap(JobSystem &_jobSystem,
+                            const LightmapBakeParams &_params,
+                            const std::string &_filePath) {
+  std::vector<Light> lights;
+  setupShaderBallLights(lights);
+
+  std::vector<LightmapMesh> meshes;
+  {
+    std::vector<Vertex> planeVertices;
+    std::vector<uint32_t> planeIndices;
+    generatePlaneMesh(planeVertices, planeIndices);
+    LightmapMesh &plane = meshes.emplace_back();
+    for (const Vertex &vertex : planeVertices) {
+      plane.Positions.push_back(vertex.Pos);
+      plane.Normals.push_back(vertex.Normal);
+    }
+    plane.Indices = std::move(planeIndices);
+    plane.Transform = getPlaneTransform();
+    plane.IsReceiver = true;
+  }
+
+  Model model =
+      importModel(_jobSystem, createCommonResourcePath("ShaderBall.fbx"));
+  if (model.Parts.empty()) {
+    printLine("Failed to import the shader ball");
+    return false;
+  }
+  makePartsRelativeToFirst(model.Parts);
+  Mat4 shaderBallMat = getShaderBallTransform(0, shaderBallRestAngle);
+  for (const ModelPart &part : model.Parts) {
+    const SubMesh &subMesh = model.SubMeshes[part.SubMeshIndex];
+    const Vertex *vertices = model.Vertices.data() + subMesh.VertexOffset;
+    LightmapMesh &mesh = meshes.emplace_back();
+    for (uint32_t i = 0; i < subMesh.NumVertices; ++i) {
+      mesh.Positions.push_back(vertices[i].Pos);
+      mesh.Normals.push_back(vertices[i].Normal);
+    }
+    mesh.Indices.assign(
+        model.Indices.begin() + subMesh.FirstIndex,
+        model.Indices.begin() + subMesh.FirstIndex + subMesh.NumIndices);
+    mesh.Transform = shaderBallMat * part.Transform;
+  }
+
+  printLine("Baking {}x{} lightmap, {} samples per texel, {} bounces",
+            _params.Size, _params.Size, _params.NumSamples,
+            _params.MaxBounces);
+  int lastReportedPercent = 0;
+  Lightmap lightmap = bakeLightmap(
+      _jobSystem, meshes, lights.data(), (uint32_t)lights.size(), _params,
+      [&](float _fractionDone, uint64_t _numRays, float _seconds) {
+        int percent = (int)(_fractionDone * 100.f);
+        if (percent < lastReportedPercent + 10) {
+          return;
+        }
+        lastReportedPercent = percent;
+        printLine("{:3}% {:.1f}s {:.2f} Mrays/s", percent, _seconds,
+                  _seconds > 0.f ? (float)_numRays / _seconds * 1e-6f : 0.f);
+      });
+  if (lightmap.Texels.empty()) {
+    printLine("Failed to fit the charts into the lightmap");
+    return false;
+  }
+
+  const LightmapBakeStats &stats = lightmap.Stats;
+  printLine("{} charts, {} texels at {:.2f} texels per unit", stats.NumCharts,
+            stats.NumTexels, stats.TexelsPerUnit);
+  printLine("{} rays in {:.1f}s, {:.2f} Mrays/s", stats.NumRays, stats.Seconds,
+            stats.Seconds > 0.f
+                ? (float)stats.NumRays / stats.Seconds * 1e-6f
+                : 0.f);
+
+  if (!writeLightmap(lightmap, _filePath)) {
+    printLine("Failed to write {}", _filePath);
+    return false;
+  }
+  printLine("Wrote {}", _filePath);
+  return true;
+}
+
+} // namespace bb
@@ -0,0 +1,35 @@
+#pragma once
+#include "light.h"
+#include "lightmap.h"
+#include "job.h"
+#include "model.h"
+#include "vector_math.h"
+#include <string>
+#include <vector>
+
+namespace bb {
+
+// The layout of ShaderBallScene, free of Vulkan so that its lightmap can be
+// baked without a renderer.
+
+// Angle the shader balls start at, and are baked into lightmaps at.
+constexpr float shaderBallRestAngle = -90.f;
+constexpr const char *shaderBallLightmapFileName = "ShaderBallLightmap.hdr";
+
+void setupShaderBallLights(std::vector<Light> &_lights);
+Mat4 getPlaneTransform();
+// Stands the imported shader ball up at its real size.
+Mat4 getShaderBallBaseTransform();
+Mat4 getShaderBallTransform(int _instance, float _angle);
+// The placement in getShaderBallTransform() was tuned against the first part,
+// so every part is kept relative to it.
+void makePartsRelativeToFirst(std::vector<ModelPart> &_parts);
+
+// Bakes the lights of ShaderBallScene into a lightmap of its plane and
+// writes it to _filePath, reporting progress on the way. Needs neither a
+// window nor a GPU.
+bool bakeShaderBallLightmap(JobSystem &_jobSystem,
+                            const LightmapBakeParams &_params,
+                            const std::string &_filePath);
+
+} // namespace bb
@@ -3,71 +3,122 @@
 #include "debug_common.glsl"
 #include "brdf.glsl"
 #include "standard_sets.glsl"
+#include "lighting.glsl"
 
 
 layout (location = 0) in vec2 vUV;
 
 layout (location = 0) out vec4 outColor;
+
+// Bilinear weights of the four nearest half resolution texels, scaled down
+// where the pixel each texel was lit at lies at another depth or faces
+// another way than this pixel.
+vec3 upsampleDiffuse(vec3 posWorld, vec3 N) {
+    ivec2 halfSize = (textureSize(sampler2D(uGbuffer[TEX_G_POSITION], uSamplers[SMP_NEAREST]), 0) + 1) / 2;
+    // Texel k was lit at pixel 2k.
+    vec2 halfPos = (gl_FragCoord.xy - 0.5) * 0.5;
+    ivec2 base = ivec2(floor(halfPos));
+    vec2 f = halfPos - vec2(base);
+    float depth = distance(posWorld, uViewPos);
+
+    vec3 sum = vec3(0);
+    float weightSum = 0;
+    for (int i = 0; i < 4; ++i) {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        ivec2 coord = clamp(base + offset, ivec2(0), halfSize - 1);
+        vec2 bilinear = mix(1 - f, f, vec2(offset));
+
+        vec3 samplePos = texelFetch(sampler2D(uGbuffer[TEX_G_POSITION], uSamplers[SMP_NEAREST]), coord * 2, 0).rgb;
+        vec3 sampleNormal = texelFetch(sampler2D(uGbuffer[TEX_G_NORMAL], uSamplers[SMP_NEAREST]), coord * 2, 0).rgb;
+        if (dot(sampleNormal, sampleNormal) == 0) {
+            continue;
+        }
+        float depthDiff = abs(distance(samplePos, uViewPos) - depth) / depth;
+        float weight = bilinear.x * bilinear.y
+                     * exp(-depthDiff * 50)
+                     * pow(max(dot(normalize(sampleNormal), N), 0), 16);
+
+        sum += texelFetch(sampler2D(uHalfResDiffuse, uSamplers[SMP_NEAREST]), coord, 0).rgb * weight;
+        weightSum += weight;
+    }
+
+    // Nothing alike nearby, e.g. a thin feature only lit at full resolution.
+    if (weightSum < 0.0001) {
+        ivec2 nearest = clamp(ivec2(round(halfPos)), ivec2(0), halfSize - 1);
+        return texelFetch(sampler2D(uHalfResDiffuse, uSamplers[SMP_NEAREST]), nearest, 0).rgb;
+    }
+    return sum / weightSum;
+}
+
+// Errors are counted in 8-bit steps after a Reinhard curve, roughly as they
+// would show on screen.
+void recordLightingError(vec3 color, vec3 referenceColor) {
+    vec3 diff = abs(color / (1 + color) - referenceColor / (1 + referenceColor));
+    uint error = uint(round(max(diff.r, max(diff.g, diff.b)) * 255));
+    atomicAdd(uLightingErrorSumSquared[uint(gl_FragCoord.y) % NUM_LIGHTING_ERROR_BUCKETS], error * error);
+    atomicMax(uLightingErrorMax, error);
+    atomicAdd(uLightingErrorNumPixels, 1);
+    if (error > 2) {
+        atomicAdd(uLightingErrorNumVisible, 1);
+    }
+}
+
 void main() {
     vec3 posWorld = texture(sampler2D(uGbuffer[TEX_G_POSITION], uSamplers[SMP_NEAREST]), vUV).rgb;
     vec3 normal = texture(sampler2D(uGbuffer[TEX_G_NORMAL], uSamplers[SMP_NEAREST]), vUV).rgb;
     vec3 albedo = texture(sampler2D(uGbuffer[TEX_G_ALBEDO], uSamplers[SMP_NEAREST]), vUV).rgb;
     vec4 MRAH = texture(sampler2D(uGbuffer[TEX_G_MRAH], uSamplers[SMP_NEAREST]), vUV);
-    vec3 materialIndex = texture(sampler2D(uGbuffer[TEX_G_MATINDEX], uSamplers[SMP_NEAREST]), vUV).rgb;
+    vec4 baked = texture(sampler2D(uGbuffer[TEX_G_BAKED], uSamplers[SMP_NEAREST]), vUV);
 
     float metallic = MRAH.r;
     float roughness = MRAH.g;
     float ao = MRAH.b;
     float height = MRAH.a;
 
+    vec3 N = normalize(normal);
+    vec3 V = normalize(uViewPos - posWorld);
 
-    vec3 Lo = vec3(0);
-
-    for (int i = 0; i < uNumLights; ++i) {
-        Light light = uLights[i];
-        vec3 L;
-        float att;
-        if (light.type == 0) {
-            L = light.pos - posWorld;
-            float d = length(L);
-            att = 1 / (d * d);
-            L = normalize(L);
-        } else if (light.type == 1) {
-            L = light.pos - posWorld;
-            float d = length(L);
-            att = 1 / (d * d);
-            L = normalize(L);
-            float theta = dot(L, normalize(-light.dir));
-            float epsilon = light.innerCutOff - light.outerCutOff;
-            att *= clamp((theta - light.outerCutOff) / epsilon, 0, 1);
-        } else if (light.type == 2) {
-            L = -normalize(light.dir);
-            att = 1;
-        }
-        
-        vec3 V = normalize(uViewPos - posWorld);
-        vec3 N = normalize(normal);
-        vec3 H = normalize(L + V);
-
-        float D = distributionGGX(N, H, roughness);
-
-        vec3 F0 = vec3(0.04);
-        F0 = mix(F0, albedo, metallic);
-        vec3 F = fresnelSchlick(H, V, F0);
-        float G = geometrySmith(N, V, L, roughness);
-
-        vec3 radiance = att * light.color * light.intensity;
+    // Lightmapped pixels take their diffuse lighting from the lightmap and
+    // skip the lights, specular included.
+    if (baked.a != 0) {
+        vec3 ambient = vec3(0.03) * albedo * ao;
+        outColor = vec4(ambient + baked.rgb * albedo, 1);
+        return;
+    }
 
-        vec3 specular = (D * F * G) / max(4 * max(dot(V, N), 0) * max(dot(L, N), 0), 0.001);
-        vec3 kS = F;
-        vec3 kD = vec3(1) - kS;
-        kD *= (1 - metallic);
+    // With half resolution diffuse, full resolution diffuse is only needed
+    // as the reference for measuring the error.
+    bool isHalfRes = uEnableHalfResDiffuse != 0;
+    bool needsDiffuse = !isHalfRes || uMeasureLightingError != 0;
 
-        Lo += (kD * albedo / PI + specular) * radiance * max(dot(N, L), 0);
+    vec3 diffuse = vec3(0);
+    vec3 specular = vec3(0);
+    if (needsDiffuse) {
+        for (int i = 0; i < uNumLights; ++i) {
+            vec3 lightDiffuse;
+            vec3 lightSpecular;
+            evaluateLight(i, posWorld, N, V, albedo, metallic, roughness,
+                          lightDiffuse, lightSpecular);
+            diffuse += lightDiffuse;
+            specular += lightSpecular;
+        }
+    } else {
+        for (int i = 0; i < uNumLights; ++i) {
+            specular += evaluateLightSpecular(i, posWorld, N, V, albedo,
+                                              metallic, roughness);
+        }
     }
 
     vec3 ambient = vec3(0.03) * albedo * ao;
-    vec3 color = ambient + Lo;
+    vec3 color = ambient + diffuse * albedo + specular;
+
+    if (isHalfRes) {
+        vec3 referenceColor = color;
+        color = ambient + upsampleDiffuse(posWorld, N) * albedo + specular;
+        if (uMeasureLightingError != 0 && dot(normal, normal) != 0) {
+            recordLightingError(color, referenceColor);
+        }
+    }
 
     outColor = vec4(color , 1);
-}
\ No newline at end of file
+}
@@ -0,0 +1,39 @@
+#version 450
+
+#include "brdf.glsl"
+#include "standard_sets.glsl"
+#include "lighting.glsl"
+
+layout (location = 0) out vec4 outDiffuse;
+
+// Runs over a half resolution viewport. Every texel lights the top left pixel
+// of its 2x2 block, which the upsample in brdf.frag looks up again to weigh
+// the texel against the pixel being shaded.
+void main() {
+    ivec2 coord = ivec2(gl_FragCoord.xy) * 2;
+    vec3 posWorld = texelFetch(sampler2D(uGbuffer[TEX_G_POSITION], uSamplers[SMP_NEAREST]), coord, 0).rgb;
+    vec3 normal = texelFetch(sampler2D(uGbuffer[TEX_G_NORMAL], uSamplers[SMP_NEAREST]), coord, 0).rgb;
+    vec3 albedo = texelFetch(sampler2D(uGbuffer[TEX_G_ALBEDO], uSamplers[SMP_NEAREST]), coord, 0).rgb;
+    vec4 MRAH = texelFetch(sampler2D(uGbuffer[TEX_G_MRAH], uSamplers[SMP_NEAREST]), coord, 0);
+
+    if (dot(normal, normal) == 0) {
+        outDiffuse = vec4(0);
+        return;
+    }
+
+    vec4 baked = texelFetch(sampler2D(uGbuffer[TEX_G_BAKED], uSamplers[SMP_NEAREST]), coord, 0);
+    if (baked.a != 0) {
+        outDiffuse = vec4(baked.rgb, 1);
+        return;
+    }
+
+    vec3 N = normalize(normal);
+    vec3 V = normalize(uViewPos - posWorld);
+
+    vec3 diffuse = vec3(0);
+    for (int i = 0; i < uNumLights; ++i) {
+        diffuse += evaluateLightDiffuse(i, posWorld, N, V, albedo, MRAH.r);
+    }
+
+    outDiffuse = vec4(diffuse, 1);
+}
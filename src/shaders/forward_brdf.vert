@@ -2,12 +2,23 @@
 
 #include "standard_sets.glsl"
 
+#ifdef PULL_VERTICES
+#include "vertex_pulling.glsl"
+#else
 layout (location = 0) in vec3 aPosition;
 layout (location = 1) in vec2 aUV;
 layout (location = 2) in vec3 aNormal;
 layout (location = 3) in vec3 aTangent;
 layout (location = 4) in mat4 aModel;
 layout (location = 8) in mat4 aInvModel;
+#endif
+
+// See StandardPushConstants.
+layout (push_constant) uniform DrawConstants {
+    int uHasDrawTransform;
+    layout (offset = 16) vec4 uDrawTransform[3];
+};
+
 // layout (location = 12) in vec3 aAlbedo;
 // layout (location = 13) in float aMetallic;
 // layout (location = 14) in float aRoughness;
@@ -21,14 +32,20 @@ layout (location = 3) out flat mat3 vTBN;
 //layout (location = 5) out flat vec3 vAlbedo;
 //layout (location = 6) out flat vec3 vMRA; // Metallic, Roughness, AO
 
+invariant gl_Position;
+
 void main() {
-    vec4 posWorld = aModel * vec4(aPosition, 1.0);
+#ifdef PULL_VERTICES
+    pullVertex(uHasDrawTransform);
+#endif
+    mat4 model = getModelMatrix(uHasDrawTransform, uDrawTransform, aModel);
+    vec4 posWorld = model * vec4(aPosition, 1.0);
     vPosWorld = posWorld.xyz;
-    gl_Position = uProjMat * uViewMat * posWorld;
+    gl_Position = uProjMat * (uViewMat * posWorld);
     vUV = aUV;
 
     // TODO(ilgwon): Pass normal matrix through instance data
-    mat3 normalMat = transpose(mat3(aInvModel));
+    mat3 normalMat = getNormalMatrix(uHasDrawTransform, model, aInvModel);
     vec3 N = normalize(normalMat * aNormal);
     vNormalWorld = N;
     vec3 T = normalize(normalMat * aTangent);
@@ -6,12 +6,14 @@ layout (location = 0) in vec4 vPosWorld;
 layout (location = 1) in vec2 vUV;
 layout (location = 2) in vec3 vNormalWorld;
 layout (location = 3) in mat3 vTBN;
+layout (location = 6) in vec2 vLightmapUV;
+layout (location = 7) in flat int vIsLightmapped;
 
 layout (location = 0) out vec4 outPosWorld;
 layout (location = 1) out vec3 outNormal;
 layout (location = 2) out vec3 outAlbedo;
 layout (location = 3) out vec4 outMRAH; // Metallic, Roughness, AO, Height
-layout (location = 4) out vec3 outMaterialIndex;
+layout (location = 4) out vec4 outBakedLighting;
 
 
 void main() 
@@ -29,5 +31,9 @@ void main()
     }
     outAlbedo = texture(sampler2D(uMaterialTextures[TEX_ALBEDO], uSamplers[SMP_LINEAR]), vUV).rgb;
     outMRAH = vec4(metallic, roughness, ao, height);
-    outMaterialIndex = vec3(1,0,0); // Not in use?
+    if (vIsLightmapped != 0) {
+        outBakedLighting = vec4(texture(sampler2D(uLightmap, uSamplers[SMP_LINEAR]), vLightmapUV).rgb, 1);
+    } else {
+        outBakedLighting = vec4(0);
+    }
 }
\ No newline at end of file
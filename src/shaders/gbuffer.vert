@@ -2,27 +2,46 @@
 
 #include "standard_sets.glsl"
 
+#ifdef PULL_VERTICES
+#include "vertex_pulling.glsl"
+#else
 layout (location = 0) in vec3 aPosition;
 layout (location = 1) in vec2 aUV;
 layout (location = 2) in vec3 aNormal;
 layout (location = 3) in vec3 aTangent;
 layout (location = 4) in mat4 aModel;
 layout (location = 8) in mat4 aInvModel;
+#endif
 
+// See StandardPushConstants.
+layout (push_constant) uniform DrawConstants {
+    int uHasDrawTransform;
+    layout (offset = 8) int uIsLightmapped;
+    layout (offset = 16) vec4 uDrawTransform[3];
+    layout (offset = 64) vec4 uLightmapUVTransform[2];
+};
 
 layout (location = 0) out vec4 vPosWorld;
 layout (location = 1) out vec2 vUV;
 layout (location = 2) out vec3 vNormalWorld;
 layout (location = 3) out mat3 vTBN;
+layout (location = 6) out vec2 vLightmapUV;
+layout (location = 7) out flat int vIsLightmapped;
+
+invariant gl_Position;
 
 void main() {
-    vec4 posWorld = aModel * vec4(aPosition, 1.0);
+#ifdef PULL_VERTICES
+    pullVertex(uHasDrawTransform);
+#endif
+    mat4 model = getModelMatrix(uHasDrawTransform, uDrawTransform, aModel);
+    vec4 posWorld = model * vec4(aPosition, 1.0);
     vec4 posView = uViewMat * posWorld;
     
     gl_Position = uProjMat * posView;
 
 
-    mat3 normalMat = transpose(mat3(aInvModel));
+    mat3 normalMat = getNormalMatrix(uHasDrawTransform, model, aInvModel);
     vec3 N = normalize(normalMat * aNormal);
     vec3 T = normalize(normalMat * aTangent);
     vec3 B = cross(N, T);
@@ -33,4 +52,9 @@ void main() {
 
     vTBN = mat3(T, B, N);
     vUV = aUV;
+
+    vIsLightmapped = uIsLightmapped;
+    vec4 pos = vec4(aPosition, 1.0);
+    vLightmapUV = vec2(dot(uLightmapUVTransform[0], pos),
+                       dot(uLightmapUVTransform[1], pos));
 }
\ No newline at end of file
@@ -0,0 +1,64 @@
+#version 450
+
+#include "standard_sets.glsl"
+
+// The atlas is bound as the material, see ImpostorMap.
+#define TEX_IMPOSTOR_ALBEDO 0
+#define TEX_IMPOSTOR_NORMAL 1
+#define TEX_IMPOSTOR_MRAH   2
+#define TEX_IMPOSTOR_DEPTH  3
+
+#define IMPOSTOR_GRID_SIZE 8
+
+layout (location = 0) in vec3 vQuadPos;
+layout (location = 1) in flat vec3 vViewPos;
+layout (location = 2) in flat ivec2 vCell;
+layout (location = 3) in flat vec3 vCellDir;
+layout (location = 4) in flat vec3 vCellRight;
+layout (location = 5) in flat vec3 vCellUp;
+layout (location = 6) in flat mat4 vModel;
+layout (location = 10) in flat mat3 vNormalMat;
+
+layout (location = 0) out vec4 outPosWorld;
+layout (location = 1) out vec3 outNormal;
+layout (location = 2) out vec3 outAlbedo;
+layout (location = 3) out vec4 outMRAH; // Metallic, Roughness, AO, Height
+layout (location = 4) out vec4 outBakedLighting;
+
+void main() {
+    // The cell is an orthographic view along -vCellDir, so the view ray is
+    // followed to the cell's plane through the center, and the texel there
+    // stands for the whole ray. Single step, without marching the depth.
+    vec3 rayDir = vQuadPos - vViewPos;
+    float rayDotDir = dot(rayDir, vCellDir);
+    if (rayDotDir > -1e-4) {
+        discard;
+    }
+    vec3 planePos = vViewPos - rayDir * (dot(vViewPos, vCellDir) / rayDotDir);
+    vec2 local = vec2(dot(planePos, vCellRight), dot(planePos, vCellUp));
+    if (any(greaterThan(abs(local), vec2(1)))) {
+        discard;
+    }
+
+    vec2 cellUV = vec2(0.5 + 0.5 * local.x, 0.5 - 0.5 * local.y);
+    vec2 uv = (vec2(vCell) + cellUV) / IMPOSTOR_GRID_SIZE;
+
+    float depth = texture(sampler2D(uMaterialTextures[TEX_IMPOSTOR_DEPTH], uSamplers[SMP_NEAREST]), uv).r;
+    if (depth <= 0) {
+        discard;
+    }
+
+    // Depth is 1 at the front of the unit sphere and 0 at its back.
+    vec3 pos = vCellRight * local.x + vCellUp * local.y + vCellDir * (depth * 2 - 1);
+    vec4 posWorld = vModel * vec4(pos, 1.0);
+    vec4 posClip = uProjMat * uViewMat * posWorld;
+    gl_FragDepth = posClip.z / posClip.w;
+
+    vec3 normal = texture(sampler2D(uMaterialTextures[TEX_IMPOSTOR_NORMAL], uSamplers[SMP_NEAREST]), uv).xyz;
+
+    outPosWorld = vec4(posWorld.xyz, 1.0);
+    outNormal = normalize(vNormalMat * normal);
+    outAlbedo = texture(sampler2D(uMaterialTextures[TEX_IMPOSTOR_ALBEDO], uSamplers[SMP_LINEAR]), uv).rgb;
+    outMRAH = texture(sampler2D(uMaterialTextures[TEX_IMPOSTOR_MRAH], uSamplers[SMP_LINEAR]), uv);
+    outBakedLighting = vec4(0);
+}
@@ -0,0 +1,76 @@
+#version 450
+
+#include "standard_sets.glsl"
+
+// See ImpostorAtlas. aModel takes the unit sphere to the mesh's bounds.
+layout (location = 4) in mat4 aModel;
+layout (location = 8) in mat4 aInvModel;
+
+#define IMPOSTOR_GRID_SIZE 8
+
+layout (location = 0) out vec3 vQuadPos;
+layout (location = 1) out flat vec3 vViewPos;
+layout (location = 2) out flat ivec2 vCell;
+layout (location = 3) out flat vec3 vCellDir;
+layout (location = 4) out flat vec3 vCellRight;
+layout (location = 5) out flat vec3 vCellUp;
+layout (location = 6) out flat mat4 vModel;
+layout (location = 10) out flat mat3 vNormalMat;
+
+vec2 signNotZero(vec2 v) {
+    return vec2(v.x >= 0 ? 1 : -1, v.y >= 0 ? 1 : -1);
+}
+
+// y up, the lower hemisphere folded over the corners.
+vec2 encodeOctahedral(vec3 dir) {
+    vec2 p = dir.xz / (abs(dir.x) + abs(dir.y) + abs(dir.z));
+    if (dir.y < 0) {
+        p = (1 - abs(p.yx)) * signNotZero(p);
+    }
+    return p * 0.5 + 0.5;
+}
+
+vec3 decodeOctahedral(vec2 uv) {
+    vec2 p = uv * 2 - 1;
+    vec3 dir = vec3(p.x, 1 - abs(p.x) - abs(p.y), p.y);
+    if (dir.y < 0) {
+        dir.xz = (1 - abs(dir.zx)) * signNotZero(dir.xz);
+    }
+    return normalize(dir);
+}
+
+// Axes of a view looking along -dir, as Mat4::lookAt() builds them.
+void getBasis(vec3 dir, out vec3 right, out vec3 up) {
+    vec3 upAxis = abs(dir.y) > 0.99 ? vec3(0, 0, 1) : vec3(0, 1, 0);
+    vec3 forward = -dir;
+    right = normalize(cross(upAxis, forward));
+    up = cross(forward, right);
+}
+
+void main() {
+    // Clamped outside the sphere, where the quad would have to be infinite.
+    vec3 viewPos = (aInvModel * vec4(uViewPos, 1.0)).xyz;
+    float viewDist = max(length(viewPos), 1.01);
+    vec3 viewDir = normalize(viewPos);
+
+    ivec2 cell = clamp(ivec2(encodeOctahedral(viewDir) * IMPOSTOR_GRID_SIZE),
+                       ivec2(0), ivec2(IMPOSTOR_GRID_SIZE - 1));
+    vCell = cell;
+    vCellDir = decodeOctahedral((vec2(cell) + 0.5) / IMPOSTOR_GRID_SIZE);
+    getBasis(vCellDir, vCellRight, vCellUp);
+
+    // Facing the view through the center, just big enough to cover the
+    // silhouette of the sphere in perspective.
+    const vec2 corners[6] = vec2[](vec2(-1, -1), vec2(1, -1), vec2(1, 1),
+                                   vec2(-1, -1), vec2(1, 1), vec2(-1, 1));
+    vec3 right, up;
+    getBasis(viewDir, right, up);
+    float halfSize = inversesqrt(1 - 1 / (viewDist * viewDist));
+    vec2 corner = corners[gl_VertexIndex] * halfSize;
+    vQuadPos = right * corner.x + up * corner.y;
+
+    vViewPos = viewPos;
+    vModel = aModel;
+    vNormalMat = transpose(mat3(aInvModel));
+    gl_Position = uProjMat * uViewMat * aModel * vec4(vQuadPos, 1.0);
+}
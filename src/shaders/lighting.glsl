@@ -0,0 +1,126 @@
+// Needs brdf.glsl and standard_sets.glsl.
+
+// 1 where posWorld is lit by the light, 0 where it's in shadow, filtered
+// over 2x2 texels. Positions are pushed along N by a texel at their distance
+// from the light so that surfaces don't shadow themselves.
+float computeShadow(int lightIndex, vec3 posWorld, vec3 N) {
+    ShadowLight shadow = uShadowLights[lightIndex];
+    if (uEnableShadows == 0 || shadow.numTiles == 0) {
+        return 1;
+    }
+
+    vec3 toPos = posWorld - uLights[lightIndex].pos;
+    uint face = 0;
+    if (shadow.numTiles == 6) {
+        vec3 a = abs(toPos);
+        if (a.x >= a.y && a.x >= a.z) {
+            face = toPos.x > 0 ? 0 : 1;
+        } else if (a.y >= a.z) {
+            face = toPos.y > 0 ? 2 : 3;
+        } else {
+            face = toPos.z > 0 ? 4 : 5;
+        }
+    }
+
+    float offset = 1.5 * shadow.texelScale * length(toPos);
+    vec4 clip = shadow.viewProj[face] * vec4(posWorld + N * offset, 1);
+    if (clip.w <= 0) {
+        return 1;
+    }
+    vec3 ndc = clip.xyz / clip.w;
+    if (any(greaterThan(abs(ndc.xy), vec2(1))) || ndc.z > 1 || ndc.z < 0) {
+        return 1;
+    }
+
+    // Keep the filter footprint inside the tile.
+    vec4 tile = shadow.tiles[face];
+    vec2 halfTexel = 0.5 / vec2(textureSize(uShadowAtlas, 0));
+    vec2 uv = clamp(tile.xy + (ndc.xy * 0.5 + 0.5) * tile.zw,
+                    tile.xy + halfTexel, tile.xy + tile.zw - halfTexel);
+    return texture(sampler2DShadow(uShadowAtlas, uSamplers[SMP_SHADOW]),
+                   vec3(uv, ndc.z));
+}
+
+// Direction from posWorld to the light, and the shadowed radiance reaching
+// posWorld from it.
+void getLightIncidence(int lightIndex, vec3 posWorld, vec3 N,
+                       out vec3 L, out vec3 radiance) {
+    Light light = uLights[lightIndex];
+    float att;
+    if (light.type == 0) {
+        L = light.pos - posWorld;
+        float d = length(L);
+        att = 1 / (d * d);
+        L = normalize(L);
+    } else if (light.type == 1) {
+        L = light.pos - posWorld;
+        float d = length(L);
+        att = 1 / (d * d);
+        L = normalize(L);
+        float theta = dot(L, normalize(-light.dir));
+        float epsilon = light.innerCutOff - light.outerCutOff;
+        att *= clamp((theta - light.outerCutOff) / epsilon, 0, 1);
+    } else if (light.type == 2) {
+        L = -normalize(light.dir);
+        att = 1;
+    }
+
+    radiance = att * light.color * light.intensity *
+               computeShadow(lightIndex, posWorld, N);
+}
+
+vec3 getLightFresnel(vec3 L, vec3 V, vec3 albedo, float metallic) {
+    vec3 H = normalize(L + V);
+    vec3 F0 = vec3(0.04);
+    F0 = mix(F0, albedo, metallic);
+    return fresnelSchlick(H, V, F0);
+}
+
+vec3 getDiffuseBRDF(vec3 F, float metallic) {
+    vec3 kS = F;
+    vec3 kD = vec3(1) - kS;
+    kD *= (1 - metallic);
+    return kD / PI;
+}
+
+vec3 getSpecularBRDF(vec3 N, vec3 V, vec3 L, vec3 F, float roughness) {
+    vec3 H = normalize(L + V);
+    float D = distributionGGX(N, H, roughness);
+    float G = geometrySmith(N, V, L, roughness);
+    return (D * F * G) / max(4 * max(dot(V, N), 0) * max(dot(L, N), 0), 0.001);
+}
+
+// Contribution of one light at posWorld, weighted by N.L. Diffuse is left
+// without albedo so that it can be computed at a lower resolution than the
+// albedo texture. N and V are normalized.
+void evaluateLight(int lightIndex, vec3 posWorld, vec3 N, vec3 V, vec3 albedo,
+                   float metallic, float roughness,
+                   out vec3 diffuse, out vec3 specular) {
+    vec3 L;
+    vec3 radiance;
+    getLightIncidence(lightIndex, posWorld, N, L, radiance);
+    vec3 F = getLightFresnel(L, V, albedo, metallic);
+    vec3 irradiance = radiance * max(dot(N, L), 0);
+    diffuse = getDiffuseBRDF(F, metallic) * irradiance;
+    specular = getSpecularBRDF(N, V, L, F, roughness) * irradiance;
+}
+
+// Either half of evaluateLight(), for passes that only need one.
+vec3 evaluateLightDiffuse(int lightIndex, vec3 posWorld, vec3 N, vec3 V,
+                          vec3 albedo, float metallic) {
+    vec3 L;
+    vec3 radiance;
+    getLightIncidence(lightIndex, posWorld, N, L, radiance);
+    vec3 F = getLightFresnel(L, V, albedo, metallic);
+    return getDiffuseBRDF(F, metallic) * radiance * max(dot(N, L), 0);
+}
+
+vec3 evaluateLightSpecular(int lightIndex, vec3 posWorld, vec3 N, vec3 V,
+                           vec3 albedo, float metallic, float roughness) {
+    vec3 L;
+    vec3 radiance;
+    getLightIncidence(lightIndex, posWorld, N, L, radiance);
+    vec3 F = getLightFresnel(L, V, albedo, metallic);
+    return getSpecularBRDF(N, V, L, F, roughness) * radiance *
+           max(dot(N, L), 0);
+}
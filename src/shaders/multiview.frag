@@ -0,0 +1,35 @@
+#version 450
+
+#include "brdf.glsl"
+#include "standard_sets.glsl"
+#include "lighting.glsl"
+
+layout (location = 0) in vec2 vUV;
+layout (location = 1) in vec3 vPosWorld;
+layout (location = 2) in vec3 vNormalWorld;
+layout (location = 3) in flat vec3 vViewPos;
+
+layout (location = 0) out vec4 outColor;
+
+// Views are shown as they are, so they're tone mapped right away.
+void main() {
+    vec3 albedo = texture(sampler2D(uMaterialTextures[TEX_ALBEDO], uSamplers[SMP_LINEAR]), vUV).rgb;
+    float metallic = texture(sampler2D(uMaterialTextures[TEX_METALLIC], uSamplers[SMP_LINEAR]), vUV).r;
+    float roughness = texture(sampler2D(uMaterialTextures[TEX_ROUGHNESS], uSamplers[SMP_LINEAR]), vUV).r;
+    float ao = texture(sampler2D(uMaterialTextures[TEX_AO], uSamplers[SMP_LINEAR]), vUV).r;
+
+    vec3 N = normalize(vNormalWorld);
+    vec3 V = normalize(vViewPos - vPosWorld);
+
+    vec3 Lo = vec3(0);
+    for (int i = 0; i < uNumLights; ++i) {
+        vec3 diffuse;
+        vec3 specular;
+        evaluateLight(i, vPosWorld, N, V, albedo, metallic, roughness,
+                      diffuse, specular);
+        Lo += diffuse * albedo + specular;
+    }
+
+    vec3 color = vec3(0.03) * albedo * ao + Lo;
+    outColor = vec4(vec3(1.0) - exp(-color * uExposure), 1.0);
+}
@@ -0,0 +1,13 @@
+#version 450
+#extension GL_EXT_multiview : require
+
+#include "standard_sets.glsl"
+
+// See StandardPushConstants.
+layout (push_constant) uniform DrawConstants {
+    int uHasDrawTransform;
+    layout (offset = 16) vec4 uDrawTransform[3];
+};
+
+#define VIEW_INDEX gl_ViewIndex
+#include "multiview_common.glsl"
@@ -0,0 +1,25 @@
+// Vertex shader of the multiview capture, included by multiview.vert and
+// multiview_layered.vert once they define VIEW_INDEX and their push
+// constants. Needs standard_sets.glsl.
+
+layout (location = 0) in vec3 aPosition;
+layout (location = 1) in vec2 aUV;
+layout (location = 2) in vec3 aNormal;
+layout (location = 4) in mat4 aModel;
+layout (location = 8) in mat4 aInvModel;
+
+layout (location = 0) out vec2 vUV;
+layout (location = 1) out vec3 vPosWorld;
+layout (location = 2) out vec3 vNormalWorld;
+layout (location = 3) out flat vec3 vViewPos;
+
+void main() {
+    mat4 model = getModelMatrix(uHasDrawTransform, uDrawTransform, aModel);
+    vec4 posWorld = model * vec4(aPosition, 1.0);
+    gl_Position = uMultiviewViewProj[VIEW_INDEX] * posWorld;
+    vPosWorld = posWorld.xyz;
+    vUV = aUV;
+    mat3 normalMat = getNormalMatrix(uHasDrawTransform, model, aInvModel);
+    vNormalWorld = normalize(normalMat * aNormal);
+    vViewPos = uMultiviewPos[VIEW_INDEX].xyz;
+}
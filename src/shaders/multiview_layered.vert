@@ -0,0 +1,13 @@
+#version 450
+
+#include "standard_sets.glsl"
+
+// See StandardPushConstants.
+layout (push_constant) uniform LayeredConstants {
+    int uHasDrawTransform;
+    layout (offset = 12) int uViewIndex;
+    layout (offset = 16) vec4 uDrawTransform[3];
+};
+
+#define VIEW_INDEX uViewIndex
+#include "multiview_common.glsl"
@@ -0,0 +1,18 @@
+#version 450
+
+#include "standard_sets.glsl"
+
+layout (location = 0) in vec3 aPosition;
+layout (location = 4) in mat4 aModel;
+
+// See StandardPushConstants.
+layout (push_constant) uniform ShadowConstants {
+    int uHasDrawTransform;
+    layout (offset = 16) vec4 uDrawTransform[3];
+    layout (offset = 64) mat4 uShadowViewProj;
+};
+
+void main() {
+    mat4 model = getModelMatrix(uHasDrawTransform, uDrawTransform, aModel);
+    gl_Position = uShadowViewProj * (model * vec4(aPosition, 1.0));
+}
@@ -20,21 +20,80 @@ layout (set = SET_FRAME, binding = 0) uniform FrameData {
     int uVisualizedGBufferAttachmentIndex;
     int uEnableToneMapping;
     float uExposure;
+    int uEnableHalfResDiffuse;
+    int uMeasureLightingError;
+    int uEnableShadows;
 };
 
-layout (set = SET_FRAME, binding = 1) uniform sampler uSamplers[2];
+layout (set = SET_FRAME, binding = 1) uniform sampler uSamplers[3];
 #define SMP_NEAREST 0
 #define SMP_LINEAR  1
+#define SMP_SHADOW  2 // Depth comparison, reverse-Z
 
 layout (set = SET_FRAME, binding = 2) uniform texture2D uGbuffer[5];
 #define TEX_G_POSITION    0
 #define TEX_G_NORMAL      1
 #define TEX_G_ALBEDO      2
 #define TEX_G_MRAH        3
-#define TEX_G_MATINDEX    4
+#define TEX_G_BAKED       4 // a = 1 where lightmapped
 
 layout (set = SET_FRAME, binding = 3) uniform texture2D uHDRBuffer;
 
+// Draw id plus one in the high bits, triangle in the low bits, 0 if empty.
+layout (set = SET_FRAME, binding = 4) uniform utexture2D uVisibilityBuffer;
+#define VISIBILITY_TRIANGLE_BITS 22
+
+struct VisibilityDraw {
+    mat4 modelMat;
+    mat4 invModelMat;
+    uint firstIndex;
+    int vertexOffset;
+    uint indexSource; // 0 = geometry pool, 1 = scene index buffer
+    uint material;
+};
+
+layout (std430, set = SET_FRAME, binding = 5) readonly buffer VisibilityDraws {
+    VisibilityDraw uVisibilityDraws[];
+};
+
+// Raw words of the geometry pool's position, attribute and index buffers,
+// plus the scene's own index buffer.
+layout (std430, set = SET_FRAME, binding = 6) readonly buffer VisibilityStorage {
+    uint words[];
+} uVisibilityStorage[4];
+#define BUF_POSITIONS     0
+#define BUF_ATTRIBUTES    1
+#define BUF_POOL_INDICES  2
+#define BUF_SCENE_INDICES 3
+
+// Only the top left quarter is written, one texel per 2x2 pixel block.
+layout (set = SET_FRAME, binding = 7) uniform texture2D uHalfResDiffuse;
+
+#define NUM_LIGHTING_ERROR_BUCKETS 1024
+layout (std430, set = SET_FRAME, binding = 8) buffer LightingError {
+    uint uLightingErrorSumSquared[NUM_LIGHTING_ERROR_BUCKETS];
+    uint uLightingErrorMax;
+    uint uLightingErrorNumPixels;
+    uint uLightingErrorNumVisible;
+};
+
+// Point lights have a tile per cube face, ordered +X, -X, +Y, -Y, +Z, -Z.
+struct ShadowLight {
+    mat4 viewProj[6];
+    vec4 tiles[6]; // xy = offset, zw = size, in atlas UV
+    uint numTiles; // 0 = no shadow
+    float texelScale;
+};
+
+layout (std430, set = SET_FRAME, binding = 9) readonly buffer ShadowLights {
+    ShadowLight uShadowLights[MAX_NUM_LIGHTS];
+};
+
+layout (set = SET_FRAME, binding = 10) uniform texture2D uShadowAtlas;
+
+// Diffuse lighting without albedo baked by bakeLightmap().
+layout (set = SET_FRAME, binding = 11) uniform texture2D uLightmap;
+
 layout (set = SET_VIEW, binding = 0) uniform ViewData {
     mat4 uViewMat;
     mat4 uProjMat;
@@ -42,10 +101,59 @@ layout (set = SET_VIEW, binding = 0) uniform ViewData {
     int uEnableNormalMap;
 };
 
+// Views of the multiview capture, picked by view index.
+#define MAX_NUM_MULTIVIEWS 6
+layout (set = SET_VIEW, binding = 1) uniform MultiviewData {
+    mat4 uMultiviewViewProj[MAX_NUM_MULTIVIEWS];
+    vec4 uMultiviewPos[MAX_NUM_MULTIVIEWS];
+};
+
 layout (set = SET_MATERIAL, binding = 0) uniform texture2D uMaterialTextures[6];
 #define TEX_ALBEDO    0
 #define TEX_METALLIC  1
 #define TEX_ROUGHNESS 2
 #define TEX_AO        3
 #define TEX_NORMAL    4
-#define TEX_HEIGHT    5
\ No newline at end of file
+#define TEX_HEIGHT    5
+
+struct Instance {
+    mat4 modelMat;
+    mat4 invModelMat;
+};
+
+// InstanceBlocks of the draw, only read by vertex shaders that pull their
+// vertices, see VertexPulling. Others take them as vertex attributes.
+layout (std430, set = SET_DRAW, binding = 0) readonly buffer Instances {
+    Instance uInstances[];
+};
+
+vec3 fetchPosition(uint v) {
+    uint base = v * 3;
+    return uintBitsToFloat(uvec3(uVisibilityStorage[BUF_POSITIONS].words[base],
+                                 uVisibilityStorage[BUF_POSITIONS].words[base + 1],
+                                 uVisibilityStorage[BUF_POSITIONS].words[base + 2]));
+}
+
+// VertexAttributes: vec2 UV, vec3 normal, vec3 tangent, tightly packed.
+float fetchAttribute(uint v, uint i) {
+    return uintBitsToFloat(uVisibilityStorage[BUF_ATTRIBUTES].words[v * 8 + i]);
+}
+
+// The instance's model matrix, or the one pushed for a single instance draw
+// when _hasDrawTransform is set, see StandardPushConstants.
+mat4 getModelMatrix(int _hasDrawTransform, vec4 _drawTransform[3],
+                    mat4 _instanceModel) {
+    if (_hasDrawTransform == 0) {
+        return _instanceModel;
+    }
+    return transpose(mat4(_drawTransform[0], _drawTransform[1],
+                          _drawTransform[2], vec4(0, 0, 0, 1)));
+}
+
+mat3 getNormalMatrix(int _hasDrawTransform, mat4 _model,
+                     mat4 _instanceInvModel) {
+    if (_hasDrawTransform == 0) {
+        return transpose(mat3(_instanceInvModel));
+    }
+    return transpose(inverse(mat3(_model)));
+}
@@ -9,15 +9,22 @@ layout (location = 3) in vec3 aTangent;
 layout (location = 4) in mat4 aModel;
 layout (location = 8) in mat4 aInvModel;
 
+// See StandardPushConstants.
+layout (push_constant) uniform DrawConstants {
+    int uHasDrawTransform;
+    layout (offset = 16) vec4 uDrawTransform[3];
+};
+
 layout (location = 0) out vec3 vT;
 layout (location = 1) out vec3 vB;
 layout (location = 2) out vec3 vN;
 layout (location = 3) out mat4 vCombined;
 
 void main() {
-    mat3 normalMat = transpose(mat3(aInvModel));
+    mat4 model = getModelMatrix(uHasDrawTransform, uDrawTransform, aModel);
+    mat3 normalMat = getNormalMatrix(uHasDrawTransform, model, aInvModel);
     
-    gl_Position = aModel * vec4(aPosition, 1.0);
+    gl_Position = model * vec4(aPosition, 1.0);
     vCombined = uProjMat * uViewMat;
 
     vN = normalize(normalMat * aNormal);
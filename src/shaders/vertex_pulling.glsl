@@ -0,0 +1,26 @@
+// Included by vertex shaders built with PULL_VERTICES, see VertexPulling, in
+// place of the vertex attributes of MeshVertexInput. pullVertex() fills the
+// same names from the geometry pool's storage buffers by gl_VertexIndex, which
+// includes the draw's vertex offset, and from the draw set's instances by
+// gl_InstanceIndex, which includes its first instance.
+
+vec3 aPosition;
+vec2 aUV;
+vec3 aNormal;
+vec3 aTangent;
+mat4 aModel;
+mat4 aInvModel;
+
+// The instance isn't read with a pushed draw transform, as the draw set then
+// only holds a placeholder.
+void pullVertex(int _hasDrawTransform) {
+    uint v = uint(gl_VertexIndex);
+    aPosition = fetchPosition(v);
+    aUV = vec2(fetchAttribute(v, 0), fetchAttribute(v, 1));
+    aNormal = vec3(fetchAttribute(v, 2), fetchAttribute(v, 3), fetchAttribute(v, 4));
+    aTangent = vec3(fetchAttribute(v, 5), fetchAttribute(v, 6), fetchAttribute(v, 7));
+    if (_hasDrawTransform == 0) {
+        aModel = uInstances[gl_InstanceIndex].modelMat;
+        aInvModel = uInstances[gl_InstanceIndex].invModelMat;
+    }
+}
@@ -0,0 +1,14 @@
+#version 450
+
+#include "standard_sets.glsl"
+
+layout (location = 0) in flat uint vDrawId;
+
+layout (location = 0) out uint outVisibility;
+
+void main() {
+    // Triangles past the field's range wrap around rather than corrupt the
+    // draw id.
+    uint triangle = uint(gl_PrimitiveID) & ((1u << VISIBILITY_TRIANGLE_BITS) - 1);
+    outVisibility = ((vDrawId + 1) << VISIBILITY_TRIANGLE_BITS) | triangle;
+}
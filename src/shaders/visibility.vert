@@ -0,0 +1,24 @@
+#version 450
+
+#include "standard_sets.glsl"
+
+layout (location = 0) in vec3 aPosition;
+layout (location = 4) in mat4 aModel;
+
+// See StandardPushConstants.
+layout (push_constant) uniform DrawConstants {
+    int uHasDrawTransform;
+    layout (offset = 4) int uVisibilityDrawIdBase;
+    layout (offset = 16) vec4 uDrawTransform[3];
+};
+
+layout (location = 0) out flat uint vDrawId;
+
+invariant gl_Position;
+
+void main() {
+    mat4 model = getModelMatrix(uHasDrawTransform, uDrawTransform, aModel);
+    vec4 posWorld = model * vec4(aPosition, 1.0);
+    gl_Position = uProjMat * (uViewMat * posWorld);
+    vDrawId = uint(uVisibilityDrawIdBase + gl_InstanceIndex);
+}
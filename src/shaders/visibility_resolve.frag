@@ -0,0 +1,106 @@
+#version 450
+
+#include "brdf.glsl"
+#include "standard_sets.glsl"
+#include "lighting.glsl"
+
+layout (location = 0) in vec3 vRayDir;
+layout (location = 1) in flat uint vMaterial;
+
+layout (location = 0) out vec4 outColor;
+
+uint fetchIndex(VisibilityDraw draw, uint i) {
+    if (draw.indexSource == 0) {
+        return uVisibilityStorage[BUF_POOL_INDICES].words[draw.firstIndex + i];
+    }
+    return uVisibilityStorage[BUF_SCENE_INDICES].words[draw.firstIndex + i];
+}
+
+// Barycentric weights of p1 and p2 where the ray from the eye along dir hits
+// the plane of the triangle (p0, p0 + e1, p0 + e2).
+vec2 intersectBarycentrics(vec3 dir, vec3 p0, vec3 e1, vec3 e2) {
+    vec3 p = cross(dir, e2);
+    float invDet = 1 / dot(e1, p);
+    vec3 s = uViewPos - p0;
+    vec3 q = cross(s, e1);
+    return vec2(dot(s, p), dot(dir, q)) * invDet;
+}
+
+void main() {
+    // Taken before anything is discarded, while the whole quad is running.
+    vec3 rayDirDx = dFdx(vRayDir);
+    vec3 rayDirDy = dFdy(vRayDir);
+
+    uint visibility = texelFetch(usampler2D(uVisibilityBuffer, uSamplers[SMP_NEAREST]), ivec2(gl_FragCoord.xy), 0).r;
+    if (visibility == 0) {
+        discard;
+    }
+    VisibilityDraw draw = uVisibilityDraws[(visibility >> VISIBILITY_TRIANGLE_BITS) - 1];
+    if (draw.material != vMaterial) {
+        discard;
+    }
+    uint triangle = visibility & ((1u << VISIBILITY_TRIANGLE_BITS) - 1);
+
+    vec3 corners[3];
+    vec2 uvs[3];
+    vec3 normals[3];
+    vec3 tangents[3];
+    for (uint k = 0; k < 3; ++k) {
+        uint v = uint(int(fetchIndex(draw, triangle * 3 + k)) + draw.vertexOffset);
+        corners[k] = (draw.modelMat * vec4(fetchPosition(v), 1)).xyz;
+        uvs[k] = vec2(fetchAttribute(v, 0), fetchAttribute(v, 1));
+        normals[k] = vec3(fetchAttribute(v, 2), fetchAttribute(v, 3), fetchAttribute(v, 4));
+        tangents[k] = vec3(fetchAttribute(v, 5), fetchAttribute(v, 6), fetchAttribute(v, 7));
+    }
+
+    // Barycentrics at this pixel and its right and lower neighbours, all on
+    // this triangle's plane, which gives the UV gradients for mip selection.
+    vec3 e1 = corners[1] - corners[0];
+    vec3 e2 = corners[2] - corners[0];
+    vec2 b = intersectBarycentrics(vRayDir, corners[0], e1, e2);
+    vec2 bx = intersectBarycentrics(vRayDir + rayDirDx, corners[0], e1, e2);
+    vec2 by = intersectBarycentrics(vRayDir + rayDirDy, corners[0], e1, e2);
+
+    vec2 uvE1 = uvs[1] - uvs[0];
+    vec2 uvE2 = uvs[2] - uvs[0];
+    vec2 uv = uvs[0] + uvE1 * b.x + uvE2 * b.y;
+    vec2 uvDx = uvE1 * (bx.x - b.x) + uvE2 * (bx.y - b.y);
+    vec2 uvDy = uvE1 * (by.x - b.x) + uvE2 * (by.y - b.y);
+
+    vec3 weights = vec3(1 - b.x - b.y, b.x, b.y);
+    vec3 posWorld = corners[0] + e1 * b.x + e2 * b.y;
+    mat3 normalMat = transpose(mat3(draw.invModelMat));
+    vec3 normalWorld = normalize(normalMat * (normals[0] * weights.x + normals[1] * weights.y + normals[2] * weights.z));
+    vec3 tangentWorld = normalize(normalMat * (tangents[0] * weights.x + tangents[1] * weights.y + tangents[2] * weights.z));
+    mat3 TBN = mat3(tangentWorld, cross(normalWorld, tangentWorld), normalWorld);
+
+    vec3 albedo = textureGrad(sampler2D(uMaterialTextures[TEX_ALBEDO], uSamplers[SMP_LINEAR]), uv, uvDx, uvDy).rgb;
+    float metallic = textureGrad(sampler2D(uMaterialTextures[TEX_METALLIC], uSamplers[SMP_LINEAR]), uv, uvDx, uvDy).r;
+    float roughness = textureGrad(sampler2D(uMaterialTextures[TEX_ROUGHNESS], uSamplers[SMP_LINEAR]), uv, uvDx, uvDy).r;
+    float ao = textureGrad(sampler2D(uMaterialTextures[TEX_AO], uSamplers[SMP_LINEAR]), uv, uvDx, uvDy).r;
+    vec3 normal;
+    if (uEnableNormalMap != 0) {
+        normal = TBN * (textureGrad(sampler2D(uMaterialTextures[TEX_NORMAL], uSamplers[SMP_LINEAR]), uv, uvDx, uvDy).xyz * 2 - 1);
+    } else {
+        normal = normalWorld;
+    }
+
+    vec3 N = normalize(normal);
+    vec3 V = normalize(uViewPos - posWorld);
+
+    vec3 diffuse = vec3(0);
+    vec3 specular = vec3(0);
+    for (int i = 0; i < uNumLights; ++i) {
+        vec3 lightDiffuse;
+        vec3 lightSpecular;
+        evaluateLight(i, posWorld, N, V, albedo, metallic, roughness,
+                      lightDiffuse, lightSpecular);
+        diffuse += lightDiffuse;
+        specular += lightSpecular;
+    }
+
+    vec3 ambient = vec3(0.03) * albedo * ao;
+    vec3 color = ambient + diffuse * albedo + specular;
+
+    outColor = vec4(color, 1);
+}
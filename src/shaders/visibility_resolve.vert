@@ -0,0 +1,20 @@
+#version 450
+
+#include "standard_sets.glsl"
+
+layout (location = 0) out vec3 vRayDir;
+layout (location = 1) out flat uint vMaterial;
+
+void main() {
+    vec2 uv = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+    vec4 ndc = vec4(uv * 2.0f + -1.0f, 0.0f, 1.0f);
+    gl_Position = ndc;
+
+    // Depth 0 is the far plane. Points on it are an affine function of the
+    // screen position, so the rays towards them interpolate exactly.
+    vec4 farPos = inverse(uProjMat * uViewMat) * ndc;
+    vRayDir = farPos.xyz / farPos.w - uViewPos;
+
+    // One instance per material pass.
+    vMaterial = uint(gl_InstanceIndex);
+}
@@ -0,0 +1,686 @@
+#include "shadow.h"
+#include <algorithm>
+#include <math.h>
+#include <stddef.h>
+
+namespace bb {
+
+// Where a light's range falls below this fraction of its intensity at a
+// distance of one.
+constexpr float shadowLightCutOff = 0.05f;
+constexpr float shadowNearZ = 0.05f;
+
+static uint32_t getTileLevel(const ShadowTileAllocator &_allocator,
+                             uint32_t _tileSize) {
+  uint32_t level = 0;
+  while ((_allocator.Size >> level) > _tileSize) {
+    ++level;
+  }
+  return level;
+}
+
+ShadowTileAllocator createShadowTileAllocator(uint32_t _size,
+                                              uint32_t _minTileSize) {
+  ShadowTileAllocator allocator = {};
+  allocator.Size = _size;
+  allocator.NumLevels = getTileLevel(allocator, _minTileSize) + 1;
+  allocator.FreeTiles.resize(allocator.NumLevels);
+  allocator.FreeTiles[0].push_back({0, 0});
+  return allocator;
+}
+
+bool allocateShadowTile(ShadowTileAllocator &_allocator, uint32_t _tileSize,
+                        Int2 &_offset) {
+  uint32_t level = getTileLevel(_allocator, _tileSize);
+  BB_ASSERT(level < _allocator.NumLevels);
+
+  uint32_t freeLevel = level;
+  while (_allocator.FreeTiles[freeLevel].empty()) {
+    if (freeLevel == 0) {
+      return false;
+    }
+    --freeLevel;
+  }
+
+  Int2 offset = _allocator.FreeTiles[freeLevel].back();
+  _allocator.FreeTiles[freeLevel].pop_back();
+
+  // Keep the first child and free the other three on the way down.
+  for (; freeLevel < level; ++freeLevel) {
+    int childSize = (int)(_allocator.Size >> (freeLevel + 1));
+    std::vector<Int2> &children = _allocator.FreeTiles[freeLevel + 1];
+    children.push_back({offset.X + childSize, offset.Y});
+    children.push_back({offset.X, offset.Y + childSize});
+    children.push_back({offset.X + childSize, offset.Y + childSize});
+  }
+
+  _allocator.NumAllocatedTexels += (uint64_t)_tileSize * _tileSize;
+  _offset = offset;
+  return true;
+}
+
+void freeShadowTile(ShadowTileAllocator &_allocator, uint32_t _tileSize,
+                    Int2 _offset) {
+  _allocator.NumAllocatedTexels -= (uint64_t)_tileSize * _tileSize;
+
+  uint32_t level = getTileLevel(_allocator, _tileSize);
+  for (; level > 0; --level) {
+    int size = (int)(_allocator.Size >> level);
+    Int2 parent = {_offset.X & ~(2 * size - 1), _offset.Y & ~(2 * size - 1)};
+
+    std::vector<Int2> &freeTiles = _allocator.FreeTiles[level];
+    size_t siblingIndices[3];
+    int numSiblings = 0;
+    for (int child = 0; child < 4; ++child) {
+      Int2 sibling = {parent.X + (child & 1) * size,
+                      parent.Y + (child >> 1) * size};
+      if (sibling.X == _offset.X && sibling.Y == _offset.Y) {
+        continue;
+      }
+      auto it = std::find_if(freeTiles.begin(), freeTiles.end(),
+                             [&](const Int2 &_tile) {
+                               return _tile.X == sibling.X &&
+                                      _tile.Y == sibling.Y;
+                             });
+      if (it == freeTiles.end()) {
+        break;
+      }
+      siblingIndices[numSiblings++] = it - freeTiles.begin();
+    }
+
+    if (numSiblings < 3) {
+      break;
+    }
+
+    // Erase back to front so that the remaining indices stay valid.
+    std::sort(siblingIndices, siblingIndices + 3);
+    for (int i = 2; i >= 0; --i) {
+      freeTiles[siblingIndices[i]] = freeTiles.back();
+      freeTiles.pop_back();
+    }
+    _offset = parent;
+  }
+
+  _allocator.FreeTiles[level].push_back(_offset);
+}
+
+static bool isSameLight(const Light &_a, const Light &_b) {
+  return _a.Pos.X == _b.Pos.X && _a.Pos.Y == _b.Pos.Y && _a.Pos.Z == _b.Pos.Z &&
+         _a.Type == _b.Type && _a.Dir.X == _b.Dir.X && _a.Dir.Y == _b.Dir.Y &&
+         _a.Dir.Z == _b.Dir.Z && _a.Intensity == _b.Intensity &&
+         _a.OuterCutOff == _b.OuterCutOff;
+}
+
+static uint32_t getNumShadowTiles(const Light &_light) {
+  switch (_light.Type) {
+  case LightType::Point:
+    return 6;
+  case LightType::Spot:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+static float getShadowRange(const Light &_light) {
+  return std::max(sqrtf(_light.Intensity / shadowLightCutOff), 1.f);
+}
+
+// The largest tile size that's still no more than twice the light's range on
+// screen, in maxShadowTileSize texels per screen height.
+static uint32_t getDesiredTileSize(const Light &_light, const Float3 &_viewPos,
+                                   float _tanHalfFov) {
+  float distance = (_light.Pos - _viewPos).length();
+  float coverage =
+      getShadowRange(_light) / std::max(distance * _tanHalfFov, epsilon32);
+  coverage = std::min(coverage, 1.f);
+
+  uint32_t tileSize = maxShadowTileSize;
+  while (tileSize > minShadowTileSize &&
+         (float)(tileSize / 2) >= coverage * (float)maxShadowTileSize) {
+    tileSize /= 2;
+  }
+  return tileSize;
+}
+
+static float getSpotFov(const Light &_light) {
+  // Cut-offs are cosines, see lighting.glsl.
+  float cosHalfAngle = std::clamp(_light.OuterCutOff, 0.26f, 1.f);
+  return std::max(radToDeg(2.f * acosf(cosHalfAngle)), 1.f);
+}
+
+static void updateLightViewProj(ShadowLightState &_state,
+                                const Light &_light) {
+  float farZ = getShadowRange(_light);
+  if (_state.NumTiles == 1) {
+    float fov = getSpotFov(_light);
+    Float3 dir = _light.Dir.normalize();
+    Float3 up = fabsf(dir.Y) > 0.99f ? Float3{0, 0, 1} : Float3{0, 1, 0};
+    _state.ViewProj[0] =
+        Mat4::perspective(fov, 1.f, shadowNearZ, farZ) *
+        Mat4::lookAt(_light.Pos, _light.Pos + dir, up);
+    _state.TexelScale =
+        2.f * tanf(degToRad(fov) * 0.5f) / (float)_state.TileSize;
+    return;
+  }
+
+  const Float3 faceDirs[6] = {{1, 0, 0},  {-1, 0, 0}, {0, 1, 0},
+                              {0, -1, 0}, {0, 0, 1},  {0, 0, -1}};
+  Mat4 proj = Mat4::perspective(90.f, 1.f, shadowNearZ, farZ);
+  for (int face = 0; face < 6; ++face) {
+    Float3 up = face == 2 || face == 3 ? Float3{0, 0, 1} : Float3{0, 1, 0};
+    _state.ViewProj[face] =
+        proj * Mat4::lookAt(_light.Pos, _light.Pos + faceDirs[face], up);
+  }
+  _state.TexelScale = 2.f / (float)_state.TileSize;
+}
+
+static void freeLightTiles(ShadowAtlas &_atlas, ShadowLightState &_state) {
+  for (uint32_t tile = 0; tile < _state.NumTiles; ++tile) {
+    freeShadowTile(_atlas.Allocator, _state.TileSize,
+                   _state.TileOffsets[tile]);
+  }
+  _state = {};
+}
+
+// Falls back to smaller tiles while the atlas is too full.
+static bool allocateLightTiles(ShadowAtlas &_atlas, ShadowLightState &_state,
+                               uint32_t _numTiles, uint32_t _tileSize) {
+  for (; _tileSize >= minShadowTileSize; _tileSize /= 2) {
+    uint32_t numAllocated = 0;
+    while (numAllocated < _numTiles &&
+           allocateShadowTile(_atlas.Allocator, _tileSize,
+                              _state.TileOffsets[numAllocated])) {
+      ++numAllocated;
+    }
+    if (numAllocated == _numTiles) {
+      _state.TileSize = _tileSize;
+      _state.NumTiles = _numTiles;
+      return true;
+    }
+    for (uint32_t tile = 0; tile < numAllocated; ++tile) {
+      freeShadowTile(_atlas.Allocator, _tileSize, _state.TileOffsets[tile]);
+    }
+  }
+  return false;
+}
+
+ShadowAtlas createShadowAtlas(const Renderer &_renderer, VkCommandPool _cmdPool,
+                              VkPipelineLayout _pipelineLayout,
+                              VertexStreamLayout _vertexLayout,
+                              const Shader &_vertShader) {
+  ShadowAtlas atlas = {};
+  atlas.Allocator =
+      createShadowTileAllocator(shadowAtlasSize, minShadowTileSize);
+
+  ImageParams params = {};
+  params.Format = shadowAtlasFormat;
+  params.Width = shadowAtlasSize;
+  params.Height = shadowAtlasSize;
+  params.Usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                 VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                 VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  params.Aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+  atlas.StaticImage = createImage(_renderer, params);
+  params.Usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                 VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  atlas.SampledImage = createImage(_renderer, params);
+
+  // Tiles are loaded and stored as they are. Layouts are changed with
+  // barriers outside of the render pass, see recordShadowAtlasUpdate().
+  {
+    VkAttachmentDescription attachment = {};
+    attachment.format = shadowAtlasFormat;
+    attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference depthRef = {};
+    depthRef.attachment = 0;
+    depthRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass = {};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.pDepthStencilAttachment = &depthRef;
+
+    VkRenderPassCreateInfo renderPassCreateInfo = {};
+    renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassCreateInfo.attachmentCount = 1;
+    renderPassCreateInfo.pAttachments = &attachment;
+    renderPassCreateInfo.subpassCount = 1;
+    renderPassCreateInfo.pSubpasses = &subpass;
+    BB_VK_ASSERT(vkCreateRenderPass(_renderer.Device, &renderPassCreateInfo,
+                                    nullptr, &atlas.RenderPass));
+  }
+
+  EnumArray<ShadowCasterType, const Image *> targets = {&atlas.StaticImage,
+                                                        &atlas.SampledImage};
+  for (ShadowCasterType casterType : AllEnums<ShadowCasterType>) {
+    VkFramebufferCreateInfo fbCreateInfo = {};
+    fbCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    fbCreateInfo.renderPass = atlas.RenderPass;
+    fbCreateInfo.attachmentCount = 1;
+    fbCreateInfo.pAttachments = &targets[casterType]->View;
+    fbCreateInfo.width = shadowAtlasSize;
+    fbCreateInfo.height = shadowAtlasSize;
+    fbCreateInfo.layers = 1;
+    BB_VK_ASSERT(vkCreateFramebuffer(_renderer.Device, &fbCreateInfo, nullptr,
+                                     &atlas.Framebuffers[casterType]));
+  }
+
+  // Both sides are drawn so that open meshes like planes always cast.
+  PipelineParams pipelineParams = {};
+  const Shader *shaders[] = {&_vertShader};
+  pipelineParams.Shaders = shaders;
+  pipelineParams.NumShaders = std::size(shaders);
+  setVertexInput(pipelineParams, _vertexLayout, true);
+  pipelineParams.InputAssembly.Topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  pipelineParams.Viewport.IsDynamic = true;
+  pipelineParams.Rasterizer.PolygonMode = VK_POLYGON_MODE_FILL;
+  pipelineParams.Rasterizer.CullMode = VK_CULL_MODE_NONE;
+  pipelineParams.DepthStencil.DepthTestEnable = true;
+  pipelineParams.DepthStencil.DepthWriteEnable = true;
+  pipelineParams.Blend.NumColorBlends = 0;
+  pipelineParams.Subpass = 0;
+  pipelineParams.PipelineLayout = _pipelineLayout;
+  pipelineParams.RenderPass = atlas.RenderPass;
+  atlas.Pipeline = createPipeline(_renderer, pipelineParams);
+
+  // Clear both to the far plane and put them in their between-frame layouts.
+  VkCommandBufferAllocateInfo cmdBufferAllocInfo = {};
+  cmdBufferAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  cmdBufferAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  cmdBufferAllocInfo.commandPool = _cmdPool;
+  cmdBufferAllocInfo.commandBufferCount = 1;
+
+  VkCommandBuffer cmdBuffer;
+  BB_VK_ASSERT(vkAllocateCommandBuffers(_renderer.Device, &cmdBufferAllocInfo,
+                                        &cmdBuffer));
+
+  VkCommandBufferBeginInfo cmdBeginInfo = {};
+  cmdBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  cmdBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  BB_VK_ASSERT(vkBeginCommandBuffer(cmdBuffer, &cmdBeginInfo));
+
+  VkImageMemoryBarrier barriers[2] = {};
+  for (int i = 0; i < 2; ++i) {
+    VkImageMemoryBarrier &barrier = barriers[i];
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.image =
+        i == 0 ? atlas.StaticImage.Handle : atlas.SampledImage.Handle;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+  }
+  vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 2, barriers);
+
+  VkClearDepthStencilValue clearValue = {0.f, 0};
+  for (VkImageMemoryBarrier &barrier : barriers) {
+    vkCmdClearDepthStencilImage(cmdBuffer, barrier.image,
+                                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                &clearValue, 1, &barrier.subresourceRange);
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  }
+  barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT |
+                           VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                       0, 0, nullptr, 0, nullptr, 2, barriers);
+  BB_VK_ASSERT(vkEndCommandBuffer(cmdBuffer));
+
+  VkSubmitInfo submitInfo = {};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &cmdBuffer;
+  BB_VK_ASSERT(vkQueueSubmit(_renderer.Queue, 1, &submitInfo, VK_NULL_HANDLE));
+  BB_VK_ASSERT(vkQueueWaitIdle(_renderer.Queue));
+  vkFreeCommandBuffers(_renderer.Device, _cmdPool, 1, &cmdBuffer);
+
+  return atlas;
+}
+
+void destroyShadowAtlas(const Renderer &_renderer, ShadowAtlas &_atlas) {
+  vkDestroyPipeline(_renderer.Device, _atlas.Pipeline, nullptr);
+  for (VkFramebuffer framebuffer : _atlas.Framebuffers) {
+    vkDestroyFramebuffer(_renderer.Device, framebuffer, nullptr);
+  }
+  vkDestroyRenderPass(_renderer.Device, _atlas.RenderPass, nullptr);
+  destroyImage(_renderer, _atlas.SampledImage);
+  destroyImage(_renderer, _atlas.StaticImage);
+  _atlas = {};
+}
+
+void resetShadowAtlas(ShadowAtlas &_atlas) {
+  for (ShadowLightState &state : _atlas.Lights) {
+    freeLightTiles(_atlas, state);
+  }
+  _atlas.Lights.clear();
+}
+
+void updateShadowAtlas(
+    ShadowAtlas &_atlas, const Light *_lights, uint32_t _numLights,
+    const ViewUniformBlock &_view,
+    const EnumArray<ShadowCasterType, uint64_t> &_casterVersions,
+    ShadowLightBlock *_blocks) {
+  _atlas.Renders.clear();
+  _atlas.Stats = {};
+
+  for (uint32_t i = _numLights; i < _atlas.Lights.size(); ++i) {
+    freeLightTiles(_atlas, _atlas.Lights[i]);
+  }
+  _atlas.Lights.resize(_numLights);
+
+  struct Candidate {
+    uint32_t LightIndex;
+    uint32_t TileSize;
+    bool IsStaticStale;
+    float Priority;
+  };
+  std::vector<Candidate> candidates;
+
+  float tanHalfFov = 1.f / std::max(fabsf(_view.ProjMat.M[1][1]), epsilon32);
+
+  for (uint32_t i = 0; i < _numLights; ++i) {
+    const Light &light = _lights[i];
+    ShadowLightState &state = _atlas.Lights[i];
+
+    uint32_t numTiles = getNumShadowTiles(light);
+    if (numTiles == 0) {
+      freeLightTiles(_atlas, state);
+      continue;
+    }
+
+    // Only shrink once the desired size is a quarter of the current one, so
+    // that tiles don't flip between two sizes while the camera moves.
+    uint32_t tileSize = getDesiredTileSize(light, _view.ViewPos, tanHalfFov);
+    bool needsResize = state.NumTiles != numTiles ||
+                       tileSize > state.TileSize ||
+                       tileSize * 4 <= state.TileSize;
+    if (!needsResize) {
+      tileSize = state.TileSize;
+    }
+
+    bool isStaticStale =
+        !state.IsReady || needsResize ||
+        !isSameLight(state.Light, light) ||
+        state.CasterVersions[ShadowCasterType::Static] !=
+            _casterVersions[ShadowCasterType::Static];
+    bool isDynamicStale = isStaticStale ||
+                          state.CasterVersions[ShadowCasterType::Dynamic] !=
+                              _casterVersions[ShadowCasterType::Dynamic];
+    if (!isDynamicStale) {
+      _atlas.Stats.NumCachedLights++;
+      continue;
+    }
+
+    // Lights without any shadow yet go first, then the ones covering more of
+    // the view.
+    float priority = (float)tileSize / (float)maxShadowTileSize;
+    if (!state.IsReady) {
+      priority += 2.f;
+    }
+    candidates.push_back({i, tileSize, isStaticStale, priority});
+  }
+
+  std::sort(candidates.begin(), candidates.end(),
+            [](const Candidate &_a, const Candidate &_b) {
+              return _a.Priority > _b.Priority;
+            });
+
+  // The first candidate is always taken so that a budget smaller than one
+  // light's tiles doesn't stall every update.
+  int budget = _atlas.MaxTileRendersPerFrame;
+  bool hasScheduled = false;
+  for (const Candidate &candidate : candidates) {
+    const Light &light = _lights[candidate.LightIndex];
+    ShadowLightState &state = _atlas.Lights[candidate.LightIndex];
+
+    uint32_t numTiles = getNumShadowTiles(light);
+    int cost = (int)numTiles * (candidate.IsStaticStale ? 2 : 1);
+    if (hasScheduled && cost > budget) {
+      _atlas.Stats.NumPendingLights++;
+      continue;
+    }
+
+    // New tiles are allocated while the old ones are still held, so that a
+    // full atlas leaves the light its old tiles rather than none. The old
+    // ones are also kept over new ones that only fit at a smaller size.
+    if (state.NumTiles != numTiles || state.TileSize != candidate.TileSize) {
+      ShadowLightState resized = {};
+      bool isAllocated =
+          allocateLightTiles(_atlas, resized, numTiles, candidate.TileSize);
+      bool keepsTiles =
+          state.NumTiles == numTiles &&
+          (!isAllocated ||
+           resized.TileSize < std::min(candidate.TileSize, state.TileSize));
+      if (keepsTiles) {
+        if (isAllocated) {
+          freeLightTiles(_atlas, resized);
+        }
+      } else if (isAllocated) {
+        freeLightTiles(_atlas, state);
+        state = resized;
+      } else {
+        _atlas.Stats.NumPendingLights++;
+        continue;
+      }
+    }
+
+    if (candidate.IsStaticStale) {
+      state.Light = light;
+      updateLightViewProj(state, light);
+      state.CasterVersions[ShadowCasterType::Static] =
+          _casterVersions[ShadowCasterType::Static];
+    }
+    state.CasterVersions[ShadowCasterType::Dynamic] =
+        _casterVersions[ShadowCasterType::Dynamic];
+    state.IsReady = true;
+
+    for (uint32_t tile = 0; tile < state.NumTiles; ++tile) {
+      _atlas.Renders.push_back({state.TileOffsets[tile], state.TileSize,
+                                state.ViewProj[tile],
+                                candidate.IsStaticStale});
+      if (candidate.IsStaticStale) {
+        _atlas.Stats.NumTileRenders[ShadowCasterType::Static]++;
+      }
+      _atlas.Stats.NumTileRenders[ShadowCasterType::Dynamic]++;
+    }
+
+    budget -= cost;
+    hasScheduled = true;
+  }
+
+  float atlasSize = (float)shadowAtlasSize;
+  for (uint32_t i = 0; i < _numLights; ++i) {
+    const ShadowLightState &state = _atlas.Lights[i];
+    ShadowLightBlock &block = _blocks[i];
+    block = {};
+    if (!state.IsReady) {
+      continue;
+    }
+    block.NumTiles = state.NumTiles;
+    block.TexelScale = state.TexelScale;
+    for (uint32_t tile = 0; tile < state.NumTiles; ++tile) {
+      block.ViewProj[tile] = state.ViewProj[tile];
+      block.Tiles[tile] = {(float)state.TileOffsets[tile].X / atlasSize,
+                           (float)state.TileOffsets[tile].Y / atlasSize,
+                           (float)state.TileSize / atlasSize,
+                           (float)state.TileSize / atlasSize};
+    }
+    _atlas.Stats.NumShadowedLights++;
+  }
+
+  _atlas.Stats.Occupancy = (float)_atlas.Allocator.NumAllocatedTexels /
+                           (atlasSize * atlasSize);
+}
+
+static void transitionShadowImage(VkCommandBuffer _cmdBuffer,
+                                  const Image &_image, VkImageLayout _oldLayout,
+                                  VkImageLayout _newLayout,
+                                  VkAccessFlags _srcAccess,
+                                  VkAccessFlags _dstAccess,
+                                  VkPipelineStageFlags _srcStage,
+                                  VkPipelineStageFlags _dstStage) {
+  VkImageMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.oldLayout = _oldLayout;
+  barrier.newLayout = _newLayout;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.srcAccessMask = _srcAccess;
+  barrier.dstAccessMask = _dstAccess;
+  barrier.image = _image.Handle;
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+  barrier.subresourceRange.baseMipLevel = 0;
+  barrier.subresourceRange.levelCount = 1;
+  barrier.subresourceRange.baseArrayLayer = 0;
+  barrier.subresourceRange.layerCount = 1;
+  vkCmdPipelineBarrier(_cmdBuffer, _srcStage, _dstStage, 0, 0, nullptr, 0,
+                       nullptr, 1, &barrier);
+}
+
+void recordShadowAtlasUpdate(
+    VkCommandBuffer _cmdBuffer, const ShadowAtlas &_atlas,
+    VkPipelineLayout _pipelineLayout,
+    const std::function<void(ShadowCasterType)> &_drawCasters) {
+  constexpr VkPipelineStageFlags depthStages =
+      VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+      VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  constexpr VkAccessFlags depthAccess =
+      VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+      VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+  if (_atlas.Renders.empty()) {
+    return;
+  }
+
+  auto renderTiles = [&](ShadowCasterType _casterType) {
+    VkRenderPassBeginInfo renderPassInfo = {};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = _atlas.RenderPass;
+    renderPassInfo.framebuffer = _atlas.Framebuffers[_casterType];
+    renderPassInfo.renderArea.offset = {0, 0};
+    renderPassInfo.renderArea.extent = {shadowAtlasSize, shadowAtlasSize};
+    vkCmdBeginRenderPass(_cmdBuffer, &renderPassInfo,
+                         VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBindPipeline(_cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                      _atlas.Pipeline);
+
+    for (const ShadowTileRender &render : _atlas.Renders) {
+      if (_casterType == ShadowCasterType::Static && !render.RendersStatic) {
+        continue;
+      }
+      VkViewport viewport = {};
+      viewport.x = (float)render.Offset.X;
+      viewport.y = (float)render.Offset.Y;
+      viewport.width = (float)render.Size;
+      viewport.height = (float)render.Size;
+      viewport.minDepth = 0.f;
+      viewport.maxDepth = 1.f;
+      vkCmdSetViewport(_cmdBuffer, 0, 1, &viewport);
+
+      VkRect2D scissor = {};
+      scissor.offset = {render.Offset.X, render.Offset.Y};
+      scissor.extent = {render.Size, render.Size};
+      vkCmdSetScissor(_cmdBuffer, 0, 1, &scissor);
+
+      // Dynamic casters go on top of the static tile copied in before, static
+      // ones start from an empty tile.
+      if (_casterType == ShadowCasterType::Static) {
+        VkClearAttachment clearAttachment = {};
+        clearAttachment.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+        clearAttachment.clearValue.depthStencil = {0.f, 0};
+        VkClearRect clearRect = {};
+        clearRect.rect = scissor;
+        clearRect.baseArrayLayer = 0;
+        clearRect.layerCount = 1;
+        vkCmdClearAttachments(_cmdBuffer, 1, &clearAttachment, 1, &clearRect);
+      }
+
+      vkCmdPushConstants(_cmdBuffer, _pipelineLayout,
+                         VK_SHADER_STAGE_VERTEX_BIT,
+                         offsetof(StandardPushConstants, ShadowViewProj),
+                         sizeof(Mat4), &render.ViewProj);
+      _drawCasters(_casterType);
+    }
+
+    vkCmdEndRenderPass(_cmdBuffer);
+  };
+
+  bool rendersStatic = std::any_of(
+      _atlas.Renders.begin(), _atlas.Renders.end(),
+      [](const ShadowTileRender &_render) { return _render.RendersStatic; });
+  if (rendersStatic) {
+    transitionShadowImage(_cmdBuffer, _atlas.StaticImage,
+                          VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                          VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                          VK_ACCESS_TRANSFER_READ_BIT, depthAccess,
+                          VK_PIPELINE_STAGE_TRANSFER_BIT, depthStages);
+    renderTiles(ShadowCasterType::Static);
+    transitionShadowImage(_cmdBuffer, _atlas.StaticImage,
+                          VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                          VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                          VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                          VK_ACCESS_TRANSFER_READ_BIT, depthStages,
+                          VK_PIPELINE_STAGE_TRANSFER_BIT);
+  }
+
+  transitionShadowImage(_cmdBuffer, _atlas.SampledImage,
+                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                        VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+  std::vector<VkImageCopy> regions(_atlas.Renders.size());
+  for (size_t i = 0; i < _atlas.Renders.size(); ++i) {
+    const ShadowTileRender &render = _atlas.Renders[i];
+    VkImageCopy &region = regions[i];
+    region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    region.srcSubresource.mipLevel = 0;
+    region.srcSubresource.baseArrayLayer = 0;
+    region.srcSubresource.layerCount = 1;
+    region.srcOffset = {render.Offset.X, render.Offset.Y, 0};
+    region.dstSubresource = region.srcSubresource;
+    region.dstOffset = region.srcOffset;
+    region.extent = {render.Size, render.Size, 1};
+  }
+  vkCmdCopyImage(_cmdBuffer, _atlas.StaticImage.Handle,
+                 VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                 _atlas.SampledImage.Handle,
+                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)regions.size(),
+                 regions.data());
+
+  transitionShadowImage(_cmdBuffer, _atlas.SampledImage,
+                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                        VK_ACCESS_TRANSFER_WRITE_BIT, depthAccess,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT, depthStages);
+  renderTiles(ShadowCasterType::Dynamic);
+  transitionShadowImage(_cmdBuffer, _atlas.SampledImage,
+                        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                        VK_ACCESS_SHADER_READ_BIT, depthStages,
+                        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+}
+
+} // namespace bb
@@ -0,0 +1,122 @@
+#pragma once
+#include "render.h"
+#include <functional>
+#include <vector>
+
+namespace bb {
+
+// Shadow maps of every shadowed light, packed as tiles into one depth atlas.
+// Tiles are only rendered again when their light or the casters they hold
+// change, and at most MaxTileRendersPerFrame of them per frame.
+//
+// Casters are split in two. Static casters are rendered into StaticImage,
+// which keeps them across frames. A light's tiles in SampledImage are
+// refreshed by copying its static tiles over and drawing the dynamic casters
+// on top.
+
+constexpr uint32_t shadowAtlasSize = 4096;
+constexpr uint32_t minShadowTileSize = 128;
+constexpr uint32_t maxShadowTileSize = 1024;
+constexpr VkFormat shadowAtlasFormat = VK_FORMAT_D32_SFLOAT;
+
+enum class ShadowCasterType { Static, Dynamic, COUNT };
+
+// Power of two square tiles split from the atlas like a quadtree. Freed tiles
+// merge back with their three siblings once those are free too.
+struct ShadowTileAllocator {
+  uint32_t Size;
+  uint32_t NumLevels;
+  // Offsets of free tiles per level, level 0 being the whole atlas.
+  std::vector<std::vector<Int2>> FreeTiles;
+  uint64_t NumAllocatedTexels;
+};
+
+ShadowTileAllocator createShadowTileAllocator(uint32_t _size,
+                                              uint32_t _minTileSize);
+// _tileSize must be a power of two between the minimum and _allocator.Size.
+// Returns false if there is no free tile large enough.
+bool allocateShadowTile(ShadowTileAllocator &_allocator, uint32_t _tileSize,
+                        Int2 &_offset);
+void freeShadowTile(ShadowTileAllocator &_allocator, uint32_t _tileSize,
+                    Int2 _offset);
+
+struct ShadowLightState {
+  // The light as its static tiles were rendered.
+  Light Light;
+  uint32_t TileSize;
+  uint32_t NumTiles;
+  Int2 TileOffsets[maxNumShadowTilesPerLight];
+  Mat4 ViewProj[maxNumShadowTilesPerLight];
+  float TexelScale;
+  EnumArray<ShadowCasterType, uint64_t> CasterVersions;
+  // SampledImage holds a complete shadow map of this light.
+  bool IsReady;
+};
+
+struct ShadowTileRender {
+  Int2 Offset;
+  uint32_t Size;
+  Mat4 ViewProj;
+  // Static casters are drawn again first, otherwise the tile's static casters
+  // are reused as they are.
+  bool RendersStatic;
+};
+
+struct ShadowAtlasStats {
+  float Occupancy;
+  uint32_t NumShadowedLights;
+  // Lights whose tiles were reused as they were.
+  uint32_t NumCachedLights;
+  // Lights that needed new tiles but didn't fit in the budget.
+  uint32_t NumPendingLights;
+  EnumArray<ShadowCasterType, uint32_t> NumTileRenders;
+};
+
+struct ShadowAtlas {
+  // Static casters only, TRANSFER_SRC_OPTIMAL between frames.
+  Image StaticImage;
+  // What lighting samples, SHADER_READ_ONLY_OPTIMAL between frames.
+  Image SampledImage;
+  VkRenderPass RenderPass;
+  EnumArray<ShadowCasterType, VkFramebuffer> Framebuffers;
+  VkPipeline Pipeline;
+
+  ShadowTileAllocator Allocator;
+  std::vector<ShadowLightState> Lights;
+  // Filled by updateShadowAtlas().
+  std::vector<ShadowTileRender> Renders;
+
+  bool IsEnabled = true;
+  int MaxTileRendersPerFrame = 24;
+  ShadowAtlasStats Stats;
+};
+
+// The pipeline is created from _vertShader with position-only vertex input.
+ShadowAtlas createShadowAtlas(const Renderer &_renderer, VkCommandPool _cmdPool,
+                              VkPipelineLayout _pipelineLayout,
+                              VertexStreamLayout _vertexLayout,
+                              const Shader &_vertShader);
+void destroyShadowAtlas(const Renderer &_renderer, ShadowAtlas &_atlas);
+
+// Forgets every tile, e.g. once the casters belong to another scene.
+void resetShadowAtlas(ShadowAtlas &_atlas);
+
+// Assigns tiles to _lights by how much of the view their range covers,
+// decides which tiles to render this frame and writes a ShadowLightBlock per
+// light to _blocks. Directional lights cast no shadow. Bump a caster version
+// whenever casters of that type change.
+void updateShadowAtlas(
+    ShadowAtlas &_atlas, const Light *_lights, uint32_t _numLights,
+    const ViewUniformBlock &_view,
+    const EnumArray<ShadowCasterType, uint64_t> &_casterVersions,
+    ShadowLightBlock *_blocks);
+
+// Records this frame's tile renders outside of any render pass.
+// _drawCasters draws the casters of one type with the bound pipeline, vertex
+// positions at binding 0 and instances at binding 1 as in setVertexInput().
+void recordShadowAtlasUpdate(
+    VkCommandBuffer _cmdBuffer, const ShadowAtlas &_atlas,
+    VkPipelineLayout _pipelineLayout,
+    const std::function<void(ShadowCasterType)> &_drawCasters);
+
+} // namespace bb
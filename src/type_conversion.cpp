@@ -12,14 +12,4 @@ VkExtent3D int2ToExtent3D(Int2 _v) {
   return {(uint32_t)_v.X, (uint32_t)_v.Y, 1};
 }
 
-Float3 aiVector3DToFloat3(const aiVector3D &_aiVec3) {
-  Float3 result = {_aiVec3.x, _aiVec3.y, _aiVec3.z};
-  return result;
-}
-
-Float2 aiVector3DToFloat2(const aiVector3D &_aiVec3) {
-  Float2 result = {_aiVec3.x, _aiVec3.y};
-  return result;
-}
-
 } // namespace bb
\ No newline at end of file
@@ -3,12 +3,16 @@
 namespace bb {
 
 void printString(const std::string &_str) {
+#ifdef BB_WINDOWS
   OutputDebugStringA(_str.c_str());
+#endif
   printf("%s", _str.c_str());
 }
 
 void printString(const char *_str) {
+#ifdef BB_WINDOWS
   OutputDebugStringA(_str);
+#endif
   printf("%s", _str);
 }
 
@@ -23,6 +27,10 @@ float getElapsedTimeInSeconds(Time _start, Time _end) {
   return result;
 }
 
+float getElapsedTimeInMs(Time _start, Time _end) {
+  return std::chrono::duration<float, std::milli>(_end - _start).count();
+}
+
 bool endsWith(const std::string &_str, char _suffix) {
   return (_str.length() >= 1) && (_str[_str.length() - 1] == _suffix);
 }
@@ -16,6 +16,7 @@
     }                                                                          \
   } while (0)
 #else
+#include <assert.h>
 #define BB_ASSERT(exp) assert(exp)
 #endif
 #define BB_LOG_INFO(...) bb::log(bb::LogLevel::Info, __VA_ARGS__)
@@ -29,7 +30,7 @@
 #endif
 #define BB_VK_ASSERT(exp)                                                      \
   do {                                                                         \
-    auto __result__ = exp;                                                     \
+    [[maybe_unused]] auto __result__ = exp;                                    \
     BB_ASSERT(__result__ == VK_SUCCESS);                                       \
   } while (0)
 
@@ -53,6 +54,8 @@ using Time = std::chrono::time_point<std::chrono::high_resolution_clock>;
 
 Time getCurrentTime();
 float getElapsedTimeInSeconds(Time _start, Time _end);
+// Unlike getElapsedTimeInSeconds(), not cut to whole milliseconds.
+float getElapsedTimeInMs(Time _start, Time _end);
 
 bool endsWith(const std::string &_str, char _suffix);
 bool endsWith(const std::string &_str, const char *_suffix);
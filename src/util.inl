@@ -38,8 +38,8 @@ template <typename Fn>
 ScopeGuard<Fn>::ScopeGuard(Fn &&_func) : Func(std::move(_func)), Active(true) {}
 template <typename Fn>
 ScopeGuard<Fn>::ScopeGuard(ScopeGuard &&_other)
-    : Func(std::move(other.Func)), Active(_other.Active) {
-  other.Active = false;
+    : Func(std::move(_other.Func)), Active(_other.Active) {
+  _other.Active = false;
 }
 template <typename Fn> ScopeGuard<Fn>::~ScopeGuard() {
   if (Active)
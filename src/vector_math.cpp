@@ -1,4 +1,6 @@
 #include "vector_math.h"
+#include <algorithm>
+#include <math.h>
 
 namespace bb {
 
@@ -70,6 +72,18 @@ Float3 cross(const Float3 &_a, const Float3 &_b) {
   return result;
 }
 
+Float3 min(const Float3 &_a, const Float3 &_b) {
+  Float3 result = {std::min(_a.X, _b.X), std::min(_a.Y, _b.Y),
+                   std::min(_a.Z, _b.Z)};
+  return result;
+}
+
+Float3 max(const Float3 &_a, const Float3 &_b) {
+  Float3 result = {std::max(_a.X, _b.X), std::max(_a.Y, _b.Y),
+                   std::max(_a.Z, _b.Z)};
+  return result;
+}
+
 float dot(const Float4 &_a, const Float4 &_b) {
   return _a.X * _b.X + _a.Y * _b.Y + _a.Z * _b.Z + _a.W * _b.W;
 }
@@ -133,6 +147,30 @@ Mat4 Mat4::inverse() const {
   return result;
 }
 
+Mat4 Mat4::inverseAffine() const {
+  BB_ASSERT(M[0][3] == 0.f && M[1][3] == 0.f && M[2][3] == 0.f &&
+            M[3][3] == 1.f);
+  // The rows of the inverse of the upper 3x3 are cross products of its
+  // columns over its determinant.
+  Float3 c0 = {M[0][0], M[0][1], M[0][2]};
+  Float3 c1 = {M[1][0], M[1][1], M[1][2]};
+  Float3 c2 = {M[2][0], M[2][1], M[2][2]};
+  Float3 rows[3] = {cross(c1, c2), cross(c2, c0), cross(c0, c1)};
+  float det = dot(c0, rows[0]);
+  BB_ASSERT(compareFloats(det, 0.f) != 0);
+
+  Float3 translation = {M[3][0], M[3][1], M[3][2]};
+  Mat4 result = identity();
+  for (int r = 0; r < 3; ++r) {
+    Float3 row = rows[r] / det;
+    result.M[0][r] = row.X;
+    result.M[1][r] = row.Y;
+    result.M[2][r] = row.Z;
+    result.M[3][r] = -dot(row, translation);
+  }
+  return result;
+}
+
 Mat4 Mat4::transpose() const {
   Mat4 transposed;
   for (int r = 0; r < 4; ++r) {
@@ -281,6 +319,103 @@ Mat4 operator/(const Mat4 &_a, float _b) {
   return result;
 }
 
+Float3 transformPoint(const Mat4 &_m, const Float3 &_p) {
+  Float3 result = {
+      _m.M[0][0] * _p.X + _m.M[1][0] * _p.Y + _m.M[2][0] * _p.Z + _m.M[3][0],
+      _m.M[0][1] * _p.X + _m.M[1][1] * _p.Y + _m.M[2][1] * _p.Z + _m.M[3][1],
+      _m.M[0][2] * _p.X + _m.M[1][2] * _p.Y + _m.M[2][2] * _p.Z + _m.M[3][2],
+  };
+  return result;
+}
+
+Float3 transformDirection(const Mat4 &_m, const Float3 &_d) {
+  Float3 result = {
+      _m.M[0][0] * _d.X + _m.M[1][0] * _d.Y + _m.M[2][0] * _d.Z,
+      _m.M[0][1] * _d.X + _m.M[1][1] * _d.Y + _m.M[2][1] * _d.Z,
+      _m.M[0][2] * _d.X + _m.M[1][2] * _d.Y + _m.M[2][2] * _d.Z,
+  };
+  return result;
+}
+
+bool AABB::isValid() const {
+  return (Min.X <= Max.X) && (Min.Y <= Max.Y) && (Min.Z <= Max.Z);
+}
+
+Float3 AABB::center() const { return (Min + Max) * 0.5f; }
+
+Float3 AABB::halfExtent() const { return (Max - Min) * 0.5f; }
+
+void AABB::extend(const Float3 &_p) {
+  Min = min(Min, _p);
+  Max = max(Max, _p);
+}
+
+void AABB::extend(const AABB &_other) {
+  Min = min(Min, _other.Min);
+  Max = max(Max, _other.Max);
+}
+
+// Arvo's method: transforms the center and projects the half extent onto the
+// absolute values of the rotation/scale part.
+AABB transformAABB(const Mat4 &_m, const AABB &_aabb) {
+  if (!_aabb.isValid()) {
+    return _aabb;
+  }
+
+  Float3 center = transformPoint(_m, _aabb.center());
+  Float3 halfExtent = _aabb.halfExtent();
+  Float3 newHalfExtent = {
+      fabsf(_m.M[0][0]) * halfExtent.X + fabsf(_m.M[1][0]) * halfExtent.Y +
+          fabsf(_m.M[2][0]) * halfExtent.Z,
+      fabsf(_m.M[0][1]) * halfExtent.X + fabsf(_m.M[1][1]) * halfExtent.Y +
+          fabsf(_m.M[2][1]) * halfExtent.Z,
+      fabsf(_m.M[0][2]) * halfExtent.X + fabsf(_m.M[1][2]) * halfExtent.Y +
+          fabsf(_m.M[2][2]) * halfExtent.Z,
+  };
+
+  AABB result;
+  result.Min = center - newHalfExtent;
+  result.Max = center + newHalfExtent;
+  return result;
+}
+
+Frustum extractFrustum(const Mat4 &_m) {
+  Float4 x = _m.row(0);
+  Float4 y = _m.row(1);
+  Float4 z = _m.row(2);
+  Float4 w = _m.row(3);
+  auto add = [](const Float4 &_a, const Float4 &_b) -> Float4 {
+    return {_a.X + _b.X, _a.Y + _b.Y, _a.Z + _b.Z, _a.W + _b.W};
+  };
+  auto sub = [](const Float4 &_a, const Float4 &_b) -> Float4 {
+    return {_a.X - _b.X, _a.Y - _b.Y, _a.Z - _b.Z, _a.W - _b.W};
+  };
+
+  Frustum frustum = {{add(w, x), sub(w, x), add(w, y), sub(w, y), z,
+                      sub(w, z)}};
+  for (Float4 &plane : frustum.Planes) {
+    float length =
+        sqrtf(plane.X * plane.X + plane.Y * plane.Y + plane.Z * plane.Z);
+    if (length > 0.f) {
+      plane = {plane.X / length, plane.Y / length, plane.Z / length,
+               plane.W / length};
+    }
+  }
+  return frustum;
+}
+
+bool isSphereInFrustum(const Frustum &_frustum, const Float3 &_center,
+                       float _radius) {
+  for (const Float4 &plane : _frustum.Planes) {
+    if (plane.X * _center.X + plane.Y * _center.Y + plane.Z * _center.Z +
+            plane.W <
+        -_radius) {
+      return false;
+    }
+  }
+  return true;
+}
+
 Float3 sphericalToCartesian(const SphericalFloat3 &_spherical) {
   float cosTheta = cosf(_spherical.theta);
 
@@ -1,6 +1,7 @@
 #pragma once
 #include "util.h"
 #include <limits>
+#include <float.h>
 
 namespace bb {
 constexpr float pi32 = 3.141592f;
@@ -45,6 +46,8 @@ struct Float3 {
 
 float dot(const Float3 &_a, const Float3 &_b);
 Float3 cross(const Float3 &_a, const Float3 &_b);
+Float3 min(const Float3 &_a, const Float3 &_b);
+Float3 max(const Float3 &_a, const Float3 &_b);
 
 struct Float4 {
   float X = 0.f;
@@ -68,6 +71,8 @@ struct Mat4 {
   Float4 column(int _n) const;
   float cofactor(int _row, int _col) const;
   Mat4 inverse() const;
+  // For matrices whose bottom row is 0 0 0 1, much cheaper than inverse().
+  Mat4 inverseAffine() const;
   Mat4 transpose() const;
 
   static Mat4 identity();
@@ -85,6 +90,35 @@ struct Mat4 {
 
 Mat4 operator*(const Mat4 &_a, const Mat4 &_b);
 Mat4 operator/(const Mat4 &_a, float _b);
+Float3 transformPoint(const Mat4 &_m, const Float3 &_p);
+Float3 transformDirection(const Mat4 &_m, const Float3 &_d);
+
+// Starts out inverted (Min > Max) so that the first extend() sets both ends.
+struct AABB {
+  Float3 Min = {FLT_MAX, FLT_MAX, FLT_MAX};
+  Float3 Max = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+
+  bool isValid() const;
+  Float3 center() const;
+  Float3 halfExtent() const;
+  void extend(const Float3 &_p);
+  void extend(const AABB &_other);
+};
+
+AABB transformAABB(const Mat4 &_m, const AABB &_aabb);
+
+// Planes are stored as (normal, distance) with normals pointing inward, so a
+// point p is inside when dot(normal, p) + distance >= 0 for every plane.
+struct Frustum {
+  Float4 Planes[6];
+};
+
+// Extracts the planes of the clip volume -w <= x, y <= w, 0 <= z <= w from
+// _m. Pass a view-projection matrix for world-space planes, or a
+// model-view-projection matrix for planes in that model's space.
+Frustum extractFrustum(const Mat4 &_m);
+bool isSphereInFrustum(const Frustum &_frustum, const Float3 &_center,
+                       float _radius);
 
 struct SphericalFloat3 {
   float r;
@@ -0,0 +1,28 @@
+#pragma once
+#include "vector_math.h"
+
+namespace bb {
+
+// Vertex formats, free of Vulkan so that CPU-only code can build meshes. See
+// MeshVertexInput in render.h for how they're bound.
+
+struct Vertex {
+  Float3 Pos;
+  Float2 UV;
+  Float3 Normal = {0, 0, -1};
+  Float3 Tangent = {0, -1, 0};
+};
+
+// Everything in Vertex except Pos, for meshes stored as split streams.
+struct VertexAttributes {
+  Float2 UV;
+  Float3 Normal = {0, 0, -1};
+  Float3 Tangent = {0, -1, 0};
+};
+
+struct InstanceBlock {
+  Mat4 ModelMat;
+  Mat4 InvModelMat;
+};
+
+} // namespace bb
@@ -0,0 +1,73 @@
+#include "test.h"
+#include <stdio.h>
+#include <string.h>
+
+namespace bb {
+
+static uint32_t gNumFailedChecks;
+
+void failCheck(const char *_file, int _line, const char *_expression) {
+  // Only the first few of a check that fails in a loop are worth reading.
+  constexpr uint32_t maxNumReportedChecks = 8;
+  if (gNumFailedChecks < maxNumReportedChecks) {
+    printf("  %s:%d: %s\n", _file, _line, _expression);
+  }
+  ++gNumFailedChecks;
+}
+
+static void printUsage() {
+  printf("Usage: tests [--filter <substring>] [--list]\n");
+}
+
+} // namespace bb
+
+int main(int _argc, char **_argv) {
+  using namespace bb;
+
+  std::string filter;
+  bool listsOnly = false;
+  for (int i = 1; i < _argc; ++i) {
+    const char *arg = _argv[i];
+    bool hasValue = i + 1 < _argc;
+    if (strcmp(arg, "--filter") == 0 && hasValue) {
+      filter = _argv[++i];
+    } else if (strcmp(arg, "--list") == 0) {
+      listsOnly = true;
+    } else {
+      printUsage();
+      return 1;
+    }
+  }
+
+  std::vector<Test> tests;
+  addBVHTests(tests);
+  addOcclusionTests(tests);
+
+  uint32_t numRun = 0;
+  uint32_t numFailed = 0;
+  for (const Test &test : tests) {
+    if (test.Name.find(filter) == std::string::npos) {
+      continue;
+    }
+    if (listsOnly) {
+      printf("%s\n", test.Name.c_str());
+      continue;
+    }
+    gNumFailedChecks = 0;
+    test.Run();
+    ++numRun;
+    if (gNumFailedChecks > 0) {
+      printf("%-48s FAILED (%u checks)\n", test.Name.c_str(),
+             gNumFailedChecks);
+      ++numFailed;
+    } else {
+      printf("%-48s ok\n", test.Name.c_str());
+    }
+    fflush(stdout);
+  }
+
+  if (!listsOnly) {
+    printf("%u of %u tests passed\n", numRun - numFailed, numRun);
+  }
+  return numFailed > 0 ? 1 : 0;
+}
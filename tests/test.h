@@ -0,0 +1,29 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace bb {
+
+// Unit tests of core code that builds without Vulkan. A test runs to the end
+// even when a check fails, so that every failed check gets reported.
+
+struct Test {
+  std::string Name;
+  std::function<void()> Run;
+};
+
+void addBVHTests(std::vector<Test> &_tests);
+void addOcclusionTests(std::vector<Test> &_tests);
+
+// Reports a failed check of the running test.
+void failCheck(const char *_file, int _line, const char *_expression);
+
+} // namespace bb
+
+#define BB_CHECK(exp)                                                          \
+  do {                                                                         \
+    if (!(exp)) {                                                              \
+      bb::failCheck(__FILE__, __LINE__, #exp);                                 \
+    }                                                                          \
+  } while (0)
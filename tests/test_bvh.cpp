@@ -0,0 +1,71 @@
+#include "test.h"
+#include "bvh.h"
+#include <random>
+
+namespace bb {
+
+static uint32_t getBVHDepth(const BVH &_bvh, uint32_t _node = 0) {
+  const BVHNode &node = _bvh.Nodes[_node];
+  if (node.NumItems > 0) {
+    return 0;
+  }
+  return 1 + std::max(getBVHDepth(_bvh, node.First),
+                      getBVHDepth(_bvh, node.First + 1));
+}
+
+static std::vector<AABB> createRandomBounds(int _numItems) {
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<float> position(-10.f, 10.f);
+  std::uniform_real_distribution<float> size(0.1f, 1.f);
+  std::vector<AABB> bounds(_numItems);
+  for (AABB &item : bounds) {
+    Float3 min = {position(rng), position(rng), position(rng)};
+    item.extend(min);
+    item.extend(min + Float3{size(rng), size(rng), size(rng)});
+  }
+  return bounds;
+}
+
+// Builds stop splitting at the depth cap, so that the fixed traversal stacks
+// can't overflow, and the oversized leaves that leaves behind still traverse
+// like any other.
+static void testDepthIsCapped() {
+  JobSystem jobSystem;
+  initJobSystem(jobSystem, 2);
+
+  constexpr int numItems = 1000;
+  constexpr uint32_t maxDepth = 4;
+  std::vector<AABB> bounds = createRandomBounds(numItems);
+  BVH bvh = buildBVH(jobSystem, bounds, 1, maxDepth);
+  BB_CHECK(getBVHDepth(bvh) == maxDepth);
+  BB_CHECK(getBVHDepth(buildBVH(jobSystem, bounds, 1)) > maxDepth);
+
+  std::vector<uint32_t> items;
+  queryBVH(bvh, bounds, {0.f, 0.f, 0.f}, FLT_MAX, items);
+  BB_CHECK(items.size() == numItems);
+
+  // Aimed at an item, which others may be in front of.
+  Float3 origin = {-20.f, 0.5f, 0.5f};
+  Ray ray = {origin, bounds[0].center() - origin};
+  Float3 invDir = {1.f / ray.Dir.X, 1.f / ray.Dir.Y, 1.f / ray.Dir.Z};
+  RayHit expected = {};
+  for (uint32_t i = 0; i < numItems; ++i) {
+    float t = intersectRayAABB(ray, invDir, bounds[i]);
+    if (t < expected.T) {
+      expected = {t, i};
+    }
+  }
+  RayHit hit = raycastBVH(bvh, ray, [&](uint32_t _item, const Ray &_ray) {
+    return intersectRayAABB(_ray, invDir, bounds[_item]);
+  });
+  BB_CHECK(expected.Item != UINT32_MAX);
+  BB_CHECK(hit.Item == expected.Item);
+
+  destroyJobSystem(jobSystem);
+}
+
+void addBVHTests(std::vector<Test> &_tests) {
+  _tests.push_back({"BVH/DepthIsCapped", testDepthIsCapped});
+}
+
+} // namespace bb
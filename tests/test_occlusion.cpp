@@ -0,0 +1,315 @@
+#include "test.h"
+#include "occlusion.h"
+#include <math.h>
+
+namespace bb {
+
+constexpr int testBufferWidth = 64;
+constexpr int testBufferHeight = 32;
+
+// Identity transforms keep clip space positions, so that tests can place
+// triangles straight in normalized device coordinates at W = 1.
+static Float3 toScreen(const OcclusionBuffer &_buffer, const Float3 &_p) {
+  return {(_p.X * 0.5f + 0.5f) * (float)_buffer.Width,
+          (_p.Y * 0.5f + 0.5f) * (float)_buffer.Height, _p.Z};
+}
+
+static float edgeFunction(const Float3 &_a, const Float3 &_b, float _x,
+                          float _y) {
+  return (_b.X - _a.X) * (_y - _a.Y) - (_b.Y - _a.Y) * (_x - _a.X);
+}
+
+// Barycentric depth of the triangle's plane at (_x, _y), and whether the
+// point is inside, edges included up to _epsilon.
+static bool interpolateDepth(const Float3 (&_v)[3], float _x, float _y,
+                             float &_depth, float _epsilon = 1e-4f) {
+  float area = edgeFunction(_v[0], _v[1], _v[2].X, _v[2].Y);
+  float w0 = edgeFunction(_v[1], _v[2], _x, _y) / area;
+  float w1 = edgeFunction(_v[2], _v[0], _x, _y) / area;
+  float w2 = edgeFunction(_v[0], _v[1], _x, _y) / area;
+  _depth = w0 * _v[0].Z + w1 * _v[1].Z + w2 * _v[2].Z;
+  return w0 >= -_epsilon && w1 >= -_epsilon && w2 >= -_epsilon;
+}
+
+static OccluderMesh createTriangleMesh(const Float3 (&_v)[3]) {
+  OccluderMesh mesh;
+  mesh.Positions.assign(std::begin(_v), std::end(_v));
+  mesh.Indices = {0, 1, 2};
+  return mesh;
+}
+
+static OccluderMesh createQuadMesh(float _minX, float _minY, float _maxX,
+                                   float _maxY, float _z) {
+  OccluderMesh mesh;
+  mesh.Positions = {
+      {_minX, _minY, _z}, {_maxX, _minY, _z}, {_maxX, _maxY, _z},
+      {_minX, _maxY, _z}};
+  mesh.Indices = {0, 1, 2, 0, 2, 3};
+  return mesh;
+}
+
+static void rasterizeMesh(JobSystem &_jobSystem, OcclusionBuffer &_buffer,
+                          const OccluderMesh &_mesh, const Mat4 &_modelViewProj,
+                          OcclusionCoverage _coverage) {
+  rasterizeOccluders(_jobSystem, _buffer, {{&_mesh, _modelViewProj, 1}},
+                     nullptr, _coverage);
+}
+
+static void testConservativeCoverage() {
+  JobSystem jobSystem;
+  initJobSystem(jobSystem, 2);
+
+  const Float3 triangle[3] = {
+      {-0.8f, -0.7f, 0.5f}, {0.9f, -0.2f, 0.5f}, {-0.1f, 0.85f, 0.5f}};
+  OccluderMesh mesh = createTriangleMesh(triangle);
+  OcclusionBuffer conservative =
+      createOcclusionBuffer(testBufferWidth, testBufferHeight);
+  OcclusionBuffer pixelCenter =
+      createOcclusionBuffer(testBufferWidth, testBufferHeight);
+  rasterizeMesh(jobSystem, conservative, mesh, Mat4::identity(),
+                OcclusionCoverage::Conservative);
+  rasterizeMesh(jobSystem, pixelCenter, mesh, Mat4::identity(),
+                OcclusionCoverage::PixelCenter);
+
+  Float3 screen[3];
+  for (int i = 0; i < 3; ++i) {
+    screen[i] = toScreen(conservative, triangle[i]);
+  }
+
+  int numConservative = 0;
+  int numPixelCenter = 0;
+  for (int y = 0; y < testBufferHeight; ++y) {
+    for (int x = 0; x < testBufferWidth; ++x) {
+      size_t pixel = (size_t)y * testBufferWidth + x;
+      float depth;
+      bool isCenterInside =
+          interpolateDepth(screen, (float)x + 0.5f, (float)y + 0.5f, depth);
+      numPixelCenter += pixelCenter.Depth[pixel] > 0.f;
+      // Pixel centers exactly on an edge may go either way.
+      if (pixelCenter.Depth[pixel] > 0.f) {
+        BB_CHECK(isCenterInside);
+      }
+      if (conservative.Depth[pixel] <= 0.f) {
+        continue;
+      }
+      ++numConservative;
+      BB_CHECK(pixelCenter.Depth[pixel] > 0.f);
+      for (int corner = 0; corner < 4; ++corner) {
+        float cornerX = (float)(x + (corner & 1));
+        float cornerY = (float)(y + (corner >> 1));
+        BB_CHECK(interpolateDepth(screen, cornerX, cornerY, depth));
+      }
+    }
+  }
+  BB_CHECK(numConservative > 0);
+  BB_CHECK(numConservative < numPixelCenter);
+
+  destroyJobSystem(jobSystem);
+}
+
+static void testConservativeDepth() {
+  JobSystem jobSystem;
+  initJobSystem(jobSystem, 2);
+
+  const Float3 triangle[3] = {
+      {-1.f, -1.f, 0.2f}, {3.f, -1.f, 0.9f}, {-1.f, 3.f, 0.5f}};
+  OccluderMesh mesh = createTriangleMesh(triangle);
+  OcclusionBuffer conservative =
+      createOcclusionBuffer(testBufferWidth, testBufferHeight);
+  OcclusionBuffer pixelCenter =
+      createOcclusionBuffer(testBufferWidth, testBufferHeight);
+  rasterizeMesh(jobSystem, conservative, mesh, Mat4::identity(),
+                OcclusionCoverage::Conservative);
+  rasterizeMesh(jobSystem, pixelCenter, mesh, Mat4::identity(),
+                OcclusionCoverage::PixelCenter);
+
+  Float3 screen[3];
+  for (int i = 0; i < 3; ++i) {
+    screen[i] = toScreen(conservative, triangle[i]);
+  }
+
+  // The triangle covers the whole buffer. Conservative coverage leaves out
+  // the outermost pixels, whose neighborhoods reach past the buffer.
+  for (int y = 0; y < testBufferHeight; ++y) {
+    for (int x = 0; x < testBufferWidth; ++x) {
+      size_t pixel = (size_t)y * testBufferWidth + x;
+      float centerDepth;
+      interpolateDepth(screen, (float)x + 0.5f, (float)y + 0.5f, centerDepth);
+      BB_CHECK(fabsf(pixelCenter.Depth[pixel] - centerDepth) < 1e-4f);
+
+      bool isBorder = x == 0 || y == 0 || x == testBufferWidth - 1 ||
+                      y == testBufferHeight - 1;
+      BB_CHECK((conservative.Depth[pixel] > 0.f) != isBorder);
+      for (int corner = 0; corner < 4; ++corner) {
+        float cornerDepth;
+        interpolateDepth(screen, (float)(x + (corner & 1)),
+                         (float)(y + (corner >> 1)), cornerDepth);
+        BB_CHECK(conservative.Depth[pixel] <= cornerDepth + 1e-5f);
+      }
+    }
+  }
+
+  destroyJobSystem(jobSystem);
+}
+
+static void testAABBQueries() {
+  JobSystem jobSystem;
+  initJobSystem(jobSystem, 2);
+
+  // The left half of the screen at depth 0.8, larger being closer.
+  OccluderMesh mesh = createQuadMesh(-1.f, -1.f, 0.f, 1.f, 0.8f);
+  OcclusionBuffer buffer =
+      createOcclusionBuffer(testBufferWidth, testBufferHeight);
+  rasterizeMesh(jobSystem, buffer, mesh, Mat4::identity(),
+                OcclusionCoverage::Conservative);
+
+  auto isOccluded = [&](Float3 _min, Float3 _max) {
+    AABB bounds;
+    bounds.extend(_min);
+    bounds.extend(_max);
+    return isAABBOccluded(buffer, Mat4::identity(), bounds);
+  };
+
+  // Behind the occluder
+  BB_CHECK(isOccluded({-0.9f, -0.5f, 0.1f}, {-0.1f, 0.5f, 0.5f}));
+  // In front of it, or partly so
+  BB_CHECK(!isOccluded({-0.9f, -0.5f, 0.85f}, {-0.1f, 0.5f, 0.95f}));
+  BB_CHECK(!isOccluded({-0.9f, -0.5f, 0.5f}, {-0.1f, 0.5f, 0.9f}));
+  // Reaching past its edge, even by less than a pixel
+  BB_CHECK(!isOccluded({-0.5f, -0.5f, 0.1f}, {0.3f, 0.5f, 0.5f}));
+  BB_CHECK(!isOccluded({-0.5f, -0.5f, 0.1f}, {0.01f, 0.5f, 0.5f}));
+  // Entirely off screen
+  BB_CHECK(isOccluded({1.5f, -0.5f, 0.1f}, {2.f, 0.5f, 0.5f}));
+  // Crossing the near plane
+  BB_CHECK(!isOccluded({-0.9f, -0.5f, 0.1f}, {-0.1f, 0.5f, 1.5f}));
+  // Invalid
+  BB_CHECK(!isAABBOccluded(buffer, Mat4::identity(), AABB{}));
+
+  destroyJobSystem(jobSystem);
+}
+
+// A cube over [-1, 1]^3 whose faces are split into _numCells^2 quads, with
+// outward normals.
+static void createCube(int _numCells, std::vector<Vertex> &_vertices,
+                       std::vector<uint32_t> &_indices) {
+  const Float3 axes[3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+  for (int axis = 0; axis < 3; ++axis) {
+    for (float sign : {-1.f, 1.f}) {
+      Float3 normal = axes[axis] * sign;
+      Float3 u = axes[(axis + 1) % 3];
+      Float3 v = axes[(axis + 2) % 3];
+      uint32_t first = (uint32_t)_vertices.size();
+      for (int j = 0; j <= _numCells; ++j) {
+        for (int i = 0; i <= _numCells; ++i) {
+          float s = (float)i / (float)_numCells * 2.f - 1.f;
+          float t = (float)j / (float)_numCells * 2.f - 1.f;
+          Vertex vertex;
+          vertex.Pos = normal + u * s + v * t;
+          vertex.Normal = normal;
+          _vertices.push_back(vertex);
+        }
+      }
+      for (int j = 0; j < _numCells; ++j) {
+        for (int i = 0; i < _numCells; ++i) {
+          uint32_t a = first + (uint32_t)(j * (_numCells + 1) + i);
+          uint32_t b = a + 1;
+          uint32_t c = a + (uint32_t)_numCells + 1;
+          uint32_t d = c + 1;
+          _indices.insert(_indices.end(), {a, b, d, a, d, c});
+        }
+      }
+    }
+  }
+}
+
+static void testSimplifiedOccluderIsConservative() {
+  JobSystem jobSystem;
+  initJobSystem(jobSystem, 2);
+
+  std::vector<Vertex> vertices;
+  std::vector<uint32_t> indices;
+  createCube(7, vertices, indices);
+  OccluderMesh fullMesh;
+  for (const Vertex &vertex : vertices) {
+    fullMesh.Positions.push_back(vertex.Pos);
+  }
+  fullMesh.Indices = indices;
+
+  OccluderMesh simplified = simplifyOccluder(vertices.data(), indices.data(),
+                                             0, (uint32_t)indices.size(), 5);
+  BB_CHECK(!simplified.Indices.empty());
+  BB_CHECK(simplified.Indices.size() < indices.size());
+  for (uint32_t index : simplified.Indices) {
+    const Float3 &p = simplified.Positions[index];
+    BB_CHECK(fabsf(p.X) < 1.f && fabsf(p.Y) < 1.f && fabsf(p.Z) < 1.f);
+  }
+
+  // Wherever the simplified cube occludes, the cube is there, at least as
+  // close.
+  Mat4 viewProj =
+      Mat4::perspective(60.f, 2.f, 0.1f, 100.f) *
+      Mat4::lookAt({2.5f, 1.8f, -3.5f}, {0.f, 0.f, 0.f});
+  for (float degrees : {0.f, 30.f, 75.f}) {
+    Mat4 modelViewProj = viewProj * Mat4::rotateY(degrees);
+    OcclusionBuffer exact =
+        createOcclusionBuffer(occlusionBufferWidth, occlusionBufferHeight);
+    OcclusionBuffer occluder =
+        createOcclusionBuffer(occlusionBufferWidth, occlusionBufferHeight);
+    rasterizeMesh(jobSystem, exact, fullMesh, modelViewProj,
+                  OcclusionCoverage::PixelCenter);
+    rasterizeMesh(jobSystem, occluder, simplified, modelViewProj,
+                  OcclusionCoverage::Conservative);
+
+    int numCovered = 0;
+    for (size_t i = 0; i < occluder.Depth.size(); ++i) {
+      if (occluder.Depth[i] > 0.f) {
+        ++numCovered;
+        BB_CHECK(exact.Depth[i] >= occluder.Depth[i]);
+      }
+    }
+    BB_CHECK(numCovered > 0);
+  }
+
+  destroyJobSystem(jobSystem);
+}
+
+static void testSimplifyDropsThinSheets() {
+  // Both sides of a square share their positions, so every cluster sees
+  // normals that cancel out.
+  std::vector<Vertex> vertices;
+  std::vector<uint32_t> indices;
+  for (float sign : {1.f, -1.f}) {
+    uint32_t first = (uint32_t)vertices.size();
+    for (int j = 0; j <= 4; ++j) {
+      for (int i = 0; i <= 4; ++i) {
+        Vertex vertex;
+        vertex.Pos = {(float)i * 0.5f - 1.f, (float)j * 0.5f - 1.f, 0.f};
+        vertex.Normal = {0.f, 0.f, sign};
+        vertices.push_back(vertex);
+      }
+    }
+    for (int j = 0; j < 4; ++j) {
+      for (int i = 0; i < 4; ++i) {
+        uint32_t a = first + (uint32_t)(j * 5 + i);
+        indices.insert(indices.end(), {a, a + 1, a + 6, a, a + 6, a + 5});
+      }
+    }
+  }
+
+  OccluderMesh simplified = simplifyOccluder(vertices.data(), indices.data(),
+                                             0, (uint32_t)indices.size(), 3);
+  BB_CHECK(simplified.Indices.empty());
+}
+
+void addOcclusionTests(std::vector<Test> &_tests) {
+  _tests.push_back(
+      {"Occlusion/ConservativeCoverage", testConservativeCoverage});
+  _tests.push_back({"Occlusion/ConservativeDepth", testConservativeDepth});
+  _tests.push_back({"Occlusion/AABBQueries", testAABBQueries});
+  _tests.push_back({"Occlusion/SimplifiedOccluderIsConservative",
+                    testSimplifiedOccluderIsConservative});
+  _tests.push_back(
+      {"Occlusion/SimplifyDropsThinSheets", testSimplifyDropsThinSheets});
+}
+
+} // namespace bb
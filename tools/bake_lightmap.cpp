@@ -0,0 +1,52 @@
+#include "shader_ball.h"
+#include "resource_root.h"
+#include "path.h"
+#include "util.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Bakes ShaderBallScene's lightmap without a window or a GPU, so that it can
+// run on build machines.
+
+static void printUsage() {
+  printf("Usage: bake_lightmap [--resources <dir>] [--output <path>]\n"
+         "                     [--size <texels>] [--samples <n>] "
+         "[--bounces <n>]\n");
+}
+
+int main(int _argc, char **_argv) {
+  using namespace bb;
+
+  std::string resourceRoot = "resources";
+  std::string lightmapPath;
+  LightmapBakeParams params;
+  for (int i = 1; i < _argc; ++i) {
+    const char *arg = _argv[i];
+    bool hasValue = i + 1 < _argc;
+    if (strcmp(arg, "--resources") == 0 && hasValue) {
+      resourceRoot = _argv[++i];
+    } else if (strcmp(arg, "--output") == 0 && hasValue) {
+      lightmapPath = _argv[++i];
+    } else if (strcmp(arg, "--size") == 0 && hasValue) {
+      params.Size = (uint32_t)atoi(_argv[++i]);
+    } else if (strcmp(arg, "--samples") == 0 && hasValue) {
+      params.NumSamples = (uint32_t)atoi(_argv[++i]);
+    } else if (strcmp(arg, "--bounces") == 0 && hasValue) {
+      params.MaxBounces = (uint32_t)atoi(_argv[++i]);
+    } else {
+      printUsage();
+      return 1;
+    }
+  }
+
+  setResourceRoots(resourceRoot, joinPaths(resourceRoot, "shaders"));
+  if (lightmapPath.empty()) {
+    lightmapPath = createCommonResourcePath(shaderBallLightmapFileName);
+  }
+
+  JobSystem jobSystem;
+  initJobSystem(jobSystem);
+  bool isBaked = bakeShaderBallLightmap(jobSystem, params, lightmapPath);
+  destroyJobSystem(jobSystem);
+  return isBaked ? 0 : 1;
+}
@@ -0,0 +1,53 @@
+#include "capture.h"
+#include "resource_root.h"
+#include "util.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Replays a capture written by `bibim --frame-capture` without a window, so
+// that frames can be timed on any machine, software drivers such as lavapipe
+// included.
+
+static void printUsage() {
+  printf("Usage: replay_capture <capture> [--iterations <n>] [--warmup <n>]\n"
+         "                      [--compare] [--shaders <dir>]\n");
+}
+
+int main(int _argc, char **_argv) {
+  using namespace bb;
+
+  std::string capturePath;
+  // Compiled shaders are written next to their sources.
+  std::string shaderRoot = "src/shaders";
+  FrameReplayParams params;
+  for (int i = 1; i < _argc; ++i) {
+    const char *arg = _argv[i];
+    bool hasValue = i + 1 < _argc;
+    if (strcmp(arg, "--iterations") == 0 && hasValue) {
+      params.NumIterations = (uint32_t)atoi(_argv[++i]);
+    } else if (strcmp(arg, "--warmup") == 0 && hasValue) {
+      params.NumWarmupIterations = (uint32_t)atoi(_argv[++i]);
+    } else if (strcmp(arg, "--compare") == 0) {
+      params.CompareWithReloadedShaders = true;
+    } else if (strcmp(arg, "--shaders") == 0 && hasValue) {
+      shaderRoot = _argv[++i];
+    } else if (arg[0] != '-' && capturePath.empty()) {
+      capturePath = arg;
+    } else {
+      printUsage();
+      return 1;
+    }
+  }
+  if (capturePath.empty()) {
+    printUsage();
+    return 1;
+  }
+
+  // Only shaders are reloaded, for --compare.
+  setResourceRoots({}, shaderRoot);
+  if (volkInitialize() != VK_SUCCESS) {
+    printLine("Failed to load the Vulkan loader");
+    return 1;
+  }
+  return replayFrameCapture(capturePath, params) ? 0 : 1;
+}